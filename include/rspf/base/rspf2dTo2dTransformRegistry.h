@@ -70,7 +70,8 @@ public:
    
 protected:
    rspf2dTo2dTransformRegistry()
-   :rspfObjectFactory()
+   :rspfObjectFactory(),
+    rspfFactoryListInterface<rspf2dTo2dTransformFactoryBase, rspf2dTo2dTransform>("2d_to_2d_transform")
    {}
    
    rspf2dTo2dTransformRegistry( const rspf2dTo2dTransformRegistry& rhs )
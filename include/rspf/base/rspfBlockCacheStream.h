@@ -0,0 +1,264 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfBlockCacheStream.h
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  Block cache for read only file streams.
+//
+// Class declarations for:
+//
+// rspfBlockCache
+// rspfBlockCacheStreamBuf
+// rspfBlockCacheIStream
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#ifndef rspfBlockCacheStream_HEADER
+#define rspfBlockCacheStream_HEADER 1
+
+#include <rspf/base/rspfConstants.h>
+#include <rspf/base/rspfReferenced.h>
+#include <rspf/base/rspfRefPtr.h>
+#include <rspf/base/rspfIoStream.h>
+#include <OpenThreads/Mutex>
+
+#include <iosfwd>
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @class rspfBlockCache
+ *
+ * Process wide cache of fixed size file blocks shared by every
+ * rspfBlockCacheIStream.  Handlers that do many small seekg/read calls,
+ * e.g. a post at a time from a dted cell, are served from memory after the
+ * first block read instead of making a system call, or a network round trip,
+ * per read.
+ *
+ * - Blocks are evicted least recently used first once the cache holds more
+ *   than getMaxBytes.
+ * - A stream that reads consecutive blocks gets read ahead: the miss is
+ *   filled with one larger read covering the next blocks too, doubling up to
+ *   getReadAheadBlocks.
+ * - Reads are positional(pread) on a descriptor per stream, and the cache is
+ *   locked only around lookups and inserts, so streams on different threads
+ *   do not serialize on each other's I/O.
+ * - Blocks are keyed by path, size and modification time, so a rewritten
+ *   file is not served stale data.
+ *
+ * Preferences, read at first use:
+ * <pre>
+ * stream_cache.enabled:           true
+ * stream_cache.block_size:        65536
+ * stream_cache.max_bytes:         134217728
+ * stream_cache.read_ahead_blocks: 8
+ * </pre>
+ */
+class RSPF_DLL rspfBlockCache : public rspfReferenced
+{
+public:
+
+   /** @brief Counters since start up or resetStatistics. */
+   struct RSPF_DLL Statistics
+   {
+      Statistics();
+
+      /** @return hits / (hits + misses), zero with no lookups. */
+      double getHitRate() const;
+
+      rspf_uint64 m_hits;            ///< Block lookups served from memory.
+      rspf_uint64 m_misses;          ///< Block lookups that went to the file.
+      rspf_uint64 m_readAheadBlocks; ///< Blocks read ahead of a miss.
+      rspf_uint64 m_bypassReads;     ///< Large reads passed straight to the file.
+      rspf_uint64 m_fileReads;       ///< Reads made on files.
+      rspf_uint64 m_bytesRead;       ///< Bytes read from files.
+      rspf_uint64 m_evictions;       ///< Blocks dropped for space.
+      rspf_uint64 m_cachedBytes;     ///< Bytes held now.
+   };
+
+   /** One cached block. */
+   class Block : public rspfReferenced
+   {
+   public:
+      Block() : m_offset(0), m_data() {}
+      rspf_uint64       m_offset; ///< File offset of m_data[0].
+      std::vector<char> m_data;
+   protected:
+      virtual ~Block() {}
+   };
+
+   /** @return The cache, configured from preferences at first call. */
+   static rspfBlockCache* instance();
+
+   /** @brief Enables or disables handing out cached streams. */
+   void setEnabled(bool flag);
+   bool isEnabled() const;
+
+   /**
+    * @brief Sets the block size, rounded up to 4096.  Clears the cache.
+    */
+   void setBlockSize(rspf_uint32 size);
+   rspf_uint32 getBlockSize() const;
+
+   /** @brief Sets the memory limit, evicting if needed. */
+   void setMaxBytes(rspf_uint64 bytes);
+   rspf_uint64 getMaxBytes() const;
+
+   /** @brief Sets the most blocks read ahead on a sequential miss. */
+   void setReadAheadBlocks(rspf_uint32 blocks);
+   rspf_uint32 getReadAheadBlocks() const;
+
+   /** @brief Drops all blocks. */
+   void clear();
+
+   Statistics getStatistics() const;
+   void resetStatistics();
+
+   /** @brief Prints the settings and statistics. */
+   std::ostream& print(std::ostream& out) const;
+
+   /**
+    * @brief Registers an opened file.
+    * @return Key for getBlock, new if path, size or modification time
+    * changed.
+    */
+   rspf_uint64 getFileKey(const std::string& path, rspf_uint64 size, rspf_int64 mtime);
+
+   /**
+    * @brief Gets block index of a file, reading it and up to readAhead
+    * following blocks on a miss.
+    * @param fd Descriptor to read with on a miss.
+    * @param fileKey From getFileKey.
+    * @param fileSize Size of the file.
+    * @param index Block number.
+    * @param readAhead Blocks wanted after index; clamped to
+    * getReadAheadBlocks.
+    * @return The block, null on read error.  Its size is the block size,
+    * less at end of file.
+    */
+   rspfRefPtr<Block> getBlock(int fd, rspf_uint64 fileKey, rspf_uint64 fileSize,
+                               rspf_uint64 index, rspf_uint32 readAhead);
+
+   /** @brief Reads straight from the file into buf, counted as a bypass. */
+   rspf_int64 readDirect(int fd, rspf_uint64 offset, char* buf, rspf_uint64 size);
+
+   /** @brief Positional read, looping over short reads. */
+   static rspf_int64 readAt(int fd, rspf_uint64 offset, char* buf, rspf_uint64 size);
+
+protected:
+   rspfBlockCache();
+   virtual ~rspfBlockCache();
+
+   typedef std::pair<rspf_uint64, rspf_uint64> BlockKey; // file key, index
+   typedef std::list< std::pair<BlockKey, rspfRefPtr<Block> > > BlockList;
+
+   /** @brief Evicts until within the limit.  Caller holds m_mutex. */
+   void evict();
+
+   bool                                m_enabled;
+   rspf_uint32                         m_blockSize;
+   rspf_uint64                         m_maxBytes;
+   rspf_uint32                         m_readAheadBlocks;
+
+   /** Most recently used first. */
+   BlockList                           m_blocks;
+   std::map<BlockKey, BlockList::iterator> m_index;
+
+   struct FileInfo
+   {
+      rspf_uint64 m_key;
+      rspf_uint64 m_size;
+      rspf_int64  m_mtime;
+   };
+   std::map<std::string, FileInfo>     m_files;
+   rspf_uint64                         m_nextFileKey;
+
+   Statistics                          m_stats;
+   mutable OpenThreads::Mutex          m_mutex;
+
+private:
+   rspfBlockCache(const rspfBlockCache&);
+   const rspfBlockCache& operator=(const rspfBlockCache&);
+};
+
+/**
+ * @class rspfBlockCacheStreamBuf
+ *
+ * Read only, seekable streambuf over rspfBlockCache.  The get area is the
+ * current block, so sequential small reads are plain copies.
+ */
+class RSPF_DLL rspfBlockCacheStreamBuf : public std::streambuf
+{
+public:
+   rspfBlockCacheStreamBuf();
+   virtual ~rspfBlockCacheStreamBuf();
+
+   bool is_open() const;
+   rspfBlockCacheStreamBuf* open(const char* name);
+   rspfBlockCacheStreamBuf* close();
+
+protected:
+   virtual int_type underflow();
+   virtual std::streamsize xsgetn(char_type* s, std::streamsize n);
+   virtual std::streamsize showmanyc();
+   virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                            std::ios_base::openmode mode = std::ios_base::in |
+                            std::ios_base::out);
+   virtual pos_type seekpos(pos_type pos,
+                            std::ios_base::openmode mode = std::ios_base::in |
+                            std::ios_base::out);
+
+   /** @return File offset of the next character. */
+   rspf_uint64 position() const;
+
+   /** @brief Makes the block holding offset the get area. */
+   bool loadBlock(rspf_uint64 offset);
+
+   int                                  m_fd;
+   rspf_uint64                          m_fileKey;
+   rspf_uint64                          m_fileSize;
+   rspfRefPtr<rspfBlockCache::Block>   m_block;
+   rspf_uint64                          m_blockOffset; ///< File offset of eback().
+   rspf_uint64                          m_pos;         ///< Used with no get area.
+   rspf_uint64                          m_lastIndex;
+   rspf_uint32                          m_readAhead;
+
+private:
+   rspfBlockCacheStreamBuf(const rspfBlockCacheStreamBuf&);
+   const rspfBlockCacheStreamBuf& operator=(const rspfBlockCacheStreamBuf&);
+};
+
+/**
+ * @class rspfBlockCacheIStream
+ *
+ * Binary input file stream reading through rspfBlockCache.  Handed out by
+ * rspfStreamFactoryRegistry::createNewIFStream for binary read only opens
+ * when the cache is enabled.
+ */
+class RSPF_DLL rspfBlockCacheIStream : public rspfIFStream
+{
+public:
+   rspfBlockCacheIStream();
+   rspfBlockCacheIStream(const char* name,
+                          std::ios_base::openmode mode = std::ios_base::in|std::ios_base::binary);
+   virtual ~rspfBlockCacheIStream();
+
+   rspfBlockCacheStreamBuf* rdbuf();
+
+   virtual void open(const char* name,
+                     std::ios_base::openmode mode = std::ios_base::in|std::ios_base::binary);
+   virtual void close();
+   virtual bool is_open() const;
+
+protected:
+   rspfBlockCacheStreamBuf m_buf;
+};
+
+#endif /* #ifndef rspfBlockCacheStream_HEADER */
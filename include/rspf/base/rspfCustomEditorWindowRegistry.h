@@ -22,6 +22,8 @@ public:
    virtual ~rspfCustomEditorWindowRegistry();
    static rspfCustomEditorWindowRegistry* instance();
    bool registerFactory(rspfCustomEditorWindowFactoryBase* factory);
+   /** @return Number of factories registered. */
+   rspf_uint32 getNumberOfFactories()const;
 
    virtual rspfCustomEditorWindow* createCustomEditor(rspfObject* obj,
                                                        void* parent=NULL)const;
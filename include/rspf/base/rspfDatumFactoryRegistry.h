@@ -41,6 +41,8 @@ public:
     * @param factory Factory to register.
     */
    void registerFactory(rspfDatumFactoryInterface* factory);
+   /** @return Number of factories registered. */
+   rspf_uint32 getNumberOfFactories()const;
    
    /**
     * create method
@@ -18,8 +18,19 @@
 #include <rspf/base/rspfString.h>
 #include <rspf/base/rspfKeywordlist.h>
 
+/**
+ * Loads the plugins rspfInit deferred that register factories in the
+ * registry named registryKey.  Implemented by rspfSharedPluginRegistry.
+ */
+RSPF_DLL void rspfLoadDeferredPlugins(const char* registryKey);
+
 /**
  * The is a factory list interface that allows registries to be accessed in a common way.  
+ *
+ * A registry constructed with a plugin key gets the factories of deferred
+ * plugins loaded on first use: it calls loadDeferredPlugins() before walking
+ * its factory list.  The key is the name used in the plugin manifest (see
+ * rspfInit::initializePlugins).
  */
 template <class T, class NativeType>
 class rspfFactoryListInterface
@@ -29,7 +40,9 @@ class rspfFactoryListInterface
       typedef T FactoryType;
       typedef NativeType NativeReturnType;
       
-      rspfFactoryListInterface(){}
+      rspfFactoryListInterface(const char* pluginKey=0)
+         : m_pluginKey(pluginKey)
+      {}
       
       /**
        * This is for backward compatability and calls registerFactory for simple adds.
@@ -97,6 +110,16 @@ class rspfFactoryListInterface
          m_factoryList.clear();
       }
       
+      /**
+       * @return Number of registered factories.  Does not load deferred
+       * plugins.
+       */
+      rspf_uint32 getNumberOfFactories()const
+      {
+         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_factoryListMutex);
+         return (rspf_uint32)m_factoryList.size();
+      }
+      
       /**
        * Inserts the factory to the front of the list.
        */
@@ -169,6 +192,18 @@ class rspfFactoryListInterface
       NativeType* createNativeObjectFromRegistry(const rspfKeywordlist& kwl,
                                                  const char* prefix=0)const;
    protected:
+      /**
+       * Loads the deferred plugins that extend this registry.  Call before
+       * walking the factory list, never with m_factoryListMutex held.
+       */
+      void loadDeferredPlugins()const
+      {
+         if(m_pluginKey)
+         {
+            rspfLoadDeferredPlugins(m_pluginKey);
+         }
+      }
+      
       /**
        * Utility to find a factory in the list
        */
@@ -188,11 +223,13 @@ class rspfFactoryListInterface
       }
       mutable OpenThreads::Mutex m_factoryListMutex;
       FactoryListType m_factoryList;
+      const char* m_pluginKey;
    };
 
 template <class T, class NativeType>
 void rspfFactoryListInterface<T, NativeType>::getAllTypeNamesFromRegistry(std::vector<rspfString>& typeList)const
 {
+   loadDeferredPlugins();
    //OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_factoryListMutex);
    rspf_uint32 idx = 0;
    for(; idx<m_factoryList.size(); ++idx)
@@ -203,6 +240,7 @@ void rspfFactoryListInterface<T, NativeType>::getAllTypeNamesFromRegistry(std::v
 template <class T, class NativeType>
 rspfObject* rspfFactoryListInterface<T, NativeType>::createObjectFromRegistry(const rspfString& typeName)const
 {
+   loadDeferredPlugins();
    //OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_factoryListMutex);
    rspfObject* result = 0;
    rspf_uint32 idx = 0;
@@ -217,6 +255,7 @@ template <class T, class NativeType>
 rspfObject* rspfFactoryListInterface<T, NativeType>::createObjectFromRegistry(const rspfKeywordlist& kwl,
                                                                                 const char* prefix)const
 {
+   loadDeferredPlugins();
    // OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_factoryListMutex);
    rspfObject* result = 0;
    rspf_uint32 idx = 0;
@@ -148,6 +148,16 @@ public:
 
    virtual ~rspfIFStream();
 
+   /**
+    * open, close and is_open are not virtual in std::ifstream; they are here
+    * so streams handed out as rspfIFStream (gzip, block cache) that read
+    * through their own buffer are opened and closed through it.
+    */
+   virtual void open(const char* file,
+                     std::ios_base::openmode mode = std::ios_base::in);
+   virtual void close();
+   virtual bool is_open() const;
+
 };
 
 class RSPF_DLL rspfOFStream : public rspfStreamBase, public std::ofstream
@@ -17,6 +17,7 @@
 #include <rspf/base/rspfConstants.h>
 #include <rspf/base/rspfErrorCodes.h>
 #include <rspf/base/rspfString.h>
+#include <cstddef>
 #include <iosfwd>
 #include <map>
 #include <vector>
@@ -398,6 +399,14 @@ public:
    virtual bool parseStream(std::istream& is);
    virtual bool parseString(const std::string& inString);
 
+   /**
+    * @brief Parses size characters of buffer, same syntax as parseStream.
+    * Used for files (memory mapped) and strings; no stream or per character
+    * string appends involved.
+    * @return true if buffer was parsed, false on error.
+    */
+   bool parseBuffer(const char* buffer, std::size_t size);
+
    /*!
     *  Will return a list of keys that contain the string passed in.
     *  Later we will need to allow a user to specify regular expresion
@@ -443,6 +452,14 @@ public:
    rspf_uint32 getNumberOfSubstringKeys(
       const rspfString& regularExpression)const;
 
+   /**
+    * @brief Gets the range of keys starting with prefix, e.g. "image0.".
+    * Keys are sorted so this is a lookup rather than a scan of the list.
+    */
+   void getPrefixRange(const std::string& prefix,
+                       KeywordMap::const_iterator& first,
+                       KeywordMap::const_iterator& last)const;
+
    void addPrefixToAll(const rspfString& prefix);
    void addPrefixToKeysThatMatch(const rspfString& prefix,
                                  const rspfString& regularExpression);
@@ -489,6 +506,15 @@ protected:
    bool parseFile(const rspfFilename& file,
                   bool  ignoreBinaryChars = false);
 
+   /**
+    * Range of keys that can match regularExpression: the keys starting with
+    * its literal head when it is anchored with "^" (e.g. "^(image0.)"), all
+    * keys otherwise.
+    */
+   void getRegExpRange(const rspfString& regularExpression,
+                       KeywordMap::const_iterator& first,
+                       KeywordMap::const_iterator& last)const;
+
    bool isValidKeywordlistCharacter(rspf_uint8 c)const;
    void skipWhitespace(std::istream& in)const;
    KeywordlistParseState readComments(rspfString& sequence, std::istream& in)const;
@@ -0,0 +1,93 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfMemoryMappedFile.h
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  See description for class below.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#ifndef rspfMemoryMappedFile_HEADER
+#define rspfMemoryMappedFile_HEADER 1
+
+#include <rspf/base/rspfConstants.h>
+#include <rspf/base/rspfReferenced.h>
+#include <rspf/base/rspfFilename.h>
+
+/**
+ * @class rspfMemoryMappedFile
+ *
+ * Read only mapping of a whole file.  The mapping has no file position, so
+ * any number of threads can copy out of getData at once.
+ *
+ * Uses mmap/madvise, or CreateFileMapping/MapViewOfFile on Windows where
+ * the advice methods do nothing.
+ */
+class RSPF_DLL rspfMemoryMappedFile : public rspfReferenced
+{
+public:
+
+   enum Advice
+   {
+      NORMAL     = 0,
+      SEQUENTIAL = 1,
+      RANDOM     = 2
+   };
+
+   /** @brief Default constructor. */
+   rspfMemoryMappedFile();
+
+   /**
+    * @brief Maps file, closing any current mapping.
+    * @return false if the file could not be opened or mapped, e.g. it is
+    * empty or larger than the address space.
+    */
+   bool open(const rspfFilename& file);
+
+   /** @brief Unmaps. */
+   void close();
+
+   bool isOpen() const;
+
+   /** @return Start of the mapping, null if not open. */
+   const rspf_uint8* getData() const;
+
+   /** @return Mapped size in bytes. */
+   rspf_uint64 getSize() const;
+
+   /**
+    * @brief Copies size bytes at offset into buf.
+    * @return false if the range is outside the file.
+    */
+   bool read(rspf_uint64 offset, void* buf, rspf_uint64 size) const;
+
+   /** @brief Hints the access pattern for the whole mapping. */
+   void advise(Advice advice) const;
+
+   /**
+    * @brief Hints that a range will be read soon so the kernel starts
+    * paging it in.
+    */
+   void willNeed(rspf_uint64 offset, rspf_uint64 size) const;
+
+protected:
+   /** @brief Protected destructor.  Unmaps. */
+   virtual ~rspfMemoryMappedFile();
+
+   rspf_uint8*  m_data;
+   rspf_uint64  m_size;
+#if defined(_WIN32)
+   void*         m_fileHandle;
+   void*         m_mappingHandle;
+#endif
+
+private:
+   rspfMemoryMappedFile(const rspfMemoryMappedFile&);
+   const rspfMemoryMappedFile& operator=(const rspfMemoryMappedFile&);
+};
+
+#endif /* #ifndef rspfMemoryMappedFile_HEADER */
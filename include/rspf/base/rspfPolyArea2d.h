@@ -93,6 +93,13 @@ public:
    
 
    void add(const rspfPolyArea2d& rhs);
+
+   /**
+    * @brief Simplifies each polygon and hole (Douglas-Peucker), keeping
+    * every vertex farther than tolerance from the simplified ring.  Rings
+    * that collapse are dropped.
+    */
+   void simplify(double tolerance);
    
    bool getVisiblePolygons(vector<rspfPolygon>& polyList)const;
    bool getPolygonHoles(vector<rspfPolygon>& polyList, bool includeFalsePolygons=false)const;
@@ -115,6 +122,22 @@ protected:
                          const rspfPolyArea2d& rhs,
                          BOOL_OP operation)const;
    void clearPolygons();
+
+   /**
+    * @brief Union without the boolean engine when the result is known:
+    * disjoint bounds, one side inside the other convex side, or two
+    * rectangles making a rectangle.
+    * @return false if the engine is needed.
+    */
+   bool unionFastPath(const rspfPolyArea2d& rhs);
+
+   /** @brief Gets the outside polygons and holes, false edges skipped. */
+   void getRings(vector<rspfPolygon>& outside,
+                 vector<rspfPolygon>& holes)const;
+
+   /** @brief Replaces the area by outside minus holes. */
+   void setRings(const vector<rspfPolygon>& outside,
+                 const vector<rspfPolygon>& holes);
    
    mutable Bool_Engine* theEngine;
 };
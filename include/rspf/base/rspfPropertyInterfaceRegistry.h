@@ -39,6 +39,8 @@ public:
    
    bool addFactory( rspfPropertyInterfaceFactory* factory );
    bool registerFactory(rspfPropertyInterfaceFactory* factory);
+   /** @return Number of factories registered. */
+   rspf_uint32 getNumberOfFactories()const;
 protected:
    rspfPropertyInterfaceRegistry()
       :rspfObjectFactory()
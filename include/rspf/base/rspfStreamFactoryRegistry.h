@@ -23,6 +23,8 @@ public:
    virtual ~rspfStreamFactoryRegistry();
    
    void registerFactory(rspfStreamFactoryBase* factory);
+   /** @return Number of factories registered. */
+   rspf_uint32 getNumberOfFactories()const;
    
    virtual rspfRefPtr<rspfIFStream> createNewIFStream(
       const rspfFilename& file, std::ios_base::openmode openMode) const;
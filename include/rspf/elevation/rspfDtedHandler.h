@@ -25,6 +25,8 @@
 
 #include <rspf/base/rspfConstants.h>
 #include <rspf/base/rspfString.h>
+#include <rspf/base/rspfIoStream.h>
+#include <rspf/base/rspfRefPtr.h>
 #include <rspf/elevation/rspfElevCellHandler.h>
 #include <OpenThreads/Mutex>
 #include <rspf/support_data/rspfDtedVol.h>
@@ -174,7 +176,7 @@ protected:
    void readPostsFromFile(DtedHeight &postData, int offset);
 
    mutable OpenThreads::Mutex m_fileStrMutex;
-   mutable std::ifstream m_fileStr;
+   mutable rspfRefPtr<rspfIFStream> m_fileStr;
    
    rspf_int32      m_numLonLines;  // east-west dir
    rspf_int32      m_numLatPoints; // north-south
@@ -223,12 +225,12 @@ inline bool rspfDtedHandler::isOpen()const
    if(!m_memoryMap.empty()) return true;
    
    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_fileStrMutex);
-   return (m_fileStr.is_open());
+   return (m_fileStr.valid());
 }
 
 inline void rspfDtedHandler::close()
 {
-   m_fileStr.close();
+   m_fileStr = 0;
    m_memoryMap.clear();
 }
 
@@ -8,6 +8,7 @@ class RSPF_DLL rspfElevationDatabaseRegistry : public rspfFactoryListInterface<r
 {
 public:
    rspfElevationDatabaseRegistry()
+   :rspfFactoryListInterface<rspfElevationDatabaseFactoryBase, rspfElevationDatabase>("elevation_database")
    {
       m_instance = 0;
    }
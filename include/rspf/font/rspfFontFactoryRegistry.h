@@ -12,6 +12,8 @@ public:
    static rspfFontFactoryRegistry* instance();
    bool registerFactory(rspfFontFactoryBase* factory);
    void unregisterFactory(rspfFontFactoryBase* factory);
+   /** @return Number of factories registered. */
+   rspf_uint32 getNumberOfFactories()const;
    bool findFactory(rspfFontFactoryBase* factory)const;
    
    rspfFont* createFont(const rspfFontInformation& information)const;
@@ -16,6 +16,7 @@
 #include <rspf/matrix/newmat.h>
 
 class rspfImageData;
+class rspfImageToPlaneNormalFilter;
 
 class rspfImageSourceConnection;
 
@@ -94,6 +95,12 @@ class rspfImageSourceConnection;
  *
  * 3) If no color source (2nd input layer) is present the r,g,b values will be
  * used.  The method setRgbColorSource can be used to control this.
+ *
+ * 4) If input 0 is an enabled rspfImageToPlaneNormalFilter its input (the
+ * elevation) is read directly and gradients, normals and shading are computed
+ * in one float32 pass writing 8-bit output.  This avoids the 3-band float64
+ * normal tile.  Set fused_kernel: false (setFusedKernelFlag) to go through
+ * the normal filter.  Any other input 0 must output normals as before.
  * 
  * </pre>
  * 
@@ -232,6 +239,16 @@ public:
     * @param b blue
     */
    void getRgbColorSource(rspf_uint8& r, rspf_uint8& g, rspf_uint8& b) const;
+
+   /**
+    * @brief Enables/disables the single pass kernel that bypasses an
+    * rspfImageToPlaneNormalFilter on input 0.  Default is enabled.
+    * @param flag true to enable, false to use the normal filter output.
+    */
+   void setFusedKernelFlag(bool flag);
+
+   /** @return true if the single pass kernel is enabled. */
+   bool getFusedKernelFlag() const;
    
 protected:
    virtual ~rspfBumpShadeTileSource();
@@ -274,6 +291,51 @@ protected:
                      rspf_uint8 dr,
                      rspf_uint8 dg,
                      rspf_uint8 db)const;
+
+   /**
+    * @return Input 0 as an rspfImageToPlaneNormalFilter if the fused kernel is
+    * enabled and the filter can be bypassed; else, null.
+    */
+   rspfImageToPlaneNormalFilter* getFusableNormalFilter();
+
+   /**
+    * @brief Single pass getTile.  Reads the elevation input of normalFilter
+    * and shades directly into m_tile.
+    */
+   rspfRefPtr<rspfImageData> getFusedTile(rspfImageToPlaneNormalFilter* normalFilter,
+                                           rspfImageSource* colorSource,
+                                           const rspfIrect& tileRect,
+                                           rspf_uint32 resLevel);
+
+   /**
+    * @brief Computes the shade factor(light dot unit normal) for each line of
+    * m_tile from demTile(tile rect plus a one pixel border) and applies it.
+    */
+   template <class T> void computeFusedShade(T dummy,
+                                             const rspfImageData* demTile,
+                                             const rspfImageData* colorTile,
+                                             rspf_float32 xScale,
+                                             rspf_float32 yScale);
+
+   /**
+    * @brief Writes one line of m_tile from shade factors and the diffuse color.
+    * @param shade Shade factor per sample.
+    * @param line Zero based line in m_tile.
+    * @param colorTile 8-bit color tile or null for the r,g,b values.
+    */
+   void applyShade(const rspf_float32* shade,
+                   rspf_uint32 line,
+                   const rspfImageData* colorTile);
+
+   /** @return shade*color rounded and clamped to 1 to 255. */
+   inline rspf_uint8 shadeToByte(rspf_float32 shade, rspf_uint8 color) const
+   {
+      rspf_float32 v = shade * color + 0.5f;
+      return ( v < 1.0f ) ? 1 : ( ( v >= 255.0f ) ? 255 : static_cast<rspf_uint8>(v) );
+   }
+
+   /** Enables single pass kernel when input 0 is an rspfImageToPlaneNormalFilter. */
+   bool m_fusedKernelFlag;
    
 TYPE_DATA
 };
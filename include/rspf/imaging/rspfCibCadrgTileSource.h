@@ -14,8 +14,8 @@
 #define rspfCibCadrgTileSource_HEADER 1
 #include <rspf/imaging/rspfImageHandler.h>
 #include <rspf/support_data/rspfRpfFrameEntry.h>
+#include <rspf/support_data/rspfRpfToc.h>
 
-class rspfRpfToc;
 class rspfRpfTocEntry;
 class rspfRpfFrame;
 
@@ -472,11 +472,9 @@ protected:
    vector<rspfFrameEntryData> getIntersectingEntries(const rspfIrect& rect);
 
    /**
-    * This is a wrapper for the fill cib and fill cadrg.  It takes the frames
-    * involved that were found in the getIntersectingEntries and call the
-    * appropriate fill cib or fill cadrg on each frame entry data.  It will
-    * loop through making sure that the frame file exists before calling
-    * the associated fill routines.
+    * This is a wrapper for fillSubTile.  It takes the frames
+    * involved that were found in the getIntersectingEntries and calls
+    * fillSubTile on each frame entry data.
     *
     * @param tileRect Region to fill.
     * @param framesInvolved All intersecting frames used to render the region.
@@ -486,33 +484,22 @@ protected:
                  rspfImageData* tile);
 
    /**
-    * Will uncompress the CIB file using a VQ decompression algorithm.
+    * Will render the part of tileRect covered by one frame.  Decoded(VQ
+    * uncompressed) subframes come from the shared rspfRpfFrameCache.  Any
+    * not cached are decoded in parallel and added to the cache.
     *
-    * @param aFrame Frame that overlaps the requested tile rect.
     * @param tileRect The region requested to render.
     * @param frameEntryData The frame entry data.
+    * @param tile The tile to fill.
     */
-   void fillSubTileCib(const rspfRpfFrame& aFrame,
-                       const rspfIrect& tileRect,
-                       const rspfFrameEntryData& frameEntryData,
-                       rspfImageData* tile);
-   
-   /**
-    * Will uncompress the CADRG file using a VQ decompression algorithm.
-    *
-    * @param aFrame Frame that overlaps the requested tile rect.
-    * @param tileRect The region requested to render.
-    * @param frameEntryData The frame entry data.
-    */
-   void fillSubTileCadrg(const rspfRpfFrame& aFrame,
-                         const rspfIrect& tileRect,
-                         const rspfFrameEntryData& frameEntryData,
-                         rspfImageData* tile);
-   
+   void fillSubTile(const rspfIrect& tileRect,
+                    const rspfFrameEntryData& frameEntryData,
+                    rspfImageData* tile);
+
    /**
-    * Will allocate an internal buffer for the given product.  If the product is
-    * a CIB then it is a single band RSPF_UCHAR buffer and if its a CADRG it
-    * is a 3 band RSPF_UCHAR buffer.
+    * Will allocate the output tile for the given product.  If the product is
+    * a CIB then it is a single band RSPF_UCHAR tile and if its a CADRG it
+    * is a 3 band RSPF_UCHAR tile.
     */
    void allocateForProduct();
    
@@ -530,16 +517,6 @@ protected:
 
    void populateLut();
 
-   /**
-    * This is for storage of a single compressed buffer.
-    */
-   unsigned char*               theCompressedBuffer;
-
-   /**
-    * This is used as a buffer to uncompress the data to
-    */
-   unsigned char*               theUncompressedBuffer;
-   
    /**
     * This will be computed based on the frames organized within
     * the directory.  The CibCadrg have fixed size frames of 1536x1536
@@ -560,10 +537,11 @@ protected:
    rspfRefPtr<rspfImageData>  theTile;
 
    /**
-    * Will own a table of contents.  This describes all entries within
-    * the CIB/CADRG.
+    * Table of contents.  This describes all entries within
+    * the CIB/CADRG.  Shared with other sources of the same a.toc through
+    * rspfRpfFrameCache; do not modify.
     */
-   rspfRpfToc*                 theTableOfContents;
+   rspfRefPtr<rspfRpfToc>      theTableOfContents;
 
    /**
     * This is the actual frame file to render.  This should be
@@ -592,6 +570,9 @@ protected:
    
    mutable rspfRpfFrame*       theWorkFrame;
 
+   /** File theWorkFrame was parsed from; empty if none. */
+   rspfFilename                theWorkFrameFile;
+
    /**
     * If true during the call to open(), the RPF file is opened even 
     * if all the frame files are missing. By default this is set to false.
@@ -0,0 +1,188 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfConvolutionEngine.h
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  See description for class below.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#ifndef rspfConvolutionEngine_HEADER
+#define rspfConvolutionEngine_HEADER 1
+
+#include <rspf/base/rspfConstants.h>
+#include <rspf/matrix/newmat.h>
+
+#include <vector>
+
+/**
+ * @class rspfConvolutionEngine
+ *
+ * Convolves null free bands with a fixed kernel.  The kernel is applied
+ * top left anchored(correlation), the same as
+ * rspfDiscreteConvolutionKernel::convolveSubImage.
+ *
+ * The method is picked on setKernel:
+ *
+ * SEPARABLE: The kernel is rank one(gaussian, box...).  Done as a
+ * horizontal then vertical 1D pass; width + height multiplies per pixel
+ * instead of width * height.
+ *
+ * FFT: Kernel has at least getFftThreshold non zero taps.  Overlap-save:
+ * the input patch is transformed(NEWMAT::FFT2, padded to a 2/3/5 smooth
+ * size), multiplied by the cached kernel spectrum and transformed back.
+ *
+ * DIRECT: Everything else.  Zero taps are skipped and each tap is applied
+ * to a whole output row so the inner loop is a simple multiply add the
+ * compiler can vectorize.
+ *
+ * Not thread safe; holds work buffers.  Use one per thread.
+ */
+class RSPF_DLL rspfConvolutionEngine
+{
+public:
+
+   enum Method
+   {
+      DIRECT    = 0,
+      SEPARABLE = 1,
+      FFT       = 2
+   };
+
+   /** Default for getFftThreshold. */
+   static const rspf_uint32 DEFAULT_FFT_THRESHOLD;
+
+   /** @brief default constructor */
+   rspfConvolutionEngine();
+
+   /**
+    * @brief Sets the kernel and picks the method.
+    * @param kernel Kernel, rows by columns.
+    * @param doWeightedAverage If true results are divided by the kernel sum
+    * when the sum is positive; this is what rspfDiscreteConvolutionKernel
+    * gives for null free input.
+    */
+   void setKernel(const NEWMAT::Matrix& kernel, bool doWeightedAverage);
+
+   /** @return Method picked for the kernel. */
+   Method getMethod() const;
+
+   /** @return true if the kernel is rank one. */
+   bool isSeparable() const;
+
+   /** @return Kernel width. */
+   rspf_uint32 getWidth() const;
+
+   /** @return Kernel height. */
+   rspf_uint32 getHeight() const;
+
+   /**
+    * @brief Sets the number of non zero taps at which the FFT method is used
+    * for non separable kernels.  Zero disables FFT.
+    */
+   void setFftThreshold(rspf_uint32 taps);
+
+   /** @return FFT threshold. */
+   rspf_uint32 getFftThreshold() const;
+
+   /**
+    * @brief Convolves one band.
+    *
+    * @param in First input pixel; the one under the kernel's top left
+    * corner for the first output pixel.  Must cover
+    * (outWidth + width - 1) x (outHeight + height - 1) pixels.  Must not
+    * contain nulls.
+    * @param inWidth Input line stride in pixels.
+    * @param out Output buffer, outWidth x outHeight.
+    * @param outWidth Output width.
+    * @param outHeight Output height.
+    * @param minPix Results are clamped to minPix.
+    * @param maxPix Results are clamped to maxPix.
+    */
+   void convolve(const rspf_uint8* in, rspf_uint32 inWidth,
+                 rspf_uint8* out, rspf_uint32 outWidth, rspf_uint32 outHeight,
+                 rspf_float64 minPix, rspf_float64 maxPix);
+   void convolve(const rspf_uint16* in, rspf_uint32 inWidth,
+                 rspf_uint16* out, rspf_uint32 outWidth, rspf_uint32 outHeight,
+                 rspf_float64 minPix, rspf_float64 maxPix);
+   void convolve(const rspf_sint16* in, rspf_uint32 inWidth,
+                 rspf_sint16* out, rspf_uint32 outWidth, rspf_uint32 outHeight,
+                 rspf_float64 minPix, rspf_float64 maxPix);
+   void convolve(const rspf_float32* in, rspf_uint32 inWidth,
+                 rspf_float32* out, rspf_uint32 outWidth, rspf_uint32 outHeight,
+                 rspf_float64 minPix, rspf_float64 maxPix);
+   void convolve(const rspf_float64* in, rspf_uint32 inWidth,
+                 rspf_float64* out, rspf_uint32 outWidth, rspf_uint32 outHeight,
+                 rspf_float64 minPix, rspf_float64 maxPix);
+
+private:
+
+   /** One non zero kernel coefficient. */
+   struct Tap
+   {
+      rspf_uint32  m_row;
+      rspf_uint32  m_col;
+      rspf_float64 m_weight;
+   };
+
+   /** @brief Picks m_method from the kernel. */
+   void selectMethod();
+
+   template <class T>
+   void convolveBand(const T* in, rspf_uint32 inWidth,
+                     T* out, rspf_uint32 outWidth, rspf_uint32 outHeight,
+                     rspf_float64 minPix, rspf_float64 maxPix);
+
+   template <class T>
+   void convolveDirect(const T* in, rspf_uint32 inWidth,
+                       T* out, rspf_uint32 outWidth, rspf_uint32 outHeight,
+                       rspf_float64 minPix, rspf_float64 maxPix);
+
+   template <class T>
+   void convolveSeparable(const T* in, rspf_uint32 inWidth,
+                          T* out, rspf_uint32 outWidth, rspf_uint32 outHeight,
+                          rspf_float64 minPix, rspf_float64 maxPix);
+
+   template <class T>
+   void convolveFft(const T* in, rspf_uint32 inWidth,
+                    T* out, rspf_uint32 outWidth, rspf_uint32 outHeight,
+                    rspf_float64 minPix, rspf_float64 maxPix);
+
+   /** @brief Scales, clamps and stores one row of sums. */
+   template <class T>
+   void storeRow(const rspf_float64* sums, T* out, rspf_uint32 count,
+                 rspf_float64 minPix, rspf_float64 maxPix) const;
+
+   /** @brief Computes the kernel spectrum for a transform size. */
+   void buildKernelSpectrum(rspf_uint32 rows, rspf_uint32 cols);
+
+   /** @return Smallest size >= n with only 2, 3 and 5 as factors. */
+   static rspf_uint32 getFftSize(rspf_uint32 n);
+
+   rspf_uint32               m_width;
+   rspf_uint32               m_height;
+   std::vector<rspf_float64> m_kernel;     // row major
+   std::vector<Tap>          m_taps;
+   std::vector<rspf_float64> m_rowKernel;  // m_width
+   std::vector<rspf_float64> m_colKernel;  // m_height
+   bool                      m_separable;
+   rspf_float64              m_scale;
+   rspf_uint32               m_fftThreshold;
+   Method                    m_method;
+
+   // FFT kernel spectrum for m_fftRows x m_fftCols.
+   rspf_uint32               m_fftRows;
+   rspf_uint32               m_fftCols;
+   NEWMAT::Matrix            m_kernelRe;
+   NEWMAT::Matrix            m_kernelIm;
+
+   // Work buffers.
+   std::vector<rspf_float64> m_work;
+   std::vector<rspf_float64> m_sums;
+};
+
+#endif /* #ifndef rspfConvolutionEngine_HEADER */
@@ -20,6 +20,7 @@ using namespace std;
 
 class rspfTilePatch;
 class rspfDiscreteConvolutionKernel;
+class rspfConvolutionEngine;
 
 class rspfConvolutionSource : public rspfImageSourceFilter
 {
@@ -57,13 +58,21 @@ protected:
    rspf_int32                 theMaxKernelHeight;
    
    std::vector<rspfDiscreteConvolutionKernel* > theConvolutionKernelList;
+
+   /**
+    * One per kernel.  Used for full(null free) input tiles; picks separable,
+    * FFT or direct convolution for the kernel.
+    */
+   std::vector<rspfConvolutionEngine* > theConvolutionEngineList;
+   
    virtual void setKernelInformation();
    virtual void deleteConvolutionList();
 
    template<class T>
    void convolve(T dummyVariable,
                  rspfRefPtr<rspfImageData> inputTile,
-                 rspfDiscreteConvolutionKernel* kernel);
+                 rspfDiscreteConvolutionKernel* kernel,
+                 rspfConvolutionEngine* engine);
    
 
 TYPE_DATA
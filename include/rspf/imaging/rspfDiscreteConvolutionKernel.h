@@ -125,6 +125,10 @@ public:
       {
          return *theKernel;
       }
+   bool getComputeWeightedAverageFlag()const
+      {
+         return theComputeWeightedAverageFlag;
+      }
 protected:
    NEWMAT::Matrix  *theKernel;
    long theWidth;
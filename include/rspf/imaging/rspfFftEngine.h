@@ -0,0 +1,237 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfFftEngine.h
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  See description for class below.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#ifndef rspfFftEngine_HEADER
+#define rspfFftEngine_HEADER 1
+
+#include <rspf/base/rspfConstants.h>
+#include <rspf/base/rspfReferenced.h>
+#include <rspf/base/rspfRefPtr.h>
+#include <rspf/base/rspfString.h>
+#include <rspf/parallel/rspfJobMultiThreadQueue.h>
+#include <OpenThreads/Mutex>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @class rspfFftEngine
+ *
+ * Process wide 2D real to complex FFT service.
+ *
+ * Layout is the one used by FFTW's r2c/c2r: the real side is rows x cols,
+ * row major; the complex side is rows x (cols/2 + 1) interleaved
+ * (real, imaginary) pairs, the other half of the spectrum being implied by
+ * hermitian symmetry.  Forward uses exp(-2 pi i jk/n).  Neither direction is
+ * normalized; forward then inverse scales by rows * cols.
+ *
+ * Transforms are done by a Plan obtained with getPlan.  Plans are created by
+ * the current Backend once per size and cached here, so callers can ask for
+ * one per tile without paying for twiddle tables or planning each time.
+ *
+ * The built in backend("builtin") is a mixed radix(4, 2, generic odd)
+ * implementation with no external dependencies.  Plugins may register a
+ * faster one, e.g. the registration plugin registers "fftw".  The last
+ * registered backend becomes current unless the preference "fft_backend"
+ * names another.
+ *
+ * All methods are thread safe.  Plan execute methods are const and may be
+ * called from several threads at once.
+ */
+class RSPF_DLL rspfFftEngine
+{
+public:
+
+   /** @brief Transform plan for one size. */
+   class RSPF_DLL Plan : public rspfReferenced
+   {
+   public:
+
+      /**
+       * @brief Constructor.
+       * @param rows Rows on the real side.
+       * @param cols Columns on the real side.
+       */
+      Plan(rspf_uint32 rows, rspf_uint32 cols);
+
+      /** @return Rows. */
+      rspf_uint32 getRows() const;
+
+      /** @return Columns on the real side. */
+      rspf_uint32 getCols() const;
+
+      /** @return Columns on the complex side, cols/2 + 1. */
+      rspf_uint32 getComplexCols() const;
+
+      /** @return Reals on the real side, rows * cols. */
+      rspf_uint32 getRealSize() const;
+
+      /** @return Reals on the complex side, rows * (cols/2 + 1) * 2. */
+      rspf_uint32 getComplexSize() const;
+
+      /**
+       * @brief Real to complex.
+       * @param in getRealSize() reals.  Not modified.
+       * @param out getComplexSize() reals.  Must not overlap in.
+       */
+      virtual void forward(const rspf_float64* in, rspf_float64* out) const = 0;
+      virtual void forward(const rspf_float32* in, rspf_float32* out) const = 0;
+
+      /**
+       * @brief Complex to real, not normalized.
+       * @param in getComplexSize() reals.  Overwritten.
+       * @param out getRealSize() reals.  Must not overlap in.
+       */
+      virtual void inverse(rspf_float64* in, rspf_float64* out) const = 0;
+      virtual void inverse(rspf_float32* in, rspf_float32* out) const = 0;
+
+   protected:
+
+      /** @brief Protected destructor. */
+      virtual ~Plan();
+
+      rspf_uint32 m_rows;
+      rspf_uint32 m_cols;
+   };
+
+   /** @brief Plan factory. */
+   class RSPF_DLL Backend : public rspfReferenced
+   {
+   public:
+
+      /** @return Name used by setBackend and the "fft_backend" preference. */
+      virtual rspfString getName() const = 0;
+
+      /**
+       * @brief Creates a plan.  Called with the engine locked so
+       * implementations need not guard non reentrant planners.
+       * @return New plan or null on error.
+       */
+      virtual Plan* createPlan(rspf_uint32 rows, rspf_uint32 cols) = 0;
+
+      /** @return Saved planner state, e.g. FFTW wisdom.  Default empty. */
+      virtual std::string exportWisdom() const;
+
+      /**
+       * @brief Restores planner state from exportWisdom.  Default does
+       * nothing.
+       * @return true on success.
+       */
+      virtual bool importWisdom(const std::string& wisdom);
+
+   protected:
+
+      /** @brief Protected destructor. */
+      virtual ~Backend();
+   };
+
+   /** @return The instance of this class. */
+   static rspfFftEngine* instance();
+
+   /**
+    * @brief Adds a backend and makes it current unless the "fft_backend"
+    * preference names a different one.
+    */
+   void registerBackend(Backend* backend);
+
+   /**
+    * @brief Removes a backend.  If current, the previous one registered
+    * becomes current and the plan cache is flushed.  Must be called before
+    * the code of a plugin backend is unloaded.
+    */
+   void unregisterBackend(Backend* backend);
+
+   /**
+    * @brief Makes a registered backend current, flushing the plan cache.
+    * @return true if found.
+    */
+   bool setBackend(const rspfString& name);
+
+   /** @return Name of the current backend. */
+   rspfString getBackendName() const;
+
+   /** @param names Initialized to the names of the registered backends. */
+   void getBackendNames(std::vector<rspfString>& names) const;
+
+   /**
+    * @brief Gets the cached plan for a size, creating it if needed.
+    * @return Plan or null if rows or cols is zero or the backend failed.
+    */
+   rspfRefPtr<Plan> getPlan(rspf_uint32 rows, rspf_uint32 cols);
+
+   /**
+    * @brief Batch transforms, e.g. one per band.  Run in parallel on a
+    * thread pool(rspf::getNumberOfThreads) when count is more than one.
+    * @param plan Plan to use.
+    * @param count Number of transforms.
+    * @param in count input buffers.
+    * @param out count output buffers.
+    */
+   void forward(const Plan* plan, rspf_uint32 count,
+                const rspf_float64* const* in, rspf_float64* const* out);
+   void forward(const Plan* plan, rspf_uint32 count,
+                const rspf_float32* const* in, rspf_float32* const* out);
+   void inverse(const Plan* plan, rspf_uint32 count,
+                rspf_float64* const* in, rspf_float64* const* out);
+   void inverse(const Plan* plan, rspf_uint32 count,
+                rspf_float32* const* in, rspf_float32* const* out);
+
+   /** @return Current backend's exportWisdom. */
+   std::string exportWisdom() const;
+
+   /** @return Current backend's importWisdom. */
+   bool importWisdom(const std::string& wisdom);
+
+   /** @brief Sets the number of batch threads.  Zero = number of cores. */
+   void setNumberOfThreads(rspf_uint32 nThreads);
+
+   /** @brief Drops all cached plans. */
+   void flush();
+
+protected:
+
+   /** @brief Protected constructor.  Use instance(). */
+   rspfFftEngine();
+
+   /** @brief Protected destructor. */
+   ~rspfFftEngine();
+
+   /** @brief Runs a batch on the thread pool. */
+   template <class T>
+   void runBatch(const Plan* plan, rspf_uint32 count, bool inverse,
+                 T* const* in, T* const* out);
+
+private:
+
+   /** Hide from use. */
+   rspfFftEngine(const rspfFftEngine&);
+   const rspfFftEngine& operator=(const rspfFftEngine&);
+
+   typedef std::pair<rspf_uint32, rspf_uint32> PlanKey;
+
+   static rspfFftEngine* m_instance;
+
+   std::vector< rspfRefPtr<Backend> >         m_backends;
+   rspfRefPtr<Backend>                        m_backend;
+   rspfString                                 m_preferredBackend;
+   std::map< PlanKey, rspfRefPtr<Plan> >      m_planMap;
+
+   rspfRefPtr<rspfJobMultiThreadQueue>        m_jobQueue;
+   rspf_uint32                                m_numberOfThreads;
+
+   mutable OpenThreads::Mutex                 m_mutex;
+};
+
+#endif /* #ifndef rspfFftEngine_HEADER */
@@ -12,6 +12,8 @@
 #ifndef rspfFftFilter_HEADER
 #define rspfFftFilter_HEADER
 #include <rspf/imaging/rspfImageSourceFilter.h>
+#include <rspf/imaging/rspfFftEngine.h>
+#include <vector>
 
 class rspfScalarRemapper;
 
@@ -68,17 +70,33 @@ protected:
                rspfRefPtr<rspfImageData>& input,
                rspfRefPtr<rspfImageData>& output);
 
+   /**
+    * Copies a band into the real transform buffer, nulls to zero.
+    */
    template <class T>
-   void fillMatrixForward(T *realPart,
-                          T nullPix,
-                          NEWMAT::Matrix& real,
-                          NEWMAT::Matrix& img)const;
+   void fillForward(const T* band,
+                    T nullPix,
+                    rspf_float64* real,
+                    rspf_uint32 size)const;
+
+   /**
+    * Copies a real/imaginary band pair into the half spectrum transform
+    * buffer.  The pair is made hermitian first so the complex to real
+    * inverse gives the real part of the full complex inverse.
+    */
    template <class T>
-   void fillMatrixInverse(T *realPart,
-                          T *imgPart,
-                          NEWMAT::Matrix& real,
-                          NEWMAT::Matrix& img)const;
+   void fillInverse(const T* realPart,
+                    const T* imgPart,
+                    rspf_float64* spectrum,
+                    rspf_uint32 w,
+                    rspf_uint32 h)const;
+
+   /** Plan for the last tile size. */
+   rspfRefPtr<rspfFftEngine::Plan> thePlan;
 
+   /** Per band transform buffers reused across tiles. */
+   std::vector<rspf_float64> theRealBuffer;
+   std::vector<rspf_float64> theComplexBuffer;
 
 TYPE_DATA
 };
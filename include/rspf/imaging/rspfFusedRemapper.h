@@ -0,0 +1,183 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfFusedRemapper.h
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  See description for class below.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#ifndef rspfFusedRemapper_HEADER
+#define rspfFusedRemapper_HEADER 1
+
+#include <rspf/base/rspfConstants.h>
+#include <rspf/base/rspfConnectableObject.h>
+#include <rspf/base/rspfRefPtr.h>
+#include <rspf/imaging/rspfImageData.h>
+#include <rspf/imaging/rspfImageSource.h>
+
+#include <vector>
+
+class rspfImageChain;
+class rspfImageSourceFilter;
+
+/**
+ * @class rspfFusedRemapper
+ *
+ * Replaces a run of adjacent point(per pixel, per band) filters in an
+ * rspfImageChain with one table lookup per pixel.
+ *
+ * Point filters are rspfScalarRemapper, rspfHistogramRemapper,
+ * rspfTableRemapper, rspfGammaRemapper, rspfBrightnessContrastSource
+ * (unless it is mixing three bands), a pass through rspfBandSelector, and
+ * any of the above when disabled.  See isPointFilter.
+ *
+ * On initialize the run is cloned(saveState/loadState), fed one probe tile
+ * holding every possible input value, and the output recorded into a table
+ * per band.  This is only done for 8 and 16 bit unsigned input.
+ *
+ * The object is not connected to anything so the chain's saved state is
+ * unchanged.  The chain hands it to the filter downstream of the run with
+ * rspfImageSourceFilter::setInputConnection, or calls it directly when the
+ * run is at the output end of the chain.  All queries are forwarded to the
+ * head of the run.  getTile checks that the chain still holds the run and
+ * the enable flags are unchanged; if not it falls back to the run's own
+ * getTile.
+ *
+ * Tables are rebuilt on the next getTile when a filter's
+ * rspfImageSourceFilter::getStateCounter changed, i.e. a setter changed its
+ * output.
+ */
+class RSPF_DLL rspfFusedRemapper : public rspfImageSource
+{
+public:
+
+   /**
+    * @brief Constructor.
+    * @param chain Chain holding the run.  Not owned.
+    */
+   rspfFusedRemapper(rspfImageChain* chain);
+
+   /**
+    * @brief Builds the tables.
+    *
+    * @param index Index of the run head(output side) in the chain list.
+    * @param count Number of filters in the run.  The input of the run is at
+    * chain list index + count.
+    * @param consumer Filter whose input is the run head, or null if the run
+    * is at the output end of the chain.
+    * @return true on success; false if the run cannot be fused.
+    */
+   bool initialize(rspf_uint32 index,
+                   rspf_uint32 count,
+                   rspfImageSourceFilter* consumer);
+
+   /** @return Filter downstream of the run or null. */
+   rspfImageSourceFilter* getConsumer() const;
+
+   /** @return Number of filters fused. */
+   rspf_uint32 getNumberOfFusedFilters() const;
+
+   /** @return true if the chain still holds the run as it was initialized. */
+   bool isValid() const;
+
+   /**
+    * @param source Source to test.
+    * @return true if source is a point filter that can be part of a run.
+    */
+   static bool isPointFilter(const rspfConnectableObject* source);
+
+   /**
+    * @brief Gets the fused tile.
+    *
+    * Falls back to the run head if no longer valid, or if the input tile is
+    * null, empty or not of the type the tables were built for.
+    */
+   virtual rspfRefPtr<rspfImageData> getTile(const rspfIrect& tileRect,
+                                             rspf_uint32 resLevel=0);
+
+   // Forwarded to the run head.
+   virtual void getDecimationFactor(rspf_uint32 resLevel, rspfDpt& result) const;
+   virtual void getDecimationFactors(std::vector<rspfDpt>& decimations) const;
+   virtual rspf_uint32 getNumberOfDecimationLevels() const;
+   virtual rspf_uint32 getNumberOfInputBands() const;
+   virtual rspf_uint32 getNumberOfOutputBands() const;
+   virtual void getOutputBandList(std::vector<rspf_uint32>& bandList) const;
+   virtual rspfScalarType getOutputScalarType() const;
+   virtual rspf_uint32 getTileWidth() const;
+   virtual rspf_uint32 getTileHeight() const;
+   virtual double getNullPixelValue(rspf_uint32 band=0) const;
+   virtual double getMinPixelValue(rspf_uint32 band=0) const;
+   virtual double getMaxPixelValue(rspf_uint32 band=0) const;
+   virtual rspfIrect getBoundingRect(rspf_uint32 resLevel=0) const;
+   virtual void getValidImageVertices(std::vector<rspfIpt>& validVertices,
+                                      rspfVertexOrdering ordering=RSPF_CLOCKWISE_ORDER,
+                                      rspf_uint32 resLevel=0) const;
+   virtual rspfRefPtr<rspfImageGeometry> getImageGeometry();
+   virtual bool isIndexedData() const;
+
+   /** @brief Satisfies pure virtual.  Does nothing; see initialize(...). */
+   virtual void initialize();
+
+   /** @brief Satisfies pure virtual.  Never connected; returns false. */
+   virtual bool canConnectMyInputTo(rspf_int32 inputIndex,
+                                    const rspfConnectableObject* object) const;
+
+protected:
+
+   /** @brief Protected destructor. */
+   virtual ~rspfFusedRemapper();
+
+   /**
+    * @brief Runs the probe tile through clones of the run.
+    * @return true if the tables were built.
+    */
+   bool buildTables();
+
+   /** @return true if no filter in the run changed since the tables were built. */
+   bool isCurrent() const;
+
+   /** @return true if every filter of the run is still a point filter. */
+   bool isPointFilterRun() const;
+
+   /** @brief Stores the run's state counters. */
+   void recordStateCounters();
+
+   /** @brief Applies tables, output type dispatch. */
+   template <class InType>
+   void remap(InType dummy, const rspfImageData* inputTile);
+
+   /** @brief Applies tables. */
+   template <class InType, class OutType>
+   void remap(InType dummyIn, OutType dummyOut, const rspfImageData* inputTile);
+
+   /** @brief Copies probe results into the typed tables. */
+   template <class OutType>
+   void fillTables(OutType dummy, const rspfImageData* probeResult);
+
+   rspfImageChain*             m_chain;
+   rspfImageSourceFilter*      m_consumer;
+   rspf_uint32                 m_index;
+   rspf_uint32                 m_chainSize;
+   std::vector<rspfImageSource*> m_run;
+   std::vector<bool>           m_enabled;
+   std::vector<rspf_uint32>    m_stateCounters;
+   rspfImageSource*            m_input;
+   rspfScalarType              m_inputScalarType;
+   rspfScalarType              m_outputScalarType;
+   rspf_uint32                 m_bands;
+   rspf_uint32                 m_tableSize;
+
+   /** One table per band of m_tableSize output pixels, raw bytes. */
+   std::vector< std::vector<rspf_uint8> > m_tables;
+
+   rspfRefPtr<rspfImageData>   m_tile;
+
+TYPE_DATA
+};
+
+#endif /* #ifndef rspfFusedRemapper_HEADER */
@@ -20,6 +20,7 @@
 
 #include <rspf/imaging/rspfImageHandler.h>
 #include <rspf/base/rspfIoStream.h>
+#include <rspf/base/rspfMemoryMappedFile.h>
 #include <rspf/imaging/rspfGeneralRasterInfo.h>
 #include <vector>
   
@@ -169,6 +170,27 @@ public:
    /** @brief Initializes bandList to the zero based order of output bands. */
    virtual void getOutputBandList(std::vector<rspf_uint32>& bandList) const;
 
+   /**
+    * @brief Sets memory mapped reading, taking effect at the next open.
+    *
+    * When on, the image files are mapped read only and lines are copied out
+    * of the mapping instead of seekg/read on the file streams.  BSQ tiles
+    * are copied straight from the mapping into the caller's tile, skipping
+    * the intermediate buffer, and touch no handler state, so several
+    * threads may call getTile(rspfImageData*) at once.  Falls back to the
+    * streams if a file cannot be mapped.
+    *
+    * Default is the "general_raster.memory_map" preference, false if not
+    * set; keyword "memory_map" in the state.
+    */
+   void setMemoryMapFlag(bool flag);
+
+   /** @return true if memory mapped reading is requested. */
+   bool getMemoryMapFlag() const;
+
+   /** @return true if the image files are currently mapped. */
+   bool isMemoryMapped() const;
+
 protected:
    virtual ~rspfGeneralRasterTileSource();
    /**
@@ -180,6 +202,26 @@ protected:
    virtual bool fillBSQ(const rspfIpt& origin, const rspfIpt& size);
    virtual bool fillBsqMultiFile(const rspfIpt& origin, const rspfIpt& size);
 
+   /**
+    * @brief Copies size bytes at offset of image file fileIndex into buf,
+    * from the mapping if there is one, else the file stream.
+    * @return true on success, false on seek or read error.
+    */
+   bool readRaw(rspf_uint32 fileIndex, std::streamoff offset,
+                rspf_uint8* buf, std::streamsize size);
+
+   /** @brief Tells the mapping of fileIndex, if any, a range is about to be read. */
+   void willNeed(rspf_uint32 fileIndex, std::streamoff offset, std::streamsize size) const;
+
+   /**
+    * @brief Copies the BSQ lines of clip_rect straight from the mappings into
+    * result, one strided copy per output band and line.
+    * @return true on success, false if a range is outside a file.
+    */
+   bool fillTileFromMap(rspfImageData* result,
+                        const rspfIrect& tile_rect,
+                        const rspfIrect& clip_rect) const;
+
    virtual rspfKeywordlist getHdrInfo(rspfFilename hdrFile);
    virtual rspfKeywordlist getXmlInfo(rspfFilename xmlFile);
 
@@ -191,6 +233,8 @@ protected:
    rspfInterleaveType                      m_bufferInterleave;
    std::vector<rspfRefPtr<rspfIFStream> > m_fileStrList;
    // std::vector< std::ifstream* >            m_fileStrList;   
+   std::vector<rspfRefPtr<rspfMemoryMappedFile> > m_mappedFileList;
+   bool                                     m_memoryMapFlag;
    rspfGeneralRasterInfo                   m_rasterInfo;
    rspfIrect                               m_bufferRect;
    bool                                     m_swapBytesFlag;
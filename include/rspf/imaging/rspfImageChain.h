@@ -19,6 +19,7 @@ using namespace std;
 #include <rspf/base/rspfConnectableObjectListener.h>
 #include <rspf/base/rspfId.h>
 #include <rspf/base/rspfConnectableContainerInterface.h>
+#include <rspf/imaging/rspfFusedRemapper.h>
 
 class RSPFDLLEXPORT rspfImageChain : public rspfImageSource,
                                        public rspfConnectableObjectListener,
@@ -200,7 +201,23 @@ public:
    virtual bool loadState(const rspfKeywordlist& kwl,
                           const char* prefix=NULL);
    
+   /**
+    * Initializes in reverse order, then replaces runs of two or more point
+    * filters with an rspfFusedRemapper if the fuse flag is set.
+    */
    virtual void initialize();
+
+   /**
+    * Sets the flag to fuse runs of point filters(remappers, gamma,
+    * brightness/contrast...) into one table lookup on initialize.
+    * Default is true.  Keyword: fuse_point_filters
+    */
+   void setFusePointFiltersFlag(bool flag);
+   bool getFusePointFiltersFlag() const;
+
+   /** @return Number of point filters currently fused. */
+   rspf_uint32 getNumberOfFusedFilters() const;
+
    virtual void enableSource();
    virtual void disableSource();
    
@@ -409,6 +426,15 @@ protected:
                                const rspfKeywordlist& kwl,
                                const char* prefix=NULL);
    bool connectAllSources(const map<rspfId, vector<rspfId> >& idMapping);
+
+   /** Finds runs of point filters and splices in fused remappers. */
+   void fusePointFilters();
+
+   /** Hands consumers back their real inputs and drops fused remappers. */
+   void clearFusedRemappers();
+
+   bool                                              theFusePointFiltersFlag;
+   std::vector< rspfRefPtr<rspfFusedRemapper> >      theFusedRemappers;
    
    
 TYPE_DATA
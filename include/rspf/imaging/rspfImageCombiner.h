@@ -14,6 +14,8 @@
 #include <rspf/base/rspfConnectableObjectListener.h>
 #include <rspf/base/rspfPropertyEvent.h>
 
+class rspfPolyArea2d;
+
 /**
  * This will be a base for all combiners.  Combiners take N inputs and
  * will produce a single output.
@@ -33,6 +35,19 @@ public:
 
    virtual rspfIrect getBoundingRect(rspf_uint32 resLevel=0) const;
 
+   /**
+    * @brief Union of the valid image vertices of the inputs, merged with
+    * rspfCascadedUnion.  Inputs without valid vertices contribute their
+    * bounding rect.
+    * @param coverage Initialized with the union, empty if no inputs.
+    * @param resLevel Reduced resolution level.
+    * @param tolerance Simplify tolerance in pixels, 0 = none.
+    * @throw rspfException from rspfCascadedUnion::execute on a failed merge.
+    */
+   virtual void getCoverage(rspfPolyArea2d& coverage,
+                            rspf_uint32 resLevel=0,
+                            double tolerance=0.0) const;
+
    virtual void initialize();
    virtual bool loadState(const rspfKeywordlist& kwl, const char* prefix=NULL);
    virtual bool saveState(rspfKeywordlist& kwl, const char* prefix=NULL)const;
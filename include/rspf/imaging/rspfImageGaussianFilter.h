@@ -10,6 +10,9 @@
 
 #include <rspf/imaging/rspfImageSourceFilter.h>
 #include <rspf/imaging/rspfConvolutionFilter1D.h>
+#include <rspf/imaging/rspfConvolutionEngine.h>
+
+class rspfGaussianInputCache;
 
 /**
  * class for symmetric Gaussian filtering
@@ -22,6 +25,10 @@
  *   true  : any NODATA pixels in the convolution will Nullify the center pixel
  *   false : center pixel will be NODATA only if it was NODATA before 
  *     other NODATA pixels are processed as zero in the convolution calculation
+ *
+ * Tiles whose input is full(no NODATA) are done in one pass with an
+ * rspfConvolutionEngine(separable); others go through the two 1D filters,
+ * which are fed the input tile already read.
  */
 class RSPF_DLL rspfImageGaussianFilter : public rspfImageSourceFilter
 {
@@ -62,6 +69,14 @@ protected:
    void initializeProcesses();
    void updateKernels();
 
+   /**
+    * Convolves in one pass if the input tile is full.
+    * @param input Input tile, tileRect grown by theHalfWidth on each side.
+    * @return Tile or null if the input is not full; caller uses theVF.
+    */
+   rspfRefPtr<rspfImageData> getFullTile(const rspfImageData* input,
+                                         const rspfIrect& tileRect);
+
   /**
    * parameters
    */
@@ -73,6 +88,11 @@ protected:
    */
    rspfRefPtr<rspfConvolutionFilter1D> theHF; //horizontal filter
    rspfRefPtr<rspfConvolutionFilter1D> theVF; //vertical filter
+   rspfRefPtr<rspfGaussianInputCache>  theInputCache; //input of theHF
+
+   rspfConvolutionEngine               theEngine; //2D separable kernel
+   rspf_uint32                         theHalfWidth;
+   rspfRefPtr<rspfImageData>           theTile;
 
 TYPE_DATA
 };
@@ -60,7 +60,8 @@ public:
    
 protected:
    rspfImageGeometryRegistry()
-   :rspfImageGeometryFactoryBase()
+   :rspfImageGeometryFactoryBase(),
+    rspfFactoryListInterface<rspfImageGeometryFactoryBase, rspfImageGeometry>("image_geometry")
    {}
    
    rspfImageGeometryRegistry( const rspfImageGeometryRegistry& rhs )
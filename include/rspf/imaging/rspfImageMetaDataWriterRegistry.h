@@ -22,6 +22,8 @@ public:
    
    void registerFactory(rspfImageMetaDataWriterFactoryBase* factory);
    void unregisterFactory(rspfImageMetaDataWriterFactoryBase* factory);
+   /** @return Number of factories registered. */
+   rspf_uint32 getNumberOfFactories()const;
    bool findFactory(rspfImageMetaDataWriterFactoryBase* factory)const;
    /**
     * Creates an object given a type name.
@@ -21,6 +21,8 @@ public:
    
    void registerFactory(rspfImageSourceFactoryBase* factory);
    void unregisterFactory(rspfImageSourceFactoryBase* factory);
+   /** @return Number of factories registered. */
+   rspf_uint32 getNumberOfFactories()const;
    bool findFactory(rspfImageSourceFactoryBase* factory)const;
    
 protected:
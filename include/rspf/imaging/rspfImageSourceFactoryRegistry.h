@@ -23,6 +23,7 @@ public:
    void registerFactory(rspfImageSourceFactoryBase* factory);
    void unregisterFactory(rspfImageSourceFactoryBase* factory);
    bool findFactory(rspfImageSourceFactoryBase* factory)const;
+   rspf_uint32 getNumberOfFactories()const;
    
 protected:
    rspfImageSourceFactoryRegistry(); // hide
@@ -39,6 +39,20 @@ public:
 
    virtual void initialize();
 
+   /**
+    * @brief Routes this filter's requests to source in place of input 0
+    * until the next initialize or connection change.  Connections are not
+    * touched.  Used by rspfImageChain to splice in an rspfFusedRemapper.
+    */
+   void setInputConnection(rspfImageSource* source);
+
+   /**
+    * @return Count bumped by setters and input connection changes that
+    * change this filter's output, so copies of its settings (see
+    * rspfFusedRemapper) can tell they are stale.
+    */
+   rspf_uint32 getStateCounter() const;
+
    virtual bool loadState(const rspfKeywordlist& kwl,
                           const char* prefix=0);
 
@@ -59,7 +73,12 @@ public:
    
 protected:
    virtual ~rspfImageSourceFilter();
+
+   /** @brief Called by setters that change the output. */
+   void incrementStateCounter();
+
    rspfImageSource* theInputConnection;
+   rspf_uint32      theStateCounter;
 TYPE_DATA
 };
 
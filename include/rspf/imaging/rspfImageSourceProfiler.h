@@ -0,0 +1,177 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfImageSourceProfiler.h
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  See description for class below.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#ifndef rspfImageSourceProfiler_HEADER
+#define rspfImageSourceProfiler_HEADER 1
+
+#include <rspf/base/rspfConstants.h>
+#include <rspf/base/rspfIrect.h>
+#include <rspf/base/rspfTimer.h>
+#include <OpenThreads/Mutex>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class rspfFilename;
+class rspfImageSource;
+class rspfKeywordlist;
+
+/**
+ * @class rspfImageSourceProfiler
+ *
+ * Records where tile time goes in an image chain: for each instrumented
+ * image source, the number of getTile calls, inclusive and exclusive time,
+ * bytes requested and tile cache hits/misses.
+ *
+ * Sources instrument their getTile with RSPF_PROFILE_GET_TILE.  Calls are
+ * recorded per thread in a call tree (no locking), so the same source
+ * reached through different paths is kept apart for the trace and summed
+ * for the report.  Time spent in a source that is not instrumented is
+ * counted as exclusive time of the nearest instrumented caller.
+ *
+ * Off unless the "image_source_profiler.enabled" preference is true (read
+ * by rspfInit) or setEnabled(true) is called; when off a probe only tests a
+ * flag.
+ *
+ * Preferences:
+ * <pre>
+ * image_source_profiler.enabled: true
+ * image_source_profiler.report_file: profile.kwl  // keyword list report
+ * image_source_profiler.trace_file: profile.txt   // folded stacks
+ * </pre>
+ * The files are written by writeReports(), called from rspfInit::finalize.
+ * The trace is in the folded stack format (one "a;b;c microseconds" line per
+ * call path) read by flamegraph.pl and speedscope.
+ */
+class RSPF_DLL rspfImageSourceProfiler
+{
+public:
+
+   /** @brief Probe for one getTile call, open for the life of the object. */
+   class RSPF_DLL Scope
+   {
+   public:
+      Scope(const rspfImageSource* source,
+            const rspfIrect& rect)
+         : m_active(theEnabledFlag)
+      {
+         if (m_active) rspfImageSourceProfiler::instance()->push(source, rect);
+      }
+      ~Scope()
+      {
+         if (m_active) rspfImageSourceProfiler::instance()->pop();
+      }
+   private:
+      bool m_active;
+   };
+
+   static rspfImageSourceProfiler* instance();
+
+   static bool isEnabled() { return theEnabledFlag; }
+
+   /** @brief Turns recording on or off. Recorded data is kept. */
+   void setEnabled(bool flag);
+
+   /**
+    * @brief Clears recorded data.
+    * Must not be called while tiles are being requested.
+    */
+   void reset();
+
+   /** @brief Records a tile cache lookup made by source. */
+   static void cacheHit(const rspfImageSource* source)
+   {
+      if (theEnabledFlag) instance()->recordCache(source, true);
+   }
+   static void cacheMiss(const rspfImageSource* source)
+   {
+      if (theEnabledFlag) instance()->recordCache(source, false);
+   }
+
+   /**
+    * @brief Report, one entry per source sorted by exclusive time:
+    * <pre>
+    * number_of_threads: 4
+    * number_of_sources: 2
+    * source0.name: rspfImageRenderer(12)
+    * source0.get_tile_count: 1024
+    * source0.inclusive_time: 3.2   // seconds, summed over threads
+    * source0.exclusive_time: 1.1
+    * source0.bytes: 268435456
+    * source0.cache_hits: 0
+    * source0.cache_misses: 0
+    * </pre>
+    */
+   void saveState(rspfKeywordlist& kwl, const char* prefix=0) const;
+
+   /** @brief Writes the folded stacks of all threads, times in microseconds. */
+   void writeTrace(std::ostream& out) const;
+
+   /** @brief Writes the report and trace files named in the preferences. */
+   void writeReports() const;
+
+   /** @brief Called by Scope. */
+   void push(const rspfImageSource* source, const rspfIrect& rect);
+   void pop();
+
+protected:
+   rspfImageSourceProfiler();
+   ~rspfImageSourceProfiler();
+
+   /** @brief One source at one call path of one thread. */
+   struct Node
+   {
+      Node();
+      const rspfImageSource* m_source;
+      std::string             m_name;   //!< Kept since the source may be gone by report time
+      rspf_uint32            m_parent;
+      std::vector<rspf_uint32> m_children;
+      rspf_uint64            m_count;
+      rspfTimer::Timer_t     m_inclusive;
+      rspfTimer::Timer_t     m_exclusive;
+      rspf_uint64            m_bytes;
+      rspf_uint64            m_hits;
+      rspf_uint64            m_misses;
+   };
+
+   struct Frame
+   {
+      rspf_uint32        m_node;
+      rspfTimer::Timer_t m_start;
+      rspfTimer::Timer_t m_childTime;
+   };
+
+   /** @brief Call tree of one thread; node 0 is the root. */
+   struct ThreadData
+   {
+      ThreadData();
+      void clear();
+      std::vector<Node>  m_nodes;
+      std::vector<Frame> m_stack;
+   };
+
+   ThreadData* getThreadData();
+   rspf_uint32 getChild(ThreadData* data, rspf_uint32 parent, const rspfImageSource* source);
+   void recordCache(const rspfImageSource* source, bool hit);
+
+   static bool                    theEnabledFlag;
+   static rspfImageSourceProfiler* theInstance;
+   std::vector<ThreadData*>       m_threads;
+   mutable OpenThreads::Mutex     m_mutex; //!< Guards m_threads
+   const rspfTimer*               m_timer;
+};
+
+#define RSPF_PROFILE_GET_TILE(rect) \
+   rspfImageSourceProfiler::Scope rspfProfileScope_(this, rect)
+
+#endif /* #ifndef rspfImageSourceProfiler_HEADER */
@@ -110,6 +110,7 @@ protected:
 
    void applyFilter(rspfRefPtr<rspfImageData>& input);
 
+   /** Summed area table mean; cost per pixel independent of window size. */
    template <class T>
       void applyMean(T dummyVariable,
                      rspfRefPtr<rspfImageData>& inputData);
@@ -123,6 +124,16 @@ protected:
    template <class T>
       void applyMedianNullCenterOnly(T dummyVariable,
                                      rspfRefPtr<rspfImageData>& inputData);
+
+   /** Sliding histogram median for 8 and 16 bit integer data. */
+   template <class T>
+      void applyMedianHistogram(T dummyVariable,
+                                rspfRefPtr<rspfImageData>& inputData);
+
+   /** Windowed selection(nth_element) median for other data. */
+   template <class T>
+      void applyMedianSelect(T dummyVariable,
+                             rspfRefPtr<rspfImageData>& inputData);
 TYPE_DATA
 };
 
@@ -13,6 +13,27 @@
 #define rspfOrthoImageMosaic_HEADER
 
 #include <rspf/imaging/rspfImageMosaic.h>
+#include <rspf/base/rspfKeywordlist.h>
+#include <list>
+#include <map>
+
+class rspfImageHandler;
+
+/**
+ * Mosaic of map projected inputs sharing the same projection.
+ *
+ * Input footprints are computed once in initialize so tile requests do
+ * not touch inputs they do not intersect.
+ *
+ * Large mosaics:  setMaxOpenInputs(or keyword "max_open_inputs", or
+ * preference "ortho_mosaic.max_open_inputs") caps the number of inputs
+ * kept open.  When the cap is exceeded the least recently used input has
+ * its image handlers closed(state saved) and its cache tile sources flushed.
+ * It is reopened from the saved state the next time a tile intersects its
+ * footprint.  Input 0 is the geometry reference and is never closed, nor
+ * is the input being read, so at least two inputs stay open.  Zero means no
+ * limit(default).
+ */
 
 class RSPFDLLEXPORT rspfOrthoImageMosaic : public rspfImageMosaic
 {
@@ -40,6 +61,24 @@ public:
    
    rspfIrect getRelativeRect(rspf_uint32 index,
                               rspf_uint32 resLevel = 0)const;
+
+   /**
+    * @brief Sets the maximum number of inputs kept open.
+    * @param count Maximum or 0 for no limit.
+    */
+   void setMaxOpenInputs(rspf_uint32 count);
+
+   /** @return Maximum number of inputs kept open, 0 = no limit. */
+   rspf_uint32 getMaxOpenInputs() const;
+
+   /** @return Number of inputs currently closed by this mosaic. */
+   rspf_uint32 getNumberOfClosedInputs() const;
+
+   virtual bool saveState(rspfKeywordlist& kwl,
+                          const char* prefix=0)const;
+
+   virtual bool loadState(const rspfKeywordlist& kwl,
+                          const char* prefix=0);
 protected:
    virtual ~rspfOrthoImageMosaic();   
    void computeBoundingRect(rspf_uint32 resLevel=0);
@@ -48,6 +87,37 @@ protected:
    //! each time the contents of the mosaic changes.
    void updateGeometry();
 
+   /**
+    * @brief Reopens input if closed and marks it most recently used.  Closes
+    * least recently used inputs over the limit.
+    */
+   void openInput(rspf_uint32 index);
+
+   /** @brief Saves the state of and closes all image handlers of input. */
+   void closeInput(rspf_uint32 index);
+
+   /** @brief Reopens all closed inputs. */
+   void openAllInputs();
+
+   /**
+    * @brief Closes least recently used inputs until within the limit.  The
+    * most recently used input is kept open.
+    */
+   void enforceOpenInputLimit();
+
+   /** @brief Gets decimation of input for resLevel; works for closed inputs. */
+   void getInputDecimation(rspf_uint32 index,
+                           rspf_uint32 resLevel,
+                           rspfDpt& result) const;
+
+   /** State needed to reopen a closed input. */
+   struct rspfClosedInput
+   {
+      std::vector< rspfRefPtr<rspfImageHandler> > m_Handlers;
+      std::vector<rspfKeywordlist>                m_States;
+      std::vector<rspfDpt>                        m_Decimations;
+   };
+
    std::vector<rspfDpt>  m_InputTiePoints;
    rspfDpt    m_Delta; //!< Holds R0 delta and will be scaled for different r-level requests
    rspfDpt    m_UpperLeftTie; //!< Will hold the upper left tie of the mosaic.
@@ -55,6 +125,11 @@ protected:
    rspfString m_Units;
    rspfRefPtr<rspfImageGeometry> m_Geometry; //!< The input image geometry, altered by the map tiepoint
 
+   std::vector<rspfIrect> m_InputRects; //!< Full res input bounds in input space.
+   rspf_uint32 m_MaxOpenInputs; //!< 0 = no limit.
+   std::list<rspf_uint32> m_OpenInputList; //!< Open inputs, most recently used at front.
+   std::map<rspf_uint32, rspfClosedInput> m_ClosedInputs;
+
 TYPE_DATA
 };
 
@@ -0,0 +1,226 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfRpfFrameCache.h
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  See description for class below.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#ifndef rspfRpfFrameCache_HEADER
+#define rspfRpfFrameCache_HEADER 1
+
+#include <rspf/base/rspfConstants.h>
+#include <rspf/base/rspfFilename.h>
+#include <rspf/base/rspfIpt.h>
+#include <rspf/base/rspfReferenced.h>
+#include <rspf/base/rspfRefPtr.h>
+#include <rspf/parallel/rspfJobMultiThreadQueue.h>
+#include <OpenThreads/Mutex>
+
+#include <ctime>
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+class rspfRpfFrame;
+class rspfRpfToc;
+
+/**
+ * @class rspfRpfFrameCache
+ *
+ * Process wide cache shared by all rspfCibCadrgTileSource objects.
+ *
+ * Holds:
+ *
+ * 1) Decoded(VQ expanded) 256x256 subframes keyed by frame file, subframe
+ * row and column.  Least recently used subframes are dropped when the byte
+ * budget is exceeded.  Budget is from the preference "rpf_cache_size" in
+ * megabytes, or DEFAULT_SIZE.
+ *
+ * 2) Parsed a.toc files keyed by file name.  An entry is reused only if the
+ * file size and modification time are unchanged.
+ *
+ * Subframes missing from the cache are decoded with decodeSubframes which
+ * spreads them over a thread pool(rspf::getNumberOfThreads).
+ *
+ * All methods are thread safe.
+ */
+class RSPF_DLL rspfRpfFrameCache
+{
+public:
+
+   /** @brief Decoded subframe.  Band sequential, 256x256 per band. */
+   class RSPF_DLL Subframe : public rspfReferenced
+   {
+   public:
+
+      /**
+       * @brief Constructor.
+       * @param bands 1 for CIB, 3 for CADRG.
+       */
+      Subframe(rspf_uint32 bands);
+
+      /**
+       * @return Buffer or null if the subframe is not present in the frame
+       * (masked).
+       */
+      const rspf_uint8* getBuf() const;
+
+      /** @return Number of bands. */
+      rspf_uint32 getNumberOfBands() const;
+
+      /** @return Bytes held. */
+      rspf_uint32 getSize() const;
+
+   protected:
+
+      friend class rspfRpfFrameCache;
+
+      /** @return Buffer allocating if needed. */
+      rspf_uint8* getWritableBuf();
+
+      /** @brief Releases the buffer making this an empty(masked) subframe. */
+      void setEmpty();
+
+      rspf_uint32             m_bands;
+      std::vector<rspf_uint8> m_buffer;
+   };
+
+   /** Subframe width/height in pixels. */
+   static const rspf_uint32 SUBFRAME_SIZE;
+
+   /** Default cache size in bytes. */
+   static const rspf_uint32 DEFAULT_SIZE;
+
+   /** @return The instance of this class. */
+   static rspfRpfFrameCache* instance();
+
+   /**
+    * @brief Gets a parsed table of contents.
+    *
+    * Parses and caches the file if not already cached or if the file changed.
+    * The returned object is shared; callers must not modify it.
+    *
+    * @param tocFile The a.toc file.
+    * @return Table of contents or null if parse failed.
+    */
+   rspfRefPtr<rspfRpfToc> getToc(const rspfFilename& tocFile);
+
+   /**
+    * @brief Gets a decoded subframe.
+    * @param frameFile Frame file.
+    * @param row Subframe row(0 to 5).
+    * @param col Subframe column(0 to 5).
+    * @return Subframe or null if not in the cache.
+    */
+   rspfRefPtr<const Subframe> getSubframe(const rspfFilename& frameFile,
+                                          rspf_uint32 row,
+                                          rspf_uint32 col);
+
+   /**
+    * @brief Decodes subframes of a parsed frame and adds them to the cache.
+    *
+    * If more than one subframe is requested they are decoded in parallel.
+    *
+    * @param frame Parsed frame.  Must stay valid until return.
+    * @param frameFile File frame was parsed from.
+    * @param bands 1 for CIB, 3 for CADRG.
+    * @param subframes Subframe positions(x = column, y = row).
+    * @param result Initialized by this; same size and order as subframes.
+    */
+   void decodeSubframes(const rspfRpfFrame& frame,
+                        const rspfFilename& frameFile,
+                        rspf_uint32 bands,
+                        const std::vector<rspfIpt>& subframes,
+                        std::vector< rspfRefPtr<const Subframe> >& result);
+
+   /**
+    * @brief VQ decompresses one subframe.
+    * @param frame Parsed frame.
+    * @param row Subframe row.
+    * @param col Subframe column.
+    * @param bands 1 for CIB, 3 for CADRG.
+    * @param compressed Scratch buffer of at least (64*64*12)/8 bytes.
+    * @param buffer Output buffer of 256*256*bands bytes, band sequential.
+    * @return true on success, false if subframe is masked or read failed.
+    */
+   static bool decodeSubframe(const rspfRpfFrame& frame,
+                              rspf_uint32 row,
+                              rspf_uint32 col,
+                              rspf_uint32 bands,
+                              rspf_uint8* compressed,
+                              rspf_uint8* buffer);
+
+   /** @brief Sets the maximum decoded subframe bytes. */
+   void setMaxCacheSize(rspf_uint64 bytes);
+
+   /** @return Maximum decoded subframe bytes. */
+   rspf_uint64 getMaxCacheSize() const;
+
+   /** @return Decoded subframe bytes currently held. */
+   rspf_uint64 getCacheSize() const;
+
+   /** @brief Sets the number of decode threads.  Zero = number of cores. */
+   void setNumberOfThreads(rspf_uint32 nThreads);
+
+   /** @brief Drops all subframes and tables of contents. */
+   void flush();
+
+protected:
+
+   /** @brief Protected constructor.  Use instance(). */
+   rspfRpfFrameCache();
+
+   /** @brief Protected destructor. */
+   ~rspfRpfFrameCache();
+
+   /** @brief Adds subframe to cache and drops lru subframes over budget. */
+   void addSubframe(const std::string& key, Subframe* subframe);
+
+   /** @return Cache key for a subframe. */
+   static std::string getKey(const rspfFilename& frameFile,
+                             rspf_uint32 row,
+                             rspf_uint32 col);
+
+private:
+
+   /** Hide from use. */
+   rspfRpfFrameCache(const rspfRpfFrameCache&);
+   const rspfRpfFrameCache& operator=(const rspfRpfFrameCache&);
+
+   typedef std::pair< std::string, rspfRefPtr<const Subframe> > SubframeEntry;
+   typedef std::list<SubframeEntry> SubframeList;
+
+   /** Table of contents with the file stamp it was parsed at. */
+   struct TocEntry
+   {
+      rspfRefPtr<rspfRpfToc> m_toc;
+      rspf_int64             m_fileSize;
+      std::time_t            m_modTime;
+   };
+
+   static rspfRpfFrameCache* m_instance;
+
+   /** Subframes, most recently used at front. */
+   SubframeList                                    m_subframeList;
+   std::map<std::string, SubframeList::iterator>   m_subframeMap;
+   rspf_uint64                                     m_cacheSize;
+   rspf_uint64                                     m_maxCacheSize;
+
+   std::map<std::string, TocEntry>                 m_tocMap;
+
+   rspfRefPtr<rspfJobMultiThreadQueue>             m_jobQueue;
+   rspf_uint32                                     m_numberOfThreads;
+
+   mutable OpenThreads::Mutex                      m_mutex;
+   OpenThreads::Mutex                              m_tocMutex;
+};
+
+#endif /* #ifndef rspfRpfFrameCache_HEADER */
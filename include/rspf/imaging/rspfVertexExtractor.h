@@ -27,6 +27,20 @@ class rspfImageSource;
 /*!
  *  Class designed to scan the area of interest and detect the valid vertices
  *  of non null image data.
+ *
+ *  The scan runs on the coarsest reduced resolution level that is still
+ *  at least 256 pixels on a side, then each full resolution line is only
+ *  searched within one coarse pixel of the coarse edges.  Bands of tile
+ *  lines are scanned on a thread pool, each worker reading its own copy of
+ *  the input chain.
+ *
+ *  The left and right edges are simplified (Douglas-Peucker) into a
+ *  polygon of as many vertices as needed, unless the quadrilateral flag is
+ *  set in which case the four corner vertices are extracted as before.
+ *
+ *  The output file also stores a key made from the image file size and
+ *  modification time, the area of interest and the settings; when the key
+ *  matches on a later execute the vertices are read back instead.
  */
 class RSPFDLLEXPORT rspfVertexExtractor : public rspfOutputSource,
     public rspfProcessInterface
@@ -110,6 +124,34 @@ public:
       }
 
    vector<rspfIpt> getVertices() { return theVertice; }
+
+   /*!
+    *  Sets the number of scan threads.  0 (default) uses
+    *  rspf::getNumberOfThreads().
+    */
+   void setNumberOfThreads(rspf_uint32 threads);
+
+   /*!
+    *  Sets the largest distance in pixels between the edges and the
+    *  simplified polygon.  Default is 1.0.
+    */
+   void setTolerance(double pixels);
+
+   /*!
+    *  If true the four corner vertices are extracted (the image must be a
+    *  quadrilateral) instead of the simplified polygon.  Default is false.
+    */
+   void setQuadrilateralFlag(bool flag);
+
+   /*!
+    *  If false only full resolution is scanned.  Default is true.
+    */
+   void setUseOverviewsFlag(bool flag);
+
+   /*!
+    *  If false the output file is always rewritten.  Default is true.
+    */
+   void setCacheFlag(bool flag);
    
 protected:
    virtual ~rspfVertexExtractor();
@@ -119,6 +161,48 @@ protected:
     */
    bool scanForEdges();
 
+   /*!
+    *  Scans the lines of rect at resLevel for the first valid pixel from
+    *  each side, searching line i within [leftStart[i], leftStop[i]] and
+    *  [rightStart[i], rightStop[i]] (sample coordinates of resLevel; a line
+    *  with start > stop is skipped).  Edges are returned in sample
+    *  coordinates of resLevel, RSPF_INT_NAN if not found.
+    *  @param sources The input and its copies, one per scan worker.
+    *  @param progressStart, progressEnd Percent complete range to report.
+    *  Returns false if aborted.
+    */
+   bool scanLines(const std::vector<rspfImageSource*>& sources,
+                  rspf_uint32 resLevel,
+                  const rspfIrect& rect,
+                  const std::vector<rspf_int32>& leftStart,
+                  const std::vector<rspf_int32>& leftStop,
+                  const std::vector<rspf_int32>& rightStart,
+                  const std::vector<rspf_int32>& rightStop,
+                  std::vector<rspf_int32>& leftEdge,
+                  std::vector<rspf_int32>& rightEdge,
+                  double progressStart,
+                  double progressEnd);
+
+   /*!
+    *  Builds "theVertice" from "theLeftEdge" and "theRightEdge": the left
+    *  edges top down and the right edges bottom up, each simplified to
+    *  "theTolerance".
+    *  Returns false if no line has valid data.
+    */
+   bool simplifyEdges();
+
+   /*!
+    *  Returns the cache key of the current input and settings, empty if the
+    *  input has no image file.
+    */
+   rspfString getCacheKey() const;
+
+   /*!
+    *  Reads "theVertice" from "theFilename" if it holds the vertices of
+    *  the current cache key.
+    */
+   bool readCachedVertices();
+
    /*!
     *  Extracts the vertices of the source.  Uses "theLeftEdge" and
     *  "theRightEdge" data members.
@@ -147,6 +231,11 @@ protected:
    vector<rspfIpt> theVertice;
    rspf_int32*     theLeftEdge;
    rspf_int32*     theRightEdge;
+   rspf_uint32     theNumberOfThreads;
+   double           theTolerance;
+   bool             theQuadrilateralFlag;
+   bool             theUseOverviewsFlag;
+   bool             theCacheFlag;
 
    //! Disallow copy constructor and operator=
    rspfVertexExtractor(const rspfVertexExtractor&) {}
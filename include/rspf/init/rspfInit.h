@@ -1,6 +1,7 @@
 #ifndef rspfInit_HEADER
 #define rspfInit_HEADER 1
 #include <rspf/base/rspfFilename.h>
+#include <vector>
 class rspfPreferences;
 class rspfArgumentParser;
 class RSPFDLLEXPORT rspfInit
@@ -60,6 +61,19 @@ public:
     */ 
    void loadPlugins(const rspfFilename& plugin, const char* options=0);
    
+   /**
+    * Loads the plugins named in the preferences and found next to the
+    * application.
+    *
+    * Unless the preference rspf_init.lazy_plugins is false, a manifest
+    * (rspf_init.plugin_manifest, default plugin_manifest.kwl in the user
+    * rspf directory) records the registries each plugin adds factories to.
+    * Plugins whose file is unchanged since they were recorded are not
+    * opened: they are loaded when one of those registries is first used.
+    * Plugins that are new or changed are loaded now and recorded; plugins
+    * with side effects the registries cannot see (an FFT backend) are
+    * always loaded now.
+    */
    void initializePlugins();
    void initializeDefaultFactories();
    void initializeElevation();
@@ -101,6 +115,24 @@ protected:
    void removeOption(int&   argc, 
                      char** argv,
                      int    argToRemove);
+
+   /** A plugin file to load and its options. */
+   struct PluginCandidate
+   {
+      rspfFilename m_file;
+      rspfString   m_options;
+   };
+
+   /** Same search as loadPlugins, adding the files to candidates. */
+   void collectPlugins(const rspfFilename& plugin,
+                       const char* options,
+                       std::vector<PluginCandidate>& candidates)const;
+
+   /** Loads or defers the candidates using the plugin manifest. */
+   void loadPluginCandidates(const std::vector<PluginCandidate>& candidates);
+
+   /** @return Plugin manifest file, empty if it can not be stored. */
+   rspfFilename getPluginManifestFile()const;
    
    static rspfInit*  theInstance;
    bool               theInitializedFlag;  
@@ -0,0 +1,105 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfCascadedUnion.h
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  See description for class below.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#ifndef rspfCascadedUnion_HEADER
+#define rspfCascadedUnion_HEADER 1
+
+#include <rspf/base/rspfConstants.h>
+#include <rspf/base/rspfDrect.h>
+#include <rspf/base/rspfPolyArea2d.h>
+#include <rspf/base/rspfRefPtr.h>
+#include <vector>
+
+class rspfPolygon;
+
+/**
+ * @class rspfCascadedUnion
+ *
+ * Union of many polygons, e.g. scene footprints into a coverage.  Merging
+ * them one at a time with rspfPolyArea2d::operator+= makes every step
+ * work on the whole result so far; here the areas are sorted along a
+ * Z-order curve of their bounding rect centers so neighbors are next to
+ * each other, then merged pairwise in a balanced tree:  each level merges
+ * pairs on a thread pool, halving the number of areas.
+ *
+ * Each merge goes through rspfPolyArea2d::operator+=, so disjoint
+ * footprints, footprints inside a convex neighbor and rectangles sharing
+ * a side are merged without the boolean engine.  With a tolerance each
+ * merged area is simplified, which keeps the upper levels small.
+ *
+ * Usage:
+ * <pre>
+ * rspfCascadedUnion cascade;
+ * cascade.add(footprint);  // for each footprint
+ * rspfPolyArea2d coverage;
+ * cascade.execute(coverage);
+ * </pre>
+ */
+class RSPF_DLL rspfCascadedUnion
+{
+public:
+
+   /** default constructor */
+   rspfCascadedUnion();
+
+   /** destructor */
+   ~rspfCascadedUnion();
+
+   /** @brief Number of merge threads, 0 (default) = rspf::getNumberOfThreads(). */
+   void setNumberOfThreads(rspf_uint32 threads);
+
+   /** @brief Simplify tolerance of the merged areas, 0 (default) = none. */
+   void setTolerance(double tolerance);
+
+   /** @brief Adds a polygon; fewer than three vertices is ignored. */
+   void add(const rspfPolygon& polygon);
+
+   /** @brief Adds an area, which is merged in place. */
+   void add(rspfPolyArea2d* area);
+
+   /** @return Number of areas added since the last execute or clear. */
+   rspf_uint32 getNumberOfAreas() const;
+
+   /** @brief Removes the areas added. */
+   void clear();
+
+   /**
+    * @brief Merges the areas added; they are released.
+    * @param result Initialized with the union, empty if nothing was added.
+    * @throw rspfException if the boolean engine fails on a merge; the
+    * areas are released and result is left empty.
+    */
+   void execute(rspfPolyArea2d& result);
+
+   /** @brief Union of polygons in one call. */
+   static void unionOf(const std::vector<rspfPolygon>& polygons,
+                       rspfPolyArea2d& result,
+                       rspf_uint32 threads=0,
+                       double tolerance=0.0);
+
+protected:
+
+   /** @brief Sorts m_areas (and m_bounds) along the Z-order curve. */
+   void sortAreas();
+
+   std::vector< rspfRefPtr<rspfPolyArea2d> > m_areas;
+   std::vector<rspfDrect> m_bounds;
+   rspf_uint32 m_threads;
+   double      m_tolerance;
+
+private:
+   rspfCascadedUnion(const rspfCascadedUnion& /* obj */) {}
+   const rspfCascadedUnion& operator=(const rspfCascadedUnion& rhs) { return rhs; }
+};
+
+#endif /* #ifndef rspfCascadedUnion_HEADER */
@@ -26,6 +26,7 @@
 
 class rspfImageChain;
 class rspfImageFileWriter;
+class rspfRectangleCutFilter;
 class rspfMapProjection;
 class rspfImageViewTransform;
 class rspfImageSource;
@@ -42,6 +43,9 @@ public:
 
    virtual void initialize(const rspfKeywordlist& kwl);
    virtual void outputProduct();
+
+   //! Returns true if the cut rectangle misses its input, i.e., the product would be all null.
+   static bool isProductEmpty(const rspfRectangleCutFilter* cut);
    
 protected:
    void initializeAttributes();
@@ -52,6 +56,11 @@ protected:
    void initializeChain();
    bool writeToFile(rspfImageFileWriter* writer);
 
+   //! Writes the remaining rspfTiling products on theThreadCount threads, each with its own
+   //! chain clone and writer. Returns false without writing anything if it could not set up.
+   bool writeTiledProductsInParallel(rspfImageFileWriter* writer,
+                                     const rspfFilename& outputDir);
+
    rspfRefPtr<rspfConnectableContainer> theContainer;
    rspfRefPtr<rspfMapProjection>  theProductProjection;
    rspfRefPtr<rspfImageChain>  theProductChain;
@@ -65,6 +74,7 @@ protected:
    bool              theProgressFlag;
    bool              theStdoutFlag;
    rspf_uint32      theThreadCount;
+   rspf_uint32      theProcessCount;
 
 };
 
@@ -16,6 +16,12 @@
 // a recieve and does no processing itself.  The slave connection does
 // all the actual work and processing.
 //
+// Tiles are handed out on demand: slaves ask for work and get a range of
+// tiles sized by what is left(guided self scheduling), so fast slaves take
+// more.  Ranges are only handed out within a window ahead of the tile being
+// returned, which bounds the tiles held here waiting for their turn.  See
+// rspfMpiTileMessage for the protocol.
+//
 //*******************************************************************
 //  $Id: rspfImageMpiMWriterSequenceConnection.h 9094 2006-06-13 19:12:40Z dburken $
 #ifndef rspfImageMpiMWriterSequenceConnection_HEADER
@@ -49,10 +55,27 @@ public:
     */
    virtual rspfRefPtr<rspfImageData> getNextTile(rspf_uint32 resLevel=0);
 protected:
+
+   /** Mpi receive state; defined in the .cpp so this header needs no mpi.h. */
+   class ReceiveState;
+
+   /**
+    * @brief Answers waiting work requests with the next range or, when all
+    * tiles are handed out, with no more work.
+    */
+   void serveWorkRequests();
+
+   /** @brief Tells every slave there is no more work and drains requests. */
+   void finishSequence();
+
+   /** @brief Drops receive state, posting no new receives. */
+   void deleteReceiveState();
+
    int theNumberOfProcessors;
    int theRank;
    bool theNeedToSendRequest;
    rspfRefPtr<rspfImageData> theOutputTile;
+   ReceiveState* theReceiveState;
 
 TYPE_DATA
 };
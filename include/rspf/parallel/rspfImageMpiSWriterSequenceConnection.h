@@ -12,7 +12,14 @@
 #ifndef rspfImageMpiSWriterSequenceConnection_HEADER
 #define rspfImageMpiSWriterSequenceConnection_HEADER
 #include <rspf/imaging/rspfImageSourceSequencer.h>
+#include <vector>
 class rspfImageData;
+
+/**
+ * Slave side of the mpi writer sequence.  Pulls tile ranges from the master
+ * (rspfImageMpiMWriterSequenceConnection) and sends back tiles packed with
+ * rspfMpiTileMessage; see that class for the protocol.
+ */
 class rspfImageMpiSWriterSequenceConnection : public rspfImageSourceSequencer
 {
 public:
@@ -37,15 +44,23 @@ public:
    virtual rspfRefPtr<rspfImageData> getNextTile(rspf_uint32 resLevel=0);
 
    virtual void slaveProcessTiles();
+
+   /**
+    * @brief Sets whether tile payloads are run length encoded when that
+    * makes them smaller.  Default from the preference
+    * "mpi_tile_compression", else true.
+    */
+   void setCompressionFlag(bool flag);
+   bool getCompressionFlag()const;
    
 protected:
    int theNumberOfProcessors;
    int theRank;
    int theNumberOfTilesToBuffer;
-   
-   rspfRefPtr<rspfImageData>* theOutputTile;
+   bool theCompressionFlag;
 
-   void deleteOutputTiles();
+   /** Packed tiles in flight, one per nonblocking send. */
+   std::vector< std::vector<rspf_uint8> > theMessages;
 
 TYPE_DATA
 };
@@ -0,0 +1,130 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfMpiTileMessage.h
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  See description for class below.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#ifndef rspfMpiTileMessage_HEADER
+#define rspfMpiTileMessage_HEADER 1
+
+#include <rspf/base/rspfConstants.h>
+
+#include <vector>
+
+class rspfImageData;
+
+/**
+ * @class rspfMpiTileMessage
+ *
+ * Wire format and tags shared by rspfImageMpiMWriterSequenceConnection and
+ * rspfImageMpiSWriterSequenceConnection.
+ *
+ * Protocol: each slave sends a WORK_REQUEST_TAG message(no payload) and the
+ * master answers with a WORK_TAG message of two unsigned ints, first tile
+ * and tile count; a count of zero means no more work.  Slaves keep one
+ * request outstanding while they work so they never wait on the master
+ * between ranges.  Tiles go back with TILE_TAG in any order.
+ *
+ * A tile message is a header of five big endian 32 bit words:
+ * tile number, encoding, payload byte order, raw size in bytes and payload
+ * size in bytes; followed by the payload.  Null and empty tiles have no
+ * payload.  RLE payloads are PackBits run length encoded raw bytes; used
+ * only when smaller than raw.  Pixel data stays in the sender's byte order
+ * and is swapped on decode only if the receiver's differs.
+ *
+ * No MPI calls are made here.
+ */
+class RSPF_DLL rspfMpiTileMessage
+{
+public:
+
+   enum Tag
+   {
+      TILE_TAG         = 0,
+      WORK_REQUEST_TAG = 1,
+      WORK_TAG         = 2
+   };
+
+   enum Encoding
+   {
+      RAW   = 0,
+      RLE   = 1,
+      EMPTY = 2
+   };
+
+   /** Header size in bytes. */
+   static const rspf_uint32 HEADER_SIZE;
+
+   /**
+    * @param tile Tile of the sequence tile size.
+    * @return Largest message for tile.
+    */
+   static rspf_uint32 getMaxMessageSize(const rspfImageData* tile);
+
+   /**
+    * @brief Packs a tile.
+    * @param tile Tile or null.  Null, RSPF_NULL and RSPF_EMPTY tiles are
+    * sent as EMPTY.
+    * @param tileNumber Sequence tile number.
+    * @param compress If true try RLE.
+    * @param message Initialized by this.
+    */
+   static void encode(const rspfImageData* tile,
+                      rspf_uint32 tileNumber,
+                      bool compress,
+                      std::vector<rspf_uint8>& message);
+
+   /**
+    * @param message Message.
+    * @param size Message size in bytes.
+    * @param tileNumber Initialized by this.
+    * @return false if message is too small.
+    */
+   static bool getTileNumber(const rspf_uint8* message,
+                             rspf_uint32 size,
+                             rspf_uint32& tileNumber);
+
+   /**
+    * @brief Unpacks a message into tile.  Does not change the tile's
+    * rectangle or status; callers validate after.
+    * @param message Message.
+    * @param size Message size in bytes.
+    * @param tile Initialized tile of the sequence tile size.
+    * @return false on a malformed message or size mismatch.
+    */
+   static bool decode(const rspf_uint8* message,
+                      rspf_uint32 size,
+                      rspfImageData* tile);
+
+   /**
+    * @brief PackBits run length encoding.
+    * @param in Input bytes.
+    * @param size Input size.
+    * @param out Encoded bytes appended.
+    * @param maxSize Gives up when out grows past this.
+    * @return false if the encoding would be larger than maxSize.
+    */
+   static bool packBits(const rspf_uint8* in,
+                        rspf_uint32 size,
+                        std::vector<rspf_uint8>& out,
+                        rspf_uint32 maxSize);
+
+   /**
+    * @brief PackBits decode.
+    * @return false if in is malformed or does not decode to exactly size
+    * bytes.
+    */
+   static bool unpackBits(const rspf_uint8* in,
+                          rspf_uint32 inSize,
+                          rspf_uint8* out,
+                          rspf_uint32 size);
+};
+
+#endif /* #ifndef rspfMpiTileMessage_HEADER */
@@ -199,6 +199,13 @@ protected:
    */
    void consolidateCutRectSpec();
 
+   /**
+    * @return Combined bounding rect of the valid input vertices of the
+    * mosaic, clipped to the product chain bounding rect; the product chain
+    * bounding rect if there is no mosaic.  In view coordinates.
+    */
+   rspfDrect getValidMosaicRect();
+
    /**
    * Called when histogram operation is requested. Sets up additional filters in image chain
    * for performing matching, stretching or clipping. If chain=0,
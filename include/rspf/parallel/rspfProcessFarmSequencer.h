@@ -0,0 +1,152 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfProcessFarmSequencer.h
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  See description for class below.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#ifndef rspfProcessFarmSequencer_HEADER
+#define rspfProcessFarmSequencer_HEADER 1
+
+#include <rspf/imaging/rspfImageSourceSequencer.h>
+#include <rspf/imaging/rspfImageData.h>
+
+class rspfConnectableContainer;
+
+/**
+ * @class rspfProcessFarmSequencer
+ *
+ * Sequencer that spreads getNextTile work over forked worker processes on
+ * the local machine.  An alternative to rspfMultiThreadSequencer when the
+ * chain has handlers that are not thread safe, and to the mpi sequencers when
+ * there is no mpi runtime.
+ *
+ * At the first getNextTile of a sequence the initialized chain is forked
+ * once per worker.  Each worker rebuilds the chain, and reloads the
+ * elevation databases, from their saveState so it reads through its own
+ * file descriptors rather than the parent's.  Since a
+ * forked child only has the forking thread, the farm is not started when
+ * other threads are running (e.g. a job queue); the sequencer then runs
+ * serial, so create it before starting any threads.  The parent
+ * hands tile numbers to workers through pipes, keeping a few queued on each,
+ * and workers return tiles in a shared memory ring of slots(see
+ * rspfMpiTileMessage for the slot format).  The parent returns tiles in
+ * sequence order and frees a slot as soon as its tile is copied out, so the
+ * ring bounds how far workers run ahead of the writer.  Workers exit at the
+ * end of the sequence; a chain changed between sequences is forked again.
+ *
+ * A worker that dies has its queued tiles done by the parent.
+ *
+ * Only getNextTile is farmed; getTile(rect) goes straight to the input.
+ * Requires fork; on Windows this behaves like rspfImageSourceSequencer.
+ */
+class RSPFDLLEXPORT rspfProcessFarmSequencer : public rspfImageSourceSequencer
+{
+public:
+
+   /**
+    * @brief Constructor.
+    * @param inputSource Input.
+    * @param numberOfProcesses Workers.  Zero = number of cores.
+    * @param owner Owner.
+    */
+   rspfProcessFarmSequencer(rspfImageSource* inputSource=NULL,
+                             rspf_uint32 numberOfProcesses=0,
+                             rspfObject* owner=NULL);
+
+   /** @brief Destructor.  Stops any workers. */
+   virtual ~rspfProcessFarmSequencer();
+
+   /** @brief Stops any workers and initializes the base. */
+   virtual void initialize();
+
+   /** @brief Stops any workers and rewinds. */
+   virtual void setToStartOfSequence();
+
+   /**
+    * @brief Returns the next tile in sequence from the workers, starting them
+    * if needed.
+    */
+   virtual rspfRefPtr<rspfImageData> getNextTile(rspf_uint32 resLevel=0);
+
+   /** @brief Sets the number of workers.  Zero = number of cores. */
+   void setNumberOfProcesses(rspf_uint32 numberOfProcesses);
+
+   /** @return Number of workers used. */
+   rspf_uint32 getNumberOfProcesses() const;
+
+   /**
+    * @brief Sets the number of ring slots per worker.  Two or more; the
+    * default of four lets each worker have two tiles queued and two done
+    * ahead of the writer.
+    */
+   void setSlotsPerProcess(rspf_uint32 slots);
+
+   /** @return Ring slots per worker. */
+   rspf_uint32 getSlotsPerProcess() const;
+
+protected:
+
+   class Farm;
+
+   /**
+    * @brief Forks the workers.
+    * @return false if the farm could not be set up.
+    */
+   bool startWorkers(rspf_uint32 resLevel);
+
+   /** @brief Closes the pipes, waits on the workers and frees the ring. */
+   void stopWorkers();
+
+   /** @brief Queues tiles on live workers while there are free slots. */
+   void assignTiles();
+
+   /**
+    * @brief Waits until tileNumber is in its slot, doing it here if its
+    * worker died.
+    */
+   void waitForTile(rspf_uint32 tileNumber);
+
+   /** @brief Gets a tile from the input and encodes it into a slot. */
+   void fillSlot(rspf_uint32 tileNumber, rspf_uint32 slot, rspf_uint32& size);
+
+   /**
+    * @brief Worker side.  Replaces theInputConnection with a copy loaded
+    * from the state of the inherited chain.
+    * @param container Initialized with the objects of the copy.
+    * @return false if the chain could not be rebuilt.
+    */
+   bool rebuildInput(rspfRefPtr<rspfConnectableContainer>& container);
+
+   /**
+    * @brief Worker side.  Replaces the rspfElevManager databases with copies
+    * loaded from their states so elevation cells are not read through the
+    * parent's file descriptors either.
+    * @return false if a database could not be reloaded.
+    */
+   bool reloadElevation();
+
+   /** @brief Worker side.  Never returns. */
+   void workerLoop(rspf_uint32 worker, int commandFd, int resultFd);
+
+   rspf_uint32                m_numberOfProcesses;
+   rspf_uint32                m_slotsPerProcess;
+   rspf_uint32                m_resLevel;
+   rspfRefPtr<rspfImageData> m_outputTile;
+   Farm*                      m_farm;
+   bool                       m_farmFailed;
+
+private:
+
+   /** Hide from use. */
+   rspfProcessFarmSequencer(const rspfProcessFarmSequencer&);
+   const rspfProcessFarmSequencer& operator=(const rspfProcessFarmSequencer&);
+};
+
+#endif /* #ifndef rspfProcessFarmSequencer_HEADER */
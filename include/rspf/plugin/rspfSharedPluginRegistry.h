@@ -6,6 +6,7 @@
 #include <rspf/base/rspfFilename.h>
 #include <rspf/base/rspfRefPtr.h>
 #include <rspf/plugin/rspfPluginLibrary.h>
+#include <OpenThreads/ReentrantMutex>
 class RSPFDLLEXPORT rspfSharedPluginRegistry
 {
 public:
@@ -20,6 +21,7 @@ public:
    rspf_uint32 getIndex(const rspfPluginLibrary* lib)const;
    rspfPluginLibrary* getPlugin(rspf_uint32 idx);
    const rspfPluginLibrary* getPlugin(rspf_uint32 idx)const;
+   /** @return Number of loaded plugins, deferred ones are not counted. */
    rspf_uint32 getNumberOfPlugins()const;
    /**
     * Checks if filename is already loaded to avoid duplication.
@@ -27,15 +29,63 @@ public:
     * @param filename The file to check.
     *
     * @return true if any of the plugins match file name, false if not.
+    * A deferred plugin counts as loaded.
     */
    bool isLoaded(const rspfFilename& filename) const;
    
+   /** Loads all deferred plugins first. */
    void printAllPluginInformation(std::ostream& out);
    
+   /**
+    * Adds a plugin without opening it.  It is loaded by loadDeferredPlugins
+    * the first time one of the registries it extends is used, or by
+    * registerPlugin.
+    *
+    * @param filename The plugin.
+    * @param options Options passed to its initialize.
+    * @param registries Plugin keys of the registries the plugin registers
+    * factories in (see rspfFactoryListInterface).
+    */
+   void registerDeferredPlugin(const rspfFilename& filename,
+                               const rspfString& options,
+                               const std::vector<rspfString>& registries);
+   
+   /**
+    * Loads the deferred plugins that extend the registry with plugin key
+    * registryKey.  Cheap when there is nothing deferred.
+    */
+   void loadDeferredPlugins(const rspfString& registryKey);
+   
+   /** Loads all deferred plugins. */
+   void loadAllDeferredPlugins();
+   
+   rspf_uint32 getNumberOfDeferredPlugins()const;
+   
 protected:
+   struct DeferredPlugin
+   {
+      rspfFilename            m_file;
+      rspfString              m_options;
+      std::vector<rspfString> m_registries;
+   };
+   
    rspfSharedPluginRegistry();
    rspfSharedPluginRegistry(const rspfSharedPluginRegistry&){}
    void operator = (const rspfSharedPluginRegistry&){}
+   
+   /** Removes the deferred entries matching key (all if empty) and loads them. */
+   void loadDeferred(const rspfString& registryKey, const rspfFilename& filename);
+   
    std::vector<rspfRefPtr<rspfPluginLibrary> > theLibraryList;
+   std::vector<DeferredPlugin> m_deferredList;
+   /** Reentrant: a plugin's initialize may use registries. */
+   mutable OpenThreads::ReentrantMutex m_deferredMutex;
+   /** Loads in progress, nested ones included; guarded by m_deferredMutex. */
+   rspf_uint32 m_loadingCount;
+   /**
+    * Fast check for the registry hooks, only read unlocked.  Stays set while
+    * a load is in progress so other threads take the lock and wait for it.
+    */
+   volatile bool m_hasDeferredFlag;
 };
 #endif
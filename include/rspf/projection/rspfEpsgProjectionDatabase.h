@@ -13,8 +13,11 @@
 
 #include <rspf/projection/rspfProjectionFactoryBase.h>
 #include <rspf/base/rspfFilename.h>
+#include <rspf/base/rspfMemoryMappedFile.h>
 #include <fstream>
+#include <map>
 #include <rspf/projection/rspfMapProjection.h>
+#include <OpenThreads/ReentrantMutex>
 
 class rspfProjection;
 class rspfString;
@@ -24,6 +27,11 @@ class rspfUtmProjection;
 //*************************************************************************************************
 //! Projection Database for coded projections defined in database files and specified via some 
 //! coordinate reference system group:code, such as EPSG:26715.
+//!
+//! Each Db CSV file gets a binary index (codes, names and line positions sorted by code) kept in
+//! the directory given by the "epsg_database_index_dir" preference (default: epsg_index in the
+//! user rspf directory) and rebuilt when the CSV changes. Start up only maps the indexes; a CSV
+//! line is split into fields the first time its code is looked up.
 //*************************************************************************************************
 class RSPFDLLEXPORT rspfEpsgProjectionDatabase : public rspfReferenced
 {
@@ -67,7 +75,7 @@ public:
    void getProjectionsList(std::vector<rspfString>& typeList) const;
 
    //! ENGINEERING CODE. Used for testing
-   size_t numRecords() const { return m_projDatabase.size(); }
+   size_t numRecords() const;
 
 protected:
    enum RecordFormat
@@ -99,6 +107,48 @@ protected:
       rspfRefPtr<rspfMapProjection> proj;
    };
 
+   //! One Db CSV file and its index. Entries are sorted by code, file order kept for equal codes.
+   class DbFile : public rspfReferenced
+   {
+   public:
+      //! Index record, as stored in the index file.
+      struct Entry
+      {
+         rspf_uint32 code;
+         rspf_uint32 nameOffset;  //!< In the names block
+         rspf_uint32 nameLength;
+         rspf_uint32 lineLength;
+         rspf_uint64 lineOffset;  //!< In the CSV file
+         bool operator<(const Entry& rhs) const { return code < rhs.code; }
+      };
+
+      DbFile() : format(NOT_ASSIGNED), entries(0), count(0), names(0) {}
+
+      rspfString name(rspf_uint32 i) const;
+      rspfString line(rspf_uint32 i) const;
+
+      //! Index of the first entry with code, or count if none.
+      rspf_uint32 find(rspf_uint32 code) const;
+
+      rspfFilename                      csvFile;
+      RecordFormat                      format;
+      rspfRefPtr<rspfMemoryMappedFile> csv;
+      rspfRefPtr<rspfMemoryMappedFile> index;       //!< Mapped index file, if it could be written
+      std::vector<rspf_uint64>          indexBuffer; //!< Index held in memory otherwise
+      const Entry*                      entries;
+      rspf_uint32                       count;
+      const char*                       names;
+   };
+
+   //! Position of an entry over all Db files: ascending code, then Db file and line order.
+   struct EntryRef
+   {
+      rspf_uint32 code;
+      rspf_uint32 file;
+      rspf_uint32 entry;
+      bool operator<(const EntryRef& rhs) const { return code < rhs.code; }
+   };
+
    //! Constructor loads all Db files specified in the rspf prefs. Protected as part of
    //! singleton implementation.
    rspfEpsgProjectionDatabase();
@@ -121,7 +171,29 @@ protected:
    //! Populates the database with contents of DB files as specified in rspf_preferences.
    void initialize();
 
-   mutable std::multimap<rspf_uint32, rspfRefPtr<ProjDbRecord> > m_projDatabase;
+   //! Maps the index of db.csvFile, building it first if missing or stale. False for a bad file.
+   bool openDbFile(DbFile& db) const;
+
+   //! Scans the CSV and writes the index. Keeps it in memory if the index file can't be written.
+   bool buildIndex(DbFile& db, const rspfFilename& indexFile,
+                   rspf_uint64 csvSize, rspf_int64 csvTime) const;
+
+   //! Index file name for a Db CSV file, empty if no index directory.
+   rspfFilename getIndexFile(const rspfFilename& csvFile) const;
+
+   //! Returns the record of the first entry with code, decoding its CSV line if not done yet.
+   ProjDbRecord* getRecord(rspf_uint32 code) const;
+
+   //! All entries ordered by code, then by Db file and line.
+   void getEntries(std::vector<EntryRef>& entries) const;
+
+   //! Decoded records by code (first Db entry with that code).
+   mutable std::map<rspf_uint32, rspfRefPtr<ProjDbRecord> > m_projDatabase;
+
+   //! Guards m_projDatabase and the records' cached projections. Reentrant since lookups by
+   //! name or by projection call findProjection(code).
+   mutable OpenThreads::ReentrantMutex m_projDatabaseMutex;
+   std::vector< rspfRefPtr<DbFile> > m_dbFiles;
    static rspfEpsgProjectionDatabase*  m_instance; //!< Singleton implementation
 
 };
@@ -63,6 +63,9 @@ public:
     * for memory.
     */
    rspfInfoBase* create(const rspfFilename& file) const;
+
+   /** @return Number of registered factories. */
+   rspf_uint32 getNumberOfFactories() const;
    
 protected:
 
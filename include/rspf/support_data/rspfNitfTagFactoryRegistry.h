@@ -24,6 +24,8 @@ public:
    virtual ~rspfNitfTagFactoryRegistry();
    void registerFactory(rspfNitfTagFactory* aFactory);
    void unregisterFactory(rspfNitfTagFactory* aFactory);
+   /** @return Number of factories registered. */
+   rspf_uint32 getNumberOfFactories()const;
    
    static rspfNitfTagFactoryRegistry* instance();
    
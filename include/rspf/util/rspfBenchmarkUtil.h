@@ -0,0 +1,184 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfBenchmarkUtil.h
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:
+//
+// Utility class to time the core tile paths on synthetic data.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#ifndef rspfBenchmarkUtil_HEADER
+#define rspfBenchmarkUtil_HEADER 1
+
+#include <rspf/base/rspfConstants.h>
+#include <rspf/base/rspfFilename.h>
+#include <rspf/base/rspfReferenced.h>
+#include <rspf/base/rspfRefPtr.h>
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+// Forward class declarations:
+class rspfArgumentParser;
+class rspfImageData;
+class rspfImageGeometry;
+
+/**
+ * @brief rspfBenchmarkUtil class.
+ *
+ * Times the core tile paths against rasters generated in memory, so runs
+ * are reproducible without external data:
+ *
+ * <pre>
+ * image_data.*        rspfImageData load/unload per interleave and scalar
+ *                     type, and scalar conversions through loadTile
+ * resampler.*         rspfResampler per resampler type
+ * filter_resampler.*  rspfFilterResampler per filter type
+ * renderer.*          rspfImageRenderer map to map and RPC ortho
+ * tiff.*              rspfTiffWriter write and rspfTiffTileSource read back
+ * elevation.*         rspfElevManager lookups against synthetic SRTM cells
+ * histogram.*         rspfImageData::populateHistogram per scalar type
+ * sequencer.*         rspfMultiThreadSequencer from one to N threads
+ * </pre>
+ *
+ * Each benchmark runs once untimed, then the number of iterations; the best
+ * and mean wall times are kept.  Results are written as JSON and can be
+ * compared against a previous run with --baseline, in which case execute
+ * returns false if any benchmark got slower than the tolerance.
+ *
+ * Files (tiff, SRTM cells) are written to a work directory that is removed
+ * when done.
+ */
+class RSPF_DLL rspfBenchmarkUtil : public rspfReferenced
+{
+public:
+
+   /** @brief One timed operation. */
+   class Case
+   {
+   public:
+      virtual ~Case() {}
+      virtual void run() = 0;
+   };
+
+   /** @brief Timing of one benchmark. */
+   struct Result
+   {
+      std::string  m_name;
+      rspf_uint32  m_iterations;
+      double       m_bestSeconds;
+      double       m_meanSeconds;
+      rspf_uint64  m_pixels;     //!< Pixels (or lookups) per iteration.
+      double       m_baselineSeconds; //!< Best time in baseline, nan if none.
+   };
+
+   /** default constructor */
+   rspfBenchmarkUtil();
+
+   /** virtual destructor */
+   virtual ~rspfBenchmarkUtil();
+
+   /**
+    * @brief Initial method to be ran prior to execute.
+    * @param ap Arg parser to initialize from.
+    * @return false if usage was printed and the caller should exit.
+    */
+   bool initialize(rspfArgumentParser& ap);
+
+   /**
+    * @brief Runs the selected benchmarks, writes the JSON output and, if a
+    * baseline was given, the comparison.
+    * @return false if a benchmark regressed against the baseline or the
+    * output could not be written.
+    */
+   bool execute();
+
+   /** @return Results of the last execute. */
+   const std::vector<Result>& getResults() const;
+
+   /** @brief Writes results as JSON. */
+   void writeJson(std::ostream& out) const;
+
+   /**
+    * @brief Reads the best times of a file written by writeJson.
+    * @param file File to read.
+    * @param bestSeconds Initialized with name to best time in seconds.
+    * @return true on success, false if file could not be read.
+    */
+   static bool readJson(const rspfFilename& file,
+                        std::map<std::string, double>& bestSeconds);
+
+   /** @brief Adds application arguments to the argument parser. */
+   void addArguments(rspfArgumentParser& ap);
+
+   /** @brief Initializes arg parser and outputs usage. */
+   void usage(rspfArgumentParser& ap);
+
+protected:
+
+   /**
+    * @brief Times c (one untimed run plus m_iterations) and appends a result.
+    * @param pixels Pixels or lookups processed by one run, for throughput.
+    */
+   void time(const std::string& name, Case& c, rspf_uint64 pixels);
+
+   /**
+    * @return true if name starts with a --benchmark prefix or a prefix
+    * starts with name (so group names select their setup).
+    */
+   bool isSelected(const std::string& name) const;
+
+   void runImageData();
+   void runResampler();
+   void runFilterResampler();
+   void runRenderer();
+   void runTiff();
+   void runElevation();
+   void runHistogram();
+   void runSequencer();
+
+   /** @brief Compares m_results to the baseline; logs the table. */
+   bool compareToBaseline();
+
+   /** @return New initialized tile filled with the synthetic pattern. */
+   static rspfRefPtr<rspfImageData> createImage(rspfScalarType scalar,
+                                                 rspf_uint32 bands,
+                                                 rspf_uint32 width,
+                                                 rspf_uint32 height);
+
+   /** @return Geographic geometry of an m_size square image. */
+   rspfRefPtr<rspfImageGeometry> createGeoGeometry() const;
+
+   /** @return RPC geometry of an m_size square image, same footprint. */
+   rspfRefPtr<rspfImageGeometry> createRpcGeometry() const;
+
+   /** @return Utm geometry covering the same footprint. */
+   rspfRefPtr<rspfImageGeometry> createUtmGeometry() const;
+
+   /** @brief Writes the synthetic geographic image as a geotiff. */
+   bool writeTiff(const rspfFilename& file) const;
+
+   /** @brief Removes the work files and directory. */
+   void removeWorkFiles() const;
+
+   rspf_uint32         m_size;       //!< Width and height of synthetic images.
+   rspf_uint32         m_tileSize;
+   rspf_uint32         m_iterations;
+   rspf_uint32         m_threads;    //!< Most sequencer threads, 0 = cores.
+   double              m_tolerance;  //!< Allowed slowdown, 0.1 = 10%.
+   std::vector<std::string> m_filters;
+   rspfFilename        m_outputFile;
+   rspfFilename        m_baselineFile;
+   rspfFilename        m_workDir;
+   std::vector<Result> m_results;
+};
+
+#endif /* #ifndef rspfBenchmarkUtil_HEADER */
@@ -0,0 +1,213 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfChipperService.h
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  See description for class below.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#ifndef rspfChipperService_HEADER
+#define rspfChipperService_HEADER 1
+
+#include <rspf/base/rspfConstants.h>
+#include <rspf/base/rspfKeywordlist.h>
+#include <rspf/base/rspfReferenced.h>
+#include <rspf/base/rspfRefPtr.h>
+#include <rspf/imaging/rspfImageData.h>
+#include <rspf/parallel/rspfJob.h>
+#include <rspf/parallel/rspfJobMultiThreadQueue.h>
+#include <rspf/util/rspfChipperUtil.h>
+#include <OpenThreads/Block>
+#include <OpenThreads/Mutex>
+
+#include <list>
+#include <string>
+#include <utility>
+
+/**
+ * @class rspfChipperService
+ *
+ * Long lived chipper for serving many small chips from the same scenes.
+ *
+ * Requests are queued and processed by a pool of threads.  Each request
+ * holds a full rspfChipperUtil options keyword list.  The options are split
+ * into scene options(inputs, entry, bands, resampler...) and chip options(see
+ * rspfChipperUtil::isChipOption).  Initialized rspfChipperUtil objects are
+ * kept in a pool keyed by scene options so the opened rspfSingleImageChain's,
+ * geometries and caches stay warm.  A request for a scene already in the pool
+ * only pays for rspfChipperUtil::reinitialize and the chip itself.
+ *
+ * A pooled chipper is only ever used by one thread at a time.  If several
+ * threads need the same scene at once, additional chippers are opened for
+ * it.
+ *
+ * The result is written to an in-memory buffer if a "writer" option is
+ * present(the writer must support streams); else, the raw chip is returned
+ * as an rspfImageData.
+ *
+ * Typical usage:
+ *
+ * rspfRefPtr<rspfChipperService> service = new rspfChipperService();
+ * rspfRefPtr<rspfChipperService::Request> request =
+ *    new rspfChipperService::Request(options);
+ * service->add( request.get() );
+ * request->wait();
+ * if ( request->succeeded() ) { ... request->getBuffer() ... }
+ */
+class RSPF_DLL rspfChipperService : public rspfReferenced
+{
+public:
+
+   /** @brief A chip request and, once finished, its result. */
+   class RSPF_DLL Request : public rspfReferenced
+   {
+   public:
+
+      /**
+       * @brief Constructor.
+       * @param options rspfChipperUtil options for this chip.
+       */
+      Request(const rspfKeywordlist& options);
+
+      /** @return The options. */
+      const rspfKeywordlist& getOptions() const;
+
+      /** @brief Blocks the calling thread until the request is finished. */
+      void wait();
+
+      /** @return true if processed, successful or not. */
+      bool isFinished() const;
+
+      /** @return true if finished without error. */
+      bool succeeded() const;
+
+      /** @return Encoded chip.  Only set if a writer option was given. */
+      const std::string& getBuffer() const;
+
+      /** @return Chip.  Only set if no writer option was given. */
+      rspfRefPtr<rspfImageData> getChip() const;
+
+      /** @return Error message if not successful. */
+      const std::string& getErrorMessage() const;
+
+   protected:
+
+      friend class rspfChipperService;
+
+      /** @brief Sets the result and releases any waiting thread. */
+      void setResult(bool status,
+                     rspfRefPtr<rspfImageData> chip,
+                     const std::string& buffer,
+                     const std::string& errorMessage);
+
+      rspfKeywordlist            m_options;
+      mutable OpenThreads::Mutex m_mutex;
+      OpenThreads::Block         m_block;
+      bool                       m_finished;
+      bool                       m_status;
+      rspfRefPtr<rspfImageData>  m_chip;
+      std::string                m_buffer;
+      std::string                m_errorMessage;
+   };
+
+   /**
+    * @brief Constructor.
+    * @param nThreads Number of requests processed concurrently.  If zero the
+    * number of cores is used.
+    * @param maxIdleChippers Maximum number of idle warm chippers to keep.
+    * Least recently used are released first.
+    */
+   rspfChipperService(rspf_uint32 nThreads=0, rspf_uint32 maxIdleChippers=32);
+
+   /** @brief Queues request.  Returns immediately. */
+   void add(Request* request);
+
+   /**
+    * @brief Convenience method to queue a request and wait on it.
+    * @param options rspfChipperUtil options for this chip.
+    * @return The finished request.
+    */
+   rspfRefPtr<Request> process(const rspfKeywordlist& options);
+
+   /** @brief Sets the number of requests processed concurrently. */
+   void setNumberOfThreads(rspf_uint32 nThreads);
+
+   /** @return Number of threads. */
+   rspf_uint32 getNumberOfThreads() const;
+
+   /** @brief Sets the maximum number of idle warm chippers to keep. */
+   void setMaxIdleChippers(rspf_uint32 count);
+
+   /** @return Number of idle warm chippers in the pool. */
+   rspf_uint32 getNumberOfIdleChippers() const;
+
+   /** @brief Releases all idle chippers(closes the scenes). */
+   void clearIdleChippers();
+
+   /**
+    * @brief Gets the pool key for options.
+    *
+    * This is all options that are not chip options.
+    *
+    * @param options rspfChipperUtil options.
+    * @param key Initialized by this.
+    */
+   static void getSceneKey(const rspfKeywordlist& options, std::string& key);
+
+protected:
+
+   /**
+    * @brief virtual destructor
+    *
+    * Requests still queued are finished with an error, then the threads are
+    * stopped after the requests in progress.  Jobs do not hold a reference
+    * to the service, so this runs on the thread releasing the last one.
+    */
+   virtual ~rspfChipperService();
+
+   /** @brief Processes a request.  Called from job threads. */
+   void processRequest(Request* request);
+
+   /**
+    * @brief Gets a warm chipper for scene key out of the pool.
+    * @return Chipper or null if none idle for key.
+    */
+   rspfRefPtr<rspfChipperUtil> checkOut(const std::string& key);
+
+   /** @brief Returns a chipper to the pool. */
+   void checkIn(const std::string& key, rspfChipperUtil* chipper);
+
+private:
+
+   /** @brief Private rspfJob class. */
+   class rspfChipperJob : public rspfJob
+   {
+   public:
+      rspfChipperJob(rspfChipperService* service, Request* request);
+
+      /** @brief Defines pure virtual rspfJob::start. */
+      virtual void start();
+
+      /** @brief Finishes the request with an error without processing it. */
+      void abort();
+
+   private:
+      rspfChipperService*  m_service; // Not owned; outlives its queued jobs.
+      rspfRefPtr<Request>  m_request;
+   };
+
+   typedef std::pair< std::string, rspfRefPtr<rspfChipperUtil> > PoolEntry;
+
+   /** Idle chippers.  Most recently used at front. */
+   std::list<PoolEntry>                m_idleChippers;
+   rspf_uint32                         m_maxIdleChippers;
+   rspfRefPtr<rspfJobMultiThreadQueue> m_jobQueue;
+   mutable OpenThreads::Mutex          m_poolMutex;
+};
+
+#endif /* #ifndef rspfChipperService_HEADER */
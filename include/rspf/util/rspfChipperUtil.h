@@ -26,7 +26,9 @@
 #include <rspf/imaging/rspfSingleImageChain.h>
 #include <rspf/projection/rspfMapProjection.h>
 
+#include <iosfwd>
 #include <map>
+#include <string>
 #include <vector>
 
 // Forward class declarations:
@@ -35,6 +37,7 @@ class rspfDpt;
 class rspfFilename;
 class rspfGpt;
 class rspfImageFileWriter;
+class rspfImageData;
 class rspfImageGeometry;
 class rspfImageViewAffineTransform;
 class rspfIrect;
@@ -105,12 +108,74 @@ public:
     */
    void initialize();
 
+   /**
+    * @brief Initialize method from keyword list of options.
+    *
+    * Clears any previous state, copies options and calls initialize().
+    * 
+    * @param kwl Options keyword list.  Same keywords as the
+    * --options-keyword-list file.
+    * @return true if at least one input chain was created, false if not.
+    * @note Throws rspfException on error.
+    */
+   bool initialize(const rspfKeywordlist& kwl);
+
+   /**
+    * @brief Re-initializes an already initialized object for a new chip.
+    *
+    * The opened chains are kept warm.  Only the chip options(see
+    * isChipOption) are replaced and the output projection is rebuilt.
+    * Any scene option in chipKwl is ignored.
+    *
+    * @param chipKwl Chip options, e.g. cut box, gsd, projection, writer.
+    * @note Throws rspfException on error.
+    */
+   void reinitialize(const rspfKeywordlist& chipKwl);
+
    /**
     * @brief execute method.  Performs the actual product write.
     * @note Throws rspfException on error.
     */
    void execute();
 
+   /**
+    * @brief Builds the processing chain for the current operation on top of
+    * the layers.
+    * @param aoi Initialized by this with the area of interest in view space.
+    * @return End of chain.  Can be null.
+    * @note Throws rspfException on error.
+    */
+   rspfRefPtr<rspfImageSource> initializeChain( rspfIrect& aoi );
+
+   /**
+    * @brief Gets the area of interest for the current options into memory.
+    * @return Chip or null on error.  This is a copy the caller owns.
+    * @note Throws rspfException on error.
+    */
+   rspfRefPtr<rspfImageData> getChip();
+
+   /**
+    * @brief Writes the area of interest for the current options to a stream.
+    *
+    * The writer keyword is required as there is no output file extension to
+    * derive it from.  The writer must support setOutputStream(std::ostream&).
+    * 
+    * @param out Stream to write to, e.g. std::ostringstream.
+    * @return true on success, false on error.
+    * @note Throws rspfException on error.
+    */
+   bool writeChip(std::ostream& out);
+
+   /** @brief Clears all options and chains. */
+   void clear();
+
+   /**
+    * @param key Option key.
+    * @return true if key only effects the view, area of interest or the
+    * output, i.e. can be changed by reinitialize; false, if not.
+    */
+   static bool isChipOption(const std::string& key);
+
    /**
     * @brief Gets the output file name.
     * @param f Initialized by this with the filename.
@@ -119,6 +184,24 @@ public:
 
 private:
 
+   /**
+    * @brief Initializes m_operation from the operation keyword.
+    * @note Throws rspfException on error.
+    */
+   void initializeOperation();
+
+   /**
+    * @brief Checks input count and options against the operation.
+    * @note Throws rspfException on error.
+    */
+   void validateOperation() const;
+
+   /**
+    * @brief Disconnects anything connected to the outputs of the dem and image
+    * layers, i.e. the chain head made by initializeChain.
+    */
+   void disconnectLayerOutputs();
+
    /**
     * @brief Initializes the output projection and propagates to image chains.
     * @note Throws rspfException on error.
@@ -340,6 +423,12 @@ private:
     */
    rspfRefPtr<rspfImageFileWriter> createNewWriter() const;
 
+   /**
+    * @brief Sets any writer_property options on writer.
+    * @param writer Writer to set properties on.
+    */
+   void setWriterProperties(rspfImageFileWriter* writer) const;
+
    /**
     * @brief loops through all chains and sets the output projection.
     * @note Throws rspfException on error.
@@ -0,0 +1,239 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfWebTileExporter.h
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  See description for class below.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#ifndef rspfWebTileExporter_HEADER
+#define rspfWebTileExporter_HEADER 1
+
+#include <rspf/base/rspfConstants.h>
+#include <rspf/base/rspfReferenced.h>
+#include <rspf/base/rspfRefPtr.h>
+#include <rspf/base/rspfFilename.h>
+#include <rspf/base/rspfIrect.h>
+#include <rspf/base/rspfString.h>
+#include <OpenThreads/Mutex>
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+class rspfImageChain;
+class rspfImageData;
+class rspfImageSource;
+class rspfKeywordlist;
+class rspfMapProjection;
+
+/**
+ * @class rspfWebTileExporter
+ *
+ * Writes a web map tile pyramid, <dir>/<z>/<x>/<y>.<png|jpg>, in Web
+ * Mercator(EPSG:900913) from an image chain with a view(renderer).
+ *
+ * Tiles are 256 x 256.  Only the highest zoom is rendered by the chain; the
+ * renderer picks the handler overview level for that resolution.  Each lower
+ * zoom tile is the 2 x 2 average of its four already rendered children, null
+ * aware, so nothing is rendered twice.
+ *
+ * The pyramid is split into subtrees rooted at the first zoom with enough
+ * tiles to keep every thread busy.  Each thread renders, reduces, encodes and
+ * writes its subtrees depth first on its own clone of the chain
+ * (rspfImageChainMtAdaptor), so memory stays at a few tiles per zoom per
+ * thread.  The zooms above the split are built from the subtree roots at the
+ * end.
+ *
+ * Tiles outside the chain's bounding rectangle are never requested; tiles
+ * that come back all null, and parents of only null children, are not
+ * written.
+ *
+ * Output is 8 bit: one band is written as gray, three or more as RGB from
+ * the first three bands.  Other scalar types are stretched from the input's
+ * min/max pixel values, so tiles do not seam.  PNG tiles carry alpha, zero where null; JPEG tiles are black
+ * there.
+ *
+ * Keywords for loadState, e.g. with prefix "igen.web_tiles.":
+ * <pre>
+ * output_directory: /data/tiles
+ * min_zoom:         0
+ * max_zoom:         14
+ * scheme:           xyz          // or tms(y up)
+ * format:           png          // or jpeg
+ * jpeg_quality:     75
+ * png_compression:  1            // zlib level 0 - 9
+ * threads:          0            // 0 = rspf::getNumberOfThreads
+ * </pre>
+ */
+class RSPF_DLL rspfWebTileExporter : public rspfReferenced
+{
+public:
+
+   enum Scheme
+   {
+      XYZ = 0, ///< y = 0 at the top(Google, OSM).
+      TMS = 1  ///< y = 0 at the bottom.
+   };
+
+   enum Format
+   {
+      PNG  = 0,
+      JPEG = 1
+   };
+
+   /** Tile width and height in pixels. */
+   static const rspf_uint32 TILE_SIZE;
+
+   /** @brief Default constructor. */
+   rspfWebTileExporter();
+
+   /**
+    * @brief Sets the chain to export.  Its view is replaced.  The chain is
+    * taken apart into per thread clones by execute so should not be used
+    * for anything else after.
+    */
+   void setInput(rspfImageChain* chain);
+
+   void setOutputDirectory(const rspfFilename& dir);
+   const rspfFilename& getOutputDirectory() const;
+
+   /** @brief Sets the zoom range, clamped to 0 - 23(int pixel space). */
+   void setZoomLevels(rspf_uint32 minZoom, rspf_uint32 maxZoom);
+   rspf_uint32 getMinZoom() const;
+   rspf_uint32 getMaxZoom() const;
+
+   void setScheme(Scheme scheme);
+   Scheme getScheme() const;
+
+   void setFormat(Format format);
+   Format getFormat() const;
+
+   /** @param quality 1 - 100. */
+   void setJpegQuality(rspf_int32 quality);
+
+   /** @param level zlib level, 0 - 9.  Default 1, fastest that compresses. */
+   void setPngCompressionLevel(rspf_int32 level);
+
+   /** @param threads Zero = rspf::getNumberOfThreads(). */
+   void setNumberOfThreads(rspf_uint32 threads);
+
+   /**
+    * @brief Initializes from keywords listed in the class description.
+    * @return true if max_zoom was found.
+    */
+   bool loadState(const rspfKeywordlist& kwl, const char* prefix=0);
+
+   /**
+    * @brief Writes the pyramid.
+    * @return false if nothing could be set up or a tile could not be
+    * written.
+    */
+   bool execute();
+
+   /** @return Tiles written by the last execute. */
+   rspf_uint64 getTilesWritten() const;
+
+   /**
+    * @return Web Mercator projection whose view pixels at zoom are global
+    * pixels, i.e. tile (x, y) is the rectangle x*256, y*256 to
+    * x*256+255, y*256+255.
+    */
+   static rspfMapProjection* createProjection(rspf_uint32 zoom);
+
+   /**
+    * @brief PNG encodes 8 bit pixels.
+    * @param pixels Interleaved, rows top down.
+    * @param channels 1 gray, 3 RGB, 4 RGBA.
+    * @param level zlib level.
+    * @param out Initialized to the file bytes.
+    * @return false on error.
+    */
+   static bool encodePng(const rspf_uint8* pixels,
+                         rspf_uint32 width,
+                         rspf_uint32 height,
+                         rspf_uint32 channels,
+                         rspf_int32 level,
+                         std::vector<rspf_uint8>& out);
+
+protected:
+
+   /** @brief Subtree worker; see rspfWebTileExporter.cpp. */
+   class Job;
+   friend class Job;
+
+   /** @brief Protected destructor. */
+   virtual ~rspfWebTileExporter();
+
+   /** One tile, RGBA interleaved, TILE_SIZE x TILE_SIZE. */
+   typedef std::vector<rspf_uint8> Raster;
+
+   typedef std::pair<rspf_uint32, rspf_uint32> TileXy;
+
+   /**
+    * @brief Builds tile (zoom, x, y) depth first from source and writes it
+    * and everything under it.
+    * @return false if the tile is empty.
+    */
+   bool buildTile(rspfImageSource* source, rspf_uint32 zoom, rspf_uint32 x,
+                  rspf_uint32 y, Raster& raster);
+
+   /** @return true if the tile's footprint at max zoom meets the input. */
+   bool intersectsInput(rspf_uint32 zoom, rspf_uint32 x, rspf_uint32 y) const;
+
+   /**
+    * @brief Copies a rendered tile into raster as RGBA.
+    * @return false if every pixel is null.
+    */
+   static bool toRaster(const rspfImageData* tile, Raster& raster);
+
+   /** @brief 2 x 2 reduces child into quadrant (qx, qy) of parent. */
+   static void reduce(const Raster& child, rspf_uint32 qx, rspf_uint32 qy, Raster& parent);
+
+   /** @brief Encodes and writes one tile. */
+   bool writeTile(rspf_uint32 zoom, rspf_uint32 x, rspf_uint32 y, const Raster& raster);
+
+   /** @brief Counts a written tile or a failure, thread safe. */
+   void tileDone(bool ok);
+
+   /** @brief Hands out the next subtree root, thread safe. */
+   bool nextRoot(TileXy& root);
+
+   /** @brief Keeps a subtree root for the zooms above the split. */
+   void keepRoot(const TileXy& root, const Raster& raster);
+
+   /** @brief Builds and writes the zooms above the split from m_roots. */
+   void buildTopZooms();
+
+   rspfRefPtr<rspfImageChain> m_chain;
+   rspfFilename               m_outputDirectory;
+   rspf_uint32                m_minZoom;
+   rspf_uint32                m_maxZoom;
+   Scheme                     m_scheme;
+   Format                     m_format;
+   rspf_int32                 m_jpegQuality;
+   rspf_int32                 m_pngLevel;
+   rspf_uint32                m_threads;
+
+   /** Chain bounding rectangle in max zoom pixels. */
+   rspfIrect                  m_inputRect;
+   rspf_uint32                m_splitZoom;
+
+   std::vector<TileXy>        m_rootList;
+   size_t                     m_nextRoot;
+   std::map<TileXy, Raster>   m_roots;
+   std::set<std::string>      m_directories;
+
+   rspf_uint64                m_written;
+   bool                       m_failed;
+   OpenThreads::Mutex         m_mutex;
+};
+
+#endif /* #ifndef rspfWebTileExporter_HEADER */
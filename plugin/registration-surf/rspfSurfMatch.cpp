@@ -8,10 +8,44 @@ using namespace std;
 #include <rspf/imaging/rspfImageHandler.h>
 #include <rspf/base/rspfTrace.h>
 #include <rspf/base/rspfNotifyContext.h>
+#include <rspf/base/rspfCommon.h>
+#include <rspf/parallel/rspfJob.h>
+#include <rspf/parallel/rspfJobMultiThreadQueue.h>
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 static rspfTrace traceDebug("rspfSurfMatch:debug");
 
-#define TILE_SIZE	512
+#define TILE_SIZE	1024
+#define SURF_OCTAVES	4 //cvSURFParams defaults, set explicitly : the overlap depends on them
+#define SURF_OCTAVE_LAYERS	2
+
+//---
+// Support radius of a SURF keypoint, i.e. the margin read around each tile so
+// keypoints of the core get the same response and descriptor as untiled.
+// Largest box filter : (9 + 6*(layers+1)) << (octaves-1) (216 px for 4/2), its
+// scale s = size*1.2/9; the rotated descriptor window is 21s wide, so reaches
+// 10.5*sqrt(2)*s from the keypoint (428 px for 4/2).  This covers the filter
+// half size and the 6s orientation window.
+//---
+static rspf_int32 getSurfSupportRadius(int octaves, int layers)
+{
+	const double size  = (double)((9 + 6*(layers+1)) << (octaves-1));
+	const double scale = size * 1.2 / 9.0;
+	return (rspf_int32)std::ceil(10.5 * std::sqrt(2.0) * scale) + 1;
+}
+
+static const rspf_int32 TILE_OVERLAP = getSurfSupportRadius(SURF_OCTAVES, SURF_OCTAVE_LAYERS);
+
+static const char SURF_CACHE_MAGIC[] = "rspf_surf_features 1";
 
 RTTI_DEF2(rspfSurfMatch, "rspfSurfMatch",
           rspfOutputSource, rspfProcessInterface);
@@ -32,7 +66,9 @@ rspfSurfMatch::rspfSurfMatch(rspfImageSource* inputSource)
 	  theSlaverBand(0),
 	  theMasterFilename(""),
 	  theSlaverFilename(""),
-	  theOutputFilename("")
+	  theOutputFilename(""),
+	  theThreads(0),
+	  theCacheDirectory("")
 {
    connectMyInputTo(0, inputSource);
    theAreaOfInterest.makeNan();
@@ -70,6 +106,14 @@ void rspfSurfMatch::setProperty(rspfRefPtr<rspfProperty> property)
 	{
 		theOutputFilename = property->valueToString();
 	}
+	if(name == "threads")
+	{
+		theThreads = property->valueToString().toUInt32();
+	}
+	if(name == "feature_cache_directory")
+	{
+		theCacheDirectory = property->valueToString();
+	}
 	else
 	{
 		rspfOutputSource::setProperty(property);
@@ -117,6 +161,19 @@ rspfRefPtr<rspfProperty> rspfSurfMatch::getProperty(const rspfString& name)const
 		rspfNumericProperty* numeric = new rspfNumericProperty(name, theOutputFilename);
 		return numeric;
 	}
+	if(name == "threads")
+	{
+		rspfNumericProperty* numeric = new rspfNumericProperty(name,
+			rspfString::toString(theThreads));
+		numeric->setNumericType(rspfNumericProperty::rspfNumericPropertyType_UINT);
+		numeric->setCacheRefreshBit();
+		return numeric;
+	}
+	if(name == "feature_cache_directory")
+	{
+		rspfNumericProperty* numeric = new rspfNumericProperty(name, theCacheDirectory);
+		return numeric;
+	}
 
 	return rspfOutputSource::getProperty(name);
 }
@@ -130,52 +187,191 @@ void rspfSurfMatch::getPropertyNames(std::vector<rspfString>& propertyNames)cons
 	propertyNames.push_back("master_band");
 	propertyNames.push_back("slaver_band");
 	propertyNames.push_back("output_filename");
+	propertyNames.push_back("threads");
+	propertyNames.push_back("feature_cache_directory");
 }
 
-void rspfSurfMatch::addElementToList(CvSeq** root, CvSeq *elem)
+//---
+// Tiles of one getFeatures run : hands out tile indices to the workers, keeps
+// one feature slot per tile (only written by the worker extracting the tile)
+// and lets the caller merge tiles in order as they complete.
+//---
+class rspfSurfTileQueue : public rspfReferenced
 {
-	//if(*root)
-	//{
-	//	elem->h_next = *root;
-	//	(*root)->h_prev = elem;
-	//}
-	//else
-	//	elem->h_next = 0;
-
-	//*root = elem;
-	//(*root)->h_prev = 0;
-
-	int length = (int)((*root)->elem_size/sizeof(float));
-	int length1 = (int)(elem->elem_size/sizeof(float));
-	assert( length == length1);
-
-	CvSeqWriter seqWriter;
-	cvStartAppendToSeq(*root, &seqWriter);
-	CvSeqReader obj_reader;
-	cvStartReadSeq( elem, &obj_reader );
-	//int elem_size = (seqWriter).seq->elem_size;
-	//seqWriter.ptr += elem_size * seqWriter.seq->total;
-
-	for (int i = 0;i < (int)elem->total;++i)
-	{
-		CV_NEXT_SEQ_ELEM( obj_reader.seq->elem_size, obj_reader );
-		//int memLength = sizeof(data);
-		//int length = (int)(data->elem_size/sizeof(float));
-		CV_WRITE_SEQ_ELEM_VAR( obj_reader.ptr, seqWriter );
-		//CV_WRITE_SEQ_ELEM(*(CvSURFPoint*)cvGetSeqElem(elem, i), seqWriter);
-		//assert( elem_size == sizeof(data));
-		//if( (seqWriter).ptr >= (seqWriter).block_max )
-		//{
-		//	cvCreateSeqBlock( &seqWriter);
-		//}
-		//assert( (seqWriter).ptr <= (seqWriter).block_max - elem_size);
-		//memcpy((seqWriter).ptr, obj_reader.ptr, elem_size);
-		//(seqWriter).ptr += elem_size;
-	}
-	cvEndWriteSeq(&seqWriter);
-	//int num = seqWriter.seq->total;
-	//cout<<num<<endl;
-}
+public:
+   rspfSurfTileQueue(const rspfIrect& aoi, rspf_uint32 workers)
+      : m_aoi(aoi),
+        m_tilecols((aoi.width()+TILE_SIZE-1) / TILE_SIZE),
+        m_tiles(m_tilecols * ((aoi.height()+TILE_SIZE-1) / TILE_SIZE)),
+        m_next(0),
+        m_workers(workers),
+        m_features(m_tiles),
+        m_done(m_tiles, false),
+        m_mutex(),
+        m_condition(),
+        m_inputMutex()
+   {
+   }
+
+   rspf_uint32 getNumberOfTiles()const { return m_tiles; }
+
+   //! next tile to extract, false when none left or stopped
+   bool nextTile(rspf_uint32& index)
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      if (m_next >= m_tiles)
+      {
+         return false;
+      }
+      index = m_next++;
+      return true;
+   }
+
+   //! tile without overlap, clipped to the area of interest
+   rspfIrect getCoreRect(rspf_uint32 index)const
+   {
+      rspfIpt ul(m_aoi.ul().x + (rspf_int32)(index % m_tilecols) * TILE_SIZE,
+                 m_aoi.ul().y + (rspf_int32)(index / m_tilecols) * TILE_SIZE);
+      rspfIrect core(ul, rspfIpt(ul.x+TILE_SIZE-1, ul.y+TILE_SIZE-1));
+      return core.clipToRect(m_aoi);
+   }
+
+   //! rectangle read for a tile : core plus overlap, clipped to the area of interest
+   rspfIrect getReadRect(rspf_uint32 index)const
+   {
+      rspfIrect core = getCoreRect(index);
+      rspfIrect rect(core.ul() - rspfIpt(TILE_OVERLAP,TILE_OVERLAP),
+                     core.lr() + rspfIpt(TILE_OVERLAP,TILE_OVERLAP));
+      return rect.clipToRect(m_aoi);
+   }
+
+   rspfSurfMatch::FeatureSet& getFeatures(rspf_uint32 index) { return m_features[index]; }
+
+   void tileDone(rspf_uint32 index)
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      m_done[index] = true;
+      m_condition.broadcast();
+   }
+
+   void workerDone()
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      --m_workers;
+      m_condition.broadcast();
+   }
+
+   //! blocks until tile index is extracted, false if it never will be (stopped)
+   bool waitForTile(rspf_uint32 index)
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      while (!m_done[index] && m_workers)
+      {
+         m_condition.wait(&m_mutex);
+      }
+      return m_done[index];
+   }
+
+   //! stops handing out tiles and waits for the workers to return
+   void stop()
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      m_next = m_tiles;
+      while (m_workers)
+      {
+         m_condition.wait(&m_mutex);
+      }
+   }
+
+   //! serializes reads of the image source
+   OpenThreads::Mutex& getInputMutex() { return m_inputMutex; }
+
+protected:
+   virtual ~rspfSurfTileQueue() {}
+
+   rspfIrect                                m_aoi;
+   rspf_uint32                              m_tilecols;
+   rspf_uint32                              m_tiles;
+   rspf_uint32                              m_next;
+   rspf_uint32                              m_workers;
+   std::vector<rspfSurfMatch::FeatureSet>  m_features;
+   std::vector<bool>                        m_done;
+   OpenThreads::Mutex                       m_mutex;
+   OpenThreads::Condition                   m_condition;
+   OpenThreads::Mutex                       m_inputMutex;
+};
+
+//---
+// Worker : copies a tile out of the source, then runs SURF on it while the
+// other workers read or extract theirs.
+//---
+class rspfSurfTileJob : public rspfJob
+{
+public:
+   rspfSurfTileJob(const rspfSurfMatch* match, rspfImageSource* source, int band, rspfSurfTileQueue* tiles)
+      : m_match(match),
+        m_source(source),
+        m_band(band),
+        m_tiles(tiles)
+   {
+   }
+
+   virtual void start()
+   {
+      running();
+      run();
+      m_tiles->workerDone();
+      finished();
+   }
+
+   void run()
+   {
+      std::vector<unsigned char> buf;
+      rspf_uint32 index = 0;
+      while (m_tiles->nextTile(index))
+      {
+         rspfIrect rect = m_tiles->getReadRect(index);
+         int w = (int)rect.width();
+         int h = (int)rect.height();
+         bool valid = false;
+         {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_tiles->getInputMutex());
+            rspfRefPtr<rspfImageData> data = m_source->getTile(rect, 0);
+            if ( data.valid() &&
+                 (data->getDataObjectStatus() != RSPF_NULL) &&
+                 (data->getDataObjectStatus() != RSPF_EMPTY) &&
+                 ((rspf_uint32)m_band < data->getNumberOfBands()) )
+            {
+               //8 bit data assumed, as for the whole match
+               const unsigned char* p = static_cast<const unsigned char*>(data->getBuf(m_band));
+               buf.assign(p, p + w*h);
+               valid = true;
+            }
+         }
+         if (valid)
+         {
+            try
+            {
+               m_match->extractFeatures(&buf[0], w, h, rect.ul(), m_tiles->getCoreRect(index),
+                                        m_tiles->getFeatures(index));
+            }
+            catch (const cv::Exception& e)
+            {
+               rspfNotify(rspfNotifyLevel_WARN)
+                  << "rspfSurfMatch::getFeatures WARNING: SURF failed on tile " << index
+                  << " : " << e.what() << std::endl;
+            }
+         }
+         m_tiles->tileDone(index);
+      }
+   }
+
+private:
+   const rspfSurfMatch*              m_match;
+   rspfImageSource*                  m_source;
+   int                                m_band;
+   rspfRefPtr<rspfSurfTileQueue>     m_tiles;
+};
 
 bool rspfSurfMatch::execute()
 {
@@ -186,8 +382,6 @@ bool rspfSurfMatch::execute()
 
 
    // -- 1 -- create source handlers
-   //rspfImageChain* theMChain = new rspfImageChain;
-   //rspfImageChain* theSChain = new rspfImageChain;
    rspfRefPtr<rspfImageHandler> handlerM = rspfImageHandlerRegistry::instance()->open(theMasterFilename);
 
    if (!handlerM)
@@ -195,55 +389,41 @@ bool rspfSurfMatch::execute()
 	   cerr<<"rspfImageCorrelator"<<"::execute can't create handler for master image "<< theMasterFilename <<endl;
 	   return false;
    }
-   //rspfImageSourceSequencer* theImageSourceSequencer = PTR_CAST(rspfImageSourceSequencer, handlerM.get());
-   //theImageSourceSequencer->setTileSize(rspfIpt(1024,1024));
    theMasterSource = handlerM.get();
    rspfRefPtr<rspfImageHandler> handlerS = rspfImageHandlerRegistry::instance()->open(theSlaverFilename);
-   //handlerM->connectMyInputTo(0, theImageSourceSequencer);
    if (!handlerS)
    {
 	   cerr<<"rspfImageCorrelator"<<"::execute can't create handler for slave image  "<< theSlaverFilename <<endl;
 	   return false;
    }
-   //theSChain->add(handlerS.get());
    theSlaverSource = handlerS.get();
-   
-   //open stream
-   //open();
-
-   //setProcessStatus(rspfProcessInterface::PROCESS_STATUS_EXECUTING);
-   
 
    //do the actual work there
-   CvSeq* MasterKeypoints = 0;
-   CvSeq* MasterDescriptors = 0;
-   CvSeq* SlaverKeypoints = 0;
-   CvSeq* SlaverDescriptors = 0;
-
-
    cv::initModule_nonfree();
 
-   CvMemStorage* storage = cvCreateMemStorage(0);
-   MasterKeypoints = cvCreateSeq(0, sizeof(CvSeq), sizeof(CvSURFPoint), storage);
-   SlaverKeypoints = cvCreateSeq(0, sizeof(CvSeq), sizeof(CvSURFPoint), storage);
-   if (status) status = getMasterFeatures( &MasterKeypoints, &MasterDescriptors);
-   if (status) status = getSlaverFeatures( &SlaverKeypoints, &SlaverDescriptors);
-   
+   FeatureSet masterFeatures;
+   FeatureSet slaverFeatures;
+   if (status) status = getMasterFeatures(masterFeatures);
+   if (status) status = getSlaverFeatures(slaverFeatures);
+   if (!status)
+   {
+      return false;
+   }
 
    vector<int> ptpairs;
-   flannFindPairs( MasterKeypoints, MasterDescriptors, SlaverKeypoints, SlaverDescriptors, ptpairs );
+   findPairs( masterFeatures, slaverFeatures, ptpairs );
 
    //-- Create input data
    arma::mat dataPoints((int)ptpairs.size()/2, 4);// = "0 0; 1 1; 2 2; 3 3";
    for(int i = 0;i < (int)ptpairs.size()/2;++i)
    {
-	   CvSURFPoint* r1 = (CvSURFPoint*)cvGetSeqElem( MasterKeypoints, ptpairs[2*i] );
-	   CvSURFPoint* r2 = (CvSURFPoint*)cvGetSeqElem( SlaverKeypoints, ptpairs[2*i+1] );
+	   const CvSURFPoint& r1 = masterFeatures.keypoints[ptpairs[2*i]];
+	   const CvSURFPoint& r2 = slaverFeatures.keypoints[ptpairs[2*i+1]];
 
-	   dataPoints(i, 0) = r1->pt.x;
-	   dataPoints(i, 1) = r1->pt.y;
-	   dataPoints(i, 2) = r2->pt.x;
-	   dataPoints(i, 3) = r2->pt.y;
+	   dataPoints(i, 0) = r1.pt.x;
+	   dataPoints(i, 1) = r1.pt.y;
+	   dataPoints(i, 2) = r2.pt.x;
+	   dataPoints(i, 3) = r2.pt.y;
    }
 
    // RANSAC detect outliers
@@ -296,254 +476,329 @@ bool rspfSurfMatch::execute()
    return status;
 }
 
-bool rspfSurfMatch::ExtractTile(rspfImageSource* imageSource,
-								const rspfIrect& tileRect,
-								int iband/* = 0*/,
-								rspf_uint32 resLevel/* = 0*/,
-								CvSeq** Keypoints/* = NULL*/,
-								CvSeq** Descriptors/* = NULL*/)
+void rspfSurfMatch::extractFeatures(const unsigned char* buf, int w, int h,
+                                     const rspfIpt& origin, const rspfIrect& core,
+                                     FeatureSet& features)const
 {
-
-	if(!isSourceEnabled())
-	{
-		return false;
-	}
-	long w     = tileRect.width();
-	long h     = tileRect.height();
-	
-	rspfRefPtr<rspfImageData> data = 0;
-	if(imageSource)
-	{
-		data  = imageSource->getTile(tileRect, resLevel);
-	} else {
-		return false;
-	}
-
-	if(!data.valid()) return 0;
-	if(data->getDataObjectStatus() == RSPF_NULL ||  data->getDataObjectStatus() == RSPF_EMPTY)
-	{
-		return false;
-	}
-
-	IplImage *input = cvCreateImageHeader(cvSize(w, h),8,1);
-	
-	input->imageData = static_cast<char*>(data->getBuf(iband));
+	IplImage* input = cvCreateImageHeader(cvSize(w, h), IPL_DEPTH_8U, 1);
+	cvSetData(input, const_cast<unsigned char*>(buf), w);
 
 	CvMemStorage* storage = cvCreateMemStorage(0);
 	CvSURFParams params = cvSURFParams(theHessianThreshold, 1);
+	params.nOctaves = SURF_OCTAVES;
+	params.nOctaveLayers = SURF_OCTAVE_LAYERS;
 	CvSeq* KeypointsTemp = 0;
 	CvSeq* DescriptorsTemp = 0;
 	cvExtractSURF(input, NULL, &KeypointsTemp, &DescriptorsTemp, storage, params);
 
-
-	//CvSeq *KeypointsNew=NULL;
-	//KeypointsNew = cvCreateSeq(0, sizeof(CvSeq), sizeof(CvSURFPoint), storage);
-
-	for (int i = 0;i < KeypointsTemp->total;++i)
-	{
-		CvSURFPoint* corner = (CvSURFPoint*)cvGetSeqElem(KeypointsTemp,i);
-		corner->pt.x += tileRect.ul().x;
-		corner->pt.y += tileRect.ul().y;
-		//int t = sizeof(corner);
-		//CV_WRITE_SEQ_ELEM( corner, seqWriter );
-		cvSeqPush(*Keypoints, corner);
-	}
-	//for( int i = 0; i < DescriptorsTemp->total; i++ )
-	//{
-	//	if( _keypoints )
-	//	{
-	//		CvSURFPoint pt = cvSURFPoint(kpt[i].pt, kpt[i].class_id, cvRound(kpt[i].size), kpt[i].angle, kpt[i].response);
-	//		cvSeqPush(*_keypoints, &pt);
-	//	}
-	//	if( _descriptors )
-	//		cvSeqPush(*_descriptors, descr.ptr((int)i));
-	//}
-	
-	
-	//if (!*Keypoints)
-	//{
-	//	*Keypoints = cvCloneSeq(KeypointsNew);
-	//}
-	//else
-	//{
-	//	addElementToList(Keypoints, KeypointsNew);
-
-	//}
-	
-	if (!*Descriptors)
-	{
-		*Descriptors = cvCloneSeq(DescriptorsTemp);
-	}
-	else
+	if (KeypointsTemp && DescriptorsTemp)
 	{
-		addElementToList(Descriptors, DescriptorsTemp);
-	}
+		features.length = (int)(DescriptorsTemp->elem_size/sizeof(float));
 
-	int num = (*Keypoints)->total;
+		CvSeqReader kreader;
+		CvSeqReader dreader;
+		cvStartReadSeq(KeypointsTemp, &kreader);
+		cvStartReadSeq(DescriptorsTemp, &dreader);
+		for (int i = 0;i < KeypointsTemp->total;++i)
+		{
+			CvSURFPoint corner = *(const CvSURFPoint*)kreader.ptr;
+			const float* descriptor = (const float*)dreader.ptr;
+			CV_NEXT_SEQ_ELEM( kreader.seq->elem_size, kreader );
+			CV_NEXT_SEQ_ELEM( dreader.seq->elem_size, dreader );
+
+			corner.pt.x += origin.x;
+			corner.pt.y += origin.y;
+			//keep keypoints of the tile core only : the overlap belongs to the neighbours
+			if ( (corner.pt.x <  core.ul().x) || (corner.pt.y <  core.ul().y) ||
+			     (corner.pt.x >= core.lr().x+1) || (corner.pt.y >= core.lr().y+1) )
+			{
+				continue;
+			}
+			features.keypoints.push_back(corner);
+			features.descriptors.insert(features.descriptors.end(), descriptor, descriptor+features.length);
+		}
+	}
 
+	cvReleaseMemStorage(&storage);
 	cvReleaseImageHeader(&input);
-
-	return true;
 }
 
-bool rspfSurfMatch::getMasterFeatures(CvSeq** Keypoints, CvSeq** Descriptors)
+bool rspfSurfMatch::getFeatures(rspfImageSource* imageSource,
+                                 const rspfIrect& aoi,
+                                 int iband,
+                                 double progressStart,
+                                 double progressEnd,
+                                 FeatureSet& features)
 {
-	static const char MODULE[] = "rspfTieGenerator::getAllFeatures";
+	static const char MODULE[] = "rspfSurfMatch::getFeatures";
 
 	if (traceDebug()) CLOG << " Entered..." << endl;
 
-	rspfImageSource* master = theMasterSource.get();
-	if (!master)
+	if (!imageSource || aoi.hasNans())
 	{
 		rspfNotify(rspfNotifyLevel_WARN)
-			<< "WARN rspfTieGenerator::scanForEdges():"
-			<< "\nInput source is not a rspfImageChip.  Returning..." << std::endl;
+			<< "WARN rspfSurfMatch::getFeatures():"
+			<< "\nNo input source.  Returning..." << std::endl;
 		return false;
 	}
-	// Some constants needed throughout...
-	//const rspf_int32 TILE_HEIGHT    = master->getTileHeight();
-	//const rspf_int32 TILE_WIDTH     = master->getTileWidth();
-	//const rspf_int32 START_LINE = master->getBoundingRect().ul().y;
-	//const rspf_int32 STOP_LINE  = master->getBoundingRect().lr().y;
-	//const rspf_int32 START_SAMP = master->getBoundingRect().ul().x;
-	//const rspf_int32 STOP_SAMP  = master->getBoundingRect().lr().x;
-
-	const rspf_int32 TILE_HEIGHT    = TILE_SIZE;
-	const rspf_int32 TILE_WIDTH     = TILE_SIZE;
-	const rspf_int32 START_LINE = master->getBoundingRect().ul().y;
-	const rspf_int32 STOP_LINE  = master->getBoundingRect().lr().y;
-	const rspf_int32 START_SAMP = master->getBoundingRect().ul().x;
-	const rspf_int32 STOP_SAMP  = master->getBoundingRect().lr().x;
-
-	// For percent complete status.
-	rspf_int32 tilerows=(STOP_LINE-START_LINE+TILE_HEIGHT) / TILE_HEIGHT; //ceil : (stop-start+1+size-1)/size
-	rspf_int32 tilecols=(STOP_SAMP-START_SAMP+TILE_WIDTH) / TILE_WIDTH;
-	double total_tiles = ((double)tilerows)*tilecols;
-	double tiles_processed = 0.0;
-
-	// Set the status message to be "scanning source for edges..."
-	rspfNotify(rspfNotifyLevel_INFO) << "Getting tie points..." << std::endl;
-
-	// Start off with a percent complete at 0...
-	setPercentComplete(0.0);
-
-	// loop through all tiles
-	// need to use a sequencer for parallelism in the future TBD
-	//theTiePoints.clear();
-	rspf_int32 line=START_LINE;
-	rspf_int32 i,j;
-	
-	rspf_uint32 resLevel = 0;
-	for (i=0;(i<tilerows)&&!needsAborting();++i)
-	{
-		rspf_int32 samp=START_SAMP;
-		for (j=0;(j<tilecols)&&!needsAborting();++j )
-		{
-			// Get the tie points
-			//TBC : can we go further than source edges with edge tiles?? TBD
-			rspfIrect tileRect = rspfIrect(rspfIpt(samp, line),rspfIpt(samp+TILE_WIDTH-1,line+TILE_HEIGHT-1));
-			
-			ExtractTile(master, tileRect, theMasterBand, resLevel, Keypoints, Descriptors);
 
-			samp+=TILE_WIDTH;
-			// Set the percent complete.
-			tiles_processed += 1.0;
-			setPercentComplete(tiles_processed/total_tiles*50.0);
+	rspf_uint32 threads = theThreads ? theThreads : rspf::getNumberOfThreads();
+	if (threads < 1) threads = 1;
 
-			//DEBUG TBR TBC
-			// std::cout<<"p="<<tiles_processed/total_tiles*100.0<<std::endl;
+	const rspf_uint32 total_tiles = ((aoi.width()+TILE_SIZE-1) / TILE_SIZE) *
+	                                ((aoi.height()+TILE_SIZE-1) / TILE_SIZE);
+	if (threads > total_tiles) threads = total_tiles;
+	rspfRefPtr<rspfSurfTileQueue> tiles = new rspfSurfTileQueue(aoi, threads);
 
+	rspfNotify(rspfNotifyLevel_INFO) << "Getting features..." << std::endl;
+	setPercentComplete(progressStart);
+
+	// with one thread the job runs here, else on a thread pool
+	rspfRefPtr<rspfJobMultiThreadQueue> queue;
+	if (threads > 1)
+	{
+		queue = new rspfJobMultiThreadQueue(new rspfJobQueue(), threads);
+		for (rspf_uint32 t = 0;t < threads;++t)
+		{
+			rspfRefPtr<rspfJob> job = new rspfSurfTileJob(this, imageSource, iband, tiles.get());
+			queue->getJobQueue()->add(job.get(), false);
+		}
+	}
+	else
+	{
+		rspfRefPtr<rspfSurfTileJob> job = new rspfSurfTileJob(this, imageSource, iband, tiles.get());
+		job->start();
+	}
+
+	// merge in tile order : same features whatever the number of threads
+	features = FeatureSet();
+	rspf_uint32 k = 0;
+	for (;(k<total_tiles)&&!needsAborting();++k)
+	{
+		if (!tiles->waitForTile(k))
+		{
+			break;
 		}
-		line+=TILE_HEIGHT;
+		FeatureSet& tf = tiles->getFeatures(k);
+		if (tf.length)
+		{
+			features.length = tf.length;
+		}
+		features.keypoints.insert(features.keypoints.end(), tf.keypoints.begin(), tf.keypoints.end());
+		features.descriptors.insert(features.descriptors.end(), tf.descriptors.begin(), tf.descriptors.end());
+		tf = FeatureSet(); //release tile memory
+
+		setPercentComplete(progressStart + (k+1.0)/total_tiles*(progressEnd-progressStart));
 	}
+	tiles->stop();
 
-	setPercentComplete(50.0);
+	setPercentComplete(progressEnd);
 	if (traceDebug()) CLOG << " Exited." << endl;
-	return true;
+	return (k == total_tiles);
 }
 
-bool rspfSurfMatch::getSlaverFeatures(CvSeq** Keypoints, CvSeq** Descriptors)
+bool rspfSurfMatch::getImageFeatures(rspfImageSource* imageSource,
+                                      const rspfFilename& imageFile,
+                                      const rspfIrect& aoi,
+                                      int iband,
+                                      double progressStart,
+                                      double progressEnd,
+                                      FeatureSet& features)
 {
-	static const char MODULE[] = "rspfTieGenerator::getAllFeatures";
+	rspfString key;
+	rspfFilename cacheFile;
+	if (theCacheDirectory.size())
+	{
+		key       = getCacheKey(imageFile, aoi, iband);
+		cacheFile = getCacheFile(imageFile, key);
+		if (loadFeatures(cacheFile, key, features))
+		{
+			rspfNotify(rspfNotifyLevel_INFO)
+				<< "rspfSurfMatch: " << features.keypoints.size()
+				<< " features of " << imageFile << " read from " << cacheFile << std::endl;
+			setPercentComplete(progressEnd);
+			return true;
+		}
+	}
 
-	if (traceDebug()) CLOG << " Entered..." << endl;
+	if (!getFeatures(imageSource, aoi, iband, progressStart, progressEnd, features))
+	{
+		return false;
+	}
 
+	if (cacheFile.size() && !saveFeatures(cacheFile, key, features))
+	{
+		rspfNotify(rspfNotifyLevel_WARN)
+			<< "rspfSurfMatch WARNING: cannot write feature cache " << cacheFile << std::endl;
+	}
+	return true;
+}
+
+bool rspfSurfMatch::getMasterFeatures(FeatureSet& features)
+{
+	rspfImageSource* master = theMasterSource.get();
+	if (!master)
+	{
+		return false;
+	}
+	rspfIrect aoi = master->getBoundingRect();
+	if (!theAreaOfInterest.hasNans())
+	{
+		aoi = aoi.clipToRect(theAreaOfInterest);
+	}
+	return getImageFeatures(master, theMasterFilename, aoi, theMasterBand, 0.0, 50.0, features);
+}
+
+bool rspfSurfMatch::getSlaverFeatures(FeatureSet& features)
+{
 	rspfImageSource* slaver = theSlaverSource.get();
 	if (!slaver)
 	{
-		rspfNotify(rspfNotifyLevel_WARN)
-			<< "WARN rspfTieGenerator::scanForEdges():"
-			<< "\nInput source is not a rspfImageChip.  Returning..." << std::endl;
 		return false;
 	}
+	return getImageFeatures(slaver, theSlaverFilename, slaver->getBoundingRect(), theSlaverBand, 50.0, 100.0, features);
+}
 
-	// Some constants needed throughout...
-	//const rspf_int32 TILE_HEIGHT    = slaver->getTileHeight();
-	//const rspf_int32 TILE_WIDTH     = slaver->getTileWidth();
-	////const rspf_int32 START_LINE = theAreaOfInterest.ul().y;
-	////const rspf_int32 STOP_LINE  = theAreaOfInterest.lr().y;
-	////const rspf_int32 START_SAMP = theAreaOfInterest.ul().x;
-	////const rspf_int32 STOP_SAMP  = theAreaOfInterest.lr().x;
-	//const rspf_int32 START_LINE = slaver->getBoundingRect().ul().y;
-	//const rspf_int32 STOP_LINE  = slaver->getBoundingRect().lr().y;
-	//const rspf_int32 START_SAMP = slaver->getBoundingRect().ul().x;
-	//const rspf_int32 STOP_SAMP  = slaver->getBoundingRect().lr().x;
-
-	const rspf_int32 TILE_HEIGHT    = TILE_SIZE;
-	const rspf_int32 TILE_WIDTH     = TILE_SIZE;
-	const rspf_int32 START_LINE = slaver->getBoundingRect().ul().y;
-	const rspf_int32 STOP_LINE  = slaver->getBoundingRect().lr().y;
-	const rspf_int32 START_SAMP = slaver->getBoundingRect().ul().x;
-	const rspf_int32 STOP_SAMP  = slaver->getBoundingRect().lr().x;
-
-	// For percent complete status.
-	rspf_int32 tilerows=(STOP_LINE-START_LINE+TILE_HEIGHT) / TILE_HEIGHT; //ceil : (stop-start+1+size-1)/size
-	rspf_int32 tilecols=(STOP_SAMP-START_SAMP+TILE_WIDTH) / TILE_WIDTH;
-	double total_tiles = ((double)tilerows)*tilecols;
-	double tiles_processed = 0.0;
-
-	
-	// Set the status message to be "scanning source for edges..."
-	rspfNotify(rspfNotifyLevel_INFO) << "Getting tie points..." << std::endl;
-
-	// Start off with a percent complete at 0...
-	setPercentComplete(50.0);
-
-	// loop through all tiles
-	// need to use a sequencer for parallelism in the future TBD
-	//theTiePoints.clear();
-	rspf_int32 line=START_LINE;
-	rspf_int32 i,j;
-	
-	rspf_uint32 resLevel = 0;
-	for (i=0;(i<tilerows)&&!needsAborting();++i)
-	{
-		rspf_int32 samp=START_SAMP;
-		for (j=0;(j<tilecols)&&!needsAborting();++j )
+// approximate nearest neighbours (FLANN) with the 0.6 distance ratio test,
+// descriptors are used in place
+void rspfSurfMatch::findPairs(const FeatureSet& master, const FeatureSet& slaver, vector<int>& ptpairs)const
+{
+	ptpairs.clear();
+	if ( master.keypoints.empty() || (slaver.keypoints.size() < 2) ||
+	     (master.length != slaver.length) )
+	{
+		return;
+	}
+
+	cv::Mat m_object((int)master.keypoints.size(), master.length, CV_32F,
+	                 const_cast<float*>(&master.descriptors[0]));
+	cv::Mat m_image((int)slaver.keypoints.size(), slaver.length, CV_32F,
+	                const_cast<float*>(&slaver.descriptors[0]));
+
+	cv::Mat m_indices(m_object.rows, 2, CV_32S);
+	cv::Mat m_dists(m_object.rows, 2, CV_32F);
+	cv::flann::Index flann_index(m_image, cv::flann::KDTreeIndexParams(4));  // using 4 randomized kdtrees
+	flann_index.knnSearch(m_object, m_indices, m_dists, 2, cv::flann::SearchParams(64) ); // maximum number of leafs checked
+
+	int* indices_ptr = m_indices.ptr<int>(0);
+	float* dists_ptr = m_dists.ptr<float>(0);
+	for (int i=0;i<m_indices.rows;++i)
+	{
+		if (dists_ptr[2*i]<0.6*dists_ptr[2*i+1])
 		{
-			// Get the tie points
-			//TBC : can we go further than source edges with edge tiles?? TBD
-			rspfIrect tileRect = rspfIrect(rspfIpt(samp, line),rspfIpt(samp+TILE_WIDTH-1,line+TILE_HEIGHT-1));
+			ptpairs.push_back(i);
+			ptpairs.push_back(indices_ptr[2*i]);
+		}
+	}
+}
 
-			ExtractTile(slaver, tileRect, theSlaverBand, resLevel, Keypoints, Descriptors);
+rspfString rspfSurfMatch::getCacheKey(const rspfFilename& imageFile, const rspfIrect& aoi, int iband)const
+{
+	rspfFilename file = imageFile.expand();
+	rspf_int64 mtime = 0;
+#if defined(_WIN32)
+	struct _stati64 info;
+	if (_stati64(file.c_str(), &info) == 0) mtime = (rspf_int64)info.st_mtime;
+#else
+	struct stat info;
+	if (stat(file.c_str(), &info) == 0) mtime = (rspf_int64)info.st_mtime;
+#endif
+
+	std::ostringstream key;
+	key << file << "|" << file.fileSize() << "|" << mtime
+	    << "|" << aoi.ul().x << "," << aoi.ul().y << "," << aoi.lr().x << "," << aoi.lr().y
+	    << "|" << iband << "|" << std::setprecision(15) << theHessianThreshold
+	    << "|" << TILE_SIZE << "," << TILE_OVERLAP << "|surf128";
+	return rspfString(key.str());
+}
 
-			samp+=TILE_WIDTH;
-			// Set the percent complete.
-			tiles_processed += 1.0;
-			setPercentComplete(50.0+tiles_processed/total_tiles*50.0);
+rspfFilename rspfSurfMatch::getCacheFile(const rspfFilename& imageFile, const rspfString& key)const
+{
+	//FNV-1a of the key, image name kept readable
+	rspf_uint64 hash = 14695981039346656037ULL;
+	for (std::string::size_type i = 0;i < key.size();++i)
+	{
+		hash ^= (unsigned char)key[i];
+		hash *= 1099511628211ULL;
+	}
+	char hex[17];
+	sprintf(hex, "%08x%08x", (unsigned int)(hash >> 32), (unsigned int)(hash & 0xffffffff));
 
-			//DEBUG TBR TBC
-			// std::cout<<"p="<<tiles_processed/total_tiles*100.0<<std::endl;
+	return theCacheDirectory.dirCat(imageFile.fileNoExtension() + "_" + hex + ".surf");
+}
 
-		}
-		line+=TILE_HEIGHT;
+bool rspfSurfMatch::loadFeatures(const rspfFilename& cacheFile, const rspfString& key, FeatureSet& features)const
+{
+	std::ifstream in(cacheFile.c_str(), std::ios::in|std::ios::binary);
+	if (!in.good())
+	{
+		return false;
+	}
+	std::string magic;
+	std::string storedKey;
+	std::getline(in, magic);
+	std::getline(in, storedKey);
+	rspf_uint64 count = 0;
+	int length = 0;
+	in >> count >> length;
+	in.get(); // end of line
+	//an image without keypoints may be stored with a zero descriptor length
+	if ( !in.good() || (magic != SURF_CACHE_MAGIC) || (storedKey != key.string()) ||
+	     (length < 0) || (length > 1024) || ((length == 0) && count) )
+	{
+		return false;
 	}
 
-	setPercentComplete(100.0);
-	if (traceDebug()) CLOG << " Exited." << endl;
+	features.length = length;
+	features.keypoints.resize((size_t)count);
+	features.descriptors.resize((size_t)count*length);
+	if (count)
+	{
+		in.read((char*)&features.keypoints[0], (std::streamsize)(count*sizeof(CvSURFPoint)));
+		in.read((char*)&features.descriptors[0], (std::streamsize)(count*length*sizeof(float)));
+	}
+	if (!in.good())
+	{
+		features = FeatureSet();
+		return false;
+	}
 	return true;
 }
 
+bool rspfSurfMatch::saveFeatures(const rspfFilename& cacheFile, const rspfString& key, const FeatureSet& features)const
+{
+	if (!theCacheDirectory.exists() && !theCacheDirectory.createDirectory())
+	{
+		return false;
+	}
+	//write aside then rename, so a concurrent reader never sees a partial file
+	rspfFilename tmpFile = cacheFile + ".tmp";
+	{
+		std::ofstream out(tmpFile.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+		if (!out.good())
+		{
+			return false;
+		}
+		out << SURF_CACHE_MAGIC << "\n" << key << "\n"
+		    << features.keypoints.size() << " " << features.length << "\n";
+		if (features.keypoints.size())
+		{
+			out.write((const char*)&features.keypoints[0],
+			          (std::streamsize)(features.keypoints.size()*sizeof(CvSURFPoint)));
+			out.write((const char*)&features.descriptors[0],
+			          (std::streamsize)(features.descriptors.size()*sizeof(float)));
+		}
+		if (!out.good())
+		{
+			out.close();
+			tmpFile.remove();
+			return false;
+		}
+	}
+	cacheFile.remove();
+	return tmpFile.rename(cacheFile);
+}
+
 void rspfSurfMatch::setAreaOfInterest(const rspfIrect& rect)
 {
    theAreaOfInterest = rect;
@@ -11,7 +11,17 @@
 //
 // created by Frederic Claudel, CSIR - Aug 2005 - using rspfVertexExtractor as a model
 //
-// TBD: parallelize : use a sequencer (for vector data as well)
+// features are extracted on overlapping tiles, several tiles at once (threads
+// property, 0 = rspf::getNumberOfThreads()). A keypoint is kept by the tile
+// whose core (tile without overlap) holds it, so tile borders neither lose
+// nor duplicate features, and tiles are merged in order. The overlap is the
+// support radius of the largest SURF scale (4 octaves), so keypoints match
+// an untiled extraction.
+//
+// feature_cache_directory : when set, keypoints & descriptors of each image
+// are kept there, keyed by image (path, size, time), area of interest, band
+// and SURF settings, so repeated registrations against the same reference
+// skip its extraction
 //
 
 #ifndef rspfSurfMatch_HEADER
@@ -107,6 +117,20 @@ public:
    virtual rspfRefPtr<rspfProperty> getProperty(const rspfString& name)const;
    virtual void getPropertyNames(std::vector<rspfString>& propertyNames)const;
 
+   //! keypoints, in image coordinates, and their descriptors (length floats each) for one image
+   struct FeatureSet
+   {
+      FeatureSet() : length(0) {}
+      std::vector<CvSURFPoint> keypoints;
+      std::vector<float>       descriptors;
+      int                      length;
+   };
+
+   //! SURF on an 8 bit buffer (w x h), keeps keypoints inside core, offsets them by origin
+   void extractFeatures(const unsigned char* buf, int w, int h,
+                        const rspfIpt& origin, const rspfIrect& core,
+                        FeatureSet& features)const;
+
 protected:
    double theHessianThreshold;
    rspfString theMasterFilename;
@@ -118,16 +142,32 @@ protected:
    rspfRefPtr<rspfImageSource> theMasterSource;
    rspfRefPtr<rspfImageSource> theSlaverSource;
 
-   bool ExtractTile(rspfImageSource* imageSource,
-	   const rspfIrect& tileRect,
-	   int iband = 0,
-	   rspf_uint32 resLevel = 0,
-	   CvSeq** Keypoints = NULL,
-	   CvSeq** Descriptors = NULL);
-   bool getMasterFeatures(CvSeq** Keypoints, CvSeq** Descriptors);
-   bool getSlaverFeatures(CvSeq** Keypoints, CvSeq** Descriptors);
-
-   void addElementToList(CvSeq** root, CvSeq *elem);
+   rspf_uint32 theThreads;
+   rspfFilename theCacheDirectory;
+
+   bool getFeatures(rspfImageSource* imageSource,
+                    const rspfIrect& aoi,
+                    int iband,
+                    double progressStart,
+                    double progressEnd,
+                    FeatureSet& features);
+   bool getImageFeatures(rspfImageSource* imageSource,
+                         const rspfFilename& imageFile,
+                         const rspfIrect& aoi,
+                         int iband,
+                         double progressStart,
+                         double progressEnd,
+                         FeatureSet& features);
+   bool getMasterFeatures(FeatureSet& features);
+   bool getSlaverFeatures(FeatureSet& features);
+
+   void findPairs(const FeatureSet& master, const FeatureSet& slaver, vector<int>& ptpairs)const;
+
+   //! feature cache
+   rspfString   getCacheKey(const rspfFilename& imageFile, const rspfIrect& aoi, int iband)const;
+   rspfFilename getCacheFile(const rspfFilename& imageFile, const rspfString& key)const;
+   bool loadFeatures(const rspfFilename& cacheFile, const rspfString& key, FeatureSet& features)const;
+   bool saveFeatures(const rspfFilename& cacheFile, const rspfString& key, const FeatureSet& features)const;
 
 private:
    rspfIrect        theAreaOfInterest;
@@ -1,39 +1,25 @@
 // class rspfChipMatch implementation
-// REQUIRES FFTW version 3.x (Fast Fourier Transform)
+// REQUIRES FFTW version 3.x (Fast Fourier Transform) for large chips
 
 #include "rspfChipMatch.h"
 #include <rspf/imaging/rspfImageDataFactory.h>
 #include <rspf/base/rspfIrect.h>
 #include "rspfRunningSum.h"
-#include "rspfNCC_FFTW.h"
+#include "rspfNCC_Correlator.h"
 #include <rspf/projection/rspfProjection.h>
 #include <rspf/projection/rspfProjectionFactoryRegistry.h>
 
-#include <fftw3.h>
-
 #include <iostream> //TBR
 
 RTTI_DEF1( rspfChipMatch, "rspfChipMatch", rspfImageCombiner );
 
-// matrix to get the 2nd order x,y best fit polynomial (least mean squares)
-// -order of values (inputs) : from top left to bottom right along rows (normal image scan)
-// -order of coefficients (results) : 1 x y xy xx yy
-// uniform weighting for least mean squares
-
-double rspfChipMatch::theLMS[6*9] = {
--1.1111111111111116e-001,2.2222222222222210e-001,-1.1111111111111116e-001,2.2222222222222210e-001,5.5555555555555536e-001,2.2222222222222210e-001,-1.1111111111111116e-001,2.2222222222222210e-001,-1.1111111111111116e-001,
--1.6666666666666666e-001,0.0000000000000000e+000,1.6666666666666666e-001,-1.6666666666666666e-001,0.0000000000000000e+000,1.6666666666666666e-001,-1.6666666666666666e-001,0.0000000000000000e+000,1.6666666666666666e-001,
--1.6666666666666666e-001,-1.6666666666666666e-001,-1.6666666666666666e-001,0.0000000000000000e+000,0.0000000000000000e+000,0.0000000000000000e+000,1.6666666666666666e-001,1.6666666666666666e-001,1.6666666666666666e-001,
-2.5000000000000000e-001,0.0000000000000000e+000,-2.5000000000000000e-001,0.0000000000000000e+000,0.0000000000000000e+000,0.0000000000000000e+000,-2.5000000000000000e-001,0.0000000000000000e+000,2.5000000000000000e-001,
-1.6666666666666669e-001,-3.3333333333333331e-001,1.6666666666666669e-001,1.6666666666666674e-001,-3.3333333333333326e-001,1.6666666666666674e-001,1.6666666666666669e-001,-3.3333333333333331e-001,1.6666666666666669e-001,
-1.6666666666666669e-001,1.6666666666666674e-001,1.6666666666666669e-001,-3.3333333333333331e-001,-3.3333333333333326e-001,-3.3333333333333331e-001,1.6666666666666669e-001,1.6666666666666674e-001,1.6666666666666669e-001
-};
-
 rspfChipMatch::rspfChipMatch()
    :rspfImageCombiner(),
    theSlaveAccuracy(7.0), //TBC
    theMRadius(5), //TBC
    theBias(0.0,0.0),
+   theBiasDx(0.0,0.0),
+   theBiasDy(0.0,0.0),
    theMinNCC(0.75),
    theNCCengine(NULL),
    theTile(NULL)
@@ -52,6 +38,8 @@ rspfChipMatch::rspfChipMatch(rspfObject *owner,
    theSlaveAccuracy(7.0), //TBC: set to 0
    theMRadius(5), //TBC
    theBias(0.0,0.0),
+   theBiasDx(0.0,0.0),
+   theBiasDy(0.0,0.0),
    theMinNCC(0.75),
    theNCCengine(NULL),
    theTile(NULL)
@@ -393,6 +381,20 @@ rspfChipMatch::runMatch(const rspfIrect &rect, rspf_uint32 resLevel)
    //erase stored tie points
    theTies.clear();
 
+   std::vector<Chip> chips;
+   if (!getChips(rect, resLevel, chips))
+   {
+      return false;
+   }
+   matchChips(chips, theNCCengine, theTies);
+   return true;
+}
+
+bool
+rspfChipMatch::getChips(const rspfIrect &rect, rspf_uint32 resLevel, std::vector<Chip>& chips)
+{
+   chips.clear();
+
    //get Inputs
    rspfImageSource* corner = PTR_CAST(rspfImageSource, getInput(0));
    rspfImageSource* master = PTR_CAST(rspfImageSource, getInput(1));
@@ -442,27 +444,23 @@ rspfChipMatch::runMatch(const rspfIrect &rect, rspf_uint32 resLevel)
                {
                   //get slave data with bias & extended frame (use accuracy)
                   //bias & extension change with scale
-                  rspfIpt delta_sc(ci+(rspf_int32)floor(theBias.x+0.5),cj+(rspf_int32)floor(theBias.y+0.5)); //biased center : TBD : convert unit to pixels
+                  rspfIpt pos(rect.ul()+delta_mc);
+                  rspfIpt bias((rspf_int32)floor(theBias.x + theBiasDx.x*pos.x + theBiasDy.x*pos.y + 0.5),
+                               (rspf_int32)floor(theBias.y + theBiasDx.y*pos.x + theBiasDy.y*pos.y + 0.5));
+                  rspfIpt delta_sc(delta_mc + bias); //biased center : TBD : convert unit to pixels
                   rspfIrect srect(rect.ul()+delta_sc-delta_lr, rect.ul()+delta_sc+delta_lr); //square, size 2*(radius+accuracy)+1 pixels
                   rspfRefPtr<rspfImageData> slaveData = slave->getTile(srect, resLevel); //same resLevel?? TBC
                   if ((slaveData != NULL) 
                       && (slaveData->getDataObjectStatus() != RSPF_EMPTY)
                       && (slaveData->getDataObjectStatus() != RSPF_PARTIAL))
                   {
-                     //find normalized cross-correlation maximum
-                     //TBD: assuming floating point input
-                     double dx=0.0;
-                     double dy=0.0;
-                     double ncor=0.0;
-
-                     getMaxCorrelation(masterData, slaveData, &dx, &dy, &ncor);
-                     
-                     //filter on NCC value
-                     if (ncor >= theMinNCC)
-                     {
-                        //create tie point & store
-                        theTies.push_back(rspfTDpt( rect.ul()+delta_mc, rspfDpt(dx,dy), ncor ));
-                     }
+                     //keep copies : sources re-use their tiles on the next getTile
+                     Chip chip;
+                     chip.center = pos;
+                     chip.bias   = bias;
+                     chip.master = static_cast<rspfImageData*>(masterData->dup());
+                     chip.slave  = static_cast<rspfImageData*>(slaveData->dup());
+                     chips.push_back(chip);
                   }
                }
             }
@@ -475,110 +473,50 @@ rspfChipMatch::runMatch(const rspfIrect &rect, rspf_uint32 resLevel)
 }
 
 void
-rspfChipMatch::getMaxCorrelation(rspfRefPtr<rspfImageData> Mchip, rspfRefPtr<rspfImageData> Schip, 
-                                  double* pdispx, double* pdispy, double* pcor)
+rspfChipMatch::matchChips(const std::vector<Chip>& chips, rspfNCC_Correlator*& engine, std::vector<rspfTDpt>& ties)const
 {
-   //use FFTW 3.0.1
-   //assume displacement between center of master to center of slave buffer
-   // Mchip must smaller than Schip (Schip incorporates error buffer)
-
-   rspf_uint32 sx = Schip->getWidth();
-   rspf_uint32 sy = Schip->getHeight();
-   rspf_uint32 mx = Mchip->getWidth();
-   rspf_uint32 my = Mchip->getHeight();
-   //cout<<"mx="<<mx<<" my="<<my<<" sx="<<sx<<" sy="<<sy<<endl; //TBR
-
-   int cx=sx+mx-1;
-   int cy=sy+my-1;
-
-   if (theNCCengine!=NULL)
+   for (std::vector<Chip>::const_iterator it=chips.begin();it!=chips.end();++it)
    {
-      //check correlation size
-      if (!theNCCengine->sameDims(cy,cx))
+      //find normalized cross-correlation maximum
+      //TBD: assuming floating point input
+      double dx=0.0;
+      double dy=0.0;
+      double ncor=0.0;
+
+      getMaxCorrelation(it->master.get(), it->slave.get(), engine, &dx, &dy, &ncor);
+      
+      //filter on NCC value
+      if (ncor >= theMinNCC)
       {
-         //re build NCC engine //TBD : use wisdom
-         delete theNCCengine;
-         theNCCengine=NULL;
+         //create tie point & store
+         ties.push_back(rspfTDpt( it->center, rspfDpt(it->bias.x+dx, it->bias.y+dy), ncor ));
       }
    }
-   if (theNCCengine==NULL)
+}
+
+void
+rspfChipMatch::getMaxCorrelation(rspfRefPtr<rspfImageData> Mchip, rspfRefPtr<rspfImageData> Schip, 
+                                  double* pdispx, double* pdispy, double* pcor)
+{
+   getMaxCorrelation(Mchip.get(), Schip.get(), theNCCengine, pdispx, pdispy, pcor);
+}
+
+void
+rspfChipMatch::getMaxCorrelation(const rspfImageData* Mchip, const rspfImageData* Schip, rspfNCC_Correlator*& engine,
+                                  double* pdispx, double* pdispy, double* pcor)
+{
+   //assume displacement between center of master to center of slave buffer
+   // Mchip must smaller than Schip (Schip incorporates error buffer)
+   if (engine==NULL)
    {
-      //build a new NCC engine //TBD : use wisdom
-      theNCCengine = new rspfNCC_FFTW(cy,cx);
+      engine = new rspfNCC_Correlator();
    }
 
-   theNCCengine->ingestMaster(my,mx,Mchip->getDoubleBuf());
-   theNCCengine->ingestSlave(sy,sx,Schip->getDoubleBuf());
-
-   if (!theNCCengine->calculateNCC())
+   if (!engine->correlate(Mchip->getHeight(), Mchip->getWidth(), Mchip->getDoubleBuf(),
+                          Schip->getHeight(), Schip->getWidth(), Schip->getDoubleBuf(),
+                          pdispx, pdispy, pcor))
    {
       // TBD err mngt
-      if (pcor) *pcor=0.0;
-      if (pdispx) *pdispx = 0.0;
-      if (pdispy) *pdispy = 0.0;
       cout<<"Error in NCC calculation"<<endl;
-      return;
    }
-   int mj          = theNCCengine->getMaxCorrX(); 
-   int mi          = theNCCengine->getMaxCorrY();
-   double bestcorr = theNCCengine->getMaxCorr();
-   int oj = (cx-1)/2;//we know that cx and cy are odd!!
-   int oi = (cy-1)/2;
-   int deltaj = (sx-mx)/2; //we know that sx-mx is even
-   int deltai = (sy-my)/2;
-
-   //original best shift (integer shift for for max value)
-   double dmcx = mj - oj;
-   double dmcy = mi - oi;
-
-   //find maximum, sub-pixel precision
-   //use least-square fit on 2nd order polynomial
-   if ((mj > oj-deltaj) && (mj < oj+deltaj) && (mi > oi-deltai) && (mi < oi+deltai))
-   {
-      //then there's a 3x3 neighborhood we can use to get better precision
-      vector<double> p2c(6); //2nd order x y polynomial coefficents (see theLMS comments)
-      vector<double>::iterator it = p2c.begin();
-      double* pm = theLMS;
-      const rspfNCC_FFTW::cMatrix& corrmat = theNCCengine->getNcc();
-      //matrix product with values of 3x3 neighborhood
-      for (int k=0;k<6;++k)
-      {
-         *it = 0.0;
-         for(int i=-1;i<=1;++i)
-         {
-            for(int j=-1;j<=1;++j)
-            {
-               *it += *(pm++) * corrmat(mi+i, mj+j);
-            }
-         }
-         ++it;
-      }
-      //check convexity (det>0) + downwards orientation (trace<0)
-      double trace = p2c[4] + p2c[5];
-      if (trace<-1e-13) //TBC : -epsilon
-      {
-         double det = p2c[4]*p2c[5] - 0.25*p2c[3]*p2c[3];
-         if (det>1e-13) //TBC : epsilon
-         {
-            //ok : convex + downwards
-            //find maximum position
-            double optx = (p2c[3]*p2c[2] - 2.0 * p2c[5]*p2c[1]) / det * 0.25;
-            double opty = (p2c[3]*p2c[1] - 2.0 * p2c[4]*p2c[2]) / det * 0.25;
-            //limit new position to center pixel square
-            //TBD : need to find better model for NCC subpixel
-            if ((fabs(optx)<=0.501) && (fabs(opty)<=0.501))
-            {
-               dmcx+=optx;
-               dmcy+=opty;
-              //change corelation max value (dangerous) : TBD ? TBC
-            }
-         }
-      }
-   }
-
-   //give results back  
-   if (pcor)   *pcor   = bestcorr;
-   if (pdispx) *pdispx = dmcx;
-   if (pdispy) *pdispy = dmcy;
 }
-
@@ -19,7 +19,16 @@
 //  handle NULL pixels
 //  add matching on boundaries 
 //  use vector features for matching positions
-//  use vector tiles in Ossim for parallelism
+//
+// PARALLELISM:
+//  getChips() copies the chips of a tile out of the inputs, matchChips() then
+//  correlates them without touching the inputs or the object state, so
+//  rspfTieGenerator can read tiles one at a time and match them on
+//  several threads, each with its own NCC engine
+//
+// CORRELATION:
+//  rspfNCC_Correlator : direct sums with summed area tables for small chips,
+//  FFT for large ones, sub-pixel peak fit
 //
 // created by Frederic Claudel, EORU - CSIR - Aug 2005
 
@@ -37,7 +46,7 @@
 #define RSPF_CHIPMATCH_PIXELRADIUS_PROPNAME "PixelRadius"
 #define RSPF_CHIPMATCH_MINNCC_PROPNAME "MinimumNCC"
 
-class rspfNCC_FFTW;
+class rspfNCC_Correlator;
 
 class RSPF_REGISTRATION_DLL rspfChipMatch : public rspfImageCombiner
 {
@@ -59,10 +68,33 @@ public:
    inline void setBias(const rspfDpt& aBias) { theBias=aBias; } //using current projection unit & axes
    inline const rspfDpt& getBias()const { return theBias; }
 
+   //optional linear variation of the bias : bias(x,y) = bias + x * biasDx + y * biasDy (pixels)
+   //e.g. from a coarser matching level, so the slave accuracy can be reduced to the model residuals
+   inline void setBiasGradient(const rspfDpt& biasDx, const rspfDpt& biasDy) { theBiasDx=biasDx; theBiasDy=biasDy; }
+   inline const rspfDpt& getBiasDx()const { return theBiasDx; }
+   inline const rspfDpt& getBiasDy()const { return theBiasDy; }
+
    inline void setMinNCC(rspf_float64 m) { theMinNCC=m; } //unitless (between -1.0 and 1.0)
    inline rspf_float64 getMinNCC()const { return theMinNCC; }
    
    virtual const std::vector<rspfTDpt>& getFeatures(const rspfIrect &rect, rspf_uint32 resLevel=0); //vector method for getTile
+
+   //master/slave chip pair copied from the inputs, centered on a feature
+   struct Chip
+   {
+      rspfIpt                    center; //feature position (full tile coordinates)
+      rspfIpt                    bias;   //slave chip center minus master chip center
+      rspfRefPtr<rspfImageData> master;
+      rspfRefPtr<rspfImageData> slave;
+   };
+
+   //reads the chips of all features of a tile (not thread safe : uses the inputs)
+   //returns false if there is no feature data for the tile
+   bool getChips(const rspfIrect &rect, rspf_uint32 resLevel, std::vector<Chip>& chips);
+
+   //correlates chips and appends ties with NCC >= MinNCC, in chip order
+   //thread safe as long as each thread uses its own engine (created/resized as needed, caller deletes it)
+   void matchChips(const std::vector<Chip>& chips, rspfNCC_Correlator*& engine, std::vector<rspfTDpt>& ties)const;
    
    //inherited public methods
    virtual void                        initialize();
@@ -94,16 +126,18 @@ protected:
    bool runMatch(const rspfIrect &rect, rspf_uint32 resLevel=0);
    void getMaxCorrelation(rspfRefPtr<rspfImageData> Mchip, rspfRefPtr<rspfImageData> Schip, 
                                   double* pdispx, double* pdispy, double* pcor);
+   static void getMaxCorrelation(const rspfImageData* Mchip, const rspfImageData* Schip, rspfNCC_Correlator*& engine,
+                                  double* pdispx, double* pdispy, double* pcor);
 
    std::vector<rspfTDpt>      theTies;
    rspf_float64               theSlaveAccuracy;
    rspf_uint32                theMRadius;
    rspfDpt                    theBias;
+   rspfDpt                    theBiasDx;
+   rspfDpt                    theBiasDy;
    rspf_float64               theMinNCC;
-   rspfNCC_FFTW*              theNCCengine;
+   rspfNCC_Correlator*        theNCCengine;
    rspfRefPtr<rspfImageData> theTile;
-   //static data
-   static double theLMS[6*9];
 
 TYPE_DATA
 };
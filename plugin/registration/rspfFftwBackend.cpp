@@ -0,0 +1,126 @@
+// class rspfFftwBackend : impl.
+//
+#include "rspfFftwBackend.h"
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <fftw3.h>
+#include <algorithm>
+#include <vector>
+
+//FFTW planner and plan destruction are not thread safe, execution is
+static OpenThreads::Mutex fftwMutex;
+
+class rspfFftwPlan : public rspfFftEngine::Plan
+{
+public:
+   rspfFftwPlan(rspf_uint32 rows, rspf_uint32 cols, unsigned flags)
+      : rspfFftEngine::Plan(rows, cols),
+        m_forward(NULL),
+        m_inverse(NULL)
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(fftwMutex);
+
+      //planning may overwrite buffers : use scratch ones
+      double* r = (double*)fftw_malloc(sizeof(double)*getRealSize());
+      double* c = (double*)fftw_malloc(sizeof(double)*getComplexSize());
+      if (r && c)
+      {
+         m_forward = fftw_plan_dft_r2c_2d(rows, cols, r, (fftw_complex*)c,
+                                          flags | FFTW_UNALIGNED);
+         m_inverse = fftw_plan_dft_c2r_2d(rows, cols, (fftw_complex*)c, r,
+                                          flags | FFTW_UNALIGNED);
+      }
+      if (r) fftw_free(r);
+      if (c) fftw_free(c);
+   }
+
+   bool isValid()const
+   {
+      return (m_forward!=NULL) && (m_inverse!=NULL);
+   }
+
+   virtual void forward(const rspf_float64* in, rspf_float64* out)const
+   {
+      //out of place r2c preserves input
+      fftw_execute_dft_r2c(m_forward, const_cast<double*>(in), (fftw_complex*)out);
+   }
+   virtual void inverse(rspf_float64* in, rspf_float64* out)const
+   {
+      fftw_execute_dft_c2r(m_inverse, (fftw_complex*)in, out);
+   }
+
+   //single precision : fftw3f isn't linked, go through double buffers
+   virtual void forward(const rspf_float32* in, rspf_float32* out)const
+   {
+      std::vector<double> r(in, in + getRealSize());
+      std::vector<double> c(getComplexSize());
+      forward(&r[0], &c[0]);
+      std::copy(c.begin(), c.end(), out);
+   }
+   virtual void inverse(rspf_float32* in, rspf_float32* out)const
+   {
+      std::vector<double> c(in, in + getComplexSize());
+      std::vector<double> r(getRealSize());
+      inverse(&c[0], &r[0]);
+      std::copy(r.begin(), r.end(), out);
+   }
+
+protected:
+   virtual ~rspfFftwPlan()
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(fftwMutex);
+      if (m_forward!=NULL) fftw_destroy_plan(m_forward);
+      if (m_inverse!=NULL) fftw_destroy_plan(m_inverse);
+   }
+
+   fftw_plan m_forward;
+   fftw_plan m_inverse;
+};
+
+rspfFftwBackend::rspfFftwBackend(unsigned flags)
+ : rspfFftEngine::Backend(),
+   m_flags(flags)
+{
+}
+
+rspfFftwBackend::~rspfFftwBackend()
+{
+}
+
+rspfString
+rspfFftwBackend::getName()const
+{
+   return rspfString("fftw");
+}
+
+rspfFftEngine::Plan*
+rspfFftwBackend::createPlan(rspf_uint32 rows, rspf_uint32 cols)
+{
+   rspfRefPtr<rspfFftwPlan> plan = new rspfFftwPlan(rows, cols, m_flags);
+   if (!plan->isValid())
+   {
+      return NULL;
+   }
+   return plan.release();
+}
+
+std::string
+rspfFftwBackend::exportWisdom()const
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(fftwMutex);
+   char* ws=fftw_export_wisdom_to_string();
+   if (ws)
+   {
+      std::string s(ws);
+      fftw_free(ws);
+      return s;
+   }
+   return std::string();
+}
+
+bool
+rspfFftwBackend::importWisdom(const std::string& wisdom)
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(fftwMutex);
+   return (fftw_import_wisdom_from_string(wisdom.c_str()) != 0);
+}
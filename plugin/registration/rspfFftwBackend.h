@@ -0,0 +1,34 @@
+// class rspfFftwBackend
+// FFTW based backend for rspfFftEngine
+//
+// Registered by the plugin so that rspfFftFilter, rspfNCC_FFTW and any other
+// rspfFftEngine user share FFTW plans and wisdom.
+// Plans are made with FFTW_UNALIGNED so they can be executed on any buffer
+// (new array execute), from several threads at once.
+//
+#ifndef rspfFftwBackend_HEADER
+#define rspfFftwBackend_HEADER
+
+#include <rspf/imaging/rspfFftEngine.h>
+#include <string>
+
+class rspfFftwBackend : public rspfFftEngine::Backend
+{
+public:
+   //flags : FFTW planner flags (FFTW_ESTIMATE, FFTW_MEASURE...)
+   rspfFftwBackend(unsigned flags);
+
+   virtual rspfString getName()const;
+   virtual rspfFftEngine::Plan* createPlan(rspf_uint32 rows, rspf_uint32 cols);
+
+   //IMPORTANT don't exchange wisdom strings across different systems !
+   virtual std::string exportWisdom()const;
+   virtual bool importWisdom(const std::string& wisdom);
+
+protected:
+   virtual ~rspfFftwBackend();
+
+   unsigned m_flags;
+};
+
+#endif
@@ -12,6 +12,7 @@
 #include <rspf/imaging/rspfImageChain.h>
 #include <rspf/imaging/rspfBandSelector.h>
 #include "rspfTieGenerator.h"
+#include "rspfOutlierRejection.h"
 #include <rspf/imaging/rspfImageHandlerRegistry.h>
 #include <rspf/projection/rspfMapProjection.h>
 #include <rspf/projection/rspfProjectionFactoryRegistry.h>
@@ -46,6 +47,8 @@ rspfImageCorrelator::rspfImageCorrelator()
    theSlavePointProj("I"),
    theTemplateRadius(7),
    theMinCorrel(0.8),
+   thePyramidLevels(0),
+   thePyramidModel("rspfPolynomProjection{1 x y}"),
    theHasRun(false),
    handlerM(NULL),
    handlerS(NULL),
@@ -350,6 +353,7 @@ rspfImageCorrelator::execute()
    matcher->setSlaveAccuracy(getSlaveAccuracy() * getScaleRatio()); //adapt pixel radius according to scale
    matcher->setMasterRadius(getTemplateRadius()); //in sync with GaussStd for corners
    matcher->setBias(rspfDpt(0.0,0.0));
+   matcher->setBiasGradient(rspfDpt(0.0,0.0), rspfDpt(0.0,0.0));
    matcher->setMinNCC(getMinCorrel());
 
    generator->close();
@@ -368,11 +372,18 @@ rspfImageCorrelator::execute()
    cornerDetector->connectMyInputTo(0,theMChain.get());
    matcher->connectMyInputTo(0,cornerDetector.get());
    matcher->connectMyInputTo(1,caster[0].get()); // master
-   matcher->connectMyInputTo(2,caster[0].get()); // slave
+   matcher->connectMyInputTo(2,caster[1].get()); // slave
    generator->connectMyInputTo(0,matcher.get());
 
    // -- 4 -- run
-   result = generator->execute();
+   if (getPyramidLevels() > 0)
+   {
+      result = runPyramid(outProj);
+   }
+   else
+   {
+      result = generator->execute();
+   }
 
    const vector<rspfTDpt>& tp = generator->getTiePoints();
 
@@ -387,21 +398,7 @@ rspfImageCorrelator::execute()
    rspfRefPtr<rspfImageGeometry> geom = getOutputImageGeometry();
    if ( geom.valid() )
    {
-      for(vector<rspfTDpt>::const_iterator it = tp.begin();
-          it != tp.end() ;
-          ++it)
-      {
-         rspfRefPtr<rspfTieGpt> tgi(new rspfTieGpt);
-         //set master ground pos
-         geom->localToWorld( it->getMasterPoint() , *tgi ); //TBC : is it always lon/lat WGS84?
-         //set slave image position
-         st->viewToImage( it->getMasterPoint() + it->getSlavePoint() , tgi->refImagePoint() );
-         //set score
-         tgi->setScore(it->score);
-         
-         //add to list
-         theTset.addTiePoint(tgi);
-      }
+      buildTieSet(tp, geom.get(), st, theTset);
    }
    
    theTset.setMasterPath(theMaster);
@@ -432,6 +429,207 @@ rspfImageCorrelator::execute()
    return true;
 }
 
+// runPyramid() - coarse to fine matching, see header
+// output projection is at level 0 on return
+bool
+rspfImageCorrelator::runPyramid(rspfMapProjection* outProj)
+{
+   static const rspf_float64 INLIER_RATIO    = 0.5; //RANSAC : expected ratio of good ties (TBC)
+   static const rspf_float64 INLIER_ACCURACY = 2.0; //RANSAC : max error, unit level pixels
+   static const rspf_float64 RESIDUAL_NSTD   = 3.0; //search radius = NSTD * model RMS + MARGIN
+   static const rspf_float64 RESIDUAL_MARGIN = 2.0; // unit level pixels
+
+   rspf_uint32 levels = getPyramidLevels();
+   if ( (handlerM->getNumberOfDecimationLevels() <= levels) ||
+        (handlerS->getNumberOfDecimationLevels() <= levels) )
+   {
+      cout<<"rspfImageCorrelator::runPyramid warning: missing overviews, coarse levels will be resampled from full resolution"<<endl;
+   }
+
+   //renderer views hold the output projection, keep it while they are switched to level projections
+   rspfRefPtr<rspfMapProjection> outProjRef = outProj;
+
+   rspfTieGptSet inliers; //from previous level
+   bool haveModel = false;
+
+   for (rspf_int32 level=(rspf_int32)levels; level>=0; --level)
+   {
+      if (needsAborting()) return false;
+
+      // -- a -- output projection for this level : 1/2^level of the final scale
+      rspf_float64 factor = (rspf_float64)(1<<level);
+      rspfRefPtr<rspfMapProjection> levelProj = outProj;
+      rspfRefPtr<rspfImageGeometry> levelGeom;
+      if (level > 0)
+      {
+         levelProj = PTR_CAST(rspfMapProjection, outProj->dup());
+         if (!levelProj.valid()) return false;
+         levelProj->applyScale(rspfDpt(factor,factor), false);
+         levelGeom = new rspfImageGeometry(0, levelProj.get());
+      }
+      else
+      {
+         levelGeom = getOutputImageGeometry();
+      }
+      setRendererView(rendererM.get(), levelProj.get());
+      setRendererView(rendererS.get(), levelProj.get());
+      theMChain->initialize(); //flush caches
+      theSChain->initialize();
+      caster[0]->initialize();
+      caster[1]->initialize();
+      cornerDetector->initialize();
+      matcher->initialize();
+
+      // -- b -- search window : full accuracy at coarsest level, then displacement model residuals
+      rspf_float64 accuracy = getSlaveAccuracy() * getScaleRatio() / factor;
+      rspfDpt bias(0.0,0.0);
+      rspfDpt biasDx(0.0,0.0);
+      rspfDpt biasDy(0.0,0.0);
+      rspf_float64 rms = 0.0;
+      if (haveModel && fitDisplacement(inliers, levelGeom.get(), rendererS->getImageViewTransform(), bias, biasDx, biasDy, rms))
+      {
+         accuracy = std::min(accuracy, RESIDUAL_NSTD * rms + RESIDUAL_MARGIN);
+      }
+      matcher->setSlaveAccuracy(accuracy);
+      matcher->setBias(bias);
+      matcher->setBiasGradient(biasDx, biasDy);
+
+      cout<<"Pyramid level "<<level<<" : scale="<<getScaleRatio()/factor
+          <<" bias="<<bias<<" search radius="<<accuracy<<" pixels"<<endl;
+
+      // -- c -- match
+      rspfIrect aoi;
+      aoi.makeNan();
+      generator->setAreaOfInterest(aoi); //whole level
+      if (!generator->execute()) return false;
+      if (level == 0) break;
+
+      // -- d -- reject outliers, keep inliers for next level model
+      rspfTieGptSet levelSet;
+      rspfImageViewTransform* st = rendererS->getImageViewTransform();
+      buildTieSet(generator->getTiePoints(), levelGeom.get(), st, levelSet);
+
+      rspfRefPtr<rspfOutlierRejection> rejecter = new rspfOutlierRejection;
+      rejecter->setTieSet(levelSet);
+      rejecter->setInlierRatio(INLIER_RATIO);
+      rejecter->setInlierImageAccuracy(INLIER_ACCURACY * st->getOutputMetersPerPixel().x / st->getInputMetersPerPixel().x);
+      if ( (levelSet.size() >= 3) && rejecter->setupModel(getPyramidModel()) && rejecter->removeOutliers() )
+      {
+         inliers   = rejecter->getTieSet();
+         haveModel = (inliers.size() >= 3);
+      }
+      else
+      {
+         //keep previous model if any, else search full accuracy again
+         cout<<"rspfImageCorrelator::runPyramid warning: no displacement model at level "<<level<<endl;
+      }
+   }
+   return true;
+}
+
+// setRendererView() - changes renderer output projection, keeps input geometry
+void
+rspfImageCorrelator::setRendererView(rspfImageRenderer* renderer, rspfMapProjection* proj)const
+{
+   rspfImageViewProjectionTransform* transform =
+      PTR_CAST(rspfImageViewProjectionTransform, renderer->getImageViewTransform());
+   if (transform)
+   {
+      transform->setViewGeometry(new rspfImageGeometry(0, proj));
+      renderer->setImageViewTransform(transform); //recomputes bounding rects
+   }
+}
+
+// buildTieSet() - converts "Image to Image" to "Ground to Image" tie points
+//  geom : output (master view) geometry, st : slave renderer transform
+void
+rspfImageCorrelator::buildTieSet(const vector<rspfTDpt>& tp,
+                                 const rspfImageGeometry* geom,
+                                 const rspfImageViewTransform* st,
+                                 rspfTieGptSet& tset)const
+{
+   for(vector<rspfTDpt>::const_iterator it = tp.begin();
+       it != tp.end() ;
+       ++it)
+   {
+      rspfRefPtr<rspfTieGpt> tgi(new rspfTieGpt);
+      //set master ground pos
+      geom->localToWorld( it->getMasterPoint() , *tgi ); //TBC : is it always lon/lat WGS84?
+      //set slave image position
+      st->viewToImage( it->getMasterPoint() + it->getSlavePoint() , tgi->refImagePoint() );
+      //set score
+      tgi->setScore(it->score);
+      
+      //add to list
+      tset.addTiePoint(tgi);
+   }
+}
+
+// fitDisplacement() - least squares linear displacement model (slave view - master view)
+// of tie points in the view of geom/st : d(x,y) = bias + x * biasDx + y * biasDy
+// rms : residual, unit pixels
+bool
+rspfImageCorrelator::fitDisplacement(const rspfTieGptSet& tset,
+                                     const rspfImageGeometry* geom,
+                                     const rspfImageViewTransform* st,
+                                     rspfDpt& bias, rspfDpt& biasDx, rspfDpt& biasDy,
+                                     rspf_float64& rms)const
+{
+   const vector<rspfRefPtr<rspfTieGpt> >& ties = tset.getTiePoints();
+   if (ties.size() < 3) return false;
+
+   //view positions, centered for conditioning
+   vector<rspfDpt> pm(ties.size());
+   vector<rspfDpt> d(ties.size());
+   rspfDpt c(0.0,0.0);
+   vector<rspfRefPtr<rspfTieGpt> >::const_iterator it;
+   rspf_uint32 i=0;
+   for (it=ties.begin();it!=ties.end();++it,++i)
+   {
+      geom->worldToLocal((*it)->getGroundPoint(), pm[i]);
+      d[i] = st->imageToView((*it)->getImagePoint()) - pm[i];
+      c += pm[i];
+   }
+   c = c / (double)ties.size();
+
+   //normal equations, unknowns : 1 x y
+   NEWMAT::SymmetricMatrix ata(3);
+   NEWMAT::ColumnVector atx(3);
+   NEWMAT::ColumnVector aty(3);
+   ata = 0.0;
+   atx = 0.0;
+   aty = 0.0;
+   for (i=0;i<pm.size();++i)
+   {
+      double a[3] = { 1.0, pm[i].x - c.x, pm[i].y - c.y };
+      for (int r=0;r<3;++r)
+      {
+         for (int k=0;k<=r;++k) ata(r+1,k+1) += a[r]*a[k];
+         atx(r+1) += a[r]*d[i].x;
+         aty(r+1) += a[r]*d[i].y;
+      }
+   }
+   if (std::fabs(ata.Determinant()) < 1e-12) return false;
+   NEWMAT::Matrix inv = ata.i();
+   NEWMAT::ColumnVector cx = inv * atx;
+   NEWMAT::ColumnVector cy = inv * aty;
+
+   biasDx = rspfDpt(cx(2), cy(2));
+   biasDy = rspfDpt(cx(3), cy(3));
+   bias   = rspfDpt(cx(1) - cx(2)*c.x - cx(3)*c.y,
+                    cy(1) - cy(2)*c.x - cy(3)*c.y);
+
+   rspf_float64 sum2 = 0.0;
+   for (i=0;i<pm.size();++i)
+   {
+      rspfDpt r = d[i] - (bias + rspfDpt(biasDx.x*pm[i].x + biasDy.x*pm[i].y,
+                                         biasDx.y*pm[i].x + biasDy.y*pm[i].y));
+      sum2 += r.x*r.x + r.y*r.y;
+   }
+   rms = std::sqrt(sum2 / pm.size());
+   return true;
+}
+
 bool
 rspfImageCorrelator::isOpen() const
 {
@@ -586,6 +784,14 @@ void rspfImageCorrelator::setProperty(rspfRefPtr<rspfProperty> property)
    {
       setOutputName(property->valueToString());
    }
+   else if(name == "pyramid_levels")
+   {
+      setPyramidLevels(property->valueToString().toUInt32());
+   }
+   else if(name == "pyramid_model")
+   {
+      setPyramidModel(property->valueToString());
+   }
    else
    {
       rspfOutputSource::setProperty(property);
@@ -646,6 +852,14 @@ rspfRefPtr<rspfProperty> rspfImageCorrelator::getProperty(const rspfString& name
    {
       return new rspfStringProperty(name, getProjectionType());
    }
+   else if(name == "pyramid_levels")
+   {
+      return new rspfStringProperty(name, rspfString::toString(getPyramidLevels()));
+   }
+   else if(name == "pyramid_model")
+   {
+      return new rspfStringProperty(name, getPyramidModel());
+   }
    else if(name == "output_filename")
    {
       rspfFilenameProperty* filenameProp =
@@ -677,4 +891,6 @@ void rspfImageCorrelator::getPropertyNames(std::vector<rspfString>& propertyName
    propertyNames.push_back("slave_accuracy");
    propertyNames.push_back("projection_type");
    propertyNames.push_back("output_filename");
+   propertyNames.push_back("pyramid_levels");
+   propertyNames.push_back("pyramid_model");
 }
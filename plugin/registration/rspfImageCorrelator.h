@@ -4,6 +4,13 @@
 // TODO : generate one file only : XML or Tabulated Text
 // TODO : change TieGPtSet to a generic TiePtSet
 // TODO : increase speed
+//
+// coarse to fine (pyramid_levels > 0) : matches first at 1/2^levels of the
+// output scale (renderers use the handlers' overviews), removes outliers with
+// rspfOutlierRejection (pyramid_model), then at each finer level the inliers
+// give a linear displacement model : the chip bias follows the model and the
+// search radius shrinks to the model residuals instead of the full slave
+// accuracy
 
 #ifndef rspfImageCorrelator_HEADER
 #define rspfImageCorrelator_HEADER
@@ -64,6 +71,10 @@ public:
    inline rspf_uint32       getTemplateRadius()const { return theTemplateRadius; }
    inline void               setMinCorrel(const rspf_float64& c) { theMinCorrel=c; }
    inline rspf_float64      getMinCorrel()const { return theMinCorrel; }   
+   inline void               setPyramidLevels(const rspf_uint32& l) { thePyramidLevels=l; }
+   inline rspf_uint32       getPyramidLevels()const { return thePyramidLevels; }
+   inline void               setPyramidModel(const rspfString& m) { thePyramidModel=m; }
+   inline const rspfString& getPyramidModel()const { return thePyramidModel; }
    
    inline bool hasRun()const { return theHasRun; }
 
@@ -104,6 +115,18 @@ protected:
          const rspfFilterResampler::rspfFilterResamplerType& stype =  rspfFilterResampler::rspfFilterResampler_CUBIC
          )const;
 
+   bool runPyramid(rspfMapProjection* outProj);
+   void setRendererView(rspfImageRenderer* renderer, rspfMapProjection* proj)const;
+   void buildTieSet(const vector<rspfTDpt>& tp,
+                    const rspfImageGeometry* geom,
+                    const rspfImageViewTransform* st,
+                    rspfTieGptSet& tset)const;
+   bool fitDisplacement(const rspfTieGptSet& tset,
+                        const rspfImageGeometry* geom,
+                        const rspfImageViewTransform* st,
+                        rspfDpt& bias, rspfDpt& biasDx, rspfDpt& biasDy,
+                        rspf_float64& rms)const;
+
    void computeDispStats(const vector<rspfTDpt>& tp)const;
    void rejectOutliersMedian(const vector<rspfTDpt>& tp, vector<rspfTDpt>& ftp, const rspf_float64& relError);
    void getMedianInlier1D(const vector<double>& sd, const rspf_float64& relError, rspf_float64& median, rspf_uint32& inlierCount);
@@ -120,6 +143,8 @@ protected:
    rspfString   theSlavePointProj;
    rspf_uint32  theTemplateRadius; //in pixels
    rspf_float64 theMinCorrel;
+   rspf_uint32  thePyramidLevels; //0 : single level
+   rspfString   thePyramidModel;  //model for outlier rejection between levels
 
    bool theHasRun; //to know whether execute has been run
 
@@ -0,0 +1,305 @@
+// class rspfNCC_Correlator implementation
+
+#include "rspfNCC_Correlator.h"
+#include "rspfNCC_FFTW.h"
+
+#include <algorithm>
+#include <cmath>
+
+// matrix to get the 2nd order x,y best fit polynomial (least mean squares)
+// -order of values (inputs) : from top left to bottom right along rows (normal image scan)
+// -order of coefficients (results) : 1 x y xy xx yy
+// uniform weighting for least mean squares
+const double rspfNCC_Correlator::theLMS[6*9] = {
+-1.1111111111111116e-001,2.2222222222222210e-001,-1.1111111111111116e-001,2.2222222222222210e-001,5.5555555555555536e-001,2.2222222222222210e-001,-1.1111111111111116e-001,2.2222222222222210e-001,-1.1111111111111116e-001,
+-1.6666666666666666e-001,0.0000000000000000e+000,1.6666666666666666e-001,-1.6666666666666666e-001,0.0000000000000000e+000,1.6666666666666666e-001,-1.6666666666666666e-001,0.0000000000000000e+000,1.6666666666666666e-001,
+-1.6666666666666666e-001,-1.6666666666666666e-001,-1.6666666666666666e-001,0.0000000000000000e+000,0.0000000000000000e+000,0.0000000000000000e+000,1.6666666666666666e-001,1.6666666666666666e-001,1.6666666666666666e-001,
+2.5000000000000000e-001,0.0000000000000000e+000,-2.5000000000000000e-001,0.0000000000000000e+000,0.0000000000000000e+000,0.0000000000000000e+000,-2.5000000000000000e-001,0.0000000000000000e+000,2.5000000000000000e-001,
+1.6666666666666669e-001,-3.3333333333333331e-001,1.6666666666666669e-001,1.6666666666666674e-001,-3.3333333333333326e-001,1.6666666666666674e-001,1.6666666666666669e-001,-3.3333333333333331e-001,1.6666666666666669e-001,
+1.6666666666666669e-001,1.6666666666666674e-001,1.6666666666666669e-001,-3.3333333333333331e-001,-3.3333333333333326e-001,-3.3333333333333331e-001,1.6666666666666669e-001,1.6666666666666674e-001,1.6666666666666669e-001
+};
+
+rspfNCC_Correlator::rspfNCC_Correlator()
+ : m_method(AUTO),
+   m_lastMethod(AUTO),
+   m_fft(NULL),
+   m_nx(0),
+   m_ny(0),
+   m_maxx(0),
+   m_maxy(0),
+   m_maxncc(-2.0),
+   m_ncc(),
+   m_master(),
+   m_sat(),
+   m_sat2()
+{
+}
+
+rspfNCC_Correlator::~rspfNCC_Correlator()
+{
+   if (m_fft != NULL)
+   {
+      delete m_fft;
+      m_fft = NULL;
+   }
+}
+
+bool
+rspfNCC_Correlator::directIsFaster(int my, int mx, int sy, int sx)
+{
+   //direct : one multiply-add per master pixel and offset
+   double direct = (double)my*mx * (double)(sy-my+1)*(sx-mx+1);
+   //fft : three real transforms of the correlation size (~2.5 n log2 n each)
+   // plus the spectrum product and normalization
+   double n   = (double)(sy+my-1)*(sx+mx-1);
+   double fft = n * (7.5 * std::log(n) / std::log(2.0) + 4.0);
+   return (direct <= fft);
+}
+
+bool
+rspfNCC_Correlator::correlate(int my, int mx, const double* master,
+                              int sy, int sx, const double* slave,
+                              double* pdispx, double* pdispy, double* pcor)
+{
+   if (pcor)   *pcor   = 0.0;
+   if (pdispx) *pdispx = 0.0;
+   if (pdispy) *pdispy = 0.0;
+
+   if ((master==NULL) || (slave==NULL) || (mx<1) || (my<1) ||
+       (sx<mx) || (sy<my) || ((sx-mx)%2) || ((sy-my)%2))
+   {
+      return false;
+   }
+
+   m_nx = sx-mx+1;
+   m_ny = sy-my+1;
+   m_maxx = 0;
+   m_maxy = 0;
+   m_maxncc = -2.0;
+
+   Method method = m_method;
+   if (method == AUTO)
+   {
+      method = directIsFaster(my, mx, sy, sx) ? DIRECT : FFT;
+   }
+   m_lastMethod = method;
+
+   if (method == FFT)
+   {
+      if (!correlateFft(my, mx, master, sy, sx, slave))
+      {
+         return false;
+      }
+   }
+   else
+   {
+      correlateDirect(my, mx, master, sy, sx, slave);
+   }
+
+   if (pcor) *pcor = m_maxncc;
+   refinePeak(pdispx, pdispy);
+   return true;
+}
+
+void
+rspfNCC_Correlator::correlateDirect(int my, int mx, const double* master,
+                                    int sy, int sx, const double* slave)
+{
+   int i,j,k,l,u,v;
+   const int mpix = my*mx;
+
+   //master minus average, and its standard deviation
+   m_master.resize(mpix);
+   double sum  = 0.0;
+   double sum2 = 0.0;
+   for (i=0;i<mpix;++i)
+   {
+      sum  += master[i];
+      sum2 += master[i]*master[i];
+   }
+   double invmpix = 1.0 / mpix;
+   double mavg = sum * invmpix;
+   double mstd = std::sqrt(std::fabs(sum2 * invmpix - mavg*mavg));
+   for (i=0;i<mpix;++i)
+   {
+      m_master[i] = master[i] - mavg;
+   }
+
+   m_ncc.assign(m_ny*m_nx, 0.0);
+   if (mstd <= 1e-13)
+   {
+      //flat master : no correlation
+      m_maxncc = 0.0;
+      return;
+   }
+
+   //summed area tables with a zero first row & column (no bound checks)
+   const int tw = sx+1;
+   m_sat.assign((sy+1)*tw, 0.0);
+   m_sat2.assign((sy+1)*tw, 0.0);
+   for (i=0;i<sy;++i)
+   {
+      const double* s  = slave + i*sx;
+      const double* p  = &m_sat [i*tw];
+      const double* p2 = &m_sat2[i*tw];
+      double* t  = &m_sat [(i+1)*tw];
+      double* t2 = &m_sat2[(i+1)*tw];
+      double rs  = 0.0;
+      double rs2 = 0.0;
+      for (j=0;j<sx;++j)
+      {
+         rs  += s[j];
+         rs2 += s[j]*s[j];
+         t [j+1] = p [j+1] + rs;
+         t2[j+1] = p2[j+1] + rs2;
+      }
+   }
+
+   //correlation : the master has zero mean, so the slave window mean drops out
+   // each master tap is applied to a whole row of offsets
+   for (v=0;v<m_ny;++v)
+   {
+      double* out = &m_ncc[v*m_nx];
+      for (k=0;k<my;++k)
+      {
+         const double* srow = slave + (v+k)*sx;
+         const double* mrow = &m_master[k*mx];
+         for (l=0;l<mx;++l)
+         {
+            const double  m = mrow[l];
+            const double* s = srow + l;
+            for (u=0;u<m_nx;++u)
+            {
+               out[u] += m * s[u];
+            }
+         }
+      }
+   }
+
+   //normalize with the slave window deviation, keep maximum
+   double cnorm = invmpix / mstd;
+   double* pcc = &m_ncc[0];
+   for (v=0;v<m_ny;++v)
+   {
+      const double* a  = &m_sat [v*tw];      //top rows of the windows
+      const double* b  = &m_sat [(v+my)*tw]; //bottom rows
+      const double* a2 = &m_sat2[v*tw];
+      const double* b2 = &m_sat2[(v+my)*tw];
+      for (u=0;u<m_nx;++u)
+      {
+         double wsum = (b [u+mx] - b [u] - a [u+mx] + a [u]) * invmpix;
+         double wvar = (b2[u+mx] - b2[u] - a2[u+mx] + a2[u]) * invmpix - wsum*wsum;
+         if (wvar > 1e-26)
+         {
+            *pcc *= cnorm / std::sqrt(wvar);
+         } else {
+            *pcc = 0.0;
+         }
+         if (m_maxncc < *pcc)
+         {
+            m_maxncc = *pcc;
+            m_maxx = u;
+            m_maxy = v;
+         }
+         ++pcc;
+      }
+   }
+}
+
+bool
+rspfNCC_Correlator::correlateFft(int my, int mx, const double* master,
+                                 int sy, int sx, const double* slave)
+{
+   int cx = sx+mx-1;
+   int cy = sy+my-1;
+
+   if ((m_fft != NULL) && !m_fft->sameDims(cy,cx))
+   {
+      delete m_fft;
+      m_fft = NULL;
+   }
+   if (m_fft == NULL)
+   {
+      m_fft = new rspfNCC_FFTW(cy,cx);
+   }
+
+   m_fft->ingestMaster(my,mx,master);
+   m_fft->ingestSlave(sy,sx,slave);
+   if (!m_fft->calculateNCC())
+   {
+      return false;
+   }
+
+   //full overlap part of the correlation : offset (u,v) is at (v+my-1, u+mx-1)
+   const rspfNCC_FFTW::cMatrix& corrmat = m_fft->getNcc();
+   m_ncc.resize(m_ny*m_nx);
+   double* pcc = &m_ncc[0];
+   for (int v=0;v<m_ny;++v)
+   {
+      const double* row = corrmat.getBuffer() + (v+my-1)*corrmat.fd() + (mx-1);
+      for (int u=0;u<m_nx;++u)
+      {
+         *pcc = row[u];
+         if (m_maxncc < *pcc)
+         {
+            m_maxncc = *pcc;
+            m_maxx = u;
+            m_maxy = v;
+         }
+         ++pcc;
+      }
+   }
+   return true;
+}
+
+void
+rspfNCC_Correlator::refinePeak(double* pdispx, double* pdispy)const
+{
+   //original best shift (integer shift for for max value), relative to centered chips
+   double dmcx = m_maxx - (m_nx-1)/2;
+   double dmcy = m_maxy - (m_ny-1)/2;
+
+   //find maximum, sub-pixel precision
+   //use least-square fit on 2nd order polynomial
+   if ((m_maxx > 0) && (m_maxx < m_nx-1) && (m_maxy > 0) && (m_maxy < m_ny-1))
+   {
+      //then there's a 3x3 neighborhood we can use to get better precision
+      double p2c[6]; //2nd order x y polynomial coefficents (see theLMS comments)
+      const double* pm = theLMS;
+      for (int k=0;k<6;++k)
+      {
+         p2c[k] = 0.0;
+         for(int i=-1;i<=1;++i)
+         {
+            const double* row = &m_ncc[(m_maxy+i)*m_nx + m_maxx];
+            for(int j=-1;j<=1;++j)
+            {
+               p2c[k] += *(pm++) * row[j];
+            }
+         }
+      }
+      //check convexity (det>0) + downwards orientation (trace<0)
+      double trace = p2c[4] + p2c[5];
+      if (trace<-1e-13) //TBC : -epsilon
+      {
+         double det = p2c[4]*p2c[5] - 0.25*p2c[3]*p2c[3];
+         if (det>1e-13) //TBC : epsilon
+         {
+            //ok : convex + downwards
+            //find maximum position
+            double optx = (p2c[3]*p2c[2] - 2.0 * p2c[5]*p2c[1]) / det * 0.25;
+            double opty = (p2c[3]*p2c[1] - 2.0 * p2c[4]*p2c[2]) / det * 0.25;
+            //limit new position to center pixel square
+            //TBD : need to find better model for NCC subpixel
+            if ((std::fabs(optx)<=0.501) && (std::fabs(opty)<=0.501))
+            {
+               dmcx+=optx;
+               dmcy+=opty;
+            }
+         }
+      }
+   }
+
+   if (pdispx) *pdispx = dmcx;
+   if (pdispy) *pdispy = dmcy;
+}
@@ -0,0 +1,85 @@
+// class rspfNCC_Correlator
+// finds the normalized cross correlation maximum of a master chip inside a
+// (larger) slave chip, with sub-pixel refinement of the peak
+//
+// two methods, picked per chip size (AUTO) or forced:
+// - DIRECT : master minus its mean is correlated with the slave, one master
+//   tap applied to a whole output row at a time (plain multiply-add loops the
+//   compiler vectorizes). Slave window means and variances come from summed
+//   area tables, so they cost four lookups per offset whatever the chip size
+// - FFT : rspfNCC_FFTW, for large masters/search windows where the transforms
+//   are cheaper than the direct sums
+// the peak is tracked while the NCC is normalized, then refined with a 2nd
+// order least squares fit on its 3x3 neighborhood
+//
+// one object per thread : holds working buffers and the FFT engine
+
+#ifndef rspfNCC_Correlator_HEADER
+#define rspfNCC_Correlator_HEADER
+
+#include <vector>
+
+class rspfNCC_FFTW;
+
+class rspfNCC_Correlator
+{
+public:
+   enum Method
+   {
+      AUTO   = 0,
+      DIRECT = 1,
+      FFT    = 2
+   };
+
+   rspfNCC_Correlator();
+   virtual ~rspfNCC_Correlator();
+
+   inline void   setMethod(Method m) { m_method = m; }
+   inline Method getMethod()const    { return m_method; }
+
+   //true if direct sums are expected to be cheaper than the FFT for those sizes
+   static bool directIsFaster(int my, int mx, int sy, int sx);
+
+   //master is my x mx, slave is sy x sx, row major
+   //slave must be larger than master by an even number of pixels in each direction
+   //displacement is slave position minus master position (0,0 = centers match), sub-pixel
+   //returns false for bad dimensions
+   bool correlate(int my, int mx, const double* master,
+                  int sy, int sx, const double* slave,
+                  double* pdispx, double* pdispy, double* pcor);
+
+   //NCC of the last correlate() for each integer offset (row major), size getNccHeight() x getNccWidth()
+   inline const std::vector<double>& getNcc()const { return m_ncc; }
+   inline int getNccWidth()const  { return m_nx; }
+   inline int getNccHeight()const { return m_ny; }
+
+   //method used by the last correlate()
+   inline Method getLastMethod()const { return m_lastMethod; }
+
+protected:
+   void correlateDirect(int my, int mx, const double* master, int sy, int sx, const double* slave);
+   bool correlateFft   (int my, int mx, const double* master, int sy, int sx, const double* slave);
+   void refinePeak(double* pdispx, double* pdispy)const;
+
+   Method              m_method;
+   Method              m_lastMethod;
+   rspfNCC_FFTW*       m_fft;
+   int                 m_nx; //number of offsets along x (sx-mx+1)
+   int                 m_ny;
+   int                 m_maxx; //integer peak position in m_ncc
+   int                 m_maxy;
+   double              m_maxncc;
+   std::vector<double> m_ncc;
+   std::vector<double> m_master; //master minus mean
+   std::vector<double> m_sat;    //zero padded summed area tables of the slave, (sy+1) x (sx+1)
+   std::vector<double> m_sat2;
+
+   //least squares 2nd order polynomial fit on 3x3 values
+   static const double theLMS[6*9];
+
+private:
+   rspfNCC_Correlator(const rspfNCC_Correlator&);
+   const rspfNCC_Correlator& operator=(const rspfNCC_Correlator&);
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "rspfNCC_FFTW.h"
 #include "rspfRunningSum.h"
 
+#include <algorithm>
 #include <cmath>
 
 rspfNCC_FFTW::rspfNCC_FFTW(int cy, int cx, const char* wisdom)
@@ -13,6 +14,8 @@ rspfNCC_FFTW::rspfNCC_FFTW(int cy, int cx, const char* wisdom)
    _pcx(2*(cx/2+1)),
    _NCC(cy,2*(cx/2+1)),
    _PS(cy,2*(cx/2+1)),
+   _plan(0),
+   _work(),
    _srs(NULL),
    _mavg(0.0),
    _mstd(0.0),
@@ -25,35 +28,18 @@ rspfNCC_FFTW::rspfNCC_FFTW(int cy, int cx, const char* wisdom)
    //re-use wisdom (if provided) : IMPORTANT don't exchange wisdom strings across different systems !
    if (wisdom)
    {
-      fftw_import_wisdom_from_string(wisdom);
+      rspfFftEngine::instance()->importWisdom(wisdom);
    }
 
-
-   //create plans : TBC TBD use different planner flags?
-   _splan = fftw_plan_dft_r2c_2d(_cy, 
-                                 _cx,
-                                 _PS.refBuffer(),
-                                 (double(*)[2])_PS.refBuffer(),
-                                 FFTW_MEASURE); //note: ESTIMATE flag does nor erase input/output buffer
-   _mplan = fftw_plan_dft_r2c_2d(_cy, 
-                                 _cx,
-                                 _NCC.refBuffer(),
-                                 (double(*)[2])_NCC.refBuffer(),
-                                 FFTW_MEASURE);
-   //inverse FFT (inplace)
-   _ccplan = fftw_plan_dft_c2r_2d(_cy, 
-                                  _cx,
-                                  (double(*)[2])_NCC.refBuffer(),
-                                  _NCC.refBuffer(),
-                                  FFTW_MEASURE);
+   //get shared plan : cached by the engine, so rebuilding an NCC of the same size is cheap
+   _plan = rspfFftEngine::instance()->getPlan(_cy, _cx);
+   _work.resize(2*_cy*_cx);
 }
 
 rspfNCC_FFTW::~rspfNCC_FFTW()
 {
-   //delete plans (matrices are automatically discarded)
-   fftw_destroy_plan(_ccplan);
-   fftw_destroy_plan(_mplan);
-   fftw_destroy_plan(_splan);
+   //release plan (matrices are automatically discarded)
+   _plan = 0;
    //delete running sum
    if (_srs!=NULL)
    {
@@ -148,15 +134,30 @@ rspfNCC_FFTW::calculateNCC()
       return false;
    }
 
+   if (!_plan.valid())
+   {
+      std::cerr<<"calculateNCC no FFT plan"<<std::endl;
+      return false;
+   }
+
    //transform padded reversed master & padded slave to freq. space
-   fftw_execute(_splan);
-   fftw_execute(_mplan);
+   //engine transforms are out of place : drop row padding, transform back into padded buffers
+   int i,j;
+   double* ws = &_work[0];
+   double* wm = ws + _cy*_cx;
+   for(i=0;i<_cy;++i)
+   {
+      std::copy(_PS.getBuffer()  + i*_pcx, _PS.getBuffer()  + i*_pcx + _cx, ws + i*_cx);
+      std::copy(_NCC.getBuffer() + i*_pcx, _NCC.getBuffer() + i*_pcx + _cx, wm + i*_cx);
+   }
+   const double* fin[2] = { ws, wm };
+   double* fout[2] = { _PS.refBuffer(), _NCC.refBuffer() };
+   rspfFftEngine::instance()->forward(_plan.get(), 2, fin, fout); //both in parallel
 
    //multiply master by slave in freq. space (half transform only)
    const double* s = _PS.getBuffer();
    double*       m = _NCC.refBuffer();
    double rr;
-   int i,j;
    for(i=0;i<_cy;++i) 
    {
       for(j=0;j<_cx/2+1;++j) //number of complex coeffs (halfed because of real transform)
@@ -171,8 +172,12 @@ rspfNCC_FFTW::calculateNCC()
       //note: no jump over padding
    }
 
-   //transform back to image space : correlation
-   fftw_execute(_ccplan);
+   //transform back to image space : correlation, then restore row padding
+   _plan->inverse(_NCC.refBuffer(), ws);
+   for(i=0;i<_cy;++i)
+   {
+      std::copy(ws + i*_cx, ws + (i+1)*_cx, _NCC.refBuffer() + i*_pcx);
+   }
 
    //normalize correlation (for unnormalized FFT in FFTW + local variance of slave)
    // MASTER cannot be flat because of feature detection (std=0)
@@ -186,8 +191,8 @@ rspfNCC_FFTW::calculateNCC()
    int maxx=-1;
    int startx = _mx-1;
    int starty = _my-1;
-   int endx   = _sx-1;
-   int endy   = _sy-1;
+   int endx   = _sx; //last full overlap position included
+   int endy   = _sy;
    double* pcc   = _NCC.refBuffer() + startx + starty * _pcx;
 
    for(i=starty;i<endy;++i) 
@@ -218,7 +223,7 @@ rspfNCC_FFTW::calculateNCC()
          ++pcc;
       }
 
-      pcc+=_pcx-(_sx-_mx);
+      pcc+=_pcx-(endx-startx);
    }
    _maxy   = maxy;
    _maxx   = maxx;
@@ -229,14 +234,7 @@ rspfNCC_FFTW::calculateNCC()
 std::string
 rspfNCC_FFTW::getWisdom()const
 {
-   char* ws=fftw_export_wisdom_to_string();
-   if (ws)
-   {
-      std::string s(ws);
-      fftw_free(ws);
-      return s;
-   }
-   return std::string();
+   return rspfFftEngine::instance()->exportWisdom();
 }
 
 void
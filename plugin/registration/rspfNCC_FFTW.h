@@ -1,11 +1,14 @@
 // class for carrying out a series of Normalized Cross Correlations
-// makes use of FFTW plans for speed
+// makes use of rspfFftEngine plans for speed (FFTW when the plugin's backend
+// is current), plans & wisdom are shared with other engine users
 
 #ifndef rspfNCC_FFTW_HEADER
 #define rspfNCC_FFTW_HEADER
 
+#include <rspf/imaging/rspfFftEngine.h>
 #include <fftw3.h>
 #include <string>
+#include <vector>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
@@ -111,9 +114,9 @@ protected:
 //end of inner class cMatrix
 
 
-//constructor allocates buffers and prepares FFTW plans
+//constructor allocates buffers and gets the engine plan
 //can't change dimensions of NCC
-//can re-use existing wisdom string if provided
+//can re-use existing wisdom string if provided (imported into the engine)
    rspfNCC_FFTW(int cy, int cx, const char* wisdom=0);
    virtual ~rspfNCC_FFTW();
 
@@ -140,7 +143,7 @@ protected:
    inline double         getSlaveStd()const  { return _sstd; }
    inline double         getSlaveAvg()const  { return _savg; }
 
-   //used to keep FFTW wisdom after object destruction
+   //used to keep engine (FFTW) wisdom after object destruction
    std::string getWisdom()const;
 
 protected:
@@ -154,9 +157,8 @@ protected:
    cMatrix _NCC; //used for padded master AND NCC
    cMatrix _PS;  //used for padded slave
 
-   fftw_plan _mplan; //stored plans
-   fftw_plan _splan;
-   fftw_plan _ccplan;
+   rspfRefPtr<rspfFftEngine::Plan> _plan; //shared engine plan (cy x cx)
+   std::vector<double> _work; //unpadded master & slave for out of place transforms
 
    rspfRunningSum* _srs;
    double _mavg; //master average
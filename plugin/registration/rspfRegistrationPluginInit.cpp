@@ -16,6 +16,9 @@
 #include <rspf/projection/rspfProjectionFactoryRegistry.h>
 #include "rspfRegistrationImageSourceFactory.h"
 #include "rspfRegistrationMiscFactory.h"
+#include "rspfFftwBackend.h"
+#include <rspf/imaging/rspfFftEngine.h>
+#include <fftw3.h>
 
 static void setDescription(rspfString& description)
 {
@@ -27,6 +30,7 @@ extern "C"
    static rspfSharedObjectInfo  myInfo;
    static rspfString theDescription;
    static std::vector<rspfString> theObjList;
+   static rspfRefPtr<rspfFftwBackend> theFftwBackend;
    static const char* getDescription()
    {
       return theDescription.c_str();
@@ -56,6 +60,13 @@ extern "C"
       rspfImageSourceFactoryRegistry::instance()->registerFactory(rspfRegistrationImageSourceFactory::instance());
       rspfObjectFactoryRegistry::instance()->registerFactory(rspfRegistrationMiscFactory::instance());
 
+      // Share FFTW plans and wisdom with all rspfFftEngine users.
+      if(!theFftwBackend.valid())
+      {
+         theFftwBackend = new rspfFftwBackend(FFTW_MEASURE);
+      }
+      rspfFftEngine::instance()->registerBackend(theFftwBackend.get());
+
       if(!theObjList.size())
       {
          rspfRegistrationImageSourceFactory::instance()->getTypeNameList(theObjList);
@@ -69,6 +80,10 @@ extern "C"
   {
      rspfImageSourceFactoryRegistry::instance()->unregisterFactory(rspfRegistrationImageSourceFactory::instance());
      rspfObjectFactoryRegistry::instance()->unregisterFactory(rspfRegistrationMiscFactory::instance());
-     
+     if(theFftwBackend.valid())
+     {
+        rspfFftEngine::instance()->unregisterBackend(theFftwBackend.get());
+        theFftwBackend = 0;
+     }
   }
 }
@@ -8,9 +8,162 @@ using namespace std;
 #include <rspf/imaging/rspfImageHandler.h>
 #include <rspf/base/rspfTrace.h>
 #include <rspf/base/rspfNotifyContext.h>
+#include <rspf/base/rspfCommon.h>
+#include <rspf/parallel/rspfJob.h>
+#include <rspf/parallel/rspfJobMultiThreadQueue.h>
+#include "rspfNCC_Correlator.h"
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
 
 static rspfTrace traceDebug("rspfTieGenerator:debug");
 
+//---
+// Tiles of one getAllFeatures run : hands out tile indices to the workers,
+// keeps one tie slot per tile (only written by the worker matching the tile,
+// so no lock is taken on ties) and lets the caller wait for tiles in order.
+//---
+class rspfTieTileQueue : public rspfReferenced
+{
+public:
+   rspfTieTileQueue(const rspfIpt& origin, rspf_int32 tileWidth, rspf_int32 tileHeight,
+                    rspf_int32 tilerows, rspf_int32 tilecols, rspf_uint32 workers)
+      : m_origin(origin),
+        m_tileWidth(tileWidth),
+        m_tileHeight(tileHeight),
+        m_tilecols(tilecols),
+        m_tiles((rspf_uint32)(tilerows*tilecols)),
+        m_next(0),
+        m_workers(workers),
+        m_ties(m_tiles),
+        m_done(m_tiles, false),
+        m_mutex(),
+        m_condition(),
+        m_inputMutex()
+   {
+   }
+
+   //next tile to match, false when none left or stopped
+   bool nextTile(rspf_uint32& index)
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      if (m_next >= m_tiles)
+      {
+         return false;
+      }
+      index = m_next++;
+      return true;
+   }
+
+   rspfIrect getTileRect(rspf_uint32 index)const
+   {
+      rspfIpt ul(m_origin.x + (rspf_int32)(index % m_tilecols) * m_tileWidth,
+                 m_origin.y + (rspf_int32)(index / m_tilecols) * m_tileHeight);
+      return rspfIrect(ul, rspfIpt(ul.x+m_tileWidth-1, ul.y+m_tileHeight-1));
+   }
+
+   std::vector<rspfTDpt>& getTies(rspf_uint32 index) { return m_ties[index]; }
+
+   void tileDone(rspf_uint32 index)
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      m_done[index] = true;
+      m_condition.broadcast();
+   }
+
+   void workerDone()
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      --m_workers;
+      m_condition.broadcast();
+   }
+
+   //blocks until tile index is matched, false if it never will be (stopped)
+   bool waitForTile(rspf_uint32 index)
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      while (!m_done[index] && m_workers)
+      {
+         m_condition.wait(&m_mutex);
+      }
+      return m_done[index];
+   }
+
+   //stops handing out tiles and waits for the workers to return
+   void stop()
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      m_next = m_tiles;
+      while (m_workers)
+      {
+         m_condition.wait(&m_mutex);
+      }
+   }
+
+   //serializes reads of the chip match inputs
+   OpenThreads::Mutex& getInputMutex() { return m_inputMutex; }
+
+protected:
+   virtual ~rspfTieTileQueue() {}
+
+   rspfIpt                               m_origin;
+   rspf_int32                            m_tileWidth;
+   rspf_int32                            m_tileHeight;
+   rspf_int32                            m_tilecols;
+   rspf_uint32                           m_tiles;
+   rspf_uint32                           m_next;
+   rspf_uint32                           m_workers;
+   std::vector< std::vector<rspfTDpt> >  m_ties;
+   std::vector<bool>                      m_done;
+   OpenThreads::Mutex                     m_mutex;
+   OpenThreads::Condition                 m_condition;
+   OpenThreads::Mutex                     m_inputMutex;
+};
+
+//---
+// Worker : reads the chips of a tile, then correlates them with its own NCC
+// engine while the other workers read or correlate theirs.
+//---
+class rspfTieMatchJob : public rspfJob
+{
+public:
+   rspfTieMatchJob(rspfChipMatch* chipMatch, rspfTieTileQueue* tiles)
+      : m_chipMatch(chipMatch),
+        m_tiles(tiles)
+   {
+   }
+
+   virtual void start()
+   {
+      running();
+      run();
+      m_tiles->workerDone();
+      finished();
+   }
+
+   void run()
+   {
+      rspfNCC_Correlator* engine = NULL;
+      std::vector<rspfChipMatch::Chip> chips;
+      rspf_uint32 index = 0;
+      while (m_tiles->nextTile(index))
+      {
+         {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_tiles->getInputMutex());
+            m_chipMatch->getChips(m_tiles->getTileRect(index), 0, chips);
+         }
+         m_chipMatch->matchChips(chips, engine, m_tiles->getTies(index));
+         chips.clear();
+         m_tiles->tileDone(index);
+      }
+      delete engine;
+   }
+
+private:
+   rspfChipMatch*                  m_chipMatch;
+   rspfRefPtr<rspfTieTileQueue>   m_tiles;
+};
+
 RTTI_DEF2(rspfTieGenerator, "rspfTieGenerator",
           rspfOutputSource, rspfProcessInterface);
 
@@ -25,7 +178,8 @@ rspfTieGenerator::rspfTieGenerator(rspfImageSource* inputSource)
       theAreaOfInterest(),
       theFilename(rspfFilename::NIL),
       theFileStream(),
-      theStoreFlag(false)
+      theStoreFlag(false),
+      theThreads(0)
 {
    connectMyInputTo(0, inputSource);
    theAreaOfInterest.makeNan();
@@ -114,9 +268,21 @@ bool rspfTieGenerator::getAllFeatures()
    // Start off with a percent complete at 0...
    setPercentComplete(0.0);
 
-   // loop through all tiles
-   // need to use a sequencer for parallelism in the future TBD
    theTiePoints.clear();
+
+   rspf_uint32 threads = theThreads ? theThreads : rspf::getNumberOfThreads();
+   if (threads > (rspf_uint32)(tilerows*tilecols))
+   {
+      threads = (rspf_uint32)(tilerows*tilecols);
+   }
+   if (threads > 1)
+   {
+      bool status = getAllFeaturesMt(src, threads, theAreaOfInterest.ul(), tilerows, tilecols);
+      if (traceDebug()) CLOG << " Exited." << endl;
+      return status;
+   }
+
+   // loop through all tiles
    rspf_int32 line=START_LINE;
    rspf_int32 i,j;
 
@@ -203,6 +369,52 @@ bool rspfTieGenerator::getAllFeatures()
    return true;
 }
 
+bool rspfTieGenerator::getAllFeaturesMt(rspfChipMatch* src, rspf_uint32 threads,
+                                         const rspfIpt& origin, rspf_int32 tilerows, rspf_int32 tilecols)
+{
+   const rspf_uint32 total_tiles = (rspf_uint32)(tilerows*tilecols);
+
+   rspfRefPtr<rspfTieTileQueue> tiles =
+      new rspfTieTileQueue(origin, src->getTileWidth(), src->getTileHeight(), tilerows, tilecols, threads);
+   rspfRefPtr<rspfJobMultiThreadQueue> queue =
+      new rspfJobMultiThreadQueue(new rspfJobQueue(), threads);
+   for (rspf_uint32 t=0;t<threads;++t)
+   {
+      rspfRefPtr<rspfJob> job = new rspfTieMatchJob(src, tiles.get());
+      queue->getJobQueue()->add(job.get(), false);
+   }
+
+   // write/store in tile order as tiles complete, same output as the serial loop
+   rspf_uint32 k=0;
+   for (;(k<total_tiles)&&!needsAborting();++k)
+   {
+      if (!tiles->waitForTile(k))
+      {
+         break;
+      }
+      vector<rspfTDpt>& tp = tiles->getTies(k);
+      if (theFilename != rspfFilename::NIL)
+      {
+         //write on stream
+         writeTiePoints(tp);
+      }
+      if (getStoreFlag())
+      {
+         theTiePoints.insert(theTiePoints.end(),tp.begin(),tp.end());
+      }
+      vector<rspfTDpt>().swap(tp);
+
+      setPercentComplete((k+1.0)/total_tiles*100.0);
+   }
+   tiles->stop();
+
+   if (k == total_tiles)
+   {
+      setPercentComplete(100.0);
+   }
+   return true;
+}
+
 void rspfTieGenerator::writeTiePoints(const vector<rspfTDpt>& tp)
 {
    for (vector<rspfTDpt>::const_iterator it=tp.begin();it!=tp.end();++it)
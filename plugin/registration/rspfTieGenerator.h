@@ -11,7 +11,10 @@
 //
 // created by Frederic Claudel, CSIR - Aug 2005 - using rspfVertexExtractor as a model
 //
-// TBD: parallelize : use a sequencer (for vector data as well)
+// parallel : tiles are handed out to worker threads, each matching its tiles
+// with its own NCC engine. Inputs are read one tile at a time (they are not
+// thread safe), ties of each tile go to their own slot and are written/stored
+// in tile order, so output is identical to the single thread run
 //
 
 #ifndef rspfTieGenerator_HEADER
@@ -46,6 +49,10 @@ public:
    inline bool getStoreFlag()const   { return theStoreFlag; }
    inline void setStoreFlag(bool sf) { theStoreFlag = sf; }
 
+   //number of matching threads, 0 (default) = rspf::getNumberOfThreads(), 1 = no worker thread
+   inline rspf_uint32 getNumberOfThreads()const    { return theThreads; }
+   inline void setNumberOfThreads(rspf_uint32 n)   { theThreads = n; }
+
    virtual       rspfObject* getObject()      { return this; }
    virtual const rspfObject* getObject()const { return this; }
    virtual       rspfObject* getObjectInterface() { return this; }
@@ -78,6 +85,8 @@ public:
 
 protected:
    bool getAllFeatures();
+   bool getAllFeaturesMt(rspfChipMatch* src, rspf_uint32 threads,
+                         const rspfIpt& origin, rspf_int32 tilerows, rspf_int32 tilecols);
    void writeTiePoints(const vector<rspfTDpt>& tp);
 
 private:
@@ -86,6 +95,7 @@ private:
    std::ofstream     theFileStream;
    vector<rspfTDpt> theTiePoints;
    bool              theStoreFlag;
+   rspf_uint32      theThreads;
 
    //! Disallow copy constructor and operator=
    rspfTieGenerator(const rspfTieGenerator&) {}
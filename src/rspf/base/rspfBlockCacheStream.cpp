@@ -0,0 +1,623 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfBlockCacheStream.cpp
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  See class descriptions in header.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#include <rspf/base/rspfBlockCacheStream.h>
+#include <rspf/base/rspfPreferences.h>
+#include <rspf/base/rspfString.h>
+#include <OpenThreads/ScopedLock>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+#  include <io.h>
+#  include <fcntl.h>
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#else
+#  include <fcntl.h>
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+static rspfBlockCache* theBlockCacheInstance = 0;
+
+static const rspf_uint32 MIN_BLOCK_SIZE = 4096;
+
+//---
+// rspfBlockCache::Statistics
+//---
+rspfBlockCache::Statistics::Statistics()
+   : m_hits(0),
+     m_misses(0),
+     m_readAheadBlocks(0),
+     m_bypassReads(0),
+     m_fileReads(0),
+     m_bytesRead(0),
+     m_evictions(0),
+     m_cachedBytes(0)
+{
+}
+
+double rspfBlockCache::Statistics::getHitRate() const
+{
+   rspf_uint64 lookups = m_hits + m_misses;
+   return lookups ? (double)m_hits / (double)lookups : 0.0;
+}
+
+//---
+// rspfBlockCache
+//---
+rspfBlockCache::rspfBlockCache()
+   : rspfReferenced(),
+     m_enabled(true),
+     m_blockSize(65536),
+     m_maxBytes(128 * 1024 * 1024),
+     m_readAheadBlocks(8),
+     m_blocks(),
+     m_index(),
+     m_files(),
+     m_nextFileKey(0),
+     m_stats(),
+     m_mutex()
+{
+}
+
+rspfBlockCache::~rspfBlockCache()
+{
+}
+
+rspfBlockCache* rspfBlockCache::instance()
+{
+   if (!theBlockCacheInstance)
+   {
+      theBlockCacheInstance = new rspfBlockCache();
+      theBlockCacheInstance->ref(); // Lives for the process.
+
+      rspfPreferences* prefs = rspfPreferences::instance();
+      const char* lookup = prefs->findPreference("stream_cache.enabled");
+      if (lookup)
+         theBlockCacheInstance->setEnabled(rspfString(lookup).toBool());
+      lookup = prefs->findPreference("stream_cache.block_size");
+      if (lookup)
+         theBlockCacheInstance->setBlockSize(rspfString(lookup).toUInt32());
+      lookup = prefs->findPreference("stream_cache.max_bytes");
+      if (lookup)
+         theBlockCacheInstance->setMaxBytes(rspfString(lookup).toUInt64());
+      lookup = prefs->findPreference("stream_cache.read_ahead_blocks");
+      if (lookup)
+         theBlockCacheInstance->setReadAheadBlocks(rspfString(lookup).toUInt32());
+   }
+   return theBlockCacheInstance;
+}
+
+void rspfBlockCache::setEnabled(bool flag)
+{
+   m_enabled = flag;
+}
+
+bool rspfBlockCache::isEnabled() const
+{
+   return m_enabled;
+}
+
+void rspfBlockCache::setBlockSize(rspf_uint32 size)
+{
+   size = ( (size + MIN_BLOCK_SIZE - 1) / MIN_BLOCK_SIZE ) * MIN_BLOCK_SIZE;
+   if (size < MIN_BLOCK_SIZE)
+      size = MIN_BLOCK_SIZE;
+
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   if (size != m_blockSize)
+   {
+      m_blockSize = size;
+      m_blocks.clear();
+      m_index.clear();
+      m_stats.m_cachedBytes = 0;
+   }
+}
+
+rspf_uint32 rspfBlockCache::getBlockSize() const
+{
+   return m_blockSize;
+}
+
+void rspfBlockCache::setMaxBytes(rspf_uint64 bytes)
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   m_maxBytes = bytes;
+   evict();
+}
+
+rspf_uint64 rspfBlockCache::getMaxBytes() const
+{
+   return m_maxBytes;
+}
+
+void rspfBlockCache::setReadAheadBlocks(rspf_uint32 blocks)
+{
+   m_readAheadBlocks = blocks;
+}
+
+rspf_uint32 rspfBlockCache::getReadAheadBlocks() const
+{
+   return m_readAheadBlocks;
+}
+
+void rspfBlockCache::clear()
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   m_blocks.clear();
+   m_index.clear();
+   m_files.clear();
+   m_stats.m_cachedBytes = 0;
+}
+
+rspfBlockCache::Statistics rspfBlockCache::getStatistics() const
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   return m_stats;
+}
+
+void rspfBlockCache::resetStatistics()
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   rspf_uint64 cachedBytes = m_stats.m_cachedBytes;
+   m_stats = Statistics();
+   m_stats.m_cachedBytes = cachedBytes;
+}
+
+std::ostream& rspfBlockCache::print(std::ostream& out) const
+{
+   Statistics stats = getStatistics();
+   out << "rspfBlockCache:"
+       << "\nenabled:           " << (m_enabled ? "true" : "false")
+       << "\nblock_size:        " << m_blockSize
+       << "\nmax_bytes:         " << m_maxBytes
+       << "\nread_ahead_blocks: " << m_readAheadBlocks
+       << "\ncached_bytes:      " << stats.m_cachedBytes
+       << "\nhits:              " << stats.m_hits
+       << "\nmisses:            " << stats.m_misses
+       << "\nhit_rate:          " << stats.getHitRate()
+       << "\nread_ahead_blocks_read: " << stats.m_readAheadBlocks
+       << "\nbypass_reads:      " << stats.m_bypassReads
+       << "\nfile_reads:        " << stats.m_fileReads
+       << "\nbytes_read:        " << stats.m_bytesRead
+       << "\nevictions:         " << stats.m_evictions
+       << std::endl;
+   return out;
+}
+
+rspf_uint64 rspfBlockCache::getFileKey(const std::string& path,
+                                        rspf_uint64 size,
+                                        rspf_int64 mtime)
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   std::map<std::string, FileInfo>::iterator i = m_files.find(path);
+   if ( (i != m_files.end()) && (i->second.m_size == size) && (i->second.m_mtime == mtime) )
+      return i->second.m_key;
+
+   // New or changed; blocks under an old key age out.
+   FileInfo info;
+   info.m_key   = ++m_nextFileKey;
+   info.m_size  = size;
+   info.m_mtime = mtime;
+   m_files[path] = info;
+   return info.m_key;
+}
+
+rspfRefPtr<rspfBlockCache::Block> rspfBlockCache::getBlock(int fd,
+                                                             rspf_uint64 fileKey,
+                                                             rspf_uint64 fileSize,
+                                                             rspf_uint64 index,
+                                                             rspf_uint32 readAhead)
+{
+   rspf_uint64 blockSize = 0;
+   rspf_uint64 count = 1;
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      std::map<BlockKey, BlockList::iterator>::iterator i =
+         m_index.find( BlockKey(fileKey, index) );
+      if (i != m_index.end())
+      {
+         ++m_stats.m_hits;
+         m_blocks.splice(m_blocks.begin(), m_blocks, i->second);
+         return i->second->second;
+      }
+      ++m_stats.m_misses;
+
+      // Read ahead up to end of file or the next block already here:
+      blockSize = m_blockSize;
+      rspf_uint64 ahead = std::min(readAhead, m_readAheadBlocks);
+      while ( (count <= ahead) && ((index + count) * blockSize < fileSize) &&
+              (m_index.find(BlockKey(fileKey, index + count)) == m_index.end()) )
+      {
+         ++count;
+      }
+   }
+
+   const rspf_uint64 offset = index * blockSize;
+   if (offset >= fileSize)
+      return 0;
+   const rspf_uint64 bytes = std::min(count * blockSize, fileSize - offset);
+
+   // Read outside the lock:
+   std::vector<char> buf( (size_t)bytes );
+   rspf_int64 got = readAt(fd, offset, &buf.front(), bytes);
+   if (got <= 0)
+      return 0;
+
+   //---
+   // Whole blocks are cached, and a partial one only at end of file;
+   // anything else from a short read goes back uncached.
+   //---
+   rspf_uint64 blocks = ( (rspf_uint64)got == bytes ) ? count : (rspf_uint64)got / blockSize;
+   rspfRefPtr<Block> result = 0;
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   ++m_stats.m_fileReads;
+   m_stats.m_bytesRead += got;
+   if (blocks == 0)
+   {
+      result = new Block();
+      result->m_offset = offset;
+      result->m_data.assign( buf.begin(), buf.begin() + (size_t)got );
+      return result;
+   }
+   m_stats.m_readAheadBlocks += blocks - 1;
+
+   // Requested block inserted last so it is the most recently used:
+   for (rspf_uint64 b = blocks; b > 0; --b)
+   {
+      BlockKey key(fileKey, index + b - 1);
+      std::map<BlockKey, BlockList::iterator>::iterator i = m_index.find(key);
+      if (i != m_index.end())
+      {
+         // Another stream got here first.
+         if (b == 1)
+            result = i->second->second;
+         continue;
+      }
+      const size_t start = (size_t)( (b - 1) * blockSize );
+      const size_t end   = std::min( (size_t)(b * blockSize), (size_t)bytes );
+      rspfRefPtr<Block> block = new Block();
+      block->m_offset = offset + start;
+      block->m_data.assign( buf.begin() + start, buf.begin() + end );
+      m_blocks.push_front( std::make_pair(key, block) );
+      m_index[key] = m_blocks.begin();
+      m_stats.m_cachedBytes += block->m_data.size();
+      if (b == 1)
+         result = block;
+   }
+   evict();
+   return result;
+}
+
+rspf_int64 rspfBlockCache::readDirect(int fd, rspf_uint64 offset, char* buf, rspf_uint64 size)
+{
+   rspf_int64 got = readAt(fd, offset, buf, size);
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   ++m_stats.m_bypassReads;
+   ++m_stats.m_fileReads;
+   if (got > 0)
+      m_stats.m_bytesRead += got;
+   return got;
+}
+
+rspf_int64 rspfBlockCache::readAt(int fd, rspf_uint64 offset, char* buf, rspf_uint64 size)
+{
+   rspf_uint64 done = 0;
+#if defined(_WIN32)
+   // No pread; the descriptor belongs to one stream so seek + read is safe.
+   if (_lseeki64(fd, (__int64)offset, SEEK_SET) < 0)
+      return -1;
+   while (done < size)
+   {
+      unsigned int want = (unsigned int)std::min(size - done, (rspf_uint64)0x40000000);
+      int got = _read(fd, buf + done, want);
+      if (got < 0)
+         return -1;
+      if (got == 0)
+         break;
+      done += got;
+   }
+#else
+   while (done < size)
+   {
+      ssize_t got = pread(fd, buf + done, (size_t)(size - done), (off_t)(offset + done));
+      if (got < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         return -1;
+      }
+      if (got == 0)
+         break;
+      done += got;
+   }
+#endif
+   return (rspf_int64)done;
+}
+
+void rspfBlockCache::evict()
+{
+   while ( (m_stats.m_cachedBytes > m_maxBytes) && !m_blocks.empty() )
+   {
+      m_stats.m_cachedBytes -= m_blocks.back().second->m_data.size();
+      m_index.erase(m_blocks.back().first);
+      m_blocks.pop_back();
+      ++m_stats.m_evictions;
+   }
+}
+
+//---
+// rspfBlockCacheStreamBuf
+//---
+rspfBlockCacheStreamBuf::rspfBlockCacheStreamBuf()
+   : std::streambuf(),
+     m_fd(-1),
+     m_fileKey(0),
+     m_fileSize(0),
+     m_block(0),
+     m_blockOffset(0),
+     m_pos(0),
+     m_lastIndex(0),
+     m_readAhead(0)
+{
+   setg(0, 0, 0);
+}
+
+rspfBlockCacheStreamBuf::~rspfBlockCacheStreamBuf()
+{
+   close();
+}
+
+bool rspfBlockCacheStreamBuf::is_open() const
+{
+   return (m_fd >= 0);
+}
+
+rspfBlockCacheStreamBuf* rspfBlockCacheStreamBuf::open(const char* name)
+{
+   if ( is_open() || !name )
+      return 0;
+
+#if defined(_WIN32)
+   m_fd = _open(name, _O_RDONLY | _O_BINARY);
+   struct _stati64 info;
+   if ( (m_fd >= 0) && (_fstati64(m_fd, &info) != 0) )
+#else
+   m_fd = ::open(name, O_RDONLY);
+   struct stat info;
+   if ( (m_fd >= 0) && (fstat(m_fd, &info) != 0) )
+#endif
+   {
+      close();
+   }
+   if (m_fd < 0)
+      return 0;
+
+   m_fileSize  = (rspf_uint64)info.st_size;
+   m_fileKey   = rspfBlockCache::instance()->getFileKey(
+      std::string(name), m_fileSize, (rspf_int64)info.st_mtime );
+   m_block     = 0;
+   m_pos       = 0;
+   m_lastIndex = (rspf_uint64)-1; // So block 0 counts as sequential.
+   m_readAhead = 0;
+   setg(0, 0, 0);
+   return this;
+}
+
+rspfBlockCacheStreamBuf* rspfBlockCacheStreamBuf::close()
+{
+   if (m_fd < 0)
+      return 0;
+#if defined(_WIN32)
+   _close(m_fd);
+#else
+   ::close(m_fd);
+#endif
+   m_fd = -1;
+   m_block = 0;
+   setg(0, 0, 0);
+   return this;
+}
+
+rspf_uint64 rspfBlockCacheStreamBuf::position() const
+{
+   return eback() ? m_blockOffset + (gptr() - eback()) : m_pos;
+}
+
+bool rspfBlockCacheStreamBuf::loadBlock(rspf_uint64 offset)
+{
+   m_block = 0;
+   setg(0, 0, 0);
+   m_pos = offset;
+   if ( (m_fd < 0) || (offset >= m_fileSize) )
+      return false;
+
+   rspfBlockCache* cache = rspfBlockCache::instance();
+   const rspf_uint64 index = offset / cache->getBlockSize();
+
+   // Consecutive blocks double the read ahead; anything else resets it.
+   if (index == m_lastIndex + 1)
+      m_readAhead = m_readAhead ? std::min(m_readAhead * 2, cache->getReadAheadBlocks()) : 1;
+   else if (index != m_lastIndex)
+      m_readAhead = 0;
+
+   m_block = cache->getBlock(m_fd, m_fileKey, m_fileSize, index, m_readAhead);
+   if ( !m_block.valid() || (offset < m_block->m_offset) ||
+        (offset >= m_block->m_offset + m_block->m_data.size()) )
+   {
+      m_block = 0;
+      return false;
+   }
+   m_lastIndex   = index;
+   m_blockOffset = m_block->m_offset;
+   char* data = &m_block->m_data.front();
+   setg( data, data + (offset - m_blockOffset), data + m_block->m_data.size() );
+   return true;
+}
+
+rspfBlockCacheStreamBuf::int_type rspfBlockCacheStreamBuf::underflow()
+{
+   if (gptr() < egptr())
+      return traits_type::to_int_type(*gptr());
+   if ( !loadBlock(position()) )
+      return traits_type::eof();
+   return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize rspfBlockCacheStreamBuf::xsgetn(char_type* s, std::streamsize n)
+{
+   std::streamsize done = 0;
+   while (done < n)
+   {
+      std::streamsize avail = egptr() - gptr();
+      if (avail > 0)
+      {
+         std::streamsize count = std::min(avail, n - done);
+         memcpy(s + done, gptr(), (size_t)count);
+         gbump( (int)count );
+         done += count;
+         continue;
+      }
+
+      rspf_uint64 pos = position();
+      if ( (m_fd < 0) || (pos >= m_fileSize) )
+         break;
+
+      //---
+      // Large reads, e.g. whole tile rows, go straight to the caller's buffer
+      // so they neither pay a copy nor flush the cache.
+      //---
+      rspf_uint64 remaining = (rspf_uint64)(n - done);
+      if ( remaining >= 2 * (rspf_uint64)rspfBlockCache::instance()->getBlockSize() )
+      {
+         rspf_uint64 want = std::min(remaining, m_fileSize - pos);
+         rspf_int64 got = rspfBlockCache::instance()->readDirect(m_fd, pos, s + done, want);
+         m_block = 0;
+         setg(0, 0, 0);
+         m_pos = pos + ( (got > 0) ? got : 0 );
+         if (got <= 0)
+            break;
+         done += (std::streamsize)got;
+         if ((rspf_uint64)got < want)
+            break;
+         continue;
+      }
+
+      if ( !loadBlock(pos) )
+         break;
+   }
+   return done;
+}
+
+std::streamsize rspfBlockCacheStreamBuf::showmanyc()
+{
+   rspf_uint64 pos = position();
+   return (pos < m_fileSize) ? (std::streamsize)(m_fileSize - pos) : -1;
+}
+
+rspfBlockCacheStreamBuf::pos_type rspfBlockCacheStreamBuf::seekoff(
+   off_type off, std::ios_base::seekdir dir, std::ios_base::openmode mode)
+{
+   if ( (m_fd < 0) || !(mode & std::ios_base::in) )
+      return pos_type(off_type(-1));
+
+   rspf_int64 base = 0;
+   if (dir == std::ios_base::cur)
+      base = (rspf_int64)position();
+   else if (dir == std::ios_base::end)
+      base = (rspf_int64)m_fileSize;
+   rspf_int64 pos = base + (rspf_int64)off;
+   if (pos < 0)
+      return pos_type(off_type(-1));
+
+   // Inside the current block just move the get pointer:
+   rspf_uint64 upos = (rspf_uint64)pos;
+   if ( eback() && (upos >= m_blockOffset) &&
+        (upos < m_blockOffset + (rspf_uint64)(egptr() - eback())) )
+   {
+      setg( eback(), eback() + (upos - m_blockOffset), egptr() );
+   }
+   else
+   {
+      m_block = 0;
+      setg(0, 0, 0);
+      m_pos = upos;
+   }
+   return pos_type(off_type(pos));
+}
+
+rspfBlockCacheStreamBuf::pos_type rspfBlockCacheStreamBuf::seekpos(
+   pos_type pos, std::ios_base::openmode mode)
+{
+   return seekoff(off_type(pos), std::ios_base::beg, mode);
+}
+
+//---
+// rspfBlockCacheIStream
+//---
+rspfBlockCacheIStream::rspfBlockCacheIStream()
+   : rspfIFStream(),
+     m_buf()
+{
+   init(&m_buf);
+}
+
+rspfBlockCacheIStream::rspfBlockCacheIStream(const char* name,
+                                               std::ios_base::openmode mode)
+   : rspfIFStream(),
+     m_buf()
+{
+   init(&m_buf);
+   open(name, mode);
+}
+
+rspfBlockCacheIStream::~rspfBlockCacheIStream()
+{
+   m_buf.close();
+}
+
+rspfBlockCacheStreamBuf* rspfBlockCacheIStream::rdbuf()
+{
+   return &m_buf;
+}
+
+void rspfBlockCacheIStream::open(const char* name,
+                                  std::ios_base::openmode /* mode */)
+{
+   if ( !m_buf.open(name) )
+   {
+      clear( rdstate() | std::ios::badbit );
+   }
+}
+
+void rspfBlockCacheIStream::close()
+{
+   if ( m_buf.is_open() )
+   {
+      if ( !m_buf.close() )
+      {
+         clear( rdstate() | std::ios::badbit );
+      }
+   }
+}
+
+bool rspfBlockCacheIStream::is_open() const
+{
+   return m_buf.is_open();
+}
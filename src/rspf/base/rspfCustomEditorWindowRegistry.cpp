@@ -153,3 +153,8 @@ extern "C"
     return rspfCustomEditorWindowRegistry::instance();
   }
 }
+
+rspf_uint32 rspfCustomEditorWindowRegistry::getNumberOfFactories()const
+{
+   return (rspf_uint32)theFactoryList.size();
+}
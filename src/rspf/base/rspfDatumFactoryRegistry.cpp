@@ -93,3 +93,8 @@ rspfDatumFactoryRegistry::rspfDatumFactoryRegistry()
    registerFactory(rspfDatumFactory::instance());
    registerFactory(rspfEpsgDatumFactory::instance());
 }
+
+rspf_uint32 rspfDatumFactoryRegistry::getNumberOfFactories()const
+{
+   return (rspf_uint32)theFactoryList.size();
+}
@@ -219,6 +219,21 @@ rspfIFStream::~rspfIFStream()
 {
 }
 
+void rspfIFStream::open(const char* file, std::ios_base::openmode mode)
+{
+   std::ifstream::open(file, mode);
+}
+
+void rspfIFStream::close()
+{
+   std::ifstream::close();
+}
+
+bool rspfIFStream::is_open() const
+{
+   return std::ifstream::rdbuf()->is_open();
+}
+
 rspfOFStream::rspfOFStream()
    : rspfStreamBase(),
      std::ofstream()
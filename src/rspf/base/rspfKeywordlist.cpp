@@ -10,13 +10,17 @@
 #include <rspf/base/rspfKeywordlist.h>
 #include <rspf/base/rspfDirectory.h>
 #include <rspf/base/rspfFilename.h>
+#include <rspf/base/rspfMemoryMappedFile.h>
 #include <rspf/base/rspfNotify.h>
+#include <rspf/base/rspfRefPtr.h>
 #include <rspf/base/rspfRegExp.h>
 #include <rspf/base/rspfTrace.h>
 
 #include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <fstream>
-#include <list>
+#include <set>
 #include <sstream>
 #include <utility>
 
@@ -33,6 +37,77 @@ static const char RSPF_ID[] = "$Id: rspfKeywordlist.cpp 21527 2012-08-26 16:50:4
 
 const std::string rspfKeywordlist::NULL_KW = "";
 
+// prefix + key with a single allocation.
+static std::string makeKey(const char* prefix, const char* key)
+{
+   std::string k;
+   if (prefix)
+   {
+      std::string::size_type prefixLength = strlen(prefix);
+      k.reserve(prefixLength + strlen(key));
+      k.append(prefix, prefixLength);
+   }
+   k.append(key);
+   return k;
+}
+
+static inline bool isKeywordlistWhitespace(char c)
+{
+   return ( (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r') );
+}
+
+//---
+// Returns the characters every match of regularExpression starts with, i.e. the literal
+// characters following a leading "^", or an empty string if there is no such head.
+// Alternation and optional groups give up since they make the head optional.
+//---
+static std::string getRegExpHead(const rspfString& regularExpression)
+{
+   std::string head;
+   const std::string& re = regularExpression.string();
+   if ( re.empty() || (re[0] != '^') || (re.find('|') != std::string::npos) )
+   {
+      return head;
+   }
+   bool inGroup = false;
+   std::string::size_type i = 1;
+   while (i < re.size())
+   {
+      char c = re[i];
+      if (c == '(')
+      {
+         inGroup = true;
+         ++i;
+      }
+      else if ( (c == '\\') && (i + 1 < re.size()) &&
+                !isalnum( static_cast<unsigned char>(re[i+1]) ) )
+      {
+         head += re[i+1];
+         i += 2;
+      }
+      else if ( strchr("^$.[])?+*\\", c) )
+      {
+         // A quantifier allowing zero of the previous character drops it from the head:
+         if ( ((c == '*') || (c == '?')) && !head.empty() )
+         {
+            head.erase(head.size() - 1);
+         }
+         break;
+      }
+      else
+      {
+         head += c;
+         ++i;
+      }
+   }
+   if ( inGroup && ( (re.find(")*") != std::string::npos) ||
+                     (re.find(")?") != std::string::npos) ) )
+   {
+      head.clear();
+   }
+   return head;
+}
+
 rspfKeywordlist::rspfKeywordlist(const rspfKeywordlist& src)
 :m_map(src.m_map),
 m_delimiter(src.m_delimiter),
@@ -132,17 +207,19 @@ void rspfKeywordlist::add(const rspfKeywordlist& kwl,
                            const char* prefix,
                            bool stripPrefix)
 {
-   std::map<std::string, std::string>::const_iterator iter = kwl.m_map.begin();
-   
    rspfRegExp regExp;
    
    // Check for null prefix.
    std::string tmpPrefix;
    if (prefix) tmpPrefix = prefix;
    
-   regExp.compile(("^("+tmpPrefix+")").c_str());
+   rspfString regularExpression = "^(" + tmpPrefix + ")";
+   regExp.compile(regularExpression.c_str());
    
-   while(iter != kwl.m_map.end())
+   KeywordMap::const_iterator iter;
+   KeywordMap::const_iterator last;
+   kwl.getRegExpRange(regularExpression, iter, last);
+   while(iter != last)
    {
       rspfString newKey;
       
@@ -181,21 +258,23 @@ void rspfKeywordlist::addPair(const std::string& key,
 {
    if ( key.size() )
    {
-      rspfString v = value;
-      if ( m_expandEnvVars == true )
-      {
-         v = v.expandEnvironmentVariable();
-      }
+      // One lookup; its position is the insert hint if the key is new.
+      KeywordMap::iterator i = m_map.lower_bound(key);
+      bool found = ( (i != m_map.end()) && !(key < (*i).first) );
       
-      KeywordMap::iterator i = getMapEntry(key);
-      
-      if (i == m_map.end())
-      {
-         m_map.insert(std::make_pair(key, v.string()));
-      }
-      else if (overwrite)
+      if ( !found || overwrite )
       {
-         (*i).second = v.string();
+         if ( m_expandEnvVars == true )
+         {
+            rspfString v = rspfString(value).expandEnvironmentVariable();
+            if (found) (*i).second = v.string();
+            else m_map.insert(i, std::make_pair(key, v.string()));
+         }
+         else
+         {
+            if (found) (*i).second = value;
+            else m_map.insert(i, std::make_pair(key, value));
+         }
       }
    }
 }
@@ -205,7 +284,9 @@ void rspfKeywordlist::addPair(const std::string& prefix,
                                const std::string& value,
                                bool               overwrite)
 {
-   std::string k(prefix + key);
+   std::string k;
+   k.reserve(prefix.size() + key.size());
+   k.append(prefix).append(key);
    addPair(k, value, overwrite);
 }
 
@@ -228,7 +309,7 @@ void rspfKeywordlist::add(const char* prefix,
 {
    if ( key )
    {
-      std::string k(prefix ? (std::string(prefix)+std::string(key)) : key);
+      std::string k = makeKey(prefix, key);
       std::string v(value ? value : "");
       addPair(k, v, overwrite);
    }
@@ -253,7 +334,7 @@ void rspfKeywordlist::add(const char* prefix,
 {
    if ( key )
    {
-      std::string k(prefix ? (std::string(prefix)+std::string(key)) : key);
+      std::string k = makeKey(prefix, key);
       std::string v(1, value);
       addPair(k, v, overwrite);
    }
@@ -278,7 +359,7 @@ void rspfKeywordlist::add(const char* prefix,
 {
    if ( key )
    {
-      std::string k(prefix ? (std::string(prefix)+std::string(key)) : key);
+      std::string k = makeKey(prefix, key);
       std::string v = rspfString::toString(value).string();
       addPair(k, v, overwrite);
    }
@@ -303,7 +384,7 @@ void rspfKeywordlist::add(const char* prefix,
 {
    if ( key )
    {
-      std::string k(prefix ? (std::string(prefix)+std::string(key)) : key);
+      std::string k = makeKey(prefix, key);
       std::string v = rspfString::toString(value).string();
       addPair(k, v, overwrite);
    }
@@ -328,7 +409,7 @@ void rspfKeywordlist::add(const char*  prefix,
 {
    if ( key )
    {
-      std::string k(prefix ? (std::string(prefix)+std::string(key)) : key);
+      std::string k = makeKey(prefix, key);
       std::string v = rspfString::toString(value).string();
       addPair(k, v, overwrite);
    }
@@ -353,7 +434,7 @@ void rspfKeywordlist::add(const char*  prefix,
 {
    if ( key )
    {
-      std::string k(prefix ? (std::string(prefix)+std::string(key)) : key);
+      std::string k = makeKey(prefix, key);
       std::string v = rspfString::toString(value).string();
       addPair(k, v, overwrite);
    }
@@ -378,7 +459,7 @@ void rspfKeywordlist::add(const char*  prefix,
 {
    if ( key )
    {
-      std::string k(prefix ? (std::string(prefix)+std::string(key)) : key);
+      std::string k = makeKey(prefix, key);
       std::string v = rspfString::toString(value).string();
       addPair(k, v, overwrite);
    }
@@ -403,7 +484,7 @@ void rspfKeywordlist::add(const char*  prefix,
 {
    if ( key )
    {
-      std::string k(prefix ? (std::string(prefix)+std::string(key)) : key);
+      std::string k = makeKey(prefix, key);
       std::string v = rspfString::toString(value).string();
       addPair(k, v, overwrite);
    }
@@ -430,7 +511,7 @@ void rspfKeywordlist::add(const char* prefix,
 {
    if ( key )
    {
-      std::string k(prefix ? (std::string(prefix)+std::string(key)) : key);
+      std::string k = makeKey(prefix, key);
       std::string v = rspfString::toString(value, precision).string();
       addPair(k, v, overwrite);
    }
@@ -457,7 +538,7 @@ void rspfKeywordlist::add(const char* prefix,
 {
    if ( key )
    {
-      std::string k(prefix ? (std::string(prefix)+std::string(key)) : key);
+      std::string k = makeKey(prefix, key);
       std::string v = rspfString::toString(value, precision).string();
       addPair(k, v, overwrite);
    }
@@ -579,7 +660,9 @@ const std::string& rspfKeywordlist::findKey(const std::string& key) const
 const std::string& rspfKeywordlist::findKey(const std::string& prefix,
                                              const std::string& key) const
 {
-   std::string k = prefix+key;
+   std::string k;
+   k.reserve(prefix.size() + key.size());
+   k.append(prefix).append(key);
    return findKey(k);
 }
 
@@ -589,9 +672,7 @@ const char* rspfKeywordlist::find(const char* key) const
    
    if (key)
    {
-      rspfString k = key;
-      
-      KeywordMap::const_iterator i = m_map.find(k.c_str());
+      KeywordMap::const_iterator i = m_map.find( std::string(key) );
       
       if (i != m_map.end())
       {
@@ -609,10 +690,7 @@ const char* rspfKeywordlist::find(const char* prefix,
    
    if (key)
    {
-      rspfString k;
-      if (prefix) k = prefix;
-      k += key;
-      KeywordMap::const_iterator i = m_map.find(k.c_str());
+      KeywordMap::const_iterator i = m_map.find( makeKey(prefix, key) );
       if (i != m_map.end())
       {
          result = (*i).second.c_str();
@@ -625,9 +703,7 @@ const char* rspfKeywordlist::find(const char* prefix,
 
 void rspfKeywordlist::remove(const char * key)
 {
-   rspfString k = key?key:"";
-   
-   KeywordMap::iterator i = m_map.find(k);
+   KeywordMap::iterator i = m_map.find( std::string(key?key:"") );
    
    if(i != m_map.end())
    {
@@ -639,11 +715,7 @@ void rspfKeywordlist::remove(const char* prefix, const char * key)
 {
    if (key)
    {
-      rspfString k;
-      if (prefix) k = prefix;
-      k += key;
-      
-      KeywordMap::iterator i = m_map.find(k);
+      KeywordMap::iterator i = m_map.find( makeKey(prefix, key) );
       
       if(i != m_map.end())
       {
@@ -678,7 +750,7 @@ rspf_uint32 rspfKeywordlist::numberOf(const char* prefix,
 {
    if ( key ) // Must have key, sometimes no prefix.
    {
-      std::string k(prefix ? (std::string(prefix)+std::string(key)) : key);
+      std::string k = makeKey(prefix, key);
       return numberOf(k.c_str());
    }
    return 0;
@@ -724,6 +796,17 @@ bool rspfKeywordlist::parseFile(const rspfFilename& file,
 {
    if(!file.exists()) return false;
    bool result = false;
+   
+   // Parse straight out of the mapped file. A binary file fails on its first bad character
+   // without being read in.
+   rspfRefPtr<rspfMemoryMappedFile> mappedFile = new rspfMemoryMappedFile;
+   if ( mappedFile->open(file) )
+   {
+      mappedFile->advise(rspfMemoryMappedFile::SEQUENTIAL);
+      return parseBuffer( (const char*)mappedFile->getData(), (std::size_t)mappedFile->getSize() );
+   }
+   
+   // Empty or not mappable (e.g. a pipe):
    std::ifstream is;
    is.open(file.c_str(), std::ios::in | std::ios::binary);
    
@@ -744,9 +827,117 @@ bool rspfKeywordlist::parseStream(std::istream& is, bool /* ignoreBinaryChars */
 
 bool rspfKeywordlist::parseString(const std::string& inString)
 {
-   std::istringstream in(inString);
+   return parseBuffer( inString.data(), inString.size() );
+}
+
+bool rspfKeywordlist::parseBuffer(const char* buffer, std::size_t size)
+{
+   if (!buffer)
+   {
+      return (size == 0);
+   }
+   
+   // Same rules as parseStream, on pointers into the buffer. Keys and values are copied once,
+   // into the map. Sorted input (e.g. written by writeToStream) appends at the end of the map.
+   const char* c   = buffer;
+   const char* end = buffer + size;
+   std::string key;
+   std::string value;
+   while (c < end)
+   {
+      while ( (c < end) && isKeywordlistWhitespace(*c) ) ++c;
+      if (c == end) return true; // we skipped to end so valid keyword list
+      
+      // Comment, to end of line:
+      if ( (*c == '/') && (c + 1 < end) && (c[1] == '/') )
+      {
+         for (c += 2; (c < end) && (*c != '\n') && (*c != '\r'); ++c)
+         {
+            if ( !isValidKeywordlistCharacter( (rspf_uint8)*c ) ) return false;
+         }
+         continue;
+      }
+      
+      // Key, to the delimiter:
+      const char* keyStart = c;
+      const char* keyEnd   = 0;
+      while (c < end)
+      {
+         char k = *c++;
+         if ( !isValidKeywordlistCharacter( (rspf_uint8)k ) )
+         {
+            return false;
+         }
+         if ( (k == '\n') || (k == '\r') )
+         {
+            // Line with no delimiter is allowed on the last line only.
+            return (c == end);
+         }
+         if (k == m_delimiter)
+         {
+            keyEnd = c - 1;
+            break;
+         }
+      }
+      if (!keyEnd) return false; // never found a delimiter so we are mal formed
+      while ( (keyStart < keyEnd) && isKeywordlistWhitespace(*keyStart) ) ++keyStart;
+      while ( (keyEnd > keyStart) && isKeywordlistWhitespace(*(keyEnd-1)) ) --keyEnd;
+      
+      // Value, to end of line unless it is in triple quotes:
+      while ( (c < end) && ((*c == ' ') || (*c == '\t')) ) ++c;
+      const char* valueStart = c;
+      const char* valueEnd   = c;
+      if ( (c < end) && ((*c == '\n') || (*c == '\r')) )
+      {
+         ++c; // blank value
+      }
+      else if ( (end - c >= 3) && (c[0] == '"') && (c[1] == '"') && (c[2] == '"') )
+      {
+         // Runs to the closing quotes, across lines. Unterminated keeps the opening quotes.
+         c += 3;
+         valueEnd = end;
+         while (c < end)
+         {
+            if ( !isValidKeywordlistCharacter( (rspf_uint8)*c ) ) return false;
+            ++c;
+            if ( (c - valueStart >= 6) && (c[-1] == '"') && (c[-2] == '"') && (c[-3] == '"') )
+            {
+               valueStart += 3;
+               valueEnd = c - 3;
+               break;
+            }
+         }
+      }
+      else
+      {
+         while ( (c < end) && (*c != '\n') && (*c != '\r') )
+         {
+            if ( !isValidKeywordlistCharacter( (rspf_uint8)*c ) ) return false;
+            ++c;
+         }
+         valueEnd = c;
+         if (c < end) ++c;
+      }
+      
+      if (keyStart == keyEnd)
+      {
+         return true;
+      }
+      key.assign(keyStart, keyEnd);
+      value.assign(valueStart, valueEnd);
+      if ( m_expandEnvVars == true )
+      {
+         value = rspfString(value).expandEnvironmentVariable().string();
+      }
+      // Like insert, an existing key keeps its value.
+      KeywordMap::iterator i = m_map.lower_bound(key);
+      if ( (i == m_map.end()) || (key < (*i).first) )
+      {
+         m_map.insert(i, std::make_pair(key, value));
+      }
+   }
    
-   return parseStream(in);
+   return true;
 }
 
 bool rspfKeywordlist::isValidKeywordlistCharacter(rspf_uint8 c)const
@@ -1032,12 +1223,14 @@ std::vector<rspfString> rspfKeywordlist::findAllKeysThatContains(const rspfStrin
 std::vector<rspfString> rspfKeywordlist::findAllKeysThatMatch(const rspfString &regularExpression)const
 {
    KeywordMap::const_iterator i;
+   KeywordMap::const_iterator last;
    std::vector<rspfString> result;
    rspfRegExp regExp;
    
    regExp.compile(regularExpression.c_str());
    
-   for(i = m_map.begin(); i != m_map.end(); ++i)
+   getRegExpRange(regularExpression, i, last);
+   for(; i != last; ++i)
    {
       if(regExp.find( (*i).first.c_str()))
       {
@@ -1052,12 +1245,13 @@ void rspfKeywordlist::extractKeysThatMatch(rspfKeywordlist& kwl,
                                             const rspfString &regularExpression)const
 {
    KeywordMap::const_iterator i;
-   std::vector<rspfString> result;
+   KeywordMap::const_iterator last;
    rspfRegExp regExp;
    
    regExp.compile(regularExpression.c_str());
    
-   for(i = m_map.begin(); i != m_map.end(); ++i)
+   getRegExpRange(regularExpression, i, last);
+   for(; i != last; ++i)
    {
       if(regExp.find( (*i).first.c_str()))
       {
@@ -1069,12 +1263,14 @@ void rspfKeywordlist::extractKeysThatMatch(rspfKeywordlist& kwl,
 void rspfKeywordlist::removeKeysThatMatch(const rspfString &regularExpression)
 {
    KeywordMap::const_iterator i;
+   KeywordMap::const_iterator last;
    std::vector<rspfString> result;
    rspfRegExp regExp;
    
    regExp.compile(regularExpression.c_str());
    
-   for(i = m_map.begin(); i != m_map.end(); ++i)
+   getRegExpRange(regularExpression, i, last);
+   for(; i != last; ++i)
    {
       if(regExp.find( (*i).first.c_str()))
       {
@@ -1098,20 +1294,29 @@ void rspfKeywordlist::getSubstringKeyList(std::vector<rspfString>& result,
                                            const rspfString& regularExpression)const
 {
    KeywordMap::const_iterator i;
+   KeywordMap::const_iterator last;
    rspfRegExp regExp;
    
    regExp.compile(regularExpression.c_str());
    
-   for(i = m_map.begin(); i != m_map.end(); ++i)
+   // Seeded with what the caller passed in, keeps the first seen order of result.
+   std::set<std::string> found;
+   for(std::vector<rspfString>::const_iterator r = result.begin(); r != result.end(); ++r)
+   {
+      found.insert( (*r).string() );
+   }
+   
+   getRegExpRange(regularExpression, i, last);
+   for(; i != last; ++i)
    {
       if(regExp.find( (*i).first.c_str()))
       {
-         rspfString value = rspfString((*i).first.begin()+regExp.start(),
-                                         (*i).first.begin()+regExp.start()+regExp.end());
+         std::string value( (*i).first.begin()+regExp.start(),
+                            (*i).first.begin()+regExp.start()+regExp.end() );
          
-         if(std::find(result.begin(), result.end(), value) == result.end())
+         if( found.insert(value).second )
          {
-            result.push_back(value);
+            result.push_back( rspfString(value) );
          }
       }
    }
@@ -1120,32 +1325,24 @@ void rspfKeywordlist::getSubstringKeyList(std::vector<rspfString>& result,
 rspf_uint32 rspfKeywordlist::getNumberOfSubstringKeys(const rspfString& regularExpression)const
 {
    KeywordMap::const_iterator i;
-   std::list<rspfString> currentList;
-   rspf_uint32 result = 0;
+   KeywordMap::const_iterator last;
+   std::set<std::string> currentList;
    rspfRegExp regExp;
    
    regExp.compile(regularExpression.c_str());
    
-   for(i = m_map.begin(); i != m_map.end(); ++i)
+   getRegExpRange(regularExpression, i, last);
+   for(; i != last; ++i)
    {
       if(regExp.find( (*i).first.c_str()))
       {
-         rspfString value = rspfString((*i).first.begin()+regExp.start(),
-                                         (*i).first.begin()+regExp.start()+regExp.end());
-         
-         // make sure we have not already marked it as
-         // found
-         if(std::find(currentList.begin(),
-                      currentList.end(),
-                      value) == currentList.end())
-         {
-            currentList.push_back(value);
-            ++result;
-         }
+         // the set only counts each substring once
+         currentList.insert( std::string( (*i).first.begin()+regExp.start(),
+                                          (*i).first.begin()+regExp.start()+regExp.end() ) );
       }
    }
    
-   return result;
+   return (rspf_uint32)currentList.size();
 }
 
 void rspfKeywordlist::addPrefixToAll(const rspfString& prefix)
@@ -1221,6 +1418,34 @@ void rspfKeywordlist::stripPrefixFromAll(const rspfString& regularExpression)
    }
 }
 
+void rspfKeywordlist::getPrefixRange(const std::string& prefix,
+                                     KeywordMap::const_iterator& first,
+                                     KeywordMap::const_iterator& last)const
+{
+   first = m_map.lower_bound(prefix);
+   last  = first;
+   while ( (last != m_map.end()) && ((*last).first.compare(0, prefix.size(), prefix) == 0) )
+   {
+      ++last;
+   }
+}
+
+void rspfKeywordlist::getRegExpRange(const rspfString& regularExpression,
+                                     KeywordMap::const_iterator& first,
+                                     KeywordMap::const_iterator& last)const
+{
+   std::string head = getRegExpHead(regularExpression);
+   if ( head.size() )
+   {
+      getPrefixRange(head, first, last);
+   }
+   else
+   {
+      first = m_map.begin();
+      last  = m_map.end();
+   }
+}
+
 rspf_uint32 rspfKeywordlist::getSize()const
 {
    return (rspf_uint32)m_map.size();
@@ -0,0 +1,170 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfMemoryMappedFile.cpp
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  See class description in header.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#include <rspf/base/rspfMemoryMappedFile.h>
+
+#include <cstring>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <sys/types.h>
+#  include <unistd.h>
+#endif
+
+rspfMemoryMappedFile::rspfMemoryMappedFile()
+   : rspfReferenced(),
+     m_data(0),
+     m_size(0)
+#if defined(_WIN32)
+   , m_fileHandle(0),
+     m_mappingHandle(0)
+#endif
+{
+}
+
+rspfMemoryMappedFile::~rspfMemoryMappedFile()
+{
+   close();
+}
+
+bool rspfMemoryMappedFile::open(const rspfFilename& file)
+{
+   close();
+
+#if defined(_WIN32)
+   HANDLE fh = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+   if (fh == INVALID_HANDLE_VALUE)
+      return false;
+   LARGE_INTEGER size;
+   if ( !GetFileSizeEx(fh, &size) || (size.QuadPart <= 0) ||
+        ((rspf_uint64)size.QuadPart > (rspf_uint64)((size_t)-1)) )
+   {
+      CloseHandle(fh);
+      return false;
+   }
+   HANDLE mh = CreateFileMappingA(fh, 0, PAGE_READONLY, 0, 0, 0);
+   if (!mh)
+   {
+      CloseHandle(fh);
+      return false;
+   }
+   void* data = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+   if (!data)
+   {
+      CloseHandle(mh);
+      CloseHandle(fh);
+      return false;
+   }
+   m_fileHandle    = fh;
+   m_mappingHandle = mh;
+   m_data = static_cast<rspf_uint8*>(data);
+   m_size = (rspf_uint64)size.QuadPart;
+#else
+   int fd = ::open(file.c_str(), O_RDONLY);
+   if (fd < 0)
+      return false;
+   struct stat info;
+   if ( (fstat(fd, &info) != 0) || (info.st_size <= 0) ||
+        ((rspf_uint64)info.st_size > (rspf_uint64)((size_t)-1)) )
+   {
+      ::close(fd);
+      return false;
+   }
+   void* data = mmap(0, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   ::close(fd); // The mapping keeps the file.
+   if (data == MAP_FAILED)
+      return false;
+   m_data = static_cast<rspf_uint8*>(data);
+   m_size = (rspf_uint64)info.st_size;
+#endif
+   return true;
+}
+
+void rspfMemoryMappedFile::close()
+{
+   if (!m_data)
+      return;
+#if defined(_WIN32)
+   UnmapViewOfFile(m_data);
+   CloseHandle( (HANDLE)m_mappingHandle );
+   CloseHandle( (HANDLE)m_fileHandle );
+   m_mappingHandle = 0;
+   m_fileHandle    = 0;
+#else
+   munmap(m_data, (size_t)m_size);
+#endif
+   m_data = 0;
+   m_size = 0;
+}
+
+bool rspfMemoryMappedFile::isOpen() const
+{
+   return (m_data != 0);
+}
+
+const rspf_uint8* rspfMemoryMappedFile::getData() const
+{
+   return m_data;
+}
+
+rspf_uint64 rspfMemoryMappedFile::getSize() const
+{
+   return m_size;
+}
+
+bool rspfMemoryMappedFile::read(rspf_uint64 offset, void* buf, rspf_uint64 size) const
+{
+   if ( !m_data || (offset > m_size) || (size > m_size - offset) )
+      return false;
+   memcpy(buf, m_data + offset, (size_t)size);
+   return true;
+}
+
+void rspfMemoryMappedFile::advise(Advice advice) const
+{
+#if !defined(_WIN32)
+   if (!m_data)
+      return;
+   int flag = MADV_NORMAL;
+   if (advice == SEQUENTIAL)
+      flag = MADV_SEQUENTIAL;
+   else if (advice == RANDOM)
+      flag = MADV_RANDOM;
+   madvise(m_data, (size_t)m_size, flag);
+#else
+   (void)advice;
+#endif
+}
+
+void rspfMemoryMappedFile::willNeed(rspf_uint64 offset, rspf_uint64 size) const
+{
+#if !defined(_WIN32)
+   if ( !m_data || (offset >= m_size) || !size )
+      return;
+   if (size > m_size - offset)
+      size = m_size - offset;
+
+   // madvise wants a page aligned start.
+   static const rspf_uint64 PAGE = (rspf_uint64)sysconf(_SC_PAGESIZE);
+   rspf_uint64 start = offset - (offset % PAGE);
+   madvise(m_data + start, (size_t)(size + offset - start), MADV_WILLNEED);
+#else
+   (void)offset;
+   (void)size;
+#endif
+}
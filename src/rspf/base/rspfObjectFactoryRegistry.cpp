@@ -20,6 +20,8 @@ using namespace std;
 
 
 rspfObjectFactoryRegistry::rspfObjectFactoryRegistry()
+   : rspfObject(),
+     rspfFactoryListInterface<rspfObjectFactory, rspfObject>("object")
 {
 }
 
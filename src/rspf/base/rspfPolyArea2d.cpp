@@ -9,6 +9,176 @@
 #include <rspf/kbool/graphlst.h>
 #include <rspf/kbool/_dl_itr.h>
 #include <rspf/base/rspfString.h>
+#include <cmath>
+
+namespace
+{
+   //---
+   // Douglas-Peucker on points [a, b] of ring, end points kept.
+   //---
+   void simplifySpan(const std::vector<rspfDpt>& ring,
+                     rspf_uint32 a,
+                     rspf_uint32 b,
+                     double tolerance,
+                     std::vector<bool>& keep)
+   {
+      std::vector< std::pair<rspf_uint32, rspf_uint32> > spans;
+      spans.push_back(std::make_pair(a, b));
+      while (spans.size())
+      {
+         a = spans.back().first;
+         b = spans.back().second;
+         spans.pop_back();
+         if (b < a+2) continue;
+
+         double dx  = ring[b].x - ring[a].x;
+         double dy  = ring[b].y - ring[a].y;
+         double len = std::sqrt(dx*dx + dy*dy);
+         double maxDistance = -1.0;
+         rspf_uint32 farthest = a;
+         for (rspf_uint32 k = a+1; k < b; ++k)
+         {
+            double x = ring[k].x - ring[a].x;
+            double y = ring[k].y - ring[a].y;
+            double d = (len > 0.0) ? std::fabs(dy*x - dx*y)/len : std::sqrt(x*x + y*y);
+            if (d > maxDistance)
+            {
+               maxDistance = d;
+               farthest = k;
+            }
+         }
+         if (maxDistance > tolerance)
+         {
+            keep[farthest] = true;
+            spans.push_back(std::make_pair(a, farthest));
+            spans.push_back(std::make_pair(farthest, b));
+         }
+      }
+   }
+
+   //---
+   // Closed ring: split at vertex 0 and the vertex farthest from it.
+   //---
+   rspfPolygon simplifyRing(const rspfPolygon& polygon, double tolerance)
+   {
+      std::vector<rspfDpt> ring = polygon.getVertexList();
+      rspf_uint32 n = (rspf_uint32)ring.size();
+      if (n < 4)
+      {
+         return polygon;
+      }
+
+      rspf_uint32 farthest = 0;
+      double maxDistance = -1.0;
+      for (rspf_uint32 k = 1; k < n; ++k)
+      {
+         double d = (ring[k] - ring[0]).length();
+         if (d > maxDistance)
+         {
+            maxDistance = d;
+            farthest = k;
+         }
+      }
+      ring.push_back(ring[0]);
+
+      std::vector<bool> keep(n+1, false);
+      keep[0] = true;
+      keep[farthest] = true;
+      simplifySpan(ring, 0, farthest, tolerance, keep);
+      simplifySpan(ring, farthest, n, tolerance, keep);
+
+      rspfPolygon result;
+      for (rspf_uint32 k = 0; k < n; ++k)
+      {
+         if (keep[k]) result.addPoint(ring[k]);
+      }
+      return result;
+   }
+
+   bool isConvex(const rspfPolygon& polygon)
+   {
+      rspf_uint32 n = polygon.getNumberOfVertices();
+      if (n < 3) return false;
+      int sign = 0;
+      double turn = 0.0; // One turn only, else a star.
+      for (rspf_uint32 i = 0; i < n; ++i)
+      {
+         const rspfDpt& p0 = polygon[i];
+         const rspfDpt& p1 = polygon[(i+1)%n];
+         const rspfDpt& p2 = polygon[(i+2)%n];
+         double cross = (p1.x-p0.x)*(p2.y-p1.y) - (p1.y-p0.y)*(p2.x-p1.x);
+         double dot   = (p1.x-p0.x)*(p2.x-p1.x) + (p1.y-p0.y)*(p2.y-p1.y);
+         turn += std::atan2(cross, dot);
+         if (cross > 0.0)
+         {
+            if (sign < 0) return false;
+            sign = 1;
+         }
+         else if (cross < 0.0)
+         {
+            if (sign > 0) return false;
+            sign = -1;
+         }
+      }
+      return (sign != 0) && (std::fabs(std::fabs(turn) - 2.0*M_PI) < 1.0e-6);
+   }
+
+   //---
+   // True if every vertex of inner is inside or on the convex polygon.
+   //---
+   bool isWithinConvex(const rspfPolygon& convex,
+                       const std::vector<rspfPolygon>& inner,
+                       double epsilon)
+   {
+      rspf_uint32 n = convex.getNumberOfVertices();
+      double orientation = (convex.area() < 0.0) ? -1.0 : 1.0;
+      for (rspf_uint32 r = 0; r < inner.size(); ++r)
+      {
+         for (rspf_uint32 v = 0; v < inner[r].getNumberOfVertices(); ++v)
+         {
+            const rspfDpt& pt = inner[r][v];
+            for (rspf_uint32 i = 0; i < n; ++i)
+            {
+               const rspfDpt& p0 = convex[i];
+               const rspfDpt& p1 = convex[(i+1)%n];
+               double cross = (p1.x-p0.x)*(pt.y-p0.y) - (p1.y-p0.y)*(pt.x-p0.x);
+               if (cross*orientation < -epsilon*(p1-p0).length())
+               {
+                  return false;
+               }
+            }
+         }
+      }
+      return true;
+   }
+
+   //---
+   // True if polygon is an axis aligned rectangle; rect set to it.
+   //---
+   bool isRectangle(const rspfPolygon& polygon, rspfDrect& rect)
+   {
+      if (polygon.getNumberOfVertices() != 4) return false;
+      for (rspf_uint32 i = 0; i < 4; ++i)
+      {
+         const rspfDpt& p0 = polygon[i];
+         const rspfDpt& p1 = polygon[(i+1)%4];
+         if ((p0.x == p1.x) == (p0.y == p1.y)) return false;
+      }
+      polygon.getBoundingRect(rect);
+      return true;
+   }
+
+   void getBounds(const std::vector<rspfPolygon>& rings, rspfDrect& rect)
+   {
+      rect.makeNan();
+      for (rspf_uint32 i = 0; i < rings.size(); ++i)
+      {
+         rspfDrect r;
+         rings[i].getBoundingRect(r);
+         rect = rect.hasNans() ? r : rect.combine(r);
+      }
+   }
+}
 
 std::ostream& operator <<(std::ostream& out, const rspfPolyArea2d& rhs)
 {
@@ -227,6 +397,10 @@ rspfPolyArea2d rspfPolyArea2d::operator +(const rspfPolyArea2d& rhs)const
    {
       return result;
    }
+   if(result.unionFastPath(rhs))
+   {
+      return result;
+   }
    performOperation(result, rhs, BOOL_OR);
    return result;
 }
@@ -296,6 +470,10 @@ const rspfPolyArea2d& rspfPolyArea2d::operator +=(const rspfPolyArea2d& rhs)
    {
       return *this;
    }
+   if(unionFastPath(rhs))
+   {
+      return *this;
+   }
    performOperation(rhs, BOOL_OR);
    return *this;
 }
@@ -344,6 +522,156 @@ void rspfPolyArea2d::clearPolygons()
    clearEngine();
 }
 
+void rspfPolyArea2d::simplify(double tolerance)
+{
+   if(isEmpty() || (tolerance <= 0.0))
+   {
+      return;
+   }
+   vector<rspfPolygon> outside;
+   vector<rspfPolygon> holes;
+   getRings(outside, holes);
+
+   vector<rspfPolygon> simplifiedOutside;
+   vector<rspfPolygon> simplifiedHoles;
+   rspf_uint32 idx = 0;
+   for(idx = 0; idx < outside.size(); ++idx)
+   {
+      rspfPolygon ring = simplifyRing(outside[idx], tolerance);
+      if(ring.getNumberOfVertices() > 2)
+      {
+         simplifiedOutside.push_back(ring);
+      }
+   }
+   for(idx = 0; idx < holes.size(); ++idx)
+   {
+      rspfPolygon ring = simplifyRing(holes[idx], tolerance);
+      if(ring.getNumberOfVertices() > 2)
+      {
+         simplifiedHoles.push_back(ring);
+      }
+   }
+   setRings(simplifiedOutside, simplifiedHoles);
+}
+
+bool rspfPolyArea2d::unionFastPath(const rspfPolyArea2d& rhs)
+{
+   vector<rspfPolygon> outside;
+   vector<rspfPolygon> holes;
+   vector<rspfPolygon> rhsOutside;
+   vector<rspfPolygon> rhsHoles;
+   getRings(outside, holes);
+   rhs.getRings(rhsOutside, rhsHoles);
+   if(outside.empty() || rhsOutside.empty())
+   {
+      return false;
+   }
+
+   rspfDrect bounds;
+   rspfDrect rhsBounds;
+   getBounds(outside, bounds);
+   getBounds(rhsOutside, rhsBounds);
+
+   // Disjoint bounds: both sides are kept as they are.  Holes would come
+   // back as outside polygons so those go through the engine.
+   if(holes.empty() && rhsHoles.empty() &&
+      ((bounds.lr().x < rhsBounds.ul().x) || (rhsBounds.lr().x < bounds.ul().x) ||
+       (bounds.lr().y < rhsBounds.ul().y) || (rhsBounds.lr().y < bounds.ul().y)))
+   {
+      add(rhs);
+      return true;
+   }
+
+   // One side inside the other, convex, side.
+   double epsilon = theEngine->GetMarge()*10;
+   if((rhsOutside.size() == 1) && rhsHoles.empty() && isConvex(rhsOutside[0]) &&
+      isWithinConvex(rhsOutside[0], outside, epsilon))
+   {
+      *this = rhsOutside[0];
+      return true;
+   }
+   if((outside.size() == 1) && holes.empty() && isConvex(outside[0]) &&
+      isWithinConvex(outside[0], rhsOutside, epsilon))
+   {
+      return true;
+   }
+
+   // Two rectangles sharing a full side.
+   rspfDrect rect;
+   rspfDrect rhsRect;
+   if((outside.size() == 1) && (rhsOutside.size() == 1) && holes.empty() && rhsHoles.empty() &&
+      isRectangle(outside[0], rect) && isRectangle(rhsOutside[0], rhsRect))
+   {
+      bool sameRows = (rect.ul().y == rhsRect.ul().y) && (rect.lr().y == rhsRect.lr().y) &&
+         (rect.ul().x <= rhsRect.lr().x) && (rhsRect.ul().x <= rect.lr().x);
+      bool sameColumns = (rect.ul().x == rhsRect.ul().x) && (rect.lr().x == rhsRect.lr().x) &&
+         (rect.ul().y <= rhsRect.lr().y) && (rhsRect.ul().y <= rect.lr().y);
+      if(sameRows || sameColumns)
+      {
+         *this = rspfPolygon(rect.combine(rhsRect));
+         return true;
+      }
+   }
+
+   return false;
+}
+
+void rspfPolyArea2d::getRings(vector<rspfPolygon>& outside,
+                               vector<rspfPolygon>& holes)const
+{
+   if(isEmpty()) return;
+
+   theEngine->StartPolygonGet();
+   while ( theEngine->nextPolygon() )
+   {
+      kbEdgeType edgeType = theEngine->GetPolygonPointEdgeType();
+      if(edgeType == KB_FALSE_EDGE)
+      {
+         continue;
+      }
+      vector<rspfPolygon>& rings = (edgeType == KB_INSIDE_EDGE) ? holes : outside;
+      rings.push_back(rspfPolygon());
+      rspfPolygon& polygon = rings[rings.size()-1];
+      while ( theEngine->PolygonHasMorePoints() )
+      {
+         rspfDpt pt(theEngine->GetPolygonXPoint(),
+                     theEngine->GetPolygonYPoint());
+         if(!polygon.getNumberOfVertices() || (pt != polygon[0]))
+         {
+            polygon.addPoint(pt);
+         }
+      }
+   }
+}
+
+void rspfPolyArea2d::setRings(const vector<rspfPolygon>& outside,
+                               const vector<rspfPolygon>& holes)
+{
+   clearEngine();
+
+   // Clockwise as in operator =.
+   rspf_uint32 idx = 0;
+   for(idx = 0; idx < outside.size() + holes.size(); ++idx)
+   {
+      rspfPolygon ring = (idx < outside.size()) ? outside[idx] : holes[idx-outside.size()];
+      ring.checkOrdering();
+      if(ring.getOrdering() == RSPF_COUNTERCLOCKWISE_ORDER)
+      {
+         ring.reverseOrder();
+      }
+      theEngine->StartPolygonAdd((idx < outside.size()) ? GROUP_A : GROUP_B);
+      for(rspf_uint32 v = 0; v < ring.getNumberOfVertices(); ++v)
+      {
+         theEngine->AddPoint(ring[v].x, ring[v].y);
+      }
+      theEngine->EndPolygonAdd();
+   }
+   if(holes.size())
+   {
+      theEngine->Do_Operation(BOOL_A_SUB_B);
+   }
+}
+
 void rspfPolyArea2d::performOperation(rspfPolyArea2d& result,
                                        const rspfPolyArea2d& rhs,
                                        BOOL_OP operation)const
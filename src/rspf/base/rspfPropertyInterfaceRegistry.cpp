@@ -112,3 +112,8 @@ extern "C"
     return rspfPropertyInterfaceRegistry::instance();
   }
 }
+
+rspf_uint32 rspfPropertyInterfaceRegistry::getNumberOfFactories()const
+{
+   return (rspf_uint32)theFactoryList.size();
+}
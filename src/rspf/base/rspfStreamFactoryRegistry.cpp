@@ -9,6 +9,7 @@
 //
 #include <rspf/base/rspfStreamFactoryRegistry.h>
 #include <rspf/base/rspfStreamFactory.h>
+#include <rspf/base/rspfBlockCacheStream.h>
 #include <rspf/base/rspfIoStream.h>
 #include <rspf/base/rspfFilename.h>
 
@@ -48,6 +49,24 @@ rspfStreamFactoryRegistry::createNewIFStream(
       result = theFactoryList[idx]->createNewIFStream(file, openMode);
    }
 
+   //---
+   // Binary read only opens go through the shared block cache so handlers
+   // doing many small seekg/read calls hit memory instead of the file.
+   //---
+   if(!result &&
+      (openMode & std::ios_base::in) &&
+      (openMode & std::ios_base::binary) &&
+      !(openMode & std::ios_base::out) &&
+      rspfBlockCache::instance()->isEnabled())
+   {
+      rspfRefPtr<rspfBlockCacheIStream> cached =
+         new rspfBlockCacheIStream(file.c_str(), openMode);
+      if(cached->is_open())
+      {
+         result = cached.get();
+      }
+   }
+
    if(!result)
    {
       result = new rspfIFStream(file.c_str(),
@@ -73,3 +92,8 @@ void rspfStreamFactoryRegistry::registerFactory(rspfStreamFactoryBase* factory)
 
 rspfStreamFactoryRegistry::rspfStreamFactoryRegistry(const rspfStreamFactoryRegistry&)
 {}
+
+rspf_uint32 rspfStreamFactoryRegistry::getNumberOfFactories()const
+{
+   return (rspf_uint32)theFactoryList.size();
+}
@@ -4,6 +4,7 @@
 rspfWebRequestFactoryRegistry* rspfWebRequestFactoryRegistry::m_instance = 0;
 
 rspfWebRequestFactoryRegistry::rspfWebRequestFactoryRegistry()
+   : rspfFactoryListInterface<rspfWebRequestFactoryBase, rspfWebRequest>("web_request")
 {
    m_instance = this;
 }
@@ -27,6 +28,7 @@ rspfObject* rspfWebRequestFactoryRegistry::createObject(const rspfKeywordlist& k
 
 rspfWebRequest* rspfWebRequestFactoryRegistry::create(const rspfUrl& url)
 {
+   loadDeferredPlugins();
    rspf_uint32 idx = 0;
    rspfWebRequest* result = 0;
    for(idx = 0; ((idx < m_factoryList.size())&&!result); ++idx)
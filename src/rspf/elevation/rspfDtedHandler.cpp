@@ -19,6 +19,7 @@
 #include <rspf/base/rspfNotify.h>
 #include <rspf/base/rspfGpt.h>
 #include <rspf/base/rspfKeywordlist.h>
+#include <rspf/base/rspfStreamFactoryRegistry.h>
 
 RTTI_DEF1(rspfDtedHandler, "rspfDtedHandler" , rspfElevCellHandler)
 
@@ -35,7 +36,7 @@ static const char ENABLE_STATS_KW[] = "elevation.compute_statistics.enabled";
 rspfDtedHandler::rspfDtedHandler(const rspfFilename& dted_file, bool memoryMapFlag)
    :
       rspfElevCellHandler(dted_file),
-      m_fileStr(),
+      m_fileStr(0),
       m_numLonLines(0),
       m_numLatPoints(0),
       m_dtedRecordSizeInBytes(0),
@@ -114,7 +115,7 @@ bool rspfDtedHandler::getAccuracyInfo(rspfElevationAccuracyInfo& info,
 
 double rspfDtedHandler::getHeightAboveMSL(const rspfGpt& gpt)
 {
-   if(m_fileStr.is_open())
+   if(m_fileStr.valid())
    {
       return getHeightAboveMSL(gpt, true);
    }
@@ -131,12 +132,13 @@ bool rspfDtedHandler::open(const rspfFilename& file, bool memoryMapFlag)
    static const char* MODULE = "rspfDtedHandler::open";
    close();
    theFilename = file;
-   m_fileStr.clear();
 
-   m_fileStr.open(file.c_str(), 
-                  std::ios::in | std::ios::binary);
-   if(!m_fileStr.good())
+   // From the factory, so posts come out of the shared block cache:
+   m_fileStr = rspfStreamFactoryRegistry::instance()->
+      createNewIFStream(file, std::ios::in | std::ios::binary);
+   if(!m_fileStr.valid() || !m_fileStr->good())
    {
+      m_fileStr = 0;
       return false;
    }
    m_numLonLines = 0;
@@ -144,11 +146,11 @@ bool rspfDtedHandler::open(const rspfFilename& file, bool memoryMapFlag)
    m_dtedRecordSizeInBytes = 0;
    
    // Attempt to parse.
-   m_vol.parse(m_fileStr);
-   m_hdr.parse(m_fileStr);
-   m_uhl.parse(m_fileStr);
-   m_dsi.parse(m_fileStr);
-   m_acc.parse(m_fileStr);
+   m_vol.parse(*m_fileStr);
+   m_hdr.parse(*m_fileStr);
+   m_uhl.parse(*m_fileStr);
+   m_dsi.parse(*m_fileStr);
+   m_acc.parse(*m_fileStr);
 
    //***
    // Check for errors.  Must have uhl, dsi and acc records.  vol and hdr
@@ -173,11 +175,11 @@ bool rspfDtedHandler::open(const rspfFilename& file, bool memoryMapFlag)
    }
    if(memoryMapFlag)
    {
-      m_fileStr.seekg(0);
-      m_fileStr.clear();
+      m_fileStr->seekg(0);
+      m_fileStr->clear();
       m_memoryMap.resize(theFilename.fileSize());
-      m_fileStr.read((char*)(&m_memoryMap.front()), (std::streamsize)m_memoryMap.size());
-      m_fileStr.close();
+      m_fileStr->read((char*)(&m_memoryMap.front()), (std::streamsize)m_memoryMap.size());
+      m_fileStr = 0;
    }
    
    m_numLonLines  = m_uhl.numLonLines();
@@ -333,22 +335,22 @@ void rspfDtedHandler::readPostsFromFile( DtedHeight &postData, int offset)
   // read the posts in blocks 2x2.
   for ( int column = 0; column < NUM_POSTS_PER_BLOCK ; ++column )
   {
-    m_fileStr.seekg( offset, std::ios::beg );
+    m_fileStr->seekg( offset, std::ios::beg );
     for ( int row = 0; row < NUM_POSTS_PER_BLOCK ; ++row )
     {
-      if ( !m_fileStr.eof() )
+      if ( !m_fileStr->eof() )
       {
         us = 0;
-        m_fileStr.read( ( char* ) &us, POST_SIZE );
+        m_fileStr->read( ( char* ) &us, POST_SIZE );
         // check the read was ok
-        if ( m_fileStr.good() )
+        if ( m_fileStr->good() )
         {
           postData.m_posts[postCount].m_status = true;
         }
         else
         {
           // reset the goodbit
-          m_fileStr.clear();
+          m_fileStr->clear();
         }
         ss = convertSignedMagnitude( us );
         postData.m_posts[postCount].m_height = ss;
@@ -386,12 +388,12 @@ double rspfDtedHandler::getPostValue(const rspfIpt& gridPt) const
       gridPt.y * 2 + DATA_RECORD_OFFSET_TO_POST;
    
    // Put the file pointer at the start of the first elevation post.
-   m_fileStr.seekg(offset, std::ios::beg);
+   m_fileStr->seekg(offset, std::ios::beg);
 
    rspf_uint16 us;
 
    // Get the post.
-   m_fileStr.read((char*)&us, POST_SIZE);
+   m_fileStr->read((char*)&us, POST_SIZE);
    
    return double(convertSignedMagnitude(us));
 }
@@ -445,7 +447,7 @@ void rspfDtedHandler::gatherStatistics()
       theMaxHeightAboveMSL = -32767;
       
       // Put the file pointer at the start of the first elevation post.
-      m_fileStr.seekg(m_offsetToFirstDataRecord, std::ios::beg);
+      m_fileStr->seekg(m_offsetToFirstDataRecord, std::ios::beg);
       
       //---
       // Loop through all records and scan for lowest min and highest max.
@@ -455,13 +457,13 @@ void rspfDtedHandler::gatherStatistics()
       //---
       for (rspf_int32 i=0; i<m_numLonLines; ++i)  // longitude direction
       {
-         m_fileStr.seekg(DATA_RECORD_OFFSET_TO_POST, std::ios::cur);
+         m_fileStr->seekg(DATA_RECORD_OFFSET_TO_POST, std::ios::cur);
          
          for (rspf_int32 j=0; j<m_numLatPoints; ++j) // latitude direction
          {
             rspf_uint16 us;
             rspf_sint16 ss;
-            m_fileStr.read((char*)&us, POST_SIZE);
+            m_fileStr->read((char*)&us, POST_SIZE);
             ss = convertSignedMagnitude(us);
             if (ss < theMinHeightAboveMSL && ss != NULL_POST)
             {
@@ -473,7 +475,7 @@ void rspfDtedHandler::gatherStatistics()
             }
          }
          
-         m_fileStr.seekg(DATA_RECORD_CHECKSUM_SIZE, std::ios::cur);
+         m_fileStr->seekg(DATA_RECORD_CHECKSUM_SIZE, std::ios::cur);
       }
       
       // Add the stats to the keyword list.
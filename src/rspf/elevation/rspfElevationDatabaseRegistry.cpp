@@ -16,6 +16,7 @@ rspfElevationDatabaseRegistry* rspfElevationDatabaseRegistry::instance()
 
 rspfElevationDatabase* rspfElevationDatabaseRegistry::createDatabase(const rspfString& typeName)const
 {
+   loadDeferredPlugins();
    rspfElevationDatabase* result = 0;
    rspf_uint32 idx = 0;
    for(;((idx < m_factoryList.size())&&!result); ++idx)
@@ -29,6 +30,7 @@ rspfElevationDatabase* rspfElevationDatabaseRegistry::createDatabase(const rspfS
 rspfElevationDatabase* rspfElevationDatabaseRegistry::createDatabase(const rspfKeywordlist& kwl,
                                                                        const char* prefix)const
 {
+   loadDeferredPlugins();
    rspfElevationDatabase* result = 0;
    rspf_uint32 idx = 0;
    for(;((idx < m_factoryList.size())&&!result); ++idx)
@@ -41,6 +43,7 @@ rspfElevationDatabase* rspfElevationDatabaseRegistry::createDatabase(const rspfK
 
 rspfElevationDatabase* rspfElevationDatabaseRegistry::open(const rspfString& connectionString)
 {
+   loadDeferredPlugins();
    rspfElevationDatabase* result = 0;
    rspf_uint32 idx = 0;
    for(;((idx < m_factoryList.size())&&!result); ++idx)
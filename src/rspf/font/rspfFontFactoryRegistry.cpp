@@ -158,3 +158,8 @@ rspfFontFactoryRegistry::rspfFontFactoryRegistry(const rspfFontFactoryRegistry&
 void rspfFontFactoryRegistry::operator=(const rspfFontFactoryRegistry& /* rhs */ )
 {
 }
+
+rspf_uint32 rspfFontFactoryRegistry::getNumberOfFactories()const
+{
+   return (rspf_uint32)theFactoryList.size();
+}
@@ -13,6 +13,7 @@
 //  $Id: rspfBandSelector.cpp 22230 2013-04-12 16:34:05Z dburken $
 
 #include <rspf/imaging/rspfBandSelector.h>
+#include <rspf/imaging/rspfImageSourceProfiler.h>
 #include <rspf/base/rspfTrace.h>
 #include <rspf/base/rspfKeywordlist.h>
 #include <rspf/base/rspfKeywordNames.h>
@@ -50,6 +51,8 @@ rspfRefPtr<rspfImageData> rspfBandSelector::getTile(
    const rspfIrect& tileRect,
    rspf_uint32 resLevel)
 {
+   RSPF_PROFILE_GET_TILE(tileRect);
+
    if (!theInputConnection)
    {
       return rspfRefPtr<rspfImageData>();
@@ -116,6 +119,7 @@ rspfRefPtr<rspfImageData> rspfBandSelector::getTile(
 
 void rspfBandSelector::setOutputBandList( const vector<rspf_uint32>& outputBandList )
 {
+   incrementStateCounter();
    if (outputBandList.size())
    {
       theOutputBandList = outputBandList;  // Assign the new list.
@@ -375,6 +379,7 @@ bool rspfBandSelector::saveState(rspfKeywordlist& kwl,
 bool rspfBandSelector::loadState(const rspfKeywordlist& kwl,
                                   const char* prefix)
 {
+   incrementStateCounter();
    rspfImageSourceFilter::loadState(kwl, prefix);
 
    theOutputBandList.clear();
@@ -526,6 +531,7 @@ rspfString rspfBandSelector::getShortName()const
 
 void rspfBandSelector::setProperty(rspfRefPtr<rspfProperty> property)
 {
+   incrementStateCounter();
    if(!property) return;
 
    if(property->getName() == "bandSelection")
@@ -200,6 +200,7 @@ void rspfBrightnessContrastSource::allocate()
 
 void rspfBrightnessContrastSource::setProperty(rspfRefPtr<rspfProperty> property)
 {
+   incrementStateCounter();
    if(!property)
    {
       return;
@@ -255,6 +256,7 @@ void rspfBrightnessContrastSource::getPropertyNames(std::vector<rspfString>& pro
 bool rspfBrightnessContrastSource::loadState(const rspfKeywordlist& kwl,
                                               const char* prefix)
 {
+   incrementStateCounter();
    const char* brightness = kwl.find(prefix, "brightness");
    const char* contrast = kwl.find(prefix, "contrast");
 
@@ -289,17 +291,20 @@ bool rspfBrightnessContrastSource::saveState(rspfKeywordlist& kwl,
 void rspfBrightnessContrastSource::setBrightnessContrast(
    rspf_float64 brightness, rspf_float64 contrast)
 {
+   incrementStateCounter();
    theBrightness = brightness;
    theContrast   = contrast;
 }
 
 void rspfBrightnessContrastSource::setBrightness(rspf_float64 brightness)
 {
+   incrementStateCounter();
    setBrightnessContrast(brightness, getContrast());
 }
 
 void rspfBrightnessContrastSource::setContrast(rspf_float64 contrast)
 {
+   incrementStateCounter();
    setBrightnessContrast(getBrightness(), contrast);
 }
 
@@ -13,6 +13,7 @@
 #include <rspf/imaging/rspfBumpShadeTileSource.h>
 #include <rspf/imaging/rspfImageDataFactory.h>
 #include <rspf/imaging/rspfImageData.h>
+#include <rspf/imaging/rspfImageToPlaneNormalFilter.h>
 #include <rspf/imaging/rspfTilePatch.h>
 #include <rspf/imaging/rspfImageData.h>
 #include <rspf/base/rspfColumnVector3d.h>
@@ -26,6 +27,7 @@
 static const char COLOR_RED_KW[]   = "color_red";
 static const char COLOR_GREEN_KW[] = "color_green";
 static const char COLOR_BLUE_KW[]  = "color_blue";
+static const char FUSED_KERNEL_KW[] = "fused_kernel";
 
 RTTI_DEF1(rspfBumpShadeTileSource,
           "rspfBumpShadeTileSource",
@@ -40,7 +42,8 @@ rspfBumpShadeTileSource::rspfBumpShadeTileSource()
     m_lightDirection(3),
     m_r(255),
     m_g(255),
-    m_b(255)
+    m_b(255),
+    m_fusedKernelFlag(true)
 {
    initialize();
 }
@@ -80,6 +83,13 @@ rspfRefPtr<rspfImageData> rspfBumpShadeTileSource::getTile(
    if(isSourceEnabled())
    {
       m_tile->makeBlank();
+
+      // Single pass from the dem if input 0 is a plain normal filter:
+      rspfImageToPlaneNormalFilter* normalFilter = getFusableNormalFilter();
+      if ( normalFilter )
+      {
+         return getFusedTile(normalFilter, colorSource, tileRect, resLevel);
+      }
       
       if(colorSource)
       {
@@ -246,6 +256,276 @@ rspfRefPtr<rspfImageData> rspfBumpShadeTileSource::getTile(
    return m_tile;
 }
 
+rspfImageToPlaneNormalFilter* rspfBumpShadeTileSource::getFusableNormalFilter()
+{
+   rspfImageToPlaneNormalFilter* result = 0;
+   if ( m_fusedKernelFlag )
+   {
+      result = dynamic_cast<rspfImageToPlaneNormalFilter*>( getInput(0) );
+      if ( result )
+      {
+         //---
+         // Only a plain normal filter can be bypassed.  If it's disabled or not connected
+         // its output is not normals so go through the two filter path.
+         //---
+         if ( !result->isSourceEnabled() ||
+              !dynamic_cast<rspfImageSource*>( result->getInput(0) ) )
+         {
+            result = 0;
+         }
+      }
+   }
+   return result;
+}
+
+rspfRefPtr<rspfImageData> rspfBumpShadeTileSource::getFusedTile(
+   rspfImageToPlaneNormalFilter* normalFilter,
+   rspfImageSource* colorSource,
+   const rspfIrect& tileRect,
+   rspf_uint32 resLevel)
+{
+   rspfImageSource* demSource = dynamic_cast<rspfImageSource*>( normalFilter->getInput(0) );
+
+   // Same one pixel border the normal filter requests for the central differences.
+   rspfIrect requestRect(tileRect.ul().x - 1,
+                         tileRect.ul().y - 1,
+                         tileRect.lr().x + 1,
+                         tileRect.lr().y + 1);
+   
+   rspfRefPtr<rspfImageData> demTile = demSource->getTile(requestRect, resLevel);
+
+   rspfRefPtr<rspfImageData> colorTile = 0;
+   if ( colorSource )
+   {
+      colorTile = colorSource->getTile(tileRect, resLevel);
+      if ( colorTile.valid() &&
+           ( (colorTile->getDataObjectStatus() == RSPF_EMPTY) ||
+             (colorTile->getDataObjectStatus() == RSPF_NULL) ) )
+      {
+         colorTile = 0;
+      }
+   }
+   if ( colorTile.valid() && ( colorTile->getScalarType() != RSPF_UCHAR ) )
+   {
+      rspfNotify(rspfNotifyLevel_NOTICE)
+         << "rspfBumpShadeTileSource::getTile NOTICE:\n"
+         << "only 8-bit unsigned char is supported." << endl;
+      m_tile->validate();
+      return m_tile;
+   }
+
+   // Gradient scale, same as the normal filter including the reduced resolution adjustment.
+   rspf_float64 xScale = normalFilter->getXScale() * normalFilter->getSmoothnessFactor();
+   rspf_float64 yScale = normalFilter->getYScale() * normalFilter->getSmoothnessFactor();
+   if ( resLevel > 0 )
+   {
+      rspfDpt scaleFactor;
+      demSource->getDecimationFactor(resLevel, scaleFactor);
+      if ( !scaleFactor.hasNans() )
+      {
+         xScale *= scaleFactor.x;
+         yScale *= scaleFactor.y;
+      }
+   }
+
+   if ( !demTile.valid() || !demTile->getBuf() ||
+        (demTile->getDataObjectStatus() == RSPF_EMPTY) )
+   {
+      //---
+      // Normal filter behavior: flat earth inside the dem bounds, nothing outside.
+      //---
+      if ( tileRect.completely_within( demSource->getBoundingRect(resLevel) ) )
+      {
+         std::vector<rspf_float32> shade( m_tile->getWidth(),
+                                          static_cast<rspf_float32>(m_lightDirection[2]) );
+         for ( rspf_uint32 y = 0; y < m_tile->getHeight(); ++y )
+         {
+            applyShade( &shade.front(), y, colorTile.get() );
+         }
+         m_tile->validate();
+         return m_tile;
+      }
+      return rspfRefPtr<rspfImageData>();
+   }
+
+   switch( demTile->getScalarType() )
+   {
+      case RSPF_SSHORT16:
+      {
+         computeFusedShade( (rspf_sint16)0, demTile.get(), colorTile.get(),
+                            (rspf_float32)xScale, (rspf_float32)yScale );
+         break;
+      }
+      case RSPF_UCHAR:
+      {
+         computeFusedShade( (rspf_uint8)0, demTile.get(), colorTile.get(),
+                            (rspf_float32)xScale, (rspf_float32)yScale );
+         break;
+      }
+      case RSPF_USHORT11:
+      case RSPF_USHORT16:
+      {
+         computeFusedShade( (rspf_uint16)0, demTile.get(), colorTile.get(),
+                            (rspf_float32)xScale, (rspf_float32)yScale );
+         break;
+      }
+      case RSPF_NORMALIZED_DOUBLE:
+      case RSPF_DOUBLE:
+      {
+         computeFusedShade( (rspf_float64)0, demTile.get(), colorTile.get(),
+                            (rspf_float32)xScale, (rspf_float32)yScale );
+         break;
+      }
+      case RSPF_NORMALIZED_FLOAT:
+      case RSPF_FLOAT:
+      {
+         computeFusedShade( (rspf_float32)0, demTile.get(), colorTile.get(),
+                            (rspf_float32)xScale, (rspf_float32)yScale );
+         break;
+      }
+      default:
+         break;
+   }
+
+   m_tile->validate();
+   return m_tile;
+}
+
+template <class T> void rspfBumpShadeTileSource::computeFusedShade(
+   T /* dummy */,
+   const rspfImageData* demTile,
+   const rspfImageData* colorTile,
+   rspf_float32 xScale,
+   rspf_float32 yScale)
+{
+   const T NP = static_cast<T>( demTile->getNullPix(0) );
+   const T* demBuf = static_cast<const T*>( demTile->getBuf(0) );
+   const rspf_int32 DEM_W = static_cast<rspf_int32>( demTile->getWidth() );
+   const rspf_int32 W     = static_cast<rspf_int32>( m_tile->getWidth() );
+   const rspf_int32 H     = static_cast<rspf_int32>( m_tile->getHeight() );
+
+   const rspf_float32 LX = static_cast<rspf_float32>( m_lightDirection[0] );
+   const rspf_float32 LY = static_cast<rspf_float32>( m_lightDirection[1] );
+   const rspf_float32 LZ = static_cast<rspf_float32>( m_lightDirection[2] );
+
+   // Central difference is (f(x+1) - f(x-1))/2.
+   const rspf_float32 HALF_X = xScale * 0.5f;
+   const rspf_float32 HALF_Y = yScale * 0.5f;
+
+   // No nulls means no special cases; keep that loop branch free.
+   const bool FULL = ( demTile->getDataObjectStatus() == RSPF_FULL );
+
+   std::vector<rspf_float32> shade(W);
+   
+   for ( rspf_int32 y = 0; y < H; ++y )
+   {
+      // Center row in the dem buffer, offset by the one pixel border.
+      const T* c = demBuf + (y+1)*DEM_W + 1;
+      const T* n = c - DEM_W;
+      const T* s = c + DEM_W;
+
+      if ( FULL )
+      {
+         for ( rspf_int32 x = 0; x < W; ++x )
+         {
+            rspf_float32 dx = HALF_X * ( (rspf_float32)c[x+1] - (rspf_float32)c[x-1] );
+            rspf_float32 dy = HALF_Y * ( (rspf_float32)s[x]   - (rspf_float32)n[x] );
+            shade[x] = ( dx*LX + dy*LY + LZ ) / std::sqrt( dx*dx + dy*dy + 1.0f );
+         }
+      }
+      else
+      {
+         //---
+         // Same null handling as rspfImageToPlaneNormalFilter::computeNormalsTemplate:
+         // fall back to one sided differences; flat if not possible.
+         //---
+         for ( rspf_int32 x = 0; x < W; ++x )
+         {
+            rspf_float32 dx = 0.0f;
+            rspf_float32 dy = 0.0f;
+            
+            if ( c[x+1] != NP )
+            {
+               if ( c[x-1] != NP )
+                  dx = HALF_X * ( (rspf_float32)c[x+1] - (rspf_float32)c[x-1] );
+               else if ( c[x] != NP )
+                  dx = xScale * ( (rspf_float32)c[x+1] - (rspf_float32)c[x] );
+            }
+            else if ( (c[x] != NP) && (c[x-1] != NP) )
+            {
+               dx = xScale * ( (rspf_float32)c[x] - (rspf_float32)c[x-1] );
+            }
+
+            if ( s[x] != NP )
+            {
+               if ( n[x] != NP )
+                  dy = HALF_Y * ( (rspf_float32)s[x] - (rspf_float32)n[x] );
+               else if ( c[x] != NP )
+                  dy = yScale * ( (rspf_float32)s[x] - (rspf_float32)c[x] );
+            }
+            else if ( (c[x] != NP) && (n[x] != NP) )
+            {
+               dy = yScale * ( (rspf_float32)c[x] - (rspf_float32)n[x] );
+            }
+
+            shade[x] = ( dx*LX + dy*LY + LZ ) / std::sqrt( dx*dx + dy*dy + 1.0f );
+         }
+      }
+
+      applyShade( &shade.front(), y, colorTile );
+   }
+}
+
+void rspfBumpShadeTileSource::applyShade(const rspf_float32* shade,
+                                         rspf_uint32 line,
+                                         const rspfImageData* colorTile)
+{
+   const rspf_uint32 W = m_tile->getWidth();
+   const rspf_uint32 OFFSET = line * W;
+   
+   rspf_uint8* r = static_cast<rspf_uint8*>(m_tile->getBuf(0)) + OFFSET;
+   rspf_uint8* g = static_cast<rspf_uint8*>(m_tile->getBuf(1)) + OFFSET;
+   rspf_uint8* b = static_cast<rspf_uint8*>(m_tile->getBuf(2)) + OFFSET;
+
+   if ( colorTile )
+   {
+      const rspf_uint8* cr = static_cast<const rspf_uint8*>(colorTile->getBuf(0));
+      const rspf_uint8* cg = colorTile->getBuf(1) ?
+         static_cast<const rspf_uint8*>(colorTile->getBuf(1)) : cr;
+      const rspf_uint8* cb = colorTile->getBuf(2) ?
+         static_cast<const rspf_uint8*>(colorTile->getBuf(2)) : cr;
+      cr += OFFSET;
+      cg += OFFSET;
+      cb += OFFSET;
+      
+      for ( rspf_uint32 x = 0; x < W; ++x )
+      {
+         // Null color pixels get the default color.
+         if ( cr[x] || cg[x] || cb[x] )
+         {
+            r[x] = shadeToByte( shade[x], cr[x] );
+            g[x] = shadeToByte( shade[x], cg[x] );
+            b[x] = shadeToByte( shade[x], cb[x] );
+         }
+         else
+         {
+            r[x] = shadeToByte( shade[x], m_r );
+            g[x] = shadeToByte( shade[x], m_g );
+            b[x] = shadeToByte( shade[x], m_b );
+         }
+      }
+   }
+   else
+   {
+      for ( rspf_uint32 x = 0; x < W; ++x )
+      {
+         r[x] = shadeToByte( shade[x], m_r );
+         g[x] = shadeToByte( shade[x], m_g );
+         b[x] = shadeToByte( shade[x], m_b );
+      }
+   }
+}
+
 void rspfBumpShadeTileSource::computeColor(rspf_uint8& r,
                                             rspf_uint8& g,
                                             rspf_uint8& b,
@@ -345,6 +625,12 @@ bool rspfBumpShadeTileSource::loadState(const rspfKeywordlist& kwl,
    {
       m_b = rspfString(lookup).toUInt8();
    }
+
+   lookup = kwl.find(prefix, FUSED_KERNEL_KW);
+   if (lookup)
+   {
+      m_fusedKernelFlag = rspfString(lookup).toBool();
+   }
     
 
    computeLightDirection();
@@ -374,6 +660,7 @@ bool rspfBumpShadeTileSource::saveState(rspfKeywordlist& kwl,
    kwl.add(prefix, COLOR_RED_KW,   m_r, true);
    kwl.add(prefix, COLOR_GREEN_KW, m_g, true);
    kwl.add(prefix, COLOR_BLUE_KW,  m_b, true);
+   kwl.add(prefix, FUSED_KERNEL_KW, (m_fusedKernelFlag?"true":"false"), true);
    
    return rspfImageSource::saveState(kwl, prefix);
 }
@@ -521,3 +808,13 @@ void rspfBumpShadeTileSource::getRgbColorSource(rspf_uint8& r,
    g = m_g;
    b = m_b;
 }
+
+void rspfBumpShadeTileSource::setFusedKernelFlag(bool flag)
+{
+   m_fusedKernelFlag = flag;
+}
+
+bool rspfBumpShadeTileSource::getFusedKernelFlag() const
+{
+   return m_fusedKernelFlag;
+}
@@ -15,6 +15,7 @@
 #include <rspf/base/rspfStringProperty.h>
 #include <rspf/base/rspfBooleanProperty.h>
 #include <rspf/imaging/rspfCacheTileSource.h>
+#include <rspf/imaging/rspfImageSourceProfiler.h>
 #include <rspf/imaging/rspfImageData.h>
 #include <rspf/imaging/rspfImageDataFactory.h>
 #include <rspf/base/rspfKeywordNames.h>
@@ -79,6 +80,8 @@ void rspfCacheTileSource::allocate()
 rspfRefPtr<rspfImageData> rspfCacheTileSource::getTile(
    const rspfIrect& tileRect, rspf_uint32 resLevel)
 {
+   RSPF_PROFILE_GET_TILE(tileRect);
+
    rspfRefPtr<rspfImageData> result = 0;
    
    if ( theInputConnection )
@@ -137,6 +140,14 @@ rspfRefPtr<rspfImageData> rspfCacheTileSource::fillTile(
          {
             tempTile = rspfAppFixedTileCache::instance()->getTile(cacheId,
                                                                    origin);
+            if (tempTile.valid())
+            {
+               rspfImageSourceProfiler::cacheHit(this);
+            }
+            else
+            {
+               rspfImageSourceProfiler::cacheMiss(this);
+            }
          }
          if(!tempTile.valid())
          {
@@ -193,6 +204,14 @@ rspfRefPtr<rspfImageData> rspfCacheTileSource::fillTile(
                   tempTile =
                      rspfAppFixedTileCache::instance()->getTile(cacheId,
                                                                  origin);
+                  if (tempTile.valid())
+                  {
+                     rspfImageSourceProfiler::cacheHit(this);
+                  }
+                  else
+                  {
+                     rspfImageSourceProfiler::cacheMiss(this);
+                  }
                }
                else
                {
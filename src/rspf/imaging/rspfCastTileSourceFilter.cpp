@@ -10,6 +10,7 @@
 //*************************************************************************
 // $Id: rspfCastTileSourceFilter.cpp 17195 2010-04-23 17:32:18Z dburken $
 #include <rspf/imaging/rspfCastTileSourceFilter.h>
+#include <rspf/imaging/rspfImageSourceProfiler.h>
 #include <rspf/imaging/rspfU8ImageData.h>
 #include <rspf/imaging/rspfImageDataFactory.h>
 #include <rspf/base/rspfKeywordlist.h>
@@ -36,6 +37,8 @@ rspfRefPtr<rspfImageData> rspfCastTileSourceFilter::getTile(
    const rspfIrect& tileRect,
    rspf_uint32 resLevel)
 {
+   RSPF_PROFILE_GET_TILE(tileRect);
+
    rspfRefPtr<rspfImageData> inputTile;
    
    if(theInputConnection)
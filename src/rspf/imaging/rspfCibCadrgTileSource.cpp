@@ -31,6 +31,7 @@
 #include <rspf/support_data/rspfRpfTocEntry.h>
 #include <rspf/support_data/rspfRpfCompressionSection.h>
 #include <rspf/imaging/rspfImageDataFactory.h>
+#include <rspf/imaging/rspfRpfFrameCache.h>
 #include <rspf/projection/rspfEquDistCylProjection.h>
 #include <rspf/projection/rspfCylEquAreaProjection.h>
 #include <rspf/projection/rspfProjectionFactoryRegistry.h>
@@ -50,8 +51,6 @@ const rspf_uint32 rspfCibCadrgTileSource::CIBCADRG_FRAME_HEIGHT = 1536;
 
 rspfCibCadrgTileSource::rspfCibCadrgTileSource()
    :rspfImageHandler(),
-    theCompressedBuffer(0),
-    theUncompressedBuffer(0),
     theNumberOfLines(0),
     theNumberOfSamples(0),
     theTile(0),
@@ -60,6 +59,7 @@ rspfCibCadrgTileSource::rspfCibCadrgTileSource()
     theEntryNumberToRender(1),
     theTileSize(128, 128),
     theProductType(RSPF_PRODUCT_TYPE_UNKNOWN),
+    theWorkFrameFile(),
     theSkipEmptyCheck(false)
 {
    if (traceDebug())
@@ -72,29 +72,10 @@ rspfCibCadrgTileSource::rspfCibCadrgTileSource()
 #endif      
    }
    theWorkFrame = new rspfRpfFrame;
-   
-   // a CADRG and CIBis a 64*64*12 bit buffer and must divide by 8 to
-   // convert to bytes
-   theCompressedBuffer   = new rspf_uint8[(64*64*12)/8];
-
-   // whether CIB or CADRG we will alocate the buffer
-   // to the larger of the 2 (CADRG is 3 bands)
-   theUncompressedBuffer = new rspf_uint8[256*256*3];
-                           
 }
 
 rspfCibCadrgTileSource::~rspfCibCadrgTileSource()
 {
-   if(theCompressedBuffer)
-   {
-      delete [] theCompressedBuffer;
-      theCompressedBuffer = 0;
-   }
-   if(theUncompressedBuffer)
-   {
-      delete [] theUncompressedBuffer;
-      theUncompressedBuffer = 0;
-   }
    if(theWorkFrame)
    {
       delete theWorkFrame;
@@ -122,7 +103,7 @@ void rspfCibCadrgTileSource::close()
 
 bool rspfCibCadrgTileSource::isOpen()const
 {
-   return (theTableOfContents!=0);
+   return theTableOfContents.valid();
 }
 
 bool rspfCibCadrgTileSource::open()
@@ -141,45 +122,43 @@ bool rspfCibCadrgTileSource::open()
       close();
    }
 
-   theTableOfContents = new rspfRpfToc;
+   // Shared parse; opening many entries/sources of the same a.toc is cheap.
+   theTableOfContents = rspfRpfFrameCache::instance()->getToc(theImageFile);
    
-   if(theTableOfContents)
+   if(theTableOfContents.valid())
    {      
-      if(theTableOfContents->parseFile(theImageFile) == rspfErrorCodes::RSPF_OK)
+      if(theTableOfContents->getNumberOfEntries() > 0)
       {
-         if(theTableOfContents->getNumberOfEntries() > 0)
+         vector<rspfString> scaleList = getProductScaleList();
+         if(scaleList.size() > 0)
          {
-            vector<rspfString> scaleList = getProductScaleList();
-            if(scaleList.size() > 0)
+            std::vector<rspf_uint32> entryList;
+            getEntryList(entryList);
+            if(entryList.size() > 0)
             {
-               std::vector<rspf_uint32> entryList;
-               getEntryList(entryList);
-               if(entryList.size() > 0)
+               setCurrentEntry(entryList[0]);
+               
+               if(theEntryToRender)
                {
-                  setCurrentEntry(entryList[0]);
-                  
-                  if(theEntryToRender)
-                  {
-                     // a CADRG is 1536x1536 per frame.
-                     theNumberOfLines   = theEntryToRender->getNumberOfLines();
-                     theNumberOfSamples = theEntryToRender->getNumberOfSamples();
-                  }
+                  // a CADRG is 1536x1536 per frame.
+                  theNumberOfLines   = theEntryToRender->getNumberOfLines();
+                  theNumberOfSamples = theEntryToRender->getNumberOfSamples();
+               }
 
-                  if(theEntryToRender->getProductType().trim().upcase() == "CADRG")
-                  {
-                     theProductType = RSPF_PRODUCT_TYPE_CADRG;
-                     result = true;
-                  }
-                  else if(theEntryToRender->getProductType().trim().upcase() == "CIB")
-                  {
-                     theProductType = RSPF_PRODUCT_TYPE_CIB;
-                     result = true;
-                  }
-                  if ( result )
-                  {
-                     // This initializes tiles and buffers.
-                     allocateForProduct();
-                  }
+               if(theEntryToRender->getProductType().trim().upcase() == "CADRG")
+               {
+                  theProductType = RSPF_PRODUCT_TYPE_CADRG;
+                  result = true;
+               }
+               else if(theEntryToRender->getProductType().trim().upcase() == "CIB")
+               {
+                  theProductType = RSPF_PRODUCT_TYPE_CIB;
+                  result = true;
+               }
+               if ( result )
+               {
+                  // This initializes tiles and buffers.
+                  allocateForProduct();
                }
             }
          }
@@ -528,7 +507,7 @@ const rspfRpfTocEntry* rspfCibCadrgTileSource::getCurrentTocEntry()const
 
 const rspfRpfToc*  rspfCibCadrgTileSource::getToc()const
 {
-   return theTableOfContents;
+   return theTableOfContents.get();
 }
 
 bool rspfCibCadrgTileSource::isValidRLevel(rspf_uint32 reduced_res_level) const
@@ -710,307 +689,111 @@ void rspfCibCadrgTileSource::fillTile(
        idx < framesInvolved.size();
        ++idx)
    {
-
-      if(theWorkFrame->parseFile(framesInvolved[idx].theFrameEntry.getFullPath())
-         == rspfErrorCodes::RSPF_OK)
-      {
-         // we will fill a subtile.  We pass in which frame it is and the position of the frame.
-         // the actual pixel will be 1536*row and 1536 *col.
-         if(theProductType == RSPF_PRODUCT_TYPE_CIB)
-         {
-            fillSubTileCib(*theWorkFrame,
-                           tileRect,
-                           framesInvolved[idx],
-                           tile);
-         }
-         else
-         {
-            fillSubTileCadrg(*theWorkFrame,
-                             tileRect,
-                             framesInvolved[idx],
-                             tile);
-         }
-      }
+      // we will fill a subtile.  We pass in which frame it is and the position of the frame.
+      // the actual pixel will be 1536*row and 1536 *col.
+      fillSubTile(tileRect, framesInvolved[idx], tile);
    }
 }
 
-void rspfCibCadrgTileSource::fillSubTileCadrg(
-   const rspfRpfFrame&  aFrame,
+void rspfCibCadrgTileSource::fillSubTile(
    const rspfIrect& tileRect,
    const rspfFrameEntryData& frameEntryData,
    rspfImageData* tile)
 {
+   const rspfFilename& frameFile = frameEntryData.theFrameEntry.getFullPath();
+   
    // first let's grab the absolute position of the frame rectangle in pixel space
    rspfIrect frameRect(frameEntryData.thePixelCol,
                         frameEntryData.thePixelRow,
                         frameEntryData.thePixelCol + CIBCADRG_FRAME_WIDTH  - 1,
                         frameEntryData.thePixelRow + CIBCADRG_FRAME_HEIGHT - 1);
-
    
    // now clip it to the tile
    rspfIrect clipRect = tileRect.clipToRect(frameRect);
-   
-   const rspfRpfCompressionSection* compressionSection = aFrame.getCompressionSection();
-   
-   if(!compressionSection)
-   {
-      return;
-   }
-
-   const vector<rspfRpfColorGrayscaleTable>& colorTable =
-      aFrame.getColorGrayscaleTable();
-
-   // ESH 03/2009 -- Partial fix for ticket #646.
-   // Crash fix on reading RPFs: Make sure the colorTable vector 
-   // has entries before trying to make use of them. 
-   int numTables = (int)colorTable.size();
-   if ( numTables <= 0 )
-   {
-      return;
-   }
-
-   rspf_uint8 *tempRows[3];
-   
-   tempRows[0] = theUncompressedBuffer;
-   tempRows[1] = (theUncompressedBuffer + 256*256);
-   tempRows[2] = (tempRows[1] + 256*256);
-   
-   // find the shift to 0,0
-   rspfIpt tempDelta(clipRect.ul().x - frameEntryData.thePixelCol,
-                      clipRect.ul().y - frameEntryData.thePixelRow);
-   
-   
-   // In order to compute the subframe we will need the corner offsets of
-   // the upper left of the frame and the upper left of the clip rect.  The
-   // clip rect should be completely within the frame.  This just translates the value
-   // to make the upper left of the frame be 0,0.
-   //
-   rspfIrect offsetRect(tempDelta.x,
-                         tempDelta.y,
-                         tempDelta.x + clipRect.width()-1,
-                         tempDelta.y + clipRect.height()-1);
-   
-   // each subframe is 64x64.  We will actually use 256x256 since
-   // we will be uncompressing them.  Note CADRG is a 256x256 tile
-   // compressed to 64x64x12 bit data
-   //
-    rspfIrect subFrameRect(offsetRect.ul().x/256,
-                            offsetRect.ul().y/256,
-                            (offsetRect.lr().x)/256,
-                            (offsetRect.lr().y)/256);
-   
-   rspf_uint32 readPtr  = 0;
 
+   //---
+   // Each subframe is 64x64 12 bit codes which uncompress to 256x256.  Find the
+   // subframes covering the clip rect shifted so the frame upper left is 0,0.
+   //---
+   rspfIrect subFrameRect( (clipRect.ul().x - frameEntryData.thePixelCol)/256,
+                           (clipRect.ul().y - frameEntryData.thePixelRow)/256,
+                           (clipRect.lr().x - frameEntryData.thePixelCol)/256,
+                           (clipRect.lr().y - frameEntryData.thePixelRow)/256 );
+
+   rspfRpfFrameCache* cache = rspfRpfFrameCache::instance();
+
+   // Look in the shared cache first.  Only parse the frame if something is missing.
+   std::vector< rspfRefPtr<const rspfRpfFrameCache::Subframe> > subframes;
+   std::vector<rspfIpt> subframeIds;
+   std::vector<rspfIpt> missingIds;
+   std::vector<rspf_uint32> missingIdx;
    rspf_int32 row = 0;
    rspf_int32 col = 0;
-   rspf_uint32 i = 0;
-   rspf_uint32 j = 0;
-   rspf_int32 upperY = subFrameRect.lr().y;
-   rspf_int32 upperX = subFrameRect.lr().x;
-   rspf_int32 lowerY = subFrameRect.ul().y;
-   rspf_int32 lowerX = subFrameRect.ul().x; 
-   for(row = lowerY; row <= upperY; ++row)
+   for(row = subFrameRect.ul().y; row <= subFrameRect.lr().y; ++row)
    {
-      for(col = lowerX; col <= upperX; ++col)
+      for(col = subFrameRect.ul().x; col <= subFrameRect.lr().x; ++col)
       {
-         readPtr = 0;
-         if(aFrame.fillSubFrameBuffer(theCompressedBuffer, 0, row, col))
+         subframes.push_back( cache->getSubframe(frameFile, row, col) );
+         subframeIds.push_back( rspfIpt(col, row) );
+         if ( !subframes.back().valid() )
          {
-            for (i = 0; i < 256; i += 4)
-            {
-               for (j = 0; j < 256; j += 8)
-               {
-                  rspf_uint16 firstByte  = theCompressedBuffer[readPtr++] & 0xff;
-                  rspf_uint16 secondByte = theCompressedBuffer[readPtr++] & 0xff;
-                  rspf_uint16 thirdByte  = theCompressedBuffer[readPtr++] & 0xff;
-                  
-                  //because dealing with half-bytes is hard, we
-                  //uncompress two 4x4 tiles at the same time. (a
-                  //4x4 tile compressed is 12 bits )
-                  // this little code was grabbed from openmap software.
-                  
-                  /* Get first 12-bit value as index into VQ table */
-                  // I think we need to swap
-                  rspf_uint16 val1 = (firstByte << 4) | (secondByte >> 4);
-                  
-                  /* Get second 12-bit value as index into VQ table*/
-                  rspf_uint16 val2 = ((secondByte & 0x000F) << 8) | thirdByte;
-                  
-                  for (rspf_uint32 t = 0; t < 4; ++t)
-                  {
-                     for (rspf_uint32 e = 0; e < 4; ++e)
-                     {
-                        rspf_uint16 tableVal1 = compressionSection->getTable()[t].theData[val1*4 + e] & 0xff;
-                        rspf_uint16 tableVal2 = compressionSection->getTable()[t].theData[val2*4 + e] & 0xff;
-
-                        rspf_uint32 pixindex = ((i+t)*256) +
-                                                 (j + e);
-                        const rspf_uint8* color1 = colorTable[0].getStartOfData(tableVal1);
-                        const rspf_uint8* color2 = colorTable[0].getStartOfData(tableVal2);
-                        
-                        
-                        tempRows[0][pixindex] = color1[0];
-                        tempRows[1][pixindex] = color1[1];
-                        tempRows[2][pixindex] = color1[2];
-                        
-                        tempRows[0][pixindex+4] = color2[0];
-                        tempRows[1][pixindex+4] = color2[1];
-                        tempRows[2][pixindex+4] = color2[2];
-                     } //for e
-                  } //for t
-               }  /* for j */
-            } //for i
+            missingIdx.push_back( static_cast<rspf_uint32>(subframes.size()-1) );
+            missingIds.push_back( subframeIds.back() );
          }
-         else
-         {
-            memset(theUncompressedBuffer, 0, 256*256*3);
-         }
-         rspf_int32 tempCol = col*256;
-         rspf_int32 tempRow = row*256;
-         rspfIrect subRectToFill(frameRect.ul().x + tempCol,
-                                  frameRect.ul().y + tempRow,
-                                  frameRect.ul().x + tempCol + 255,
-                                  frameRect.ul().y + tempRow + 255);
-         tile->loadTile(theUncompressedBuffer,
-                        subRectToFill,
-                        RSPF_BSQ);
       }
    }
-}
-
-void rspfCibCadrgTileSource::fillSubTileCib(
-   const rspfRpfFrame&  aFrame,
-   const rspfIrect& tileRect,
-   const rspfFrameEntryData& frameEntryData,
-   rspfImageData* tile)
-{
-   // first let's grab the absolute position of the frame rectangle in pixel
-   // space
-   rspfIrect frameRect(frameEntryData.thePixelCol,
-                        frameEntryData.thePixelRow,
-                        frameEntryData.thePixelCol + CIBCADRG_FRAME_WIDTH  - 1,
-                        frameEntryData.thePixelRow + CIBCADRG_FRAME_HEIGHT - 1);
 
-   
-   // now clip it to the tile
-   rspfIrect clipRect = tileRect.clipToRect(frameRect);
-
-   const rspfRpfCompressionSection* compressionSection = aFrame.getCompressionSection();
-   
-   if(!compressionSection)
+   if ( missingIds.size() )
    {
-      return;
-   }
+      // Consecutive tiles usually hit the same frame; skip the reparse.
+      if ( frameFile != theWorkFrameFile )
+      {
+         theWorkFrameFile.clear();
+         if ( theWorkFrame->parseFile(frameFile) != rspfErrorCodes::RSPF_OK )
+         {
+            return;
+         }
+         theWorkFrameFile = frameFile;
+      }
 
-   const vector<rspfRpfColorGrayscaleTable>& colorTable =
-      aFrame.getColorGrayscaleTable();
+      // ESH 03/2009 -- Partial fix for ticket #646.
+      // Crash fix on reading RPFs: Make sure the colorTable vector 
+      // has entries before trying to make use of them. 
+      if ( !theWorkFrame->getCompressionSection() ||
+           theWorkFrame->getColorGrayscaleTable().empty() )
+      {
+         return;
+      }
 
-   // ESH 03/2009 -- Partial fix for ticket #646.
-   // Crash fix on reading RPFs: Make sure the colorTable vector 
-   // has entries before trying to make use of them. 
-   int numTables = (int)colorTable.size();
-   if ( numTables <= 0 )
-   {
-      return;
+      // Decode the missing subframes in parallel.
+      std::vector< rspfRefPtr<const rspfRpfFrameCache::Subframe> > decoded;
+      cache->decodeSubframes( *theWorkFrame,
+                              frameFile,
+                              (theProductType == RSPF_PRODUCT_TYPE_CIB) ? 1 : 3,
+                              missingIds,
+                              decoded );
+      for ( rspf_uint32 i = 0; i < missingIdx.size(); ++i )
+      {
+         subframes[ missingIdx[i] ] = decoded[i];
+      }
    }
 
-   // check to see if it does overlap.  If it doesn't then the width and height
-   // will be a single point
+   for ( rspf_uint32 i = 0; i < subframes.size(); ++i )
    {
-      rspf_uint8 *tempRow;
-
-      tempRow = theUncompressedBuffer;
-      
-      // find the shift to 0,0
-      rspfIpt tempDelta(clipRect.ul().x - frameEntryData.thePixelCol,
-                         clipRect.ul().y - frameEntryData.thePixelRow);
-      
-      // In order to compute the subframe we will need the corner offsets of
-      // the upper left of the frame and the upper left of the clip rect.  The
-      // clip rect should be completely within the frame.  This just translates the value
-      // to make the upper left of the frame be 0,0.
-      //
-      rspfIrect offsetRect(tempDelta.x,
-                            tempDelta.y,
-                            tempDelta.x + clipRect.width()-1,
-                            tempDelta.y + clipRect.height()-1);
-
-      // each subframe is 64x64.  We will actually use 256x256 since
-      // we will be uncompressing them.  Note CADRG is a 256x256 tile
-      // compressed to 64x64x12 bit data
-      //
-      rspfIrect subFrameRect(offsetRect.ul().x/256,
-                              offsetRect.ul().y/256,
-                              (offsetRect.lr().x)/256,
-                              (offsetRect.lr().y)/256);
-
-      rspf_int32 row = 0;
-      rspf_int32 col = 0;
-      rspf_uint32 i = 0;
-      rspf_uint32 j = 0;
-      rspf_uint32 readPtr = 0;
-      for(row = subFrameRect.ul().y; row <= subFrameRect.lr().y; ++row)
+      // Null buffer is a masked subframe; tile was blanked by caller.
+      if ( subframes[i].valid() && subframes[i]->getBuf() )
       {
-         for(col = subFrameRect.ul().x; col <= subFrameRect.lr().x; ++col)
-         {
-            readPtr = 0;
-            if(aFrame.fillSubFrameBuffer(theCompressedBuffer, 0, row, col))
-            {
-               for (i = 0; i < 256; i += 4)
-               {
-                  for (j = 0; j < 256; j += 8)
-                  {
-                     rspf_uint16 firstByte  = theCompressedBuffer[readPtr++] & 0xff;
-                     rspf_uint16 secondByte = theCompressedBuffer[readPtr++] & 0xff;
-                     rspf_uint16 thirdByte  = theCompressedBuffer[readPtr++] & 0xff;
-                     
-                     //because dealing with half-bytes is hard, we
-                     //uncompress two 4x4 tiles at the same time. (a
-                     //4x4 tile compressed is 12 bits )
-                     // this little code was grabbed from openmap software.
-                     
-                     /* Get first 12-bit value as index into VQ table */
-                     // I think we need to swap
-                     rspf_uint16 val1 = (firstByte << 4) | (secondByte >> 4);
-                     
-                     /* Get second 12-bit value as index into VQ table*/
-                     rspf_uint16 val2 = ((secondByte & 0x000F) << 8) | thirdByte;
-
-                     for (rspf_uint32 t = 0; t < 4; ++t)
-                     {
-                        for (rspf_uint32 e = 0; e < 4; ++e)
-                        {
-                           rspf_uint16 tableVal1 = compressionSection->getTable()[t].theData[val1*4 + e] & 0xff;
-                           rspf_uint16 tableVal2 = compressionSection->getTable()[t].theData[val2*4 + e] & 0xff;
-
-                           rspf_uint32 pixindex = ((i+t)*256) + (j + e);
-                           const rspf_uint8* color1 = colorTable[0].getStartOfData(tableVal1);
-                           const rspf_uint8* color2 = colorTable[0].getStartOfData(tableVal2);
-
-                           
-                           tempRow[pixindex]      = color1[0];
-                           tempRow[pixindex + 4]  = color2[0];
-                        } //for e
-                     } //for t
-                  }  /* for j */
-               } //for i
-            }
-            else
-            {
-               memset(theUncompressedBuffer, 0, 256*256);
-            }
-            rspf_int32 tCol = col*256;
-            rspf_int32 tRow = row*256;
-            rspfIrect subRectToFill(frameRect.ul().x + tCol,
-                                     frameRect.ul().y + tRow,
-                                     frameRect.ul().x + tCol + 255,
-                                     frameRect.ul().y + tRow + 255);
-            tile->loadTile(theUncompressedBuffer,
-                           subRectToFill,
-                           RSPF_BSQ);
-         }
+         rspf_int32 tempCol = subframeIds[i].x*256;
+         rspf_int32 tempRow = subframeIds[i].y*256;
+         rspfIrect subRectToFill(frameRect.ul().x + tempCol,
+                                  frameRect.ul().y + tempRow,
+                                  frameRect.ul().x + tempCol + 255,
+                                  frameRect.ul().y + tempRow + 255);
+         tile->loadTile(const_cast<rspf_uint8*>( subframes[i]->getBuf() ),
+                        subRectToFill,
+                        RSPF_BSQ);
       }
-   }  
+   }
 }
 
 void rspfCibCadrgTileSource::allocateForProduct()
@@ -1019,28 +802,6 @@ void rspfCibCadrgTileSource::allocateForProduct()
    {
       return;
    }
-   if(theUncompressedBuffer)
-   {
-      delete [] theUncompressedBuffer;
-      theUncompressedBuffer = 0;
-   }
-   if(theCompressedBuffer)
-   {
-      delete [] theCompressedBuffer;
-      theCompressedBuffer = 0;
-   }
-   
-   // a CADRG and CIBis a 64*64*12 bit buffer and must divide by 8 to
-   // convert to bytes
-   theCompressedBuffer   = new rspf_uint8[(64*64*12)/8];
-   if(theProductType == RSPF_PRODUCT_TYPE_CIB)
-   {
-      theUncompressedBuffer = new rspf_uint8[256*256];
-   }
-   else
-   {
-      theUncompressedBuffer = new rspf_uint8[256*256*3];
-   }
    
    theTile = rspfImageDataFactory::instance()->create(this, this);
    theTile->initialize();
@@ -1070,11 +831,8 @@ const rspfRpfTocEntry* rspfCibCadrgTileSource::findFirstFrame()
 void rspfCibCadrgTileSource::deleteAll()
 {
    theOverview = 0;
-   if(theTableOfContents)
-   {
-      delete theTableOfContents;
-      theTableOfContents = 0;
-   }
+   theTableOfContents = 0; // rspfRefPtr, shared through rspfRpfFrameCache.
+   theWorkFrameFile.clear();
 }
 
 bool rspfCibCadrgTileSource::saveState(rspfKeywordlist& kwl,
@@ -0,0 +1,428 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfConvolutionEngine.cpp
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:
+//
+// Direct, separable and FFT convolution of null free bands.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#include <rspf/imaging/rspfConvolutionEngine.h>
+#include <rspf/matrix/newmatap.h>
+
+#include <algorithm>
+#include <cmath>
+
+const rspf_uint32 rspfConvolutionEngine::DEFAULT_FFT_THRESHOLD = 256;
+
+// Relative tolerance for the rank one test.
+static const rspf_float64 SEPARABLE_TOLERANCE = 1.0e-10;
+
+rspfConvolutionEngine::rspfConvolutionEngine()
+   : m_width(0),
+     m_height(0),
+     m_kernel(0),
+     m_taps(0),
+     m_rowKernel(0),
+     m_colKernel(0),
+     m_separable(false),
+     m_scale(1.0),
+     m_fftThreshold(DEFAULT_FFT_THRESHOLD),
+     m_method(DIRECT),
+     m_fftRows(0),
+     m_fftCols(0),
+     m_kernelRe(),
+     m_kernelIm(),
+     m_work(0),
+     m_sums(0)
+{
+}
+
+void rspfConvolutionEngine::setKernel(const NEWMAT::Matrix& kernel, bool doWeightedAverage)
+{
+   m_height = static_cast<rspf_uint32>( kernel.Nrows() );
+   m_width  = static_cast<rspf_uint32>( kernel.Ncols() );
+   m_kernel.resize( m_width * m_height );
+   m_taps.clear();
+   m_fftRows = 0;
+   m_fftCols = 0;
+
+   rspf_float64 sum    = 0.0;
+   rspf_float64 maxAbs = 0.0;
+   rspf_uint32  pivotRow = 0;
+   rspf_uint32  pivotCol = 0;
+   for ( rspf_uint32 row = 0; row < m_height; ++row )
+   {
+      for ( rspf_uint32 col = 0; col < m_width; ++col )
+      {
+         const rspf_float64 w = kernel[row][col];
+         m_kernel[row * m_width + col] = w;
+         sum += w;
+         if ( w != 0.0 )
+         {
+            Tap tap;
+            tap.m_row    = row;
+            tap.m_col    = col;
+            tap.m_weight = w;
+            m_taps.push_back( tap );
+         }
+         if ( std::fabs(w) > maxAbs )
+         {
+            maxAbs   = std::fabs(w);
+            pivotRow = row;
+            pivotCol = col;
+         }
+      }
+   }
+
+   // Same rule as rspfDiscreteConvolutionKernel with no nulls present.
+   m_scale = ( doWeightedAverage && ( sum > 0.0 ) ) ? ( 1.0 / sum ) : 1.0;
+
+   //---
+   // Rank one test: K(r,c) == col(r) * row(c) with col taken through the
+   // largest coefficient.
+   //---
+   m_separable = false;
+   m_rowKernel.clear();
+   m_colKernel.clear();
+   if ( maxAbs > 0.0 )
+   {
+      const rspf_float64 pivot = m_kernel[pivotRow * m_width + pivotCol];
+      m_colKernel.resize( m_height );
+      m_rowKernel.resize( m_width );
+      for ( rspf_uint32 row = 0; row < m_height; ++row )
+      {
+         m_colKernel[row] = m_kernel[row * m_width + pivotCol];
+      }
+      for ( rspf_uint32 col = 0; col < m_width; ++col )
+      {
+         m_rowKernel[col] = m_kernel[pivotRow * m_width + col] / pivot;
+      }
+
+      m_separable = true;
+      const rspf_float64 tolerance = maxAbs * SEPARABLE_TOLERANCE;
+      for ( rspf_uint32 row = 0; ( row < m_height ) && m_separable; ++row )
+      {
+         for ( rspf_uint32 col = 0; col < m_width; ++col )
+         {
+            if ( std::fabs( m_kernel[row * m_width + col] -
+                            m_colKernel[row] * m_rowKernel[col] ) > tolerance )
+            {
+               m_separable = false;
+               break;
+            }
+         }
+      }
+   }
+
+   selectMethod();
+}
+
+void rspfConvolutionEngine::selectMethod()
+{
+   const rspf_uint32 taps = static_cast<rspf_uint32>( m_taps.size() );
+   if ( m_separable && ( m_width > 1 ) && ( m_height > 1 ) &&
+        ( m_width + m_height < taps ) )
+   {
+      m_method = SEPARABLE;
+   }
+   else if ( m_fftThreshold && ( taps >= m_fftThreshold ) )
+   {
+      m_method = FFT;
+   }
+   else
+   {
+      m_method = DIRECT;
+   }
+}
+
+rspfConvolutionEngine::Method rspfConvolutionEngine::getMethod() const
+{
+   return m_method;
+}
+
+bool rspfConvolutionEngine::isSeparable() const
+{
+   return m_separable;
+}
+
+rspf_uint32 rspfConvolutionEngine::getWidth() const
+{
+   return m_width;
+}
+
+rspf_uint32 rspfConvolutionEngine::getHeight() const
+{
+   return m_height;
+}
+
+void rspfConvolutionEngine::setFftThreshold(rspf_uint32 taps)
+{
+   m_fftThreshold = taps;
+   selectMethod();
+}
+
+rspf_uint32 rspfConvolutionEngine::getFftThreshold() const
+{
+   return m_fftThreshold;
+}
+
+void rspfConvolutionEngine::convolve(const rspf_uint8* in, rspf_uint32 inWidth,
+                                     rspf_uint8* out, rspf_uint32 outWidth,
+                                     rspf_uint32 outHeight,
+                                     rspf_float64 minPix, rspf_float64 maxPix)
+{
+   convolveBand(in, inWidth, out, outWidth, outHeight, minPix, maxPix);
+}
+
+void rspfConvolutionEngine::convolve(const rspf_uint16* in, rspf_uint32 inWidth,
+                                     rspf_uint16* out, rspf_uint32 outWidth,
+                                     rspf_uint32 outHeight,
+                                     rspf_float64 minPix, rspf_float64 maxPix)
+{
+   convolveBand(in, inWidth, out, outWidth, outHeight, minPix, maxPix);
+}
+
+void rspfConvolutionEngine::convolve(const rspf_sint16* in, rspf_uint32 inWidth,
+                                     rspf_sint16* out, rspf_uint32 outWidth,
+                                     rspf_uint32 outHeight,
+                                     rspf_float64 minPix, rspf_float64 maxPix)
+{
+   convolveBand(in, inWidth, out, outWidth, outHeight, minPix, maxPix);
+}
+
+void rspfConvolutionEngine::convolve(const rspf_float32* in, rspf_uint32 inWidth,
+                                     rspf_float32* out, rspf_uint32 outWidth,
+                                     rspf_uint32 outHeight,
+                                     rspf_float64 minPix, rspf_float64 maxPix)
+{
+   convolveBand(in, inWidth, out, outWidth, outHeight, minPix, maxPix);
+}
+
+void rspfConvolutionEngine::convolve(const rspf_float64* in, rspf_uint32 inWidth,
+                                     rspf_float64* out, rspf_uint32 outWidth,
+                                     rspf_uint32 outHeight,
+                                     rspf_float64 minPix, rspf_float64 maxPix)
+{
+   convolveBand(in, inWidth, out, outWidth, outHeight, minPix, maxPix);
+}
+
+template <class T>
+void rspfConvolutionEngine::convolveBand(const T* in, rspf_uint32 inWidth,
+                                         T* out, rspf_uint32 outWidth,
+                                         rspf_uint32 outHeight,
+                                         rspf_float64 minPix, rspf_float64 maxPix)
+{
+   if ( !in || !out || !outWidth || !outHeight || !m_width || !m_height )
+   {
+      return;
+   }
+
+   m_sums.resize( outWidth );
+
+   switch ( m_method )
+   {
+      case SEPARABLE:
+         convolveSeparable(in, inWidth, out, outWidth, outHeight, minPix, maxPix);
+         break;
+      case FFT:
+         convolveFft(in, inWidth, out, outWidth, outHeight, minPix, maxPix);
+         break;
+      default:
+         convolveDirect(in, inWidth, out, outWidth, outHeight, minPix, maxPix);
+         break;
+   }
+}
+
+template <class T>
+void rspfConvolutionEngine::convolveDirect(const T* in, rspf_uint32 inWidth,
+                                           T* out, rspf_uint32 outWidth,
+                                           rspf_uint32 outHeight,
+                                           rspf_float64 minPix, rspf_float64 maxPix)
+{
+   rspf_float64* sums = &m_sums.front();
+   const rspf_uint32 taps = static_cast<rspf_uint32>( m_taps.size() );
+
+   for ( rspf_uint32 y = 0; y < outHeight; ++y )
+   {
+      std::fill( sums, sums + outWidth, 0.0 );
+      for ( rspf_uint32 t = 0; t < taps; ++t )
+      {
+         const Tap& tap = m_taps[t];
+         const T* s = in + (y + tap.m_row) * inWidth + tap.m_col;
+         const rspf_float64 w = tap.m_weight;
+         for ( rspf_uint32 x = 0; x < outWidth; ++x )
+         {
+            sums[x] += w * s[x];
+         }
+      }
+      storeRow( sums, out + y * outWidth, outWidth, minPix, maxPix );
+   }
+}
+
+template <class T>
+void rspfConvolutionEngine::convolveSeparable(const T* in, rspf_uint32 inWidth,
+                                              T* out, rspf_uint32 outWidth,
+                                              rspf_uint32 outHeight,
+                                              rspf_float64 minPix, rspf_float64 maxPix)
+{
+   // Horizontal pass over every input line the vertical pass needs.
+   const rspf_uint32 lines = outHeight + m_height - 1;
+   m_work.resize( lines * outWidth );
+   rspf_float64* work = &m_work.front();
+   for ( rspf_uint32 line = 0; line < lines; ++line )
+   {
+      const T* s = in + line * inWidth;
+      rspf_float64* d = work + line * outWidth;
+      std::fill( d, d + outWidth, 0.0 );
+      for ( rspf_uint32 col = 0; col < m_width; ++col )
+      {
+         const rspf_float64 w = m_rowKernel[col];
+         if ( w != 0.0 )
+         {
+            const T* sc = s + col;
+            for ( rspf_uint32 x = 0; x < outWidth; ++x )
+            {
+               d[x] += w * sc[x];
+            }
+         }
+      }
+   }
+
+   // Vertical pass.
+   rspf_float64* sums = &m_sums.front();
+   for ( rspf_uint32 y = 0; y < outHeight; ++y )
+   {
+      std::fill( sums, sums + outWidth, 0.0 );
+      for ( rspf_uint32 row = 0; row < m_height; ++row )
+      {
+         const rspf_float64 w = m_colKernel[row];
+         if ( w != 0.0 )
+         {
+            const rspf_float64* s = work + (y + row) * outWidth;
+            for ( rspf_uint32 x = 0; x < outWidth; ++x )
+            {
+               sums[x] += w * s[x];
+            }
+         }
+      }
+      storeRow( sums, out + y * outWidth, outWidth, minPix, maxPix );
+   }
+}
+
+template <class T>
+void rspfConvolutionEngine::convolveFft(const T* in, rspf_uint32 inWidth,
+                                        T* out, rspf_uint32 outWidth,
+                                        rspf_uint32 outHeight,
+                                        rspf_float64 minPix, rspf_float64 maxPix)
+{
+   const rspf_uint32 patchWidth  = outWidth  + m_width  - 1;
+   const rspf_uint32 patchHeight = outHeight + m_height - 1;
+   const rspf_uint32 rows = getFftSize( patchHeight );
+   const rspf_uint32 cols = getFftSize( patchWidth );
+   if ( ( rows != m_fftRows ) || ( cols != m_fftCols ) )
+   {
+      buildKernelSpectrum( rows, cols );
+   }
+
+   // Zero padded patch.  Padding only wraps into outputs we do not keep.
+   NEWMAT::Matrix inRe(rows, cols);
+   NEWMAT::Matrix inIm(rows, cols);
+   inRe = 0.0;
+   inIm = 0.0;
+   for ( rspf_uint32 line = 0; line < patchHeight; ++line )
+   {
+      const T* s = in + line * inWidth;
+      rspf_float64* d = inRe.Store() + line * cols;
+      for ( rspf_uint32 x = 0; x < patchWidth; ++x )
+      {
+         d[x] = s[x];
+      }
+   }
+
+   NEWMAT::Matrix re;
+   NEWMAT::Matrix im;
+   NEWMAT::FFT2(inRe, inIm, re, im);
+
+   rspf_float64* a = re.Store();
+   rspf_float64* b = im.Store();
+   const rspf_float64* c = m_kernelRe.Store();
+   const rspf_float64* d = m_kernelIm.Store();
+   const rspf_uint32 size = rows * cols;
+   for ( rspf_uint32 i = 0; i < size; ++i )
+   {
+      const rspf_float64 ar = a[i];
+      a[i] = ar * c[i] - b[i] * d[i];
+      b[i] = ar * d[i] + b[i] * c[i];
+   }
+
+   NEWMAT::FFT2I(re, im, inRe, inIm);
+
+   // Output (x,y) is at (x + width - 1, y + height - 1) of the circular result.
+   const rspf_float64* result = inRe.Store();
+   for ( rspf_uint32 y = 0; y < outHeight; ++y )
+   {
+      storeRow( result + (y + m_height - 1) * cols + (m_width - 1),
+                out + y * outWidth, outWidth, minPix, maxPix );
+   }
+}
+
+void rspfConvolutionEngine::buildKernelSpectrum(rspf_uint32 rows, rspf_uint32 cols)
+{
+   //---
+   // Flipped so the circular convolution gives the top left anchored
+   // correlation convolveSubImage computes.
+   //---
+   NEWMAT::Matrix kRe(rows, cols);
+   NEWMAT::Matrix kIm(rows, cols);
+   kRe = 0.0;
+   kIm = 0.0;
+   for ( rspf_uint32 row = 0; row < m_height; ++row )
+   {
+      for ( rspf_uint32 col = 0; col < m_width; ++col )
+      {
+         kRe[row][col] = m_kernel[(m_height - 1 - row) * m_width + (m_width - 1 - col)];
+      }
+   }
+   NEWMAT::FFT2(kRe, kIm, m_kernelRe, m_kernelIm);
+   m_fftRows = rows;
+   m_fftCols = cols;
+}
+
+template <class T>
+void rspfConvolutionEngine::storeRow(const rspf_float64* sums, T* out,
+                                     rspf_uint32 count,
+                                     rspf_float64 minPix, rspf_float64 maxPix) const
+{
+   for ( rspf_uint32 x = 0; x < count; ++x )
+   {
+      rspf_float64 v = sums[x] * m_scale;
+      v = v < minPix ? minPix : v;
+      v = v > maxPix ? maxPix : v;
+      out[x] = static_cast<T>(v);
+   }
+}
+
+rspf_uint32 rspfConvolutionEngine::getFftSize(rspf_uint32 n)
+{
+   rspf_uint32 size = n ? n : 1;
+   while ( true )
+   {
+      rspf_uint32 m = size;
+      while ( ( m % 2 ) == 0 ) m /= 2;
+      while ( ( m % 3 ) == 0 ) m /= 3;
+      while ( ( m % 5 ) == 0 ) m /= 5;
+      if ( m == 1 )
+      {
+         break;
+      }
+      ++size;
+   }
+   return size;
+}
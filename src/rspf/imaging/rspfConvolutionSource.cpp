@@ -12,6 +12,7 @@
 #include <rspf/imaging/rspfConvolutionSource.h>
 #include <rspf/imaging/rspfImageData.h>
 #include <rspf/imaging/rspfDiscreteConvolutionKernel.h>
+#include <rspf/imaging/rspfConvolutionEngine.h>
 #include <rspf/imaging/rspfImageDataFactory.h>
 #include <rspf/base/rspfKeywordlist.h>
 #include <rspf/base/rspfKeyword.h>
@@ -145,7 +146,8 @@ rspfRefPtr<rspfImageData> rspfConvolutionSource::getTile(
       {
          convolve(static_cast<rspf_uint8>(0),
                   input,
-                  theConvolutionKernelList[0]);
+                  theConvolutionKernelList[0],
+                  theConvolutionEngineList[0]);
       }
       else
       {
@@ -155,7 +157,8 @@ rspfRefPtr<rspfImageData> rspfConvolutionSource::getTile(
          {
             convolve(static_cast<rspf_uint8>(0),
                      input,
-                     theConvolutionKernelList[idx]);
+                     theConvolutionKernelList[idx],
+                     theConvolutionEngineList[idx]);
             input->loadTile(theTile.get());
          }
       }
@@ -168,7 +171,8 @@ rspfRefPtr<rspfImageData> rspfConvolutionSource::getTile(
       {
          convolve(static_cast<rspf_uint16>(0),
                   input,
-                  theConvolutionKernelList[0]);
+                  theConvolutionKernelList[0],
+                  theConvolutionEngineList[0]);
       }
       else
       {
@@ -178,7 +182,8 @@ rspfRefPtr<rspfImageData> rspfConvolutionSource::getTile(
          {
             convolve(static_cast<rspf_uint16>(0),
                      input,
-                     theConvolutionKernelList[idx]);
+                     theConvolutionKernelList[idx],
+                     theConvolutionEngineList[idx]);
             input->loadTile(theTile.get());
          }
       }
@@ -190,7 +195,8 @@ rspfRefPtr<rspfImageData> rspfConvolutionSource::getTile(
       {
          convolve(static_cast<rspf_sint16>(0),
                   input,
-                  theConvolutionKernelList[0]);
+                  theConvolutionKernelList[0],
+                  theConvolutionEngineList[0]);
       }
       else
       {
@@ -200,7 +206,8 @@ rspfRefPtr<rspfImageData> rspfConvolutionSource::getTile(
          {
             convolve(static_cast<rspf_sint16>(0),
                      input,
-                     theConvolutionKernelList[idx]);
+                     theConvolutionKernelList[idx],
+                     theConvolutionEngineList[idx]);
             input->loadTile(theTile.get());
          }
       }
@@ -213,7 +220,8 @@ rspfRefPtr<rspfImageData> rspfConvolutionSource::getTile(
       {
          convolve(static_cast<float>(0),
                   input,
-                  theConvolutionKernelList[0]);
+                  theConvolutionKernelList[0],
+                  theConvolutionEngineList[0]);
       }
       else
       {
@@ -223,7 +231,8 @@ rspfRefPtr<rspfImageData> rspfConvolutionSource::getTile(
          {
             convolve(static_cast<float>(0),
                      input,
-                     theConvolutionKernelList[idx]);
+                     theConvolutionKernelList[idx],
+                     theConvolutionEngineList[idx]);
             input->loadTile(theTile.get());
          }
       }
@@ -236,7 +245,8 @@ rspfRefPtr<rspfImageData> rspfConvolutionSource::getTile(
       {
          convolve(static_cast<double>(0),
                   input,
-                  theConvolutionKernelList[0]);
+                  theConvolutionKernelList[0],
+                  theConvolutionEngineList[0]);
       }
       else
       {
@@ -246,7 +256,8 @@ rspfRefPtr<rspfImageData> rspfConvolutionSource::getTile(
          {
             convolve(static_cast<double>(0),
                      input,
-                     theConvolutionKernelList[idx]);
+                     theConvolutionKernelList[idx],
+                     theConvolutionEngineList[idx]);
             input->loadTile(theTile.get());
          }
       }
@@ -264,7 +275,8 @@ rspfRefPtr<rspfImageData> rspfConvolutionSource::getTile(
 template <class T>
 void rspfConvolutionSource::convolve(T /* dummyVariable */,
                                       rspfRefPtr<rspfImageData> inputTile,
-                                      rspfDiscreteConvolutionKernel* kernel)
+                                      rspfDiscreteConvolutionKernel* kernel,
+                                      rspfConvolutionEngine* engine)
 {
    rspfIpt startOrigin   = theTile->getOrigin();
 
@@ -335,6 +347,23 @@ void rspfConvolutionSource::convolve(T /* dummyVariable */,
          }
       }
    }
+   else if(engine && (status == RSPF_FULL))
+   {
+      // No nulls; whole bands at a time.
+      const T* inStart = 0;
+      for(long b = 0; b < outputBands; ++b)
+      {
+         inStart = (const T*)inputTile->getBuf(b) +
+            patchWidth*(startDelta.y - convolutionOffsetY) + (startDelta.x - convolutionOffsetX);
+         engine->convolve(inStart,
+                          (rspf_uint32)patchWidth,
+                          (T*)(theTile->getBuf(b)),
+                          (rspf_uint32)tileWidth,
+                          (rspf_uint32)tileHeight,
+                          minPix,
+                          maxPix);
+      }
+   }
    else  // do not need to check for nulls here.
    {
       for(long b = 0; b < outputBands; ++b)
@@ -490,9 +519,23 @@ bool rspfConvolutionSource::loadState(const rspfKeywordlist& kwl,
 void rspfConvolutionSource::setKernelInformation()
 {
    rspf_uint32 index;
+
+   for(index = 0; index < theConvolutionEngineList.size(); ++index)
+   {
+      delete theConvolutionEngineList[index];
+   }
+   theConvolutionEngineList.clear();
    
    if(theConvolutionKernelList.size() > 0)
    {
+      for(index = 0; index < theConvolutionKernelList.size(); ++index)
+      {
+         rspfConvolutionEngine* engine = new rspfConvolutionEngine();
+         engine->setKernel(theConvolutionKernelList[index]->getKernel(),
+                           theConvolutionKernelList[index]->getComputeWeightedAverageFlag());
+         theConvolutionEngineList.push_back(engine);
+      }
+
       theMaxKernelWidth  = theConvolutionKernelList[0]->getWidth();
       theMaxKernelHeight = theConvolutionKernelList[0]->getHeight();
       
@@ -512,8 +555,13 @@ void rspfConvolutionSource::deleteConvolutionList()
    {
       delete theConvolutionKernelList[index];
    }
+   for(rspf_int32 index = 0; index < (rspf_int32)theConvolutionEngineList.size(); ++index)
+   {
+      delete theConvolutionEngineList[index];
+   }
 
    theConvolutionKernelList.clear();
+   theConvolutionEngineList.clear();
 }
 
 void rspfConvolutionSource::setConvolution(const NEWMAT::Matrix& convolutionMatrix, bool doWeightedAverage)
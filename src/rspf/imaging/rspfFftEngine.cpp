@@ -0,0 +1,866 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfFftEngine.cpp
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:
+//
+// Process wide 2D real to complex FFT service with plan cache and a built
+// in mixed radix backend.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#include <rspf/imaging/rspfFftEngine.h>
+#include <rspf/base/rspfCommon.h>
+#include <rspf/base/rspfNotify.h>
+#include <rspf/base/rspfPreferences.h>
+#include <rspf/base/rspfTrace.h>
+#include <rspf/parallel/rspfJob.h>
+#include <rspf/parallel/rspfJobQueue.h>
+#include <OpenThreads/Block>
+#include <OpenThreads/ScopedLock>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+static rspfTrace traceDebug(rspfString("rspfFftEngine:debug"));
+
+rspfFftEngine* rspfFftEngine::m_instance = 0;
+
+//---
+// Built in backend.
+//---
+
+//---
+// Complex FFT of one length.  Recursive decimation in time; radix 4 and 2
+// butterflies, generic butterfly for the odd factors.
+//---
+template <class T>
+class rspfFftComplex1d
+{
+public:
+   typedef std::complex<T> Cplx;
+
+   rspfFftComplex1d()
+      : m_n(0), m_maxRadix(1), m_factors(), m_forward(), m_inverse()
+   {
+   }
+
+   void init(rspf_uint32 n)
+   {
+      m_n = n;
+      m_maxRadix = 1;
+      m_factors.clear();
+
+      // Factor n; fours first then twos then odd numbers.
+      const rspf_uint32 ROOT =
+         static_cast<rspf_uint32>( std::floor( std::sqrt( (double)n ) ) );
+      rspf_uint32 left = n;
+      rspf_uint32 p = 4;
+      while ( left > 1 )
+      {
+         while ( left % p )
+         {
+            switch ( p )
+            {
+               case 4:
+                  p = 2;
+                  break;
+               case 2:
+                  p = 3;
+                  break;
+               default:
+                  p += 2;
+                  break;
+            }
+            if ( p > ROOT )
+            {
+               p = left;
+            }
+         }
+         left /= p;
+         m_factors.push_back(p);
+         m_factors.push_back(left);
+         m_maxRadix = std::max(m_maxRadix, p);
+      }
+
+      m_forward.resize(n);
+      m_inverse.resize(n);
+      for ( rspf_uint32 i = 0; i < n; ++i )
+      {
+         const double A = -TWO_PI * i / n;
+         m_forward[i] = Cplx( static_cast<T>( std::cos(A) ),
+                              static_cast<T>( std::sin(A) ) );
+         m_inverse[i] = std::conj( m_forward[i] );
+      }
+   }
+
+   rspf_uint32 getMaxRadix() const
+   {
+      return m_maxRadix;
+   }
+
+   /**
+    * in and out must not overlap.  scratch must hold getMaxRadix() values.
+    */
+   void transform(const Cplx* in, Cplx* out, bool inverse, Cplx* scratch) const
+   {
+      if ( m_n == 1 )
+      {
+         out[0] = in[0];
+      }
+      else if ( m_n > 1 )
+      {
+         work( out, in, 1, &m_factors.front(),
+               inverse ? &m_inverse.front() : &m_forward.front(),
+               inverse, scratch );
+      }
+   }
+
+private:
+
+   void work(Cplx* out, const Cplx* in, rspf_uint32 fstride,
+             const rspf_uint32* factors, const Cplx* tw, bool inverse,
+             Cplx* scratch) const
+   {
+      const rspf_uint32 P = factors[0];
+      const rspf_uint32 M = factors[1];
+      rspf_uint32 q;
+      if ( M == 1 )
+      {
+         for ( q = 0; q < P; ++q )
+         {
+            out[q] = *in;
+            in += fstride;
+         }
+      }
+      else
+      {
+         for ( q = 0; q < P; ++q )
+         {
+            work( out + q * M, in, fstride * P, factors + 2, tw, inverse, scratch );
+            in += fstride;
+         }
+      }
+
+      switch ( P )
+      {
+         case 2:
+            butterfly2( out, fstride, M, tw );
+            break;
+         case 4:
+            butterfly4( out, fstride, M, tw, inverse );
+            break;
+         default:
+            butterflyGeneric( out, fstride, M, P, tw, scratch );
+            break;
+      }
+   }
+
+   void butterfly2(Cplx* out, rspf_uint32 fstride, rspf_uint32 m,
+                   const Cplx* tw) const
+   {
+      Cplx* out2 = out + m;
+      for ( rspf_uint32 k = 0; k < m; ++k )
+      {
+         const Cplx T1 = out2[k] * tw[k * fstride];
+         out2[k] = out[k] - T1;
+         out[k] += T1;
+      }
+   }
+
+   void butterfly4(Cplx* out, rspf_uint32 fstride, rspf_uint32 m,
+                   const Cplx* tw, bool inverse) const
+   {
+      for ( rspf_uint32 k = 0; k < m; ++k )
+      {
+         const Cplx S0 = out[k + m]     * tw[k * fstride];
+         const Cplx S1 = out[k + 2 * m] * tw[2 * k * fstride];
+         const Cplx S2 = out[k + 3 * m] * tw[3 * k * fstride];
+         const Cplx S5 = out[k] - S1;
+         out[k] += S1;
+         const Cplx S3 = S0 + S2;
+         const Cplx S4 = S0 - S2;
+         out[k + 2 * m] = out[k] - S3;
+         out[k] += S3;
+
+         // Rotate S4 by -i forward, +i inverse.
+         if ( inverse )
+         {
+            out[k + m]     = Cplx( S5.real() - S4.imag(), S5.imag() + S4.real() );
+            out[k + 3 * m] = Cplx( S5.real() + S4.imag(), S5.imag() - S4.real() );
+         }
+         else
+         {
+            out[k + m]     = Cplx( S5.real() + S4.imag(), S5.imag() - S4.real() );
+            out[k + 3 * m] = Cplx( S5.real() - S4.imag(), S5.imag() + S4.real() );
+         }
+      }
+   }
+
+   void butterflyGeneric(Cplx* out, rspf_uint32 fstride, rspf_uint32 m,
+                         rspf_uint32 p, const Cplx* tw, Cplx* scratch) const
+   {
+      for ( rspf_uint32 u = 0; u < m; ++u )
+      {
+         rspf_uint32 q1;
+         for ( q1 = 0; q1 < p; ++q1 )
+         {
+            scratch[q1] = out[u + q1 * m];
+         }
+         for ( q1 = 0; q1 < p; ++q1 )
+         {
+            const rspf_uint32 K = u + q1 * m;
+            rspf_uint32 twIdx = 0;
+            Cplx sum = scratch[0];
+            for ( rspf_uint32 q = 1; q < p; ++q )
+            {
+               twIdx += fstride * K;
+               if ( twIdx >= m_n )
+               {
+                  twIdx -= m_n;
+               }
+               sum += scratch[q] * tw[twIdx];
+            }
+            out[K] = sum;
+         }
+      }
+   }
+
+   rspf_uint32               m_n;
+   rspf_uint32               m_maxRadix;
+   std::vector<rspf_uint32>  m_factors; // (radix, remaining length) pairs
+   std::vector<Cplx>         m_forward;
+   std::vector<Cplx>         m_inverse;
+};
+
+//---
+// 2D real to complex.  Rows then columns.  Even row lengths are done as a
+// half length complex transform of the (even, odd) sample pairs plus a
+// split step.
+//---
+template <class T>
+class rspfFftReal2d
+{
+public:
+   typedef std::complex<T> Cplx;
+
+   rspfFftReal2d()
+      : m_rows(0), m_cols(0), m_complexCols(0), m_scratchSize(0),
+        m_rowFft(), m_colFft(), m_split()
+   {
+   }
+
+   void init(rspf_uint32 rows, rspf_uint32 cols)
+   {
+      m_rows = rows;
+      m_cols = cols;
+      m_complexCols = cols / 2 + 1;
+      m_colFft.init(rows);
+      m_split.clear();
+      if ( (cols & 1) == 0 )
+      {
+         const rspf_uint32 HALF = cols / 2;
+         m_rowFft.init(HALF);
+         m_split.resize(HALF + 1);
+         for ( rspf_uint32 k = 0; k <= HALF; ++k )
+         {
+            const double A = -2.0 * M_PI * k / cols;
+            m_split[k] = Cplx( static_cast<T>( std::cos(A) ),
+                               static_cast<T>( std::sin(A) ) );
+         }
+      }
+      else
+      {
+         m_rowFft.init(cols);
+      }
+      m_scratchSize = 2 * std::max(rows, cols) +
+         std::max( m_rowFft.getMaxRadix(), m_colFft.getMaxRadix() );
+   }
+
+   void forward(const T* in, T* out) const
+   {
+      std::vector<Cplx> scratch(m_scratchSize);
+      const rspf_uint32 LEN = std::max(m_rows, m_cols);
+      Cplx* a = &scratch.front();
+      Cplx* b = a + LEN;
+      Cplx* w = b + LEN;
+      Cplx* spec = reinterpret_cast<Cplx*>(out);
+      const rspf_uint32 CC = m_complexCols;
+      rspf_uint32 r;
+      rspf_uint32 k;
+
+      for ( r = 0; r < m_rows; ++r )
+      {
+         const T* row = in + r * m_cols;
+         Cplx* dst = spec + r * CC;
+         if ( m_split.size() )
+         {
+            const rspf_uint32 HALF = m_cols / 2;
+            for ( k = 0; k < HALF; ++k )
+            {
+               a[k] = Cplx( row[2 * k], row[2 * k + 1] );
+            }
+            m_rowFft.transform( a, b, false, w );
+            const Cplx HALF_MINUS_I( 0, static_cast<T>(-0.5) );
+            for ( k = 0; k <= HALF; ++k )
+            {
+               const Cplx ZK = b[ (k == HALF) ? 0 : k ];
+               const Cplx ZC = std::conj( b[ (HALF - k) % HALF ] );
+               const Cplx EVEN = (ZK + ZC) * static_cast<T>(0.5);
+               const Cplx ODD  = (ZK - ZC) * HALF_MINUS_I;
+               dst[k] = EVEN + m_split[k] * ODD;
+            }
+         }
+         else
+         {
+            for ( k = 0; k < m_cols; ++k )
+            {
+               a[k] = Cplx( row[k], 0 );
+            }
+            m_rowFft.transform( a, b, false, w );
+            std::copy( b, b + CC, dst );
+         }
+      }
+
+      transformColumns( spec, false, a, b, w );
+   }
+
+   void inverse(T* in, T* out) const
+   {
+      std::vector<Cplx> scratch(m_scratchSize);
+      const rspf_uint32 LEN = std::max(m_rows, m_cols);
+      Cplx* a = &scratch.front();
+      Cplx* b = a + LEN;
+      Cplx* w = b + LEN;
+      Cplx* spec = reinterpret_cast<Cplx*>(in);
+      const rspf_uint32 CC = m_complexCols;
+      rspf_uint32 r;
+      rspf_uint32 k;
+
+      transformColumns( spec, true, a, b, w );
+
+      for ( r = 0; r < m_rows; ++r )
+      {
+         const Cplx* src = spec + r * CC;
+         T* row = out + r * m_cols;
+         if ( m_split.size() )
+         {
+            const rspf_uint32 HALF = m_cols / 2;
+            const Cplx I( 0, 1 );
+            for ( k = 0; k < HALF; ++k )
+            {
+               const Cplx XK = src[k];
+               const Cplx XC = std::conj( src[HALF - k] );
+               a[k] = (XK + XC) + I * (XK - XC) * std::conj( m_split[k] );
+            }
+            m_rowFft.transform( a, b, true, w );
+            for ( k = 0; k < HALF; ++k )
+            {
+               row[2 * k]     = b[k].real();
+               row[2 * k + 1] = b[k].imag();
+            }
+         }
+         else
+         {
+            for ( k = 0; k < CC; ++k )
+            {
+               a[k] = src[k];
+            }
+            for ( ; k < m_cols; ++k )
+            {
+               a[k] = std::conj( src[m_cols - k] );
+            }
+            m_rowFft.transform( a, b, true, w );
+            for ( k = 0; k < m_cols; ++k )
+            {
+               row[k] = b[k].real();
+            }
+         }
+      }
+   }
+
+private:
+
+   void transformColumns(Cplx* spec, bool inverse, Cplx* a, Cplx* b, Cplx* w) const
+   {
+      const rspf_uint32 CC = m_complexCols;
+      for ( rspf_uint32 c = 0; c < CC; ++c )
+      {
+         rspf_uint32 r;
+         const Cplx* src = spec + c;
+         for ( r = 0; r < m_rows; ++r )
+         {
+            a[r] = *src;
+            src += CC;
+         }
+         m_colFft.transform( a, b, inverse, w );
+         Cplx* dst = spec + c;
+         for ( r = 0; r < m_rows; ++r )
+         {
+            *dst = b[r];
+            dst += CC;
+         }
+      }
+   }
+
+   rspf_uint32            m_rows;
+   rspf_uint32            m_cols;
+   rspf_uint32            m_complexCols;
+   rspf_uint32            m_scratchSize;
+   rspfFftComplex1d<T>    m_rowFft;
+   rspfFftComplex1d<T>    m_colFft;
+   std::vector<Cplx>      m_split; // even cols only, exp(-2 pi i k/cols)
+};
+
+class rspfFftBuiltinPlan : public rspfFftEngine::Plan
+{
+public:
+   rspfFftBuiltinPlan(rspf_uint32 rows, rspf_uint32 cols)
+      : rspfFftEngine::Plan(rows, cols), m_double(), m_single()
+   {
+      m_double.init(rows, cols);
+      m_single.init(rows, cols);
+   }
+   virtual void forward(const rspf_float64* in, rspf_float64* out) const
+   {
+      m_double.forward(in, out);
+   }
+   virtual void forward(const rspf_float32* in, rspf_float32* out) const
+   {
+      m_single.forward(in, out);
+   }
+   virtual void inverse(rspf_float64* in, rspf_float64* out) const
+   {
+      m_double.inverse(in, out);
+   }
+   virtual void inverse(rspf_float32* in, rspf_float32* out) const
+   {
+      m_single.inverse(in, out);
+   }
+private:
+   rspfFftReal2d<rspf_float64> m_double;
+   rspfFftReal2d<rspf_float32> m_single;
+};
+
+class rspfFftBuiltinBackend : public rspfFftEngine::Backend
+{
+public:
+   virtual rspfString getName() const
+   {
+      return rspfString("builtin");
+   }
+   virtual rspfFftEngine::Plan* createPlan(rspf_uint32 rows, rspf_uint32 cols)
+   {
+      return new rspfFftBuiltinPlan(rows, cols);
+   }
+};
+
+//---
+// Private classes for parallel batches.
+//---
+class rspfFftBatch : public rspfReferenced
+{
+public:
+   rspfFftBatch(rspf_uint32 count)
+      : m_mutex(), m_block(), m_count(count)
+   {
+      m_block.reset();
+   }
+   void jobFinished()
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      if ( m_count )
+      {
+         --m_count;
+         if ( m_count == 0 )
+         {
+            m_block.release();
+         }
+      }
+   }
+   void wait()
+   {
+      m_block.block();
+   }
+private:
+   OpenThreads::Mutex m_mutex;
+   OpenThreads::Block m_block;
+   rspf_uint32        m_count;
+};
+
+template <class T>
+class rspfFftJob : public rspfJob
+{
+public:
+   rspfFftJob(const rspfFftEngine::Plan* plan,
+              bool inverse,
+              T* in,
+              T* out,
+              rspfFftBatch* batch)
+      : rspfJob(),
+        m_plan(plan),
+        m_inverse(inverse),
+        m_in(in),
+        m_out(out),
+        m_batch(batch)
+   {
+   }
+   virtual void start()
+   {
+      running();
+      if ( m_inverse )
+      {
+         m_plan->inverse( m_in, m_out );
+      }
+      else
+      {
+         m_plan->forward( m_in, m_out );
+      }
+      m_batch->jobFinished();
+      finished();
+   }
+private:
+   rspfRefPtr<const rspfFftEngine::Plan> m_plan;
+   bool                                  m_inverse;
+   T*                                    m_in;
+   T*                                    m_out;
+   rspfRefPtr<rspfFftBatch>              m_batch;
+};
+
+//---
+// rspfFftEngine::Plan
+//---
+rspfFftEngine::Plan::Plan(rspf_uint32 rows, rspf_uint32 cols)
+   : rspfReferenced(),
+     m_rows(rows),
+     m_cols(cols)
+{
+}
+
+rspfFftEngine::Plan::~Plan()
+{
+}
+
+rspf_uint32 rspfFftEngine::Plan::getRows() const
+{
+   return m_rows;
+}
+
+rspf_uint32 rspfFftEngine::Plan::getCols() const
+{
+   return m_cols;
+}
+
+rspf_uint32 rspfFftEngine::Plan::getComplexCols() const
+{
+   return m_cols / 2 + 1;
+}
+
+rspf_uint32 rspfFftEngine::Plan::getRealSize() const
+{
+   return m_rows * m_cols;
+}
+
+rspf_uint32 rspfFftEngine::Plan::getComplexSize() const
+{
+   return m_rows * getComplexCols() * 2;
+}
+
+//---
+// rspfFftEngine::Backend
+//---
+rspfFftEngine::Backend::~Backend()
+{
+}
+
+std::string rspfFftEngine::Backend::exportWisdom() const
+{
+   return std::string();
+}
+
+bool rspfFftEngine::Backend::importWisdom(const std::string& /* wisdom */)
+{
+   return false;
+}
+
+//---
+// rspfFftEngine
+//---
+rspfFftEngine::rspfFftEngine()
+   : m_backends(),
+     m_backend(0),
+     m_preferredBackend(),
+     m_planMap(),
+     m_jobQueue(0),
+     m_numberOfThreads(0),
+     m_mutex()
+{
+   const char* lookup = rspfPreferences::instance()->findPreference("fft_backend");
+   if ( lookup )
+   {
+      m_preferredBackend = rspfString(lookup).trim().downcase();
+   }
+   registerBackend( new rspfFftBuiltinBackend() );
+}
+
+rspfFftEngine::~rspfFftEngine()
+{
+   m_jobQueue = 0;
+   m_planMap.clear();
+   m_backend = 0;
+   m_backends.clear();
+}
+
+rspfFftEngine* rspfFftEngine::instance()
+{
+   static OpenThreads::Mutex instanceMutex;
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(instanceMutex);
+   if ( !m_instance )
+   {
+      m_instance = new rspfFftEngine();
+   }
+   return m_instance;
+}
+
+void rspfFftEngine::registerBackend(Backend* backend)
+{
+   if ( !backend )
+   {
+      return;
+   }
+
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   std::vector< rspfRefPtr<Backend> >::const_iterator i = m_backends.begin();
+   while ( i != m_backends.end() )
+   {
+      if ( (*i).get() == backend )
+      {
+         return;
+      }
+      ++i;
+   }
+   m_backends.push_back(backend);
+
+   const rspfString NAME = backend->getName();
+   if ( !m_backend.valid() || m_preferredBackend.empty() ||
+        (NAME == m_preferredBackend) ||
+        (m_backend->getName() != m_preferredBackend) )
+   {
+      m_backend = backend;
+      m_planMap.clear();
+   }
+
+   if ( traceDebug() )
+   {
+      rspfNotify(rspfNotifyLevel_DEBUG)
+         << "rspfFftEngine::registerBackend DEBUG: registered " << NAME
+         << ", current " << m_backend->getName() << "\n";
+   }
+}
+
+void rspfFftEngine::unregisterBackend(Backend* backend)
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   std::vector< rspfRefPtr<Backend> >::iterator i = m_backends.begin();
+   while ( i != m_backends.end() )
+   {
+      if ( (*i).get() == backend )
+      {
+         m_backends.erase(i);
+         if ( m_backend.get() == backend )
+         {
+            m_backend = m_backends.size() ? m_backends.back().get() : 0;
+            m_planMap.clear();
+         }
+         break;
+      }
+      ++i;
+   }
+}
+
+bool rspfFftEngine::setBackend(const rspfString& name)
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   std::vector< rspfRefPtr<Backend> >::const_iterator i = m_backends.begin();
+   while ( i != m_backends.end() )
+   {
+      if ( (*i)->getName() == name )
+      {
+         if ( m_backend != (*i) )
+         {
+            m_backend = (*i);
+            m_planMap.clear();
+         }
+         return true;
+      }
+      ++i;
+   }
+   return false;
+}
+
+rspfString rspfFftEngine::getBackendName() const
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   return m_backend.valid() ? m_backend->getName() : rspfString();
+}
+
+void rspfFftEngine::getBackendNames(std::vector<rspfString>& names) const
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   names.clear();
+   std::vector< rspfRefPtr<Backend> >::const_iterator i = m_backends.begin();
+   while ( i != m_backends.end() )
+   {
+      names.push_back( (*i)->getName() );
+      ++i;
+   }
+}
+
+rspfRefPtr<rspfFftEngine::Plan> rspfFftEngine::getPlan(rspf_uint32 rows,
+                                                       rspf_uint32 cols)
+{
+   rspfRefPtr<Plan> result = 0;
+   if ( rows && cols )
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      const PlanKey KEY(rows, cols);
+      std::map< PlanKey, rspfRefPtr<Plan> >::const_iterator i = m_planMap.find(KEY);
+      if ( i != m_planMap.end() )
+      {
+         result = (*i).second;
+      }
+      else if ( m_backend.valid() )
+      {
+         result = m_backend->createPlan(rows, cols);
+         if ( result.valid() )
+         {
+            m_planMap[KEY] = result;
+         }
+         else
+         {
+            rspfNotify(rspfNotifyLevel_WARN)
+               << "rspfFftEngine::getPlan WARNING: " << m_backend->getName()
+               << " backend failed to create a " << rows << "x" << cols
+               << " plan.\n";
+         }
+      }
+   }
+   return result;
+}
+
+void rspfFftEngine::forward(const Plan* plan, rspf_uint32 count,
+                            const rspf_float64* const* in,
+                            rspf_float64* const* out)
+{
+   runBatch( plan, count, false, const_cast<rspf_float64* const*>(in), out );
+}
+
+void rspfFftEngine::forward(const Plan* plan, rspf_uint32 count,
+                            const rspf_float32* const* in,
+                            rspf_float32* const* out)
+{
+   runBatch( plan, count, false, const_cast<rspf_float32* const*>(in), out );
+}
+
+void rspfFftEngine::inverse(const Plan* plan, rspf_uint32 count,
+                            rspf_float64* const* in,
+                            rspf_float64* const* out)
+{
+   runBatch( plan, count, true, in, out );
+}
+
+void rspfFftEngine::inverse(const Plan* plan, rspf_uint32 count,
+                            rspf_float32* const* in,
+                            rspf_float32* const* out)
+{
+   runBatch( plan, count, true, in, out );
+}
+
+template <class T>
+void rspfFftEngine::runBatch(const Plan* plan, rspf_uint32 count, bool inverse,
+                             T* const* in, T* const* out)
+{
+   if ( !plan || !count )
+   {
+      return;
+   }
+
+   rspfRefPtr<rspfJobQueue> queue = 0;
+   if ( count > 1 )
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      const rspf_uint32 THREADS =
+         m_numberOfThreads ? m_numberOfThreads : rspf::getNumberOfThreads();
+      if ( THREADS > 1 )
+      {
+         if ( !m_jobQueue.valid() )
+         {
+            m_jobQueue = new rspfJobMultiThreadQueue( new rspfJobQueue(), THREADS );
+         }
+         queue = m_jobQueue->getJobQueue();
+      }
+   }
+
+   rspf_uint32 idx;
+   if ( !queue.valid() )
+   {
+      // One transform or one thread; not worth the hand off.
+      for ( idx = 0; idx < count; ++idx )
+      {
+         if ( inverse )
+         {
+            plan->inverse( in[idx], out[idx] );
+         }
+         else
+         {
+            plan->forward( in[idx], out[idx] );
+         }
+      }
+   }
+   else
+   {
+      rspfRefPtr<rspfFftBatch> batch = new rspfFftBatch(count);
+      for ( idx = 0; idx < count; ++idx )
+      {
+         rspfRefPtr<rspfJob> job =
+            new rspfFftJob<T>( plan, inverse, in[idx], out[idx], batch.get() );
+         job->ready();
+         queue->add( job.get(), false );
+      }
+      batch->wait();
+   }
+}
+
+std::string rspfFftEngine::exportWisdom() const
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   return m_backend.valid() ? m_backend->exportWisdom() : std::string();
+}
+
+bool rspfFftEngine::importWisdom(const std::string& wisdom)
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   return m_backend.valid() ? m_backend->importWisdom(wisdom) : false;
+}
+
+void rspfFftEngine::setNumberOfThreads(rspf_uint32 nThreads)
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   m_numberOfThreads = nThreads;
+   if ( m_jobQueue.valid() )
+   {
+      m_jobQueue->setNumberOfThreads( nThreads ? nThreads : rspf::getNumberOfThreads() );
+   }
+}
+
+void rspfFftEngine::flush()
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   m_planMap.clear();
+}
@@ -12,8 +12,6 @@
 
 #include <rspf/imaging/rspfFftFilter.h>
 #include <rspf/imaging/rspfImageDataFactory.h>
-#include <rspf/matrix/newmat.h>
-#include <rspf/matrix/newmatap.h>
 #include <rspf/imaging/rspfScalarRemapper.h>
 #include <rspf/base/rspfStringProperty.h>
 
@@ -23,7 +21,10 @@ rspfFftFilter::rspfFftFilter(rspfObject* owner)
    :rspfImageSourceFilter(owner),
     theTile(0),
     theDirectionType(rspfFftFilterDirectionType_FORWARD),
-    theScalarRemapper(new rspfScalarRemapper())
+    theScalarRemapper(new rspfScalarRemapper()),
+    thePlan(0),
+    theRealBuffer(),
+    theComplexBuffer()
 {
    theScalarRemapper->setOutputScalarType(RSPF_DOUBLE);
 }
@@ -32,7 +33,10 @@ rspfFftFilter::rspfFftFilter(rspfImageSource* inputSource)
    :rspfImageSourceFilter(inputSource),
     theTile(0),
     theDirectionType(rspfFftFilterDirectionType_FORWARD),
-    theScalarRemapper(new rspfScalarRemapper())
+    theScalarRemapper(new rspfScalarRemapper()),
+    thePlan(0),
+    theRealBuffer(),
+    theComplexBuffer()
 {
    theScalarRemapper->setOutputScalarType(RSPF_DOUBLE);
 }
@@ -42,7 +46,10 @@ rspfFftFilter::rspfFftFilter(rspfObject* owner,
    :rspfImageSourceFilter(owner, inputSource),
     theTile(0),
     theDirectionType(rspfFftFilterDirectionType_FORWARD),
-    theScalarRemapper(new rspfScalarRemapper())
+    theScalarRemapper(new rspfScalarRemapper()),
+    thePlan(0),
+    theRealBuffer(),
+    theComplexBuffer()
 {
    theScalarRemapper->setOutputScalarType(RSPF_DOUBLE);
 }
@@ -307,142 +314,189 @@ void rspfFftFilter::runFft(T /* dummy */,
                             rspfRefPtr<rspfImageData>& input,
                             rspfRefPtr<rspfImageData>& output)
 {
-   // T*             inputBand  = 0;
-
-   NEWMAT::Matrix* realIn = new NEWMAT::Matrix(input->getHeight(),
-                                               input->getWidth());
-   NEWMAT::Matrix* imgIn = new NEWMAT::Matrix(input->getHeight(),
-                                              input->getWidth());
-   NEWMAT::Matrix* realOut = new NEWMAT::Matrix(input->getHeight(),
-                                                input->getWidth());
-   NEWMAT::Matrix* imgOut = new NEWMAT::Matrix(input->getHeight(),
-                                               input->getWidth());
+   const rspf_uint32 w = input->getWidth();
+   const rspf_uint32 h = input->getHeight();
+
+   if(!thePlan.valid()||
+      (thePlan->getCols() != w)||
+      (thePlan->getRows() != h))
+   {
+      thePlan = rspfFftEngine::instance()->getPlan(h, w);
+      if(!thePlan.valid())
+      {
+         return;
+      }
+   }
+
+   const rspf_uint32 realSize    = thePlan->getRealSize();
+   const rspf_uint32 complexSize = thePlan->getComplexSize();
+   const rspf_uint32 cw          = thePlan->getComplexCols();
+   const rspf_uint32 bands       = input->getNumberOfBands();
    rspf_uint32 bandIdx = 0;
-   rspf_uint32 w = input->getWidth();
-   rspf_uint32 h = input->getHeight();
    rspf_uint32 x = 0;
    rspf_uint32 y = 0;
+
+   if(theRealBuffer.size() < bands*realSize)
+   {
+      theRealBuffer.resize(bands*realSize);
+   }
+   if(theComplexBuffer.size() < bands*complexSize)
+   {
+      theComplexBuffer.resize(bands*complexSize);
+   }
+   std::vector<rspf_float64*> realBufs;
+   std::vector<rspf_float64*> complexBufs;
+   std::vector<rspf_uint32>   outputBands;
+
    if(theDirectionType == rspfFftFilterDirectionType_FORWARD)
    {
-      rspf_uint32 bands = input->getNumberOfBands();
       for(bandIdx = 0; bandIdx < bands; ++bandIdx)
       {
-         rspf_float64* bandReal = 0;
-         rspf_float64* bandImg  = 0;
-         fillMatrixForward((T*)input->getBuf(bandIdx),
-                           (T)input->getNullPix(bandIdx),
-                           *realIn,
-                           *imgIn);
-         NEWMAT::FFT2(*realIn, *imgIn, *realOut, *imgOut);
-         bandReal = (rspf_float64*)output->getBuf(2*bandIdx);
-         bandImg  = (rspf_float64*)output->getBuf(2*bandIdx + 1);
-         if(bandReal&&bandImg)
+         if(output->getBuf(2*bandIdx) && output->getBuf(2*bandIdx + 1))
          {
-            for(y = 0; y < h; ++y)
+            rspf_float64* real = &theRealBuffer[bandIdx*realSize];
+            fillForward((const T*)input->getBuf(bandIdx),
+                        (T)input->getNullPix(bandIdx),
+                        real,
+                        realSize);
+            realBufs.push_back(real);
+            complexBufs.push_back(&theComplexBuffer[bandIdx*complexSize]);
+            outputBands.push_back(bandIdx);
+         }
+      }
+      if(realBufs.empty())
+      {
+         return;
+      }
+
+      rspfFftEngine::instance()->forward(thePlan.get(),
+                                          (rspf_uint32)realBufs.size(),
+                                          &realBufs.front(),
+                                          &complexBufs.front());
+
+      // Expand the half spectrum using F(u,v) = conj(F(-u,-v)).
+      for(bandIdx = 0; bandIdx < outputBands.size(); ++bandIdx)
+      {
+         const rspf_float64* spectrum = complexBufs[bandIdx];
+         rspf_float64* bandReal =
+            (rspf_float64*)output->getBuf(2*outputBands[bandIdx]);
+         rspf_float64* bandImg  =
+            (rspf_float64*)output->getBuf(2*outputBands[bandIdx] + 1);
+         for(y = 0; y < h; ++y)
+         {
+            const rspf_float64* row     = spectrum + 2*y*cw;
+            const rspf_float64* mirror  = spectrum + 2*((h - y)%h)*cw;
+            for(x = 0; x < cw; ++x)
             {
-               for(x = 0; x < w; ++x)
-               {
-                  *bandReal = (rspf_float64)((*realOut)[y][x]);
-                  *bandImg  = (rspf_float64)((*imgOut)[y][x]);
-                  ++bandReal;
-                  ++bandImg;
-               }
+               *bandReal = row[2*x];
+               *bandImg  = row[2*x + 1];
+               ++bandReal;
+               ++bandImg;
+            }
+            for(; x < w; ++x)
+            {
+               *bandReal = mirror[2*(w - x)];
+               *bandImg  = -mirror[2*(w - x) + 1];
+               ++bandReal;
+               ++bandImg;
             }
          }
       }
    }
    else
    {
-      rspf_float64* bandReal = 0;
-      rspf_uint32 bands = input->getNumberOfBands();
-      for(bandIdx = 0; bandIdx < bands; bandIdx+=2)
+      for(bandIdx = 0; (bandIdx + 1) < bands; bandIdx+=2)
       {
-         bandReal = (rspf_float64*)output->getBuf(bandIdx/2);
          if(input->getBuf(bandIdx)&&
-            input->getBuf(bandIdx+1))
+            input->getBuf(bandIdx+1)&&
+            output->getBuf(bandIdx/2))
          {
-            fillMatrixInverse((T*)input->getBuf(bandIdx),
-                              (T*)input->getBuf(bandIdx+1),
-                              *realIn,
-                              *imgIn);
-            NEWMAT::FFT2I(*realIn, *imgIn, *realOut, *imgOut);
-            for(y = 0; y < h; ++y)
+            rspf_float64* spectrum = &theComplexBuffer[(bandIdx/2)*complexSize];
+            fillInverse((const T*)input->getBuf(bandIdx),
+                        (const T*)input->getBuf(bandIdx+1),
+                        spectrum,
+                        w,
+                        h);
+            complexBufs.push_back(spectrum);
+            realBufs.push_back(&theRealBuffer[(bandIdx/2)*realSize]);
+            outputBands.push_back(bandIdx/2);
+         }
+      }
+      if(realBufs.empty())
+      {
+         return;
+      }
+
+      rspfFftEngine::instance()->inverse(thePlan.get(),
+                                          (rspf_uint32)realBufs.size(),
+                                          &complexBufs.front(),
+                                          &realBufs.front());
+
+      const rspf_float64 scale = 1.0/((rspf_float64)realSize);
+      for(bandIdx = 0; bandIdx < outputBands.size(); ++bandIdx)
+      {
+         const rspf_float64* real = realBufs[bandIdx];
+         rspf_float64* bandReal = (rspf_float64*)output->getBuf(outputBands[bandIdx]);
+         for(x = 0; x < realSize; ++x)
+         {
+            rspf_float64 value = real[x]*scale;
+            if(value > 1.0)
+            {
+               value = 1.0;
+            }
+            if(value < 0.0)
             {
-               for(x = 0; x < w; ++x)
-               {
-                  *bandReal = (rspf_float64)((*realOut)[y][x]);
-                  if(*bandReal > 1.0)
-                  {
-                     *bandReal = 1.0;
-               }
-                  if(*bandReal < 0.0)
-                  {
-                     *bandReal = 0.0;
-                  }
-                  ++bandReal;
-               }
+               value = 0.0;
             }
+            bandReal[x] = value;
          }
       }
    }
-   
-   delete realIn;
-   delete imgIn;
-   delete realOut;
-   delete imgOut;
 }
 
 template <class T>
-void rspfFftFilter::fillMatrixForward(T *realPart,
-                                       T nullPix,
-                                       NEWMAT::Matrix& real,
-                                       NEWMAT::Matrix& img)const
+void rspfFftFilter::fillForward(const T* band,
+                                 T nullPix,
+                                 rspf_float64* real,
+                                 rspf_uint32 size)const
 {
-   rspf_uint32 w = real.Ncols();
-   rspf_uint32 h = real.Nrows();
-   rspf_uint32 yIdx = 0;
-   rspf_uint32 xIdx = 0;
-   
-   for(yIdx = 0; yIdx < h; ++yIdx)
+   for(rspf_uint32 idx = 0; idx < size; ++idx)
    {
-      for(xIdx = 0; xIdx < w; ++xIdx)
+      if(band[idx] != nullPix)
       {
-         if((double)(*realPart) != nullPix)
-         {
-            real[yIdx][xIdx] = (double)(*realPart);
-         }
-         else
-         {
-            real[yIdx][xIdx] = 0.0;
-         }
-         
-         img[yIdx][xIdx]  = 0.0;
-         
-         ++realPart;
+         real[idx] = (rspf_float64)band[idx];
+      }
+      else
+      {
+         real[idx] = 0.0;
       }
    }
 }
 
 template <class T>
-void rspfFftFilter::fillMatrixInverse(T *realPart,
-                                       T *imgPart,
-                                       NEWMAT::Matrix& real,
-                                       NEWMAT::Matrix& img)const
+void rspfFftFilter::fillInverse(const T* realPart,
+                                 const T* imgPart,
+                                 rspf_float64* spectrum,
+                                 rspf_uint32 w,
+                                 rspf_uint32 h)const
 {
-   rspf_uint32 w = real.Ncols();
-   rspf_uint32 h = real.Nrows();
+   const rspf_uint32 cw = w/2 + 1;
    rspf_uint32 yIdx = 0;
    rspf_uint32 xIdx = 0;
-   
+
    for(yIdx = 0; yIdx < h; ++yIdx)
    {
-      for(xIdx = 0; xIdx < w; ++xIdx)
+      const rspf_uint32 row    = yIdx*w;
+      const rspf_uint32 mirror = ((h - yIdx)%h)*w;
+      for(xIdx = 0; xIdx < cw; ++xIdx)
       {
-         real[yIdx][xIdx] = (double)(*realPart);
-         img[yIdx][xIdx]  = (double)(*imgPart);
-         
-         ++realPart;
-         ++imgPart;
+         const rspf_uint32 mirrorIdx = mirror + (w - xIdx)%w;
+         *spectrum = 0.5*((rspf_float64)realPart[row + xIdx] +
+                          (rspf_float64)realPart[mirrorIdx]);
+         ++spectrum;
+         *spectrum = 0.5*((rspf_float64)imgPart[row + xIdx] -
+                          (rspf_float64)imgPart[mirrorIdx]);
+         ++spectrum;
       }
    }
 }
@@ -0,0 +1,635 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfFusedRemapper.cpp
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:
+//
+// Table lookup replacement for a run of point filters in an rspfImageChain.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#include <rspf/imaging/rspfFusedRemapper.h>
+#include <rspf/base/rspfCommon.h>
+#include <rspf/base/rspfKeywordlist.h>
+#include <rspf/base/rspfNotify.h>
+#include <rspf/base/rspfObjectFactoryRegistry.h>
+#include <rspf/base/rspfTrace.h>
+#include <rspf/imaging/rspfBrightnessContrastSource.h>
+#include <rspf/imaging/rspfHistogramRemapper.h>
+#include <rspf/imaging/rspfImageChain.h>
+#include <rspf/imaging/rspfImageDataFactory.h>
+#include <rspf/imaging/rspfImageSourceFilter.h>
+#include <rspf/imaging/rspfMemoryImageSource.h>
+
+#include <cstring>
+
+static rspfTrace traceDebug(rspfString("rspfFusedRemapper:debug"));
+
+RTTI_DEF1(rspfFusedRemapper, "rspfFusedRemapper", rspfImageSource)
+
+rspfFusedRemapper::rspfFusedRemapper(rspfImageChain* chain)
+   : rspfImageSource(0, 0, 0, true, false),
+     m_chain(chain),
+     m_consumer(0),
+     m_index(0),
+     m_chainSize(0),
+     m_run(0),
+     m_enabled(0),
+     m_stateCounters(0),
+     m_input(0),
+     m_inputScalarType(RSPF_SCALAR_UNKNOWN),
+     m_outputScalarType(RSPF_SCALAR_UNKNOWN),
+     m_bands(0),
+     m_tableSize(0),
+     m_tables(0),
+     m_tile(0)
+{
+}
+
+rspfFusedRemapper::~rspfFusedRemapper()
+{
+}
+
+bool rspfFusedRemapper::isPointFilter(const rspfConnectableObject* source)
+{
+   bool result = false;
+   const rspfImageSource* is = dynamic_cast<const rspfImageSource*>(source);
+   if ( is && (is->getNumberOfInputs() == 1) )
+   {
+      // Exact class names; derived classes may add neighborhood operations.
+      rspfString name = is->getClassName();
+      if ( is->isSourceEnabled() == false )
+      {
+         result = ( name == "rspfScalarRemapper" ) ||
+                  ( name == "rspfHistogramRemapper" ) ||
+                  ( name == "rspfTableRemapper" ) ||
+                  ( name == "rspfGammaRemapper" ) ||
+                  ( name == "rspfBrightnessContrastSource" ) ||
+                  ( name == "rspfBandSelector" );
+      }
+      else if ( ( name == "rspfScalarRemapper" ) ||
+                ( name == "rspfTableRemapper" ) ||
+                ( name == "rspfGammaRemapper" ) )
+      {
+         result = true;
+      }
+      else if ( name == "rspfHistogramRemapper" )
+      {
+         // Not if fed by a histogram source on the second input.
+         result = ( is->getInput(1) == 0 );
+      }
+      else if ( name == "rspfBrightnessContrastSource" )
+      {
+         // Three bands are adjusted together in HSI space unless bypassed.
+         const rspfBrightnessContrastSource* bc =
+            static_cast<const rspfBrightnessContrastSource*>(is);
+         result = ( bc->getNumberOfOutputBands() != 3 ) ||
+                  ( ( bc->getBrightness() == 0.0 ) && ( bc->getContrast() == 1.0 ) );
+      }
+      else if ( name == "rspfBandSelector" )
+      {
+         // Only when the selection is already done upstream(image handler).
+         const rspfImageSource* input =
+            dynamic_cast<const rspfImageSource*>( is->getInput(0) );
+         if ( input )
+         {
+            std::vector<rspf_uint32> outputBands;
+            std::vector<rspf_uint32> inputBands;
+            is->getOutputBandList(outputBands);
+            input->getOutputBandList(inputBands);
+            result = ( outputBands == inputBands );
+         }
+      }
+   }
+   return result;
+}
+
+bool rspfFusedRemapper::initialize(rspf_uint32 index,
+                                   rspf_uint32 count,
+                                   rspfImageSourceFilter* consumer)
+{
+   static const char MODULE[] = "rspfFusedRemapper::initialize";
+
+   m_consumer = consumer;
+   m_index    = index;
+   m_run.clear();
+   m_enabled.clear();
+   m_tables.clear();
+   m_input    = 0;
+   m_tile     = 0;
+
+   if ( !m_chain )
+   {
+      return false;
+   }
+
+   rspfConnectableObject::ConnectableObjectList& chainList =
+      m_chain->getChainList();
+   m_chainSize = static_cast<rspf_uint32>( chainList.size() );
+   if ( !count || ( index + count >= m_chainSize ) )
+   {
+      return false;
+   }
+
+   for ( rspf_uint32 i = index; i < index + count; ++i )
+   {
+      rspfImageSource* source = dynamic_cast<rspfImageSource*>( chainList[i].get() );
+      if ( !source )
+      {
+         return false;
+      }
+      m_run.push_back( source );
+      m_enabled.push_back( source->isSourceEnabled() );
+   }
+   recordStateCounters();
+   m_input = dynamic_cast<rspfImageSource*>( chainList[index + count].get() );
+   if ( !m_input )
+   {
+      m_run.clear();
+      m_enabled.clear();
+      return false;
+   }
+
+   bool result = buildTables();
+   if ( !result )
+   {
+      m_run.clear();
+      m_enabled.clear();
+      m_input = 0;
+   }
+
+   if ( traceDebug() )
+   {
+      rspfNotify(rspfNotifyLevel_DEBUG)
+         << MODULE << " DEBUG:"
+         << "\nchain index: " << index
+         << "\nfilters:     " << count
+         << "\nfused:       " << (result ? "true" : "false") << "\n";
+   }
+
+   return result;
+}
+
+void rspfFusedRemapper::initialize()
+{
+}
+
+bool rspfFusedRemapper::canConnectMyInputTo(rspf_int32 /* inputIndex */,
+                                            const rspfConnectableObject* /* object */) const
+{
+   return false;
+}
+
+bool rspfFusedRemapper::buildTables()
+{
+   m_inputScalarType  = m_input->getOutputScalarType();
+   m_outputScalarType = m_run[0]->getOutputScalarType();
+   m_bands            = m_input->getNumberOfOutputBands();
+
+   switch ( m_inputScalarType )
+   {
+      case RSPF_UINT8:
+         m_tableSize = 256;
+         break;
+      case RSPF_USHORT11:
+         m_tableSize = 2048;
+         break;
+      case RSPF_UINT16:
+         m_tableSize = 65536;
+         break;
+      default:
+         return false;
+   }
+
+   switch ( m_outputScalarType )
+   {
+      case RSPF_UINT8:
+      case RSPF_USHORT11:
+      case RSPF_UINT16:
+      case RSPF_SINT16:
+      case RSPF_FLOAT32:
+      case RSPF_NORMALIZED_FLOAT:
+      case RSPF_FLOAT64:
+      case RSPF_NORMALIZED_DOUBLE:
+         break;
+      default:
+         return false;
+   }
+
+   if ( !m_bands || ( m_run[0]->getNumberOfOutputBands() != m_bands ) )
+   {
+      return false;
+   }
+
+   //---
+   // Probe tile: 256 wide, every possible input value once per band.  Null,
+   // min and max are the real input's so the filters treat nulls the same.
+   //---
+   const rspf_uint32 w = 256;
+   const rspf_uint32 h = m_tableSize / w;
+   rspfRefPtr<rspfImageData> probe =
+      new rspfImageData(0, m_inputScalarType, m_bands, w, h);
+   probe->initialize();
+   for ( rspf_uint32 band = 0; band < m_bands; ++band )
+   {
+      probe->setNullPix( m_input->getNullPixelValue(band), band );
+      probe->setMinPix( m_input->getMinPixelValue(band), band );
+      probe->setMaxPix( m_input->getMaxPixelValue(band), band );
+      if ( m_inputScalarType == RSPF_UINT8 )
+      {
+         rspf_uint8* buf = static_cast<rspf_uint8*>( probe->getBuf(band) );
+         for ( rspf_uint32 i = 0; i < m_tableSize; ++i )
+         {
+            buf[i] = static_cast<rspf_uint8>(i);
+         }
+      }
+      else
+      {
+         rspf_uint16* buf = static_cast<rspf_uint16*>( probe->getBuf(band) );
+         for ( rspf_uint32 i = 0; i < m_tableSize; ++i )
+         {
+            buf[i] = static_cast<rspf_uint16>(i);
+         }
+      }
+   }
+   probe->setImageRectangle( rspfIrect(0, 0, w-1, h-1) );
+   probe->validate();
+
+   rspfRefPtr<rspfMemoryImageSource> memorySource = new rspfMemoryImageSource();
+   memorySource->setImage( probe );
+   memorySource->initialize();
+
+   //---
+   // Clone the run, input side first.  Disabled filters and pass through band
+   // selectors are identities so are left out.
+   //---
+   std::vector< rspfRefPtr<rspfImageSource> > clones;
+   rspfImageSource* last = memorySource.get();
+   bool status = true;
+   rspf_int32 i = static_cast<rspf_int32>( m_run.size() ) - 1;
+   for ( ; i >= 0; --i )
+   {
+      rspfImageSource* source = m_run[i];
+      if ( !source->isSourceEnabled() ||
+           ( source->getClassName() == "rspfBandSelector" ) )
+      {
+         continue;
+      }
+
+      rspfKeywordlist kwl;
+      source->saveState(kwl);
+      rspfRefPtr<rspfObject> obj =
+         rspfObjectFactoryRegistry::instance()->createObject(kwl);
+      rspfImageSource* clone = dynamic_cast<rspfImageSource*>( obj.get() );
+      if ( !clone )
+      {
+         status = false;
+         break;
+      }
+      clone->disconnectAllInputs();
+      clone->connectMyInputTo( 0, last );
+      clone->initialize();
+      clones.push_back( clone );
+      last = clone;
+   }
+
+   if ( status && clones.size() )
+   {
+      rspfRefPtr<rspfImageData> probeResult = last->getTile( probe->getImageRectangle(), 0 );
+      if ( probeResult.valid() &&
+           ( probeResult->getDataObjectStatus() != RSPF_NULL ) &&
+           ( probeResult->getScalarType() == m_outputScalarType ) &&
+           ( probeResult->getNumberOfBands() == m_bands ) &&
+           ( probeResult->getImageRectangle() == probe->getImageRectangle() ) )
+      {
+         m_tables.resize( m_bands );
+         switch ( m_outputScalarType )
+         {
+            case RSPF_UINT8:
+               fillTables( rspf_uint8(0), probeResult.get() );
+               break;
+            case RSPF_USHORT11:
+            case RSPF_UINT16:
+               fillTables( rspf_uint16(0), probeResult.get() );
+               break;
+            case RSPF_SINT16:
+               fillTables( rspf_sint16(0), probeResult.get() );
+               break;
+            case RSPF_FLOAT32:
+            case RSPF_NORMALIZED_FLOAT:
+               fillTables( rspf_float32(0), probeResult.get() );
+               break;
+            default:
+               fillTables( rspf_float64(0), probeResult.get() );
+               break;
+         }
+      }
+      else
+      {
+         status = false;
+      }
+   }
+   else
+   {
+      // Nothing but identities; nothing to gain.
+      status = false;
+   }
+
+   // Break the clone connections so the clones are released.
+   std::vector< rspfRefPtr<rspfImageSource> >::iterator ci = clones.begin();
+   while ( ci != clones.end() )
+   {
+      (*ci)->disconnect();
+      ++ci;
+   }
+   memorySource->disconnect();
+
+   return status;
+}
+
+template <class OutType>
+void rspfFusedRemapper::fillTables(OutType /* dummy */, const rspfImageData* probeResult)
+{
+   const rspf_uint32 bytes = m_tableSize * sizeof(OutType);
+   for ( rspf_uint32 band = 0; band < m_bands; ++band )
+   {
+      m_tables[band].resize( bytes );
+      std::memcpy( &(m_tables[band].front()), probeResult->getBuf(band), bytes );
+   }
+}
+
+bool rspfFusedRemapper::isValid() const
+{
+   bool result = false;
+   if ( m_chain && m_input && m_run.size() )
+   {
+      // Compare pointers before touching anything; the run may be gone.
+      const rspfConnectableObject::ConnectableObjectList& chainList =
+         m_chain->getChainList();
+      const rspf_uint32 count = static_cast<rspf_uint32>( m_run.size() );
+      if ( ( chainList.size() == m_chainSize ) &&
+           ( chainList[m_index + count].get() == m_input ) )
+      {
+         result = true;
+         for ( rspf_uint32 i = 0; i < count; ++i )
+         {
+            if ( ( chainList[m_index + i].get() != m_run[i] ) ||
+                 ( m_run[i]->isSourceEnabled() != m_enabled[i] ) )
+            {
+               result = false;
+               break;
+            }
+         }
+      }
+   }
+   return result;
+}
+
+bool rspfFusedRemapper::isCurrent() const
+{
+   for ( rspf_uint32 i = 0; i < m_run.size(); ++i )
+   {
+      const rspfImageSourceFilter* filter =
+         dynamic_cast<const rspfImageSourceFilter*>( m_run[i] );
+      if ( filter && ( filter->getStateCounter() != m_stateCounters[i] ) )
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+bool rspfFusedRemapper::isPointFilterRun() const
+{
+   for ( rspf_uint32 i = 0; i < m_run.size(); ++i )
+   {
+      if ( !isPointFilter( m_run[i] ) )
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+void rspfFusedRemapper::recordStateCounters()
+{
+   m_stateCounters.resize( m_run.size() );
+   for ( rspf_uint32 i = 0; i < m_run.size(); ++i )
+   {
+      const rspfImageSourceFilter* filter =
+         dynamic_cast<const rspfImageSourceFilter*>( m_run[i] );
+      m_stateCounters[i] = filter ? filter->getStateCounter() : 0;
+   }
+}
+
+rspfRefPtr<rspfImageData> rspfFusedRemapper::getTile(const rspfIrect& tileRect,
+                                                     rspf_uint32 resLevel)
+{
+   if ( !isValid() )
+   {
+      return ( m_run.size() && m_chain &&
+               ( m_chain->indexOf( m_run[0] ) >= 0 ) ) ?
+         m_run[0]->getTile( tileRect, resLevel ) : rspfRefPtr<rspfImageData>();
+   }
+
+   if ( !isCurrent() )
+   {
+      //---
+      // A filter setting or input changed; a filter may no longer be a point
+      // filter (e.g. three band brightness/contrast off identity).  Rebuild
+      // only if all still are, else the run is used unfused.
+      //---
+      recordStateCounters();
+      m_tables.clear();
+      m_tile = 0;
+      if ( isPointFilterRun() && !buildTables() )
+      {
+         m_tables.clear();
+      }
+   }
+   if ( m_tables.empty() )
+   {
+      return m_run[0]->getTile( tileRect, resLevel );
+   }
+
+   rspfRefPtr<rspfImageData> inputTile = m_input->getTile( tileRect, resLevel );
+   if ( !inputTile.valid() ||
+        ( inputTile->getDataObjectStatus() == RSPF_NULL ) ||
+        ( inputTile->getDataObjectStatus() == RSPF_EMPTY ) ||
+        ( inputTile->getScalarType() != m_inputScalarType ) ||
+        ( inputTile->getNumberOfBands() != m_bands ) )
+   {
+      // Let the filters handle it exactly as they would have.
+      return m_run[0]->getTile( tileRect, resLevel );
+   }
+
+   if ( !m_tile.valid() )
+   {
+      m_tile = rspfImageDataFactory::instance()->create( this, this );
+      m_tile->initialize();
+   }
+   m_tile->setImageRectangle( tileRect );
+   if ( inputTile->getSizePerBand() != m_tile->getSizePerBand() )
+   {
+      return m_run[0]->getTile( tileRect, resLevel );
+   }
+
+   if ( m_inputScalarType == RSPF_UINT8 )
+   {
+      remap( rspf_uint8(0), inputTile.get() );
+   }
+   else
+   {
+      remap( rspf_uint16(0), inputTile.get() );
+   }
+   m_tile->validate();
+
+   return m_tile;
+}
+
+template <class InType>
+void rspfFusedRemapper::remap(InType dummy, const rspfImageData* inputTile)
+{
+   switch ( m_outputScalarType )
+   {
+      case RSPF_UINT8:
+         remap( dummy, rspf_uint8(0), inputTile );
+         break;
+      case RSPF_USHORT11:
+      case RSPF_UINT16:
+         remap( dummy, rspf_uint16(0), inputTile );
+         break;
+      case RSPF_SINT16:
+         remap( dummy, rspf_sint16(0), inputTile );
+         break;
+      case RSPF_FLOAT32:
+      case RSPF_NORMALIZED_FLOAT:
+         remap( dummy, rspf_float32(0), inputTile );
+         break;
+      default:
+         remap( dummy, rspf_float64(0), inputTile );
+         break;
+   }
+}
+
+template <class InType, class OutType>
+void rspfFusedRemapper::remap(InType /* dummyIn */,
+                              OutType /* dummyOut */,
+                              const rspfImageData* inputTile)
+{
+   const rspf_uint32 size    = m_tile->getSizePerBand();
+   const rspf_uint32 lastIdx = m_tableSize - 1;
+   for ( rspf_uint32 band = 0; band < m_bands; ++band )
+   {
+      const InType* s = static_cast<const InType*>( inputTile->getBuf(band) );
+      OutType* d = static_cast<OutType*>( m_tile->getBuf(band) );
+      const OutType* table =
+         reinterpret_cast<const OutType*>( &(m_tables[band].front()) );
+      if ( s && d )
+      {
+         for ( rspf_uint32 i = 0; i < size; ++i )
+         {
+            // Clamp only matters for 11 bit data holding stray high bits.
+            rspf_uint32 idx = s[i];
+            d[i] = table[ ( idx <= lastIdx ) ? idx : lastIdx ];
+         }
+      }
+   }
+}
+
+rspfImageSourceFilter* rspfFusedRemapper::getConsumer() const
+{
+   return m_consumer;
+}
+
+rspf_uint32 rspfFusedRemapper::getNumberOfFusedFilters() const
+{
+   return static_cast<rspf_uint32>( m_run.size() );
+}
+
+void rspfFusedRemapper::getDecimationFactor(rspf_uint32 resLevel, rspfDpt& result) const
+{
+   m_run[0]->getDecimationFactor(resLevel, result);
+}
+
+void rspfFusedRemapper::getDecimationFactors(std::vector<rspfDpt>& decimations) const
+{
+   m_run[0]->getDecimationFactors(decimations);
+}
+
+rspf_uint32 rspfFusedRemapper::getNumberOfDecimationLevels() const
+{
+   return m_run[0]->getNumberOfDecimationLevels();
+}
+
+rspf_uint32 rspfFusedRemapper::getNumberOfInputBands() const
+{
+   return m_run[0]->getNumberOfInputBands();
+}
+
+rspf_uint32 rspfFusedRemapper::getNumberOfOutputBands() const
+{
+   return m_run[0]->getNumberOfOutputBands();
+}
+
+void rspfFusedRemapper::getOutputBandList(std::vector<rspf_uint32>& bandList) const
+{
+   m_run[0]->getOutputBandList(bandList);
+}
+
+rspfScalarType rspfFusedRemapper::getOutputScalarType() const
+{
+   return m_run[0]->getOutputScalarType();
+}
+
+rspf_uint32 rspfFusedRemapper::getTileWidth() const
+{
+   return m_run[0]->getTileWidth();
+}
+
+rspf_uint32 rspfFusedRemapper::getTileHeight() const
+{
+   return m_run[0]->getTileHeight();
+}
+
+double rspfFusedRemapper::getNullPixelValue(rspf_uint32 band) const
+{
+   return m_run[0]->getNullPixelValue(band);
+}
+
+double rspfFusedRemapper::getMinPixelValue(rspf_uint32 band) const
+{
+   return m_run[0]->getMinPixelValue(band);
+}
+
+double rspfFusedRemapper::getMaxPixelValue(rspf_uint32 band) const
+{
+   return m_run[0]->getMaxPixelValue(band);
+}
+
+rspfIrect rspfFusedRemapper::getBoundingRect(rspf_uint32 resLevel) const
+{
+   return m_run[0]->getBoundingRect(resLevel);
+}
+
+void rspfFusedRemapper::getValidImageVertices(std::vector<rspfIpt>& validVertices,
+                                              rspfVertexOrdering ordering,
+                                              rspf_uint32 resLevel) const
+{
+   m_run[0]->getValidImageVertices(validVertices, ordering, resLevel);
+}
+
+rspfRefPtr<rspfImageGeometry> rspfFusedRemapper::getImageGeometry()
+{
+   return m_run[0]->getImageGeometry();
+}
+
+bool rspfFusedRemapper::isIndexedData() const
+{
+   return m_run[0]->isIndexedData();
+}
@@ -271,6 +271,7 @@ void rspfGammaRemapper::initialize()
 void rspfGammaRemapper::setMinMaxPixelValues(const vector<double>& v_min,
                                               const vector<double>& v_max)
 {
+   incrementStateCounter();
    theMinPixelValue = v_min;
    theMaxPixelValue = v_max;
    verifyEnabled();
@@ -307,6 +308,7 @@ void rspfGammaRemapper::verifyEnabled()
 bool rspfGammaRemapper::loadState(const rspfKeywordlist& kwl,
                                    const char* prefix)
 {
+   incrementStateCounter();
    //***
    // Call the base class to pick up the enable flag.  Note that the
    // verifyEnabled flag can override this.
@@ -13,6 +13,7 @@
 //  $Id: rspfGeneralRasterTileSource.cpp 21962 2012-11-30 15:44:32Z dburken $
 
 #include <rspf/imaging/rspfGeneralRasterTileSource.h>
+#include <rspf/imaging/rspfImageSourceProfiler.h>
 #include <rspf/base/rspfConstants.h>
 #include <rspf/base/rspfDpt.h>
 #include <rspf/base/rspfEndian.h>
@@ -23,6 +24,7 @@
 #include <rspf/base/rspfIrect.h>
 #include <rspf/base/rspfKeywordlist.h>
 #include <rspf/base/rspfKeywordNames.h>
+#include <rspf/base/rspfPreferences.h>
 #include <rspf/base/rspfScalarTypeLut.h>
 #include <rspf/base/rspfStreamFactoryRegistry.h>
 #include <rspf/base/rspfTrace.h>
@@ -52,12 +54,20 @@ rspfGeneralRasterTileSource::rspfGeneralRasterTileSource()
       m_lineBuffer(0),
       m_bufferInterleave(RSPF_BIL),
       m_fileStrList(0),
+      m_mappedFileList(0),
+      m_memoryMapFlag(false),
       m_rasterInfo(),
       m_bufferRect(0, 0, 0, 0),
       m_swapBytesFlag(false),
       m_bufferSizeInPixels(0),
       m_outputBandList(0)
-{}
+{
+   const char* lookup = rspfPreferences::instance()->findPreference("general_raster.memory_map");
+   if (lookup)
+   {
+      m_memoryMapFlag = rspfString(lookup).toBool();
+   }
+}
 
 rspfGeneralRasterTileSource::~rspfGeneralRasterTileSource()
 {
@@ -67,6 +77,8 @@ rspfGeneralRasterTileSource::~rspfGeneralRasterTileSource()
 rspfRefPtr<rspfImageData> rspfGeneralRasterTileSource::getTile(
    const rspfIrect& tile_rect, rspf_uint32 resLevel)
 {
+   RSPF_PROFILE_GET_TILE(tile_rect);
+
    if ( m_tile.valid() == false )
    {
       allocateTile(); // First time through...
@@ -149,7 +161,25 @@ bool rspfGeneralRasterTileSource::getTile(rspfImageData* result,
 
             rspfIrect clip_rect = tile_rect.clipToRect(image_rect);
 
-            if ( ! tile_rect.completely_within(m_bufferRect) )
+            if ( isMemoryMapped() &&
+                 ( (m_rasterInfo.interleaveType() == RSPF_BSQ) ||
+                   (m_rasterInfo.interleaveType() == RSPF_BSQ_MULTI_FILE) ) )
+            {
+               // Straight from the mapping into the tile; m_buffer is not used.
+               if ( !tile_rect.completely_within(clip_rect) )
+               {
+                  result->makeBlank();
+               }
+               if ( !fillTileFromMap(result, tile_rect, clip_rect) )
+               {
+                  rspfNotify(rspfNotifyLevel_WARN)
+                     << "Error from fill tile from map..."
+                     << std::endl;
+                  setErrorStatus();
+                  status = false;
+               }
+            }
+            else if ( ! tile_rect.completely_within(m_bufferRect) )
             {
                // A new buffer must be loaded.
                if ( !tile_rect.completely_within(clip_rect) )
@@ -183,11 +213,16 @@ bool rspfGeneralRasterTileSource::getTile(rspfImageData* result,
                   status = false;
                }
             }
-            
-            result->loadTile(m_buffer,
-                             m_bufferRect,
-                             clip_rect,
-                             m_bufferInterleave);
+
+            if ( !isMemoryMapped() ||
+                 ( (m_rasterInfo.interleaveType() != RSPF_BSQ) &&
+                   (m_rasterInfo.interleaveType() != RSPF_BSQ_MULTI_FILE) ) )
+            {
+               result->loadTile(m_buffer,
+                                m_bufferRect,
+                                clip_rect,
+                                m_bufferInterleave);
+            }
             result->validate();
 
             // Set the rectangle back.
@@ -295,25 +330,15 @@ bool rspfGeneralRasterTileSource::fillBIP(const rspfIpt& origin, const rspfIpt&
 #endif
    
    rspf_int32 bufferOffset = 0;   
+
+   willNeed(0, rasterOffset, HEIGHT * m_rasterInfo.bytesPerRawLine());
    
    // Line loop:
    rspf_int32 currentLine = 0;
    while ( currentLine < HEIGHT )
    {
-      // Seek to line.
-      m_fileStrList[0]->seekg(rasterOffset, ios::beg);
-      if (!(*m_fileStrList[0]))
-      {
-         theErrorStatus = rspfErrorCodes::RSPF_ERROR;
-         rspfNotify(rspfNotifyLevel_WARN)
-            << MODULE << " ERROR:\n"
-            << " Seek error!  Returning with error..." << std::endl;
-         return false;
-      }
-
       // Read image data from line for all bands into line buffer.   
-      m_fileStrList[0]->read( (char*)m_lineBuffer, inputLineBufferWidth );
-      if ( m_fileStrList[0]->gcount() != inputLineBufferWidth ) 
+      if ( !readRaw(0, rasterOffset, m_lineBuffer, inputLineBufferWidth) )
       {
          theErrorStatus = rspfErrorCodes::RSPF_ERROR;
          rspfNotify(rspfNotifyLevel_WARN)
@@ -389,29 +414,16 @@ bool rspfGeneralRasterTileSource::fillBIL(const rspfIpt& origin,
 
    rspf_uint64 height    = size.y;
    rspf_sint64 num_bands = m_rasterInfo.numberOfBands();
+
+   willNeed(0, offset, height * num_bands * m_rasterInfo.bytesPerRawLine());
    
    while ((currentLine <= static_cast<rspf_sint64>(m_rasterInfo.imageRect().lr().y)) &&
           linesProcessed < height)
    {
       for (rspf_int32 band = 0; band < num_bands; ++band)
       {
-         //***
-         // Seek to line.
-         //***
-         m_fileStrList[0]->seekg(offset, ios::beg);
-         if (!m_fileStrList[0])
-         {
-            theErrorStatus = rspfErrorCodes::RSPF_ERROR;
-            rspfNotify(rspfNotifyLevel_WARN)
-               << MODULE << " ERROR:\n"
-               << " Seek error!  Returning with error..." << std::endl;
-            return false;
-         }
-         
          // Read the line of image data.   
-         m_fileStrList[0]->read( (char*)buf, buffer_width );
-
-         if ( m_fileStrList[0]->gcount() != buffer_width ) 
+         if ( !readRaw(0, offset, buf, buffer_width) )
          {
             theErrorStatus = rspfErrorCodes::RSPF_ERROR;
             rspfNotify(rspfNotifyLevel_WARN) << MODULE << "\nERROR:  Reading image line."
@@ -486,24 +498,14 @@ bool rspfGeneralRasterTileSource::fillBSQ(const rspfIpt& origin,
 
       std::streamoff offset = startSeekPosition + (band * bandOffset);
 
+      willNeed(0, offset, height * m_rasterInfo.bytesPerRawLine());
+
       // Line loop:
       while (currentLine <= m_rasterInfo.imageRect().lr().y &&
              linesProcessed < height)
       {
-         // Seek to line.
-         m_fileStrList[0]->seekg(offset, ios::beg);
-         if (!m_fileStrList[0])
-         {
-            theErrorStatus = rspfErrorCodes::RSPF_ERROR;
-            rspfNotify(rspfNotifyLevel_WARN)
-               << MODULE << " ERROR:\n"
-               << " Seek error!  Returning with error..." << std::endl;
-            return false;
-         }
-         
          // Read the line of image data.   
-         m_fileStrList[0]->read( (char*)buf, buffer_width );
-         if ( m_fileStrList[0]->gcount() != buffer_width ) 
+         if ( !readRaw(0, offset, buf, buffer_width) )
          {
             theErrorStatus = rspfErrorCodes::RSPF_ERROR;
             rspfNotify(rspfNotifyLevel_WARN)
@@ -581,29 +583,15 @@ bool rspfGeneralRasterTileSource::fillBsqMultiFile(const rspfIpt& origin, const
       rspf_int32 currentLine    = origin.y;
       rspf_int32 linesProcessed = 0;
       rspf_int64 offset         = startSeekPosition;
+
+      willNeed(*bandIter, offset, size.y * m_rasterInfo.bytesPerRawLine());
       
       while (currentLine <= m_rasterInfo.imageRect().lr().y && linesProcessed < size.y)
       {
-         //---
-         // Seek to line.
-         //---
-         m_fileStrList[ *bandIter ]->seekg(offset, ios::beg);
-
-         if ( !m_fileStrList[ *bandIter ] )
-         {
-            theErrorStatus = rspfErrorCodes::RSPF_ERROR;
-            rspfNotify(rspfNotifyLevel_WARN)
-               << MODULE << " ERROR:\n"
-               << " Seek error!  Returning with error..." << std::endl;
-            return false;
-         }
-         
          //---
          // Read the line of image data.   
          //---
-         m_fileStrList[ *bandIter ]->read((char*)buf, buffer_width);
-         
-         if ( m_fileStrList[ *bandIter ]->gcount() != buffer_width) 
+         if ( !readRaw(*bandIter, offset, buf, buffer_width) )
          {
             theErrorStatus = rspfErrorCodes::RSPF_ERROR;
             rspfNotify(rspfNotifyLevel_WARN)
@@ -627,6 +615,112 @@ bool rspfGeneralRasterTileSource::fillBsqMultiFile(const rspfIpt& origin, const
    return true;
 }
 
+bool rspfGeneralRasterTileSource::readRaw(rspf_uint32 fileIndex,
+                                           std::streamoff offset,
+                                           rspf_uint8* buf,
+                                           std::streamsize size)
+{
+   if ( fileIndex < m_mappedFileList.size() )
+   {
+      return m_mappedFileList[fileIndex]->read( static_cast<rspf_uint64>(offset),
+                                                buf,
+                                                static_cast<rspf_uint64>(size) );
+   }
+   if ( ( fileIndex >= m_fileStrList.size() ) || !m_fileStrList[fileIndex].valid() )
+   {
+      return false;
+   }
+   
+   rspfIFStream* str = m_fileStrList[fileIndex].get();
+   str->seekg(offset, ios::beg);
+   if ( !(*str) )
+   {
+      return false;
+   }
+   str->read( (char*)buf, size );
+   return ( str->gcount() == size );
+}
+
+void rspfGeneralRasterTileSource::willNeed(rspf_uint32 fileIndex,
+                                            std::streamoff offset,
+                                            std::streamsize size) const
+{
+   if ( fileIndex < m_mappedFileList.size() )
+   {
+      m_mappedFileList[fileIndex]->willNeed( static_cast<rspf_uint64>(offset),
+                                             static_cast<rspf_uint64>(size) );
+   }
+}
+
+bool rspfGeneralRasterTileSource::fillTileFromMap(rspfImageData* result,
+                                                   const rspfIrect& tile_rect,
+                                                   const rspfIrect& clip_rect) const
+{
+   const bool        MULTI_FILE     = (m_rasterInfo.interleaveType() == RSPF_BSQ_MULTI_FILE);
+   const rspf_uint64 BYTES_PER_PIX  = m_rasterInfo.bytesPerPixel();
+   const rspf_uint64 RAW_LINE_BYTES = m_rasterInfo.bytesPerRawLine();
+   const rspf_uint64 BAND_BYTES     = RAW_LINE_BYTES * m_rasterInfo.rawLines();
+   const rspf_uint64 WIDTH          = clip_rect.width();
+   const rspf_uint64 LINES          = clip_rect.height();
+   const rspf_uint64 LINE_BYTES     = WIDTH * BYTES_PER_PIX;
+   const rspf_uint64 TILE_LINE_BYTES = result->getWidth() * BYTES_PER_PIX;
+   const rspf_uint64 SPAN           = (LINES - 1) * RAW_LINE_BYTES + LINE_BYTES;
+   const rspfScalarType SCALAR     = m_rasterInfo.getImageMetaData().getScalarType();
+   rspfEndian oe;
+
+   for (rspf_uint32 band = 0; band < result->getNumberOfBands(); ++band)
+   {
+      rspf_uint32 inputBand = (band < m_outputBandList.size()) ? m_outputBandList[band] : band;
+      rspf_uint32 fileIndex = MULTI_FILE ? inputBand : 0;
+      if ( fileIndex >= m_mappedFileList.size() )
+      {
+         return false;
+      }
+      const rspfMemoryMappedFile* map = m_mappedFileList[fileIndex].get();
+
+      rspf_uint64 offset = m_rasterInfo.offsetToFirstValidSample() +
+         (MULTI_FILE ? 0 : inputBand * BAND_BYTES) +
+         clip_rect.ul().y * RAW_LINE_BYTES + clip_rect.ul().x * BYTES_PER_PIX;
+      if ( offset + SPAN > map->getSize() )
+      {
+         return false;
+      }
+      map->willNeed(offset, SPAN);
+
+      const rspf_uint8* src = map->getData() + offset;
+      rspf_uint8* dest = static_cast<rspf_uint8*>( result->getBuf(band) ) +
+         ( (clip_rect.ul().y - tile_rect.ul().y) * result->getWidth() +
+           (clip_rect.ul().x - tile_rect.ul().x) ) * BYTES_PER_PIX;
+
+      for (rspf_uint64 line = 0; line < LINES; ++line)
+      {
+         memcpy(dest, src, LINE_BYTES);
+         if (m_swapBytesFlag)
+         {
+            oe.swap( SCALAR, dest, static_cast<rspf_uint32>(WIDTH) );
+         }
+         src  += RAW_LINE_BYTES;
+         dest += TILE_LINE_BYTES;
+      }
+   }
+   return true;
+}
+
+void rspfGeneralRasterTileSource::setMemoryMapFlag(bool flag)
+{
+   m_memoryMapFlag = flag;
+}
+
+bool rspfGeneralRasterTileSource::getMemoryMapFlag() const
+{
+   return m_memoryMapFlag;
+}
+
+bool rspfGeneralRasterTileSource::isMemoryMapped() const
+{
+   return ( m_mappedFileList.size() != 0 );
+}
+
 //*******************************************************************
 // Public method:
 //*******************************************************************
@@ -635,6 +729,7 @@ bool rspfGeneralRasterTileSource::saveState(rspfKeywordlist& kwl,
 {   
    // Our stuff:
    m_rasterInfo.saveState(kwl, prefix);
+   kwl.add(prefix, "memory_map", (m_memoryMapFlag ? "true" : "false"), true);
 
    // Base class:
    bool result = rspfImageHandler::saveState(kwl, prefix);
@@ -676,6 +771,11 @@ bool rspfGeneralRasterTileSource::loadState(const rspfKeywordlist& kwl,
       {
          rspf::toSimpleVector( m_outputBandList, value );
       }
+      const char* lookup = kwl.find(prefix, "memory_map");
+      if ( lookup )
+      {
+         m_memoryMapFlag = rspfString(lookup).toBool();
+      }
       result = open();
    }
    return result;
@@ -921,6 +1021,27 @@ bool rspfGeneralRasterTileSource::initializeHandler()
       m_fileStrList.push_back(is); // Add it to the list...
    }
 
+   if ( m_memoryMapFlag )
+   {
+      for (rspf_uint32 i=0; i<aList.size(); ++i)
+      {
+         rspfRefPtr<rspfMemoryMappedFile> map = new rspfMemoryMappedFile();
+         if ( !map->open(aList[i]) )
+         {
+            // Keep reading through the streams.
+            if (traceDebug())
+            {
+               rspfNotify(rspfNotifyLevel_DEBUG)
+                  << "rspfGeneralRasterTileSource::initializeHandler DEBUG:"
+                  << "\nCould not map " << aList[i] << ", using streams." << std::endl;
+            }
+            m_mappedFileList.clear();
+            break;
+         }
+         m_mappedFileList.push_back(map);
+      }
+   }
+
    if ((aList.size()==1) && theImageFile.empty())
    {
       theImageFile = aList[0];
@@ -1007,6 +1128,7 @@ void rspfGeneralRasterTileSource::close()
       ++is;
    }
    m_fileStrList.clear();
+   m_mappedFileList.clear();
 }
 
 rspf_uint32 rspfGeneralRasterTileSource::getImageTileWidth() const
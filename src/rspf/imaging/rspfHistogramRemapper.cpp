@@ -14,6 +14,7 @@
 // $Id: rspfHistogramRemapper.cpp 22187 2013-03-07 20:29:00Z dburken $
 
 #include <rspf/imaging/rspfHistogramRemapper.h>
+#include <rspf/imaging/rspfImageSourceProfiler.h>
 #include <rspf/base/rspfMultiResLevelHistogram.h>
 #include <rspf/base/rspfMultiBandHistogram.h>
 #include <rspf/base/rspfHistogram.h>
@@ -152,6 +153,7 @@ void rspfHistogramRemapper::initialize()
 
 void rspfHistogramRemapper::reset()
 {
+   incrementStateCounter();
    // We could delete theTable to free up memory???
    setStretchMode(LINEAR_ONE_PIECE, false);
    initializeClips();
@@ -161,6 +163,7 @@ void rspfHistogramRemapper::reset()
 void
 rspfHistogramRemapper::setHistogram(rspfRefPtr<rspfMultiResLevelHistogram> histogram)
 {
+   incrementStateCounter();
    theHistogram = histogram;
    setNullCount();
 	
@@ -172,6 +175,7 @@ rspfHistogramRemapper::setHistogram(rspfRefPtr<rspfMultiResLevelHistogram> histo
 
 bool rspfHistogramRemapper::openHistogram(const rspfFilename& histogram_file)
 {
+   incrementStateCounter();
    rspfRefPtr<rspfMultiResLevelHistogram> h = new rspfMultiResLevelHistogram();
    if (h->importHistogram(histogram_file))
    {
@@ -187,6 +191,7 @@ rspfRefPtr<rspfImageData> rspfHistogramRemapper::getTile(
    const rspfIrect& tile_rect,
    rspf_uint32 resLevel)
 {
+   RSPF_PROFILE_GET_TILE(tile_rect);
    
 #if 0 /* Please leave for serious debug. (drb) */
    cout << "\ntheEnableFlag: " << theEnableFlag
@@ -214,6 +219,7 @@ rspfRefPtr<rspfImageData> rspfHistogramRemapper::getTile(
 
 void rspfHistogramRemapper::setLowNormalizedClipPoint(const rspf_float64& clip)
 {
+   incrementStateCounter();
    const rspf_uint32 BANDS = getNumberOfInputBands();
    for (rspf_uint32 band = 0; band < BANDS; ++band)
    {
@@ -239,6 +245,7 @@ void rspfHistogramRemapper::makeClean()
 void rspfHistogramRemapper::setLowNormalizedClipPoint(const rspf_float64& clip,
                                                   rspf_uint32 zero_based_band)
 {
+   incrementStateCounter();
    const rspf_uint32 BANDS = getNumberOfInputBands();
 	
    if (zero_based_band >= BANDS)
@@ -265,6 +272,7 @@ void rspfHistogramRemapper::setLowNormalizedClipPoint(const rspf_float64& clip,
 void
 rspfHistogramRemapper::setHighNormalizedClipPoint(const rspf_float64& clip)
 {
+   incrementStateCounter();
    const rspf_uint32 BANDS = getNumberOfInputBands();
    for (rspf_uint32 band = 0; band < BANDS; ++band)
    {
@@ -275,6 +283,7 @@ rspfHistogramRemapper::setHighNormalizedClipPoint(const rspf_float64& clip)
 void rspfHistogramRemapper::setHighNormalizedClipPoint(
    const rspf_float64& clip, rspf_uint32 zero_based_band)
 {
+   incrementStateCounter();
    const rspf_uint32 BANDS = getNumberOfInputBands();
 	
    if (zero_based_band >= BANDS)
@@ -300,6 +309,7 @@ void rspfHistogramRemapper::setHighNormalizedClipPoint(
 
 void rspfHistogramRemapper::setLowClipPoint(const rspf_float64& clip)
 {
+   incrementStateCounter();
    const rspf_uint32 BANDS = getNumberOfInputBands();
    for (rspf_uint32 band = 0; band < BANDS; ++band)
    {
@@ -310,6 +320,7 @@ void rspfHistogramRemapper::setLowClipPoint(const rspf_float64& clip)
 void rspfHistogramRemapper::setLowClipPoint(const rspf_float64& clip,
                                              rspf_uint32 zero_based_band)
 {
+   incrementStateCounter();
    // allow the call to getHistogram to happen this way we can calculate a histogram if 
    // a histosource is connected to this object
    //
@@ -328,6 +339,7 @@ void rspfHistogramRemapper::setLowClipPoint(const rspf_float64& clip,
 
 void rspfHistogramRemapper::setHighClipPoint(const rspf_float64& clip)
 {
+   incrementStateCounter();
    const rspf_uint32 BANDS = getNumberOfInputBands();
    for (rspf_uint32 band = 0; band < BANDS; ++band)
    {
@@ -338,6 +350,7 @@ void rspfHistogramRemapper::setHighClipPoint(const rspf_float64& clip)
 void rspfHistogramRemapper::setHighClipPoint(const rspf_float64& clip,
                                               rspf_uint32 zero_based_band)
 {
+   incrementStateCounter();
    // allow the call to getHistogram to happen this way we can calculate a histogram if 
    // a histosource is connected to this object
    //
@@ -357,6 +370,7 @@ void rspfHistogramRemapper::setHighClipPoint(const rspf_float64& clip,
 
 void rspfHistogramRemapper::setMidPoint(const rspf_float64& value)
 {
+   incrementStateCounter();
    const rspf_uint32 BANDS = getNumberOfInputBands();
    for (rspf_uint32 band = 0; band < BANDS; ++band)
    {
@@ -367,6 +381,7 @@ void rspfHistogramRemapper::setMidPoint(const rspf_float64& value)
 void rspfHistogramRemapper::setMidPoint(const rspf_float64& value,
                                          rspf_uint32 zero_based_band)
 {
+   incrementStateCounter();
    const rspf_uint32 BANDS = getNumberOfInputBands();
 	
    if (zero_based_band >= BANDS)
@@ -391,6 +406,7 @@ void rspfHistogramRemapper::setMidPoint(const rspf_float64& value,
 
 void rspfHistogramRemapper::setMinOutputValue(const rspf_float64& value)
 {
+   incrementStateCounter();
    const rspf_uint32 BANDS = getNumberOfInputBands();
    for (rspf_uint32 band = 0; band < BANDS; ++band)
    {
@@ -401,6 +417,7 @@ void rspfHistogramRemapper::setMinOutputValue(const rspf_float64& value)
 void rspfHistogramRemapper::setMinOutputValue(const rspf_float64& value,
                                                rspf_uint32 zero_based_band)
 {
+   incrementStateCounter();
    if (theInputConnection)
    {
       const rspf_uint32 BANDS = getNumberOfInputBands();
@@ -430,6 +447,7 @@ void rspfHistogramRemapper::setMinOutputValue(const rspf_float64& value,
 
 void rspfHistogramRemapper::setMaxOutputValue(const rspf_float64& value)
 {
+   incrementStateCounter();
    const rspf_uint32 BANDS = getNumberOfInputBands();
    for (rspf_uint32 band = 0; band < BANDS; ++band)
    {
@@ -440,6 +458,7 @@ void rspfHistogramRemapper::setMaxOutputValue(const rspf_float64& value)
 void rspfHistogramRemapper::setMaxOutputValue(const rspf_float64& value,
                                                rspf_uint32 zero_based_band)
 {
+   incrementStateCounter();
    if (theInputConnection)
    {
       const rspf_uint32 BANDS = getNumberOfInputBands();
@@ -743,6 +762,7 @@ rspf_float64 rspfHistogramRemapper::getMaxOutputValue() const
 bool rspfHistogramRemapper::loadState(const rspfKeywordlist& kwl,
                                        const char* prefix)
 {
+   incrementStateCounter();
    static const char MODULE[] = "rspfHistogramRemapper::loadState";
    if (traceDebug())
    {
@@ -994,6 +1014,7 @@ bool rspfHistogramRemapper::saveState(rspfKeywordlist& kwl,
 void rspfHistogramRemapper::setStretchMode(StretchMode mode,
                                             bool rebuildTable)
 {
+   incrementStateCounter();
    if (theStretchMode != mode)
    {
       theStretchMode = mode;
@@ -1018,6 +1039,7 @@ void rspfHistogramRemapper::setStretchMode(StretchMode mode,
 void rspfHistogramRemapper::setStretchModeAsString(const rspfString& mode,
                                                     bool rebuildTable)
 {
+   incrementStateCounter();
    if( mode == "linear_one_piece")
    {
       setStretchMode(LINEAR_ONE_PIECE, rebuildTable);
@@ -1046,6 +1068,7 @@ void rspfHistogramRemapper::setStretchModeAsString(const rspfString& mode,
 
 void rspfHistogramRemapper::buildTable()
 {
+   incrementStateCounter();
    setupTable();
    switch(theStretchMode)
    {
@@ -1866,6 +1889,7 @@ rspfHistogramRemapper& rspfHistogramRemapper::operator=(const rspfHistogramRemap
 
 void rspfHistogramRemapper::setBypassFlag(bool flag)
 {
+   incrementStateCounter();
    if (theBypassFlag != flag)
    {
       //---
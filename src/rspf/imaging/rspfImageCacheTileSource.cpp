@@ -12,6 +12,7 @@
 using namespace std;
 
 #include <rspf/imaging/rspfImageCacheTileSource.h>
+#include <rspf/imaging/rspfImageSourceProfiler.h>
 
 #include <rspf/base/rspfStdOutProgress.h>
 #include <rspf/base/rspfNBandLutDataObject.h>
@@ -186,6 +187,8 @@ bool rspfImageCacheTileSource::buildFrameEntryArray(rspfFilename imageFile)
 rspfRefPtr<rspfImageData> rspfImageCacheTileSource::getTile(
   const  rspfIrect& rect, rspf_uint32 resLevel)
 {
+  RSPF_PROFILE_GET_TILE(rect);
+
   if (m_tile.valid())
   {
     // Image rectangle must be set prior to calling getTile.
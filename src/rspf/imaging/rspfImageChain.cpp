@@ -11,6 +11,7 @@
 // $Id: rspfImageChain.cpp 21850 2012-10-21 20:09:55Z dburken $
 
 #include <rspf/imaging/rspfImageChain.h>
+#include <rspf/imaging/rspfImageSourceProfiler.h>
 #include <rspf/base/rspfCommon.h>
 #include <rspf/base/rspfConnectableContainer.h>
 #include <rspf/base/rspfDrect.h>
@@ -24,6 +25,7 @@
 #include <rspf/base/rspfVisitor.h>
 #include <rspf/imaging/rspfImageData.h>
 #include <rspf/imaging/rspfImageGeometry.h>
+#include <rspf/imaging/rspfImageSourceFilter.h>
 #include <algorithm>
 #include <iostream>
 #include <iterator>
@@ -65,7 +67,9 @@ rspfImageChain::rspfImageChain()
                   false), // outputs are not fixed
     rspfConnectableContainerInterface((rspfObject*)NULL),
     theBlankTile(NULL),
-    theLoadStateFlag(false)
+    theLoadStateFlag(false),
+    theFusePointFiltersFlag(true),
+    theFusedRemappers()
 {
    rspfConnectableContainerInterface::theBaseObject = this;
    //thePropagateEventFlag = false;
@@ -75,6 +79,7 @@ rspfImageChain::rspfImageChain()
 rspfImageChain::~rspfImageChain()
 {
    removeListener((rspfConnectableObjectListener*)this);
+   clearFusedRemappers();
    deleteList();
 }
 
@@ -797,8 +802,16 @@ rspfRefPtr<rspfImageData> rspfImageChain::getTile(
    const rspfIrect& tileRect,
    rspf_uint32 resLevel)
 {
+   RSPF_PROFILE_GET_TILE(tileRect);
+
    if((imageChainList().size() > 0)&&(isSourceEnabled()))
    {
+      if(theFusedRemappers.size() && !theFusedRemappers[0]->getConsumer())
+      {
+         // Point filters at the output end are fused.
+         return theFusedRemappers[0]->getTile(tileRect, resLevel);
+      }
+      
       rspfImageSource* inputSource = PTR_CAST(rspfImageSource,
                                              imageChainList()[0].get());
       
@@ -1444,6 +1457,10 @@ bool rspfImageChain::saveState(rspfKeywordlist& kwl,
    {
       return result;
    }
+   kwl.add(prefix,
+           "fuse_point_filters",
+           (theFusePointFiltersFlag ? "true" : "false"),
+           true);
    rspf_uint32 upper = (rspf_uint32)imageChainList().size();
    rspf_uint32 counter = 1;
 
@@ -1472,7 +1489,12 @@ bool rspfImageChain::loadState(const rspfKeywordlist& kwl,
    deleteList();
 
    rspfImageSource::loadState(kwl, prefix);
-   
+
+   const char* lookup = kwl.find(prefix, "fuse_point_filters");
+   if(lookup)
+   {
+      theFusePointFiltersFlag = rspfString(lookup).toBool();
+   }
    
    theLoadStateFlag = true;
    bool result = true;
@@ -1498,6 +1520,8 @@ void rspfImageChain::initialize()
 {
    static const char* MODULE = "rspfImageChain::initialize()";
    if (traceDebug()) CLOG << " Entered..." << std::endl;
+
+   clearFusedRemappers();
    
    long upper = (rspf_uint32)imageChainList().size();
    
@@ -1523,9 +1547,129 @@ void rspfImageChain::initialize()
          }
       }
    }
+
+   if(theFusePointFiltersFlag)
+   {
+      fusePointFilters();
+   }
    if (traceDebug()) CLOG << " Exited..." << std::endl;
 }
 
+void rspfImageChain::setFusePointFiltersFlag(bool flag)
+{
+   if(flag != theFusePointFiltersFlag)
+   {
+      theFusePointFiltersFlag = flag;
+      clearFusedRemappers();
+      if(theFusePointFiltersFlag)
+      {
+         fusePointFilters();
+      }
+   }
+}
+
+bool rspfImageChain::getFusePointFiltersFlag() const
+{
+   return theFusePointFiltersFlag;
+}
+
+rspf_uint32 rspfImageChain::getNumberOfFusedFilters() const
+{
+   rspf_uint32 result = 0;
+   for(rspf_uint32 idx = 0; idx < theFusedRemappers.size(); ++idx)
+   {
+      result += theFusedRemappers[idx]->getNumberOfFusedFilters();
+   }
+   return result;
+}
+
+void rspfImageChain::fusePointFilters()
+{
+   static const char* MODULE = "rspfImageChain::fusePointFilters()";
+
+   clearFusedRemappers();
+
+   const rspf_uint32 upper = (rspf_uint32)imageChainList().size();
+   rspf_uint32 index = 0;
+   while(index < upper)
+   {
+      if(!rspfFusedRemapper::isPointFilter(imageChainList()[index].get()))
+      {
+         ++index;
+         continue;
+      }
+
+      // Run is [start, index); the source after it must be in the chain.
+      rspf_uint32 start = index;
+      rspf_uint32 active = 0;
+      while((index < upper - 1) &&
+            rspfFusedRemapper::isPointFilter(imageChainList()[index].get()))
+      {
+         const rspfSource* source =
+            PTR_CAST(rspfSource, imageChainList()[index].get());
+         if(source->isSourceEnabled() &&
+            (source->getClassName() != "rspfBandSelector"))
+         {
+            ++active;
+         }
+         ++index;
+      }
+      if(index == start)
+      {
+         ++index;
+         continue;
+      }
+
+      // One table lookup for fewer than two real filters gains nothing.
+      if(active < 2)
+      {
+         continue;
+      }
+
+      rspfImageSourceFilter* consumer = 0;
+      if(start > 0)
+      {
+         consumer = PTR_CAST(rspfImageSourceFilter,
+                             imageChainList()[start-1].get());
+         if(!consumer || (consumer->getInput(0) != imageChainList()[start].get()))
+         {
+            continue;
+         }
+      }
+
+      rspfRefPtr<rspfFusedRemapper> fused = new rspfFusedRemapper(this);
+      if(fused->initialize(start, index - start, consumer))
+      {
+         if(consumer)
+         {
+            consumer->setInputConnection(fused.get());
+         }
+         theFusedRemappers.push_back(fused);
+
+         if(traceDebug())
+         {
+            CLOG << "fused " << (index - start) << " filters at index "
+                 << start << std::endl;
+         }
+      }
+   }
+}
+
+void rspfImageChain::clearFusedRemappers()
+{
+   for(rspf_uint32 idx = 0; idx < theFusedRemappers.size(); ++idx)
+   {
+      // Only touch consumers still held by this chain.
+      rspfImageSourceFilter* consumer = theFusedRemappers[idx]->getConsumer();
+      if(consumer && (indexOf(consumer) >= 0))
+      {
+         consumer->setInputConnection(PTR_CAST(rspfImageSource,
+                                               consumer->getInput(0)));
+      }
+   }
+   theFusedRemappers.clear();
+}
+
 void rspfImageChain::enableSource()
 {
    rspf_int32 upper = static_cast<rspf_int32>(imageChainList().size());
@@ -1608,6 +1752,7 @@ bool rspfImageChain::deleteLast()
 
 void rspfImageChain::deleteList()
 {
+   clearFusedRemappers();
    rspf_uint32 upper = (rspf_uint32) imageChainList().size();
    rspf_uint32 idx = 0;
    rspfContainerEvent event(this, RSPF_EVENT_REMOVE_OBJECT_ID);
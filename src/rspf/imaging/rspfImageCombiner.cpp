@@ -11,6 +11,9 @@
 #include <rspf/base/rspfIrect.h>
 #include <rspf/imaging/rspfImageData.h>
 #include <rspf/base/rspfTrace.h>
+#include <rspf/base/rspfPolyArea2d.h>
+#include <rspf/base/rspfPolygon.h>
+#include <rspf/parallel/rspfCascadedUnion.h>
 
 using namespace std;
 
@@ -124,6 +127,47 @@ rspfIrect rspfImageCombiner::getBoundingRect(rspf_uint32 resLevel)const
    return result;
 }
 
+void rspfImageCombiner::getCoverage(rspfPolyArea2d& coverage,
+                                     rspf_uint32 resLevel,
+                                     double tolerance) const
+{
+   static const char* MODULE = "rspfImageCombiner::getCoverage";
+   rspfCascadedUnion cascade;
+   cascade.setTolerance(tolerance);
+
+   std::vector<rspfIpt> vertices;
+   for(rspf_uint32 inputIndex = 0; inputIndex < getNumberOfInputs(); ++inputIndex)
+   {
+      rspfImageSource* interface = PTR_CAST(rspfImageSource, getInput(inputIndex));
+      if(!interface)
+      {
+         continue;
+      }
+      vertices.clear();
+      interface->getValidImageVertices(vertices, RSPF_CLOCKWISE_ORDER, resLevel);
+      if(vertices.size() < 3)
+      {
+         rspfIrect rect = interface->getBoundingRect(resLevel);
+         if(rect.hasNans())
+         {
+            continue;
+         }
+         vertices.clear();
+         vertices.push_back(rect.ul());
+         vertices.push_back(rect.ur());
+         vertices.push_back(rect.lr());
+         vertices.push_back(rect.ll());
+      }
+      cascade.add(rspfPolygon(vertices));
+   }
+
+   if(traceDebug())
+   {
+      CLOG << "merging " << cascade.getNumberOfAreas() << " footprints" << endl;
+   }
+   cascade.execute(coverage);
+}
+
 rspf_uint32 rspfImageCombiner::getNumberOfInputBands() const
 {
    return theLargestNumberOfInputBands;
@@ -10,6 +10,7 @@
 #include <rspf/base/rspfNumericProperty.h>
 #include <rspf/base/rspfBooleanProperty.h>
 #include <rspf/imaging/rspfImageData.h>
+#include <rspf/imaging/rspfImageDataFactory.h>
 #include <cmath>
 
 RTTI_DEF1(rspfImageGaussianFilter, "rspfImageGaussianFilter", rspfImageSourceFilter);
@@ -20,15 +21,62 @@ RTTI_DEF1(rspfImageGaussianFilter, "rspfImageGaussianFilter", rspfImageSourceFil
 static const char* PROPERTYNAME_GAUSSSTD     = "GaussStd";
 static const char* PROPERTYNAME_STRICTNODATA = "StrictNoData";
 
+/**
+ * Input of theHF: passes through to the filter input, except that the tile
+ * getTile has just read is handed back when theHF asks for the same rect.
+ */
+class rspfGaussianInputCache : public rspfImageSourceFilter
+{
+public:
+   rspfGaussianInputCache()
+      : rspfImageSourceFilter(),
+        theCachedTile(0),
+        theCachedResLevel(0)
+   {
+   }
+
+   void setCachedTile(rspfImageData* tile, rspf_uint32 resLevel)
+   {
+      theCachedTile     = tile;
+      theCachedResLevel = resLevel;
+   }
+
+   virtual rspfRefPtr<rspfImageData> getTile(const rspfIrect& tileRect,
+                                              rspf_uint32 resLevel=0)
+   {
+      if(theCachedTile.valid() &&
+         (theCachedResLevel == resLevel) &&
+         (theCachedTile->getImageRectangle() == tileRect))
+      {
+         return theCachedTile;
+      }
+      if(theInputConnection)
+      {
+         return theInputConnection->getTile(tileRect, resLevel);
+      }
+      return 0;
+   }
+
+protected:
+   virtual ~rspfGaussianInputCache() {}
+
+   rspfRefPtr<rspfImageData> theCachedTile;
+   rspf_uint32                theCachedResLevel;
+};
+
 rspfImageGaussianFilter::rspfImageGaussianFilter()
    : rspfImageSourceFilter(),
      theGaussStd(0.5),
-     theStrictNoData(true)
+     theStrictNoData(true),
+     theEngine(),
+     theHalfWidth(0),
+     theTile(0)
 {
    // ingredients: 
    // 2x  ConvolutionFilter1D
    theHF=new rspfConvolutionFilter1D();
    theVF=new rspfConvolutionFilter1D();
+   theInputCache=new rspfGaussianInputCache();
 
    theHF->setIsHorizontal(true);
    theVF->setIsHorizontal(false);
@@ -38,6 +86,7 @@ rspfImageGaussianFilter::rspfImageGaussianFilter()
    theVF->setStrictNoData(theStrictNoData);
 
    //tie them up
+   theHF->connectMyInputTo(0,theInputCache.get());
    theVF->connectMyInputTo(0,theHF.get());
 }
 
@@ -53,6 +102,11 @@ rspfImageGaussianFilter::~rspfImageGaussianFilter()
       theVF->disconnect();
       theVF = 0;
    }
+   if(theInputCache.valid())
+   {
+      theInputCache->disconnect();
+      theInputCache = 0;
+   }
 }
 
 void rspfImageGaussianFilter::setProperty(rspfRefPtr<rspfProperty> property)
@@ -153,14 +207,30 @@ rspfImageGaussianFilter::initialize()
 {
    rspfImageSourceFilter::initialize();
    initializeProcesses();
+   theTile = 0;
 }
 
 rspfRefPtr<rspfImageData>
 rspfImageGaussianFilter::getTile(const rspfIrect &tileRect,rspf_uint32 resLevel)
 {
-    if(isSourceEnabled())
+    if(isSourceEnabled() && theInputConnection)
     {
-       return theVF->getTile(tileRect, resLevel);
+       rspfIrect requestRect(tileRect.ul().x - (rspf_int32)theHalfWidth,
+                             tileRect.ul().y - (rspf_int32)theHalfWidth,
+                             tileRect.lr().x + (rspf_int32)theHalfWidth,
+                             tileRect.lr().y + (rspf_int32)theHalfWidth);
+       rspfRefPtr<rspfImageData> input = theInputConnection->getTile(requestRect, resLevel);
+       rspfRefPtr<rspfImageData> result = getFullTile(input.get(), tileRect);
+       if(result.valid())
+       {
+          return result;
+       }
+
+       // theHF asks for requestRect too; give it the tile already read.
+       theInputCache->setCachedTile(input.get(), resLevel);
+       result = theVF->getTile(tileRect, resLevel);
+       theInputCache->setCachedTile(0, 0);
+       return result;
     }
     if(theInputConnection)
     {
@@ -173,6 +243,7 @@ rspfImageGaussianFilter::getTile(const rspfIrect &tileRect,rspf_uint32 resLevel)
 void
 rspfImageGaussianFilter::initializeProcesses()
 {
+   theInputCache->initialize();
    theHF->initialize();
    theVF->initialize();
 }
@@ -183,12 +254,12 @@ rspfImageGaussianFilter::connectInputEvent(rspfConnectionEvent &event)
     rspfImageSourceFilter::connectInputEvent(event);
     if(getInput())
     {
-       theHF->connectMyInputTo(0, getInput());
+       theInputCache->connectMyInputTo(0, getInput());
        initializeProcesses();
     }
     else
     {
-       theHF->disconnectMyInput(0, false, false);
+       theInputCache->disconnectMyInput(0, false, false);
        initializeProcesses();
     }
 }
@@ -199,12 +270,12 @@ rspfImageGaussianFilter::disconnectInputEvent(rspfConnectionEvent &event)
     rspfImageSourceFilter::disconnectInputEvent(event);
     if(getInput())
     {
-       theHF->connectMyInputTo(0, getInput());
+       theInputCache->connectMyInputTo(0, getInput());
        initializeProcesses();
     }
     else
     {
-       theHF->disconnectMyInput(0, false, false);
+       theInputCache->disconnectMyInput(0, false, false);
        initializeProcesses();
     }
 }
@@ -237,9 +308,95 @@ rspfImageGaussianFilter::updateKernels()
       newk[i] *= invsum;
    }
 
+   //same kernel in 2D for the one pass engine
+   NEWMAT::Matrix kernel(supsize, supsize);
+   for(rspf_uint32 r=0; r<supsize ;++r)
+   {
+      for(rspf_uint32 c=0; c<supsize ;++c)
+      {
+         kernel[r][c] = newk[r] * newk[c];
+      }
+   }
+   theEngine.setKernel(kernel, false);
+   theHalfWidth = halfw;
+
    //send to 1d conv filters
    theHF->setKernel(newk);
    theVF->setKernel(newk);
    theHF->setCenterOffset(halfw);
    theVF->setCenterOffset(halfw);
 }
+
+rspfRefPtr<rspfImageData>
+rspfImageGaussianFilter::getFullTile(const rspfImageData* input, const rspfIrect& tileRect)
+{
+   rspfIrect requestRect(tileRect.ul().x - (rspf_int32)theHalfWidth,
+                         tileRect.ul().y - (rspf_int32)theHalfWidth,
+                         tileRect.lr().x + (rspf_int32)theHalfWidth,
+                         tileRect.lr().y + (rspf_int32)theHalfWidth);
+   if(!input ||
+      (input->getDataObjectStatus() != RSPF_FULL) ||
+      (input->getImageRectangle() != requestRect))
+   {
+      return 0;
+   }
+
+   if(!theTile.valid() ||
+      (theTile->getScalarType() != input->getScalarType()) ||
+      (theTile->getNumberOfBands() != input->getNumberOfBands()))
+   {
+      theTile = rspfImageDataFactory::instance()->create(this, this);
+      theTile->initialize();
+   }
+   theTile->setImageRectangle(tileRect);
+   if((theTile->getScalarType() != input->getScalarType()) ||
+      (theTile->getNumberOfBands() != input->getNumberOfBands()))
+   {
+      return 0;
+   }
+
+   rspf_uint32 inW = input->getWidth();
+   rspf_uint32 w   = theTile->getWidth();
+   rspf_uint32 h   = theTile->getHeight();
+   bool handled    = true;
+   for(rspf_uint32 band = 0; (band < theTile->getNumberOfBands()) && handled; ++band)
+   {
+      rspf_float64 minPix = getMinPixelValue(band);
+      rspf_float64 maxPix = getMaxPixelValue(band);
+      switch(input->getScalarType())
+      {
+         case RSPF_UINT8:
+            theEngine.convolve((const rspf_uint8*)input->getBuf(band), inW,
+                               (rspf_uint8*)theTile->getBuf(band), w, h, minPix, maxPix);
+            break;
+         case RSPF_USHORT11:
+         case RSPF_UINT16:
+            theEngine.convolve((const rspf_uint16*)input->getBuf(band), inW,
+                               (rspf_uint16*)theTile->getBuf(band), w, h, minPix, maxPix);
+            break;
+         case RSPF_SINT16:
+            theEngine.convolve((const rspf_sint16*)input->getBuf(band), inW,
+                               (rspf_sint16*)theTile->getBuf(band), w, h, minPix, maxPix);
+            break;
+         case RSPF_FLOAT32:
+         case RSPF_NORMALIZED_FLOAT:
+            theEngine.convolve((const rspf_float32*)input->getBuf(band), inW,
+                               (rspf_float32*)theTile->getBuf(band), w, h, minPix, maxPix);
+            break;
+         case RSPF_FLOAT64:
+         case RSPF_NORMALIZED_DOUBLE:
+            theEngine.convolve((const rspf_float64*)input->getBuf(band), inW,
+                               (rspf_float64*)theTile->getBuf(band), w, h, minPix, maxPix);
+            break;
+         default:
+            handled = false;
+            break;
+      }
+   }
+   if(!handled)
+   {
+      return 0;
+   }
+   theTile->validate();
+   return theTile;
+}
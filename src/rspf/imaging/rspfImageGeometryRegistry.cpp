@@ -27,6 +27,7 @@ rspfImageGeometryRegistry* rspfImageGeometryRegistry::instance()
 
 bool rspfImageGeometryRegistry::extendGeometry(rspfImageHandler* handler)const
 {
+   loadDeferredPlugins();
    bool result = false;
    rspf_uint32 idx = 0;
    for(;((idx < m_factoryList.size())&&!result); ++idx)
@@ -63,6 +64,7 @@ rspfImageGeometry* rspfImageGeometryRegistry::createGeometry(const rspfKeywordli
 rspfImageGeometry* rspfImageGeometryRegistry::createGeometry(const rspfFilename& filename,
                                                                        rspf_uint32 entryIdx)const
 {
+   loadDeferredPlugins();
    rspfImageGeometry* result = 0;
    rspf_uint32 idx = 0;
    for(;((idx < m_factoryList.size())&&!result); ++idx)
@@ -26,6 +26,8 @@ RTTI_DEF1(rspfImageHandlerRegistry, "rspfImageHandlerRegistry", rspfObjectFactor
 //rspfImageHandlerRegistry* rspfImageHandlerRegistry::theInstance = 0;
 
 rspfImageHandlerRegistry::rspfImageHandlerRegistry()
+   : rspfObjectFactory(),
+     rspfFactoryListInterface<rspfImageHandlerFactoryBase, rspfImageHandler>("image_handler")
 {
    rspfObjectFactoryRegistry::instance()->registerFactory(this);
    registerFactory(rspfImageHandlerFactory::instance());
@@ -79,6 +81,7 @@ rspfRefPtr<rspfImageHandler> rspfImageHandlerRegistry::openBySuffix(const rspfFi
 void rspfImageHandlerRegistry::getImageHandlersBySuffix(rspfImageHandlerFactoryBase::ImageHandlerList& result,
                                                          const rspfString& ext)const
 {
+   loadDeferredPlugins();
    vector<rspfImageHandlerFactoryBase*>::const_iterator iter = m_factoryList.begin();
    rspfImageHandlerFactoryBase::ImageHandlerList temp;
    while(iter != m_factoryList.end())
@@ -101,6 +104,7 @@ void rspfImageHandlerRegistry::getImageHandlersBySuffix(rspfImageHandlerFactoryB
 void rspfImageHandlerRegistry::getImageHandlersByMimeType(
    rspfImageHandlerFactoryBase::ImageHandlerList& result, const rspfString& mimeType)const
 {
+   loadDeferredPlugins();
    vector<rspfImageHandlerFactoryBase*>::const_iterator iter = m_factoryList.begin();
    rspfImageHandlerFactoryBase::ImageHandlerList temp;
    while(iter != m_factoryList.end())
@@ -128,6 +132,7 @@ void rspfImageHandlerRegistry::getTypeNameList( std::vector<rspfString>& typeLis
 void rspfImageHandlerRegistry::getSupportedExtensions(
    rspfImageHandlerFactoryBase::UniqueStringList& extensionList)const
 {
+   loadDeferredPlugins();
    vector<rspfString> result;
    vector<rspfImageHandlerFactoryBase*>::const_iterator iter = m_factoryList.begin();
 
@@ -144,6 +149,7 @@ rspfImageHandler* rspfImageHandlerRegistry::open(const rspfFilename& fileName,
                                                    bool trySuffixFirst,
                                                    bool openOverview)const
 {
+   loadDeferredPlugins();
    if(trySuffixFirst)
    {
       rspfRefPtr<rspfImageHandler> h = openBySuffix(fileName, openOverview);
@@ -171,6 +177,7 @@ rspfImageHandler* rspfImageHandlerRegistry::open(const rspfFilename& fileName,
 rspfImageHandler* rspfImageHandlerRegistry::open(const rspfKeywordlist& kwl,
                                                    const char* prefix)const
 {
+   loadDeferredPlugins();
    rspfImageHandler*                   result = NULL;
    vector<rspfImageHandlerFactoryBase*>::const_iterator factory;
    
@@ -187,6 +194,7 @@ rspfImageHandler* rspfImageHandlerRegistry::open(const rspfKeywordlist& kwl,
 rspfRefPtr<rspfImageHandler> rspfImageHandlerRegistry::openOverview(
    const rspfFilename& file ) const
 {
+   loadDeferredPlugins();
    rspfRefPtr<rspfImageHandler> result = 0;
    vector<rspfImageHandlerFactoryBase*>::const_iterator factory = m_factoryList.begin();
    while( factory != m_factoryList.end() )
@@ -208,6 +216,7 @@ rspfObject* rspfImageHandlerRegistry::createObject(const rspfString& typeName) c
 
 std::ostream& rspfImageHandlerRegistry::printReaderProps(std::ostream& out) const
 {
+   loadDeferredPlugins();
    // Loop through factories:
    vector<rspfImageHandlerFactoryBase*>::const_iterator factory = m_factoryList.begin();
    while( factory != m_factoryList.end() )
@@ -169,3 +169,8 @@ extern "C"
       return rspfImageMetaDataWriterRegistry::instance();
    }
 }
+
+rspf_uint32 rspfImageMetaDataWriterRegistry::getNumberOfFactories()const
+{
+   return (rspf_uint32)theFactoryList.size();
+}
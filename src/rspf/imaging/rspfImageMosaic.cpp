@@ -10,6 +10,7 @@
 // $Id: rspfImageMosaic.cpp 15766 2009-10-20 12:37:09Z gpotts $
 
 #include <rspf/imaging/rspfImageMosaic.h>
+#include <rspf/imaging/rspfImageSourceProfiler.h>
 #include <rspf/imaging/rspfImageData.h>
 #include <rspf/imaging/rspfImageDataFactory.h>
 #include <rspf/base/rspfTrace.h>
@@ -40,6 +41,8 @@ rspfRefPtr<rspfImageData> rspfImageMosaic::getTile(
    const rspfIrect& tileRect,
    rspf_uint32 resLevel)
 {
+   RSPF_PROFILE_GET_TILE(tileRect);
+
    long size = getNumberOfInputs();
    rspf_uint32 layerIdx = 0;
    // If there is only one in the mosaic then just return it.
@@ -113,3 +113,8 @@ bool rspfImageReconstructionFilterRegistry::findFactory(rspfImageSourceFactoryBa
                      theFactoryList.end(),
                      factory)!=theFactoryList.end());
 }
+
+rspf_uint32 rspfImageReconstructionFilterRegistry::getNumberOfFactories()const
+{
+   return (rspf_uint32)theFactoryList.size();
+}
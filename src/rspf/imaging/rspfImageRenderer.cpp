@@ -10,6 +10,7 @@
 //  $Id: rspfImageRenderer.cpp 20352 2011-12-12 17:24:52Z dburken $
 
 #include <rspf/imaging/rspfImageRenderer.h>
+#include <rspf/imaging/rspfImageSourceProfiler.h>
 #include <rspf/base/rspfDpt.h>
 #include <rspf/base/rspfDpt3d.h>
 #include <rspf/base/rspfDrect.h>
@@ -573,6 +574,7 @@ rspfRefPtr<rspfImageData> rspfImageRenderer::getTile(
    rspf_uint32 resLevel)
 {
    static const char MODULE[] = "rspfImageRenderer::getTile";
+   RSPF_PROFILE_GET_TILE(tileRect);
    if(traceDebug())
    {
       rspfNotify(rspfNotifyLevel_DEBUG)
@@ -11,6 +11,7 @@
 #include <rspf/imaging/rspfImageSourceFactory.h>
 #include <rspf/imaging/rspfImageReconstructionFilterRegistry.h>
 #include <rspf/base/rspfString.h>
+#include <rspf/base/rspfFactoryListInterface.h>
 
 rspfImageSourceFactoryRegistry* rspfImageSourceFactoryRegistry::theInstance = NULL;
 
@@ -41,6 +42,7 @@ rspfImageSourceFactoryRegistry* rspfImageSourceFactoryRegistry::instance()
 
 rspfObject* rspfImageSourceFactoryRegistry::createObject(const rspfString& name)const
 {
+   rspfLoadDeferredPlugins("image_source");
    rspfObject*                   result = NULL;
    std::vector<rspfImageSourceFactoryBase*>::const_iterator factory;
 
@@ -57,6 +59,7 @@ rspfObject* rspfImageSourceFactoryRegistry::createObject(const rspfString& name)
 rspfObject* rspfImageSourceFactoryRegistry::createObject(const rspfKeywordlist& kwl,
 							   const char* prefix)const
 {
+   rspfLoadDeferredPlugins("image_source");
    rspfObject*                   result = NULL;
    std::vector<rspfImageSourceFactoryBase*>::const_iterator factory;
 
@@ -73,6 +76,7 @@ rspfObject* rspfImageSourceFactoryRegistry::createObject(const rspfKeywordlist&
 
 void rspfImageSourceFactoryRegistry::getTypeNameList(std::vector<rspfString>& typeList)const
 {
+   rspfLoadDeferredPlugins("image_source");
    std::vector<rspfString> result;
    std::vector<rspfImageSourceFactoryBase*>::const_iterator iter = theFactoryList.begin();
 
@@ -116,6 +120,11 @@ bool rspfImageSourceFactoryRegistry::findFactory(rspfImageSourceFactoryBase* fac
                      factory)!=theFactoryList.end());
 }
 
+rspf_uint32 rspfImageSourceFactoryRegistry::getNumberOfFactories()const
+{
+   return (rspf_uint32)theFactoryList.size();
+}
+
 void* rspfImageSourceFactoryRegistryGetInstance()
 {
   return rspfImageSourceFactoryRegistry::instance();
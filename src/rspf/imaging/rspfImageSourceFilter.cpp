@@ -27,7 +27,8 @@ rspfImageSourceFilter::rspfImageSourceFilter(rspfObject* owner)
                       0, // number of outputs
                       true, // input's fixed
                       false), // outputs ar not fixed
-     theInputConnection(NULL)
+     theInputConnection(NULL),
+     theStateCounter(0)
 {
    addListener((rspfConnectableObjectListener*)this);
 }
@@ -38,7 +39,8 @@ rspfImageSourceFilter::rspfImageSourceFilter(rspfImageSource* inputSource)
                       0,
                       true,
                       false),
-     theInputConnection(inputSource)
+     theInputConnection(inputSource),
+     theStateCounter(0)
 {
    if(inputSource)
    {
@@ -54,7 +56,8 @@ rspfImageSourceFilter::rspfImageSourceFilter(rspfObject* owner,
                       0,
                       true,
                       false),
-     theInputConnection(inputSource)
+     theInputConnection(inputSource),
+     theStateCounter(0)
 {
    if(inputSource)
    {
@@ -86,9 +89,25 @@ void rspfImageSourceFilter::initialize()
    theInputConnection = PTR_CAST(rspfImageSource, getInput(0));
 }
 
+void rspfImageSourceFilter::setInputConnection(rspfImageSource* source)
+{
+   theInputConnection = source;
+}
+
+rspf_uint32 rspfImageSourceFilter::getStateCounter() const
+{
+   return theStateCounter;
+}
+
+void rspfImageSourceFilter::incrementStateCounter()
+{
+   ++theStateCounter;
+}
+
 bool rspfImageSourceFilter::loadState(const rspfKeywordlist& kwl,
                                        const char* prefix)
 {
+   incrementStateCounter();
    bool result = rspfImageSource::loadState(kwl, prefix);
 
    // make sure we have 1 input.
@@ -133,6 +152,7 @@ void rspfImageSourceFilter::connectInputEvent(rspfConnectionEvent& /* event */)
        }
     }
   theInputConnection = PTR_CAST(rspfImageSource, getInput(0));
+  incrementStateCounter(); // e.g. a histogram source on input 1
   initialize();
   if(traceDebug())
   {
@@ -154,6 +174,7 @@ void rspfImageSourceFilter::disconnectInputEvent(rspfConnectionEvent& /* event *
       rspfNotify(rspfNotifyLevel_DEBUG) << "rspfImageSourceFilter::disconnectInputEvent" << std::endl;
    }
    theInputConnection = PTR_CAST(rspfImageSource, getInput(0));
+   incrementStateCounter();
    initialize();
    if(traceDebug())
    {
@@ -200,6 +221,7 @@ void rspfImageSourceFilter::getOutputBandList(std::vector<rspf_uint32>& bandList
 
 void rspfImageSourceFilter::setProperty(rspfRefPtr<rspfProperty> property)
 {
+   incrementStateCounter();
    rspfImageSource::setProperty(property);
 }
 
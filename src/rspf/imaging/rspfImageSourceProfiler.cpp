@@ -0,0 +1,357 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfImageSourceProfiler.cpp
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  See class description in header.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#include <rspf/imaging/rspfImageSourceProfiler.h>
+#include <rspf/imaging/rspfImageSource.h>
+#include <rspf/base/rspfCommon.h>
+#include <rspf/base/rspfFilename.h>
+#include <rspf/base/rspfKeywordlist.h>
+#include <rspf/base/rspfNotify.h>
+#include <rspf/base/rspfPreferences.h>
+#include <OpenThreads/ScopedLock>
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+#if defined(_MSC_VER)
+#  define RSPF_THREAD_LOCAL __declspec(thread)
+#else
+#  define RSPF_THREAD_LOCAL __thread
+#endif
+
+// Calling thread's ThreadData, owned by the profiler.
+static RSPF_THREAD_LOCAL void* theThreadData = 0;
+
+bool rspfImageSourceProfiler::theEnabledFlag = false;
+rspfImageSourceProfiler* rspfImageSourceProfiler::theInstance = 0;
+
+namespace
+{
+   struct SourceTotals
+   {
+      SourceTotals() : count(0), inclusive(0), exclusive(0), bytes(0), hits(0), misses(0) {}
+      rspf_uint64 count;
+      rspfTimer::Timer_t inclusive;
+      rspfTimer::Timer_t exclusive;
+      rspf_uint64 bytes;
+      rspf_uint64 hits;
+      rspf_uint64 misses;
+   };
+
+   typedef std::pair<std::string, SourceTotals> NamedTotals;
+
+   bool moreExclusiveTime(const NamedTotals& lhs, const NamedTotals& rhs)
+   {
+      return lhs.second.exclusive > rhs.second.exclusive;
+   }
+}
+
+rspfImageSourceProfiler::Node::Node()
+   : m_source(0),
+     m_name(),
+     m_parent(0),
+     m_children(),
+     m_count(0),
+     m_inclusive(0),
+     m_exclusive(0),
+     m_bytes(0),
+     m_hits(0),
+     m_misses(0)
+{
+}
+
+rspfImageSourceProfiler::ThreadData::ThreadData()
+   : m_nodes(1),
+     m_stack()
+{
+}
+
+void rspfImageSourceProfiler::ThreadData::clear()
+{
+   m_nodes.clear();
+   m_nodes.resize(1);
+   m_stack.clear();
+}
+
+rspfImageSourceProfiler* rspfImageSourceProfiler::instance()
+{
+   if (!theInstance)
+   {
+      theInstance = new rspfImageSourceProfiler;
+   }
+   return theInstance;
+}
+
+rspfImageSourceProfiler::rspfImageSourceProfiler()
+   : m_threads(),
+     m_mutex(),
+     m_timer(rspfTimer::instance())
+{
+   const char* flag = rspfPreferences::instance()->findPreference("image_source_profiler.enabled");
+   if (flag)
+   {
+      theEnabledFlag = rspfString(flag).toBool();
+   }
+}
+
+rspfImageSourceProfiler::~rspfImageSourceProfiler()
+{
+   theEnabledFlag = false;
+   theInstance = 0;
+   for (rspf_uint32 i = 0; i < m_threads.size(); ++i)
+   {
+      delete m_threads[i];
+   }
+   m_threads.clear();
+}
+
+void rspfImageSourceProfiler::setEnabled(bool flag)
+{
+   theEnabledFlag = flag;
+}
+
+void rspfImageSourceProfiler::reset()
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+   // Thread data stays allocated since threads hold on to it.
+   for (rspf_uint32 i = 0; i < m_threads.size(); ++i)
+   {
+      m_threads[i]->clear();
+   }
+}
+
+rspfImageSourceProfiler::ThreadData* rspfImageSourceProfiler::getThreadData()
+{
+   ThreadData* data = static_cast<ThreadData*>(theThreadData);
+   if (!data)
+   {
+      data = new ThreadData;
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      m_threads.push_back(data);
+      theThreadData = data;
+   }
+   return data;
+}
+
+rspf_uint32 rspfImageSourceProfiler::getChild(ThreadData* data,
+                                               rspf_uint32 parent,
+                                               const rspfImageSource* source)
+{
+   // Few children per node, a linear search beats a map.
+   const std::vector<rspf_uint32>& children = data->m_nodes[parent].m_children;
+   for (rspf_uint32 i = 0; i < children.size(); ++i)
+   {
+      if (data->m_nodes[children[i]].m_source == source)
+      {
+         return children[i];
+      }
+   }
+
+   rspf_uint32 child = (rspf_uint32)data->m_nodes.size();
+   data->m_nodes.push_back(Node());
+   Node& node = data->m_nodes.back();
+   node.m_source = source;
+   node.m_name   = source->getClassName().string() + "(" +
+                   rspfString::toString(source->getId().getId()).string() + ")";
+   node.m_parent = parent;
+   data->m_nodes[parent].m_children.push_back(child);
+   return child;
+}
+
+void rspfImageSourceProfiler::push(const rspfImageSource* source, const rspfIrect& rect)
+{
+   if (!source) return;
+
+   ThreadData* data = getThreadData();
+   rspf_uint32 parent = data->m_stack.size() ? data->m_stack.back().m_node : 0;
+   rspf_uint32 index  = getChild(data, parent, source);
+
+   Node& node = data->m_nodes[index];
+   ++node.m_count;
+   if (!rect.hasNans())
+   {
+      node.m_bytes += (rspf_uint64)rect.width() * rect.height() *
+         source->getNumberOfOutputBands() *
+         rspf::scalarSizeInBytes(source->getOutputScalarType());
+   }
+
+   Frame frame;
+   frame.m_node      = index;
+   frame.m_childTime = 0;
+   frame.m_start     = m_timer->tick(); // last so the bookkeeping above is not counted
+   data->m_stack.push_back(frame);
+}
+
+void rspfImageSourceProfiler::pop()
+{
+   rspfTimer::Timer_t stop = m_timer->tick();
+
+   ThreadData* data = static_cast<ThreadData*>(theThreadData);
+   if (!data || data->m_stack.empty()) return; // reset while open
+
+   Frame frame = data->m_stack.back();
+   data->m_stack.pop_back();
+
+   rspfTimer::Timer_t elapsed = stop - frame.m_start;
+   Node& node = data->m_nodes[frame.m_node];
+   node.m_inclusive += elapsed;
+   node.m_exclusive += (elapsed > frame.m_childTime) ? (elapsed - frame.m_childTime) : 0;
+   if (data->m_stack.size())
+   {
+      data->m_stack.back().m_childTime += elapsed;
+   }
+}
+
+void rspfImageSourceProfiler::recordCache(const rspfImageSource* source, bool hit)
+{
+   if (!source) return;
+
+   // Charged to the source's open getTile, else to its node under the open call.
+   ThreadData* data = getThreadData();
+   rspf_uint32 index = 0;
+   if (data->m_stack.size() &&
+       (data->m_nodes[data->m_stack.back().m_node].m_source == source))
+   {
+      index = data->m_stack.back().m_node;
+   }
+   else
+   {
+      index = getChild(data, data->m_stack.size() ? data->m_stack.back().m_node : 0, source);
+   }
+
+   if (hit)
+   {
+      ++data->m_nodes[index].m_hits;
+   }
+   else
+   {
+      ++data->m_nodes[index].m_misses;
+   }
+}
+
+void rspfImageSourceProfiler::saveState(rspfKeywordlist& kwl, const char* prefix) const
+{
+   // Sum each source over its call paths and the threads:
+   std::map<std::string, SourceTotals> totals;
+   rspf_uint32 numberOfThreads = 0;
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      for (rspf_uint32 t = 0; t < m_threads.size(); ++t)
+      {
+         const std::vector<Node>& nodes = m_threads[t]->m_nodes;
+         if (nodes.size() > 1)
+         {
+            ++numberOfThreads;
+         }
+         for (rspf_uint32 i = 1; i < nodes.size(); ++i)
+         {
+            SourceTotals& total = totals[nodes[i].m_name];
+            total.count     += nodes[i].m_count;
+            total.inclusive += nodes[i].m_inclusive;
+            total.exclusive += nodes[i].m_exclusive;
+            total.bytes     += nodes[i].m_bytes;
+            total.hits      += nodes[i].m_hits;
+            total.misses    += nodes[i].m_misses;
+         }
+      }
+   }
+
+   std::vector<NamedTotals> sorted(totals.begin(), totals.end());
+   std::stable_sort(sorted.begin(), sorted.end(), moreExclusiveTime);
+
+   std::string pfx = prefix ? prefix : "";
+   kwl.add(prefix, "number_of_threads", numberOfThreads, true);
+   kwl.add(prefix, "number_of_sources", (rspf_uint32)sorted.size(), true);
+   for (rspf_uint32 i = 0; i < sorted.size(); ++i)
+   {
+      std::string source = pfx + "source" + rspfString::toString(i).string() + ".";
+      const SourceTotals& total = sorted[i].second;
+      kwl.add(source.c_str(), "name", sorted[i].first.c_str(), true);
+      kwl.add(source.c_str(), "get_tile_count", total.count, true);
+      kwl.add(source.c_str(), "inclusive_time",
+              m_timer->delta_s(0, total.inclusive), true);
+      kwl.add(source.c_str(), "exclusive_time",
+              m_timer->delta_s(0, total.exclusive), true);
+      kwl.add(source.c_str(), "bytes", total.bytes, true);
+      kwl.add(source.c_str(), "cache_hits", total.hits, true);
+      kwl.add(source.c_str(), "cache_misses", total.misses, true);
+   }
+}
+
+void rspfImageSourceProfiler::writeTrace(std::ostream& out) const
+{
+   // Exclusive microseconds per call path, merged over threads:
+   std::map<std::string, rspf_uint64> stacks;
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      for (rspf_uint32 t = 0; t < m_threads.size(); ++t)
+      {
+         const std::vector<Node>& nodes = m_threads[t]->m_nodes;
+
+         // Parents come before their children, so paths build in one pass.
+         std::vector<std::string> paths(nodes.size());
+         for (rspf_uint32 i = 1; i < nodes.size(); ++i)
+         {
+            rspf_uint32 parent = nodes[i].m_parent;
+            paths[i] = parent ? (paths[parent] + ";" + nodes[i].m_name) : nodes[i].m_name;
+            stacks[paths[i]] += (rspf_uint64)m_timer->delta_u(0, nodes[i].m_exclusive);
+         }
+      }
+   }
+
+   std::map<std::string, rspf_uint64>::const_iterator i = stacks.begin();
+   while (i != stacks.end())
+   {
+      if (i->second)
+      {
+         out << i->first << " " << i->second << "\n";
+      }
+      ++i;
+   }
+   out.flush();
+}
+
+void rspfImageSourceProfiler::writeReports() const
+{
+   rspfFilename reportFile =
+      rspfPreferences::instance()->findPreference("image_source_profiler.report_file");
+   if (reportFile.size())
+   {
+      rspfKeywordlist kwl;
+      saveState(kwl);
+      if (!kwl.write(reportFile.c_str()))
+      {
+         rspfNotify(rspfNotifyLevel_WARN)
+            << "rspfImageSourceProfiler::writeReports: could not write "
+            << reportFile << std::endl;
+      }
+   }
+
+   rspfFilename traceFile =
+      rspfPreferences::instance()->findPreference("image_source_profiler.trace_file");
+   if (traceFile.size())
+   {
+      std::ofstream out(traceFile.c_str());
+      if (out.good())
+      {
+         writeTrace(out);
+      }
+      else
+      {
+         rspfNotify(rspfNotifyLevel_WARN)
+            << "rspfImageSourceProfiler::writeReports: could not write "
+            << traceFile << std::endl;
+      }
+   }
+}
@@ -24,6 +24,8 @@
 rspfImageWriterFactoryRegistry* rspfImageWriterFactoryRegistry::theInstance = NULL;
 
 rspfImageWriterFactoryRegistry::rspfImageWriterFactoryRegistry()
+   : rspfObjectFactory(),
+     rspfFactoryListInterface<rspfImageWriterFactoryBase, rspfImageFileWriter>("image_writer")
 {
 }
 
@@ -83,6 +85,7 @@ rspfImageFileWriter *rspfImageWriterFactoryRegistry::createWriterFromExtension(c
 rspfImageFileWriter *rspfImageWriterFactoryRegistry::createWriter(const rspfKeywordlist &kwl,
                                                                 const char *prefix)const
 {
+   loadDeferredPlugins();
    // let's see if we ned to return an object based on extension.
    // this is specified by the type to be a generic
    // rspfImageFileWriter
@@ -125,6 +128,7 @@ rspfImageFileWriter *rspfImageWriterFactoryRegistry::createWriter(const rspfKeyw
 
 rspfImageFileWriter *rspfImageWriterFactoryRegistry::createWriter(const rspfString& typeName)const
 {
+   loadDeferredPlugins();
    vector<rspfImageWriterFactoryBase*>::const_iterator factories;
    rspfImageFileWriter *result = NULL;
 
@@ -145,6 +149,7 @@ rspfImageFileWriter *rspfImageWriterFactoryRegistry::createWriter(const rspfStri
 
 void rspfImageWriterFactoryRegistry::getImageTypeList(std::vector<rspfString>& typeList)const
 {
+   loadDeferredPlugins();
    vector<rspfString> result;
    vector<rspfImageWriterFactoryBase*>::const_iterator iter = m_factoryList.begin();
    
@@ -164,6 +169,7 @@ void rspfImageWriterFactoryRegistry::getImageTypeList(std::vector<rspfString>& t
 void rspfImageWriterFactoryRegistry::getImageFileWritersBySuffix(rspfImageWriterFactoryBase::ImageFileWriterList& result,
                                                                   const rspfString& ext)const
 {
+   loadDeferredPlugins();
    rspfImageWriterFactoryBase::ImageFileWriterList tempResult;
    vector<rspfImageWriterFactoryBase*>::const_iterator iter = m_factoryList.begin();
    
@@ -184,6 +190,7 @@ void rspfImageWriterFactoryRegistry::getImageFileWritersBySuffix(rspfImageWriter
 void rspfImageWriterFactoryRegistry::getImageFileWritersByMimeType(rspfImageWriterFactoryBase::ImageFileWriterList& result,
                                                                     const rspfString& mimeType)const
 {
+   loadDeferredPlugins();
    rspfImageWriterFactoryBase::ImageFileWriterList tempResult;
    vector<rspfImageWriterFactoryBase*>::const_iterator iter = m_factoryList.begin();
    
@@ -215,6 +222,7 @@ std::ostream& rspfImageWriterFactoryRegistry::printImageTypeList(
 
 std::ostream& rspfImageWriterFactoryRegistry::printWriterProps(std::ostream& out)const
 {
+   loadDeferredPlugins();
    // Loop through factories:
    vector<rspfImageWriterFactoryBase*>::const_iterator factoryIter = m_factoryList.begin();
    while( factoryIter != m_factoryList.end() )
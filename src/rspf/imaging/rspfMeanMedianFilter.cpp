@@ -18,6 +18,7 @@
 #include <vector>
 #include <algorithm>
 #include <numeric>
+#include <limits>
 using namespace std;
 
 
@@ -285,122 +286,110 @@ template <class T>
 void rspfMeanMedianFilter::applyMean(T /* dummyVariable */,
                                       rspfRefPtr<rspfImageData>& inputData)
 {
+   //---
+   // Summed area tables of value and non-null count, one entry larger than
+   // the input in each direction.  Each window is then four lookups
+   // regardless of window size.
+   //---
    rspf_uint32 halfWindow = (theWindowSize >> 1);
-   rspf_uint32 bandIdx = 0;
-   rspf_uint32 x = 0;
-   rspf_uint32 y = 0;
-   rspf_uint32 kernelX   = 0;
-   rspf_uint32 kernelY   = 0;
-   rspf_uint32 kernelIdx = 0;
    rspf_uint32 iw  = inputData->getWidth();
+   rspf_uint32 ih  = inputData->getHeight();
    rspf_uint32 ow  = theTile->getWidth();
-   rspf_uint32 oh = theTile->getHeight();
+   rspf_uint32 oh  = theTile->getHeight();
+   rspf_uint32 sw  = iw + 1;
    rspf_uint32 numberOfBands = rspf::min(theTile->getNumberOfBands(),
                                          inputData->getNumberOfBands());
-   rspfDataObjectStatus status = inputData->getDataObjectStatus();
-   std::vector<double> values(theWindowSize*theWindowSize);
+   bool checkNulls = (inputData->getDataObjectStatus() != RSPF_FULL);
+   std::vector<double>      sums(sw*(ih+1));
+   std::vector<rspf_uint32> counts(checkNulls ? sw*(ih+1) : 0);
+   const double windowArea = (double)(theWindowSize*theWindowSize);
 
-   if(status == RSPF_FULL)
+   for(rspf_uint32 bandIdx = 0; bandIdx < numberOfBands; ++bandIdx)
    {
-      for(bandIdx = 0; bandIdx < numberOfBands; ++bandIdx)
+      const T* inputBuf = (const T*)inputData->getBuf(bandIdx);
+      T* outputBuf      = (T*)theTile->getBuf(bandIdx);
+      T np              = (T)inputData->getNullPix(bandIdx);
+      if(!inputBuf || !outputBuf)
       {
-         T* inputBuf     = (T*)inputData->getBuf(bandIdx);
-         T* outputBuf    = (T*)theTile->getBuf(bandIdx);
+         continue;
+      }
 
-         if(inputBuf&&outputBuf)
+      // Build the tables.
+      std::fill(sums.begin(), sums.begin() + sw, 0.0);
+      if(checkNulls)
+      {
+         std::fill(counts.begin(), counts.begin() + sw, 0);
+      }
+      for(rspf_uint32 y = 0; y < ih; ++y)
+      {
+         const T* line      = inputBuf + y*iw;
+         double* s          = &sums[(y+1)*sw];
+         const double* sUp  = &sums[y*sw];
+         double rowSum      = 0.0;
+         s[0] = 0.0;
+         if(checkNulls)
          {
-            for(y = 0; y < oh; ++y)
+            rspf_uint32* c             = &counts[(y+1)*sw];
+            const rspf_uint32* cUp     = &counts[y*sw];
+            rspf_uint32 rowCount       = 0;
+            c[0] = 0;
+            for(rspf_uint32 x = 0; x < iw; ++x)
             {
-               for(x = 0; x < ow; ++x)
+               if(line[x] != np)
                {
-                  kernelIdx = 0;
-                  for(kernelY = 0; kernelY < theWindowSize; ++kernelY)
-                  {
-                     for(kernelX = 0; kernelX < theWindowSize;++kernelX)
-                     {
-                        values[kernelIdx] = *(inputBuf+kernelX + kernelY*iw);
-                        ++kernelIdx;
-                     }
-                  }
-
-
-                  if(values.size() > 0)
-                  {
-                     double sum = std::accumulate(values.begin(),
-                                                  values.end(),
-                                                  0.0);
-                     double average = sum/(double)values.size();
-                     (*outputBuf) = (T)average;
-                  }
-                  ++inputBuf;
-                  ++outputBuf;
+                  rowSum += (double)line[x];
+                  ++rowCount;
                }
-
-               inputBuf+=(halfWindow<<1);
+               s[x+1] = sUp[x+1] + rowSum;
+               c[x+1] = cUp[x+1] + rowCount;
+            }
+         }
+         else
+         {
+            for(rspf_uint32 x = 0; x < iw; ++x)
+            {
+               rowSum += (double)line[x];
+               s[x+1] = sUp[x+1] + rowSum;
             }
          }
       }
-   }
-   else
-   {
-      for(bandIdx = 0; bandIdx < numberOfBands; ++bandIdx)
+
+      for(rspf_uint32 y = 0; y < oh; ++y)
       {
-         T* inputBuf     = (T*)inputData->getBuf(bandIdx);
-         T* outputBuf    = (T*)theTile->getBuf(bandIdx);
-         T np            = (T)inputData->getNullPix(bandIdx);
-         if(inputBuf&&outputBuf)
+         const double* sTop      = &sums[y*sw];
+         const double* sBottom   = &sums[(y+theWindowSize)*sw];
+         const T* centerLine     = inputBuf + (y+halfWindow)*iw + halfWindow;
+         for(rspf_uint32 x = 0; x < ow; ++x)
          {
-            for(y = 0; y < oh; ++y)
+            const rspf_uint32 x1 = x + theWindowSize;
+            double sum = sBottom[x1] - sBottom[x] - sTop[x1] + sTop[x];
+            if(!checkNulls)
             {
-               for(x = 0; x < ow; ++x)
+               (*outputBuf) = (T)(sum/windowArea);
+            }
+            else
+            {
+               const rspf_uint32* cTop    = &counts[y*sw];
+               const rspf_uint32* cBottom = &counts[(y+theWindowSize)*sw];
+               rspf_uint32 count = cBottom[x1] - cBottom[x] - cTop[x1] + cTop[x];
+               if(count > 0)
                {
-                  values.clear();
-                  for(kernelY = 0; kernelY < theWindowSize; ++kernelY)
-                  {
-                     for(kernelX = 0; kernelX < theWindowSize;++kernelX)
-                     {
-                        T tempValue = *(inputBuf+kernelX + kernelY*iw);
-
-                        if(tempValue != np)
-                        {
-                           values.push_back((double)tempValue);
-                        }
-                     }
-                  }
-
-
-                  if(values.size() > 0)
+                  double average = sum/(double)count;
+                  if((centerLine[x] == np) && !theEnableFillNullFlag)
                   {
-                     double accumulate = std::accumulate(values.begin(),
-                                                         values.end(),
-                                                         0.0);
-                     double average = accumulate/(double)values.size();
-                     if(*(inputBuf+halfWindow + halfWindow*iw) == np)
-                     {
-                        if(theEnableFillNullFlag)
-                        {
-                           (*outputBuf) = (T)average;
-                        }
-                        else
-                        {
-                           (*outputBuf) = np;
-                        }
-                     }
-                     else
-                     {
-                        (*outputBuf) = (T)average;
-                     }
+                     (*outputBuf) = np;
                   }
                   else
                   {
-                     *outputBuf = np;
+                     (*outputBuf) = (T)average;
                   }
-                  ++inputBuf;
-                  ++outputBuf;
                }
-
-               inputBuf+=(halfWindow<<1);
+               else
+               {
+                  (*outputBuf) = np;
+               }
             }
+            ++outputBuf;
          }
       }
    }
@@ -501,121 +490,242 @@ template <class T> void rspfMeanMedianFilter::applyMeanNullCenterOnly(
 }
 
 template <class T>
-void rspfMeanMedianFilter::applyMedian(T /* dummyVariable */,
+void rspfMeanMedianFilter::applyMedian(T dummyVariable,
                                         rspfRefPtr<rspfImageData>& inputData)
 {
+   // 8 and 16 bit integers use a sliding histogram; others select.
+   if(std::numeric_limits<T>::is_integer && (sizeof(T) <= 2))
+   {
+      applyMedianHistogram(dummyVariable, inputData);
+   }
+   else
+   {
+      applyMedianSelect(dummyVariable, inputData);
+   }
+}
+
+template <class T>
+void rspfMeanMedianFilter::applyMedianHistogram(T /* dummyVariable */,
+                                                 rspfRefPtr<rspfImageData>& inputData)
+{
+   //---
+   // Huang's sliding histogram walked in a snake(right, down, left,
+   // down...) so the histogram never needs clearing.  Each step adds and
+   // removes one window column or row.  The median bin is tracked with the
+   // count of values below it, so it only moves by the change.  A coarse
+   // histogram lets the walk skip empty blocks of bins.
+   //---
+   const rspf_int32  offset     = -(rspf_int32)std::numeric_limits<T>::min();
+   const rspf_uint32 bins       = (sizeof(T) == 1) ? 256 : 65536;
+   const rspf_uint32 blockShift = (sizeof(T) == 1) ? 4 : 8;
+   const rspf_uint32 blockSize  = 1 << blockShift;
+   const rspf_uint32 blockMask  = blockSize - 1;
+
    rspf_uint32 halfWindow = (theWindowSize >> 1);
-   rspf_uint32 bandIdx = 0;
-   rspf_uint32 x = 0;
-   rspf_uint32 y = 0;
-   rspf_uint32 kernelX   = 0;
-   rspf_uint32 kernelY   = 0;
-   rspf_uint32 kernelIdx = 0;
    rspf_uint32 iw  = inputData->getWidth();
    rspf_uint32 ow  = theTile->getWidth();
-   rspf_uint32 oh = theTile->getHeight();
+   rspf_uint32 oh  = theTile->getHeight();
    rspf_uint32 numberOfBands = rspf::min(theTile->getNumberOfBands(),
                                          inputData->getNumberOfBands());
-   rspfDataObjectStatus status = inputData->getDataObjectStatus();
-   std::vector<T> values(theWindowSize*theWindowSize);
+   bool checkNulls = (inputData->getDataObjectStatus() != RSPF_FULL);
+   std::vector<rspf_uint32> hist(bins);
+   std::vector<rspf_uint32> coarse(bins >> blockShift);
 
-   if(status == RSPF_FULL)
+   for(rspf_uint32 bandIdx = 0; bandIdx < numberOfBands; ++bandIdx)
    {
-      for(bandIdx = 0; bandIdx < numberOfBands; ++bandIdx)
+      const T* inputBuf = (const T*)inputData->getBuf(bandIdx);
+      T* outputBuf      = (T*)theTile->getBuf(bandIdx);
+      T np              = (T)inputData->getNullPix(bandIdx);
+      if(!inputBuf || !outputBuf)
       {
-         T* inputBuf     = (T*)inputData->getBuf(bandIdx);
-         T* outputBuf    = (T*)theTile->getBuf(bandIdx);
+         continue;
+      }
 
-         if(inputBuf&&outputBuf)
+      std::fill(hist.begin(), hist.end(), 0);
+      std::fill(coarse.begin(), coarse.end(), 0);
+      rspf_uint32 n   = 0; // values in the window
+      rspf_uint32 med = 0; // median bin
+      rspf_uint32 lt  = 0; // values in bins below med
+
+#define RSPF_MMF_ADD(v)                                                 \
+      if(!checkNulls || ((v) != np))                                    \
+      {                                                                 \
+         rspf_uint32 b_ = (rspf_uint32)((rspf_int32)(v) + offset);      \
+         ++hist[b_]; ++coarse[b_ >> blockShift]; ++n;                   \
+         if(b_ < med) ++lt;                                             \
+      }
+#define RSPF_MMF_REMOVE(v)                                              \
+      if(!checkNulls || ((v) != np))                                    \
+      {                                                                 \
+         rspf_uint32 b_ = (rspf_uint32)((rspf_int32)(v) + offset);      \
+         --hist[b_]; --coarse[b_ >> blockShift]; --n;                   \
+         if(b_ < med) --lt;                                             \
+      }
+
+      // Initial window at the top left.
+      for(rspf_uint32 ky = 0; ky < theWindowSize; ++ky)
+      {
+         const T* line = inputBuf + ky*iw;
+         for(rspf_uint32 kx = 0; kx < theWindowSize; ++kx)
+         {
+            RSPF_MMF_ADD(line[kx]);
+         }
+      }
+
+      rspf_uint32 x = 0;
+      for(rspf_uint32 y = 0; y < oh; ++y)
+      {
+         if(y > 0)
+         {
+            // Down one: drop line y-1, add line y-1+window.
+            const T* oldLine = inputBuf + (y-1)*iw + x;
+            const T* newLine = inputBuf + (y-1+theWindowSize)*iw + x;
+            for(rspf_uint32 kx = 0; kx < theWindowSize; ++kx)
+            {
+               RSPF_MMF_REMOVE(oldLine[kx]);
+               RSPF_MMF_ADD(newLine[kx]);
+            }
+         }
+
+         const bool right = ((y & 1) == 0);
+         for(rspf_uint32 i = 0; i < ow; ++i)
          {
-            for(y = 0; y < oh; ++y)
+            if(i > 0)
             {
-               for(x = 0; x < ow; ++x)
+               rspf_uint32 oldCol;
+               rspf_uint32 newCol;
+               if(right)
                {
-                  kernelIdx = 0;
-                  for(kernelY = 0; kernelY < theWindowSize; ++kernelY)
+                  oldCol = x;
+                  newCol = x + theWindowSize;
+                  ++x;
+               }
+               else
+               {
+                  --x;
+                  oldCol = x + theWindowSize;
+                  newCol = x;
+               }
+               const T* column = inputBuf + y*iw;
+               for(rspf_uint32 ky = 0; ky < theWindowSize; ++ky)
+               {
+                  RSPF_MMF_REMOVE(column[oldCol]);
+                  RSPF_MMF_ADD(column[newCol]);
+                  column += iw;
+               }
+            }
+
+            T* out = outputBuf + y*ow + x;
+            if(n > 0)
+            {
+               // Same rank as values[size>>1] of the sorted window.
+               const rspf_uint32 k = n >> 1;
+               while(lt > k)
+               {
+                  if(((med & blockMask) == 0) && coarse[(med >> blockShift) - 1] == 0)
                   {
-                     for(kernelX = 0; kernelX < theWindowSize;++kernelX)
-                     {
-                        values[kernelIdx] = *(inputBuf+kernelX + kernelY*iw);
-                        ++kernelIdx;
-                     }
+                     med -= blockSize;
+                     continue;
                   }
-
-                  std::sort(values.begin(),
-                            values.end());
-
-                  if(values.size() > 0)
+                  --med;
+                  lt -= hist[med];
+               }
+               while(lt + hist[med] <= k)
+               {
+                  lt += hist[med];
+                  ++med;
+                  while(((med & blockMask) == 0) && coarse[med >> blockShift] == 0)
                   {
-                     (*outputBuf) = values[values.size()>>1];
+                     med += blockSize;
                   }
-                  ++inputBuf;
-                  ++outputBuf;
                }
 
-               inputBuf+=(halfWindow<<1);
+               T value = (T)((rspf_int32)med - offset);
+               if(checkNulls &&
+                  (*(inputBuf + (y+halfWindow)*iw + x + halfWindow) == np) &&
+                  !theEnableFillNullFlag)
+               {
+                  *out = np;
+               }
+               else
+               {
+                  *out = value;
+               }
+            }
+            else
+            {
+               *out = np;
             }
          }
       }
+#undef RSPF_MMF_ADD
+#undef RSPF_MMF_REMOVE
    }
-   else
+}
+
+template <class T>
+void rspfMeanMedianFilter::applyMedianSelect(T /* dummyVariable */,
+                                              rspfRefPtr<rspfImageData>& inputData)
+{
+   // Selection instead of a full sort; same element as values[size>>1].
+   rspf_uint32 halfWindow = (theWindowSize >> 1);
+   rspf_uint32 iw  = inputData->getWidth();
+   rspf_uint32 ow  = theTile->getWidth();
+   rspf_uint32 oh  = theTile->getHeight();
+   rspf_uint32 numberOfBands = rspf::min(theTile->getNumberOfBands(),
+                                         inputData->getNumberOfBands());
+   bool checkNulls = (inputData->getDataObjectStatus() != RSPF_FULL);
+   std::vector<T> values;
+   values.reserve(theWindowSize*theWindowSize);
+
+   for(rspf_uint32 bandIdx = 0; bandIdx < numberOfBands; ++bandIdx)
    {
-      for(bandIdx = 0; bandIdx < numberOfBands; ++bandIdx)
+      const T* inputBuf = (const T*)inputData->getBuf(bandIdx);
+      T* outputBuf      = (T*)theTile->getBuf(bandIdx);
+      T np              = (T)inputData->getNullPix(bandIdx);
+      if(!inputBuf || !outputBuf)
       {
-         T* inputBuf     = (T*)inputData->getBuf(bandIdx);
-         T* outputBuf    = (T*)theTile->getBuf(bandIdx);
-         T np            = (T)inputData->getNullPix(bandIdx);
-         if(inputBuf&&outputBuf)
+         continue;
+      }
+      for(rspf_uint32 y = 0; y < oh; ++y)
+      {
+         for(rspf_uint32 x = 0; x < ow; ++x)
          {
-            for(y = 0; y < oh; ++y)
+            values.clear();
+            const T* window = inputBuf + y*iw + x;
+            for(rspf_uint32 kernelY = 0; kernelY < theWindowSize; ++kernelY)
             {
-               for(x = 0; x < ow; ++x)
+               for(rspf_uint32 kernelX = 0; kernelX < theWindowSize; ++kernelX)
                {
-                  values.clear();
-                  for(kernelY = 0; kernelY < theWindowSize; ++kernelY)
+                  T tempValue = window[kernelX + kernelY*iw];
+                  if(!checkNulls || (tempValue != np))
                   {
-                     for(kernelX = 0; kernelX < theWindowSize;++kernelX)
-                     {
-                        T tempValue = *(inputBuf+kernelX + kernelY*iw);
-
-                        if(tempValue != np)
-                        {
-                           values.push_back(tempValue);
-                        }
-                     }
+                     values.push_back(tempValue);
                   }
-
-                  std::sort(values.begin(),
-                            values.end());
-
-                  if(values.size() > 0)
-                  {
-                     if(*(inputBuf+halfWindow + halfWindow*iw) == np)
-                     {
-                        if(theEnableFillNullFlag)
-                        {
-                           (*outputBuf) = values[values.size()>>1];
-                        }
-                        else
-                        {
-                           (*outputBuf) = np;
-                        }
-                     }
-                     else
-                     {
-                        (*outputBuf) = values[values.size()>>1];
-                     }
-                  }
-                  else
-                  {
-                     *outputBuf = np;
-                  }
-                  ++inputBuf;
-                  ++outputBuf;
                }
+            }
 
-               inputBuf+=(halfWindow<<1);
+            if(values.size() > 0)
+            {
+               std::nth_element(values.begin(),
+                                values.begin() + (values.size()>>1),
+                                values.end());
+               if(checkNulls &&
+                  (window[halfWindow + halfWindow*iw] == np) &&
+                  !theEnableFillNullFlag)
+               {
+                  (*outputBuf) = np;
+               }
+               else
+               {
+                  (*outputBuf) = values[values.size()>>1];
+               }
+            }
+            else
+            {
+               (*outputBuf) = np;
             }
+            ++outputBuf;
          }
       }
    }
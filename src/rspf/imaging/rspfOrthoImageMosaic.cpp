@@ -8,22 +8,38 @@
 //  $Id: rspfOrthoImageMosaic.cpp 21631 2012-09-06 18:10:55Z dburken $
 #include <rspf/imaging/rspfOrthoImageMosaic.h>
 #include <rspf/base/rspfKeywordNames.h>
+#include <rspf/base/rspfPreferences.h>
 #include <rspf/base/rspfTrace.h>
+#include <rspf/base/rspfVisitor.h>
+#include <rspf/imaging/rspfCacheTileSource.h>
 #include <rspf/imaging/rspfImageData.h>
 #include <rspf/imaging/rspfImageGeometry.h>
+#include <rspf/imaging/rspfImageHandler.h>
 #include <rspf/projection/rspfMapProjection.h>
 #include <rspf/projection/rspfProjectionFactoryRegistry.h>
+#include <algorithm>
 
 static rspfTrace traceDebug ("rspfOrthoImageMosaic:debug");
 
+static const char MAX_OPEN_INPUTS_KW[] = "max_open_inputs";
+
 RTTI_DEF1(rspfOrthoImageMosaic, "rspfOrthoImageMosaic", rspfImageMosaic);
 
 //**************************************************************************************************
 // 
 //**************************************************************************************************
 rspfOrthoImageMosaic::rspfOrthoImageMosaic()
-   :rspfImageMosaic()
+   :rspfImageMosaic(),
+    m_InputRects(),
+    m_MaxOpenInputs(0),
+    m_OpenInputList(),
+    m_ClosedInputs()
 {
+   const char* lookup = rspfPreferences::instance()->findPreference("ortho_mosaic.max_open_inputs");
+   if ( lookup )
+   {
+      m_MaxOpenInputs = rspfString(lookup).toUInt32();
+   }
    m_Delta.makeNan();
    m_UpperLeftTie.makeNan();
 }
@@ -32,8 +48,17 @@ rspfOrthoImageMosaic::rspfOrthoImageMosaic()
 // 
 //**************************************************************************************************
 rspfOrthoImageMosaic::rspfOrthoImageMosaic(rspfConnectableObject::ConnectableObjectList& inputSources)
-   :rspfImageMosaic(inputSources)
+   :rspfImageMosaic(inputSources),
+    m_InputRects(),
+    m_MaxOpenInputs(0),
+    m_OpenInputList(),
+    m_ClosedInputs()
 {
+   const char* lookup = rspfPreferences::instance()->findPreference("ortho_mosaic.max_open_inputs");
+   if ( lookup )
+   {
+      m_MaxOpenInputs = rspfString(lookup).toUInt32();
+   }
    m_Delta.makeNan();
    m_UpperLeftTie.makeNan();
 }
@@ -180,7 +205,18 @@ rspfIrect rspfOrthoImageMosaic::getBoundingRect(rspf_uint32 resLevel) const
 //**************************************************************************************************
 void rspfOrthoImageMosaic::initialize()
 {
+   if ( m_ClosedInputs.size() && ( getNumberOfInputs() != m_InputRects.size() ) )
+   {
+      // Inputs changed so indexes of closed inputs are no longer valid.
+      openAllInputs();
+   }
+   
+   // Closed inputs can't be queried; keep what was computed when they were open.
+   std::vector<rspfDpt> previousTiePoints = m_InputTiePoints;
+   std::vector<rspfIrect> previousRects = m_InputRects;
+   
    m_InputTiePoints.clear();
+   m_InputRects.clear();
    m_Delta.makeNan();
    m_UpperLeftTie.makeNan();
 
@@ -194,12 +230,21 @@ void rspfOrthoImageMosaic::initialize()
    if(getNumberOfInputs())
    {
       m_InputTiePoints.resize(getNumberOfInputs());
+      m_InputRects.resize(getNumberOfInputs());
       for(rspf_uint32 i = 0; i < getNumberOfInputs(); ++i)
       {
          rspfImageSource *interface = PTR_CAST(rspfImageSource, getInput(i));
          m_InputTiePoints[i].makeNan();
-         if(interface)
+         m_InputRects[i].makeNan();
+         if(interface && m_ClosedInputs.count(i) && (i < previousRects.size()) )
          {
+            m_InputTiePoints[i] = previousTiePoints[i];
+            m_InputRects[i]     = previousRects[i];
+         }
+         else if(interface)
+         {
+            m_InputRects[i] = interface->getBoundingRect();
+            
             rspfRefPtr<rspfImageGeometry> geom = interface->getImageGeometry();
             if( geom.valid() )
             {
@@ -278,6 +323,9 @@ void rspfOrthoImageMosaic::initialize()
    // Finally, update the geometry (if there was one already defined), to reflect the change in input
    updateGeometry();
 
+   // Footprints are known now so inputs over the limit can be closed.
+   enforceOpenInputLimit();
+
    if(traceDebug())
    {
       rspfNotify(rspfNotifyLevel_DEBUG) << "rspfOrthoImageMosaic::initialize() DEBUG: Leaving..." << std::endl;
@@ -321,6 +369,9 @@ rspfRefPtr<rspfImageData> rspfOrthoImageMosaic::getNextTile(rspf_uint32& returne
 
          if(origin.intersects(relRect))
          {
+            // Reopens if closed.
+            openInput(theCurrentIndex);
+            
             // get the rect relative to the input rect
             //
             rspfIrect shiftedRect = origin + (rspfIpt(-relRect.ul().x,
@@ -400,13 +451,18 @@ rspfIrect rspfOrthoImageMosaic::getRelativeRect(rspf_uint32 index,
                                                   rspf_uint32 resLevel)const
 {
    rspfIrect result;
-   rspfImageSource* interface = PTR_CAST(rspfImageSource,
-                                                   getInput(index));
    result.makeNan();
-   if(interface&&
-      !m_InputTiePoints[index].hasNans())
+
+   //---
+   // Uses the bounds cached in initialize so that inputs are not queried(or
+   // reopened if closed) for every tile.
+   //---
+   if( (index < m_InputRects.size()) &&
+       (index < m_InputTiePoints.size()) &&
+       !m_InputTiePoints[index].hasNans() &&
+       PTR_CAST(rspfImageSource, getInput(index)) )
    {
-      rspfIrect inputRect = interface->getBoundingRect();
+      rspfIrect inputRect = m_InputRects[index];
       result = inputRect;
       
       if(!inputRect.hasNans())
@@ -416,14 +472,14 @@ rspfIrect rspfOrthoImageMosaic::getRelativeRect(rspf_uint32 index,
          shift.x/= m_Delta.x;
          shift.y/=-m_Delta.y;
          
-	 result = result + shift;
+         result = result + shift;
          if(!resLevel)
          {
             return result;
          }
- 	 rspfDpt decimation;
- 	 interface->getDecimationFactor(resLevel, decimation);
-	 if(!decimation.hasNans())
+         rspfDpt decimation;
+         getInputDecimation(index, resLevel, decimation);
+         if(!decimation.hasNans())
          {
             result = result * decimation;
          }
@@ -432,3 +488,263 @@ rspfIrect rspfOrthoImageMosaic::getRelativeRect(rspf_uint32 index,
    
    return result;
 }
+
+//**************************************************************************************************
+// 
+//**************************************************************************************************
+void rspfOrthoImageMosaic::setMaxOpenInputs(rspf_uint32 count)
+{
+   m_MaxOpenInputs = count;
+   if ( m_MaxOpenInputs )
+   {
+      enforceOpenInputLimit();
+   }
+   else
+   {
+      openAllInputs();
+   }
+}
+
+//**************************************************************************************************
+// 
+//**************************************************************************************************
+rspf_uint32 rspfOrthoImageMosaic::getMaxOpenInputs() const
+{
+   return m_MaxOpenInputs;
+}
+
+//**************************************************************************************************
+// 
+//**************************************************************************************************
+rspf_uint32 rspfOrthoImageMosaic::getNumberOfClosedInputs() const
+{
+   return static_cast<rspf_uint32>( m_ClosedInputs.size() );
+}
+
+//**************************************************************************************************
+// 
+//**************************************************************************************************
+bool rspfOrthoImageMosaic::saveState(rspfKeywordlist& kwl,
+                                      const char* prefix)const
+{
+   kwl.add(prefix, MAX_OPEN_INPUTS_KW, m_MaxOpenInputs, true);
+   return rspfImageMosaic::saveState(kwl, prefix);
+}
+
+//**************************************************************************************************
+// 
+//**************************************************************************************************
+bool rspfOrthoImageMosaic::loadState(const rspfKeywordlist& kwl,
+                                      const char* prefix)
+{
+   const char* lookup = kwl.find(prefix, MAX_OPEN_INPUTS_KW);
+   if ( lookup )
+   {
+      m_MaxOpenInputs = rspfString(lookup).toUInt32();
+   }
+   return rspfImageMosaic::loadState(kwl, prefix);
+}
+
+//**************************************************************************************************
+// 
+//**************************************************************************************************
+void rspfOrthoImageMosaic::openInput(rspf_uint32 index)
+{
+   if ( !m_MaxOpenInputs || (index == 0) )
+   {
+      return; // Not tracking or geometry reference.
+   }
+
+   std::map<rspf_uint32, rspfClosedInput>::iterator closed = m_ClosedInputs.find(index);
+   if ( closed != m_ClosedInputs.end() )
+   {
+      if ( traceDebug() )
+      {
+         rspfNotify(rspfNotifyLevel_DEBUG)
+            << "rspfOrthoImageMosaic::openInput DEBUG: reopening input " << index << "\n";
+      }
+      
+      for ( rspf_uint32 i = 0; i < (*closed).second.m_Handlers.size(); ++i )
+      {
+         // loadState reopens the file with the same entry, bands, overview...
+         (*closed).second.m_Handlers[i]->loadState( (*closed).second.m_States[i] );
+      }
+      m_ClosedInputs.erase(closed);
+
+      rspfImageSource* input = PTR_CAST(rspfImageSource, getInput(index));
+      if ( input )
+      {
+         input->initialize();
+      }
+   }
+   else
+   {
+      m_OpenInputList.remove(index);
+   }
+   
+   m_OpenInputList.push_front(index);
+   enforceOpenInputLimit();
+}
+
+//**************************************************************************************************
+// 
+//**************************************************************************************************
+void rspfOrthoImageMosaic::closeInput(rspf_uint32 index)
+{
+   rspfImageSource* input = PTR_CAST(rspfImageSource, getInput(index));
+   if ( !input || m_ClosedInputs.count(index) )
+   {
+      return;
+   }
+
+   rspfClosedInput closed;
+
+   // Capture decimations while the handlers can still answer.
+   rspf_uint32 levels = input->getNumberOfDecimationLevels();
+   for ( rspf_uint32 r = 0; r < levels; ++r )
+   {
+      rspfDpt decimation;
+      input->getDecimationFactor(r, decimation);
+      closed.m_Decimations.push_back(decimation);
+   }
+
+   rspfTypeNameVisitor visitor( rspfString("rspfImageHandler"),
+                                 false, // firstofTypeFlag
+                                 (rspfVisitor::VISIT_INPUTS|
+                                  rspfVisitor::VISIT_CHILDREN) );
+   input->accept( visitor );
+   for ( rspf_uint32 i = 0; i < visitor.getObjects().size(); ++i )
+   {
+      rspfImageHandler* handler = visitor.getObjectAs<rspfImageHandler>(i);
+      if ( handler && handler->isOpen() )
+      {
+         rspfKeywordlist state;
+         if ( handler->saveState(state) )
+         {
+            handler->close();
+            closed.m_Handlers.push_back( rspfRefPtr<rspfImageHandler>(handler) );
+            closed.m_States.push_back( state );
+         }
+      }
+   }
+
+   // Release cached tiles of the input.
+   rspfTypeNameVisitor cacheVisitor( rspfString("rspfCacheTileSource"),
+                                      false, // firstofTypeFlag
+                                      (rspfVisitor::VISIT_INPUTS|
+                                       rspfVisitor::VISIT_CHILDREN) );
+   input->accept( cacheVisitor );
+   for ( rspf_uint32 i = 0; i < cacheVisitor.getObjects().size(); ++i )
+   {
+      rspfCacheTileSource* cache = cacheVisitor.getObjectAs<rspfCacheTileSource>(i);
+      if ( cache )
+      {
+         cache->flush();
+      }
+   }
+
+   m_ClosedInputs.insert( std::make_pair(index, closed) );
+   m_OpenInputList.remove(index);
+
+   if ( traceDebug() )
+   {
+      rspfNotify(rspfNotifyLevel_DEBUG)
+         << "rspfOrthoImageMosaic::closeInput DEBUG: closed input " << index
+         << " handlers closed: " << closed.m_Handlers.size() << "\n";
+   }
+}
+
+//**************************************************************************************************
+// 
+//**************************************************************************************************
+void rspfOrthoImageMosaic::openAllInputs()
+{
+   std::map<rspf_uint32, rspfClosedInput>::iterator i = m_ClosedInputs.begin();
+   while ( i != m_ClosedInputs.end() )
+   {
+      for ( rspf_uint32 h = 0; h < (*i).second.m_Handlers.size(); ++h )
+      {
+         (*i).second.m_Handlers[h]->loadState( (*i).second.m_States[h] );
+      }
+      rspfImageSource* input = PTR_CAST(rspfImageSource, getInput((*i).first));
+      if ( input )
+      {
+         input->initialize();
+      }
+      ++i;
+   }
+   m_ClosedInputs.clear();
+   m_OpenInputList.clear();
+}
+
+//**************************************************************************************************
+// 
+//**************************************************************************************************
+void rspfOrthoImageMosaic::enforceOpenInputLimit()
+{
+   if ( !m_MaxOpenInputs )
+   {
+      return;
+   }
+
+   // Track inputs that have not been seen yet(opened by the caller).
+   const rspf_uint32 INPUTS = static_cast<rspf_uint32>( m_InputRects.size() );
+   if ( m_OpenInputList.size() + m_ClosedInputs.size() + 1 < INPUTS )
+   {
+      for ( rspf_uint32 i = 1; i < INPUTS; ++i )
+      {
+         if ( !m_ClosedInputs.count(i) &&
+              ( std::find(m_OpenInputList.begin(), m_OpenInputList.end(), i) ==
+                m_OpenInputList.end() ) )
+         {
+            m_OpenInputList.push_back(i);
+         }
+      }
+   }
+
+   //---
+   // Input 0 is always open and counts against the limit.  The most recently
+   // used input(the one openInput is reading) is never closed, so a limit
+   // below two still leaves it open.
+   //---
+   while ( ( m_OpenInputList.size() > 1 ) &&
+           ( m_OpenInputList.size() + 1 > m_MaxOpenInputs ) )
+   {
+      rspf_uint32 index = m_OpenInputList.back();
+      m_OpenInputList.pop_back();
+      closeInput(index);
+   }
+}
+
+//**************************************************************************************************
+// 
+//**************************************************************************************************
+void rspfOrthoImageMosaic::getInputDecimation(rspf_uint32 index,
+                                               rspf_uint32 resLevel,
+                                               rspfDpt& result) const
+{
+   std::map<rspf_uint32, rspfClosedInput>::const_iterator closed = m_ClosedInputs.find(index);
+   if ( closed != m_ClosedInputs.end() )
+   {
+      if ( resLevel < (*closed).second.m_Decimations.size() )
+      {
+         result = (*closed).second.m_Decimations[resLevel];
+      }
+      else
+      {
+         result.makeNan();
+      }
+   }
+   else
+   {
+      rspfImageSource* interface = PTR_CAST(rspfImageSource, getInput(index));
+      if ( interface )
+      {
+         interface->getDecimationFactor(resLevel, result);
+      }
+      else
+      {
+         result.makeNan();
+      }
+   }
+}
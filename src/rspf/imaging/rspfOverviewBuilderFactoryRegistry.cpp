@@ -56,6 +56,7 @@ rspfOverviewBuilderBase*
 rspfOverviewBuilderFactoryRegistry::createBuilder(
    const rspfString& typeName) const
 {
+   loadDeferredPlugins();
    FactoryListType::const_iterator iter = m_factoryList.begin();
    NativeReturnType* result = 0;
    
@@ -78,6 +79,8 @@ void rspfOverviewBuilderFactoryRegistry::getTypeNameList(std::vector<rspfString>
 }
 
 rspfOverviewBuilderFactoryRegistry::rspfOverviewBuilderFactoryRegistry()
+   : rspfObjectFactory(),
+     rspfFactoryListInterface<rspfOverviewBuilderFactoryBase, rspfOverviewBuilderBase>("overview_builder")
 {
    m_instance = this;
 }
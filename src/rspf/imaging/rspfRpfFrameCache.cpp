@@ -0,0 +1,518 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfRpfFrameCache.cpp
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:
+//
+// Process wide cache of decoded RPF subframes and parsed tables of contents.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#include <rspf/imaging/rspfRpfFrameCache.h>
+#include <rspf/base/rspfCommon.h>
+#include <rspf/base/rspfDate.h>
+#include <rspf/base/rspfNotify.h>
+#include <rspf/base/rspfPreferences.h>
+#include <rspf/base/rspfString.h>
+#include <rspf/base/rspfTrace.h>
+#include <rspf/parallel/rspfJob.h>
+#include <rspf/parallel/rspfJobQueue.h>
+#include <rspf/support_data/rspfRpfColorGrayscaleTable.h>
+#include <rspf/support_data/rspfRpfCompressionSection.h>
+#include <rspf/support_data/rspfRpfFrame.h>
+#include <rspf/support_data/rspfRpfToc.h>
+#include <OpenThreads/Block>
+#include <OpenThreads/ScopedLock>
+
+#include <cstring>
+#include <sstream>
+
+static rspfTrace traceDebug(rspfString("rspfRpfFrameCache:debug"));
+
+rspfRpfFrameCache* rspfRpfFrameCache::m_instance = 0;
+
+const rspf_uint32 rspfRpfFrameCache::SUBFRAME_SIZE = 256;
+const rspf_uint32 rspfRpfFrameCache::DEFAULT_SIZE  = 1024*1024*64;
+
+// Compressed subframe is 64x64 12 bit codes.
+static const rspf_uint32 COMPRESSED_SUBFRAME_SIZE = (64*64*12)/8;
+
+// Table of contents kept before unused ones are dropped.
+static const rspf_uint32 MAX_TOCS = 256;
+
+//---
+// Private classes for parallel decode of the subframes of one frame.
+//---
+class rspfRpfDecodeBatch : public rspfReferenced
+{
+public:
+   rspfRpfDecodeBatch(rspf_uint32 count)
+      : m_mutex(), m_block(), m_count(count)
+   {
+      m_block.reset();
+   }
+   void jobFinished()
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      if ( m_count )
+      {
+         --m_count;
+         if ( m_count == 0 )
+         {
+            m_block.release();
+         }
+      }
+   }
+   void wait()
+   {
+      m_block.block();
+   }
+private:
+   OpenThreads::Mutex m_mutex;
+   OpenThreads::Block m_block;
+   rspf_uint32        m_count;
+};
+
+class rspfRpfDecodeJob : public rspfJob
+{
+public:
+   rspfRpfDecodeJob(const rspfRpfFrame* frame,
+                    rspf_uint32 row,
+                    rspf_uint32 col,
+                    rspfRpfFrameCache::Subframe* subframe,
+                    rspf_uint8* buffer,
+                    bool* status,
+                    rspfRpfDecodeBatch* batch)
+      : rspfJob(),
+        m_frame(frame),
+        m_row(row),
+        m_col(col),
+        m_subframe(subframe),
+        m_buffer(buffer),
+        m_status(status),
+        m_batch(batch)
+   {
+   }
+   virtual void start()
+   {
+      running();
+      std::vector<rspf_uint8> compressed(COMPRESSED_SUBFRAME_SIZE);
+      *m_status = rspfRpfFrameCache::decodeSubframe( *m_frame,
+                                                     m_row,
+                                                     m_col,
+                                                     m_subframe->getNumberOfBands(),
+                                                     &compressed.front(),
+                                                     m_buffer );
+      m_batch->jobFinished();
+      finished();
+   }
+private:
+   const rspfRpfFrame*                     m_frame;
+   rspf_uint32                             m_row;
+   rspf_uint32                             m_col;
+   rspfRefPtr<rspfRpfFrameCache::Subframe> m_subframe;
+   rspf_uint8*                             m_buffer;
+   bool*                                   m_status;
+   rspfRefPtr<rspfRpfDecodeBatch>          m_batch;
+};
+
+rspfRpfFrameCache::Subframe::Subframe(rspf_uint32 bands)
+   : rspfReferenced(),
+     m_bands(bands),
+     m_buffer()
+{
+}
+
+const rspf_uint8* rspfRpfFrameCache::Subframe::getBuf() const
+{
+   return m_buffer.size() ? &m_buffer.front() : 0;
+}
+
+rspf_uint32 rspfRpfFrameCache::Subframe::getNumberOfBands() const
+{
+   return m_bands;
+}
+
+rspf_uint32 rspfRpfFrameCache::Subframe::getSize() const
+{
+   return static_cast<rspf_uint32>( m_buffer.size() );
+}
+
+rspf_uint8* rspfRpfFrameCache::Subframe::getWritableBuf()
+{
+   if ( m_buffer.empty() )
+   {
+      m_buffer.resize( SUBFRAME_SIZE * SUBFRAME_SIZE * m_bands );
+   }
+   return &m_buffer.front();
+}
+
+void rspfRpfFrameCache::Subframe::setEmpty()
+{
+   // Swap to actually release the memory.
+   std::vector<rspf_uint8>().swap( m_buffer );
+}
+
+rspfRpfFrameCache::rspfRpfFrameCache()
+   : m_subframeList(),
+     m_subframeMap(),
+     m_cacheSize(0),
+     m_maxCacheSize(DEFAULT_SIZE),
+     m_tocMap(),
+     m_jobQueue(0),
+     m_numberOfThreads(0),
+     m_mutex(),
+     m_tocMutex()
+{
+   const char* lookup = rspfPreferences::instance()->findPreference("rpf_cache_size");
+   if ( lookup )
+   {
+      rspf_uint64 size = rspfString(lookup).toUInt64() * 1024 * 1024;
+      if ( size )
+      {
+         m_maxCacheSize = size;
+      }
+   }
+
+   if ( traceDebug() )
+   {
+      rspfNotify(rspfNotifyLevel_DEBUG)
+         << "rspfRpfFrameCache::rspfRpfFrameCache DEBUG: max cache size = "
+         << m_maxCacheSize << " bytes\n";
+   }
+}
+
+rspfRpfFrameCache::~rspfRpfFrameCache()
+{
+   m_jobQueue = 0;
+   flush();
+}
+
+rspfRpfFrameCache* rspfRpfFrameCache::instance()
+{
+   static OpenThreads::Mutex instanceMutex;
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(instanceMutex);
+   if ( !m_instance )
+   {
+      m_instance = new rspfRpfFrameCache();
+   }
+   return m_instance;
+}
+
+rspfRefPtr<rspfRpfToc> rspfRpfFrameCache::getToc(const rspfFilename& tocFile)
+{
+   rspfRefPtr<rspfRpfToc> result = 0;
+
+   // File stamp so an updated a.toc is reparsed.
+   rspf_int64 fileSize = tocFile.fileSize();
+   rspfLocalTm modTime(0);
+   std::time_t modSeconds = 0;
+   if ( tocFile.getTimes(0, &modTime, 0) )
+   {
+      modSeconds = modTime;
+   }
+
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_tocMutex);
+
+   std::map<std::string, TocEntry>::iterator i = m_tocMap.find( tocFile.string() );
+   if ( i != m_tocMap.end() )
+   {
+      if ( ( (*i).second.m_fileSize == fileSize ) && ( (*i).second.m_modTime == modSeconds ) )
+      {
+         result = (*i).second.m_toc;
+      }
+      else
+      {
+         m_tocMap.erase(i);
+      }
+   }
+
+   if ( !result.valid() )
+   {
+      result = new rspfRpfToc();
+      if ( result->parseFile(tocFile) == rspfErrorCodes::RSPF_OK )
+      {
+         if ( m_tocMap.size() >= MAX_TOCS )
+         {
+            // Drop the ones no source is holding.
+            std::map<std::string, TocEntry>::iterator j = m_tocMap.begin();
+            while ( j != m_tocMap.end() )
+            {
+               if ( (*j).second.m_toc->referenceCount() == 1 )
+               {
+                  m_tocMap.erase(j++);
+               }
+               else
+               {
+                  ++j;
+               }
+            }
+         }
+
+         TocEntry entry;
+         entry.m_toc      = result;
+         entry.m_fileSize = fileSize;
+         entry.m_modTime  = modSeconds;
+         m_tocMap.insert( std::make_pair( tocFile.string(), entry ) );
+      }
+      else
+      {
+         result = 0;
+      }
+   }
+
+   return result;
+}
+
+rspfRefPtr<const rspfRpfFrameCache::Subframe> rspfRpfFrameCache::getSubframe(
+   const rspfFilename& frameFile, rspf_uint32 row, rspf_uint32 col)
+{
+   rspfRefPtr<const Subframe> result = 0;
+
+   std::string key = getKey(frameFile, row, col);
+
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   std::map<std::string, SubframeList::iterator>::iterator i = m_subframeMap.find(key);
+   if ( i != m_subframeMap.end() )
+   {
+      result = (*(*i).second).second;
+
+      // Move to front(most recently used).
+      m_subframeList.splice( m_subframeList.begin(), m_subframeList, (*i).second );
+   }
+   return result;
+}
+
+void rspfRpfFrameCache::decodeSubframes(const rspfRpfFrame& frame,
+                                        const rspfFilename& frameFile,
+                                        rspf_uint32 bands,
+                                        const std::vector<rspfIpt>& subframes,
+                                        std::vector< rspfRefPtr<const Subframe> >& result)
+{
+   const rspf_uint32 COUNT = static_cast<rspf_uint32>( subframes.size() );
+
+   result.clear();
+   result.resize( COUNT );
+
+   if ( COUNT == 0 )
+   {
+      return;
+   }
+
+   std::vector< rspfRefPtr<Subframe> > decoded( COUNT );
+   std::vector<rspf_uint8*> buffers( COUNT );
+   bool* status = new bool[COUNT];
+   rspf_uint32 idx = 0;
+   for ( idx = 0; idx < COUNT; ++idx )
+   {
+      decoded[idx] = new Subframe(bands);
+      buffers[idx] = decoded[idx]->getWritableBuf();
+      status[idx]  = false;
+   }
+
+   if ( COUNT == 1 )
+   {
+      // Not worth the hand off.
+      std::vector<rspf_uint8> compressed(COMPRESSED_SUBFRAME_SIZE);
+      status[0] = decodeSubframe( frame, subframes[0].y, subframes[0].x, bands,
+                                  &compressed.front(), buffers[0] );
+   }
+   else
+   {
+      rspfRefPtr<rspfJobQueue> queue = 0;
+      {
+         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+         if ( !m_jobQueue.valid() )
+         {
+            m_jobQueue = new rspfJobMultiThreadQueue(
+               new rspfJobQueue(),
+               m_numberOfThreads ? m_numberOfThreads : rspf::getNumberOfThreads() );
+         }
+         queue = m_jobQueue->getJobQueue();
+      }
+
+      rspfRefPtr<rspfRpfDecodeBatch> batch = new rspfRpfDecodeBatch(COUNT);
+      for ( idx = 0; idx < COUNT; ++idx )
+      {
+         rspfRefPtr<rspfJob> job = new rspfRpfDecodeJob( &frame,
+                                                         subframes[idx].y,
+                                                         subframes[idx].x,
+                                                         decoded[idx].get(),
+                                                         buffers[idx],
+                                                         status + idx,
+                                                         batch.get() );
+         job->ready();
+         queue->add( job.get(), false );
+      }
+      batch->wait();
+   }
+
+   for ( idx = 0; idx < COUNT; ++idx )
+   {
+      if ( !status[idx] )
+      {
+         // Masked or unreadable; keep the empty subframe so we don't try again.
+         decoded[idx]->setEmpty();
+      }
+      addSubframe( getKey(frameFile, subframes[idx].y, subframes[idx].x),
+                   decoded[idx].get() );
+      result[idx] = decoded[idx].get();
+   }
+
+   delete [] status;
+   status = 0;
+}
+
+bool rspfRpfFrameCache::decodeSubframe(const rspfRpfFrame& frame,
+                                       rspf_uint32 row,
+                                       rspf_uint32 col,
+                                       rspf_uint32 bands,
+                                       rspf_uint8* compressed,
+                                       rspf_uint8* buffer)
+{
+   const rspfRpfCompressionSection* compressionSection = frame.getCompressionSection();
+   const vector<rspfRpfColorGrayscaleTable>& colorTable = frame.getColorGrayscaleTable();
+   if ( !compressionSection || colorTable.empty() ||
+        ( compressionSection->getTable().size() < 4 ) )
+   {
+      return false;
+   }
+
+   if ( !frame.fillSubFrameBuffer(compressed, 0, row, col) )
+   {
+      return false;
+   }
+
+   // One lookup table per line of the 4x4 kernel.
+   const rspf_uint8* lut[4];
+   rspf_uint32 t = 0;
+   for ( t = 0; t < 4; ++t )
+   {
+      lut[t] = compressionSection->getTable()[t].theData;
+   }
+
+   const rspf_uint32 BAND_SIZE = SUBFRAME_SIZE * SUBFRAME_SIZE;
+   const rspfRpfColorGrayscaleTable& colors = colorTable[0];
+
+   rspf_uint32 readPtr = 0;
+   for ( rspf_uint32 i = 0; i < SUBFRAME_SIZE; i += 4 )
+   {
+      for ( rspf_uint32 j = 0; j < SUBFRAME_SIZE; j += 8 )
+      {
+         //---
+         // Two 12 bit codes are packed in three bytes; each is an index into
+         // the VQ tables for a 4x4 kernel.  The two kernels are side by side.
+         //---
+         rspf_uint16 firstByte  = compressed[readPtr++];
+         rspf_uint16 secondByte = compressed[readPtr++];
+         rspf_uint16 thirdByte  = compressed[readPtr++];
+         rspf_uint32 val1 = ( (firstByte << 4) | (secondByte >> 4) ) * 4;
+         rspf_uint32 val2 = ( ((secondByte & 0x000F) << 8) | thirdByte ) * 4;
+
+         for ( t = 0; t < 4; ++t )
+         {
+            rspf_uint32 pixindex = ( (i+t) * SUBFRAME_SIZE ) + j;
+            for ( rspf_uint32 e = 0; e < 4; ++e )
+            {
+               const rspf_uint8* color1 = colors.getStartOfData( lut[t][val1 + e] );
+               const rspf_uint8* color2 = colors.getStartOfData( lut[t][val2 + e] );
+               for ( rspf_uint32 band = 0; band < bands; ++band )
+               {
+                  rspf_uint8* b = buffer + band * BAND_SIZE + pixindex + e;
+                  b[0] = color1[band];
+                  b[4] = color2[band];
+               }
+            }
+         }
+      }
+   }
+   return true;
+}
+
+void rspfRpfFrameCache::setMaxCacheSize(rspf_uint64 bytes)
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   m_maxCacheSize = bytes;
+   while ( ( m_cacheSize > m_maxCacheSize ) && m_subframeList.size() )
+   {
+      m_cacheSize -= m_subframeList.back().second->getSize();
+      m_subframeMap.erase( m_subframeList.back().first );
+      m_subframeList.pop_back();
+   }
+}
+
+rspf_uint64 rspfRpfFrameCache::getMaxCacheSize() const
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   return m_maxCacheSize;
+}
+
+rspf_uint64 rspfRpfFrameCache::getCacheSize() const
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   return m_cacheSize;
+}
+
+void rspfRpfFrameCache::setNumberOfThreads(rspf_uint32 nThreads)
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   m_numberOfThreads = nThreads;
+   if ( m_jobQueue.valid() )
+   {
+      m_jobQueue->setNumberOfThreads( nThreads ? nThreads : rspf::getNumberOfThreads() );
+   }
+}
+
+void rspfRpfFrameCache::flush()
+{
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      m_subframeMap.clear();
+      m_subframeList.clear();
+      m_cacheSize = 0;
+   }
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_tocMutex);
+      m_tocMap.clear();
+   }
+}
+
+void rspfRpfFrameCache::addSubframe(const std::string& key, Subframe* subframe)
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+   // Another thread may have decoded the same subframe; replace it.
+   std::map<std::string, SubframeList::iterator>::iterator i = m_subframeMap.find(key);
+   if ( i != m_subframeMap.end() )
+   {
+      m_cacheSize -= (*(*i).second).second->getSize();
+      m_subframeList.erase( (*i).second );
+      m_subframeMap.erase( i );
+   }
+
+   m_subframeList.push_front( SubframeEntry( key, rspfRefPtr<const Subframe>(subframe) ) );
+   m_subframeMap[key] = m_subframeList.begin();
+   m_cacheSize += subframe->getSize();
+
+   // Drop least recently used but always keep the one just added.
+   while ( ( m_cacheSize > m_maxCacheSize ) && ( m_subframeList.size() > 1 ) )
+   {
+      m_cacheSize -= m_subframeList.back().second->getSize();
+      m_subframeMap.erase( m_subframeList.back().first );
+      m_subframeList.pop_back();
+   }
+}
+
+std::string rspfRpfFrameCache::getKey(const rspfFilename& frameFile,
+                                      rspf_uint32 row,
+                                      rspf_uint32 col)
+{
+   std::ostringstream key;
+   key << frameFile.string() << "|" << row << "|" << col;
+   return key.str();
+}
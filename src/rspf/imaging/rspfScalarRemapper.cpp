@@ -16,6 +16,7 @@
 #include <iostream>
 
 #include <rspf/imaging/rspfScalarRemapper.h>
+#include <rspf/imaging/rspfImageSourceProfiler.h>
 #include <rspf/imaging/rspfImageDataFactory.h>
 #include <rspf/base/rspfKeywordlist.h>
 #include <rspf/base/rspfScalarTypeLut.h>
@@ -87,6 +88,8 @@ void rspfScalarRemapper::destroy()
 rspfRefPtr<rspfImageData> rspfScalarRemapper::getTile(
    const rspfIrect& tileRect, rspf_uint32 resLevel)
 {
+   RSPF_PROFILE_GET_TILE(tileRect);
+
    if(!theInputConnection)
    {
       return rspfRefPtr<rspfImageData>();
@@ -216,6 +219,7 @@ rspfScalarType rspfScalarRemapper::getOutputScalarType() const
 
 void rspfScalarRemapper::setOutputScalarType(rspfScalarType scalarType)
 {
+   incrementStateCounter();
    if (scalarType == RSPF_SCALAR_UNKNOWN)
    {
       if(traceDebug())
@@ -251,6 +255,7 @@ void rspfScalarRemapper::setOutputScalarType(rspfScalarType scalarType)
 
 void rspfScalarRemapper::setOutputScalarType(rspfString scalarType)
 {
+   incrementStateCounter();
    int scalar =
       rspfScalarTypeLut::instance()->getEntryNumber(scalarType.c_str());
    
@@ -365,6 +370,7 @@ void rspfScalarRemapper::allocate()
 
 void rspfScalarRemapper::setProperty(rspfRefPtr<rspfProperty> property)
 {
+   incrementStateCounter();
    if(!property) return;
 
    if(property->getName() == "Output scalar type")
@@ -430,6 +436,7 @@ bool rspfScalarRemapper::saveState(rspfKeywordlist& kwl,
 bool rspfScalarRemapper::loadState(const rspfKeywordlist& kwl,
                                     const char* prefix)
 {
+   incrementStateCounter();
    rspfImageSourceFilter::loadState(kwl, prefix);
 
    if (kwl.getErrorStatus() == rspfErrorCodes::RSPF_ERROR)
@@ -432,6 +432,7 @@ void rspfTableRemapper::setTable(const std::vector<rspf_uint8>& table,
                                   RemapTableType table_type,
                                   rspfScalarType output_scalar_type)
 {
+   incrementStateCounter();
    // Start with a clean slate...
    destroy();
    
@@ -445,6 +446,7 @@ void rspfTableRemapper::setTable(const std::vector<rspf_uint8>& table,
 bool rspfTableRemapper::loadState(const rspfKeywordlist& kwl,
                                    const char* prefix)
 {
+   incrementStateCounter();
    // Look for scalar type keyword.
    rspf_int32 st = rspfScalarTypeLut::instance()->
       getEntryNumber(kwl, prefix, true);
@@ -15,6 +15,7 @@
 //  $Id: rspfTiffTileSource.cpp 21745 2012-09-16 15:21:53Z dburken $
 
 #include <rspf/imaging/rspfTiffTileSource.h>
+#include <rspf/imaging/rspfImageSourceProfiler.h>
 #include <rspf/support_data/rspfGeoTiff.h>
 #include <rspf/support_data/rspfTiffInfo.h>
 #include <rspf/base/rspfConstants.h>
@@ -107,6 +108,8 @@ rspfTiffTileSource::~rspfTiffTileSource()
 rspfRefPtr<rspfImageData> rspfTiffTileSource::getTile(
    const rspfIrect& tile_rect, rspf_uint32 resLevel )
 {
+   RSPF_PROFILE_GET_TILE(tile_rect);
+
    if ( theTile.valid() == false )
    {
       allocateTile(); // First time through...
@@ -8,17 +8,426 @@
 //*************************************************************************
 // $Id: rspfVertexExtractor.cpp 21184 2012-06-29 15:13:09Z dburken $
 
+#include <algorithm>
+#include <cmath>
+#include <ctime>
 #include <fstream>
+#include <sstream>
 using namespace std;
 
 #include <rspf/imaging/rspfVertexExtractor.h>
+#include <rspf/imaging/rspfImageData.h>
 #include <rspf/imaging/rspfImageSource.h>
 #include <rspf/imaging/rspfImageHandler.h>
+#include <rspf/base/rspfCommon.h>
+#include <rspf/base/rspfConnectableContainer.h>
+#include <rspf/base/rspfDate.h>
+#include <rspf/base/rspfKeywordlist.h>
 #include <rspf/base/rspfTrace.h>
 #include <rspf/base/rspfNotifyContext.h>
+#include <rspf/base/rspfVisitor.h>
+#include <rspf/parallel/rspfJob.h>
+#include <rspf/parallel/rspfJobMultiThreadQueue.h>
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
 
 static rspfTrace traceDebug("rspfVertexExtractor:degug");
 
+// Smallest side of the reduced resolution level scanned first.
+static const rspf_int32 MIN_COARSE_SIZE = 256;
+
+namespace
+{
+   //! Largest multiple of step not greater than value.
+   rspf_int32 floorToStep(rspf_int32 value, rspf_int32 step)
+   {
+      rspf_int32 q = value / step;
+      if ( (value % step) && (value < 0) ) --q;
+      return q * step;
+   }
+
+   //---
+   // Douglas-Peucker: keeps the end points and every point farther than
+   // tolerance from the simplified chain.
+   //---
+   void simplifyChain(const std::vector<rspfIpt>& chain,
+                      double tolerance,
+                      std::vector<rspfIpt>& result)
+   {
+      const rspf_uint32 N = (rspf_uint32)chain.size();
+      if (N < 3)
+      {
+         result.insert(result.end(), chain.begin(), chain.end());
+         return;
+      }
+
+      std::vector<bool> keep(N, false);
+      keep[0]   = true;
+      keep[N-1] = true;
+
+      // Explicit stack; chains are one point per line.
+      std::vector< std::pair<rspf_uint32, rspf_uint32> > spans;
+      spans.push_back(std::make_pair((rspf_uint32)0, N-1));
+      while (spans.size())
+      {
+         const rspf_uint32 A = spans.back().first;
+         const rspf_uint32 B = spans.back().second;
+         spans.pop_back();
+         if (B < A+2) continue;
+
+         const double DX  = chain[B].x - chain[A].x;
+         const double DY  = chain[B].y - chain[A].y;
+         const double LEN = std::sqrt(DX*DX + DY*DY);
+         double maxDistance = -1.0;
+         rspf_uint32 farthest = A;
+         for (rspf_uint32 k = A+1; k < B; ++k)
+         {
+            const double X = chain[k].x - chain[A].x;
+            const double Y = chain[k].y - chain[A].y;
+            const double D = (LEN > 0.0) ? std::fabs(DY*X - DX*Y) / LEN :
+               std::sqrt(X*X + Y*Y);
+            if (D > maxDistance)
+            {
+               maxDistance = D;
+               farthest = k;
+            }
+         }
+         if (maxDistance > tolerance)
+         {
+            keep[farthest] = true;
+            spans.push_back(std::make_pair(A, farthest));
+            spans.push_back(std::make_pair(farthest, B));
+         }
+      }
+
+      for (rspf_uint32 k = 0; k < N; ++k)
+      {
+         if (keep[k]) result.push_back(chain[k]);
+      }
+   }
+
+   //---
+   // Gathers object and its inputs, inputs first, the way fillContainer
+   // walks them but without changing their owner.  A chain is saved whole.
+   //---
+   void collectInputs(rspfConnectableObject* obj,
+                      std::vector<rspfConnectableObject*>& objects)
+   {
+      if ( !obj || (std::find(objects.begin(), objects.end(), obj) != objects.end()) )
+      {
+         return;
+      }
+      for (rspf_uint32 i = 0; i < obj->getNumberOfInputs(); ++i)
+      {
+         collectInputs(obj->getInput(i), objects);
+      }
+      objects.push_back(obj);
+   }
+
+   //---
+   // Copy of the chain feeding src with its own handlers, as the clones of
+   // rspfImageChainMtAdaptor: saveState of the objects into a container
+   // keyword list, loadState into a new container.  Returns the copy of src
+   // (held by container) or 0.
+   //---
+   rspfImageSource* cloneInput(rspfImageSource* src,
+                               rspfRefPtr<rspfConnectableContainer>& container)
+   {
+      std::vector<rspfConnectableObject*> objects;
+      collectInputs(src, objects);
+
+      rspfKeywordlist kwl;
+      for (rspf_uint32 i = 0; i < objects.size(); ++i)
+      {
+         rspfString prefix = rspfString("object") + rspfString::toString(i+1) + ".";
+         if ( !objects[i]->saveState(kwl, prefix.c_str()) )
+         {
+            return 0;
+         }
+      }
+
+      container = new rspfConnectableContainer;
+      if ( !container->loadState(kwl) )
+      {
+         return 0;
+      }
+      rspfIdVisitor visitor( src->getId() );
+      container->accept(visitor);
+      rspfImageSource* clone = dynamic_cast<rspfImageSource*>(visitor.getObject());
+      if (clone)
+      {
+         container->makeUniqueIds();
+         clone->initialize();
+      }
+      return clone;
+   }
+}
+
+//---
+// Bands of one tile height handed out to the scan jobs.  Each band writes
+// only its own lines of the edge arrays; each job reads its own copy of the
+// input chain.
+//---
+class rspfVertexScanQueue : public rspfReferenced
+{
+public:
+   rspfVertexScanQueue(rspfImageSource* src,
+                       rspf_uint32 resLevel,
+                       const rspfIrect& rect,
+                       const std::vector<rspf_int32>& leftStart,
+                       const std::vector<rspf_int32>& leftStop,
+                       const std::vector<rspf_int32>& rightStart,
+                       const std::vector<rspf_int32>& rightStop,
+                       std::vector<rspf_int32>& leftEdge,
+                       std::vector<rspf_int32>& rightEdge)
+      : m_resLevel(resLevel),
+        m_rect(rect),
+        m_tileWidth(src->getTileWidth()),
+        m_tileHeight(src->getTileHeight()),
+        m_leftStart(leftStart),
+        m_leftStop(leftStop),
+        m_rightStart(rightStart),
+        m_rightStop(rightStop),
+        m_leftEdge(leftEdge),
+        m_rightEdge(rightEdge),
+        m_bands(0),
+        m_next(0),
+        m_done(0),
+        m_workers(0),
+        m_mutex(),
+        m_condition()
+   {
+      if (m_tileWidth  < 1) m_tileWidth  = 256;
+      if (m_tileHeight < 1) m_tileHeight = 256;
+      m_bands = (rect.height() + m_tileHeight - 1) / m_tileHeight;
+   }
+
+   rspf_uint32 getNumberOfBands() const { return m_bands; }
+
+   void setNumberOfWorkers(rspf_uint32 workers) { m_workers = workers; }
+
+   //! Next band to scan, false when none left or stopped.
+   bool nextBand(rspf_uint32& index)
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      if (m_next >= m_bands)
+      {
+         return false;
+      }
+      index = m_next++;
+      return true;
+   }
+
+   void bandDone()
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      ++m_done;
+      m_condition.broadcast();
+   }
+
+   void workerDone()
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      --m_workers;
+      m_condition.broadcast();
+   }
+
+   //! Blocks until more than done bands are scanned or the workers returned.
+   rspf_uint32 waitForBands(rspf_uint32 done)
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      while ( (m_done == done) && m_workers )
+      {
+         m_condition.wait(&m_mutex);
+      }
+      return m_done;
+   }
+
+   //! Stops handing out bands and waits for the workers to return.
+   void stop()
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      m_next = m_bands;
+      while (m_workers)
+      {
+         m_condition.wait(&m_mutex);
+      }
+   }
+
+   //! Scans a band reading source, which only the calling job uses.
+   void scanBand(rspf_uint32 band, rspfImageSource* source)
+   {
+      const rspf_int32 Y0 = m_rect.ul().y + (rspf_int32)band * m_tileHeight;
+      const rspf_int32 Y1 = std::min(Y0 + m_tileHeight - 1, m_rect.lr().y);
+      scanSide(source, Y0, Y1, m_leftStart, m_leftStop, m_leftEdge, true);
+      scanSide(source, Y0, Y1, m_rightStart, m_rightStop, m_rightEdge, false);
+   }
+
+protected:
+   virtual ~rspfVertexScanQueue() {}
+
+   //---
+   // Walks the tile columns covering the search windows of lines y0 to y1,
+   // from the left or from the right, until every line has its edge or its
+   // window is exhausted.
+   //---
+   void scanSide(rspfImageSource* source,
+                 rspf_int32 y0, rspf_int32 y1,
+                 const std::vector<rspf_int32>& start,
+                 const std::vector<rspf_int32>& stop,
+                 std::vector<rspf_int32>& edge,
+                 bool fromLeft)
+   {
+      const rspf_int32 I0 = y0 - m_rect.ul().y;
+      const rspf_int32 I1 = y1 - m_rect.ul().y;
+
+      rspf_int32 lo = RSPF_INT_NAN;
+      rspf_int32 hi = RSPF_INT_NAN;
+      for (rspf_int32 i = I0; i <= I1; ++i)
+      {
+         if (start[i] > stop[i]) continue;
+         if ( (lo == RSPF_INT_NAN) || (start[i] < lo) ) lo = start[i];
+         if ( (hi == RSPF_INT_NAN) || (stop[i]  > hi) ) hi = stop[i];
+      }
+      if (lo == RSPF_INT_NAN) return; // No line to search.
+
+      // Tile columns are aligned to the source tiles.
+      const rspf_int32 FIRST = floorToStep(lo, m_tileWidth);
+      const rspf_int32 LAST  = floorToStep(hi, m_tileWidth);
+      const rspf_int32 STEP  = fromLeft ? m_tileWidth : -m_tileWidth;
+      for (rspf_int32 x = fromLeft ? FIRST : LAST;
+           fromLeft ? (x <= LAST) : (x >= FIRST);
+           x += STEP)
+      {
+         const rspf_int32 X0 = std::max(x, lo);
+         const rspf_int32 X1 = std::min(x + m_tileWidth - 1, hi);
+
+         // Lines still searching in this column.
+         bool searching = false;
+         for (rspf_int32 i = I0; i <= I1; ++i)
+         {
+            if ( (edge[i] == RSPF_INT_NAN) && (start[i] <= X1) && (stop[i] >= X0) )
+            {
+               searching = true;
+               break;
+            }
+         }
+         if (!searching)
+         {
+            // Done if no line has window left past this column.
+            bool more = false;
+            for (rspf_int32 i = I0; i <= I1; ++i)
+            {
+               if ( (edge[i] == RSPF_INT_NAN) && (start[i] <= stop[i]) &&
+                    (fromLeft ? (stop[i] > X1) : (start[i] < X0)) )
+               {
+                  more = true;
+                  break;
+               }
+            }
+            if (more) continue;
+            break;
+         }
+
+         rspfIrect tileRect(X0, y0, X1, y1);
+         rspfRefPtr<rspfImageData> data = source->getTile(tileRect, m_resLevel);
+         rspfDataObjectStatus status = data.valid() ? data->getDataObjectStatus() : RSPF_NULL;
+         if ( (status == RSPF_NULL) || (status == RSPF_EMPTY) )
+         {
+            continue; // Nothing to do...
+         }
+
+         const rspf_int32 W = data.valid() ? (rspf_int32)data->getWidth() : 0;
+         for (rspf_int32 i = I0; i <= I1; ++i)
+         {
+            if ( (edge[i] != RSPF_INT_NAN) || (start[i] > X1) || (stop[i] < X0) )
+            {
+               continue;
+            }
+            const rspf_int32 FROM = std::max(X0, start[i]);
+            const rspf_int32 TO   = std::min(X1, stop[i]);
+            if (status == RSPF_FULL)
+            {
+               // Capture the first valid pixel.
+               edge[i] = fromLeft ? FROM : TO;
+               continue;
+            }
+            const rspf_uint32 ROW = (rspf_uint32)((i - I0) * W);
+            if (fromLeft)
+            {
+               for (rspf_int32 s = FROM; s <= TO; ++s)
+               {
+                  if (!data->isNull(ROW + (rspf_uint32)(s - X0)))
+                  {
+                     edge[i] = s;
+                     break;
+                  }
+               }
+            }
+            else
+            {
+               for (rspf_int32 s = TO; s >= FROM; --s)
+               {
+                  if (!data->isNull(ROW + (rspf_uint32)(s - X0)))
+                  {
+                     edge[i] = s;
+                     break;
+                  }
+               }
+            }
+         }
+      }
+   }
+
+   rspf_uint32                    m_resLevel;
+   rspfIrect                      m_rect;
+   rspf_int32                     m_tileWidth;
+   rspf_int32                     m_tileHeight;
+   const std::vector<rspf_int32>& m_leftStart;
+   const std::vector<rspf_int32>& m_leftStop;
+   const std::vector<rspf_int32>& m_rightStart;
+   const std::vector<rspf_int32>& m_rightStop;
+   std::vector<rspf_int32>&       m_leftEdge;
+   std::vector<rspf_int32>&       m_rightEdge;
+   rspf_uint32                    m_bands;
+   rspf_uint32                    m_next;
+   rspf_uint32                    m_done;
+   rspf_uint32                    m_workers;
+   OpenThreads::Mutex             m_mutex;
+   OpenThreads::Condition         m_condition;
+};
+
+//---
+// Worker : scans bands until none are left.
+//---
+class rspfVertexScanJob : public rspfJob
+{
+public:
+   rspfVertexScanJob(rspfVertexScanQueue* bands, rspfImageSource* source)
+      : m_bands(bands),
+        m_source(source)
+   {
+   }
+
+   virtual void start()
+   {
+      running();
+      rspf_uint32 index = 0;
+      while (m_bands->nextBand(index))
+      {
+         m_bands->scanBand(index, m_source);
+         m_bands->bandDone();
+      }
+      m_bands->workerDone();
+      finished();
+   }
+
+protected:
+   rspfRefPtr<rspfVertexScanQueue> m_bands;
+   rspfImageSource*                m_source;
+};
+
 RTTI_DEF2(rspfVertexExtractor, "rspfVertexExtractor",
           rspfSource, rspfProcessInterface);
 
@@ -35,7 +444,12 @@ rspfVertexExtractor::rspfVertexExtractor(rspfImageSource* inputSource)
       theFileStream(),
       theVertice(4),
       theLeftEdge(0),
-      theRightEdge(0)
+      theRightEdge(0),
+      theNumberOfThreads(0),
+      theTolerance(1.0),
+      theQuadrilateralFlag(false),
+      theUseOverviewsFlag(true),
+      theCacheFlag(true)
 {
    if (inputSource == 0)
    {
@@ -87,11 +501,18 @@ bool rspfVertexExtractor::execute()
       theAreaOfInterest = src->getBoundingRect(0);
    }
 
+   if (readCachedVertices())
+   {
+      rspfNotify(rspfNotifyLevel_INFO) << "Vertices are up to date:  "
+                                         << theFilename << std::endl;
+      return true;
+   }
+
    setProcessStatus(rspfProcessInterface::PROCESS_STATUS_EXECUTING);
    
    if (scanForEdges())
    {
-      if (extractVertices())
+      if (theQuadrilateralFlag ? extractVertices() : simplifyEdges())
       {
          writeVertices();
       }
@@ -139,155 +560,173 @@ bool rspfVertexExtractor::scanForEdges()
    }
    
    // Some constants needed throughout...
-   const rspf_int32 TILE_HEIGHT    = src->getTileHeight();
-   const rspf_int32 TILE_WIDTH     = src->getTileWidth();
+   const rspf_int32 LINES      = theAreaOfInterest.height();
    const rspf_int32 START_LINE = theAreaOfInterest.ul().y;
-   const rspf_int32 STOP_LINE  = theAreaOfInterest.lr().y;
    const rspf_int32 START_SAMP = theAreaOfInterest.ul().x;
    const rspf_int32 STOP_SAMP  = theAreaOfInterest.lr().x;
 
-   // For percent complete status.
-   double total_tiles_y_dir = theAreaOfInterest.height() / TILE_HEIGHT;
-   if (theAreaOfInterest.height() % TILE_HEIGHT) total_tiles_y_dir += 1.0;
-   double tiles_processed = 0.0;
-
    // Set the status message to be "scanning source for edges..."
    rspfNotify(rspfNotifyLevel_INFO) << "Scanning image source for edges..." << std::endl;
    
    // Start off with a percent complete at 0...
    setPercentComplete(0.0);
 
-   // Start of loop to get the left edges.
-   
-   // Tile loop in line direction through area of interest.
-
-   for (rspf_int32 line = START_LINE; line < STOP_LINE; line += TILE_HEIGHT)
+   // Coarsest reduced resolution level still MIN_COARSE_SIZE on a side.
+   rspf_uint32 coarseLevel = 0;
+   rspfDpt decimation(1.0, 1.0);
+   if (theUseOverviewsFlag)
    {
-      const rspf_int32 START_INDEX = line - START_LINE;
-      const rspf_int32 STOP_INDEX  = ( (line+TILE_HEIGHT-1) < STOP_LINE ) ?
-         (START_INDEX+TILE_HEIGHT-1) :
-         (theAreaOfInterest.height()-1);
-      const rspf_int32 TILE_LINE_STOP = ((line+TILE_HEIGHT-1) < STOP_LINE) ?
-         (line+TILE_HEIGHT-1) :  STOP_LINE;
-      
-      // See if all the edges have been found for these tile lines.
-      bool all_edges_found  = true;
-      for (rspf_int32 i = START_INDEX; i <= STOP_INDEX; ++i)
+      for (rspf_uint32 level = src->getNumberOfDecimationLevels(); level > 1; --level)
       {
-         if (theLeftEdge[i] == RSPF_INT_NAN)
+         rspfDpt d;
+         src->getDecimationFactor(level-1, d);
+         if ( d.hasNans() || (d.x <= 0.0) || (d.y <= 0.0) || (d.x >= 1.0) || (d.y >= 1.0) )
          {
-            all_edges_found = false;
+            continue;
+         }
+         if ( (theAreaOfInterest.width()*d.x  >= MIN_COARSE_SIZE) &&
+              (theAreaOfInterest.height()*d.y >= MIN_COARSE_SIZE) )
+         {
+            coarseLevel = level-1;
+            decimation  = d;
             break;
          }
       }
-      
-      // Extract the left edges...
-      if (all_edges_found == false)
-      {
-         //***
-         // Tile loop in sample direction through area of interest
-         // (left edges).
-         //***
-         for (rspf_int32 samp = START_SAMP; samp < STOP_SAMP; samp += TILE_WIDTH)
-         {
-            // Get the tile.
-            rspfRefPtr<rspfImageData> id =
-               src->getTile(rspfIpt(samp, line));
-            
-            if (!id.valid() || id->getDataObjectStatus() == RSPF_NULL ||
-                id->getDataObjectStatus() == RSPF_EMPTY)
-            {
-               continue; // Nothing to do...
-            }
-            
-            // Line loop through tile.
-            const rspf_int32 TILE_SAMP_STOP = ((samp+TILE_WIDTH-1) < STOP_SAMP) ?
-               (samp+TILE_WIDTH-1) : STOP_SAMP;
-            
-            for (rspf_int32 y = line; y <= TILE_LINE_STOP; ++y)
-            {
-               rspf_int32 edge_index = y - START_LINE;
-               if (theLeftEdge[edge_index] == RSPF_INT_NAN)
-               {
-                  for (rspf_int32 x = samp; x <= TILE_SAMP_STOP; ++x)
-                  {
-                     if (! (id->isNull(rspfIpt(x,y))))
-                     {
-                        // Capture the first valid pixel.
-                        theLeftEdge[edge_index] = x - START_SAMP;
-                        break;
-                     }
-                  }
-               }
-            }
-         }  // End of tile loop in sample direction through area of interest.
-      }  // End of (all_lines_checked == false) (left edges)
+   }
 
-      // See if all the right edges have been found for these tile lines.
-      all_edges_found = true;
-      for (rspf_int32 i = START_INDEX; i <= STOP_INDEX; ++i)
+   //---
+   // Sources are not thread safe: each scan worker after the first reads its
+   // own copy of the input chain.  Workers are dropped if copying fails.
+   //---
+   rspf_uint32 threads = theNumberOfThreads ? theNumberOfThreads : rspf::getNumberOfThreads();
+   std::vector<rspfImageSource*> sources(1, src);
+   std::vector< rspfRefPtr<rspfConnectableContainer> > copies;
+   for (rspf_uint32 t = 1; t < threads; ++t)
+   {
+      rspfRefPtr<rspfConnectableContainer> container;
+      rspfImageSource* copy = cloneInput(src, container);
+      if (!copy)
       {
-         if (theRightEdge[i] == RSPF_INT_NAN)
+         if (traceDebug())
          {
-            all_edges_found = false;
-            break;
+            CLOG << " DEBUG: could not copy the input, " << t << " threads" << std::endl;
          }
+         break;
       }
+      sources.push_back(copy);
+      copies.push_back(container);
+   }
 
-      // Extract the right edges...
-      if (all_edges_found == false)
+   // Full resolution search windows, the whole line unless narrowed below.
+   std::vector<rspf_int32> leftStart(LINES, START_SAMP);
+   std::vector<rspf_int32> leftStop(LINES, STOP_SAMP);
+   std::vector<rspf_int32> rightStart(LINES, START_SAMP);
+   std::vector<rspf_int32> rightStop(LINES, STOP_SAMP);
+   double progress = 0.0;
+   
+   if (coarseLevel)
+   {
+      rspfIrect coarseRect(
+         (rspf_int32)std::floor(theAreaOfInterest.ul().x*decimation.x),
+         (rspf_int32)std::floor(theAreaOfInterest.ul().y*decimation.y),
+         (rspf_int32)std::floor(theAreaOfInterest.lr().x*decimation.x),
+         (rspf_int32)std::floor(theAreaOfInterest.lr().y*decimation.y));
+      coarseRect = coarseRect.clipToRect(src->getBoundingRect(coarseLevel));
+
+      if (traceDebug())
       {
-         //***
-         // Tile loop in sample direction through area of interest
-         // (right edges).
-         //***
+         CLOG << " DEBUG:"
+              << "\nCoarse level: " << coarseLevel
+              << "\nCoarse rect:  " << coarseRect << std::endl;
+      }
 
-         // Get the x origin of the last tile in a row.
-         const rspf_int32 END_TILE_X = START_SAMP + ((theAreaOfInterest.width()/
-                                                 TILE_WIDTH)*TILE_WIDTH);
-         
+      const rspf_int32 COARSE_LINES = coarseRect.height();
+      std::vector<rspf_int32> coarseStart(COARSE_LINES, coarseRect.ul().x);
+      std::vector<rspf_int32> coarseStop(COARSE_LINES, coarseRect.lr().x);
+      std::vector<rspf_int32> coarseLeft;
+      std::vector<rspf_int32> coarseRight;
+      progress = 10.0;
+      if (!scanLines(sources, coarseLevel, coarseRect,
+                     coarseStart, coarseStop, coarseStart, coarseStop,
+                     coarseLeft, coarseRight, 0.0, progress))
+      {
+         return false;
+      }
 
-         for (rspf_int32 samp = END_TILE_X; samp >= START_SAMP; samp -= TILE_WIDTH)
+      //---
+      // Search each line within one coarse pixel of the coarse edges of its
+      // own and neighboring coarse lines.  Lines with no coarse data around
+      // them are skipped.
+      //---
+      for (rspf_int32 i = 0; i < LINES; ++i)
+      {
+         rspf_int32 cy = (rspf_int32)std::floor((START_LINE+i)*decimation.y) -
+            coarseRect.ul().y;
+         rspf_int32 minLeft  = RSPF_INT_NAN;
+         rspf_int32 maxLeft  = RSPF_INT_NAN;
+         rspf_int32 minRight = RSPF_INT_NAN;
+         rspf_int32 maxRight = RSPF_INT_NAN;
+         for (rspf_int32 c = cy-1; c <= cy+1; ++c)
          {
-            // Get the tile.
-            rspfRefPtr<rspfImageData> id =
-               src->getTile(rspfIpt(samp, line));
-            
-            if (!id.valid() || id->getDataObjectStatus() == RSPF_NULL ||
-                id->getDataObjectStatus() == RSPF_EMPTY)
+            if ( (c < 0) || (c >= COARSE_LINES) || (coarseLeft[c] == RSPF_INT_NAN) )
             {
-               continue; // Nothing to do...
+               continue;
             }
-            
-            // Line loop through tile.
-            const rspf_int32 TILE_SAMP_STOP = ((samp+TILE_WIDTH-1) < STOP_SAMP) ?
-               (samp+TILE_WIDTH-1) : STOP_SAMP;
-            
-            for (rspf_int32 y = line; y <= TILE_LINE_STOP; ++y)
+            if ( (minLeft == RSPF_INT_NAN) || (coarseLeft[c] < minLeft) )
             {
-               rspf_int32 edge_index = y - START_LINE;
-               if (theRightEdge[edge_index] == RSPF_INT_NAN)
-               {
-                  for (rspf_int32 x = TILE_SAMP_STOP; x >= samp; --x)
-                  {
-                     if (! (id->isNull(rspfIpt(x,y))))
-                     {
-                        // Capture the first valid pixel.
-                        theRightEdge[edge_index] = x - START_SAMP;
-                        break;
-                     }
-                  }
-               }
+               minLeft = coarseLeft[c];
             }
-            
-         }  // End of tile loop in sample direction through area of interest.
-         
-      }  // End of (all_lines_checked == false)
+            if ( (maxLeft == RSPF_INT_NAN) || (coarseLeft[c] > maxLeft) )
+            {
+               maxLeft = coarseLeft[c];
+            }
+            if ( (minRight == RSPF_INT_NAN) || (coarseRight[c] < minRight) )
+            {
+               minRight = coarseRight[c];
+            }
+            if ( (maxRight == RSPF_INT_NAN) || (coarseRight[c] > maxRight) )
+            {
+               maxRight = coarseRight[c];
+            }
+         }
 
-      // Set the percent complete.
-      tiles_processed += 1.0;
-      setPercentComplete(tiles_processed/total_tiles_y_dir*100.0);
-   }  // End of loop through tiles in line direction.
+         if (minLeft == RSPF_INT_NAN)
+         {
+            leftStart[i]  = START_SAMP+1;
+            leftStop[i]   = START_SAMP;
+            rightStart[i] = START_SAMP+1;
+            rightStop[i]  = START_SAMP;
+            continue;
+         }
+
+         leftStart[i]  = std::max(START_SAMP, (rspf_int32)std::floor((minLeft-1)/decimation.x));
+         leftStop[i]   = std::min(STOP_SAMP, (rspf_int32)std::ceil((maxLeft+2)/decimation.x)-1);
+         rightStart[i] = std::max(START_SAMP, (rspf_int32)std::floor((minRight-1)/decimation.x));
+         rightStop[i]  = std::min(STOP_SAMP, (rspf_int32)std::ceil((maxRight+2)/decimation.x)-1);
+      }
+   }
+
+   std::vector<rspf_int32> leftEdge;
+   std::vector<rspf_int32> rightEdge;
+   if (!scanLines(sources, 0, theAreaOfInterest,
+                  leftStart, leftStop, rightStart, rightStop,
+                  leftEdge, rightEdge, progress, 100.0))
+   {
+      return false;
+   }
+
+   // Edges are kept relative to the area of interest.
+   for (rspf_int32 i = 0; i < LINES; ++i)
+   {
+      if (leftEdge[i] != RSPF_INT_NAN)
+      {
+         theLeftEdge[i] = leftEdge[i] - START_SAMP;
+      }
+      if (rightEdge[i] != RSPF_INT_NAN)
+      {
+         theRightEdge[i] = rightEdge[i] - START_SAMP;
+      }
+   }
 
    setPercentComplete(100.0);
       
@@ -308,6 +747,73 @@ bool rspfVertexExtractor::scanForEdges()
    return true;
 }
 
+bool rspfVertexExtractor::scanLines(const std::vector<rspfImageSource*>& sources,
+                                     rspf_uint32 resLevel,
+                                     const rspfIrect& rect,
+                                     const std::vector<rspf_int32>& leftStart,
+                                     const std::vector<rspf_int32>& leftStop,
+                                     const std::vector<rspf_int32>& rightStart,
+                                     const std::vector<rspf_int32>& rightStop,
+                                     std::vector<rspf_int32>& leftEdge,
+                                     std::vector<rspf_int32>& rightEdge,
+                                     double progressStart,
+                                     double progressEnd)
+{
+   leftEdge.assign(rect.height(), RSPF_INT_NAN);
+   rightEdge.assign(rect.height(), RSPF_INT_NAN);
+   if (rect.hasNans() || !rect.height())
+   {
+      return true;
+   }
+
+   rspfRefPtr<rspfVertexScanQueue> bands =
+      new rspfVertexScanQueue(sources[0], resLevel, rect,
+                              leftStart, leftStop, rightStart, rightStop,
+                              leftEdge, rightEdge);
+   const rspf_uint32 TOTAL_BANDS = bands->getNumberOfBands();
+
+   // One worker per input copy.
+   rspf_uint32 threads = (rspf_uint32)sources.size();
+   if (threads > TOTAL_BANDS) threads = TOTAL_BANDS;
+   
+   rspf_uint32 done = 0;
+   if (threads < 2)
+   {
+      // Scanned here, checking for abort between bands.
+      rspf_uint32 index = 0;
+      while ( !needsAborting() && bands->nextBand(index) )
+      {
+         bands->scanBand(index, sources[0]);
+         ++done;
+         setPercentComplete(progressStart + (progressEnd-progressStart)*done/TOTAL_BANDS);
+      }
+      return (done == TOTAL_BANDS);
+   }
+
+   bands->setNumberOfWorkers(threads);
+   rspfRefPtr<rspfJobMultiThreadQueue> queue =
+      new rspfJobMultiThreadQueue(new rspfJobQueue(), threads);
+   for (rspf_uint32 t = 0; t < threads; ++t)
+   {
+      rspfRefPtr<rspfJob> job = new rspfVertexScanJob(bands.get(), sources[t]);
+      queue->getJobQueue()->add(job.get(), false);
+   }
+
+   while ( (done < TOTAL_BANDS) && !needsAborting() )
+   {
+      rspf_uint32 next = bands->waitForBands(done);
+      if (next == done)
+      {
+         break; // Workers returned.
+      }
+      done = next;
+      setPercentComplete(progressStart + (progressEnd-progressStart)*done/TOTAL_BANDS);
+   }
+   bands->stop();
+
+   return (done == TOTAL_BANDS);
+}
+
 bool rspfVertexExtractor::extractVertices()
 {
    //***
@@ -1831,6 +2337,69 @@ bool rspfVertexExtractor::extractVertices()
    return true;
 }
 
+bool rspfVertexExtractor::simplifyEdges()
+{
+   static const char MODULE[] = "rspfVertexExtractor::simplifyEdges";
+
+   if (traceDebug()) CLOG << " Entered..." << endl;
+
+   if (!theLeftEdge || !theRightEdge)
+   {
+      rspfNotify(rspfNotifyLevel_WARN) << "ERROR rspfVertexExtractor::simplifyEdges():"
+                                         << "\nEdges not initialized!" << std::endl;
+      return false;
+   }
+
+   // Lines with valid data, top down.
+   std::vector<rspfIpt> left;
+   std::vector<rspfIpt> right;
+   for (rspf_int32 i = 0; i < (rspf_int32)theAreaOfInterest.height(); ++i)
+   {
+      if ( (theLeftEdge[i] != RSPF_INT_NAN) && (theRightEdge[i] != RSPF_INT_NAN) &&
+           (theLeftEdge[i] <= theRightEdge[i]) )
+      {
+         left.push_back(rspfIpt(theLeftEdge[i], i));
+         right.push_back(rspfIpt(theRightEdge[i], i));
+      }
+   }
+   if (left.empty())
+   {
+      rspfNotify(rspfNotifyLevel_WARN) << "WARN rspfVertexExtractor::simplifyEdges():"
+                                         << "\nNo valid data found!" << std::endl;
+      return false;
+   }
+
+   std::vector<rspfIpt> leftVertices;
+   std::vector<rspfIpt> rightVertices;
+   simplifyChain(left, theTolerance, leftVertices);
+   simplifyChain(right, theTolerance, rightVertices);
+
+   // Clockwise from the upper left like the quadrilateral: right edges top
+   // down, then left edges bottom up.
+   std::vector<rspfIpt> vertices;
+   vertices.push_back(leftVertices.front());
+   vertices.insert(vertices.end(), rightVertices.begin(), rightVertices.end());
+   vertices.insert(vertices.end(), leftVertices.rbegin(), leftVertices.rend()-1);
+
+   theVertice.clear();
+   for (rspf_uint32 i = 0; i < vertices.size(); ++i)
+   {
+      if ( theVertice.empty() || (theVertice.back() != vertices[i]) )
+      {
+         theVertice.push_back(vertices[i]);
+      }
+   }
+
+   if (traceDebug())
+   {
+      CLOG << " DEBUG:"
+           << "\nLines with data: " << left.size()
+           << "\nVertices:        " << theVertice.size() << std::endl;
+   }
+
+   return true;
+}
+
 bool rspfVertexExtractor::writeVertices()
 {
    static const char MODULE[] = "rspfVertexExtractor::writeVertices";
@@ -1844,15 +2413,23 @@ bool rspfVertexExtractor::writeVertices()
    }
 
    // Write the points...
-   theFileStream << "point0.x:  " << theVertice[0].x
-                 << "\npoint0.y:  " << theVertice[0].y
-                 << "\npoint1.x:  " << theVertice[1].x
-                 << "\npoint1.y:  " << theVertice[1].y
-                 << "\npoint2.x:  " << theVertice[2].x
-                 << "\npoint2.y:  " << theVertice[2].y
-                 << "\npoint3.x:  " << theVertice[3].x
-                 << "\npoint3.y:  " << theVertice[3].y
-                 << endl;
+   for (rspf_uint32 i = 0; i < theVertice.size(); ++i)
+   {
+      theFileStream << "point" << i << ".x:  " << theVertice[i].x
+                    << "\npoint" << i << ".y:  " << theVertice[i].y
+                    << "\n";
+   }
+
+   // Key checked by readCachedVertices.
+   if (theCacheFlag)
+   {
+      rspfString key = getCacheKey();
+      if (key.size())
+      {
+         theFileStream << "footprint_key:  " << key << "\n";
+      }
+   }
+   theFileStream << flush;
 
    // Close the file...
    close();
@@ -1875,6 +2452,118 @@ void rspfVertexExtractor::setAreaOfInterest(const rspfIrect& rect)
    theAreaOfInterest = rect;
 }
 
+void rspfVertexExtractor::setNumberOfThreads(rspf_uint32 threads)
+{
+   theNumberOfThreads = threads;
+}
+
+void rspfVertexExtractor::setTolerance(double pixels)
+{
+   theTolerance = (pixels > 0.0) ? pixels : 0.0;
+}
+
+void rspfVertexExtractor::setQuadrilateralFlag(bool flag)
+{
+   theQuadrilateralFlag = flag;
+}
+
+void rspfVertexExtractor::setUseOverviewsFlag(bool flag)
+{
+   theUseOverviewsFlag = flag;
+}
+
+void rspfVertexExtractor::setCacheFlag(bool flag)
+{
+   theCacheFlag = flag;
+}
+
+rspfString rspfVertexExtractor::getCacheKey() const
+{
+   rspfString result;
+
+   rspfConnectableObject* input =
+      const_cast<rspfConnectableObject*>(getInput(0));
+   if (!input)
+   {
+      return result;
+   }
+   rspfTypeNameVisitor visitor( rspfString("rspfImageHandler"),
+                                 true, // firstofTypeFlag
+                                 (rspfVisitor::VISIT_INPUTS|
+                                  rspfVisitor::VISIT_CHILDREN) );
+   input->accept( visitor );
+   rspfImageHandler* handler = visitor.getObjectAs<rspfImageHandler>(0);
+   if ( !handler || !handler->getFilename().exists() )
+   {
+      return result;
+   }
+
+   // File stamp so a rewritten image is scanned again.
+   const rspfFilename& file = handler->getFilename();
+   rspfLocalTm modTime(0);
+   std::time_t modSeconds = 0;
+   if ( file.getTimes(0, &modTime, 0) )
+   {
+      modSeconds = modTime;
+   }
+
+   std::ostringstream key;
+   key << file.expand() << "|" << file.fileSize() << "|" << (rspf_int64)modSeconds
+       << "|" << handler->getCurrentEntry()
+       << "|" << theAreaOfInterest.ul().x << "," << theAreaOfInterest.ul().y
+       << "," << theAreaOfInterest.lr().x << "," << theAreaOfInterest.lr().y
+       << "|" << (theQuadrilateralFlag ? "quadrilateral" : "polygon")
+       << "," << theTolerance << "," << (theUseOverviewsFlag ? "overviews" : "full");
+   result = key.str();
+   return result;
+}
+
+bool rspfVertexExtractor::readCachedVertices()
+{
+   if ( !theCacheFlag || !theFilename.exists() )
+   {
+      return false;
+   }
+
+   rspfString key = getCacheKey();
+   if (key.empty())
+   {
+      return false;
+   }
+
+   rspfKeywordlist kwl;
+   if ( !kwl.addFile(theFilename) )
+   {
+      return false;
+   }
+   const char* lookup = kwl.find("footprint_key");
+   if ( !lookup || (rspfString(lookup).trim() != key.trim()) )
+   {
+      return false;
+   }
+
+   const rspf_uint32 POINTS = kwl.numberOf("point", "x");
+   if (POINTS < 3)
+   {
+      return false;
+   }
+   std::vector<rspfIpt> vertices(POINTS);
+   for (rspf_uint32 i = 0; i < POINTS; ++i)
+   {
+      rspfString p = rspfString("point") + rspfString::toString(i);
+      const char* x = kwl.find((p + ".x").c_str());
+      const char* y = kwl.find((p + ".y").c_str());
+      if (!x || !y)
+      {
+         return false;
+      }
+      vertices[i].x = rspfString(x).toInt32();
+      vertices[i].y = rspfString(y).toInt32();
+   }
+   theVertice = vertices;
+   return true;
+}
+
 bool rspfVertexExtractor::isOpen()const
 {
    return const_cast<ofstream*>(&theFileStream)->is_open();
@@ -31,8 +31,111 @@
 #include <rspf/plugin/rspfDynamicLibrary.h>
 #include <rspf/font/rspfFontFactoryRegistry.h>
 #include <rspf/base/rspfNotifyContext.h>
+#include <rspf/base/rspfDate.h>
+#include <rspf/base/rspfWebRequestFactoryRegistry.h>
+#include <rspf/base/rspfStreamFactoryRegistry.h>
+#include <rspf/base/rspfPropertyInterfaceRegistry.h>
+#include <rspf/imaging/rspfImageReconstructionFilterRegistry.h>
+#include <rspf/support_data/rspfNitfTagFactoryRegistry.h>
+#include <rspf/elevation/rspfElevationDatabaseRegistry.h>
+#include <rspf/imaging/rspfFftEngine.h>
+#include <rspf/imaging/rspfImageSourceProfiler.h>
+#include <rspf/support_data/rspfInfoFactoryRegistry.h>
+#include <map>
 static rspfTrace traceExec = rspfTrace("rspfInit:exec");
 static rspfTrace traceDebug = rspfTrace("rspfInit:debug");
+
+//---
+// Extension points watched while a plugin initializes, by plugin manifest key
+// (the key the registry passes to rspfFactoryListInterface).  A plugin is
+// deferred when everything it added is in a deferrable registry: those load
+// deferred plugins on first use.  The registries without that hook are
+// watched too so a plugin adding to any of them is loaded eagerly.
+//---
+static const char* PLUGIN_REGISTRY_KEYS[] =
+{
+   "object",
+   "image_source",
+   "image_handler",
+   "image_writer",
+   "overview_builder",
+   "projection",
+   "image_geometry",
+   "2d_to_2d_transform",
+   "elevation_database",
+   "web_request",
+   "info",
+   "fft_backend",
+   "stream",
+   "nitf_tag",
+   "font",
+   "datum",
+   "image_metadata_writer",
+   "reconstruction_filter",
+   "property_interface",
+   "custom_editor_window",
+   0
+};
+static const bool PLUGIN_REGISTRY_DEFERRABLE[] =
+{
+   true, true, true, true, true, true, true, true, true, true, true,
+   false, // A backend has to be there before anyone asks for a plan.
+   false, false, false, false, false, false, false, false // No load on first use.
+};
+static const char PLUGIN_MANIFEST_TYPE[] = "rspfPluginManifest";
+static const char PLUGIN_MANIFEST_VERSION[] = "2";
+
+static void getPluginRegistryCounts(std::vector<rspf_uint32>& counts)
+{
+   std::vector<rspfString> backends;
+   rspfFftEngine::instance()->getBackendNames(backends);
+   
+   counts.clear();
+   counts.push_back(rspfObjectFactoryRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspfImageSourceFactoryRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspfImageHandlerRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspfImageWriterFactoryRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspfOverviewBuilderFactoryRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspfProjectionFactoryRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspfImageGeometryRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspf2dTo2dTransformRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspfElevationDatabaseRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspfWebRequestFactoryRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspfInfoFactoryRegistry::instance()->getNumberOfFactories());
+   counts.push_back((rspf_uint32)backends.size());
+   counts.push_back(rspfStreamFactoryRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspfNitfTagFactoryRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspfFontFactoryRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspfDatumFactoryRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspfImageMetaDataWriterRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspfImageReconstructionFilterRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspfPropertyInterfaceRegistry::instance()->getNumberOfFactories());
+   counts.push_back(rspfCustomEditorWindowRegistry::instance()->getNumberOfFactories());
+}
+
+static bool isDeferrablePluginRegistry(const rspfString& key)
+{
+   for(rspf_uint32 i = 0; PLUGIN_REGISTRY_KEYS[i]; ++i)
+   {
+      if(key == PLUGIN_REGISTRY_KEYS[i])
+      {
+         return PLUGIN_REGISTRY_DEFERRABLE[i];
+      }
+   }
+   return false;
+}
+
+/** Size and modification time, the plugin part of the manifest key. */
+static rspfString getPluginFileStamp(const rspfFilename& file)
+{
+   rspfLocalTm modTime;
+   time_t mtime = 0;
+   if(file.getTimes(0, &modTime, 0))
+   {
+      mtime = modTime;
+   }
+   return rspfString::toString(file.fileSize()) + " " + rspfString::toString((rspf_int64)mtime);
+}
 rspfInit* rspfInit::theInstance = 0;
 rspfInit::~rspfInit()
 {
@@ -106,6 +209,9 @@ void rspfInit::initialize(rspfArgumentParser& parser)
       theInstance->initializeElevation();
    }
    theInstance->initializeLogFile();
+
+   // Reads the image_source_profiler.enabled preference.
+   rspfImageSourceProfiler::instance();
    
    if(thePluginLoaderEnabledFlag)
    {
@@ -143,6 +249,7 @@ void rspfInit::initialize()
       theInstance->initializeElevation();
    }
    theInstance->initializeLogFile();
+   rspfImageSourceProfiler::instance();
    if(thePluginLoaderEnabledFlag)
    {
       theInstance->initializePlugins();
@@ -161,7 +268,10 @@ void rspfInit::initialize()
 }
 void rspfInit::finalize()
 {
-   
+   if (rspfImageSourceProfiler::isEnabled())
+   {
+      rspfImageSourceProfiler::instance()->writeReports();
+   }
 }
 /*!****************************************************************************
  *  Prints to stdout the list of command line options that this object parses.
@@ -399,9 +509,10 @@ void rspfInit::initializePlugins()
    int idx = 0;
    
    std::vector<int> numberList(numberOfDirs);
+   std::vector<PluginCandidate> candidates;
    
    rspfFilename userPluginDir = rspfEnvironmentUtility::instance()->getUserOssimPluginDir();
-   loadPlugins(userPluginDir);
+   collectPlugins(userPluginDir, 0, candidates);
    if(numberList.size()>0)
    {
       for(idx = 0; idx < (int)numberList.size();++idx)
@@ -420,7 +531,7 @@ void rspfInit::initializePlugins()
          
          if(directory)
          {
-            loadPlugins(rspfFilename(directory));
+            collectPlugins(rspfFilename(directory), 0, candidates);
          }
       }
    }
@@ -447,7 +558,7 @@ void rspfInit::initializePlugins()
          
          if(file&&rspfFilename(file).exists())
          {
-            loadPlugins(file);
+            collectPlugins(file, 0, candidates);
          }
       }
    }
@@ -482,7 +593,7 @@ void rspfInit::initializePlugins()
          const char* options = kwl.find((newPrefix+"options").c_str());
          if(file&&rspfFilename(file).exists())
          {
-            loadPlugins(file, options);
+            collectPlugins(file, options, candidates);
          }
       }
    }
@@ -500,10 +611,207 @@ void rspfInit::initializePlugins()
          rspf_uint32 idx = 0;
          for(idx = 0; idx < result.size(); ++idx)
          {
-            rspfSharedPluginRegistry::instance()->registerPlugin(result[idx]);
+            PluginCandidate candidate;
+            candidate.m_file = result[idx];
+            candidates.push_back(candidate);
          }
       }
    }
+   
+   loadPluginCandidates(candidates);
+}
+
+void rspfInit::collectPlugins(const rspfFilename& plugin,
+                              const char* options,
+                              std::vector<PluginCandidate>& candidates)const
+{
+   if(!thePluginLoaderEnabledFlag) return;
+   if(plugin.exists())
+   {
+      PluginCandidate candidate;
+      candidate.m_options = options;
+      if(plugin.isDir())
+      {
+         rspfDirectory dir;
+         if(dir.open(plugin))
+         {
+            rspfFilename file;
+            
+            if(dir.getFirst(file,
+                            rspfDirectory::RSPF_DIR_FILES))
+            {
+               do
+               { 
+                  candidate.m_file = file;
+                  candidates.push_back(candidate);
+               }
+               while(dir.getNext(file));
+            }
+         }
+      }
+      else
+      {
+         candidate.m_file = plugin;
+         candidates.push_back(candidate);
+      }
+   }
+}
+
+void rspfInit::loadPluginCandidates(const std::vector<PluginCandidate>& candidates)
+{
+   if(!thePluginLoaderEnabledFlag) return;
+   
+   rspfSharedPluginRegistry* registry = rspfSharedPluginRegistry::instance();
+   rspfString lazy = thePreferences->findPreference("rspf_init.lazy_plugins");
+   if(!lazy.empty() && !lazy.toBool())
+   {
+      for(rspf_uint32 idx = 0; idx < candidates.size(); ++idx)
+      {
+         registry->registerPlugin(candidates[idx].m_file, candidates[idx].m_options);
+      }
+      return;
+   }
+   
+   // Previous manifest entries by plugin file.
+   rspfFilename manifestFile = getPluginManifestFile();
+   rspfKeywordlist manifest;
+   std::map<rspfString, rspfString> entries;
+   if(manifestFile.size() && manifestFile.exists() && manifest.addFile(manifestFile) &&
+      (rspfString(manifest.find("type")) == PLUGIN_MANIFEST_TYPE) &&
+      (rspfString(manifest.find("version")) == PLUGIN_MANIFEST_VERSION))
+   {
+      rspf_uint32 count = rspfString(manifest.find("number_of_plugins")).toUInt32();
+      for(rspf_uint32 idx = 0; idx < count; ++idx)
+      {
+         rspfString prefix = rspfString("plugin") + rspfString::toString(idx) + ".";
+         entries[manifest.find(prefix, "file")] = prefix;
+      }
+   }
+   
+   rspfKeywordlist newManifest;
+   newManifest.add("type", PLUGIN_MANIFEST_TYPE);
+   newManifest.add("version", PLUGIN_MANIFEST_VERSION);
+   rspf_uint32 recorded = 0;
+   bool changed = false;
+   std::vector<rspf_uint32> before;
+   std::vector<rspf_uint32> after;
+   
+   for(rspf_uint32 idx = 0; idx < candidates.size(); ++idx)
+   {
+      const rspfFilename file  = candidates[idx].m_file.expand();
+      const rspfString options = candidates[idx].m_options;
+      const rspfString stamp   = getPluginFileStamp(file);
+      rspfString status;
+      rspfString registries;
+      
+      std::map<rspfString, rspfString>::const_iterator entry = entries.find(file);
+      if( (entry != entries.end()) &&
+          (stamp   == manifest.find(entry->second, "stamp")) &&
+          (options == manifest.find(entry->second, "options")) )
+      {
+         status     = manifest.find(entry->second, "status");
+         registries = manifest.find(entry->second, "registries");
+         if(status == "deferred")
+         {
+            std::vector<rspfString> keys;
+            registries.split(keys, " ", true);
+            registry->registerDeferredPlugin(file, options, keys);
+         }
+         else
+         {
+            //---
+            // Factories are used in registration order, so deferred plugins
+            // ahead of this one go first in the registries it shares with them.
+            //---
+            std::vector<rspfString> keys;
+            registries.split(keys, " ", true);
+            for(rspf_uint32 i = 0; i < keys.size(); ++i)
+            {
+               if(isDeferrablePluginRegistry(keys[i]))
+               {
+                  registry->loadDeferredPlugins(keys[i]);
+               }
+            }
+            registry->registerPlugin(file, options);
+         }
+      }
+      else
+      {
+         // Unknown or changed: load it and see what it registers.
+         if(registry->isLoaded(file))
+         {
+            continue;
+         }
+         
+         // Its registries are not known yet; keep everything ahead of it in order.
+         registry->loadAllDeferredPlugins();
+         getPluginRegistryCounts(before);
+         if(!registry->registerPlugin(file, options))
+         {
+            continue; // Not a plugin, or failed: tried again next time.
+         }
+         changed = true;
+         getPluginRegistryCounts(after);
+         
+         // Registries are kept for eager plugins too, for the ordering above.
+         bool changedAny = false;
+         bool deferrable = true;
+         for(rspf_uint32 i = 0; PLUGIN_REGISTRY_KEYS[i]; ++i)
+         {
+            if(after[i] != before[i])
+            {
+               changedAny = true;
+               if(!PLUGIN_REGISTRY_DEFERRABLE[i])
+               {
+                  deferrable = false;
+               }
+               if(registries.size()) registries += " ";
+               registries += PLUGIN_REGISTRY_KEYS[i];
+            }
+         }
+         status = (changedAny && deferrable) ? "deferred" : "eager";
+      }
+      
+      rspfString prefix = rspfString("plugin") + rspfString::toString(recorded) + ".";
+      newManifest.add(prefix, "file", file);
+      newManifest.add(prefix, "options", options);
+      newManifest.add(prefix, "stamp", stamp);
+      newManifest.add(prefix, "status", status);
+      newManifest.add(prefix, "registries", registries);
+      ++recorded;
+   }
+   newManifest.add("number_of_plugins", recorded);
+   
+   if(manifestFile.size() && (changed || (recorded != entries.size())))
+   {
+      rspfFilename dir = manifestFile.path();
+      if(dir.exists() || dir.createDirectory())
+      {
+         newManifest.write(manifestFile.c_str());
+      }
+   }
+   
+   if (traceDebug())
+   {
+      rspfNotify(rspfNotifyLevel_DEBUG)
+         << "DEBUG rspfInit::loadPluginCandidates: " << registry->getNumberOfPlugins()
+         << " plugins loaded, " << registry->getNumberOfDeferredPlugins() << " deferred"
+         << std::endl;
+   }
+}
+
+rspfFilename rspfInit::getPluginManifestFile()const
+{
+   rspfFilename result = thePreferences->findPreference("rspf_init.plugin_manifest");
+   if(result.empty())
+   {
+      rspfFilename dir = rspfEnvironmentUtility::instance()->getUserOssimSupportDir();
+      if(dir.size())
+      {
+         result = dir.dirCat("plugin_manifest.kwl");
+      }
+   }
+   return result.expand();
 }
 void rspfInit::initializeElevation()
 {
@@ -0,0 +1,400 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfCascadedUnion.cpp
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  See class description in header.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#include <rspf/parallel/rspfCascadedUnion.h>
+#include <rspf/base/rspfCommon.h>
+#include <rspf/base/rspfException.h>
+#include <rspf/base/rspfPolygon.h>
+#include <rspf/base/rspfReferenced.h>
+#include <rspf/base/rspfTrace.h>
+#include <rspf/base/rspfNotify.h>
+#include <rspf/parallel/rspfJob.h>
+#include <rspf/parallel/rspfJobMultiThreadQueue.h>
+#include <rspf/kbool/bool_globals.h>
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <algorithm>
+
+static rspfTrace traceDebug("rspfCascadedUnion:debug");
+
+namespace
+{
+   //! Interleaves the low 16 bits of x and y.
+   rspf_uint32 zOrder(rspf_uint32 x, rspf_uint32 y)
+   {
+      rspf_uint32 key = 0;
+      for (rspf_uint32 bit = 0; bit < 16; ++bit)
+      {
+         key |= ((x >> bit) & 1) << (2*bit);
+         key |= ((y >> bit) & 1) << (2*bit + 1);
+      }
+      return key;
+   }
+
+   typedef std::pair<rspf_uint32, rspf_uint32> KeyIndex;
+}
+
+//---
+// Pairs of one tree level handed out to the merge jobs.  Pair i merges
+// areas 2i and 2i+1 into 2i; each pair touches only its own entries.
+// The boolean engine throws on bad input; merge keeps the first error and
+// the pairs left are dropped so wait() returns and execute() can report it.
+//---
+class rspfCascadedUnionLevel : public rspfReferenced
+{
+public:
+   rspfCascadedUnionLevel(std::vector< rspfRefPtr<rspfPolyArea2d> >& areas,
+                          double tolerance)
+      : m_areas(areas),
+        m_tolerance(tolerance),
+        m_pairs((rspf_uint32)areas.size() / 2),
+        m_next(0),
+        m_done(0),
+        m_error(),
+        m_mutex(),
+        m_condition()
+   {
+   }
+
+   rspf_uint32 getNumberOfPairs() const { return m_pairs; }
+
+   //! Next pair to merge, false when none left.
+   bool nextPair(rspf_uint32& index)
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      if (m_error.size())
+      {
+         m_done += m_pairs - m_next;
+         m_next  = m_pairs;
+         m_condition.broadcast();
+      }
+      if (m_next >= m_pairs)
+      {
+         return false;
+      }
+      index = m_next++;
+      return true;
+   }
+
+   //! Merges a pair; never throws, see getError.
+   void merge(rspf_uint32 index)
+   {
+      rspfRefPtr<rspfPolyArea2d>& a = m_areas[2*index];
+      rspfRefPtr<rspfPolyArea2d>& b = m_areas[2*index+1];
+      try
+      {
+         (*a) += (*b);
+         if (m_tolerance > 0.0)
+         {
+            a->simplify(m_tolerance);
+         }
+         b = 0;
+      }
+      catch (Bool_Engine_Error& e)
+      {
+         setError(std::string(e.GetHeaderMessage()) + ": " + e.GetErrorMessage());
+      }
+      catch (const std::exception& e)
+      {
+         setError(e.what());
+      }
+      catch (...)
+      {
+         setError("unknown exception");
+      }
+   }
+
+   void pairDone()
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      ++m_done;
+      m_condition.broadcast();
+   }
+
+   //! Blocks until every pair is merged.
+   void wait()
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      while (m_done < m_pairs)
+      {
+         m_condition.wait(&m_mutex);
+      }
+   }
+
+   //! First merge error, empty if none.
+   std::string getError()
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      return m_error;
+   }
+
+protected:
+   virtual ~rspfCascadedUnionLevel() {}
+
+   void setError(const std::string& error)
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      if (m_error.empty())
+      {
+         m_error = error.size() ? error : std::string("unknown error");
+      }
+   }
+
+   std::vector< rspfRefPtr<rspfPolyArea2d> >& m_areas;
+   double                                     m_tolerance;
+   rspf_uint32                                m_pairs;
+   rspf_uint32                                m_next;
+   rspf_uint32                                m_done;
+   std::string                                m_error;
+   OpenThreads::Mutex                         m_mutex;
+   OpenThreads::Condition                     m_condition;
+};
+
+//---
+// Worker : merges pairs until none are left.
+//---
+class rspfCascadedUnionJob : public rspfJob
+{
+public:
+   rspfCascadedUnionJob(rspfCascadedUnionLevel* level)
+      : m_level(level)
+   {
+   }
+
+   virtual void start()
+   {
+      running();
+      rspf_uint32 index = 0;
+      while (m_level->nextPair(index))
+      {
+         m_level->merge(index);
+         m_level->pairDone();
+      }
+      finished();
+   }
+
+protected:
+   rspfRefPtr<rspfCascadedUnionLevel> m_level;
+};
+
+rspfCascadedUnion::rspfCascadedUnion()
+   : m_areas(),
+     m_bounds(),
+     m_threads(0),
+     m_tolerance(0.0)
+{
+}
+
+rspfCascadedUnion::~rspfCascadedUnion()
+{
+}
+
+void rspfCascadedUnion::setNumberOfThreads(rspf_uint32 threads)
+{
+   m_threads = threads;
+}
+
+void rspfCascadedUnion::setTolerance(double tolerance)
+{
+   m_tolerance = (tolerance > 0.0) ? tolerance : 0.0;
+}
+
+void rspfCascadedUnion::add(const rspfPolygon& polygon)
+{
+   if (polygon.getNumberOfVertices() < 3)
+   {
+      return;
+   }
+   rspfDrect rect;
+   polygon.getBoundingRect(rect);
+   m_areas.push_back(new rspfPolyArea2d(polygon));
+   m_bounds.push_back(rect);
+}
+
+void rspfCascadedUnion::add(rspfPolyArea2d* area)
+{
+   if (!area || area->isEmpty())
+   {
+      return;
+   }
+   rspfDrect rect;
+   area->getBoundingRect(rect);
+   m_areas.push_back(area);
+   m_bounds.push_back(rect);
+}
+
+rspf_uint32 rspfCascadedUnion::getNumberOfAreas() const
+{
+   return (rspf_uint32)m_areas.size();
+}
+
+void rspfCascadedUnion::clear()
+{
+   m_areas.clear();
+   m_bounds.clear();
+}
+
+void rspfCascadedUnion::execute(rspfPolyArea2d& result)
+{
+   result.clear();
+   if (m_areas.empty())
+   {
+      return;
+   }
+
+   sortAreas();
+   m_bounds.clear();
+
+   rspf_uint32 threads = m_threads ? m_threads : rspf::getNumberOfThreads();
+   if (threads < 1) threads = 1;
+   if (threads > m_areas.size() / 2) threads = (rspf_uint32)m_areas.size() / 2;
+
+   // One pool for all levels; with one thread the jobs run here.
+   rspfRefPtr<rspfJobMultiThreadQueue> queue;
+   if (threads > 1)
+   {
+      queue = new rspfJobMultiThreadQueue(new rspfJobQueue(), threads);
+   }
+
+   rspf_uint32 levels = 0;
+   while (m_areas.size() > 1)
+   {
+      rspfRefPtr<rspfCascadedUnionLevel> level =
+         new rspfCascadedUnionLevel(m_areas, m_tolerance);
+      const rspf_uint32 PAIRS = level->getNumberOfPairs();
+      if (queue.valid() && (PAIRS > 1))
+      {
+         rspf_uint32 jobs = std::min(threads, PAIRS);
+         for (rspf_uint32 j = 0; j < jobs; ++j)
+         {
+            rspfRefPtr<rspfJob> job = new rspfCascadedUnionJob(level.get());
+            queue->getJobQueue()->add(job.get(), false);
+         }
+      }
+      else
+      {
+         rspfRefPtr<rspfCascadedUnionJob> job = new rspfCascadedUnionJob(level.get());
+         job->start();
+      }
+      level->wait();
+
+      const std::string ERROR_MSG = level->getError();
+      if (ERROR_MSG.size())
+      {
+         m_areas.clear();
+         throw rspfException(std::string("rspfCascadedUnion::execute merge failed: ") +
+                             ERROR_MSG);
+      }
+
+      // Keep the merged areas (and an odd last one) in order.
+      rspf_uint32 kept = 0;
+      for (rspf_uint32 i = 0; i < m_areas.size(); ++i)
+      {
+         if (m_areas[i].valid())
+         {
+            m_areas[kept++] = m_areas[i];
+         }
+      }
+      m_areas.resize(kept);
+      ++levels;
+   }
+
+   if (traceDebug())
+   {
+      rspfNotify(rspfNotifyLevel_DEBUG)
+         << "rspfCascadedUnion::execute DEBUG: " << levels << " levels, "
+         << threads << " threads" << std::endl;
+   }
+
+   result = *m_areas[0];
+   m_areas.clear();
+}
+
+void rspfCascadedUnion::unionOf(const std::vector<rspfPolygon>& polygons,
+                                rspfPolyArea2d& result,
+                                rspf_uint32 threads,
+                                double tolerance)
+{
+   rspfCascadedUnion cascade;
+   cascade.setNumberOfThreads(threads);
+   cascade.setTolerance(tolerance);
+   for (rspf_uint32 i = 0; i < polygons.size(); ++i)
+   {
+      cascade.add(polygons[i]);
+   }
+   cascade.execute(result);
+}
+
+void rspfCascadedUnion::sortAreas()
+{
+   // Extent of the centers; min/max since the rects may be either handed.
+   std::vector<rspfDpt> centers(m_bounds.size());
+   double minX = 0.0;
+   double minY = 0.0;
+   double maxX = 0.0;
+   double maxY = 0.0;
+   bool found = false;
+   rspf_uint32 i = 0;
+   for (i = 0; i < m_bounds.size(); ++i)
+   {
+      if (m_bounds[i].hasNans())
+      {
+         centers[i].makeNan();
+         continue;
+      }
+      centers[i] = (m_bounds[i].ul() + m_bounds[i].lr()) * 0.5;
+      if (!found)
+      {
+         minX = maxX = centers[i].x;
+         minY = maxY = centers[i].y;
+         found = true;
+      }
+      else
+      {
+         minX = std::min(minX, centers[i].x);
+         maxX = std::max(maxX, centers[i].x);
+         minY = std::min(minY, centers[i].y);
+         maxY = std::max(maxY, centers[i].y);
+      }
+   }
+   if (!found)
+   {
+      return;
+   }
+
+   const double SX = (maxX > minX) ? 65535.0 / (maxX - minX) : 0.0;
+   const double SY = (maxY > minY) ? 65535.0 / (maxY - minY) : 0.0;
+   std::vector<KeyIndex> keys(m_areas.size());
+   for (i = 0; i < m_areas.size(); ++i)
+   {
+      rspf_uint32 key = 0;
+      if (!centers[i].hasNans())
+      {
+         key = zOrder((rspf_uint32)((centers[i].x - minX)*SX),
+                      (rspf_uint32)((centers[i].y - minY)*SY));
+      }
+      keys[i] = KeyIndex(key, i);
+   }
+   std::stable_sort(keys.begin(), keys.end());
+
+   std::vector< rspfRefPtr<rspfPolyArea2d> > areas(m_areas.size());
+   std::vector<rspfDrect> bounds(m_bounds.size());
+   for (i = 0; i < keys.size(); ++i)
+   {
+      areas[i]  = m_areas[keys[i].second];
+      bounds[i] = m_bounds[keys[i].second];
+   }
+   m_areas.swap(areas);
+   m_bounds.swap(bounds);
+}
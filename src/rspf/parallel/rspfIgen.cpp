@@ -31,16 +31,210 @@
 #include <rspf/imaging/rspfTiffWriter.h>
 #include <rspf/imaging/rspfTilingRect.h>
 #include <rspf/imaging/rspfTilingPoly.h>
+#include <rspf/imaging/rspfImageWriterFactoryRegistry.h>
 #include <rspf/base/rspfPreferences.h>
+#include <rspf/base/rspfProcessProgressEvent.h>
 #include <rspf/parallel/rspfMpi.h>
+#include <rspf/parallel/rspfImageChainMtAdaptor.h>
+#include <rspf/parallel/rspfJobMultiThreadQueue.h>
 #include <rspf/parallel/rspfMultiThreadSequencer.h>
+#include <rspf/parallel/rspfProcessFarmSequencer.h>
 #include <rspf/parallel/rspfMtDebug.h> //### For debug/performance eval
+#include <rspf/util/rspfWebTileExporter.h>
+#include <OpenThreads/Block>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
 #include <iterator>
 #include <sstream>
 
 static rspfTrace traceDebug(rspfString("rspfIgen:debug"));
 static rspfTrace traceLog(rspfString("rspfIgen:log"));
 
+//*************************************************************************************************
+// Products of a tiled output shared by the writer threads of
+// rspfIgen::writeTiledProductsInParallel. Threads pull the next product until none are left or
+// one fails.
+//*************************************************************************************************
+class rspfIgenProductBatch : public rspfReferenced
+{
+public:
+   struct Product
+   {
+      rspfRefPtr<rspfMapProjection> m_projection;
+      rspfIrect                      m_clipRect;
+      rspfFilename                   m_filename;
+   };
+
+   rspfIgenProductBatch(rspf_uint32 jobs, bool progressFlag)
+      : m_products(),
+        m_next(0),
+        m_written(0),
+        m_skipped(0),
+        m_failed(false),
+        m_jobs(jobs),
+        m_progress(progressFlag ? new rspfStdOutProgress(0, true) : 0),
+        m_mutex(),
+        m_block()
+   {
+      m_block.reset();
+   }
+
+   //! Returns false when there is nothing more to do.
+   bool nextProduct(const Product*& product)
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      if ( m_failed || (m_next >= m_products.size()) )
+         return false;
+      product = &m_products[m_next++];
+      return true;
+   }
+
+   void productDone(bool written, bool failed)
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      if (failed)
+         m_failed = true;
+      else if (written)
+         ++m_written;
+      else
+         ++m_skipped;
+      if (m_progress)
+      {
+         rspfProcessProgressEvent evt(0, 100.0 * (m_written + m_skipped) / m_products.size());
+         m_progress->processProgressEvent(evt);
+      }
+   }
+
+   void jobFinished()
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      if ( m_jobs && (--m_jobs == 0) )
+         m_block.release();
+   }
+
+   void wait() { m_block.block(); }
+
+   std::vector<Product> m_products;
+   size_t               m_next;
+   rspf_uint32          m_written;
+   rspf_uint32          m_skipped;
+   bool                 m_failed;
+
+protected:
+   virtual ~rspfIgenProductBatch() { delete m_progress; }
+
+   rspf_uint32          m_jobs;
+   rspfStdOutProgress*  m_progress;
+   OpenThreads::Mutex   m_mutex;
+   OpenThreads::Block   m_block;
+};
+
+//*************************************************************************************************
+// Writes products from the batch through one chain clone, whose first source is the rectangle
+// cut, and one writer.
+//*************************************************************************************************
+class rspfIgenProductJob : public rspfJob
+{
+public:
+   rspfIgenProductJob(rspfRectangleCutFilter* cut,
+                      rspfImageFileWriter* writer,
+                      rspfIgenProductBatch* batch)
+      : m_cut(cut),
+         m_writer(writer),
+         m_batch(batch)
+   {
+      // View clients, and every source upstream of the cut in the order to initialize them:
+      rspfTypeNameVisitor views( rspfString("rspfViewInterface"), false,
+                                 (rspfVisitor::VISIT_INPUTS|rspfVisitor::VISIT_CHILDREN) );
+      m_cut->accept(views);
+      for (rspf_uint32 i = 0; i < views.getObjects().size(); ++i)
+      {
+         rspfViewInterface* view = views.getObjectAs<rspfViewInterface>(i);
+         if (view)
+            m_views.push_back(view);
+      }
+      rspfTypeNameVisitor sources( rspfString("rspfSource"), false,
+                                   (rspfVisitor::VISIT_INPUTS|rspfVisitor::VISIT_CHILDREN) );
+      m_cut->accept(sources);
+      for (rspf_uint32 i = (rspf_uint32)sources.getObjects().size(); i > 0; --i)
+      {
+         rspfSource* source = sources.getObjectAs<rspfSource>(i-1);
+         if (source)
+            m_sources.push_back(source);
+      }
+
+      m_writer->connectMyInputTo(m_cut.get());
+   }
+
+   virtual void start()
+   {
+      running();
+      const rspfIgenProductBatch::Product* product = 0;
+      while ( m_batch->nextProduct(product) )
+      {
+         bool written = false;
+         bool failed = false;
+         writeProduct(*product, written, failed);
+         m_batch->productDone(written, failed);
+      }
+      m_writer->disconnect();
+      m_batch->jobFinished();
+      finished();
+   }
+
+private:
+   void writeProduct(const rspfIgenProductBatch::Product& product, bool& written, bool& failed)
+   {
+      // Same steps as the serial loop of rspfIgen::outputProduct, on this clone:
+      for (size_t i = 0; i < m_views.size(); ++i)
+         m_views[i]->setView( product.m_projection->dup() );
+      m_cut->setRectangle(product.m_clipRect);
+      for (size_t i = 0; i < m_sources.size(); ++i)
+         m_sources[i]->initialize();
+
+      if ( rspfIgen::isProductEmpty(m_cut.get()) )
+         return;
+
+      rspfDrect outputRect = m_cut->getBoundingRect();
+      if (!outputRect.hasNans())
+      {
+         outputRect.stretchOut();
+         rspfImageGeometry* geom = m_cut->getImageGeometry().get();
+         if (geom)
+            geom->setImageSize(rspfIpt(outputRect.size()));
+      }
+
+      m_writer->setFilename(product.m_filename);
+      m_writer->initialize();
+      try
+      {
+         m_writer->execute();
+         written = true;
+      }
+      catch(const rspfException& e)
+      {
+         rspfNotify(rspfNotifyLevel_FATAL)
+            << "rspfIgen::outputProduct ERROR:\n"
+            << "Caught exception writing " << product.m_filename << "\n"
+            << e.what() << std::endl;
+         failed = true;
+      }
+      catch(...)
+      {
+         rspfNotify(rspfNotifyLevel_FATAL)
+            << "rspfIgen::outputProduct ERROR:\n"
+            << "Unknown exception caught writing " << product.m_filename << std::endl;
+         failed = true;
+      }
+   }
+
+   rspfRefPtr<rspfRectangleCutFilter> m_cut;
+   rspfRefPtr<rspfImageFileWriter>    m_writer;
+   rspfRefPtr<rspfIgenProductBatch>   m_batch;
+   std::vector<rspfViewInterface*>     m_views;
+   std::vector<rspfSource*>            m_sources;
+};
+
 rspfIgen::rspfIgen()
 :
 theContainer(new rspfConnectableContainer()),
@@ -55,7 +249,8 @@ theKwl(),
 theTilingEnabled(false),
 theProgressFlag(true),
 theStdoutFlag(false),
-theThreadCount(9999) // Default no threading
+theThreadCount(9999), // Default no threading
+theProcessCount(9999) // Default no process farm
 {
    theOutputRect.makeNan();
 }
@@ -148,6 +343,20 @@ void rspfIgen::initializeAttributes()
       theNumberOfTilesToBuffer = rspfString(numberOfSlaveTileBuffersStr).toLong();
    }
 
+   // Threads, 0 = one per core.
+   const char* threadsStr = theKwl.find("igen.threads");
+   if(threadsStr)
+   {
+      theThreadCount = rspfString(threadsStr).toUInt32();
+   }
+
+   // Local worker processes, 0 = one per core.
+   const char* processesStr = theKwl.find("igen.processes");
+   if(processesStr)
+   {
+      theProcessCount = rspfString(processesStr).toUInt32();
+   }
+
    const char* tilingKw = theKwl.find("igen.tiling.type");
    if(tilingKw)
    {
@@ -390,6 +599,25 @@ void rspfIgen::outputProduct()
    setView();
    initializeChain();
 
+   // Web map tile pyramid instead of a product? The exporter sets its own view.
+   if (theKwl.find("igen.web_tiles.", "max_zoom"))
+   {
+      if (rspfMpi::instance()->getRank() != 0)
+         return;
+      rspfRefPtr<rspfWebTileExporter> exporter = new rspfWebTileExporter();
+      if ( (theThreadCount != 9999) && theThreadCount )
+         exporter->setNumberOfThreads(theThreadCount);
+      exporter->loadState(theKwl, "igen.web_tiles.");
+      exporter->setInput(theProductChain.get());
+      if (!exporter->execute())
+      {
+         std::string err = "rspfIgen::outputProduct() ERROR:  Web tile export to " +
+            exporter->getOutputDirectory().string() + " failed.";
+         throw(rspfException(err));
+      }
+      return;
+   }
+
    // if it's a thumbnail then adjust the GSD and reset the view proj to the chain.
    if(theBuildThumbnailFlag)
       initThumbnailProjection();
@@ -408,6 +636,10 @@ void rspfIgen::outputProduct()
 #endif
 
    // we will just load a serial connection if MPI is not supported.
+   // Forked worker processes?
+   if (!sequencer.valid() && (theProcessCount != 9999))
+      sequencer = new rspfProcessFarmSequencer(0, theProcessCount);
+
    // Threading?
    if (!sequencer.valid() && (theThreadCount != 9999))
       sequencer = new rspfMultiThreadSequencer(0, theThreadCount);
@@ -471,6 +703,7 @@ void rspfIgen::outputProduct()
    }
 
    // If multi-file tiled output is not desired perform simple output, handle special:
+   bool parallelProducts = false;
    if(theTilingEnabled && theProductProjection.valid())
    {
       theTiling->initialize(*(theProductProjection.get()), theOutputRect);
@@ -490,9 +723,19 @@ void rspfIgen::outputProduct()
       rspfString tileName;
       rspfIrect clipRect;
 
+      //---
+      // Rectangle tilings with threads requested write whole products in parallel rather than
+      // tiles of one product. Poly tilings rewire the chain per feature so stay serial.
+      //---
+      if ( (tilingPoly == NULL) && (theThreadCount != 9999) && !theStdoutFlag &&
+           (rspfMpi::instance()->getNumberOfProcessors() <= 1) )
+      {
+         parallelProducts = writeTiledProductsInParallel(writer.get(), tempFile);
+      }
+
       // 'next' method modifies the mapProj which is the same instance as theProductProjection,
       // so this data member is modified here, then later accessed by setView:
-      while(theTiling->next(theProductProjection, clipRect, tileName))
+      while(!parallelProducts && theTiling->next(theProductProjection, clipRect, tileName))
       {
          if (cut && tilingPoly == NULL)//use rspfTiling or rspfTilingRect
          {
@@ -532,6 +775,10 @@ void rspfIgen::outputProduct()
          }
          
          initializeChain();
+         if (cut && (tilingPoly == NULL) && isProductEmpty(cut))
+         {
+            continue; // Nothing but nulls; don't write it.
+         }
          writer->disconnect();
          writer->connectMyInputTo(theProductChain.get());
          writer->setFilename(tempFile.dirCat(tileName));
@@ -548,7 +795,7 @@ void rspfIgen::outputProduct()
    }
 
    //########## DEBUG CODE FOR TIMING MULTI THREAD LOCKS ##############
-   if (sequencer.valid() && (theThreadCount != 9999))
+   if (sequencer.valid() && (theThreadCount != 9999) && !parallelProducts)
    {
       rspfMultiThreadSequencer* mts = dynamic_cast<rspfMultiThreadSequencer*>(sequencer.get());
       if (mts != NULL)
@@ -572,6 +819,107 @@ void rspfIgen::outputProduct()
    //##################################################################
 }
 
+//*************************************************************************************************
+//! Writes the tiling products on a thread pool. Each thread gets a clone of the product chain from
+//! rspfImageChainMtAdaptor, the clone's first source being the rectangle cut, and its own writer
+//! made from the state of the given one.
+//*************************************************************************************************
+bool rspfIgen::writeTiledProductsInParallel(rspfImageFileWriter* writer,
+                                            const rspfFilename& outputDir)
+{
+   rspf_uint32 threads = theThreadCount ? theThreadCount : rspf::getNumberOfThreads();
+   if ( (threads < 2) || !writer || !theProductChain.valid() )
+      return false;
+
+   // Walk the tiling up front. 'next' reuses one projection so each product keeps a copy:
+   std::vector<rspfIgenProductBatch::Product> products;
+   rspfIgenProductBatch::Product product;
+   rspfString tileName;
+   while (theTiling->next(theProductProjection, product.m_clipRect, tileName))
+   {
+      product.m_projection = static_cast<rspfMapProjection*>(theProductProjection->dup());
+      product.m_filename = outputDir.dirCat(tileName);
+      products.push_back(product);
+   }
+   if (products.size() < 2)
+   {
+      theTiling->reset();
+      return false;
+   }
+   if (threads > products.size())
+      threads = (rspf_uint32)products.size();
+
+   rspfKeywordlist writerKwl;
+   writer->saveState(writerKwl);
+   writer->disconnect();
+
+   rspfRefPtr<rspfImageChainMtAdaptor> adaptor =
+      new rspfImageChainMtAdaptor(theProductChain.get(), threads);
+
+   // One cut (clone first source) and writer per thread:
+   std::vector< rspfRefPtr<rspfRectangleCutFilter> > cuts;
+   std::vector< rspfRefPtr<rspfImageFileWriter> > writers;
+   for (rspf_uint32 i = 0; i < adaptor->getNumberOfClones(); ++i)
+   {
+      rspfRefPtr<rspfRectangleCutFilter> cut =
+         dynamic_cast<rspfRectangleCutFilter*>( adaptor->getClone(i) );
+      rspfRefPtr<rspfImageFileWriter> w =
+         rspfImageWriterFactoryRegistry::instance()->createWriter(writerKwl);
+      if ( !cut.valid() || !w.valid() )
+         break;
+      cuts.push_back(cut);
+      writers.push_back(w);
+   }
+   if (cuts.size() != threads)
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << "rspfIgen::outputProduct WARNING: Could not clone the product chain. Writing "
+         << "products one at a time." << std::endl;
+      writers.clear();
+      theTiling->reset();
+      writer->connectMyInputTo(adaptor->getClone(0));
+      return false;
+   }
+
+   rspfRefPtr<rspfIgenProductBatch> batch =
+      new rspfIgenProductBatch( threads,
+                                theProgressFlag && (rspfMpi::instance()->getRank() == 0) );
+   batch->m_products.swap(products);
+
+   rspfRefPtr<rspfJobMultiThreadQueue> queue =
+      new rspfJobMultiThreadQueue(new rspfJobQueue(), threads);
+   for (rspf_uint32 i = 0; i < threads; ++i)
+   {
+      rspfRefPtr<rspfJob> job =
+         new rspfIgenProductJob(cuts[i].get(), writers[i].get(), batch.get());
+      job->ready();
+      queue->getJobQueue()->add(job.get(), false);
+   }
+   batch->wait();
+
+   if ( traceDebug() || batch->m_skipped )
+   {
+      rspfNotify(rspfNotifyLevel_INFO)
+         << "rspfIgen::outputProduct: " << batch->m_written << " products written, "
+         << batch->m_skipped << " empty products skipped, " << threads << " threads."
+         << std::endl;
+   }
+   return true;
+}
+
+//*************************************************************************************************
+//! Returns true if the cut rectangle misses the cut's input.
+//*************************************************************************************************
+bool rspfIgen::isProductEmpty(const rspfRectangleCutFilter* cut)
+{
+   const rspfImageSource* input =
+      cut ? dynamic_cast<const rspfImageSource*>( cut->getInput(0) ) : 0;
+   if (!input)
+      return false;
+   rspfIrect inputRect = input->getBoundingRect();
+   return ( inputRect.hasNans() || !inputRect.intersects(cut->getRectangle()) );
+}
+
 //*************************************************************************************************
 //! Consolidates job of actually writing to the output file.
 //*************************************************************************************************
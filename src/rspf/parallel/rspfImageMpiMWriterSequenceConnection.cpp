@@ -27,21 +27,98 @@
 
 #include <rspf/parallel/rspfImageMpiMWriterSequenceConnection.h>
 #include <rspf/parallel/rspfMpi.h>
+#include <rspf/parallel/rspfMpiTileMessage.h>
 #include <rspf/imaging/rspfImageData.h>
 #include <rspf/imaging/rspfImageDataFactory.h>
 #include <rspf/base/rspfTrace.h>
-#include <rspf/base/rspfEndian.h>
+#include <rspf/base/rspfNotify.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <vector>
 
 static rspfTrace traceDebug = rspfTrace("rspfImageMpiMWriterSequenceConnection:debug");
 
 RTTI_DEF1(rspfImageMpiMWriterSequenceConnection, "rspfImageMpiMWriterSequenceConnection", rspfImageSourceSequencer)
 
+#if RSPF_HAS_MPI
+// Tiles handed out ahead of the one being returned, per slave.
+static const rspf_uint32 WINDOW_TILES_PER_SLAVE = 16;
+
+class rspfImageMpiMWriterSequenceConnection::ReceiveState
+{
+public:
+   ReceiveState(int slaves, rspf_uint32 maxMessageSize)
+      : m_slaves(slaves),
+        m_requests(2 * slaves, MPI_REQUEST_NULL),
+        m_buffers(slaves),
+        m_dummy(0),
+        m_received(),
+        m_waiting(),
+        m_outstanding(slaves, 0),
+        m_done(slaves, false),
+        m_doneCount(0),
+        m_nextToAssign(0)
+   {
+      for(int slave = 0; slave < slaves; ++slave)
+      {
+         m_buffers[slave].resize(maxMessageSize);
+      }
+   }
+
+   //---
+   // Work requests and tiles are received separately so that a receive left
+   // posted at the end of a sequence can never match a slave's first request
+   // of the next one.  Requests are m_requests[slave], tiles
+   // m_requests[slaves + slave].
+   //---
+   void postRequest(int slave)
+   {
+      MPI_Irecv(&m_dummy, 1, MPI_UNSIGNED_CHAR, slave + 1,
+                rspfMpiTileMessage::WORK_REQUEST_TAG,
+                MPI_COMM_WORLD, &m_requests[slave]);
+   }
+
+   void postTile(int slave)
+   {
+      MPI_Irecv(&m_buffers[slave].front(),
+                (int)m_buffers[slave].size(),
+                MPI_UNSIGNED_CHAR,
+                slave + 1,
+                rspfMpiTileMessage::TILE_TAG,
+                MPI_COMM_WORLD,
+                &m_requests[m_slaves + slave]);
+   }
+
+   int                                               m_slaves;
+   std::vector<MPI_Request>                          m_requests;
+   std::vector< std::vector<rspf_uint8> >            m_buffers;
+   rspf_uint8                                        m_dummy;
+
+   // Tiles that arrived ahead of their turn.
+   std::map< rspf_uint32, std::vector<rspf_uint8> >  m_received;
+
+   // Slaves waiting on a work reply.
+   std::deque<int>                                   m_waiting;
+
+   // Tiles handed to a slave and not yet received.
+   std::vector<rspf_uint32>                          m_outstanding;
+   std::vector<bool>                                 m_done;
+   int                                               m_doneCount;
+   rspf_uint32                                       m_nextToAssign;
+};
+#else
+class rspfImageMpiMWriterSequenceConnection::ReceiveState
+{
+};
+#endif
 
 rspfImageMpiMWriterSequenceConnection::rspfImageMpiMWriterSequenceConnection(
    rspfImageSource* inputSource,
    rspfObject* owner)
    :rspfImageSourceSequencer(inputSource, owner),
-    theOutputTile(NULL)
+    theOutputTile(NULL),
+    theReceiveState(0)
 {
    theRank = 0;
    theNumberOfProcessors = 1;
@@ -66,7 +143,8 @@ rspfImageMpiMWriterSequenceConnection::rspfImageMpiMWriterSequenceConnection(
 
 rspfImageMpiMWriterSequenceConnection::rspfImageMpiMWriterSequenceConnection(rspfObject* owner)
    :rspfImageSourceSequencer(NULL, owner),
-    theOutputTile(NULL)
+    theOutputTile(NULL),
+    theReceiveState(0)
 {
    theRank = 0;
    theNumberOfProcessors = 1;
@@ -91,12 +169,14 @@ rspfImageMpiMWriterSequenceConnection::rspfImageMpiMWriterSequenceConnection(rsp
 
 rspfImageMpiMWriterSequenceConnection::~rspfImageMpiMWriterSequenceConnection()
 {
+   deleteReceiveState();
 }
 
 void rspfImageMpiMWriterSequenceConnection::initialize()
 {
   rspfImageSourceSequencer::initialize();
 
+  deleteReceiveState();
   theCurrentTileNumber = theRank;//-1;
   theOutputTile = NULL;
   
@@ -110,6 +190,7 @@ void rspfImageMpiMWriterSequenceConnection::initialize()
 void rspfImageMpiMWriterSequenceConnection::setToStartOfSequence()
 {
    rspfImageSourceSequencer::setToStartOfSequence();
+   deleteReceiveState();
    if(theRank != 0)
    {
       // we will subtract one since the masters job is just
@@ -130,7 +211,6 @@ void rspfImageMpiMWriterSequenceConnection::setToStartOfSequence()
 rspfRefPtr<rspfImageData> rspfImageMpiMWriterSequenceConnection::getNextTile(rspf_uint32 resLevel)
 {
 #if RSPF_HAS_MPI
-   rspfEndian endian;
    if(!theOutputTile)
    {
       initialize();
@@ -140,148 +220,214 @@ rspfRefPtr<rspfImageData> rspfImageMpiMWriterSequenceConnection::getNextTile(rsp
       }
    }
    
-   void* buf = theOutputTile->getBuf();
-
    rspf_uint32 numberOfTiles = getNumberOfTiles();
-   int errorValue = 0;
+   const int SLAVES = theNumberOfProcessors - 1;
    
-   if(theCurrentTileNumber >= numberOfTiles)
+   if((theCurrentTileNumber >= numberOfTiles) || (SLAVES < 1))
    {
+      finishSequence();
       return NULL;
    }
-   errorValue = MPI_Recv(buf,
-                         theOutputTile->getSizeInBytes(),
-                         MPI_UNSIGNED_CHAR,
-                         theCurrentTileNumber%(theNumberOfProcessors-1)+1,
-                         0,
-                         MPI_COMM_WORLD,
-                         MPI_STATUS_IGNORE);
-   if((endian.getSystemEndianType()!=RSPF_BIG_ENDIAN)&&
-      (theOutputTile->getScalarType()!=RSPF_UINT8))
-   {
-      endian.swap(theOutputTile->getScalarType(),
-                  buf,
-                  theOutputTile->getSize());
-   }
-   
-#if 0
-   // Since MPI can run on different platforms
-   // I am not sure if MPI has built in byte
-   // swap.  If so I will name each datatype
-   // so it can handle byte swap.  Does anyone
-   // know if MPI does byte swapping.
-   switch(theOutputTile->getScalarType())
+
+   if(!theReceiveState)
    {
-      case RSPF_UINT8:
+      theReceiveState = new ReceiveState(
+         SLAVES, rspfMpiTileMessage::getMaxMessageSize(theOutputTile.get()));
+      for(int slave = 0; slave < SLAVES; ++slave)
       {
-         // we add 1 to the rank so we don't wait on a message
-         // to ourself (rank = 0).
-         errorValue = MPI_Recv(buf,
-                               theOutputTile->getSize(),
-                               MPI_UNSIGNED_CHAR,
-                               theCurrentTileNumber%(theNumberOfProcessors-1)+1,
-                               0,
-                               MPI_COMM_WORLD,
-                               MPI_STATUS_IGNORE);
-         break;
-      }
-      case RSPF_SINT8:
-      {
-         // we add 1 to the rank so we don't wait on a message
-         // to ourself (rank = 0).
-         errorValue = MPI_Recv(buf,
-                               theOutputTile->getSize(),
-                               MPI_CHAR,
-                               theCurrentTileNumber%(theNumberOfProcessors-1)+1,
-                               0,
-                               MPI_COMM_WORLD,
-                               MPI_STATUS_IGNORE);
-         break;
-      }
-      case RSPF_UINT16:
-      case RSPF_USHORT11:
-      {
-         errorValue = MPI_Recv(buf,
-                               theOutputTile->getSize(),
-                               MPI_UNSIGNED_SHORT,
-                               theCurrentTileNumber%(theNumberOfProcessors-1)+1,
-                               0,
-                               MPI_COMM_WORLD,
-                               MPI_STATUS_IGNORE);
-         break;
-      }
-      case RSPF_SINT16:
-      {
-         errorValue = MPI_Recv(buf,
-                               theOutputTile->getSize(),
-                               MPI_SHORT,
-                               theCurrentTileNumber%(theNumberOfProcessors-1)+1,
-                               0,
-                               MPI_COMM_WORLD,
-                               MPI_STATUS_IGNORE);
-         break;
-      }
-      case RSPF_SINT32:
-      {
-         errorValue = MPI_Recv(buf,
-                               theOutputTile->getSize(),
-                               MPI_LONG,
-                               theCurrentTileNumber%(theNumberOfProcessors-1)+1,
-                               0,
-                               MPI_COMM_WORLD,
-                               MPI_STATUS_IGNORE);
-         break;
+         theReceiveState->postRequest(slave);
+         theReceiveState->postTile(slave);
       }
-      case RSPF_UINT32:
-      {
-         errorValue = MPI_Recv(buf,
-                               theOutputTile->getSize(),
-                               MPI_UNSIGNED_LONG,
-                               theCurrentTileNumber%(theNumberOfProcessors-1)+1,
-                               0,
-                               MPI_COMM_WORLD,
-                               MPI_STATUS_IGNORE);
-         break;
-      }
-      case RSPF_FLOAT32:
-      case RSPF_NORMALIZED_FLOAT:
+   }
+   ReceiveState& state = *theReceiveState;
+
+   //---
+   // Service slaves, requests and tiles in whatever order they come, until
+   // the tile we have to return is here.
+   //---
+   std::map< rspf_uint32, std::vector<rspf_uint8> >::iterator tile =
+      state.m_received.find(theCurrentTileNumber);
+   while(tile == state.m_received.end())
+   {
+      int index = MPI_UNDEFINED;
+      MPI_Status status;
+      MPI_Waitany(2 * SLAVES, &state.m_requests.front(), &index, &status);
+      if(index == MPI_UNDEFINED)
       {
-         errorValue = MPI_Recv(buf,
-                               theOutputTile->getSize(),
-                               MPI_FLOAT,
-                               theCurrentTileNumber%(theNumberOfProcessors-1)+1,
-                               0,
-                               MPI_COMM_WORLD,
-                               MPI_STATUS_IGNORE);
-         break;
+         rspfNotify(rspfNotifyLevel_WARN)
+            << "rspfImageMpiMWriterSequenceConnection::getNextTile WARNING: "
+            << "no slave left to send tile " << theCurrentTileNumber << "\n";
+         return NULL;
       }
-      case RSPF_FLOAT64:
-      case RSPF_NORMALIZED_DOUBLE:
+
+      if(index < SLAVES)
       {
-         errorValue = MPI_Recv(buf,
-                               theOutputTile->getSize(),
-                               MPI_DOUBLE,
-                               theCurrentTileNumber%(theNumberOfProcessors-1)+1,
-                               0,
-                               MPI_COMM_WORLD,
-                               MPI_STATUS_IGNORE);
-         break;
+         state.m_waiting.push_back(index);
+         serveWorkRequests();
+         if(!state.m_done[index])
+         {
+            state.postRequest(index);
+         }
       }
-      default:
+      else
       {
-         break;
+         index -= SLAVES;
+         int count = 0;
+         MPI_Get_count(&status, MPI_UNSIGNED_CHAR, &count);
+         const rspf_uint8* buf = &state.m_buffers[index].front();
+         rspf_uint32 tileNumber = 0;
+         if(rspfMpiTileMessage::getTileNumber(buf, count, tileNumber))
+         {
+            state.m_received[tileNumber].assign(buf, buf + count);
+         }
+         if(state.m_outstanding[index])
+         {
+            --state.m_outstanding[index];
+         }
+
+         // Keep listening unless the slave is done and has nothing in flight.
+         if(!state.m_done[index] || state.m_outstanding[index])
+         {
+            state.postTile(index);
+         }
       }
+      tile = state.m_received.find(theCurrentTileNumber);
    }
-#endif
+
+   if(!rspfMpiTileMessage::decode(&(*tile).second.front(),
+                                  (rspf_uint32)(*tile).second.size(),
+                                  theOutputTile.get()))
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << "rspfImageMpiMWriterSequenceConnection::getNextTile WARNING: "
+         << "bad message for tile " << theCurrentTileNumber << "\n";
+      theOutputTile->makeBlank();
+   }
+   state.m_received.erase(tile);
+
    rspfIpt origin;
    getTileOrigin(theCurrentTileNumber,
                  origin);
    theOutputTile->setOrigin(origin);
    theOutputTile->validate();
    ++theCurrentTileNumber;
+
+   // Window moved; hand out more work, or let the slaves go if that was it.
+   if(theCurrentTileNumber < numberOfTiles)
+   {
+      serveWorkRequests();
+   }
+   else
+   {
+      finishSequence();
+   }
    return theOutputTile;
 #else
    return rspfImageSourceSequencer::getNextTile(resLevel);
 #endif
    
 }
+
+void rspfImageMpiMWriterSequenceConnection::serveWorkRequests()
+{
+#if RSPF_HAS_MPI
+   if(!theReceiveState)
+   {
+      return;
+   }
+   ReceiveState& state = *theReceiveState;
+   const rspf_uint32 SLAVES = theNumberOfProcessors - 1;
+   const rspf_uint32 NUMBER_OF_TILES = getNumberOfTiles();
+   const rspf_uint32 WINDOW = WINDOW_TILES_PER_SLAVE * SLAVES;
+   const rspf_uint32 LIMIT = theCurrentTileNumber + WINDOW;
+
+   while(!state.m_waiting.empty())
+   {
+      const int SLAVE = state.m_waiting.front();
+      unsigned int work[2] = { 0, 0 };
+      if(state.m_nextToAssign < NUMBER_OF_TILES)
+      {
+         if(state.m_nextToAssign >= LIMIT)
+         {
+            // Window full; wait for the writer to catch up.
+            break;
+         }
+
+         // Guided: a share of what is left, capped to half a slave's window.
+         rspf_uint32 chunk = (NUMBER_OF_TILES - state.m_nextToAssign) / (2 * SLAVES);
+         chunk = std::min<rspf_uint32>(chunk, WINDOW_TILES_PER_SLAVE / 2);
+         chunk = std::min<rspf_uint32>(chunk, LIMIT - state.m_nextToAssign);
+         if(chunk < 1)
+         {
+            chunk = 1;
+         }
+         work[0] = state.m_nextToAssign;
+         work[1] = chunk;
+         state.m_nextToAssign += chunk;
+         state.m_outstanding[SLAVE] += chunk;
+      }
+      else if(!state.m_done[SLAVE])
+      {
+         state.m_done[SLAVE] = true;
+         ++state.m_doneCount;
+      }
+      MPI_Send(work, 2, MPI_UNSIGNED, SLAVE + 1, rspfMpiTileMessage::WORK_TAG, MPI_COMM_WORLD);
+      state.m_waiting.pop_front();
+   }
+#endif
+}
+
+void rspfImageMpiMWriterSequenceConnection::finishSequence()
+{
+#if RSPF_HAS_MPI
+   if(!theReceiveState)
+   {
+      return;
+   }
+   ReceiveState& state = *theReceiveState;
+   const int SLAVES = theNumberOfProcessors - 1;
+
+   // Everything is handed out so every request left gets a no more work.
+   serveWorkRequests();
+   while(state.m_doneCount < SLAVES)
+   {
+      int index = MPI_UNDEFINED;
+      MPI_Status status;
+      MPI_Waitany(SLAVES, &state.m_requests.front(), &index, &status);
+      if(index == MPI_UNDEFINED)
+      {
+         break;
+      }
+      state.m_waiting.push_back(index);
+      serveWorkRequests();
+      if(!state.m_done[index])
+      {
+         state.postRequest(index);
+      }
+   }
+   deleteReceiveState();
+#endif
+}
+
+void rspfImageMpiMWriterSequenceConnection::deleteReceiveState()
+{
+   if(theReceiveState)
+   {
+#if RSPF_HAS_MPI
+      // Cancel tile receives of finished slaves and anything left over from
+      // an unfinished sequence.
+      std::vector<MPI_Request>::iterator i = theReceiveState->m_requests.begin();
+      while(i != theReceiveState->m_requests.end())
+      {
+         if(*i != MPI_REQUEST_NULL)
+         {
+            MPI_Cancel(&(*i));
+            MPI_Wait(&(*i), MPI_STATUS_IGNORE);
+         }
+         ++i;
+      }
+#endif
+      delete theReceiveState;
+      theReceiveState = 0;
+   }
+}
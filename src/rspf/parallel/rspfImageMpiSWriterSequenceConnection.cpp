@@ -16,11 +16,15 @@
 
 #include <rspf/parallel/rspfImageMpiSWriterSequenceConnection.h>
 #include <rspf/parallel/rspfMpi.h>
+#include <rspf/parallel/rspfMpiTileMessage.h>
 #include <rspf/imaging/rspfImageData.h>
 #include <rspf/imaging/rspfImageDataFactory.h>
 #include <rspf/base/rspfTrace.h>
 #include <rspf/base/rspfEndian.h>
 #include <rspf/base/rspfNotifyContext.h>
+#include <rspf/base/rspfPreferences.h>
+#include <deque>
+#include <utility>
 
 static rspfTrace traceDebug = rspfTrace("rspfImageMpiSWriterSequenceConnection:debug");
 
@@ -31,7 +35,8 @@ rspfImageMpiSWriterSequenceConnection::rspfImageMpiSWriterSequenceConnection(rsp
    :rspfImageSourceSequencer(NULL,
                               owner),
     theNumberOfTilesToBuffer(numberOfTilesToBuffer),
-    theOutputTile(NULL)
+    theCompressionFlag(true),
+    theMessages()
 {
    theRank = 0;
    theNumberOfProcessors = 1;
@@ -52,6 +57,12 @@ rspfImageMpiSWriterSequenceConnection::rspfImageMpiSWriterSequenceConnection(rsp
    {
       theCurrentTileNumber = 0;
    }
+
+   const char* lookup = rspfPreferences::instance()->findPreference("mpi_tile_compression");
+   if(lookup)
+   {
+      theCompressionFlag = rspfString(lookup).toBool();
+   }
 }
 
 rspfImageMpiSWriterSequenceConnection::rspfImageMpiSWriterSequenceConnection(rspfImageSource* inputSource,
@@ -60,7 +71,8 @@ rspfImageMpiSWriterSequenceConnection::rspfImageMpiSWriterSequenceConnection(rsp
    :rspfImageSourceSequencer(inputSource,
                                  owner),
     theNumberOfTilesToBuffer(numberOfTilesToBuffer),
-    theOutputTile(NULL)
+    theCompressionFlag(true),
+    theMessages()
 {
    theRank = 0;
    theNumberOfProcessors = 1;
@@ -77,20 +89,16 @@ rspfImageMpiSWriterSequenceConnection::rspfImageMpiSWriterSequenceConnection(rsp
    {
       theCurrentTileNumber = 0;
    }   
+
+   const char* lookup = rspfPreferences::instance()->findPreference("mpi_tile_compression");
+   if(lookup)
+   {
+      theCompressionFlag = rspfString(lookup).toBool();
+   }
 }
 
 rspfImageMpiSWriterSequenceConnection::~rspfImageMpiSWriterSequenceConnection()
 {   
-   deleteOutputTiles();
-}
-
-void rspfImageMpiSWriterSequenceConnection::deleteOutputTiles()
-{
-   if(theOutputTile)
-   {
-      delete [] theOutputTile;
-      theOutputTile = NULL;
-   }
 }
 
 void rspfImageMpiSWriterSequenceConnection::initialize()
@@ -98,22 +106,8 @@ void rspfImageMpiSWriterSequenceConnection::initialize()
   rspfImageSourceSequencer::initialize();
 
   theCurrentTileNumber = theRank-1;
-  if(theOutputTile)
-  {
-     deleteOutputTiles();
-  }
-  
-  if(theInputConnection)
-  {
-     theOutputTile = new rspfRefPtr<rspfImageData>[theNumberOfTilesToBuffer];
-     
-     for(long index = 0; index < theNumberOfTilesToBuffer; ++index)
-     {
-        theOutputTile[index] = rspfImageDataFactory::instance()->create(this,
-                                                                         this);
-        theOutputTile[index]->initialize();
-     }
-  }
+  theMessages.clear();
+  theMessages.resize(theNumberOfTilesToBuffer);
 }
 
 void rspfImageMpiSWriterSequenceConnection::setToStartOfSequence()
@@ -133,206 +127,152 @@ void rspfImageMpiSWriterSequenceConnection::setToStartOfSequence()
    }
 }
 
+void rspfImageMpiSWriterSequenceConnection::setCompressionFlag(bool flag)
+{
+   theCompressionFlag = flag;
+}
+
+bool rspfImageMpiSWriterSequenceConnection::getCompressionFlag()const
+{
+   return theCompressionFlag;
+}
+
 void rspfImageMpiSWriterSequenceConnection::slaveProcessTiles()
 {
 #ifdef RSPF_HAS_MPI 
 #  if RSPF_HAS_MPI
-   rspfEndian endian;
-   rspf_uint32 numberOfTiles    = getNumberOfTiles();
+   if(getNumberOfTiles() == 0)
+   {
+      // Master won't ask for anything.
+      return;
+   }
+   if(theMessages.size() != (rspf_uint32)theNumberOfTilesToBuffer)
+   {
+      theMessages.resize(theNumberOfTilesToBuffer);
+   }
+   
    long currentSendRequest = 0;
    long numberOfTilesSent  = 0;
-   int errorValue= 0;
    MPI_Request *requests   = new MPI_Request[theNumberOfTilesToBuffer];
    for (int i = 0; i < theNumberOfTilesToBuffer; ++i)
    {
       requests[i] = MPI_REQUEST_NULL;
    }
 
+   //---
+   // Work ranges from the master.  One request is kept outstanding so the
+   // next range is usually here before the current one is done.
+   //---
+   std::deque< std::pair<rspf_uint32, rspf_uint32> > ranges;
+   unsigned int work[2] = { 0, 0 };
+   MPI_Request workRequest = MPI_REQUEST_NULL;
+   bool noMoreWork = false;
+
+   MPI_Send(0, 0, MPI_UNSIGNED_CHAR, 0, rspfMpiTileMessage::WORK_REQUEST_TAG, MPI_COMM_WORLD);
+   MPI_Irecv(work, 2, MPI_UNSIGNED, 0, rspfMpiTileMessage::WORK_TAG, MPI_COMM_WORLD, &workRequest);
+
    if(traceDebug())
    {
-      rspfNotify(rspfNotifyLevel_DEBUG) << "DEBUG rspfImageMpiSWriterSequenceConnection::slaveProcessTiles(): entering slave and will look at " << numberOfTiles << " tiles" << std::endl;
+      rspfNotify(rspfNotifyLevel_DEBUG) << "DEBUG rspfImageMpiSWriterSequenceConnection::slaveProcessTiles(): entering slave " << theRank << " of " << getNumberOfTiles() << " tiles" << std::endl;
    }
-   while(theCurrentTileNumber < numberOfTiles)
+   while(true)
    {
-      rspfRefPtr<rspfImageData> data = rspfImageSourceSequencer::getTile(theCurrentTileNumber);
-
-      // if the current send requests have looped around
-      // make sure we wait to see if it was sent
-      //
-      errorValue = MPI_Wait(&requests[currentSendRequest], MPI_STATUS_IGNORE);
-      requests[currentSendRequest] = MPI_REQUEST_NULL;
-      if(data.valid() &&
-         (data->getDataObjectStatus()!=RSPF_NULL)&&
-         (data->getDataObjectStatus()!=RSPF_EMPTY))
+      if(!noMoreWork)
       {
-         theOutputTile[currentSendRequest]->setImageRectangle(data->getImageRectangle());
-         theOutputTile[currentSendRequest]->initialize();
-         
-         theOutputTile[currentSendRequest]->loadTile(data.get());
-         theOutputTile[currentSendRequest]->setDataObjectStatus(data->getDataObjectStatus());
-
-         if(traceDebug())
+         int arrived = 0;
+         if(ranges.empty())
          {
-            if(data->getDataObjectStatus() == RSPF_EMPTY)
-            {
-               rspfNotify(rspfNotifyLevel_DEBUG)
-                  << "DEBUG rspfImageMpiSWriterSequenceConnection::slaveProcessTiles(): In salve = "
-                  << theRank << " tile is empty" << std::endl;
-            }
+            MPI_Wait(&workRequest, MPI_STATUS_IGNORE);
+            arrived = 1;
          }
-      }
-      else
-      {
-         if(traceDebug())
+         else
+         {
+            MPI_Test(&workRequest, &arrived, MPI_STATUS_IGNORE);
+         }
+         if(arrived)
          {
-            if(!data)
+            if(work[1] == 0)
             {
-               rspfNotify(rspfNotifyLevel_DEBUG)
-                  << "DEBUG rspfImageMpiSWriterSequenceConnection::slaveProcessTiles(): In slave = "
-                  << theRank << " ptr is null " << std::endl;
+               noMoreWork = true;
             }
             else
             {
-               rspfNotify(rspfNotifyLevel_DEBUG)
-                  << "DEBUG rspfImageMpiSWriterSequenceConnection::slaveProcessTiles(): In slave = " << theRank << " tile is empty" << std::endl;
+               ranges.push_back(std::make_pair((rspf_uint32)work[0], (rspf_uint32)work[1]));
+               MPI_Send(0, 0, MPI_UNSIGNED_CHAR, 0, rspfMpiTileMessage::WORK_REQUEST_TAG, MPI_COMM_WORLD);
+               MPI_Irecv(work, 2, MPI_UNSIGNED, 0, rspfMpiTileMessage::WORK_TAG, MPI_COMM_WORLD, &workRequest);
             }
          }
-         theOutputTile[currentSendRequest]->makeBlank();
       }
-
-      void* buf = theOutputTile[currentSendRequest]->getBuf();
-      if((endian.getSystemEndianType()!=RSPF_BIG_ENDIAN)&&
-         (theOutputTile[currentSendRequest]->getScalarType()!=RSPF_UINT8))
-      {
-         endian.swap(theOutputTile[currentSendRequest]->getScalarType(),
-                     buf,
-                     theOutputTile[currentSendRequest]->getSize());
-      }
-      errorValue = MPI_Isend(buf,
-                             theOutputTile[currentSendRequest]->getSizeInBytes(),
-                             MPI_UNSIGNED_CHAR,
-                             0,
-                             0,
-                             MPI_COMM_WORLD,
-                             &requests[currentSendRequest]);
-#if 0      
-      switch(theOutputTile[currentSendRequest]->getScalarType())
+      if(ranges.empty())
       {
-         case RSPF_UINT8:
+         if(noMoreWork)
          {
-            errorValue = MPI_Isend(buf,
-                                    theOutputTile[currentSendRequest]->getSize(),
-                                    MPI_UNSIGNED_CHAR,
-                                    0,
-                                    0,
-                                    MPI_COMM_WORLD,
-                                    &requests[currentSendRequest]);
             break;
          }
-         case RSPF_SINT8:
-         {
-            errorValue = MPI_Isend(buf,
-                                    theOutputTile[currentSendRequest]->getSize(),
-                                    MPI_CHAR,
-                                    0,
-                                    0,
-                                    MPI_COMM_WORLD,
-                                    &requests[currentSendRequest]);
-            break;
-         }
-         case RSPF_UINT16:
-         {
-            errorValue = MPI_Isend(buf,
-                                    theOutputTile[currentSendRequest]->getSize(),
-                                    MPI_UNSIGNED_SHORT,
-                                    0,
-                                    0,
-                                    MPI_COMM_WORLD,
-                                    &requests[currentSendRequest]);
-            break;
-         }
-         case RSPF_SINT16:
-         {
-            errorValue = MPI_Isend(buf,
-                                    theOutputTile[currentSendRequest]->getSize(),
-                                    MPI_SHORT,
-                                    0,
-                                    0,
-                                    MPI_COMM_WORLD,
-                                    &requests[currentSendRequest]);
-            break;
-         }
-         case RSPF_UINT32:
-         {
-            errorValue = MPI_Isend(buf,
-                                    theOutputTile[currentSendRequest]->getSize(),
-                                    MPI_UNSIGNED_LONG,
-                                    0,
-                                    0,
-                                    MPI_COMM_WORLD,
-                                    &requests[currentSendRequest]);
-            break;
-         }
-         case RSPF_SINT32:
-         {
-            errorValue = MPI_Isend(buf,
-                                    theOutputTile[currentSendRequest]->getSize(),
-                                    MPI_LONG,
-                                    0,
-                                    0,
-                                    MPI_COMM_WORLD,
-                                    &requests[currentSendRequest]);
-            break;
-         }
-         case RSPF_FLOAT32:
-         case RSPF_NORMALIZED_FLOAT:
+         continue;
+      }
+
+      theCurrentTileNumber = ranges.front().first;
+      ++ranges.front().first;
+      if(--ranges.front().second == 0)
+      {
+         ranges.pop_front();
+      }
+
+      rspfRefPtr<rspfImageData> data = rspfImageSourceSequencer::getTile(theCurrentTileNumber);
+
+      // if the current send requests have looped around
+      // make sure we wait to see if it was sent
+      //
+      MPI_Wait(&requests[currentSendRequest], MPI_STATUS_IGNORE);
+      requests[currentSendRequest] = MPI_REQUEST_NULL;
+
+      if(traceDebug())
+      {
+         if(!data.valid())
          {
-            errorValue = MPI_Isend(buf,
-                                    theOutputTile[currentSendRequest]->getSize(),
-                                    MPI_FLOAT,
-                                    0,
-                                    0,
-                                    MPI_COMM_WORLD,
-                                    &requests[currentSendRequest]);
-            break;
+            rspfNotify(rspfNotifyLevel_DEBUG)
+               << "DEBUG rspfImageMpiSWriterSequenceConnection::slaveProcessTiles(): In slave = "
+               << theRank << " ptr is null " << std::endl;
          }
-         case RSPF_FLOAT64:
-         case RSPF_NORMALIZED_DOUBLE:
+         else if((data->getDataObjectStatus()==RSPF_NULL)||
+                 (data->getDataObjectStatus()==RSPF_EMPTY))
          {
-            errorValue = MPI_Isend(buf,
-                                    theOutputTile[currentSendRequest]->getSize(),
-                                    MPI_DOUBLE,
-                                    0,
-                                    0,
-                                    MPI_COMM_WORLD,
-                                    &requests[currentSendRequest]);
-            break;
+            rspfNotify(rspfNotifyLevel_DEBUG)
+               << "DEBUG rspfImageMpiSWriterSequenceConnection::slaveProcessTiles(): In slave = " << theRank << " tile is empty" << std::endl;
          }
-         default:
-            break;
       }
-#endif
-      theCurrentTileNumber += (theNumberOfProcessors-1);
+
+      // Null and empty tiles go as a header only.
+      std::vector<rspf_uint8>& message = theMessages[currentSendRequest];
+      rspfMpiTileMessage::encode(data.get(),
+                                 theCurrentTileNumber,
+                                 theCompressionFlag,
+                                 message);
+      MPI_Isend(&message.front(),
+                (int)message.size(),
+                MPI_UNSIGNED_CHAR,
+                0,
+                rspfMpiTileMessage::TILE_TAG,
+                MPI_COMM_WORLD,
+                &requests[currentSendRequest]);
+
       numberOfTilesSent++;
       currentSendRequest++;
       currentSendRequest %= theNumberOfTilesToBuffer;
    }
-   rspf_int32 tempCount = 0;
-   // must wait in the correct order
-   //
-   while(tempCount < theNumberOfTilesToBuffer)
+
+   MPI_Waitall(theNumberOfTilesToBuffer,
+               requests,
+               MPI_STATUSES_IGNORE);
+   
+   if(traceDebug())
    {
-      currentSendRequest++;
-      currentSendRequest %= theNumberOfTilesToBuffer;
-      
-      errorValue = MPI_Wait(&requests[currentSendRequest], MPI_STATUS_IGNORE);
-      ++tempCount;
+      rspfNotify(rspfNotifyLevel_DEBUG)
+         << "DEBUG rspfImageMpiSWriterSequenceConnection::slaveProcessTiles(): slave = "
+         << theRank << " sent " << numberOfTilesSent << " tiles" << std::endl;
    }
-   
-//   MPI_Waitall(theNumberOfTilesToBuffer,
-//               requests,
-//               MPI_STATUS_IGNORE);
-   
+
    delete [] requests;
 #  endif
 #endif
@@ -347,4 +287,3 @@ rspfRefPtr<rspfImageData> rspfImageMpiSWriterSequenceConnection::getNextTile(
       << "should not be called" << std::endl;
    return rspfRefPtr<rspfImageData>();
 }
-
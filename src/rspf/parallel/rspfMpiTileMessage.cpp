@@ -0,0 +1,246 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfMpiTileMessage.cpp
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:
+//
+// Tile message packing for the mpi writer sequence connections.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#include <rspf/parallel/rspfMpiTileMessage.h>
+#include <rspf/base/rspfCommon.h>
+#include <rspf/base/rspfEndian.h>
+#include <rspf/imaging/rspfImageData.h>
+
+#include <cstring>
+
+const rspf_uint32 rspfMpiTileMessage::HEADER_SIZE = 20;
+
+// Header word offsets.
+static const rspf_uint32 TILE_NUMBER_WORD  = 0;
+static const rspf_uint32 ENCODING_WORD     = 1;
+static const rspf_uint32 BYTE_ORDER_WORD   = 2;
+static const rspf_uint32 RAW_SIZE_WORD     = 3;
+static const rspf_uint32 PAYLOAD_SIZE_WORD = 4;
+
+static void putWord(std::vector<rspf_uint8>& message, rspf_uint32 word, rspf_uint32 value)
+{
+   rspf_uint8* p = &message[word * 4];
+   p[0] = static_cast<rspf_uint8>( (value >> 24) & 0xff );
+   p[1] = static_cast<rspf_uint8>( (value >> 16) & 0xff );
+   p[2] = static_cast<rspf_uint8>( (value >> 8) & 0xff );
+   p[3] = static_cast<rspf_uint8>( value & 0xff );
+}
+
+static rspf_uint32 getWord(const rspf_uint8* message, rspf_uint32 word)
+{
+   const rspf_uint8* p = message + word * 4;
+   return ( (static_cast<rspf_uint32>(p[0]) << 24) |
+            (static_cast<rspf_uint32>(p[1]) << 16) |
+            (static_cast<rspf_uint32>(p[2]) << 8) |
+            static_cast<rspf_uint32>(p[3]) );
+}
+
+rspf_uint32 rspfMpiTileMessage::getMaxMessageSize(const rspfImageData* tile)
+{
+   return HEADER_SIZE + ( tile ? tile->getSizeInBytes() : 0 );
+}
+
+void rspfMpiTileMessage::encode(const rspfImageData* tile,
+                                rspf_uint32 tileNumber,
+                                bool compress,
+                                std::vector<rspf_uint8>& message)
+{
+   message.resize(HEADER_SIZE);
+   putWord( message, TILE_NUMBER_WORD, tileNumber );
+   putWord( message, BYTE_ORDER_WORD,
+            (rspf::byteOrder() == RSPF_BIG_ENDIAN) ? 1 : 0 );
+
+   const rspf_uint8* buf = tile ? static_cast<const rspf_uint8*>( tile->getBuf() ) : 0;
+   if ( !buf ||
+        (tile->getDataObjectStatus() == RSPF_NULL) ||
+        (tile->getDataObjectStatus() == RSPF_EMPTY) )
+   {
+      putWord( message, ENCODING_WORD, EMPTY );
+      putWord( message, RAW_SIZE_WORD, 0 );
+      putWord( message, PAYLOAD_SIZE_WORD, 0 );
+      return;
+   }
+
+   const rspf_uint32 RAW_SIZE = tile->getSizeInBytes();
+   rspf_uint32 encoding = RAW;
+   if ( compress && packBits( buf, RAW_SIZE, message, HEADER_SIZE + RAW_SIZE - 1 ) )
+   {
+      encoding = RLE;
+   }
+   else
+   {
+      message.resize( HEADER_SIZE + RAW_SIZE );
+      std::memcpy( &message[HEADER_SIZE], buf, RAW_SIZE );
+   }
+   putWord( message, ENCODING_WORD, encoding );
+   putWord( message, RAW_SIZE_WORD, RAW_SIZE );
+   putWord( message, PAYLOAD_SIZE_WORD,
+            static_cast<rspf_uint32>( message.size() ) - HEADER_SIZE );
+}
+
+bool rspfMpiTileMessage::getTileNumber(const rspf_uint8* message,
+                                       rspf_uint32 size,
+                                       rspf_uint32& tileNumber)
+{
+   if ( !message || (size < HEADER_SIZE) )
+   {
+      return false;
+   }
+   tileNumber = getWord( message, TILE_NUMBER_WORD );
+   return true;
+}
+
+bool rspfMpiTileMessage::decode(const rspf_uint8* message,
+                                rspf_uint32 size,
+                                rspfImageData* tile)
+{
+   if ( !message || !tile || (size < HEADER_SIZE) )
+   {
+      return false;
+   }
+
+   const rspf_uint32 ENCODING     = getWord( message, ENCODING_WORD );
+   const rspf_uint32 RAW_SIZE     = getWord( message, RAW_SIZE_WORD );
+   const rspf_uint32 PAYLOAD_SIZE = getWord( message, PAYLOAD_SIZE_WORD );
+
+   if ( ENCODING == EMPTY )
+   {
+      tile->makeBlank();
+      return true;
+   }
+
+   rspf_uint8* buf = static_cast<rspf_uint8*>( tile->getBuf() );
+   if ( !buf || (RAW_SIZE != tile->getSizeInBytes()) ||
+        (size < HEADER_SIZE + PAYLOAD_SIZE) )
+   {
+      return false;
+   }
+
+   const rspf_uint8* payload = message + HEADER_SIZE;
+   if ( ENCODING == RAW )
+   {
+      if ( PAYLOAD_SIZE != RAW_SIZE )
+      {
+         return false;
+      }
+      std::memcpy( buf, payload, RAW_SIZE );
+   }
+   else if ( ENCODING == RLE )
+   {
+      if ( !unpackBits( payload, PAYLOAD_SIZE, buf, RAW_SIZE ) )
+      {
+         return false;
+      }
+   }
+   else
+   {
+      return false;
+   }
+
+   const rspfByteOrder SENDER_ORDER =
+      getWord( message, BYTE_ORDER_WORD ) ? RSPF_BIG_ENDIAN : RSPF_LITTLE_ENDIAN;
+   if ( (SENDER_ORDER != rspf::byteOrder()) &&
+        (rspf::scalarSizeInBytes( tile->getScalarType() ) > 1) )
+   {
+      rspfEndian endian;
+      endian.swap( tile->getScalarType(), buf, tile->getSize() );
+   }
+   return true;
+}
+
+bool rspfMpiTileMessage::packBits(const rspf_uint8* in,
+                                  rspf_uint32 size,
+                                  std::vector<rspf_uint8>& out,
+                                  rspf_uint32 maxSize)
+{
+   rspf_uint32 i = 0;
+   while ( i < size )
+   {
+      // Length of the run starting at i.
+      rspf_uint32 run = 1;
+      while ( (i + run < size) && (run < 128) && (in[i + run] == in[i]) )
+      {
+         ++run;
+      }
+
+      if ( run > 2 )
+      {
+         out.push_back( static_cast<rspf_uint8>( 257 - run ) );
+         out.push_back( in[i] );
+         i += run;
+      }
+      else
+      {
+         // Literals up to the next run of three or 128 bytes.
+         rspf_uint32 count = 0;
+         while ( (i + count < size) && (count < 128) )
+         {
+            if ( (i + count + 2 < size) &&
+                 (in[i + count] == in[i + count + 1]) &&
+                 (in[i + count] == in[i + count + 2]) )
+            {
+               break;
+            }
+            ++count;
+         }
+         out.push_back( static_cast<rspf_uint8>( count - 1 ) );
+         out.insert( out.end(), in + i, in + i + count );
+         i += count;
+      }
+
+      if ( out.size() > maxSize )
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+bool rspfMpiTileMessage::unpackBits(const rspf_uint8* in,
+                                    rspf_uint32 inSize,
+                                    rspf_uint8* out,
+                                    rspf_uint32 size)
+{
+   rspf_uint32 i = 0;
+   rspf_uint32 o = 0;
+   while ( i < inSize )
+   {
+      const rspf_uint32 CODE = in[i++];
+      if ( CODE < 128 )
+      {
+         const rspf_uint32 COUNT = CODE + 1;
+         if ( (i + COUNT > inSize) || (o + COUNT > size) )
+         {
+            return false;
+         }
+         std::memcpy( out + o, in + i, COUNT );
+         i += COUNT;
+         o += COUNT;
+      }
+      else if ( CODE > 128 )
+      {
+         const rspf_uint32 COUNT = 257 - CODE;
+         if ( (i >= inSize) || (o + COUNT > size) )
+         {
+            return false;
+         }
+         std::memset( out + o, in[i], COUNT );
+         ++i;
+         o += COUNT;
+      }
+      // 128 is a no op.
+   }
+   return ( o == size );
+}
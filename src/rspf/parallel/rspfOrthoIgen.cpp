@@ -275,6 +275,9 @@ void rspfOrthoIgen::addArguments(rspfArgumentParser& argumentParser)
       "--output-radiometry","Specifies the desired product's pixel radiometry type. Possible "
       "values are: U8, U11, U16, S16, F32. Note this overrides the deprecated option \"scale-to"
       "-8-bit\".");
+   argumentParser.getApplicationUsage()->addCommandLineOption(
+      "--processes [n]","Farms tiles out to local worker processes using optionally-specified "
+      "number of processes.  Unlike --threads, handlers need not be thread safe.");
    argumentParser.getApplicationUsage()->addCommandLineOption(
       "--reader-prop","Passes a name=value pair to the reader(s) for setting it's property.  Any "
       "number of these can appear on the line.");
@@ -739,6 +742,19 @@ void rspfOrthoIgen::initialize(rspfArgumentParser& argumentParser)
       theThreadCount = (rspf_uint32) tempUint; 
    }
 
+   // Local process farm:
+   num_params = argumentParser.numberOfParams("--processes", uintParam);
+   if (num_params == 0)   // No param means one per core
+   {
+      argumentParser.read("--processes");
+      theProcessCount = 0;
+   }
+   else if (num_params == 1)
+   {
+      argumentParser.read("--processes", uintParam);
+      theProcessCount = (rspf_uint32) tempUint; 
+   }
+
    if(traceDebug())
    {
          rspfNotify(rspfNotifyLevel_DEBUG)
@@ -1913,6 +1929,67 @@ bool rspfOrthoIgen::setupTiling()
    return true;
 }
 
+//*************************************************************************************************
+// Bounding rect of the valid mosaic footprint, i.e. the combined bounding rect of the inputs'
+// valid vertices; no polygon union is needed for a rect. Only the product chain's children are
+// searched so the combiners inside the input chains (mask filters) are not picked up.
+//*************************************************************************************************
+rspfDrect rspfOrthoIgen::getValidMosaicRect()
+{
+   rspfDrect chainRect = theProductChain->getBoundingRect();
+
+   rspfTypeNameVisitor visitor( rspfString("rspfImageCombiner"),
+                                 true, // firstofTypeFlag
+                                 rspfVisitor::VISIT_CHILDREN );
+   theProductChain->accept( visitor );
+   rspfRefPtr<rspfImageCombiner> combiner = visitor.getObjectAs<rspfImageCombiner>(0);
+   if ( !combiner.valid() || chainRect.hasNans() )
+   {
+      return chainRect;
+   }
+
+   rspfDrect validRect;
+   validRect.makeNan();
+   std::vector<rspfIpt> vertices;
+   for ( rspf_uint32 i = 0; i < combiner->getNumberOfInputs(); ++i )
+   {
+      rspfImageSource* input = PTR_CAST(rspfImageSource, combiner->getInput(i));
+      if ( !input )
+      {
+         continue;
+      }
+      rspfDrect rect;
+      vertices.clear();
+      input->getValidImageVertices(vertices, RSPF_CLOCKWISE_ORDER);
+      if ( vertices.size() )
+      {
+         rect = rspfDrect(rspfIrect(vertices));
+      }
+      else
+      {
+         rect = input->getBoundingRect(); // No valid vertices, use the whole input.
+      }
+      if ( rect.hasNans() )
+      {
+         continue;
+      }
+      validRect = validRect.hasNans() ? rect : validRect.combine(rect);
+   }
+   if ( validRect.hasNans() || !validRect.intersects(chainRect) )
+   {
+      return chainRect;
+   }
+
+   if (traceDebug())
+   {
+      rspfNotify(rspfNotifyLevel_DEBUG)
+         << "rspfOrthoIgen::getValidMosaicRect: chain rect = " << chainRect
+         << "\nvalid rect = " << validRect << std::endl;
+   }
+
+   return validRect.clipToRect(chainRect);
+}
+
 //*************************************************************************************************
 // Consolidates specification of bounding rect given various ways of specifying on the command
 // line. This avoids multiple, redundant checks scattered throughout the code. On exit:
@@ -1975,7 +2052,7 @@ void rspfOrthoIgen::consolidateCutRectSpec()
       if (theClipToValidRectFlag)
       {
          // Now we need to clip the cut rect by the valid image footprint for the entire mosaic:
-         rspfDrect boundingRect = theProductChain->getBoundingRect(); // in view coordinates
+         rspfDrect boundingRect = getValidMosaicRect(); // in view coordinates
 
          // The bounding rect is in image space. Since pixel-is-point, the actual valid area on the
          // ground will extend 1/2 pixel beyond the centers, so grow the bounding rect by 1/2 p:
@@ -2031,7 +2108,7 @@ void rspfOrthoIgen::consolidateCutRectSpec()
          if (theClipToValidRectFlag)
          {
             // Now we need to clip the cut rect by the valid image footprint for the entire mosaic:
-            rspfDrect boundingRect = theProductChain->getBoundingRect(); // in view coordinates
+            rspfDrect boundingRect = getValidMosaicRect(); // in view coordinates
             boundingRect.expand(rspfDpt(0.5, 0.5));
             rspfDpt mosaic_ul, mosaic_lr;
             theProductProjection->lineSampleToEastingNorthing(boundingRect.ul(), mosaic_ul);
@@ -0,0 +1,799 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfProcessFarmSequencer.cpp
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:
+//
+// Sequencer farming getNextTile out to forked worker processes.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#include <rspf/parallel/rspfProcessFarmSequencer.h>
+#include <rspf/parallel/rspfMpiTileMessage.h>
+#include <rspf/imaging/rspfImageChain.h>
+#include <rspf/imaging/rspfImageDataFactory.h>
+#include <rspf/base/rspfConnectableContainer.h>
+#include <rspf/base/rspfIrect.h>
+#include <rspf/base/rspfKeywordlist.h>
+#include <rspf/base/rspfNotify.h>
+#include <rspf/base/rspfTrace.h>
+#include <rspf/base/rspfVisitor.h>
+#include <rspf/elevation/rspfElevManager.h>
+#include <rspf/elevation/rspfElevationDatabaseRegistry.h>
+#include <OpenThreads/Thread>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#if !defined(_WIN32)
+#  include <dirent.h>
+#  include <errno.h>
+#  include <poll.h>
+#  include <signal.h>
+#  include <sys/mman.h>
+#  include <sys/types.h>
+#  include <sys/wait.h>
+#  include <unistd.h>
+#  if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#    define MAP_ANONYMOUS MAP_ANON
+#  endif
+#endif
+
+static rspfTrace traceDebug("rspfProcessFarmSequencer:debug");
+
+static const rspf_uint32 DEFAULT_SLOTS_PER_PROCESS = 4;
+
+// How long the parent waits on a result before checking for dead workers.
+static const int POLL_TIMEOUT_MS = 1000;
+
+#if !defined(_WIN32)
+
+namespace
+{
+   // Parent to worker: do tileNumber into slot.
+   struct Command
+   {
+      rspf_uint32 tileNumber;
+      rspf_uint32 slot;
+   };
+
+   // Worker to parent: slot now holds size bytes for tileNumber.  Smaller
+   // than PIPE_BUF so writes from several workers never interleave.
+   struct Result
+   {
+      rspf_uint32 worker;
+      rspf_uint32 tileNumber;
+      rspf_uint32 slot;
+      rspf_uint32 size;
+   };
+
+   bool readFully(int fd, void* buf, size_t size)
+   {
+      char* p = static_cast<char*>(buf);
+      while ( size )
+      {
+         ssize_t n = ::read(fd, p, size);
+         if ( n < 0 )
+         {
+            if ( errno == EINTR ) continue;
+            return false;
+         }
+         if ( n == 0 )
+         {
+            return false; // EOF
+         }
+         p += n;
+         size -= n;
+      }
+      return true;
+   }
+
+   //---
+   // Threads in this process, 0 if unknown.  Only the calling thread exists
+   // in a forked child, so a mutex another thread held at fork time is never
+   // released there.
+   //---
+   rspf_uint32 getNumberOfProcessThreads()
+   {
+      rspf_uint32 count = 0;
+      DIR* dir = ::opendir("/proc/self/task");
+      if ( dir )
+      {
+         struct dirent* entry = 0;
+         while ( (entry = ::readdir(dir)) != 0 )
+         {
+            if ( entry->d_name[0] != '.' )
+            {
+               ++count;
+            }
+         }
+         ::closedir(dir);
+      }
+      return count;
+   }
+
+   bool writeFully(int fd, const void* buf, size_t size)
+   {
+      const char* p = static_cast<const char*>(buf);
+      while ( size )
+      {
+         ssize_t n = ::write(fd, p, size);
+         if ( n < 0 )
+         {
+            if ( errno == EINTR ) continue;
+            return false;
+         }
+         p += n;
+         size -= n;
+      }
+      return true;
+   }
+}
+
+class rspfProcessFarmSequencer::Farm
+{
+public:
+
+   struct Worker
+   {
+      pid_t       m_pid;
+      int         m_commandFd;
+      rspf_uint32 m_queued;
+      bool        m_alive;
+   };
+
+   struct Tile
+   {
+      rspf_uint32 m_slot;
+      rspf_uint32 m_worker;
+      rspf_uint32 m_size;
+      bool        m_ready;
+   };
+
+   Farm()
+      : m_workers(),
+        m_resultFd(-1),
+        m_ring(0),
+        m_ringSize(0),
+        m_slotSize(0),
+        m_freeSlots(),
+        m_tiles(),
+        m_nextToAssign(0),
+        m_oldSigPipe()
+   {
+   }
+
+   rspf_uint8* getSlot(rspf_uint32 slot)
+   {
+      return m_ring + static_cast<size_t>(slot) * m_slotSize;
+   }
+
+   std::vector<Worker>               m_workers;
+   int                               m_resultFd;
+   rspf_uint8*                       m_ring;
+   size_t                            m_ringSize;
+   rspf_uint32                       m_slotSize;
+   std::vector<rspf_uint32>          m_freeSlots;
+
+   // Assigned tiles not yet returned by getNextTile.
+   std::map<rspf_uint32, Tile>       m_tiles;
+   rspf_uint32                       m_nextToAssign;
+
+   struct sigaction                  m_oldSigPipe;
+};
+
+#else
+
+class rspfProcessFarmSequencer::Farm
+{
+};
+
+#endif /* #if !defined(_WIN32) */
+
+rspfProcessFarmSequencer::rspfProcessFarmSequencer(rspfImageSource* inputSource,
+                                                     rspf_uint32 numberOfProcesses,
+                                                     rspfObject* owner)
+   : rspfImageSourceSequencer(inputSource, owner),
+     m_numberOfProcesses(0),
+     m_slotsPerProcess(DEFAULT_SLOTS_PER_PROCESS),
+     m_resLevel(0),
+     m_outputTile(0),
+     m_farm(0),
+     m_farmFailed(false)
+{
+   setNumberOfProcesses(numberOfProcesses);
+}
+
+rspfProcessFarmSequencer::~rspfProcessFarmSequencer()
+{
+   stopWorkers();
+}
+
+void rspfProcessFarmSequencer::initialize()
+{
+   stopWorkers();
+   rspfImageSourceSequencer::initialize();
+   m_outputTile = 0;
+   m_farmFailed = false;
+}
+
+void rspfProcessFarmSequencer::setToStartOfSequence()
+{
+   stopWorkers();
+   rspfImageSourceSequencer::setToStartOfSequence();
+   m_farmFailed = false;
+}
+
+void rspfProcessFarmSequencer::setNumberOfProcesses(rspf_uint32 numberOfProcesses)
+{
+   stopWorkers();
+   m_numberOfProcesses = numberOfProcesses;
+   if ( !m_numberOfProcesses )
+   {
+      m_numberOfProcesses = static_cast<rspf_uint32>( OpenThreads::GetNumberOfProcessors() );
+   }
+   if ( !m_numberOfProcesses )
+   {
+      m_numberOfProcesses = 1;
+   }
+}
+
+rspf_uint32 rspfProcessFarmSequencer::getNumberOfProcesses() const
+{
+   return m_numberOfProcesses;
+}
+
+void rspfProcessFarmSequencer::setSlotsPerProcess(rspf_uint32 slots)
+{
+   stopWorkers();
+   m_slotsPerProcess = (slots < 2) ? 2 : slots;
+}
+
+rspf_uint32 rspfProcessFarmSequencer::getSlotsPerProcess() const
+{
+   return m_slotsPerProcess;
+}
+
+rspfRefPtr<rspfImageData> rspfProcessFarmSequencer::getNextTile(rspf_uint32 resLevel)
+{
+#if !defined(_WIN32)
+   if ( !theInputConnection )
+   {
+      return 0;
+   }
+
+   rspfIrect tileRect;
+   if ( !getTileRect(theCurrentTileNumber, tileRect) )
+   {
+      stopWorkers();
+      return 0;
+   }
+
+   if ( m_farm && (resLevel != m_resLevel) )
+   {
+      stopWorkers();
+   }
+   if ( !m_farm && !m_farmFailed )
+   {
+      if ( !startWorkers(resLevel) )
+      {
+         m_farmFailed = true;
+      }
+   }
+   if ( !m_farm )
+   {
+      // Serial fallback.
+      return rspfImageSourceSequencer::getNextTile(resLevel);
+   }
+
+   assignTiles();
+   waitForTile(theCurrentTileNumber);
+
+   std::map<rspf_uint32, Farm::Tile>::iterator i = m_farm->m_tiles.find(theCurrentTileNumber);
+   if ( i == m_farm->m_tiles.end() )
+   {
+      return rspfImageSourceSequencer::getNextTile(resLevel);
+   }
+   m_outputTile->setImageRectangle(tileRect);
+   if ( !rspfMpiTileMessage::decode(m_farm->getSlot((*i).second.m_slot),
+                                     (*i).second.m_size,
+                                     m_outputTile.get()) )
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << "rspfProcessFarmSequencer::getNextTile WARNING: "
+         << "bad slot for tile " << theCurrentTileNumber << "\n";
+      m_outputTile->makeBlank();
+   }
+   m_outputTile->validate();
+
+   m_farm->m_freeSlots.push_back( (*i).second.m_slot );
+   m_farm->m_tiles.erase(i);
+   ++theCurrentTileNumber;
+
+   if ( theCurrentTileNumber >= getNumberOfTiles() )
+   {
+      stopWorkers();
+   }
+   return m_outputTile;
+#else
+   return rspfImageSourceSequencer::getNextTile(resLevel);
+#endif
+}
+
+bool rspfProcessFarmSequencer::startWorkers(rspf_uint32 resLevel)
+{
+#if !defined(_WIN32)
+   if ( !theInputConnection )
+   {
+      return false;
+   }
+   if ( !m_outputTile.valid() )
+   {
+      m_outputTile = rspfImageDataFactory::instance()->create(this, this);
+      if ( !m_outputTile.valid() )
+      {
+         return false;
+      }
+      m_outputTile->initialize();
+   }
+
+   const rspf_uint32 THREADS = getNumberOfProcessThreads();
+   if ( THREADS > 1 )
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << "rspfProcessFarmSequencer::startWorkers WARNING: "
+         << THREADS << " threads running; forking could deadlock the workers."
+         << "\nRunning serial.\n";
+      return false;
+   }
+
+   const rspf_uint32 PROCESSES = m_numberOfProcesses;
+   const rspf_uint32 SLOTS = PROCESSES * m_slotsPerProcess;
+
+   Farm* farm = new Farm();
+   farm->m_slotSize = rspfMpiTileMessage::getMaxMessageSize(m_outputTile.get());
+   farm->m_ringSize = static_cast<size_t>(farm->m_slotSize) * SLOTS;
+   void* ring = ::mmap(0, farm->m_ringSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   int resultPipe[2];
+   if ( (ring == MAP_FAILED) || (::pipe(resultPipe) != 0) )
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << "rspfProcessFarmSequencer::startWorkers WARNING: "
+         << "could not set up the tile ring: " << std::strerror(errno)
+         << "\nRunning serial.\n";
+      if ( ring != MAP_FAILED )
+      {
+         ::munmap(ring, farm->m_ringSize);
+      }
+      delete farm;
+      return false;
+   }
+   farm->m_ring = static_cast<rspf_uint8*>(ring);
+   farm->m_resultFd = resultPipe[0];
+   for ( rspf_uint32 slot = SLOTS; slot > 0; --slot )
+   {
+      farm->m_freeSlots.push_back(slot - 1);
+   }
+   farm->m_nextToAssign = theCurrentTileNumber;
+
+   // A dead worker must not take the parent down on the next command write.
+   struct sigaction ignore;
+   std::memset(&ignore, 0, sizeof(ignore));
+   ignore.sa_handler = SIG_IGN;
+   sigemptyset(&ignore.sa_mask);
+   ::sigaction(SIGPIPE, &ignore, &farm->m_oldSigPipe);
+
+   m_farm = farm;
+   m_resLevel = resLevel;
+
+   // Buffered output would otherwise be written again by a worker.
+   std::cout.flush();
+   std::cerr.flush();
+   std::fflush(0);
+
+   for ( rspf_uint32 worker = 0; worker < PROCESSES; ++worker )
+   {
+      int commandPipe[2];
+      if ( ::pipe(commandPipe) != 0 )
+      {
+         break;
+      }
+      pid_t pid = ::fork();
+      if ( pid == 0 )
+      {
+         // Worker: drop the parent's ends of every pipe.
+         ::close(commandPipe[1]);
+         ::close(resultPipe[0]);
+         for ( rspf_uint32 i = 0; i < farm->m_workers.size(); ++i )
+         {
+            ::close(farm->m_workers[i].m_commandFd);
+         }
+         workerLoop(worker, commandPipe[0], resultPipe[1]);
+      }
+      ::close(commandPipe[0]);
+      if ( pid < 0 )
+      {
+         ::close(commandPipe[1]);
+         break;
+      }
+      Farm::Worker w;
+      w.m_pid = pid;
+      w.m_commandFd = commandPipe[1];
+      w.m_queued = 0;
+      w.m_alive = true;
+      farm->m_workers.push_back(w);
+   }
+
+   // Parent keeps only the read end so EOF means every worker is gone.
+   ::close(resultPipe[1]);
+
+   if ( farm->m_workers.empty() )
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << "rspfProcessFarmSequencer::startWorkers WARNING: "
+         << "fork failed: " << std::strerror(errno) << "\nRunning serial.\n";
+      stopWorkers();
+      return false;
+   }
+
+   if ( traceDebug() )
+   {
+      rspfNotify(rspfNotifyLevel_DEBUG)
+         << "rspfProcessFarmSequencer::startWorkers DEBUG:"
+         << "\nworkers: " << farm->m_workers.size()
+         << "\nslots:   " << SLOTS
+         << "\nslot size: " << farm->m_slotSize << std::endl;
+   }
+   return true;
+#else
+   return false;
+#endif
+}
+
+void rspfProcessFarmSequencer::stopWorkers()
+{
+#if !defined(_WIN32)
+   if ( !m_farm )
+   {
+      return;
+   }
+
+   // Workers exit on EOF of their command pipe after any tile in hand.
+   std::vector<Farm::Worker>::iterator w = m_farm->m_workers.begin();
+   while ( w != m_farm->m_workers.end() )
+   {
+      ::close( (*w).m_commandFd );
+      ++w;
+   }
+   w = m_farm->m_workers.begin();
+   while ( w != m_farm->m_workers.end() )
+   {
+      int status = 0;
+      while ( (::waitpid( (*w).m_pid, &status, 0 ) < 0) && (errno == EINTR) )
+      {
+      }
+      ++w;
+   }
+
+   if ( m_farm->m_resultFd >= 0 )
+   {
+      ::close(m_farm->m_resultFd);
+   }
+   if ( m_farm->m_ring )
+   {
+      ::munmap(m_farm->m_ring, m_farm->m_ringSize);
+   }
+   ::sigaction(SIGPIPE, &m_farm->m_oldSigPipe, 0);
+
+   delete m_farm;
+   m_farm = 0;
+#endif
+}
+
+void rspfProcessFarmSequencer::assignTiles()
+{
+#if !defined(_WIN32)
+   const rspf_uint32 NUMBER_OF_TILES = getNumberOfTiles();
+
+   //---
+   // Two queued per worker keeps each busy while its last result travels
+   // back; more only makes the order tiles finish in worse.
+   //---
+   const rspf_uint32 MAX_QUEUED = 2;
+
+   while ( (m_farm->m_nextToAssign < NUMBER_OF_TILES) && !m_farm->m_freeSlots.empty() )
+   {
+      // Least loaded live worker.
+      Farm::Worker* worker = 0;
+      rspf_uint32 index = 0;
+      for ( rspf_uint32 i = 0; i < m_farm->m_workers.size(); ++i )
+      {
+         Farm::Worker& w = m_farm->m_workers[i];
+         if ( w.m_alive && (w.m_queued < MAX_QUEUED) &&
+              (!worker || (w.m_queued < worker->m_queued)) )
+         {
+            worker = &w;
+            index = i;
+         }
+      }
+      if ( !worker )
+      {
+         break;
+      }
+
+      Command command;
+      command.tileNumber = m_farm->m_nextToAssign;
+      command.slot = m_farm->m_freeSlots.back();
+      if ( !writeFully(worker->m_commandFd, &command, sizeof(command)) )
+      {
+         worker->m_alive = false;
+         continue;
+      }
+      m_farm->m_freeSlots.pop_back();
+
+      Farm::Tile tile;
+      tile.m_slot = command.slot;
+      tile.m_worker = index;
+      tile.m_size = 0;
+      tile.m_ready = false;
+      m_farm->m_tiles[command.tileNumber] = tile;
+      ++worker->m_queued;
+      ++m_farm->m_nextToAssign;
+   }
+#endif
+}
+
+void rspfProcessFarmSequencer::waitForTile(rspf_uint32 tileNumber)
+{
+#if !defined(_WIN32)
+   std::map<rspf_uint32, Farm::Tile>::iterator tile = m_farm->m_tiles.find(tileNumber);
+   if ( tile == m_farm->m_tiles.end() )
+   {
+      // Could not be queued anywhere; do it here.
+      if ( m_farm->m_freeSlots.empty() )
+      {
+         return; // Can't happen; tiles are assigned in order.
+      }
+      Farm::Tile t;
+      t.m_slot = m_farm->m_freeSlots.back();
+      t.m_worker = 0;
+      t.m_ready = true;
+      m_farm->m_freeSlots.pop_back();
+      fillSlot(tileNumber, t.m_slot, t.m_size);
+      m_farm->m_tiles[tileNumber] = t;
+      if ( m_farm->m_nextToAssign == tileNumber )
+      {
+         ++m_farm->m_nextToAssign;
+      }
+      return;
+   }
+
+   while ( !(*tile).second.m_ready )
+   {
+      Farm::Worker& owner = m_farm->m_workers[(*tile).second.m_worker];
+      if ( !owner.m_alive )
+      {
+         fillSlot(tileNumber, (*tile).second.m_slot, (*tile).second.m_size);
+         (*tile).second.m_ready = true;
+         break;
+      }
+
+      struct pollfd pfd;
+      pfd.fd = m_farm->m_resultFd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      int n = ::poll(&pfd, 1, POLL_TIMEOUT_MS);
+      if ( (n < 0) && (errno == EINTR) )
+      {
+         continue;
+      }
+
+      Result result;
+      bool eof = false;
+      if ( n > 0 )
+      {
+         eof = !readFully(m_farm->m_resultFd, &result, sizeof(result));
+      }
+      if ( (n > 0) && !eof )
+      {
+         std::map<rspf_uint32, Farm::Tile>::iterator r = m_farm->m_tiles.find(result.tileNumber);
+         if ( r != m_farm->m_tiles.end() && !(*r).second.m_ready )
+         {
+            (*r).second.m_size = result.size;
+            (*r).second.m_ready = true;
+         }
+         if ( (result.worker < m_farm->m_workers.size()) &&
+              m_farm->m_workers[result.worker].m_queued )
+         {
+            --m_farm->m_workers[result.worker].m_queued;
+         }
+         assignTiles();
+         continue;
+      }
+
+      //---
+      // Timed out or error: see who is gone.  EOF means every worker closed
+      // its end, so waiting on them will not block.
+      //---
+      for ( rspf_uint32 i = 0; i < m_farm->m_workers.size(); ++i )
+      {
+         Farm::Worker& w = m_farm->m_workers[i];
+         if ( w.m_alive )
+         {
+            int status = 0;
+            pid_t pid = ::waitpid(w.m_pid, &status, eof ? 0 : WNOHANG);
+            if ( (pid == w.m_pid) || ((pid < 0) && (errno == ECHILD)) )
+            {
+               if ( w.m_alive )
+               {
+                  rspfNotify(rspfNotifyLevel_WARN)
+                     << "rspfProcessFarmSequencer WARNING: worker " << i
+                     << " exited; its tiles will be done by the parent.\n";
+               }
+               w.m_alive = false;
+            }
+         }
+      }
+   }
+#endif
+}
+
+void rspfProcessFarmSequencer::fillSlot(rspf_uint32 tileNumber,
+                                         rspf_uint32 slot,
+                                         rspf_uint32& size)
+{
+#if !defined(_WIN32)
+   rspfRefPtr<rspfImageData> tile = 0;
+   rspfIrect tileRect;
+   if ( getTileRect(tileNumber, tileRect) )
+   {
+      tile = theInputConnection->getTile(tileRect, m_resLevel);
+   }
+
+   std::vector<rspf_uint8> message;
+   rspfMpiTileMessage::encode(tile.get(), tileNumber, false, message);
+   if ( message.size() > m_farm->m_slotSize )
+   {
+      // Tile larger than asked for; send blank rather than overrun the slot.
+      rspfMpiTileMessage::encode(0, tileNumber, false, message);
+   }
+   std::memcpy(m_farm->getSlot(slot), &message.front(), message.size());
+   size = static_cast<rspf_uint32>( message.size() );
+#endif
+}
+
+bool rspfProcessFarmSequencer::rebuildInput(rspfRefPtr<rspfConnectableContainer>& container)
+{
+   if ( !theInputConnection )
+   {
+      return false;
+   }
+
+   // A chain is replaced by its first source when filling the container.
+   rspfImageSource* output = theInputConnection;
+   rspfImageChain* chain = dynamic_cast<rspfImageChain*>(theInputConnection);
+   if ( chain )
+   {
+      output = chain->getFirstSource();
+      if ( !output )
+      {
+         return false;
+      }
+   }
+   const rspfId OUTPUT_ID = output->getId();
+
+   //---
+   // Filling rewires the inherited objects, which is fine as this process
+   // never uses them again.
+   //---
+   rspfRefPtr<rspfConnectableContainer> inherited = new rspfConnectableContainer;
+   rspfKeywordlist kwl;
+   if ( !theInputConnection->fillContainer(*inherited.get()) || !inherited->saveState(kwl) )
+   {
+      return false;
+   }
+
+   container = new rspfConnectableContainer;
+   if ( !container->loadState(kwl) )
+   {
+      return false;
+   }
+   rspfIdVisitor visitor(OUTPUT_ID);
+   container->accept(visitor);
+   rspfImageSource* input = dynamic_cast<rspfImageSource*>(visitor.getObject());
+   if ( !input )
+   {
+      return false;
+   }
+   input->initialize();
+   theInputConnection = input;
+   return true;
+}
+
+bool rspfProcessFarmSequencer::reloadElevation()
+{
+   //---
+   // Elevation cells are held by the rspfElevManager singleton, outside the
+   // chain.  Replace each database by one loaded from its state; dropping the
+   // old ones closes the inherited cells.
+   //---
+   rspfElevManager::ElevationDatabaseListType& databases =
+      rspfElevManager::instance()->getElevationDatabaseList();
+   for ( rspf_uint32 idx = 0; idx < databases.size(); ++idx )
+   {
+      if ( !databases[idx].valid() )
+      {
+         continue;
+      }
+      rspfKeywordlist kwl;
+      if ( !databases[idx]->saveState(kwl, 0) )
+      {
+         return false;
+      }
+      rspfRefPtr<rspfElevationDatabase> database =
+         rspfElevationDatabaseRegistry::instance()->createDatabase(kwl);
+      if ( !database.valid() )
+      {
+         return false;
+      }
+      databases[idx] = database;
+   }
+   return true;
+}
+
+void rspfProcessFarmSequencer::workerLoop(rspf_uint32 worker, int commandFd, int resultFd)
+{
+#if !defined(_WIN32)
+   //---
+   // Handlers inherited from the parent share its open file descriptions,
+   // offsets included, so reading through them races the other processes.
+   // Open everything again; a worker that can't exits and the parent does
+   // its tiles.
+   //---
+   rspfRefPtr<rspfConnectableContainer> input;
+   if ( !rebuildInput(input) )
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << "rspfProcessFarmSequencer worker " << worker
+         << " WARNING: could not rebuild the input chain.\n";
+      ::_exit(1);
+   }
+   if ( !reloadElevation() )
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << "rspfProcessFarmSequencer worker " << worker
+         << " WARNING: could not reload the elevation databases.\n";
+      ::_exit(1);
+   }
+
+   Command command;
+   while ( readFully(commandFd, &command, sizeof(command)) )
+   {
+      Result result;
+      result.worker = worker;
+      result.tileNumber = command.tileNumber;
+      result.slot = command.slot;
+      result.size = 0;
+      fillSlot(command.tileNumber, command.slot, result.size);
+      if ( !writeFully(resultFd, &result, sizeof(result)) )
+      {
+         break;
+      }
+   }
+
+   //---
+   // _exit: the parent's objects, open writers and buffered streams were
+   // copied into this process and must not be destroyed or flushed here.
+   //---
+   ::_exit(0);
+#endif
+}
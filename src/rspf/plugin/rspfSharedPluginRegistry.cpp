@@ -6,8 +6,21 @@
 #include <rspf/base/rspfKeywordNames.h>
 #include <rspf/base/rspfKeywordlist.h>
 #include <rspf/plugin/rspfSharedObjectBridge.h>
+#include <rspf/base/rspfFactoryListInterface.h>
+#include <OpenThreads/ScopedLock>
 static rspfTrace traceDebug("rspfSharedPluginRegistry:debug");
+
+void rspfLoadDeferredPlugins(const char* registryKey)
+{
+   rspfSharedPluginRegistry::instance()->loadDeferredPlugins(rspfString(registryKey));
+}
+
 rspfSharedPluginRegistry::rspfSharedPluginRegistry()
+   : theLibraryList(),
+     m_deferredList(),
+     m_deferredMutex(),
+     m_loadingCount(0),
+     m_hasDeferredFlag(false)
 {
 }
 rspfSharedPluginRegistry::~rspfSharedPluginRegistry()
@@ -22,6 +35,21 @@ rspfSharedPluginRegistry* rspfSharedPluginRegistry::instance()
 bool rspfSharedPluginRegistry::registerPlugin(const rspfFilename& filename, const rspfString& options)//, bool insertFrontFlag)
 {
    bool result = false;
+   if(m_hasDeferredFlag)
+   {
+      // Asking for a deferred plugin loads it now.
+      OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(m_deferredMutex);
+      std::vector<DeferredPlugin>::const_iterator i = m_deferredList.begin();
+      while(i != m_deferredList.end())
+      {
+         if(filename.file() == (*i).m_file.file())
+         {
+            loadDeferred(rspfString(), filename);
+            return (getPlugin(filename) != 0);
+         }
+         ++i;
+      }
+   }
    if(!getPlugin(filename))
    {
       rspfPluginLibrary *lib =new rspfPluginLibrary;
@@ -149,6 +177,19 @@ bool rspfSharedPluginRegistry::isLoaded(const rspfFilename& filename) const
 {
    rspfFilename fileOnly = filename.file();
    bool result = false;
+   if(m_hasDeferredFlag)
+   {
+      OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(m_deferredMutex);
+      std::vector<DeferredPlugin>::const_iterator i = m_deferredList.begin();
+      while(i != m_deferredList.end())
+      {
+         if(fileOnly == (*i).m_file.file())
+         {
+            return true;
+         }
+         ++i;
+      }
+   }
    rspf_uint32 count = getNumberOfPlugins();
    for (rspf_uint32 i = 0; i < count; ++i)
    {
@@ -166,6 +207,7 @@ bool rspfSharedPluginRegistry::isLoaded(const rspfFilename& filename) const
 }
 void rspfSharedPluginRegistry::printAllPluginInformation(std::ostream& out)
 {
+   loadAllDeferredPlugins();
    rspf_uint32 count = getNumberOfPlugins();
    rspf_uint32 idx = 0;
    
@@ -187,3 +229,104 @@ void rspfSharedPluginRegistry::printAllPluginInformation(std::ostream& out)
       }
    }
 }
+
+void rspfSharedPluginRegistry::registerDeferredPlugin(const rspfFilename& filename,
+                                                       const rspfString& options,
+                                                       const std::vector<rspfString>& registries)
+{
+   if(isLoaded(filename))
+   {
+      rspfNotify(rspfNotifyLevel_WARN) << "WARNING: Plugin with the name " << filename << std::endl
+                                         << "Already registered with RSPF" << std::endl;
+      return;
+   }
+   OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(m_deferredMutex);
+   DeferredPlugin plugin;
+   plugin.m_file       = filename;
+   plugin.m_options    = options;
+   plugin.m_registries = registries;
+   m_deferredList.push_back(plugin);
+   m_hasDeferredFlag = true;
+   
+   if (traceDebug())
+   {
+      rspfNotify(rspfNotifyLevel_DEBUG)
+         << "rspfSharedPluginRegistry DEBUG: deferred " << filename << std::endl;
+   }
+}
+
+void rspfSharedPluginRegistry::loadDeferredPlugins(const rspfString& registryKey)
+{
+   if(m_hasDeferredFlag)
+   {
+      loadDeferred(registryKey, rspfFilename());
+   }
+}
+
+void rspfSharedPluginRegistry::loadAllDeferredPlugins()
+{
+   if(m_hasDeferredFlag)
+   {
+      loadDeferred(rspfString(), rspfFilename());
+   }
+}
+
+rspf_uint32 rspfSharedPluginRegistry::getNumberOfDeferredPlugins()const
+{
+   OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(m_deferredMutex);
+   return (rspf_uint32)m_deferredList.size();
+}
+
+void rspfSharedPluginRegistry::loadDeferred(const rspfString& registryKey,
+                                            const rspfFilename& filename)
+{
+   // The lock is held while loading so other threads using the registry
+   // wait for the factories; m_hasDeferredFlag stays set until the load is
+   // done so they do not skip the lock meanwhile.  Entries are removed first,
+   // so a registry used from a plugin's initialize does not load it again.
+   OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(m_deferredMutex);
+   
+   std::vector<DeferredPlugin> toLoad;
+   std::vector<DeferredPlugin>::iterator i = m_deferredList.begin();
+   while(i != m_deferredList.end())
+   {
+      bool match = false;
+      if(filename.size())
+      {
+         match = (filename.file() == (*i).m_file.file());
+      }
+      else if(registryKey.empty())
+      {
+         match = true;
+      }
+      else
+      {
+         match = (std::find((*i).m_registries.begin(), (*i).m_registries.end(), registryKey) !=
+                  (*i).m_registries.end());
+      }
+      if(match)
+      {
+         toLoad.push_back(*i);
+         i = m_deferredList.erase(i);
+      }
+      else
+      {
+         ++i;
+      }
+   }
+   ++m_loadingCount;
+   
+   for(i = toLoad.begin(); i != toLoad.end(); ++i)
+   {
+      if (traceDebug())
+      {
+         rspfNotify(rspfNotifyLevel_DEBUG)
+            << "rspfSharedPluginRegistry DEBUG: loading deferred " << (*i).m_file
+            << " for " << (registryKey.empty() ? rspfString("all") : registryKey) << std::endl;
+      }
+      registerPlugin((*i).m_file, (*i).m_options);
+   }
+   
+   --m_loadingCount;
+   m_hasDeferredFlag = (!m_deferredList.empty() || m_loadingCount);
+}
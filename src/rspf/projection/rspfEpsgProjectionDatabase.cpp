@@ -28,6 +28,12 @@
 #include <rspf/base/rspfPreferences.h>
 #include <rspf/projection/rspfMapProjectionFactory.h>
 #include <rspf/base/rspfException.h>
+#include <rspf/base/rspfEnvironmentUtility.h>
+#include <rspf/base/rspfDate.h>
+#include <OpenThreads/ScopedLock>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <math.h>
 
 rspfEpsgProjectionDatabase* rspfEpsgProjectionDatabase::m_instance = 0;
@@ -110,6 +116,21 @@ enum
 };
 static const rspfString SPCS_EPSG_MAP_FORMAT_C ("SPCS_EPSG_MAP");
 
+// Binary index of a Db CSV file: header, entries sorted by code, then the names block. The index
+// is a local cache in native byte order; the CSV size and modification time tell when it is stale.
+static const char        INDEX_MAGIC[8] = { 'R','S','P','F','E','P','S','G' };
+static const rspf_uint32 INDEX_VERSION  = 1;
+struct IndexHeader
+{
+   char        magic[8];
+   rspf_uint32 version;
+   rspf_uint32 format;
+   rspf_uint64 csvSize;
+   rspf_int64  csvTime;
+   rspf_uint32 count;
+   rspf_uint32 namesSize;
+};
+
 //*************************************************************************************************
 //! Converts sexagesimal DMS to decimal degrees
 //*************************************************************************************************
@@ -191,11 +212,8 @@ void rspfEpsgProjectionDatabase::initialize()
 
    // Create only once outside the loop:
    rspfFilename db_name;
-   rspfString group_id;
-   rspfString format_id;
-   rspfString line;
 
-   // Loop over each file and read contents into memory:
+   // Loop over each file and map its index. Records are decoded on first lookup (getRecord()):
    while ( i != keys.end() )
    {
       db_name = rspfPreferences::instance()->preferencesKWL().find( (*i).c_str() );
@@ -203,74 +221,333 @@ void rspfEpsgProjectionDatabase::initialize()
       if (!db_name.isReadable())
          continue;
 
-      // Open the DB file:
-      std::ifstream db_stream (db_name.chars());
-      bool good_file = false;
-      if (db_stream.good())
-      {
-         // Format specification implied in file's magic number:
-         std::getline(db_stream, format_id.string());
-         format_id.trim();
-         if ((format_id == EPSG_DB_FORMAT_A) || 
-             (format_id == STATE_PLANE_FORMAT_B) ||
-             (format_id == SPCS_EPSG_MAP_FORMAT_C))
-            good_file = true;
-      }
-      if (!good_file)
+      rspfRefPtr<DbFile> db = new DbFile;
+      db->csvFile = db_name;
+      if (!openDbFile(*db))
       {
          rspfNotify(rspfNotifyLevel_WARN)<<"rspfEpsgProjectionDatabase::initialize() -- "
             "Encountered bad database file <"<<db_name<<">. Skipping this file."<<endl;
-         db_stream.close();
          continue;
       }
+      m_dbFiles.push_back(db);
+   } // end of while loop over all DB files
+}
+
+//*************************************************************************************************
+//! Maps the index of db.csvFile, building it first if missing or stale. False for a bad file.
+//*************************************************************************************************
+bool rspfEpsgProjectionDatabase::openDbFile(DbFile& db) const
+{
+   db.csv = new rspfMemoryMappedFile;
+   if (!db.csv->open(db.csvFile))
+      return false;
+
+   rspfLocalTm mod_time;
+   time_t csv_time = 0;
+   if (db.csvFile.getTimes(0, &mod_time, 0))
+      csv_time = mod_time;
+   const rspf_uint64 csv_size = db.csv->getSize();
+
+   // Use the existing index if it was made from this version of the CSV:
+   rspfFilename index_file = getIndexFile(db.csvFile);
+   if (!index_file.empty() && index_file.exists())
+   {
+      rspfRefPtr<rspfMemoryMappedFile> index = new rspfMemoryMappedFile;
+      if (index->open(index_file) && (index->getSize() >= sizeof(IndexHeader)))
+      {
+         const IndexHeader* header = (const IndexHeader*) index->getData();
+         const rspf_uint64 expected_size = sizeof(IndexHeader) + 
+            (rspf_uint64) header->count * sizeof(DbFile::Entry) + header->namesSize;
+         if ((memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) == 0) &&
+             (header->version == INDEX_VERSION) &&
+             (header->format >= FORMAT_A) && (header->format <= FORMAT_C) &&
+             (header->csvSize == csv_size) && (header->csvTime == (rspf_int64) csv_time) &&
+             (index->getSize() == expected_size))
+         {
+            db.index   = index;
+            db.format  = (RecordFormat) header->format;
+            db.count   = header->count;
+            db.entries = (const DbFile::Entry*) (index->getData() + sizeof(IndexHeader));
+            db.names   = (const char*) (db.entries + db.count);
+            return true;
+         }
+      }
+   }
+
+   return buildIndex(db, index_file, csv_size, (rspf_int64) csv_time);
+}
+
+//*************************************************************************************************
+//! Scans the CSV and writes the index. Keeps it in memory if the index file can't be written.
+//*************************************************************************************************
+bool rspfEpsgProjectionDatabase::buildIndex(DbFile& db,
+                                             const rspfFilename& indexFile,
+                                             rspf_uint64 csvSize,
+                                             rspf_int64 csvTime) const
+{
+   const char* data = (const char*) db.csv->getData();
+   const char* data_end = data + csvSize;
+   db.csv->advise(rspfMemoryMappedFile::SEQUENTIAL);
+
+   // Format specification implied in file's magic number:
+   const char* line_end = std::find(data, data_end, '\n');
+   rspfString format_id (std::string(data, line_end));
+   format_id.trim();
+   rspf_uint32 code_field = 0;
+   if (format_id == EPSG_DB_FORMAT_A)
+   {
+      db.format = FORMAT_A;
+      code_field = A_CODE;
+   }
+   else if (format_id == STATE_PLANE_FORMAT_B)
+   {
+      db.format = FORMAT_B;
+      code_field = B_CODE;
+   }
+   else if (format_id == SPCS_EPSG_MAP_FORMAT_C)
+   {
+      db.format = FORMAT_C;
+      code_field = C_CODE;
+   }
+   else
+      return false;
+
+   // The file is good. Skip over the column descriptor line:
+   const char* line = (line_end == data_end) ? data_end : line_end + 1;
+   line = (line == data_end) ? data_end : std::find(line, data_end, '\n');
+   if (line != data_end)
+      ++line;
+
+   // Only the code and name are read here. Fields are split like rspfString::explode(","), 
+   // i.e., empty fields are skipped:
+   std::vector<DbFile::Entry> entries;
+   std::string names;
+   while (line < data_end)
+   {
+      line_end = std::find(line, data_end, '\n');
 
-      // The file is good. Skip over the column descriptor line:
-      std::getline(db_stream, line.string());
+      const char* field[2] = { 0, 0 };
+      const char* field_end[2] = { 0, 0 };
+      rspf_uint32 num_fields = 0;
+      const char* c = line;
+      while ((c < line_end) && (num_fields < 2))
+      {
+         while ((c < line_end) && (*c == ','))
+            ++c;
+         if (c == line_end)
+            break;
+         field[num_fields] = c;
+         while ((c < line_end) && (*c != ','))
+            ++c;
+         field_end[num_fields++] = c;
+      }
 
-      // Loop to read all data records:
-      while (!db_stream.eof())
+      if (num_fields)
       {
-         rspfRefPtr<ProjDbRecord> db_record = new ProjDbRecord;
-         std::getline(db_stream, line.string());
-         db_record->csvRecord = line.explode(","); // ONLY CSV FILES CONSIDERED HERE
-         if (db_record->csvRecord.size())
+         // The code is the first field in format A, the second in B and C; the name is the other:
+         rspf_uint32 name_field = 1 - code_field;
+         DbFile::Entry entry;
+         entry.code = 0;
+         if (code_field < num_fields)
+            entry.code = rspfString(std::string(field[code_field], field_end[code_field])).toUInt32();
+         entry.nameOffset = (rspf_uint32) names.size();
+         entry.nameLength = 0;
+         if (name_field < num_fields)
          {
-            rspfRefPtr<rspfMapProjection> proj;
+            entry.nameLength = (rspf_uint32) (field_end[name_field] - field[name_field]);
+            names.append(field[name_field], entry.nameLength);
+         }
+         entry.lineOffset = (rspf_uint64) (line - data);
+         entry.lineLength = (rspf_uint32) (line_end - line);
+         entries.push_back(entry);
+      }
 
-            // Check if primary EPSG database format A:
-            if (format_id == EPSG_DB_FORMAT_A)
+      line = line_end + 1;
+   }
+   db.csv->advise(rspfMemoryMappedFile::RANDOM);
+
+   // Sort by code, keeping line order for duplicate codes:
+   std::stable_sort(entries.begin(), entries.end());
+
+   IndexHeader header;
+   memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+   header.version   = INDEX_VERSION;
+   header.format    = (rspf_uint32) db.format;
+   header.csvSize   = csvSize;
+   header.csvTime   = csvTime;
+   header.count     = (rspf_uint32) entries.size();
+   header.namesSize = (rspf_uint32) names.size();
+
+   // Write to a temporary and rename so other processes never map a partial index:
+   if (!indexFile.empty())
+   {
+      rspfFilename dir = indexFile.path();
+      if (dir.exists() || dir.createDirectory())
+      {
+         rspfFilename tmp_file = indexFile + ".tmp";
+         std::ofstream out (tmp_file.c_str(), std::ios::out | std::ios::binary);
+         out.write((const char*) &header, sizeof(header));
+         if (entries.size())
+            out.write((const char*) &entries[0], entries.size() * sizeof(DbFile::Entry));
+         out.write(names.data(), names.size());
+         out.close();
+         if (out.good() && tmp_file.rename(indexFile, true))
+         {
+            rspfRefPtr<rspfMemoryMappedFile> index = new rspfMemoryMappedFile;
+            if (index->open(indexFile) && 
+                (index->getSize() == sizeof(header) + entries.size() * sizeof(DbFile::Entry) +
+                 names.size()))
             {
-               db_record->code = db_record->csvRecord[A_CODE].toUInt32();
-               db_record->name = db_record->csvRecord[A_NAME];
-               db_record->csvFormat = FORMAT_A;
+               db.index   = index;
+               db.count   = header.count;
+               db.entries = (const DbFile::Entry*) (index->getData() + sizeof(IndexHeader));
+               db.names   = (const char*) (db.entries + db.count);
+               return true;
             }
+         }
+         else
+            tmp_file.remove();
+      }
+   }
 
-            // Check if State Plane (subset of EPSG but handled differently until projection 
-            // geotrans-EPSG disconnect is resolved. 
-            else if (format_id == STATE_PLANE_FORMAT_B)
-            {
-               db_record->code = db_record->csvRecord[B_CODE].toUInt32();
-               db_record->name = db_record->csvRecord[B_NAME];
-               db_record->csvFormat = FORMAT_B;
-            }
+   // No index file, hold it in memory (8 byte words keep the entries aligned):
+   const rspf_uint64 entries_size = entries.size() * sizeof(DbFile::Entry);
+   db.indexBuffer.resize((size_t) ((entries_size + names.size() + 7) / 8) + 1);
+   char* buffer = (char*) &db.indexBuffer[0];
+   if (entries_size)
+      memcpy(buffer, &entries[0], (size_t) entries_size);
+   if (names.size())
+      memcpy(buffer + entries_size, names.data(), names.size());
+   db.index   = 0;
+   db.count   = header.count;
+   db.entries = (const DbFile::Entry*) buffer;
+   db.names   = buffer + entries_size;
+   return true;
+}
 
-            // This format is for Ming-special State Plane Coordinate System coded format.
-            // This format is simply a mapping from SPCS spec name (RSPF-specific) to EPSG code.
-            // Note that no proj is instantiated and no KWL is populated. Only name and EPSG mapped
-            // code is saved.
-            else if (format_id == SPCS_EPSG_MAP_FORMAT_C)
-            {
-               db_record->code = db_record->csvRecord[C_CODE].toUInt32();
-               db_record->name = db_record->csvRecord[C_NAME];
-               db_record->csvFormat = FORMAT_C;
-            }
+//*************************************************************************************************
+//! Index file name for a Db CSV file, empty if no index directory.
+//*************************************************************************************************
+rspfFilename rspfEpsgProjectionDatabase::getIndexFile(const rspfFilename& csvFile) const
+{
+   rspfFilename dir = rspfPreferences::instance()->findPreference("epsg_database_index_dir");
+   if (dir.empty())
+   {
+      dir = rspfEnvironmentUtility::instance()->getUserOssimSupportDir();
+      if (dir.empty())
+         return rspfFilename();
+      dir = dir.dirCat("epsg_index");
+   }
 
-            m_projDatabase.insert(make_pair(db_record->code, db_record));
-         }
+   // Same named CSV files from different directories get their own index (FNV-1a of the path):
+   rspfString path = csvFile.expand();
+   rspf_uint32 hash = 2166136261U;
+   for (std::string::size_type i = 0; i < path.size(); ++i)
+   {
+      hash ^= (rspf_uint8) path[i];
+      hash *= 16777619U;
+   }
+   char hash_str[16];
+   sprintf(hash_str, "%08x", hash);
+
+   rspfFilename index_name = csvFile.file() + "_" + hash_str + ".idx";
+   return dir.dirCat(index_name);
+}
+
+//*************************************************************************************************
+//! Returns the record of the first entry with code, decoding its CSV line if not done yet.
+//*************************************************************************************************
+rspfEpsgProjectionDatabase::ProjDbRecord* 
+rspfEpsgProjectionDatabase::getRecord(rspf_uint32 code) const
+{
+   OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(m_projDatabaseMutex);
+   std::map<rspf_uint32, rspfRefPtr<ProjDbRecord> >::iterator db_iter = m_projDatabase.find(code);
+   if (db_iter != m_projDatabase.end())
+      return db_iter->second.get();
+
+   // Db files are searched in preferences order, first one wins:
+   for (std::vector< rspfRefPtr<DbFile> >::const_iterator f = m_dbFiles.begin(); 
+        f != m_dbFiles.end(); ++f)
+   {
+      const DbFile* db = f->get();
+      rspf_uint32 i = db->find(code);
+      if (i == db->count)
+         continue;
+
+      rspfRefPtr<ProjDbRecord> db_record = new ProjDbRecord;
+      db_record->code = code;
+      db_record->name = db->name(i);
+      db_record->csvFormat = db->format;
+      db_record->csvRecord = db->line(i).explode(","); // ONLY CSV FILES CONSIDERED HERE
+      m_projDatabase.insert(make_pair(code, db_record));
+      return db_record.get();
+   }
+
+   return 0;
+}
+
+//*************************************************************************************************
+//! All entries ordered by code, then by Db file and line.
+//*************************************************************************************************
+void rspfEpsgProjectionDatabase::getEntries(std::vector<EntryRef>& entries) const
+{
+   entries.clear();
+   for (rspf_uint32 f = 0; f < (rspf_uint32) m_dbFiles.size(); ++f)
+   {
+      const DbFile* db = m_dbFiles[f].get();
+      for (rspf_uint32 i = 0; i < db->count; ++i)
+      {
+         EntryRef entry;
+         entry.code  = db->entries[i].code;
+         entry.file  = f;
+         entry.entry = i;
+         entries.push_back(entry);
       }
+   }
+   std::stable_sort(entries.begin(), entries.end());
+}
 
-      db_stream.close();
-   } // end of while loop over all DB files
+//*************************************************************************************************
+//! ENGINEERING CODE. Used for testing
+//*************************************************************************************************
+size_t rspfEpsgProjectionDatabase::numRecords() const
+{
+   size_t count = 0;
+   for (std::vector< rspfRefPtr<DbFile> >::const_iterator f = m_dbFiles.begin(); 
+        f != m_dbFiles.end(); ++f)
+      count += (*f)->count;
+   return count;
+}
+
+rspfString rspfEpsgProjectionDatabase::DbFile::name(rspf_uint32 i) const
+{
+   return rspfString(std::string(names + entries[i].nameOffset, entries[i].nameLength));
+}
+
+rspfString rspfEpsgProjectionDatabase::DbFile::line(rspf_uint32 i) const
+{
+   const char* data = (const char*) csv->getData();
+   if ((entries[i].lineOffset + entries[i].lineLength) > csv->getSize())
+      return rspfString();
+   return rspfString(std::string(data + entries[i].lineOffset, entries[i].lineLength));
+}
+
+rspf_uint32 rspfEpsgProjectionDatabase::DbFile::find(rspf_uint32 code) const
+{
+   // Binary search for the first entry with code:
+   rspf_uint32 lo = 0;
+   rspf_uint32 hi = count;
+   while (lo < hi)
+   {
+      rspf_uint32 mid = lo + (hi - lo) / 2;
+      if (entries[mid].code < code)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   if ((lo < count) && (entries[lo].code == code))
+      return lo;
+   return count;
 }
 
 //*************************************************************************************************
@@ -301,13 +578,13 @@ rspfProjection* rspfEpsgProjectionDatabase::findProjection(rspf_uint32 epsg_code
 
    else
    {
-      // Search database for entry:
-      std::multimap<rspf_uint32, rspfRefPtr<ProjDbRecord> >::iterator db_iter = 
-         m_projDatabase.find(epsg_code);
-      if (db_iter != m_projDatabase.end())
+      // Search database for entry. The record and its cached projection are shared between
+      // threads:
+      OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(m_projDatabaseMutex);
+      ProjDbRecord* db_record = getRecord(epsg_code);
+      if (db_record)
       {
          // See if a projection has already been created for this entry:
-         ProjDbRecord* db_record = db_iter->second.get();
          if (db_record->proj.valid())
             proj = (rspfMapProjection*) db_record->proj->dup();
          else
@@ -319,9 +596,9 @@ rspfProjection* rspfEpsgProjectionDatabase::findProjection(rspf_uint32 epsg_code
                db_record->proj = proj;
                db_record->datumValid = true;
             }
-            else if (db_iter->second->csvFormat == FORMAT_A)
+            else if (db_record->csvFormat == FORMAT_A)
                proj = createProjFromFormatARecord(db_record);
-            else if (db_iter->second->csvFormat == FORMAT_B)
+            else if (db_record->csvFormat == FORMAT_B)
                proj = createProjFromFormatBRecord(db_record);
 
             if (proj)
@@ -330,6 +607,10 @@ rspfProjection* rspfEpsgProjectionDatabase::findProjection(rspf_uint32 epsg_code
                // projection is now represented in the database:
                db_record->csvRecord.clear();
                db_record->csvFormat = NOT_ASSIGNED;
+
+               // Hand out a copy so the caller cannot modify the cached instance:
+               if (db_record->proj.valid())
+                  proj = (rspfMapProjection*) db_record->proj->dup();
             }
          }
       }
@@ -373,16 +654,19 @@ rspfProjection* rspfEpsgProjectionDatabase::findProjection(const rspfString& spe
    vector<rspfString> split_spec = spec.split(separators, true);
    vector<rspfString> split_db_name;
    rspfRefPtr<rspfMapProjection> map_proj = 0;
-   std::multimap<rspf_uint32, rspfRefPtr<ProjDbRecord> >::iterator db_iter = m_projDatabase.begin();
-   while ((db_iter != m_projDatabase.end()) && !proj)
+   std::vector<EntryRef> entries;
+   getEntries(entries);
+   std::vector<EntryRef>::const_iterator db_iter = entries.begin();
+   while ((db_iter != entries.end()) && !proj)
    {
-      ProjDbRecord* db_record = db_iter->second.get();
       split_db_name.clear();
-      db_record->name.split(split_db_name, separators, true);
+      m_dbFiles[db_iter->file]->name(db_iter->entry).split(split_db_name, separators, true);
       if (split_spec == split_db_name)
       {
          // We may already have instantiated this projection, in which case just return its copy.
          // Otherwise, create the projection from the EPSG code that corresponds to the name:
+         OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(m_projDatabaseMutex);
+         ProjDbRecord* db_record = getRecord(db_iter->code);
          if (db_record->proj.valid())
             proj = (rspfMapProjection*) db_record->proj->dup();
          else
@@ -413,12 +697,13 @@ rspfProjection* rspfEpsgProjectionDatabase::findProjection(const rspfString& spe
 //*************************************************************************************************
 rspf_uint32 rspfEpsgProjectionDatabase::findProjectionCode(const rspfString& proj_name) const
 {
-   std::multimap<rspf_uint32, rspfRefPtr<ProjDbRecord> >::iterator db_iter = m_projDatabase.begin();
-   while (db_iter != m_projDatabase.end())
+   std::vector<EntryRef> entries;
+   getEntries(entries);
+   std::vector<EntryRef>::const_iterator db_iter = entries.begin();
+   while (db_iter != entries.end())
    {
-      ProjDbRecord* db_record = db_iter->second.get();
-      if (db_record->name == proj_name)
-         return (db_record->code);
+      if (m_dbFiles[db_iter->file]->name(db_iter->entry) == proj_name)
+         return (db_iter->code);
       db_iter++;
    }
       
@@ -449,10 +734,19 @@ rspfEpsgProjectionDatabase::findProjectionCode(const rspfMapProjection& lost_pro
    }
 
    rspfString lookup;
-   std::multimap<rspf_uint32, rspfRefPtr<ProjDbRecord> >::iterator db_iter = m_projDatabase.begin();
-   while ((db_iter != m_projDatabase.end()) && (found_code == 0))
+   OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(m_projDatabaseMutex);
+   std::vector<EntryRef> entries;
+   getEntries(entries);
+   std::vector<EntryRef>::const_iterator db_iter = entries.begin();
+   while ((db_iter != entries.end()) && (found_code == 0))
    {
-      ProjDbRecord* db_record = db_iter->second.get();
+      // Duplicate codes all resolve to the first entry's record:
+      if ((db_iter != entries.begin()) && ((db_iter - 1)->code == db_iter->code))
+      {
+         db_iter++;
+         continue;
+      }
+      ProjDbRecord* db_record = getRecord(db_iter->code);
       
       // Has a projection already been created for this db iter?
       if (!db_record->proj.valid())
@@ -483,11 +777,16 @@ rspfEpsgProjectionDatabase::findProjectionCode(const rspfMapProjection& lost_pro
 rspfString rspfEpsgProjectionDatabase::findProjectionName(rspf_uint32 epsg_code) const
 {
    rspfString name ("");
-   std::multimap<rspf_uint32, rspfRefPtr<ProjDbRecord> >::iterator db_iter = 
-       m_projDatabase.find(epsg_code);
-   
-   if (db_iter != m_projDatabase.end())
-      name = db_iter->second->name;
+   for (std::vector< rspfRefPtr<DbFile> >::const_iterator f = m_dbFiles.begin(); 
+        f != m_dbFiles.end(); ++f)
+   {
+      rspf_uint32 i = (*f)->find(epsg_code);
+      if (i != (*f)->count)
+      {
+         name = (*f)->name(i);
+         break;
+      }
+   }
    
    return name;
 }
@@ -500,14 +799,15 @@ rspfString rspfEpsgProjectionDatabase::findProjectionName(rspf_uint32 epsg_code)
 //*************************************************************************************************
 void rspfEpsgProjectionDatabase::getProjectionsList(std::vector<rspfString>& list) const
 {
-   std::multimap<rspf_uint32, rspfRefPtr<ProjDbRecord> >::iterator db_iter = m_projDatabase.begin();
-   while (db_iter != m_projDatabase.end())
+   std::vector<EntryRef> entries;
+   getEntries(entries);
+   std::vector<EntryRef>::const_iterator db_iter = entries.begin();
+   while (db_iter != entries.end())
    {
-      ProjDbRecord* db_record = db_iter->second.get();
       rspfString record ("EPSG:");
-      record += rspfString::toString(db_record->code);
+      record += rspfString::toString(db_iter->code);
       record += "  \"";
-      record += db_record->name;
+      record += m_dbFiles[db_iter->file]->name(db_iter->entry);
       record += "\"";
       list.push_back(record);
       db_iter++;
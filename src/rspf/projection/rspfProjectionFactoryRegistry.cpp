@@ -23,6 +23,8 @@ rspfProjectionFactoryRegistry* rspfProjectionFactoryRegistry::m_instance = 0;
 
 
 rspfProjectionFactoryRegistry::rspfProjectionFactoryRegistry()
+   : rspfObjectFactory(),
+     rspfFactoryListInterface<rspfProjectionFactoryBase, rspfProjection>("projection")
 {
    initializeDefaults();
    rspfObjectFactoryRegistry::instance()->registerFactory(this);
@@ -54,6 +56,7 @@ rspfProjection*
 rspfProjectionFactoryRegistry::createProjection(const rspfFilename& name,
                                                  rspf_uint32 entryIdx)const
 {
+   loadDeferredPlugins();
    rspfProjection* result = 0;
    rspf_uint32 idx = 0;
    for(idx = 0; ((idx < m_factoryList.size())&&(!result)); ++idx)
@@ -66,6 +69,7 @@ rspfProjectionFactoryRegistry::createProjection(const rspfFilename& name,
 
 rspfProjection* rspfProjectionFactoryRegistry::createProjection(rspfImageHandler* handler)const
 {
+   loadDeferredPlugins();
    rspfProjection* result = 0;
    rspf_uint32 idx = 0;
    for(idx = 0; ((idx < m_factoryList.size())&&(!result)); ++idx)
@@ -79,6 +83,7 @@ rspfProjection* rspfProjectionFactoryRegistry::createProjection(rspfImageHandler
 rspfProjection* rspfProjectionFactoryRegistry::createProjection(
    const rspfKeywordlist& kwl, const char* prefix)const
 {
+   loadDeferredPlugins();
    rspfProjection* result = 0;//createNativeObjectFromRegistry(kwl, prefix); 
    rspf_uint32 idx = 0; 
    for(idx = 0; ((idx < m_factoryList.size())&&!result);++idx) 
@@ -13,6 +13,7 @@
 #include <rspf/support_data/rspfInfoFactoryRegistry.h>
 #include <rspf/support_data/rspfInfoFactoryInterface.h>
 #include <rspf/support_data/rspfInfoFactory.h>
+#include <rspf/base/rspfFactoryListInterface.h>
 
 #include <algorithm> /* for std::find */
 
@@ -71,6 +72,8 @@ void rspfInfoFactoryRegistry::unregisterFactory(
 rspfInfoBase* rspfInfoFactoryRegistry::create(
    const rspfFilename& file) const
 {
+   rspfLoadDeferredPlugins("info");
+
    rspfInfoBase* result = 0;
    
    std::vector<rspfInfoFactoryInterface*>::const_iterator i =
@@ -89,6 +92,11 @@ rspfInfoBase* rspfInfoFactoryRegistry::create(
    return result;
 }
 
+rspf_uint32 rspfInfoFactoryRegistry::getNumberOfFactories() const
+{
+   return (rspf_uint32)m_factoryList.size();
+}
+
 /** hidden from use default constructor */
 rspfInfoFactoryRegistry::rspfInfoFactoryRegistry()
    : m_factoryList(),
@@ -111,3 +111,8 @@ const rspfNitfTagFactoryRegistry& rspfNitfTagFactoryRegistry::operator=(
 {
    return *this;
 }
+
+rspf_uint32 rspfNitfTagFactoryRegistry::getNumberOfFactories()const
+{
+   return (rspf_uint32)theFactoryList.size();
+}
@@ -0,0 +1,1213 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfBenchmarkUtil.cpp
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description: Utility class definition for timing the core tile paths.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#include <rspf/util/rspfBenchmarkUtil.h>
+
+#include <rspf/base/rspfApplicationUsage.h>
+#include <rspf/base/rspfArgumentParser.h>
+#include <rspf/base/rspfCommon.h>
+#include <rspf/base/rspfException.h>
+#include <rspf/base/rspfGpt.h>
+#include <rspf/base/rspfIrect.h>
+#include <rspf/base/rspfMultiBandHistogram.h>
+#include <rspf/base/rspfNotify.h>
+#include <rspf/base/rspfTimer.h>
+
+#include <rspf/elevation/rspfElevManager.h>
+#include <rspf/elevation/rspfSrtmElevationDatabase.h>
+
+#include <rspf/imaging/rspfFilterResampler.h>
+#include <rspf/imaging/rspfImageData.h>
+#include <rspf/imaging/rspfImageGeometry.h>
+#include <rspf/imaging/rspfImageRenderer.h>
+#include <rspf/imaging/rspfMemoryImageSource.h>
+#include <rspf/imaging/rspfResampler.h>
+#include <rspf/imaging/rspfSingleImageChain.h>
+#include <rspf/imaging/rspfTiffTileSource.h>
+#include <rspf/imaging/rspfTiffWriter.h>
+
+#include <rspf/init/rspfInit.h>
+
+#include <rspf/parallel/rspfMultiThreadSequencer.h>
+
+#include <rspf/projection/rspfEquDistCylProjection.h>
+#include <rspf/projection/rspfRpcModel.h>
+#include <rspf/projection/rspfUtmProjection.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+// Footprint of the synthetic images, degrees.
+static const double CENTER_LAT = 35.0;
+static const double CENTER_LON = -100.0;
+static const double EXTENT     = 0.1;
+
+static const char TIFF_FILE[] = "benchmark.tif";
+
+// SRTM cells around the footprint, 3 arc second.
+static const char* SRTM_CELLS[] = { "N34W101.hgt", "N34W100.hgt",
+                                    "N35W101.hgt", "N35W100.hgt" };
+static const rspf_uint32 SRTM_POSTS = 1201;
+
+namespace
+{
+   const char* scalarName(rspfScalarType scalar)
+   {
+      switch (scalar)
+      {
+         case RSPF_UINT8:   return "uint8";
+         case RSPF_UINT16:  return "uint16";
+         case RSPF_SINT16:  return "sint16";
+         case RSPF_FLOAT32: return "float32";
+         case RSPF_FLOAT64: return "float64";
+         default:            return "unknown";
+      }
+   }
+
+   const char* interleaveName(rspfInterleaveType il)
+   {
+      switch (il)
+      {
+         case RSPF_BIP: return "bip";
+         case RSPF_BIL: return "bil";
+         default:        return "bsq";
+      }
+   }
+
+   /** Smooth surface plus hashed noise in [0.2, 0.8], same on every run. */
+   double pattern(rspf_uint32 x, rspf_uint32 y, rspf_uint32 band)
+   {
+      rspf_uint32 h = (x * 73856093u) ^ (y * 19349663u) ^ (band * 83492791u);
+      h ^= h >> 13;
+      h *= 0x5bd1e995u;
+      h ^= h >> 15;
+      double noise  = (h & 0xffff) / 65535.0;
+      double smooth = 0.5 + 0.25 * std::sin(x * 0.031 + band) * std::cos(y * 0.017);
+      return 0.8 * smooth + 0.2 * noise;
+   }
+
+   template <class T> void fillBand(T* buf,
+                                    rspf_uint32 width,
+                                    rspf_uint32 height,
+                                    rspf_uint32 band,
+                                    double minValue,
+                                    double maxValue)
+   {
+      for (rspf_uint32 y = 0; y < height; ++y)
+      {
+         for (rspf_uint32 x = 0; x < width; ++x)
+         {
+            *buf++ = (T)(minValue + pattern(x, y, band) * (maxValue - minValue));
+         }
+      }
+   }
+
+   /** Number of tileSize tiles covering a size square. */
+   rspf_uint32 tileCount(rspf_uint32 size, rspf_uint32 tileSize)
+   {
+      rspf_uint32 n = (size + tileSize - 1) / tileSize;
+      return n * n;
+   }
+
+   bool writeTiff(rspfImageSource* source, const rspfFilename& file, rspf_uint32 tileSize)
+   {
+      rspfRefPtr<rspfTiffWriter> writer = new rspfTiffWriter();
+      writer->connectMyInputTo(0, source);
+      writer->setFilename(file);
+      writer->setGeotiffFlag(true);
+      writer->setTileSize(rspfIpt(tileSize, tileSize));
+      writer->setWriteOverviewFlag(false);
+      writer->setWriteHistogramFlag(false);
+      writer->setWriteExternalGeometryFlag(false);
+      bool result = writer->execute();
+      writer->disconnect();
+      return result;
+   }
+
+   void getAllTiles(rspfImageSource* source, rspf_uint32 tileSize)
+   {
+      rspfIrect rect = source->getBoundingRect();
+      for (rspf_int32 y = rect.ul().y; y <= rect.lr().y; y += tileSize)
+      {
+         for (rspf_int32 x = rect.ul().x; x <= rect.lr().x; x += tileSize)
+         {
+            source->getTile(rspfIrect(x, y, x + tileSize - 1, y + tileSize - 1));
+         }
+      }
+   }
+
+   //---
+   // Timed operations:
+   //---
+
+   class LoadCase : public rspfBenchmarkUtil::Case
+   {
+   public:
+      LoadCase(rspfImageData* tile, const void* buf, const rspfIrect& rect,
+               rspfInterleaveType il, bool unload)
+         : m_tile(tile), m_buf(buf), m_rect(rect), m_il(il), m_unload(unload) {}
+      virtual void run()
+      {
+         rspf_int32 w = (rspf_int32)m_tile->getWidth();
+         rspf_int32 h = (rspf_int32)m_tile->getHeight();
+         for (rspf_int32 y = m_rect.ul().y; y <= m_rect.lr().y; y += h)
+         {
+            for (rspf_int32 x = m_rect.ul().x; x <= m_rect.lr().x; x += w)
+            {
+               m_tile->setImageRectangle(rspfIrect(x, y, x + w - 1, y + h - 1));
+               if (m_unload)
+               {
+                  m_tile->unloadTile(const_cast<void*>(m_buf), m_rect, m_il);
+               }
+               else
+               {
+                  m_tile->loadTile(m_buf, m_rect, m_il);
+               }
+            }
+         }
+      }
+   private:
+      rspfImageData*     m_tile;
+      const void*        m_buf;
+      rspfIrect          m_rect;
+      rspfInterleaveType m_il;
+      bool               m_unload;
+   };
+
+   class ConvertCase : public rspfBenchmarkUtil::Case
+   {
+   public:
+      ConvertCase(rspfImageData* src, rspfImageData* dest, rspf_uint32 count)
+         : m_src(src), m_dest(dest), m_count(count) {}
+      virtual void run()
+      {
+         for (rspf_uint32 i = 0; i < m_count; ++i)
+         {
+            m_dest->loadTile(m_src);
+         }
+      }
+   private:
+      rspfImageData* m_src;
+      rspfImageData* m_dest;
+      rspf_uint32    m_count;
+   };
+
+   /** Rotated 0.8 scale affine mapping from an output tile into the input. */
+   struct AffineMap
+   {
+      AffineMap(rspf_uint32 tileSize)
+      {
+         double n = tileSize - 1.0;
+         m_ul = rspfDpt(tileSize * 0.5, tileSize * 0.5);
+         m_ur = m_ul + rspfDpt(n * 0.8, -n * 0.1);
+         rspfDpt ll = m_ul + rspfDpt(n * 0.1, n * 0.8);
+         rspfDpt lr = m_ur + rspfDpt(n * 0.1, n * 0.8);
+         m_deltaUl = rspfDpt((ll.x - m_ul.x) / n, (ll.y - m_ul.y) / n);
+         m_deltaUr = rspfDpt((lr.x - m_ur.x) / n, (lr.y - m_ur.y) / n);
+         m_length  = rspfDpt(tileSize, tileSize);
+      }
+      rspfDpt m_ul;
+      rspfDpt m_ur;
+      rspfDpt m_deltaUl;
+      rspfDpt m_deltaUr;
+      rspfDpt m_length;
+   };
+
+   class ResampleCase : public rspfBenchmarkUtil::Case
+   {
+   public:
+      ResampleCase(rspfResampler* resampler, rspfImageData* input,
+                   rspfImageData* output, rspf_uint32 count)
+         : m_resampler(resampler), m_input(input), m_output(output),
+           m_map(output->getWidth()), m_count(count) {}
+      virtual void run()
+      {
+         for (rspf_uint32 i = 0; i < m_count; ++i)
+         {
+            m_resampler->resample(m_input, m_output, m_map.m_ul, m_map.m_ur,
+                                  m_map.m_deltaUl, m_map.m_deltaUr, m_map.m_length);
+         }
+      }
+   private:
+      rspfResampler* m_resampler;
+      rspfImageData* m_input;
+      rspfImageData* m_output;
+      AffineMap      m_map;
+      rspf_uint32    m_count;
+   };
+
+   class FilterResampleCase : public rspfBenchmarkUtil::Case
+   {
+   public:
+      FilterResampleCase(rspfFilterResampler* resampler,
+                         rspfRefPtr<rspfImageData> input,
+                         rspfRefPtr<rspfImageData> output,
+                         rspf_uint32 count)
+         : m_resampler(resampler), m_input(input), m_output(output),
+           m_map(output->getWidth()), m_count(count) {}
+      virtual void run()
+      {
+         for (rspf_uint32 i = 0; i < m_count; ++i)
+         {
+            m_resampler->resample(m_input, m_output, m_map.m_ul, m_map.m_ur,
+                                  m_map.m_deltaUl, m_map.m_deltaUr, m_map.m_length);
+         }
+      }
+   private:
+      rspfFilterResampler*      m_resampler;
+      rspfRefPtr<rspfImageData> m_input;
+      rspfRefPtr<rspfImageData> m_output;
+      AffineMap                  m_map;
+      rspf_uint32               m_count;
+   };
+
+   class TilesCase : public rspfBenchmarkUtil::Case
+   {
+   public:
+      TilesCase(rspfImageSource* source, rspf_uint32 tileSize)
+         : m_source(source), m_tileSize(tileSize) {}
+      virtual void run() { getAllTiles(m_source, m_tileSize); }
+   private:
+      rspfImageSource* m_source;
+      rspf_uint32      m_tileSize;
+   };
+
+   class TiffWriteCase : public rspfBenchmarkUtil::Case
+   {
+   public:
+      TiffWriteCase(rspfImageSource* source, const rspfFilename& file, rspf_uint32 tileSize)
+         : m_source(source), m_file(file), m_tileSize(tileSize) {}
+      virtual void run()
+      {
+         if (!writeTiff(m_source, m_file, m_tileSize))
+         {
+            throw rspfException(std::string("Could not write ") + m_file.string());
+         }
+      }
+   private:
+      rspfImageSource* m_source;
+      rspfFilename     m_file;
+      rspf_uint32      m_tileSize;
+   };
+
+   class TiffReadCase : public rspfBenchmarkUtil::Case
+   {
+   public:
+      TiffReadCase(const rspfFilename& file, rspf_uint32 tileSize)
+         : m_file(file), m_tileSize(tileSize) {}
+      virtual void run()
+      {
+         rspfRefPtr<rspfTiffTileSource> ts = new rspfTiffTileSource();
+         if (!ts->open(m_file))
+         {
+            throw rspfException(std::string("Could not open ") + m_file.string());
+         }
+         getAllTiles(ts.get(), m_tileSize);
+      }
+   private:
+      rspfFilename m_file;
+      rspf_uint32  m_tileSize;
+   };
+
+   class ElevationCase : public rspfBenchmarkUtil::Case
+   {
+   public:
+      ElevationCase(const std::vector<rspfGpt>& points)
+         : m_points(points), m_sum(0.0) {}
+      virtual void run()
+      {
+         rspfElevManager* mgr = rspfElevManager::instance();
+         for (std::vector<rspfGpt>::const_iterator i = m_points.begin(); i != m_points.end(); ++i)
+         {
+            m_sum += mgr->getHeightAboveMSL(*i);
+         }
+      }
+   private:
+      const std::vector<rspfGpt>& m_points;
+      double m_sum; //!< Keeps the lookups from being optimized out.
+   };
+
+   class HistogramCase : public rspfBenchmarkUtil::Case
+   {
+   public:
+      HistogramCase(rspfImageData* tile, rspfMultiBandHistogram* histo, rspf_uint32 count)
+         : m_tile(tile), m_histo(histo), m_count(count) {}
+      virtual void run()
+      {
+         for (rspf_uint32 i = 0; i < m_count; ++i)
+         {
+            m_tile->populateHistogram(m_histo);
+         }
+      }
+   private:
+      rspfImageData*          m_tile;
+      rspfMultiBandHistogram* m_histo;
+      rspf_uint32             m_count;
+   };
+
+   class SequencerCase : public rspfBenchmarkUtil::Case
+   {
+   public:
+      SequencerCase(rspfImageSourceSequencer* sequencer) : m_sequencer(sequencer) {}
+      virtual void run()
+      {
+         m_sequencer->setToStartOfSequence();
+         rspf_uint32 tiles = m_sequencer->getNumberOfTiles();
+         for (rspf_uint32 i = 0; i < tiles; ++i)
+         {
+            m_sequencer->getNextTile();
+         }
+      }
+   private:
+      rspfImageSourceSequencer* m_sequencer;
+   };
+}
+
+rspfBenchmarkUtil::rspfBenchmarkUtil()
+   : rspfReferenced(),
+     m_size(2048),
+     m_tileSize(256),
+     m_iterations(3),
+     m_threads(0),
+     m_tolerance(0.1),
+     m_filters(),
+     m_outputFile("rspf-benchmark.json"),
+     m_baselineFile(),
+     m_workDir("rspf-benchmark-work"),
+     m_results()
+{
+}
+
+rspfBenchmarkUtil::~rspfBenchmarkUtil()
+{
+}
+
+void rspfBenchmarkUtil::addArguments(rspfArgumentParser& ap)
+{
+   rspfString usageString = ap.getApplicationName();
+   usageString += " [option]...\nRuns the core tile path benchmarks on synthetic data and writes the timings as JSON.";
+
+   rspfApplicationUsage* appuse = ap.getApplicationUsage();
+
+   appuse->setCommandLineUsage(usageString);
+
+   appuse->setDescription(ap.getApplicationName()+" Benchmarks rspfImageData, resamplers, rendering, tiff io, elevation lookups, histograms and the multi-threaded sequencer.");
+
+   appuse->addCommandLineOption("--baseline", "<file.json>\nCompares the run to a file written by an earlier run. Exits with an error if a benchmark is slower than the tolerance.");
+
+   appuse->addCommandLineOption("--benchmark", "<name>\nRuns only benchmarks starting with name, e.g. \"tiff\" or \"resampler.bilinear\". Any number of these can appear on the line.");
+
+   appuse->addCommandLineOption("-h or --help", "Display this help and exit.");
+
+   appuse->addCommandLineOption("--iterations", "<n>\nTimed runs per benchmark, after one untimed run. Default = 3");
+
+   appuse->addCommandLineOption("--output", "<file.json>\nOutput file. Default = rspf-benchmark.json");
+
+   appuse->addCommandLineOption("--size", "<pixels>\nWidth and height of the synthetic images. Default = 2048");
+
+   appuse->addCommandLineOption("--threads", "<n>\nMost threads for the sequencer benchmarks, which run with 1, 2, 4... up to n. Zero uses the number of cores. Default = 0");
+
+   appuse->addCommandLineOption("--tile-size", "<pixels>\nTile width and height. Default = 256");
+
+   appuse->addCommandLineOption("--tolerance", "<fraction>\nAllowed slowdown against the baseline, 0.1 = 10%. Default = 0.1");
+
+   appuse->addCommandLineOption("--work-dir", "<dir>\nDirectory for temporary files, removed when done. Default = rspf-benchmark-work");
+}
+
+bool rspfBenchmarkUtil::initialize(rspfArgumentParser& ap)
+{
+   if( ap.read("-h") || ap.read("--help") )
+   {
+      usage(ap);
+
+      return false; // Indicates process should be terminated to caller.
+   }
+
+   rspfString tempString1;
+   rspfArgumentParser::rspfParameter stringParam1(tempString1);
+
+   if( ap.read("--baseline", stringParam1) )
+   {
+      m_baselineFile = tempString1;
+   }
+
+   while( ap.read("--benchmark", stringParam1) )
+   {
+      m_filters.push_back( tempString1.string() );
+   }
+
+   if( ap.read("--iterations", stringParam1) )
+   {
+      m_iterations = rspf::max<rspf_uint32>( tempString1.toUInt32(), 1 );
+   }
+
+   if( ap.read("--output", stringParam1) )
+   {
+      m_outputFile = tempString1;
+   }
+
+   if( ap.read("--size", stringParam1) )
+   {
+      m_size = rspf::max<rspf_uint32>( tempString1.toUInt32(), 64 );
+   }
+
+   if( ap.read("--threads", stringParam1) )
+   {
+      m_threads = tempString1.toUInt32();
+   }
+
+   if( ap.read("--tile-size", stringParam1) )
+   {
+      m_tileSize = rspf::max<rspf_uint32>( tempString1.toUInt32(), 16 );
+   }
+
+   if( ap.read("--tolerance", stringParam1) )
+   {
+      m_tolerance = tempString1.toDouble();
+   }
+
+   if( ap.read("--work-dir", stringParam1) )
+   {
+      m_workDir = tempString1;
+   }
+
+   return true;
+}
+
+void rspfBenchmarkUtil::usage(rspfArgumentParser& ap)
+{
+   // Add global usage options.
+   rspfInit::instance()->addOptions(ap);
+
+   // Set app name.
+   ap.getApplicationUsage()->setApplicationName(ap.getApplicationName());
+
+   // Add options.
+   addArguments(ap);
+
+   // Write usage.
+   ap.getApplicationUsage()->write(rspfNotify(rspfNotifyLevel_INFO));
+}
+
+bool rspfBenchmarkUtil::execute()
+{
+   static const char MODULE[] = "rspfBenchmarkUtil::execute";
+
+   m_results.clear();
+
+   if ( !m_workDir.exists() && !m_workDir.createDirectory() )
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << MODULE << " could not create " << m_workDir << std::endl;
+      return false;
+   }
+
+   // A failing group is reported and the others still run.
+   typedef void (rspfBenchmarkUtil::*Group)();
+   static const Group GROUPS[] =
+   {
+      &rspfBenchmarkUtil::runImageData,
+      &rspfBenchmarkUtil::runResampler,
+      &rspfBenchmarkUtil::runFilterResampler,
+      &rspfBenchmarkUtil::runRenderer,
+      &rspfBenchmarkUtil::runTiff,
+      &rspfBenchmarkUtil::runElevation,
+      &rspfBenchmarkUtil::runHistogram,
+      &rspfBenchmarkUtil::runSequencer
+   };
+   for (rspf_uint32 i = 0; i < sizeof(GROUPS) / sizeof(GROUPS[0]); ++i)
+   {
+      try
+      {
+         (this->*GROUPS[i])();
+      }
+      catch (const std::exception& e)
+      {
+         rspfNotify(rspfNotifyLevel_WARN) << MODULE << " " << e.what() << std::endl;
+      }
+   }
+
+   removeWorkFiles();
+
+   bool result = true;
+   if ( m_baselineFile.size() )
+   {
+      result = compareToBaseline();
+   }
+
+   std::ofstream out( m_outputFile.c_str() );
+   if ( out.good() )
+   {
+      writeJson(out);
+   }
+   else
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << MODULE << " could not write " << m_outputFile << std::endl;
+      result = false;
+   }
+
+   return result;
+}
+
+const std::vector<rspfBenchmarkUtil::Result>& rspfBenchmarkUtil::getResults() const
+{
+   return m_results;
+}
+
+void rspfBenchmarkUtil::time(const std::string& name, Case& c, rspf_uint64 pixels)
+{
+   if ( !isSelected(name) )
+   {
+      return;
+   }
+
+   const rspfTimer* timer = rspfTimer::instance();
+
+   c.run(); // Warm caches and lazy initialization.
+
+   Result result;
+   result.m_name            = name;
+   result.m_iterations      = m_iterations;
+   result.m_bestSeconds     = 0.0;
+   result.m_meanSeconds     = 0.0;
+   result.m_pixels          = pixels;
+   result.m_baselineSeconds = rspf::nan();
+   for (rspf_uint32 i = 0; i < m_iterations; ++i)
+   {
+      rspfTimer::Timer_t start = timer->tick();
+      c.run();
+      double seconds = timer->delta_s(start, timer->tick());
+      if ( (i == 0) || (seconds < result.m_bestSeconds) )
+      {
+         result.m_bestSeconds = seconds;
+      }
+      result.m_meanSeconds += seconds;
+   }
+   result.m_meanSeconds /= m_iterations;
+   m_results.push_back(result);
+
+   rspfNotify(rspfNotifyLevel_INFO)
+      << std::setiosflags(std::ios::left) << std::setw(44) << name
+      << std::resetiosflags(std::ios::left) << std::setw(12) << std::fixed
+      << std::setprecision(3) << result.m_bestSeconds * 1000.0 << " ms" << std::endl;
+}
+
+bool rspfBenchmarkUtil::isSelected(const std::string& name) const
+{
+   if ( m_filters.empty() )
+   {
+      return true;
+   }
+   for (rspf_uint32 i = 0; i < m_filters.size(); ++i)
+   {
+      const std::string& f = m_filters[i];
+      if ( (name.compare(0, f.size(), f) == 0) ||
+           (f.compare(0, name.size(), name) == 0) )
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+void rspfBenchmarkUtil::runImageData()
+{
+   if ( !isSelected("image_data.") )
+   {
+      return;
+   }
+
+   static const rspfScalarType SCALARS[] =
+      { RSPF_UINT8, RSPF_UINT16, RSPF_SINT16, RSPF_FLOAT32, RSPF_FLOAT64 };
+   static const rspfInterleaveType INTERLEAVES[] = { RSPF_BIP, RSPF_BIL, RSPF_BSQ };
+   const rspf_uint32 BANDS = 3;
+   const rspfIrect   rect(0, 0, m_size - 1, m_size - 1);
+   const rspf_uint64 pixels = (rspf_uint64)m_size * m_size;
+
+   for (rspf_uint32 s = 0; s < sizeof(SCALARS) / sizeof(SCALARS[0]); ++s)
+   {
+      std::string scalar = scalarName(SCALARS[s]);
+
+      // Content does not change the cost, so one buffer serves every interleave.
+      std::vector<rspf_uint8> buf;
+      {
+         rspfRefPtr<rspfImageData> image = createImage(SCALARS[s], BANDS, m_size, m_size);
+         buf.resize(image->getSizeInBytes());
+         image->unloadTile(&buf.front(), rect, RSPF_BSQ);
+      }
+
+      rspfRefPtr<rspfImageData> tile = createImage(SCALARS[s], BANDS, m_tileSize, m_tileSize);
+      for (rspf_uint32 i = 0; i < sizeof(INTERLEAVES) / sizeof(INTERLEAVES[0]); ++i)
+      {
+         std::string il = interleaveName(INTERLEAVES[i]);
+
+         LoadCase load(tile.get(), &buf.front(), rect, INTERLEAVES[i], false);
+         time("image_data.load." + il + "." + scalar, load, pixels);
+
+         LoadCase unload(tile.get(), &buf.front(), rect, INTERLEAVES[i], true);
+         time("image_data.unload." + il + "." + scalar, unload, pixels);
+      }
+   }
+
+   // Conversions between scalar types (normalized copy):
+   static const rspfScalarType FROM[] =
+      { RSPF_UINT8,   RSPF_UINT16, RSPF_SINT16,  RSPF_FLOAT32, RSPF_FLOAT64 };
+   static const rspfScalarType TO[] =
+      { RSPF_FLOAT32, RSPF_UINT8,  RSPF_FLOAT32, RSPF_UINT8,   RSPF_UINT16  };
+   const rspf_uint32 count = tileCount(m_size, m_tileSize);
+   for (rspf_uint32 i = 0; i < sizeof(FROM) / sizeof(FROM[0]); ++i)
+   {
+      rspfRefPtr<rspfImageData> src  = createImage(FROM[i], BANDS, m_tileSize, m_tileSize);
+      rspfRefPtr<rspfImageData> dest = createImage(TO[i],   BANDS, m_tileSize, m_tileSize);
+      ConvertCase convert(src.get(), dest.get(), count);
+      time(std::string("image_data.convert.") + scalarName(FROM[i]) + "_to_" +
+           scalarName(TO[i]), convert, (rspf_uint64)count * m_tileSize * m_tileSize);
+   }
+}
+
+void rspfBenchmarkUtil::runResampler()
+{
+   if ( !isSelected("resampler.") )
+   {
+      return;
+   }
+
+   static const rspfResampler::rspfResLevelResamplerType TYPES[] =
+   {
+      rspfResampler::rspfResampler_NEAREST_NEIGHBOR,
+      rspfResampler::rspfResampler_BILINEAR,
+      rspfResampler::rspfResampler_BICUBIC
+   };
+   static const char* NAMES[] = { "nearest_neighbor", "bilinear", "bicubic" };
+
+   const rspf_uint32 count = tileCount(m_size, m_tileSize);
+   rspfRefPtr<rspfImageData> input  = createImage(RSPF_UINT16, 3, m_tileSize * 2, m_tileSize * 2);
+   rspfRefPtr<rspfImageData> output = createImage(RSPF_UINT16, 3, m_tileSize, m_tileSize);
+
+   for (rspf_uint32 i = 0; i < sizeof(TYPES) / sizeof(TYPES[0]); ++i)
+   {
+      rspfRefPtr<rspfResampler> resampler = new rspfResampler();
+      resampler->setResamplerType(TYPES[i]);
+      ResampleCase resample(resampler.get(), input.get(), output.get(), count);
+      time(std::string("resampler.") + NAMES[i], resample,
+           (rspf_uint64)count * m_tileSize * m_tileSize);
+   }
+}
+
+void rspfBenchmarkUtil::runFilterResampler()
+{
+   if ( !isSelected("filter_resampler.") )
+   {
+      return;
+   }
+
+   const rspf_uint32 count = tileCount(m_size, m_tileSize);
+   rspfRefPtr<rspfImageData> input  = createImage(RSPF_UINT16, 3, m_tileSize * 2, m_tileSize * 2);
+   rspfRefPtr<rspfImageData> output = createImage(RSPF_UINT16, 3, m_tileSize, m_tileSize);
+
+   rspfFilterResampler resampler;
+   std::vector<rspfString> types;
+   resampler.getFilterTypes(types);
+   for (rspf_uint32 i = 0; i < types.size(); ++i)
+   {
+      resampler.setFilterType(types[i]);
+      resampler.setScaleFactor(rspfDpt(1.25, 1.25)); // Output pixels per input pixel.
+      resampler.setBoundingInputRect(input->getImageRectangle());
+
+      FilterResampleCase resample(&resampler, input, output, count);
+      time("filter_resampler." + types[i].substitute(" ", "_", true).string(),
+           resample, (rspf_uint64)count * m_tileSize * m_tileSize);
+   }
+}
+
+void rspfBenchmarkUtil::runRenderer()
+{
+   if ( !isSelected("renderer.") )
+   {
+      return;
+   }
+
+   rspfRefPtr<rspfMemoryImageSource> source = new rspfMemoryImageSource();
+   source->setImage( createImage(RSPF_UINT8, 3, m_size, m_size) );
+
+   if ( isSelected("renderer.map_to_map") )
+   {
+      source->setImageGeometry( createGeoGeometry().get() );
+      rspfRefPtr<rspfImageRenderer> renderer = new rspfImageRenderer();
+      renderer->connectMyInputTo(0, source.get());
+      renderer->setView( createUtmGeometry().get() );
+      renderer->initialize();
+
+      rspfIrect rect = renderer->getBoundingRect();
+      TilesCase render(renderer.get(), m_tileSize);
+      time("renderer.map_to_map", render, (rspf_uint64)rect.width() * rect.height());
+      renderer->disconnect();
+   }
+
+   if ( isSelected("renderer.rpc_ortho") )
+   {
+      source->setImageGeometry( createRpcGeometry().get() );
+      rspfRefPtr<rspfImageRenderer> renderer = new rspfImageRenderer();
+      renderer->connectMyInputTo(0, source.get());
+      renderer->setView( createGeoGeometry().get() );
+      renderer->initialize();
+
+      rspfIrect rect = renderer->getBoundingRect();
+      TilesCase render(renderer.get(), m_tileSize);
+      time("renderer.rpc_ortho", render, (rspf_uint64)rect.width() * rect.height());
+      renderer->disconnect();
+   }
+}
+
+void rspfBenchmarkUtil::runTiff()
+{
+   if ( !isSelected("tiff.") )
+   {
+      return;
+   }
+
+   rspfFilename file = m_workDir.dirCat(TIFF_FILE);
+   const rspf_uint64 pixels = (rspf_uint64)m_size * m_size;
+
+   if ( isSelected("tiff.write") )
+   {
+      rspfRefPtr<rspfMemoryImageSource> source = new rspfMemoryImageSource();
+      source->setImage( createImage(RSPF_UINT8, 3, m_size, m_size) );
+      source->setImageGeometry( createGeoGeometry().get() );
+      TiffWriteCase write(source.get(), file, m_tileSize);
+      time("tiff.write", write, pixels);
+   }
+
+   if ( isSelected("tiff.read") )
+   {
+      if ( !file.exists() && !writeTiff(file) )
+      {
+         throw rspfException(std::string("Could not write ") + file.string());
+      }
+      TiffReadCase read(file, m_tileSize);
+      time("tiff.read", read, pixels);
+   }
+}
+
+void rspfBenchmarkUtil::runElevation()
+{
+   if ( !isSelected("elevation.") )
+   {
+      return;
+   }
+
+   // Synthetic terrain, big endian 16 bit posts as SRTM.
+   std::vector<char> cell(SRTM_POSTS * SRTM_POSTS * 2);
+   for (rspf_uint32 c = 0; c < sizeof(SRTM_CELLS) / sizeof(SRTM_CELLS[0]); ++c)
+   {
+      char* p = &cell.front();
+      for (rspf_uint32 y = 0; y < SRTM_POSTS; ++y)
+      {
+         for (rspf_uint32 x = 0; x < SRTM_POSTS; ++x)
+         {
+            rspf_sint16 h = (rspf_sint16)(200.0 + 1500.0 * pattern(x + c * SRTM_POSTS, y, 0));
+            *p++ = (char)((h >> 8) & 0xff);
+            *p++ = (char)(h & 0xff);
+         }
+      }
+      rspfFilename file = m_workDir.dirCat(SRTM_CELLS[c]);
+      std::ofstream out(file.c_str(), std::ios::out | std::ios::binary);
+      out.write(&cell.front(), (std::streamsize)cell.size());
+      if ( !out.good() )
+      {
+         throw rspfException(std::string("Could not write ") + file.string());
+      }
+   }
+
+   // Put the cells first so installed elevation does not answer instead.
+   rspfRefPtr<rspfSrtmElevationDatabase> database = new rspfSrtmElevationDatabase();
+   if ( !database->open(m_workDir) )
+   {
+      throw rspfException(std::string("Could not open srtm cells in ") + m_workDir.string());
+   }
+   rspfElevManager::ElevationDatabaseListType& databases =
+      rspfElevManager::instance()->getElevationDatabaseList();
+   databases.insert(databases.begin(), database.get());
+
+   // Scattered points over the four cells, and a raster scan at the image
+   // spacing which stays within a cell and its neighbors.
+   const rspf_uint32 LOOKUPS = 100000;
+   std::vector<rspfGpt> scattered(LOOKUPS);
+   rspf_uint32 seed = 12345;
+   for (rspf_uint32 i = 0; i < LOOKUPS; ++i)
+   {
+      seed = seed * 1664525u + 1013904223u;
+      double u = (seed >> 8) / 16777216.0;
+      seed = seed * 1664525u + 1013904223u;
+      double v = (seed >> 8) / 16777216.0;
+      scattered[i] = rspfGpt(CENTER_LAT - 1.0 + 2.0 * v, CENTER_LON - 1.0 + 2.0 * u);
+   }
+   std::vector<rspfGpt> scan;
+   scan.reserve(LOOKUPS);
+   const rspf_uint32 side = (rspf_uint32)std::sqrt((double)LOOKUPS);
+   for (rspf_uint32 y = 0; y < side; ++y)
+   {
+      for (rspf_uint32 x = 0; x < side; ++x)
+      {
+         scan.push_back(rspfGpt(CENTER_LAT + EXTENT * (0.5 - (double)y / side),
+                                 CENTER_LON + EXTENT * ((double)x / side - 0.5)));
+      }
+   }
+
+   try
+   {
+      ElevationCase random(scattered);
+      time("elevation.scattered_lookup", random, scattered.size());
+      ElevationCase sequential(scan);
+      time("elevation.scan_lookup", sequential, scan.size());
+   }
+   catch (...)
+   {
+      databases.erase(std::find(databases.begin(), databases.end(), database.get()));
+      throw;
+   }
+   databases.erase(std::find(databases.begin(), databases.end(), database.get()));
+}
+
+void rspfBenchmarkUtil::runHistogram()
+{
+   if ( !isSelected("histogram.") )
+   {
+      return;
+   }
+
+   static const rspfScalarType SCALARS[] =
+      { RSPF_UINT8, RSPF_UINT16, RSPF_SINT16, RSPF_FLOAT32, RSPF_FLOAT64 };
+   const rspf_uint32 BANDS = 3;
+   const rspf_uint32 count = tileCount(m_size, m_tileSize);
+
+   for (rspf_uint32 s = 0; s < sizeof(SCALARS) / sizeof(SCALARS[0]); ++s)
+   {
+      rspfRefPtr<rspfImageData> tile = createImage(SCALARS[s], BANDS, m_tileSize, m_tileSize);
+      rspf_int32 buckets = (SCALARS[s] == RSPF_UINT8) ? 256 : 1024;
+      rspfRefPtr<rspfMultiBandHistogram> histo =
+         new rspfMultiBandHistogram(BANDS, buckets,
+                                     (float)tile->getMinPix(0), (float)tile->getMaxPix(0));
+      HistogramCase populate(tile.get(), histo.get(), count);
+      time(std::string("histogram.") + scalarName(SCALARS[s]), populate,
+           (rspf_uint64)count * m_tileSize * m_tileSize);
+   }
+}
+
+void rspfBenchmarkUtil::runSequencer()
+{
+   if ( !isSelected("sequencer.") )
+   {
+      return;
+   }
+
+   // The sequencer clones its chain per thread from a keyword list, so the
+   // chain must be file based.
+   rspfFilename file = m_workDir.dirCat(TIFF_FILE);
+   if ( !file.exists() && !writeTiff(file) )
+   {
+      throw rspfException(std::string("Could not write ") + file.string());
+   }
+
+   rspf_uint32 maxThreads = m_threads ? m_threads : rspf::getNumberOfThreads();
+   std::vector<rspf_uint32> threads;
+   for (rspf_uint32 n = 1; n < maxThreads; n *= 2)
+   {
+      threads.push_back(n);
+   }
+   threads.push_back(maxThreads);
+
+   for (rspf_uint32 i = 0; i < threads.size(); ++i)
+   {
+      std::string name = "sequencer.threads_" + rspfString::toString(threads[i]).string();
+      if ( !isSelected(name) )
+      {
+         continue;
+      }
+
+      rspfRefPtr<rspfSingleImageChain> chain = new rspfSingleImageChain();
+      if ( !chain->open(file, false) )
+      {
+         throw rspfException(std::string("Could not open ") + file.string());
+      }
+      chain->createRenderedChain();
+      chain->getImageRenderer()->setView( createUtmGeometry().get() );
+      chain->initialize();
+
+      rspfRefPtr<rspfMultiThreadSequencer> sequencer =
+         new rspfMultiThreadSequencer(0, threads[i]);
+      sequencer->connectMyInputTo(0, chain.get());
+      sequencer->setTileSize(rspfIpt(m_tileSize, m_tileSize));
+      sequencer->setAreaOfInterest(chain->getBoundingRect());
+
+      rspfIrect rect = chain->getBoundingRect();
+      SequencerCase sequence(sequencer.get());
+      time(name, sequence, (rspf_uint64)rect.width() * rect.height());
+      sequencer->disconnect();
+   }
+}
+
+rspfRefPtr<rspfImageData> rspfBenchmarkUtil::createImage(rspfScalarType scalar,
+                                                           rspf_uint32 bands,
+                                                           rspf_uint32 width,
+                                                           rspf_uint32 height)
+{
+   rspfRefPtr<rspfImageData> image = new rspfImageData(0, scalar, bands, width, height);
+   image->initialize();
+   if ( (scalar == RSPF_FLOAT32) || (scalar == RSPF_FLOAT64) )
+   {
+      // Default float range is too wide to normalize anything usefully.
+      image->setMinPix(0.0);
+      image->setMaxPix(1.0);
+   }
+
+   for (rspf_uint32 band = 0; band < bands; ++band)
+   {
+      double minValue = image->getMinPix(band);
+      double maxValue = image->getMaxPix(band);
+      void*  buf      = image->getBuf(band);
+      switch (scalar)
+      {
+         case RSPF_UINT8:
+            fillBand((rspf_uint8*)buf, width, height, band, minValue, maxValue);
+            break;
+         case RSPF_UINT16:
+            fillBand((rspf_uint16*)buf, width, height, band, minValue, maxValue);
+            break;
+         case RSPF_SINT16:
+            fillBand((rspf_sint16*)buf, width, height, band, minValue, maxValue);
+            break;
+         case RSPF_FLOAT32:
+            fillBand((rspf_float32*)buf, width, height, band, minValue, maxValue);
+            break;
+         case RSPF_FLOAT64:
+            fillBand((rspf_float64*)buf, width, height, band, minValue, maxValue);
+            break;
+         default:
+            throw rspfException(std::string("Unsupported scalar type ") + scalarName(scalar));
+      }
+   }
+   image->validate();
+   return image;
+}
+
+rspfRefPtr<rspfImageGeometry> rspfBenchmarkUtil::createGeoGeometry() const
+{
+   rspfRefPtr<rspfEquDistCylProjection> proj = new rspfEquDistCylProjection();
+   proj->setDecimalDegreesPerPixel(rspfDpt(EXTENT / m_size, EXTENT / m_size));
+   proj->setUlTiePoints(rspfGpt(CENTER_LAT + EXTENT * 0.5, CENTER_LON - EXTENT * 0.5));
+
+   rspfRefPtr<rspfImageGeometry> geom = new rspfImageGeometry(0, proj.get());
+   geom->setImageSize(rspfIpt(m_size, m_size));
+   return geom;
+}
+
+rspfRefPtr<rspfImageGeometry> rspfBenchmarkUtil::createRpcGeometry() const
+{
+   //---
+   // Near affine RPC00B over the same footprint: sample follows longitude,
+   // line follows latitude downward, with height and cross terms so the
+   // polynomial is fully evaluated.
+   //---
+   rspfRpcModel::rpcModelStruct rpc;
+   memset(&rpc, 0, sizeof(rpc));
+   rpc.type       = 'B';
+   rpc.lineScale  = m_size * 0.5;
+   rpc.sampScale  = m_size * 0.5;
+   rpc.lineOffset = m_size * 0.5;
+   rpc.sampOffset = m_size * 0.5;
+   rpc.latScale   = EXTENT * 0.5;
+   rpc.lonScale   = EXTENT * 0.5;
+   rpc.hgtScale   = 500.0;
+   rpc.latOffset  = CENTER_LAT;
+   rpc.lonOffset  = CENTER_LON;
+   rpc.hgtOffset  = 0.0;
+
+   // Coefficient order: 1 L P H LP LH PH L2 P2 H2 PLH L3 LP2 LH2 L2P P3 PH2 L2H P2H H3
+   rpc.sampNumCoef[1] =  1.0;
+   rpc.sampNumCoef[3] =  0.02;
+   rpc.sampNumCoef[4] =  0.001;
+   rpc.lineNumCoef[2] = -1.0;
+   rpc.lineNumCoef[3] =  0.03;
+   rpc.lineNumCoef[7] =  0.001;
+   rpc.sampDenCoef[0] =  1.0;
+   rpc.lineDenCoef[0] =  1.0;
+
+   rspfRefPtr<rspfRpcModel> model = new rspfRpcModel();
+   model->setImageSize(rspfDpt(m_size, m_size));
+   model->setImageRect(rspfDrect(0.0, 0.0, m_size - 1.0, m_size - 1.0));
+   model->setRefImgPt(rspfDpt(m_size * 0.5, m_size * 0.5));
+   model->setAttributes(rpc);
+
+   rspfRefPtr<rspfImageGeometry> geom = new rspfImageGeometry(0, model.get());
+   geom->setImageSize(rspfIpt(m_size, m_size));
+   return geom;
+}
+
+rspfRefPtr<rspfImageGeometry> rspfBenchmarkUtil::createUtmGeometry() const
+{
+   rspfGpt center(CENTER_LAT, CENTER_LON);
+   rspfRefPtr<rspfUtmProjection> utm = new rspfUtmProjection();
+   utm->setZone(center);
+   utm->setHemisphere(center);
+
+   // About the input resolution.
+   double gsd = EXTENT * 111000.0 / m_size;
+   utm->setMetersPerPixel(rspfDpt(gsd, gsd));
+   utm->setUlTiePoints(rspfGpt(CENTER_LAT + EXTENT * 0.5, CENTER_LON - EXTENT * 0.5));
+
+   return new rspfImageGeometry(0, utm.get());
+}
+
+bool rspfBenchmarkUtil::writeTiff(const rspfFilename& file) const
+{
+   rspfRefPtr<rspfMemoryImageSource> source = new rspfMemoryImageSource();
+   source->setImage( createImage(RSPF_UINT8, 3, m_size, m_size) );
+   source->setImageGeometry( createGeoGeometry().get() );
+   return ::writeTiff(source.get(), file, m_tileSize);
+}
+
+void rspfBenchmarkUtil::removeWorkFiles() const
+{
+   rspfFilename::remove( m_workDir.dirCat(TIFF_FILE) );
+   for (rspf_uint32 c = 0; c < sizeof(SRTM_CELLS) / sizeof(SRTM_CELLS[0]); ++c)
+   {
+      rspfFilename::remove( m_workDir.dirCat(SRTM_CELLS[c]) );
+   }
+   rspfFilename::remove( m_workDir ); // Only if empty.
+}
+
+void rspfBenchmarkUtil::writeJson(std::ostream& out) const
+{
+   out << std::setprecision(9)
+       << "{\n"
+       << "  \"format\": \"rspf-benchmark\",\n"
+       << "  \"version\": 1,\n"
+       << "  \"size\": " << m_size << ",\n"
+       << "  \"tile_size\": " << m_tileSize << ",\n"
+       << "  \"iterations\": " << m_iterations << ",\n"
+       << "  \"threads\": " << (m_threads ? m_threads : rspf::getNumberOfThreads()) << ",\n"
+       << "  \"benchmarks\": [";
+   for (rspf_uint32 i = 0; i < m_results.size(); ++i)
+   {
+      // Names are made of [a-z0-9._] so need no escaping.
+      const Result& r = m_results[i];
+      out << (i ? ",\n" : "\n")
+          << "    { \"name\": \"" << r.m_name << "\""
+          << ", \"iterations\": " << r.m_iterations
+          << ", \"best_seconds\": " << r.m_bestSeconds
+          << ", \"mean_seconds\": " << r.m_meanSeconds
+          << ", \"count\": " << r.m_pixels
+          << ", \"megapixels_per_second\": "
+          << ( (r.m_bestSeconds > 0.0) ? (r.m_pixels / r.m_bestSeconds / 1.0e6) : 0.0 );
+      if ( !rspf::isnan(r.m_baselineSeconds) )
+      {
+         out << ", \"baseline_best_seconds\": " << r.m_baselineSeconds
+             << ", \"change\": " << (r.m_bestSeconds / r.m_baselineSeconds - 1.0);
+      }
+      out << " }";
+   }
+   out << "\n  ]\n}\n";
+   out.flush();
+}
+
+bool rspfBenchmarkUtil::readJson(const rspfFilename& file,
+                                  std::map<std::string, double>& bestSeconds)
+{
+   std::ifstream in(file.c_str());
+   if ( !in.good() )
+   {
+      return false;
+   }
+   std::stringstream ss;
+   ss << in.rdbuf();
+   const std::string text = ss.str();
+
+   // Only the layout written by writeJson is read: a name followed by its
+   // best time within the same object.
+   static const std::string NAME = "\"name\"";
+   static const std::string BEST = "\"best_seconds\"";
+   std::string::size_type pos = text.find(NAME);
+   while ( pos != std::string::npos )
+   {
+      std::string::size_type next = text.find(NAME, pos + NAME.size());
+      std::string::size_type open = text.find('"', text.find(':', pos) + 1);
+      std::string::size_type close = (open != std::string::npos) ? text.find('"', open + 1)
+                                                                 : std::string::npos;
+      std::string::size_type best = text.find(BEST, pos);
+      if ( (close != std::string::npos) && (best != std::string::npos) &&
+           ((next == std::string::npos) || (best < next)) )
+      {
+         const char* value = text.c_str() + text.find(':', best) + 1;
+         bestSeconds[text.substr(open + 1, close - open - 1)] = std::strtod(value, 0);
+      }
+      pos = next;
+   }
+   return true;
+}
+
+bool rspfBenchmarkUtil::compareToBaseline()
+{
+   static const char MODULE[] = "rspfBenchmarkUtil::compareToBaseline";
+
+   std::map<std::string, double> baseline;
+   if ( !readJson(m_baselineFile, baseline) )
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << MODULE << " could not read " << m_baselineFile << std::endl;
+      return false;
+   }
+
+   bool result = true;
+   rspfNotify(rspfNotifyLevel_NOTICE)
+      << "\n" << std::setiosflags(std::ios::left) << std::setw(44) << "benchmark"
+      << std::resetiosflags(std::ios::left)
+      << std::setw(14) << "baseline ms" << std::setw(14) << "current ms"
+      << std::setw(10) << "change" << "\n";
+   for (rspf_uint32 i = 0; i < m_results.size(); ++i)
+   {
+      Result& r = m_results[i];
+      std::map<std::string, double>::const_iterator b = baseline.find(r.m_name);
+      if ( (b == baseline.end()) || (b->second <= 0.0) )
+      {
+         continue;
+      }
+      r.m_baselineSeconds = b->second;
+      double change = r.m_bestSeconds / r.m_baselineSeconds - 1.0;
+      const char* flag = "";
+      if ( change > m_tolerance )
+      {
+         flag = "  slower";
+         result = false;
+      }
+      else if ( change < -m_tolerance )
+      {
+         flag = "  faster";
+      }
+      rspfNotify(rspfNotifyLevel_NOTICE)
+         << std::setiosflags(std::ios::left) << std::setw(44) << r.m_name
+         << std::resetiosflags(std::ios::left) << std::fixed << std::setprecision(3)
+         << std::setw(14) << r.m_baselineSeconds * 1000.0
+         << std::setw(14) << r.m_bestSeconds * 1000.0
+         << std::setw(9) << std::setprecision(1) << change * 100.0 << "%" << flag << "\n";
+   }
+   rspfNotify(rspfNotifyLevel_NOTICE) << std::endl;
+
+   return result;
+}
@@ -0,0 +1,351 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfChipperService.cpp
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:
+//
+// Long lived chipper service keeping chains warm between chip requests.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#include <rspf/util/rspfChipperService.h>
+#include <rspf/base/rspfCommon.h>
+#include <rspf/base/rspfException.h>
+#include <rspf/base/rspfNotify.h>
+#include <rspf/base/rspfTrace.h>
+#include <rspf/parallel/rspfJobQueue.h>
+#include <OpenThreads/ScopedLock>
+
+#include <sstream>
+
+static rspfTrace traceDebug(rspfString("rspfChipperService:debug"));
+
+static const char WRITER_KW[] = "writer";
+
+rspfChipperService::Request::Request(const rspfKeywordlist& options)
+   : rspfReferenced(),
+     m_options(options),
+     m_mutex(),
+     m_block(),
+     m_finished(false),
+     m_status(false),
+     m_chip(0),
+     m_buffer(),
+     m_errorMessage()
+{
+   m_block.reset();
+}
+
+const rspfKeywordlist& rspfChipperService::Request::getOptions() const
+{
+   return m_options;
+}
+
+void rspfChipperService::Request::wait()
+{
+   m_block.block();
+}
+
+bool rspfChipperService::Request::isFinished() const
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   return m_finished;
+}
+
+bool rspfChipperService::Request::succeeded() const
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   return m_status;
+}
+
+const std::string& rspfChipperService::Request::getBuffer() const
+{
+   return m_buffer;
+}
+
+rspfRefPtr<rspfImageData> rspfChipperService::Request::getChip() const
+{
+   return m_chip;
+}
+
+const std::string& rspfChipperService::Request::getErrorMessage() const
+{
+   return m_errorMessage;
+}
+
+void rspfChipperService::Request::setResult(bool status,
+                                            rspfRefPtr<rspfImageData> chip,
+                                            const std::string& buffer,
+                                            const std::string& errorMessage)
+{
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      m_status       = status;
+      m_chip         = chip;
+      m_buffer       = buffer;
+      m_errorMessage = errorMessage;
+      m_finished     = true;
+   }
+   m_block.release();
+}
+
+rspfChipperService::rspfChipperJob::rspfChipperJob(rspfChipperService* service,
+                                                   Request* request)
+   : rspfJob(),
+     m_service(service),
+     m_request(request)
+{
+}
+
+void rspfChipperService::rspfChipperJob::start()
+{
+   running();
+   if ( m_service && m_request.valid() )
+   {
+      m_service->processRequest( m_request.get() );
+   }
+   finished();
+}
+
+void rspfChipperService::rspfChipperJob::abort()
+{
+   if ( m_request.valid() )
+   {
+      m_request->setResult( false, 0, std::string(),
+                            std::string("Chipper service destroyed!") );
+   }
+}
+
+rspfChipperService::rspfChipperService(rspf_uint32 nThreads, rspf_uint32 maxIdleChippers)
+   : rspfReferenced(),
+     m_idleChippers(),
+     m_maxIdleChippers(maxIdleChippers),
+     m_jobQueue(0),
+     m_poolMutex()
+{
+   if ( nThreads == 0 )
+   {
+      nThreads = rspf::getNumberOfThreads();
+   }
+   m_jobQueue = new rspfJobMultiThreadQueue(new rspfJobQueue(), nThreads);
+}
+
+rspfChipperService::~rspfChipperService()
+{
+   // Fail what is still queued so nobody waits on it forever.
+   rspfRefPtr<rspfJob> job = m_jobQueue->getJobQueue()->nextJob( false );
+   while ( job.valid() )
+   {
+      rspfChipperJob* chipperJob = dynamic_cast<rspfChipperJob*>( job.get() );
+      if ( chipperJob )
+      {
+         chipperJob->abort();
+      }
+      job = m_jobQueue->getJobQueue()->nextJob( false );
+   }
+
+   m_jobQueue = 0; // Not a leak, ref pointer.  Waits on the running jobs.
+   clearIdleChippers();
+}
+
+void rspfChipperService::add(Request* request)
+{
+   if ( request )
+   {
+      rspfRefPtr<rspfChipperJob> job = new rspfChipperJob( this, request );
+      job->ready();
+
+      // Requests are not unique by name so skip the uniqueness check.
+      m_jobQueue->getJobQueue()->add( job.get(), false );
+   }
+}
+
+rspfRefPtr<rspfChipperService::Request> rspfChipperService::process(
+   const rspfKeywordlist& options)
+{
+   rspfRefPtr<Request> request = new Request(options);
+   add( request.get() );
+   request->wait();
+   return request;
+}
+
+void rspfChipperService::setNumberOfThreads(rspf_uint32 nThreads)
+{
+   m_jobQueue->setNumberOfThreads( nThreads ? nThreads : rspf::getNumberOfThreads() );
+}
+
+rspf_uint32 rspfChipperService::getNumberOfThreads() const
+{
+   return m_jobQueue->getNumberOfThreads();
+}
+
+void rspfChipperService::setMaxIdleChippers(rspf_uint32 count)
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_poolMutex);
+   m_maxIdleChippers = count;
+   while ( m_idleChippers.size() > m_maxIdleChippers )
+   {
+      m_idleChippers.pop_back();
+   }
+}
+
+rspf_uint32 rspfChipperService::getNumberOfIdleChippers() const
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_poolMutex);
+   return static_cast<rspf_uint32>( m_idleChippers.size() );
+}
+
+void rspfChipperService::clearIdleChippers()
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_poolMutex);
+   m_idleChippers.clear();
+}
+
+void rspfChipperService::getSceneKey(const rspfKeywordlist& options, std::string& key)
+{
+   key.clear();
+
+   // Keyword map is sorted so equal scene options give equal keys.
+   const rspfKeywordlist::KeywordMap& map = options.getMap();
+   rspfKeywordlist::KeywordMap::const_iterator i = map.begin();
+   while ( i != map.end() )
+   {
+      if ( rspfChipperUtil::isChipOption( (*i).first ) == false )
+      {
+         key += (*i).first;
+         key += "=";
+         key += (*i).second;
+         key += "\n";
+      }
+      ++i;
+   }
+}
+
+void rspfChipperService::processRequest(Request* request)
+{
+   static const char MODULE[] = "rspfChipperService::processRequest";
+
+   const rspfKeywordlist& options = request->getOptions();
+
+   std::string key;
+   getSceneKey( options, key );
+
+   bool status = false;
+   rspfRefPtr<rspfImageData> chip = 0;
+   std::string buffer;
+   std::string errorMessage;
+
+   try
+   {
+      rspfRefPtr<rspfChipperUtil> chipper = checkOut( key );
+      if ( chipper.valid() )
+      {
+         // Warm: chains already open, just swap the chip options.
+         chipper->reinitialize( options );
+      }
+      else
+      {
+         if ( traceDebug() )
+         {
+            rspfNotify(rspfNotifyLevel_DEBUG)
+               << MODULE << " DEBUG: Opening new chipper for scene:\n" << key << "\n";
+         }
+
+         chipper = new rspfChipperUtil();
+         if ( chipper->initialize( options ) == false )
+         {
+            throw rspfException( std::string("No inputs opened!") );
+         }
+      }
+
+      if ( options.find( WRITER_KW ) )
+      {
+         std::ostringstream out;
+         status = chipper->writeChip( out );
+         if ( status )
+         {
+            buffer = out.str();
+         }
+      }
+      else
+      {
+         chip = chipper->getChip();
+         status = chip.valid();
+      }
+
+      if ( !status )
+      {
+         errorMessage = "Chip failed!";
+      }
+
+      //---
+      // Return the chipper to the pool.  Note on an exception we never get here as the
+      // state is unknown; so, the chipper is dropped.
+      //---
+      checkIn( key, chipper.get() );
+   }
+   catch ( const rspfException& e )
+   {
+      status = false;
+      errorMessage = e.what();
+
+      if ( traceDebug() )
+      {
+         rspfNotify(rspfNotifyLevel_DEBUG)
+            << MODULE << " caught exception: " << e.what() << "\n";
+      }
+   }
+   catch ( const std::exception& e )
+   {
+      status = false;
+      errorMessage = e.what();
+   }
+   catch ( ... )
+   {
+      // The request must be finished whatever happened or its waiter blocks forever.
+      status = false;
+      errorMessage = "Unknown exception!";
+   }
+
+   request->setResult( status, chip, buffer, errorMessage );
+}
+
+rspfRefPtr<rspfChipperUtil> rspfChipperService::checkOut(const std::string& key)
+{
+   rspfRefPtr<rspfChipperUtil> result = 0;
+
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_poolMutex);
+   std::list<PoolEntry>::iterator i = m_idleChippers.begin();
+   while ( i != m_idleChippers.end() )
+   {
+      if ( (*i).first == key )
+      {
+         result = (*i).second;
+         m_idleChippers.erase(i);
+         break;
+      }
+      ++i;
+   }
+   return result;
+}
+
+void rspfChipperService::checkIn(const std::string& key, rspfChipperUtil* chipper)
+{
+   if ( chipper )
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_poolMutex);
+      if ( m_maxIdleChippers )
+      {
+         m_idleChippers.push_front( PoolEntry( key, rspfRefPtr<rspfChipperUtil>(chipper) ) );
+         while ( m_idleChippers.size() > m_maxIdleChippers )
+         {
+            m_idleChippers.pop_back(); // Least recently used.
+         }
+      }
+   }
+}
@@ -578,6 +578,35 @@ void rspfChipperUtil::initialize()
    } 
 
    // Determine the operation to do.
+   initializeOperation();
+
+   //---
+   // Populate the m_srcKwl if --src option was set.
+   // Note do this before creating chains.
+   //---
+   initializeSrcKwl();
+   
+   // Check for required inputs. Do this after initializeSrcKwl.
+   validateOperation();
+
+   // Create chains for any dem sources.
+   addDemSources();
+
+   // Create chains for any image sources.
+   addImgSources();
+
+   // Initialize projection and propagate to chains.
+   initializeOutputProjection();
+   
+   if ( traceDebug() )
+   {
+      rspfNotify(rspfNotifyLevel_DEBUG) << MODULE << " exited...\n";
+   }
+
+} // End: void rspfChipperUtil::initialize()
+
+void rspfChipperUtil::initializeOperation()
+{
    std::string op = m_kwl->findKey( std::string(OP_KW) );
    if ( op.size() )
    {
@@ -619,14 +648,12 @@ void rspfChipperUtil::initialize()
       errMsg += "\nUse --op option to specify operation.\n";
       throw rspfException(errMsg);  
    }
+}
 
-   //---
-   // Populate the m_srcKwl if --src option was set.
-   // Note do this before creating chains.
-   //---
-   initializeSrcKwl();
+void rspfChipperUtil::validateOperation() const
+{
+   std::string op = m_kwl->findKey( std::string(OP_KW) );
    
-   // Check for required inputs. Do this after initializeSrcKwl.
    if ( m_operation == RSPF_CHIPPER_OP_CHIP )
    {
       if ( getNumberOfInputs() != 1 )
@@ -675,22 +702,7 @@ void rspfChipperUtil::initialize()
          throw rspfException( errMsg.str() );
       }
    }
-
-   // Create chains for any dem sources.
-   addDemSources();
-
-   // Create chains for any image sources.
-   addImgSources();
-
-   // Initialize projection and propagate to chains.
-   initializeOutputProjection();
-   
-   if ( traceDebug() )
-   {
-      rspfNotify(rspfNotifyLevel_DEBUG) << MODULE << " exited...\n";
-   }
-
-} // End: void rspfChipperUtil::initialize()
+}
 
 void rspfChipperUtil::initializeOutputProjection()
 {
@@ -708,9 +720,9 @@ void rspfChipperUtil::initializeOutputProjection()
    }
 }
 
-void rspfChipperUtil::execute()
+rspfRefPtr<rspfImageSource> rspfChipperUtil::initializeChain( rspfIrect& aoi )
 {
-   static const char MODULE[] = "rspfChipperUtil::execute";
+   static const char MODULE[] = "rspfChipperUtil::initializeChain";
 
    if ( traceDebug() )
    {
@@ -885,7 +897,6 @@ void rspfChipperUtil::execute()
       // explicitly set by user with one of the --cut options.
       //  Need to get this before the thumbnail code.
       //---
-      rspfIrect aoi;
       getAreaOfInterest(source.get(), aoi);
 
       //---
@@ -906,7 +917,31 @@ void rspfChipperUtil::execute()
          // Reset the source bounding rect if it changed.
          source->initialize();
       }
+   }
+   
+   if ( traceDebug() )
+   {
+      rspfNotify(rspfNotifyLevel_DEBUG) << MODULE << " exited...\n";
+   }
+
+   return source;
+   
+} // End: rspfChipperUtil::initializeChain( rspfIrect& aoi )
+
+void rspfChipperUtil::execute()
+{
+   static const char MODULE[] = "rspfChipperUtil::execute";
 
+   if ( traceDebug() )
+   {
+      rspfNotify(rspfNotifyLevel_DEBUG) << MODULE << " entered...\n";
+   }
+
+   rspfIrect aoi;
+   rspfRefPtr<rspfImageSource> source = initializeChain( aoi );
+
+   if ( source.valid() )
+   {
       // Set up the writer.
       rspfRefPtr<rspfImageFileWriter> writer = createNewWriter();
 
@@ -956,6 +991,241 @@ void rspfChipperUtil::execute()
    }   
 }
 
+bool rspfChipperUtil::initialize(const rspfKeywordlist& kwl)
+{
+   clear();
+   
+   m_kwl->addList( kwl, true );
+
+   initialize();
+
+   return ( m_demLayer.size() || m_imgLayer.size() );
+}
+
+void rspfChipperUtil::reinitialize(const rspfKeywordlist& chipKwl)
+{
+   static const char MODULE[] = "rspfChipperUtil::reinitialize";
+
+   if ( traceDebug() )
+   {
+      rspfNotify(rspfNotifyLevel_DEBUG) << MODULE << " entered...\n";
+   }
+
+   if ( !m_demLayer.size() && !m_imgLayer.size() )
+   {
+      std::string errMsg = MODULE;
+      errMsg += " ERROR: Not initialized!";
+      throw rspfException(errMsg);
+   }
+
+   // Remove the previous chip options so they do not leak into this chip.
+   rspfKeywordlist::KeywordMap& map = m_kwl->getMap();
+   rspfKeywordlist::KeywordMap::iterator i = map.begin();
+   while ( i != map.end() )
+   {
+      if ( isChipOption( (*i).first ) )
+      {
+         map.erase( i++ );
+      }
+      else
+      {
+         ++i;
+      }
+   }
+
+   // Add the new chip options.  Scene options are ignored as the chains are already open.
+   const rspfKeywordlist::KeywordMap& chipMap = chipKwl.getMap();
+   rspfKeywordlist::KeywordMap::const_iterator ci = chipMap.begin();
+   while ( ci != chipMap.end() )
+   {
+      if ( isChipOption( (*ci).first ) )
+      {
+         m_kwl->addPair( (*ci).first, (*ci).second, true );
+      }
+      ++ci;
+   }
+
+   // Release any processing chain head left over from the last chip.
+   disconnectLayerOutputs();
+   
+   m_geom = 0;
+   m_ivt  = 0;
+
+   initializeOperation();
+   validateOperation();
+   initializeOutputProjection();
+   
+   if ( traceDebug() )
+   {
+      rspfNotify(rspfNotifyLevel_DEBUG) << MODULE << " exited...\n";
+   }
+}
+
+rspfRefPtr<rspfImageData> rspfChipperUtil::getChip()
+{
+   rspfRefPtr<rspfImageData> result = 0;
+   
+   rspfIrect aoi;
+   rspfRefPtr<rspfImageSource> source = initializeChain( aoi );
+   if ( source.valid() && !aoi.hasNans() )
+   {
+      result = source->getTile( aoi, 0 );
+      if ( result.valid() )
+      {
+         //---
+         // Make a copy as the tile belongs to the chain and will be recycled
+         // on the next request.
+         //---
+         result = (rspfImageData*)result->dup();
+      }
+   }
+
+   disconnectLayerOutputs();
+
+   return result;
+}
+
+bool rspfChipperUtil::writeChip(std::ostream& out)
+{
+   static const char MODULE[] = "rspfChipperUtil::writeChip";
+   
+   bool status = false;
+   
+   const char* lookup = m_kwl->find( WRITER_KW );
+   if ( !lookup )
+   {
+      std::string errMsg = MODULE;
+      errMsg += " ERROR: writer keyword required to write to stream!";
+      throw rspfException(errMsg);
+   }
+   
+   rspfRefPtr<rspfImageFileWriter> writer =
+      rspfImageWriterFactoryRegistry::instance()->createWriter(rspfString(lookup));
+   if ( !writer.valid() )
+   {
+      std::string errMsg = MODULE;
+      errMsg += " ERROR creating writer: ";
+      errMsg += lookup;
+      throw rspfException(errMsg);
+   }
+
+   setWriterProperties( writer.get() );
+
+   if ( writer->setOutputStream( out ) )
+   {
+      rspfIrect aoi;
+      rspfRefPtr<rspfImageSource> source = initializeChain( aoi );
+      if ( source.valid() )
+      {
+         writer->connectMyInputTo(0, source.get());
+         if ( !aoi.hasNans() )
+         {
+            writer->setAreaOfInterest(aoi);
+         }
+         if (writer->getErrorStatus() == rspfErrorCodes::RSPF_OK)
+         {
+            status = writer->execute();
+         }
+         writer->disconnect();
+      }
+   }
+   else
+   {
+      std::string errMsg = MODULE;
+      errMsg += " ERROR: writer does not support streams: ";
+      errMsg += lookup;
+      throw rspfException(errMsg);
+   }
+
+   disconnectLayerOutputs();
+
+   return status;
+}
+
+void rspfChipperUtil::clear()
+{
+   disconnectLayerOutputs();
+   
+   m_operation = RSPF_CHIPPER_OP_UNKNOWN;
+   m_kwl->clear();
+   m_srcKwl = 0;
+   m_geom   = 0;
+   m_ivt    = 0;
+   m_demLayer.clear();
+   m_imgLayer.clear();
+}
+
+bool rspfChipperUtil::isChipOption(const std::string& key)
+{
+   //---
+   // Options that only effect the view, the area of interest or the output.  Everything
+   // else(inputs, entry, bands, resampler filter, histogram...) is baked into the
+   // rspfSingleImageChain's at creation.  That includes the operation and output radiometry
+   // as they decide the chains' remap to eight bit.
+   //---
+   static const char* CHIP_KEYS[] =
+   {
+      rspfKeywordNames::AZIMUTH_ANGLE_KW,
+      rspfKeywordNames::CENTRAL_MERIDIAN_KW,
+      COLOR_BLUE_KW,
+      COLOR_GREEN_KW,
+      COLOR_RED_KW,
+      DEGREES_X_KW,
+      DEGREES_Y_KW,
+      rspfKeywordNames::ELEVATION_ANGLE_KW,
+      GAIN_KW,
+      LUT_FILE_KW,
+      METERS_KW,
+      NORTH_UP_KW,
+      rspfKeywordNames::ORIGIN_LATITUDE_KW,
+      rspfKeywordNames::OUTPUT_FILE_KW,
+      rspfKeywordNames::PROJECTION_KW,
+      SNAP_TIE_TO_ORIGIN_KW,
+      SRS_KW,
+      THUMBNAIL_RESOLUTION_KW,
+      UP_IS_UP_KW,
+      WRITER_KW,
+      0
+   };
+
+   // Prefixed options:
+   if ( ( key.compare( 0, 4, "cut_" ) == 0 ) ||
+        ( key.compare( 0, 5, "2cmv_" ) == 0 ) ||
+        ( key.compare( 0, sizeof(WRITER_PROPERTY_KW)-1, WRITER_PROPERTY_KW ) == 0 ) )
+   {
+      return true;
+   }
+
+   for ( rspf_uint32 i = 0; CHIP_KEYS[i] != 0; ++i )
+   {
+      if ( key == CHIP_KEYS[i] )
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+void rspfChipperUtil::disconnectLayerOutputs()
+{
+   //---
+   // Anything built on top of the layers by initializeChain(mosaic, bump shade, remapper...)
+   // is connected as an output of the chains.  Disconnect so it can be freed.
+   //---
+   std::vector< rspfRefPtr<rspfSingleImageChain> >::iterator chainIdx = m_demLayer.begin();
+   while ( chainIdx != m_demLayer.end() )
+   {
+      (*chainIdx)->disconnectAllOutputs();
+      ++chainIdx;
+   }
+   chainIdx = m_imgLayer.begin();
+   while ( chainIdx != m_imgLayer.end() )
+   {
+      (*chainIdx)->disconnectAllOutputs();
+      ++chainIdx;
+   }
+}
+
 void rspfChipperUtil::addDemSources()
 {
    static const char MODULE[] = "rspfChipperUtil::addDemSources";
@@ -2545,12 +2815,26 @@ rspfRefPtr<rspfImageFileWriter> rspfChipperUtil::createNewWriter() const
    writer->setFilename( outputFile );
 
    // Add any writer props.
+   setWriterProperties( writer.get() );
+   
+   if ( traceDebug() )
+   {
+      rspfNotify(rspfNotifyLevel_DEBUG)
+         << "writer name: " << writer->getClassName() << "\n"
+         << MODULE << " exited...\n";
+   }
+
+   return writer;
+}
+
+void rspfChipperUtil::setWriterProperties(rspfImageFileWriter* writer) const
+{
    rspf_uint32 count = m_kwl->numberOf(WRITER_PROPERTY_KW);
    for (rspf_uint32 i = 0; i < count; ++i)
    {
       rspfString key = WRITER_PROPERTY_KW;
       key += rspfString::toString(i);
-      lookup = m_kwl->find( key.c_str() );
+      const char* lookup = m_kwl->find( key.c_str() );
       if ( lookup )
       {
          rspfString s = lookup;
@@ -2571,15 +2855,6 @@ rspfRefPtr<rspfImageFileWriter> rspfChipperUtil::createNewWriter() const
          }
       }
    }
-   
-   if ( traceDebug() )
-   {
-      rspfNotify(rspfNotifyLevel_DEBUG)
-         << "writer name: " << writer->getClassName() << "\n"
-         << MODULE << " exited...\n";
-   }
-
-   return writer;
 }
 
 void rspfChipperUtil::propagateOutputProjectionToChains()
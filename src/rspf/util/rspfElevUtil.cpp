@@ -18,6 +18,7 @@
 
 #include <rspf/base/rspfArgumentParser.h>
 #include <rspf/base/rspfApplicationUsage.h>
+#include <rspf/base/rspfCommon.h>
 #include <rspf/base/rspfConnectableObject.h>
 #include <rspf/base/rspfException.h>
 #include <rspf/base/rspfFilename.h>
@@ -35,6 +36,7 @@
 #include <rspf/base/rspfConnectableContainer.h>
 
 #include <rspf/imaging/rspfBumpShadeTileSource.h>
+#include <rspf/imaging/rspfCacheTileSource.h>
 #include <rspf/imaging/rspfFilterResampler.h>
 #include <rspf/imaging/rspfImageFileWriter.h>
 #include <rspf/imaging/rspfImageGeometry.h>
@@ -42,6 +44,7 @@
 #include <rspf/imaging/rspfImageMosaic.h>
 #include <rspf/imaging/rspfImageRenderer.h>
 #include <rspf/imaging/rspfImageSource.h>
+#include <rspf/imaging/rspfImageSourceSequencer.h>
 #include <rspf/imaging/rspfImageSourceFilter.h>
 #include <rspf/imaging/rspfImageToPlaneNormalFilter.h>
 #include <rspf/imaging/rspfImageWriterFactoryRegistry.h>
@@ -50,6 +53,8 @@
 
 #include <rspf/init/rspfInit.h>
 
+#include <rspf/parallel/rspfMultiThreadSequencer.h>
+
 #include <rspf/projection/rspfEquDistCylProjection.h>
 #include <rspf/projection/rspfMapProjection.h>
 #include <rspf/projection/rspfProjection.h>
@@ -91,6 +96,7 @@ static const char SCALE_2_8_BIT_KW[]        = "scale_2_8_bit";
 static const char SNAP_TIE_TO_ORIGIN_KW[]   = "snap_tie_to_origin";
 static const char SRC_FILE_KW[]             = "src_file";
 static const char SRS_KW[]                  = "srs";
+static const char THREADS_KW[]              = "threads";
 static const char THUMBNAIL_RESOLUTION_KW[] = "thumbnail_resolution"; // pixels
 static const char TRUE_KW[]                 = "true";
 static const char WRITER_KW[]               = "writer";
@@ -172,6 +178,8 @@ void rspfElevUtil::addArguments(rspfArgumentParser& ap)
    
    appuse->addCommandLineOption("--srs","<src_code>\nSpecify an output reference frame/projection. Example: --srs EPSG:4326");
 
+   appuse->addCommandLineOption("--threads","<number_of_threads>\nNumber of threads used to compute output tiles in parallel. Zero uses the number of cores. Default is a single thread.");
+
    appuse->addCommandLineOption("-t or --thumbnail", "<max_dimension>\nSpecify a thumbnail "
       "resolution.\nScale will be adjusted so the maximum dimension = argument given.");
    
@@ -381,6 +389,11 @@ bool rspfElevUtil::initialize(rspfArgumentParser& ap)
       m_kwl->add( SRS_KW, tempString1.c_str() );
    }
 
+   if( ap.read("--threads", stringParam1) )
+   {
+      m_kwl->add( THREADS_KW, tempString1.c_str() );
+   }
+
    if( ap.read("-t", stringParam1) || ap.read("--thumbnail", stringParam1) )
    {
       m_kwl->add( THUMBNAIL_RESOLUTION_KW, tempString1.c_str() );
@@ -581,6 +594,19 @@ void rspfElevUtil::execute()
       //---
       normSource->setTrackScaleFlag(true);
 
+      //---
+      // The normal filter requests each tile expanded by one pixel on all sides so every
+      // output tile touches its eight neighbors.  A single dem chain has a resampler cache;
+      // for a mosaic of dems, cache the combined tiles so the halo is not re-rendered from
+      // every input for each neighbor.
+      //---
+      if ( m_demLayer.size() > 1 )
+      {
+         rspfRefPtr<rspfCacheTileSource> demCache = new rspfCacheTileSource;
+         demCache->connectMyInputTo( demSource.get() );
+         demSource = demCache.get();
+      }
+
       // Connect to dems.
       normSource->connectMyInputTo( demSource.get() );
 
@@ -751,6 +777,26 @@ void rspfElevUtil::execute()
       // Set up the writer.
       rspfRefPtr<rspfImageFileWriter> writer = createNewWriter();
 
+      //---
+      // Multi-threaded: The sequencer clones the chain once per thread and renders tiles
+      // in parallel.  Must be set prior to connecting the writer.
+      //---
+      lookup = m_kwl->find( THREADS_KW );
+      if ( lookup )
+      {
+         rspf_uint32 threads = rspfString(lookup).toUInt32();
+         if ( threads == 0 )
+         {
+            threads = rspf::getNumberOfThreads();
+         }
+         if ( threads > 1 )
+         {
+            rspfRefPtr<rspfImageSourceSequencer> sequencer =
+               new rspfMultiThreadSequencer(0, threads);
+            writer->changeSequencer( sequencer.get() );
+         }
+      }
+
       // Connect the writer.
       writer->connectMyInputTo(0, source.get());
 
@@ -2173,6 +2173,7 @@ void rspfInfo::printPlugins() const
 
 std::ostream& rspfInfo::printPlugins(std::ostream& out) const
 {
+   rspfSharedPluginRegistry::instance()->loadAllDeferredPlugins();
    if(rspfSharedPluginRegistry::instance()->getNumberOfPlugins() > 0)
    {
       rspfSharedPluginRegistry::instance()->printAllPluginInformation(out);
@@ -0,0 +1,823 @@
+//----------------------------------------------------------------------------
+//
+// File: rspfWebTileExporter.cpp
+//
+// License:  LGPL
+//
+// See LICENSE.txt file in the top level directory for more details.
+//
+// Description:  See class description in header.
+//
+//----------------------------------------------------------------------------
+// $Id$
+
+#include <cstdio>
+#include <cstring>
+
+//---
+// Using windows .NET compiler there is a conflict in the libjpeg with INT32
+// in the file jmorecfg.h.  Defining XMD_H fixes this.
+extern "C"
+{
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#  ifndef XMD_H
+#    define XMD_H
+#  endif
+#endif
+#include <jpeglib.h>
+}
+#include <zlib.h>
+
+#include <rspf/util/rspfWebTileExporter.h>
+#include <rspf/base/rspfCommon.h>
+#include <rspf/base/rspfException.h>
+#include <rspf/base/rspfKeywordlist.h>
+#include <rspf/base/rspfNotify.h>
+#include <rspf/base/rspfTrace.h>
+#include <rspf/base/rspfViewInterface.h>
+#include <rspf/base/rspfVisitor.h>
+#include <rspf/imaging/rspfImageChain.h>
+#include <rspf/imaging/rspfImageData.h>
+#include <rspf/imaging/rspfImageSource.h>
+#include <rspf/parallel/rspfImageChainMtAdaptor.h>
+#include <rspf/parallel/rspfJob.h>
+#include <rspf/parallel/rspfJobMultiThreadQueue.h>
+#include <rspf/projection/rspfEpsgProjectionDatabase.h>
+#include <rspf/projection/rspfMapProjection.h>
+#include <OpenThreads/Block>
+#include <OpenThreads/ScopedLock>
+
+static rspfTrace traceDebug(rspfString("rspfWebTileExporter:debug"));
+
+const rspf_uint32 rspfWebTileExporter::TILE_SIZE = 256;
+
+static const rspf_uint32 MAX_ZOOM_LIMIT = 23; // 256 * 2^23 - 1 is the last rspf_int32.
+static const double      HALF_WORLD     = 20037508.342789244; // pi * 6378137
+
+//---
+// Sets the view on every view client of head and initializes everything
+// upstream of it, inputs first.
+//---
+static void setChainView(rspfImageSource* head, const rspfMapProjection* proj)
+{
+   rspfTypeNameVisitor views( rspfString("rspfViewInterface"), false,
+                              (rspfVisitor::VISIT_INPUTS|rspfVisitor::VISIT_CHILDREN) );
+   head->accept(views);
+   for (rspf_uint32 i = 0; i < views.getObjects().size(); ++i)
+   {
+      rspfViewInterface* view = views.getObjectAs<rspfViewInterface>(i);
+      if (view)
+         view->setView( proj->dup() );
+   }
+   rspfTypeNameVisitor sources( rspfString("rspfSource"), false,
+                                (rspfVisitor::VISIT_INPUTS|rspfVisitor::VISIT_CHILDREN) );
+   head->accept(sources);
+   for (rspf_uint32 i = (rspf_uint32)sources.getObjects().size(); i > 0; --i)
+   {
+      rspfSource* source = sources.getObjectAs<rspfSource>(i-1);
+      if (source)
+         source->initialize();
+   }
+   head->initialize();
+}
+
+//---
+// Big endian append for the PNG chunks.
+//---
+static void appendUint32(std::vector<rspf_uint8>& out, rspf_uint32 value)
+{
+   out.push_back( (rspf_uint8)(value >> 24) );
+   out.push_back( (rspf_uint8)(value >> 16) );
+   out.push_back( (rspf_uint8)(value >> 8) );
+   out.push_back( (rspf_uint8)value );
+}
+
+static void appendPngChunk(std::vector<rspf_uint8>& out, const char* type,
+                           const rspf_uint8* data, rspf_uint32 size)
+{
+   appendUint32(out, size);
+   size_t typePos = out.size();
+   out.insert(out.end(), type, type + 4);
+   if (size)
+      out.insert(out.end(), data, data + size);
+   uLong crc = crc32(0L, Z_NULL, 0);
+   crc = crc32(crc, &out[typePos], size + 4);
+   appendUint32(out, (rspf_uint32)crc);
+}
+
+//---
+// Counts down the jobs of one execute.
+//---
+class rspfWebTileCountDown : public rspfReferenced
+{
+public:
+   rspfWebTileCountDown(rspf_uint32 jobs)
+      : m_jobs(jobs),
+        m_mutex(),
+        m_block()
+   {
+      m_block.reset();
+   }
+
+   void jobFinished()
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      if ( m_jobs && (--m_jobs == 0) )
+         m_block.release();
+   }
+
+   void wait() { m_block.block(); }
+
+protected:
+   virtual ~rspfWebTileCountDown() {}
+
+   rspf_uint32          m_jobs;
+   OpenThreads::Mutex   m_mutex;
+   OpenThreads::Block   m_block;
+};
+
+//---
+// Builds subtrees from the exporter's root list on one chain clone.
+//---
+class rspfWebTileExporter::Job : public rspfJob
+{
+public:
+   Job(rspfWebTileExporter* exporter, rspfImageSource* source, rspfWebTileCountDown* countDown)
+      : m_exporter(exporter),
+        m_source(source),
+        m_countDown(countDown)
+   {
+   }
+
+   virtual void start()
+   {
+      running();
+      run();
+      if (m_countDown.valid())
+         m_countDown->jobFinished();
+      finished();
+   }
+
+   void run()
+   {
+      TileXy root;
+      Raster raster;
+      while ( m_exporter->nextRoot(root) )
+      {
+         try
+         {
+            if ( m_exporter->buildTile(m_source.get(), m_exporter->m_splitZoom,
+                                       root.first, root.second, raster) )
+            {
+               m_exporter->keepRoot(root, raster);
+            }
+         }
+         catch(const rspfException& e)
+         {
+            rspfNotify(rspfNotifyLevel_WARN)
+               << "rspfWebTileExporter::execute ERROR:\n" << e.what() << std::endl;
+            m_exporter->tileDone(false);
+         }
+      }
+   }
+
+private:
+   rspfWebTileExporter*                m_exporter;
+   rspfRefPtr<rspfImageSource>        m_source;
+   rspfRefPtr<rspfWebTileCountDown>   m_countDown;
+};
+
+rspfWebTileExporter::rspfWebTileExporter()
+   : rspfReferenced(),
+     m_chain(0),
+     m_outputDirectory(),
+     m_minZoom(0),
+     m_maxZoom(0),
+     m_scheme(XYZ),
+     m_format(PNG),
+     m_jpegQuality(75),
+     m_pngLevel(1),
+     m_threads(0),
+     m_inputRect(),
+     m_splitZoom(0),
+     m_rootList(),
+     m_nextRoot(0),
+     m_roots(),
+     m_directories(),
+     m_written(0),
+     m_failed(false),
+     m_mutex()
+{
+   m_inputRect.makeNan();
+}
+
+rspfWebTileExporter::~rspfWebTileExporter()
+{
+}
+
+void rspfWebTileExporter::setInput(rspfImageChain* chain)
+{
+   m_chain = chain;
+}
+
+void rspfWebTileExporter::setOutputDirectory(const rspfFilename& dir)
+{
+   m_outputDirectory = dir;
+}
+
+const rspfFilename& rspfWebTileExporter::getOutputDirectory() const
+{
+   return m_outputDirectory;
+}
+
+void rspfWebTileExporter::setZoomLevels(rspf_uint32 minZoom, rspf_uint32 maxZoom)
+{
+   m_maxZoom = (maxZoom > MAX_ZOOM_LIMIT) ? MAX_ZOOM_LIMIT : maxZoom;
+   m_minZoom = (minZoom > m_maxZoom) ? m_maxZoom : minZoom;
+}
+
+rspf_uint32 rspfWebTileExporter::getMinZoom() const
+{
+   return m_minZoom;
+}
+
+rspf_uint32 rspfWebTileExporter::getMaxZoom() const
+{
+   return m_maxZoom;
+}
+
+void rspfWebTileExporter::setScheme(Scheme scheme)
+{
+   m_scheme = scheme;
+}
+
+rspfWebTileExporter::Scheme rspfWebTileExporter::getScheme() const
+{
+   return m_scheme;
+}
+
+void rspfWebTileExporter::setFormat(Format format)
+{
+   m_format = format;
+}
+
+rspfWebTileExporter::Format rspfWebTileExporter::getFormat() const
+{
+   return m_format;
+}
+
+void rspfWebTileExporter::setJpegQuality(rspf_int32 quality)
+{
+   m_jpegQuality = (quality < 1) ? 1 : ( (quality > 100) ? 100 : quality );
+}
+
+void rspfWebTileExporter::setPngCompressionLevel(rspf_int32 level)
+{
+   m_pngLevel = (level < 0) ? 0 : ( (level > 9) ? 9 : level );
+}
+
+void rspfWebTileExporter::setNumberOfThreads(rspf_uint32 threads)
+{
+   m_threads = threads;
+}
+
+bool rspfWebTileExporter::loadState(const rspfKeywordlist& kwl, const char* prefix)
+{
+   const char* lookup = kwl.find(prefix, "output_directory");
+   if (lookup)
+      setOutputDirectory(rspfFilename(lookup));
+
+   rspf_uint32 minZoom = m_minZoom;
+   rspf_uint32 maxZoom = m_maxZoom;
+   lookup = kwl.find(prefix, "min_zoom");
+   if (lookup)
+      minZoom = rspfString(lookup).toUInt32();
+   const char* maxLookup = kwl.find(prefix, "max_zoom");
+   if (maxLookup)
+      maxZoom = rspfString(maxLookup).toUInt32();
+   setZoomLevels(minZoom, maxZoom);
+
+   lookup = kwl.find(prefix, "scheme");
+   if (lookup)
+      setScheme( (rspfString(lookup).downcase() == "tms") ? TMS : XYZ );
+
+   lookup = kwl.find(prefix, "format");
+   if (lookup)
+   {
+      rspfString format = rspfString(lookup).downcase();
+      setFormat( ((format == "jpeg") || (format == "jpg")) ? JPEG : PNG );
+   }
+
+   lookup = kwl.find(prefix, "jpeg_quality");
+   if (lookup)
+      setJpegQuality(rspfString(lookup).toInt32());
+
+   lookup = kwl.find(prefix, "png_compression");
+   if (lookup)
+      setPngCompressionLevel(rspfString(lookup).toInt32());
+
+   lookup = kwl.find(prefix, "threads");
+   if (lookup)
+      setNumberOfThreads(rspfString(lookup).toUInt32());
+
+   return (maxLookup != 0);
+}
+
+rspf_uint64 rspfWebTileExporter::getTilesWritten() const
+{
+   return m_written;
+}
+
+rspfMapProjection* rspfWebTileExporter::createProjection(rspf_uint32 zoom)
+{
+   rspfMapProjection* proj = dynamic_cast<rspfMapProjection*>(
+      rspfEpsgProjectionDatabase::instance()->findProjection(900913) );
+   if (proj)
+   {
+      if (zoom > MAX_ZOOM_LIMIT)
+         zoom = MAX_ZOOM_LIMIT;
+      const double res = (2.0 * HALF_WORLD) / ( (double)TILE_SIZE * (double)(1 << zoom) );
+
+      // Pixel centers, edge to edge like rspfTiling:
+      proj->setUlTiePoints(rspfDpt(-HALF_WORLD + res * 0.5, HALF_WORLD - res * 0.5));
+      proj->setMetersPerPixel(rspfDpt(res, res));
+   }
+   return proj;
+}
+
+bool rspfWebTileExporter::execute()
+{
+   static const char MODULE[] = "rspfWebTileExporter::execute";
+
+   m_written = 0;
+   m_failed  = false;
+   m_roots.clear();
+   m_rootList.clear();
+   m_nextRoot = 0;
+
+   if ( !m_chain.valid() || m_outputDirectory.empty() )
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << MODULE << " ERROR: No input chain or output directory." << std::endl;
+      return false;
+   }
+   if ( !m_outputDirectory.createDirectory(true) )
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << MODULE << " ERROR: Could not create " << m_outputDirectory << std::endl;
+      return false;
+   }
+
+   rspfRefPtr<rspfMapProjection> proj = createProjection(m_maxZoom);
+   if ( !proj.valid() )
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << MODULE << " ERROR: Could not create the web mercator projection." << std::endl;
+      return false;
+   }
+   setChainView(m_chain.get(), proj.get());
+
+   // Input footprint in max zoom pixels, clamped to the world:
+   m_inputRect = m_chain->getBoundingRect();
+   const rspf_int64 worldPixels = (rspf_int64)TILE_SIZE << m_maxZoom;
+   if ( !m_inputRect.hasNans() )
+   {
+      m_inputRect = m_inputRect.clipToRect(
+         rspfIrect(0, 0, (rspf_int32)(worldPixels - 1), (rspf_int32)(worldPixels - 1)) );
+   }
+   if ( m_inputRect.hasNans() || (m_inputRect.width() < 1) || (m_inputRect.height() < 1) )
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << MODULE << " ERROR: Input does not cover the web mercator world." << std::endl;
+      return false;
+   }
+
+   // Subtree roots: the first zoom with enough tiles to keep the threads busy.
+   rspf_uint32 threads = m_threads ? m_threads : rspf::getNumberOfThreads();
+   if (threads < 1)
+      threads = 1;
+   rspf_uint32 x0 = 0;
+   rspf_uint32 y0 = 0;
+   rspf_uint32 x1 = 0;
+   rspf_uint32 y1 = 0;
+   for (m_splitZoom = m_minZoom; m_splitZoom <= m_maxZoom; ++m_splitZoom)
+   {
+      const rspf_uint32 shift = m_maxZoom - m_splitZoom;
+      const rspf_int64 span = (rspf_int64)TILE_SIZE << shift;
+      x0 = (rspf_uint32)(m_inputRect.ul().x / span);
+      y0 = (rspf_uint32)(m_inputRect.ul().y / span);
+      x1 = (rspf_uint32)(m_inputRect.lr().x / span);
+      y1 = (rspf_uint32)(m_inputRect.lr().y / span);
+      rspf_uint64 count = (rspf_uint64)(x1 - x0 + 1) * (rspf_uint64)(y1 - y0 + 1);
+      if ( (count >= 8 * (rspf_uint64)threads) || (m_splitZoom == m_maxZoom) )
+         break;
+   }
+   for (rspf_uint32 y = y0; y <= y1; ++y)
+      for (rspf_uint32 x = x0; x <= x1; ++x)
+         m_rootList.push_back( TileXy(x, y) );
+   if (threads > m_rootList.size())
+      threads = (rspf_uint32)m_rootList.size();
+
+   if (threads > 1)
+   {
+      rspfRefPtr<rspfImageChainMtAdaptor> adaptor =
+         new rspfImageChainMtAdaptor(m_chain.get(), threads);
+      threads = adaptor->getNumberOfClones();
+
+      rspfRefPtr<rspfWebTileCountDown> countDown = new rspfWebTileCountDown(threads);
+      rspfRefPtr<rspfJobMultiThreadQueue> queue =
+         new rspfJobMultiThreadQueue(new rspfJobQueue(), threads);
+      for (rspf_uint32 i = 0; i < threads; ++i)
+      {
+         rspfImageSource* clone = adaptor->getClone(i);
+         setChainView(clone, proj.get());
+         rspfRefPtr<rspfJob> job = new Job(this, clone, countDown.get());
+         job->ready();
+         queue->getJobQueue()->add(job.get(), false);
+      }
+      countDown->wait();
+   }
+   else
+   {
+      rspfRefPtr<Job> job = new Job(this, m_chain.get(), 0);
+      job->run();
+   }
+
+   if (!m_failed)
+      buildTopZooms();
+   m_roots.clear();
+
+   if ( traceDebug() || m_failed )
+   {
+      rspfNotify(rspfNotifyLevel_INFO)
+         << MODULE << ": " << m_written << " tiles written, zooms " << m_minZoom << " - "
+         << m_maxZoom << ", split at " << m_splitZoom << ", " << threads << " threads."
+         << std::endl;
+   }
+   return !m_failed;
+}
+
+bool rspfWebTileExporter::buildTile(rspfImageSource* source, rspf_uint32 zoom,
+                                     rspf_uint32 x, rspf_uint32 y, Raster& raster)
+{
+   if ( m_failed || !intersectsInput(zoom, x, y) )
+      return false;
+
+   if (zoom == m_maxZoom)
+   {
+      rspfIrect rect( (rspf_int32)(x * TILE_SIZE), (rspf_int32)(y * TILE_SIZE),
+                      (rspf_int32)(x * TILE_SIZE + TILE_SIZE - 1),
+                      (rspf_int32)(y * TILE_SIZE + TILE_SIZE - 1) );
+      rspfRefPtr<rspfImageData> tile = source->getTile(rect);
+      if ( !tile.valid() ||
+           (tile->getDataObjectStatus() == RSPF_NULL) ||
+           (tile->getDataObjectStatus() == RSPF_EMPTY) ||
+           !toRaster(tile.get(), raster) )
+      {
+         return false;
+      }
+   }
+   else
+   {
+      // Depth first; one child raster per level is live at a time.
+      raster.assign(TILE_SIZE * TILE_SIZE * 4, 0);
+      Raster child;
+      bool valid = false;
+      for (rspf_uint32 qy = 0; qy < 2; ++qy)
+      {
+         for (rspf_uint32 qx = 0; qx < 2; ++qx)
+         {
+            if ( buildTile(source, zoom + 1, 2 * x + qx, 2 * y + qy, child) )
+            {
+               reduce(child, qx, qy, raster);
+               valid = true;
+            }
+         }
+      }
+      if (!valid)
+         return false;
+   }
+
+   tileDone( writeTile(zoom, x, y, raster) );
+   return true;
+}
+
+bool rspfWebTileExporter::intersectsInput(rspf_uint32 zoom, rspf_uint32 x, rspf_uint32 y) const
+{
+   const rspf_int64 span = (rspf_int64)TILE_SIZE << (m_maxZoom - zoom);
+   const rspf_int64 ulx = x * span;
+   const rspf_int64 uly = y * span;
+   return ( (ulx <= m_inputRect.lr().x) && (ulx + span - 1 >= m_inputRect.ul().x) &&
+            (uly <= m_inputRect.lr().y) && (uly + span - 1 >= m_inputRect.ul().y) );
+}
+
+bool rspfWebTileExporter::toRaster(const rspfImageData* tile, Raster& raster)
+{
+   const rspf_uint32 pixels = TILE_SIZE * TILE_SIZE;
+   raster.assign(pixels * 4, 0);
+
+   const rspf_uint32 bands = tile->getNumberOfBands();
+   if ( !bands || (tile->getWidth() != TILE_SIZE) || (tile->getHeight() != TILE_SIZE) )
+      return false;
+   const rspf_uint32 band[3] = { 0,
+                                  static_cast<rspf_uint32>( (bands >= 3) ? 1 : 0 ),
+                                  static_cast<rspf_uint32>( (bands >= 3) ? 2 : 0 ) };
+   const rspf_uint32 nullBands = (bands >= 3) ? 3 : 1;
+
+   bool valid = false;
+   if (tile->getScalarType() == RSPF_UINT8)
+   {
+      const rspf_uint8* buf[3];
+      rspf_uint8 np[3];
+      for (rspf_uint32 b = 0; b < 3; ++b)
+      {
+         buf[b] = static_cast<const rspf_uint8*>( tile->getBuf(band[b]) );
+         np[b]  = (rspf_uint8)tile->getNullPix(band[b]);
+      }
+      rspf_uint8* out = &raster.front();
+      for (rspf_uint32 i = 0; i < pixels; ++i, out += 4)
+      {
+         bool isNull = true;
+         for (rspf_uint32 b = 0; b < nullBands; ++b)
+            isNull = isNull && (buf[b][i] == np[b]);
+         if (isNull)
+            continue;
+         out[0] = buf[0][i];
+         out[1] = buf[1][i];
+         out[2] = buf[2][i];
+         out[3] = 255;
+         valid = true;
+      }
+   }
+   else
+   {
+      double minPix[3];
+      double scale[3];
+      double np[3];
+      for (rspf_uint32 b = 0; b < 3; ++b)
+      {
+         minPix[b] = tile->getMinPix(band[b]);
+         double range = tile->getMaxPix(band[b]) - minPix[b];
+         scale[b] = (range > 0.0) ? 255.0 / range : 0.0;
+         np[b] = tile->getNullPix(band[b]);
+      }
+      rspf_uint8* out = &raster.front();
+      for (rspf_uint32 i = 0; i < pixels; ++i, out += 4)
+      {
+         double pix[3];
+         bool isNull = true;
+         for (rspf_uint32 b = 0; b < 3; ++b)
+         {
+            pix[b] = tile->getPix(i, band[b]);
+            if (b < nullBands)
+               isNull = isNull && (pix[b] == np[b]);
+         }
+         if (isNull)
+            continue;
+         for (rspf_uint32 b = 0; b < 3; ++b)
+         {
+            double v = (pix[b] - minPix[b]) * scale[b];
+            out[b] = (rspf_uint8)( (v < 0.0) ? 0 : ( (v > 255.0) ? 255 : v + 0.5 ) );
+         }
+         out[3] = 255;
+         valid = true;
+      }
+   }
+   return valid;
+}
+
+void rspfWebTileExporter::reduce(const Raster& child, rspf_uint32 qx, rspf_uint32 qy,
+                                 Raster& parent)
+{
+   const rspf_uint32 half = TILE_SIZE / 2;
+   const rspf_uint32 rowBytes = TILE_SIZE * 4;
+   for (rspf_uint32 py = 0; py < half; ++py)
+   {
+      const rspf_uint8* r0 = &child[(2 * py) * rowBytes];
+      const rspf_uint8* r1 = r0 + rowBytes;
+      rspf_uint8* out = &parent[(qy * half + py) * rowBytes + qx * half * 4];
+      for (rspf_uint32 px = 0; px < half; ++px, r0 += 8, r1 += 8, out += 4)
+      {
+         const rspf_uint8* p[4] = { r0, r0 + 4, r1, r1 + 4 };
+         rspf_uint32 sum[3] = { 0, 0, 0 };
+         rspf_uint32 alpha = 0;
+         rspf_uint32 count = 0;
+         for (rspf_uint32 k = 0; k < 4; ++k)
+         {
+            if (p[k][3])
+            {
+               sum[0] += p[k][0];
+               sum[1] += p[k][1];
+               sum[2] += p[k][2];
+               alpha  += p[k][3];
+               ++count;
+            }
+         }
+         if (count)
+         {
+            out[0] = (rspf_uint8)( (sum[0] + count / 2) / count );
+            out[1] = (rspf_uint8)( (sum[1] + count / 2) / count );
+            out[2] = (rspf_uint8)( (sum[2] + count / 2) / count );
+            out[3] = (rspf_uint8)( (alpha + 2) / 4 );
+            if (!out[3])
+               out[3] = 1;
+         }
+      }
+   }
+}
+
+bool rspfWebTileExporter::writeTile(rspf_uint32 zoom, rspf_uint32 x, rspf_uint32 y,
+                                    const Raster& raster)
+{
+   const rspf_uint32 row = (m_scheme == TMS) ? ( (1u << zoom) - 1 - y ) : y;
+
+   rspfFilename dir = m_outputDirectory.dirCat( rspfString::toString(zoom) );
+   dir = dir.dirCat( rspfString::toString(x) );
+   {
+      // One stat/mkdir per column directory for the whole run:
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      if ( m_directories.insert(dir.string()).second && !dir.createDirectory(true) )
+      {
+         m_directories.erase(dir.string());
+         rspfNotify(rspfNotifyLevel_WARN)
+            << "rspfWebTileExporter::writeTile ERROR: Could not create " << dir << std::endl;
+         return false;
+      }
+   }
+   rspfFilename file = dir.dirCat( rspfString::toString(row) +
+                                   ( (m_format == JPEG) ? ".jpg" : ".png" ) );
+
+   const rspf_uint32 pixels = TILE_SIZE * TILE_SIZE;
+   const rspf_uint8* rgba = &raster.front();
+
+   // Fully opaque tiles go out without alpha:
+   bool opaque = true;
+   for (rspf_uint32 i = 0; opaque && (i < pixels); ++i)
+      opaque = (rgba[i * 4 + 3] == 255);
+   std::vector<rspf_uint8> rgb;
+   if ( opaque || (m_format == JPEG) )
+   {
+      rgb.resize(pixels * 3);
+      for (rspf_uint32 i = 0; i < pixels; ++i)
+      {
+         rgb[i * 3]     = rgba[i * 4];
+         rgb[i * 3 + 1] = rgba[i * 4 + 1];
+         rgb[i * 3 + 2] = rgba[i * 4 + 2];
+      }
+   }
+
+   FILE* fp = fopen(file.c_str(), "wb");
+   if (!fp)
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << "rspfWebTileExporter::writeTile ERROR: Could not open " << file << std::endl;
+      return false;
+   }
+
+   bool status = true;
+   if (m_format == JPEG)
+   {
+      // Same libjpeg usage as rspfJpegWriter::writeFile.
+      struct jpeg_compress_struct cinfo;
+      struct jpeg_error_mgr jerr;
+      cinfo.err = jpeg_std_error(&jerr);
+      jpeg_create_compress(&cinfo);
+      jpeg_stdio_dest(&cinfo, fp);
+      cinfo.image_width      = TILE_SIZE;
+      cinfo.image_height     = TILE_SIZE;
+      cinfo.input_components = 3;
+      cinfo.in_color_space   = JCS_RGB;
+      jpeg_set_defaults(&cinfo);
+      jpeg_set_quality(&cinfo, m_jpegQuality, TRUE);
+      jpeg_start_compress(&cinfo, TRUE);
+      while (cinfo.next_scanline < cinfo.image_height)
+      {
+         JSAMPROW rowPointer[1];
+         rowPointer[0] = &rgb[cinfo.next_scanline * TILE_SIZE * 3];
+         jpeg_write_scanlines(&cinfo, rowPointer, 1);
+      }
+      jpeg_finish_compress(&cinfo);
+      jpeg_destroy_compress(&cinfo);
+   }
+   else
+   {
+      std::vector<rspf_uint8> bytes;
+      status = opaque ? encodePng(&rgb.front(), TILE_SIZE, TILE_SIZE, 3, m_pngLevel, bytes)
+                      : encodePng(rgba, TILE_SIZE, TILE_SIZE, 4, m_pngLevel, bytes);
+      if (status)
+         status = ( fwrite(&bytes.front(), 1, bytes.size(), fp) == bytes.size() );
+   }
+   if ( (fclose(fp) != 0) || !status )
+   {
+      rspfNotify(rspfNotifyLevel_WARN)
+         << "rspfWebTileExporter::writeTile ERROR: Could not write " << file << std::endl;
+      return false;
+   }
+   return true;
+}
+
+bool rspfWebTileExporter::encodePng(const rspf_uint8* pixels,
+                                    rspf_uint32 width,
+                                    rspf_uint32 height,
+                                    rspf_uint32 channels,
+                                    rspf_int32 level,
+                                    std::vector<rspf_uint8>& out)
+{
+   out.clear();
+   rspf_uint8 colorType = 0;
+   switch (channels)
+   {
+      case 1: colorType = 0; break; // gray
+      case 2: colorType = 4; break; // gray, alpha
+      case 3: colorType = 2; break; // RGB
+      case 4: colorType = 6; break; // RGBA
+      default: return false;
+   }
+   if ( !pixels || !width || !height )
+      return false;
+
+   // Rows with the "Sub" filter, which costs little and helps zlib on imagery:
+   const rspf_uint32 rowBytes = width * channels;
+   std::vector<rspf_uint8> filtered( (rowBytes + 1) * height );
+   rspf_uint8* f = &filtered.front();
+   for (rspf_uint32 y = 0; y < height; ++y)
+   {
+      const rspf_uint8* row = pixels + y * rowBytes;
+      *f++ = 1;
+      for (rspf_uint32 i = 0; i < channels; ++i)
+         *f++ = row[i];
+      for (rspf_uint32 i = channels; i < rowBytes; ++i)
+         *f++ = (rspf_uint8)(row[i] - row[i - channels]);
+   }
+
+   uLongf compressedSize = compressBound( (uLong)filtered.size() );
+   std::vector<rspf_uint8> compressed(compressedSize);
+   if ( compress2(&compressed.front(), &compressedSize,
+                  &filtered.front(), (uLong)filtered.size(), level) != Z_OK )
+   {
+      return false;
+   }
+
+   static const rspf_uint8 SIGNATURE[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+   out.reserve(compressedSize + 64);
+   out.insert(out.end(), SIGNATURE, SIGNATURE + 8);
+
+   std::vector<rspf_uint8> ihdr;
+   appendUint32(ihdr, width);
+   appendUint32(ihdr, height);
+   ihdr.push_back(8);         // bit depth
+   ihdr.push_back(colorType);
+   ihdr.push_back(0);         // deflate
+   ihdr.push_back(0);         // adaptive filtering
+   ihdr.push_back(0);         // no interlace
+   appendPngChunk(out, "IHDR", &ihdr.front(), (rspf_uint32)ihdr.size());
+   appendPngChunk(out, "IDAT", &compressed.front(), (rspf_uint32)compressedSize);
+   appendPngChunk(out, "IEND", 0, 0);
+   return true;
+}
+
+void rspfWebTileExporter::tileDone(bool ok)
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   if (ok)
+      ++m_written;
+   else
+      m_failed = true;
+}
+
+bool rspfWebTileExporter::nextRoot(TileXy& root)
+{
+   OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+   if ( m_failed || (m_nextRoot >= m_rootList.size()) )
+      return false;
+   root = m_rootList[m_nextRoot++];
+   return true;
+}
+
+void rspfWebTileExporter::keepRoot(const TileXy& root, const Raster& raster)
+{
+   if (m_splitZoom > m_minZoom)
+   {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+      m_roots[root] = raster;
+   }
+}
+
+void rspfWebTileExporter::buildTopZooms()
+{
+   for (rspf_uint32 zoom = m_splitZoom; (zoom > m_minZoom) && !m_failed; --zoom)
+   {
+      std::map<TileXy, Raster> parents;
+      std::map<TileXy, Raster>::const_iterator i = m_roots.begin();
+      for (; i != m_roots.end(); ++i)
+      {
+         Raster& parent = parents[ TileXy(i->first.first / 2, i->first.second / 2) ];
+         if (parent.empty())
+            parent.assign(TILE_SIZE * TILE_SIZE * 4, 0);
+         reduce(i->second, i->first.first & 1, i->first.second & 1, parent);
+      }
+      for (i = parents.begin(); i != parents.end(); ++i)
+         tileDone( writeTile(zoom - 1, i->first.first, i->first.second, i->second) );
+      m_roots.swap(parents);
+   }
+}